@@ -0,0 +1,517 @@
+// AsyncCurl.cpp
+#ifndef FORTE_NO_CURL
+#include "AsyncCurl.h"
+#include "Clock.h"
+#include "Foreach.h"
+#include "FTrace.h"
+#include "LogManager.h"
+#include <boost/bind.hpp>
+#include <string.h>
+
+using namespace Forte;
+
+#define SET_CURL_OPT(HANDLE, OPTION, VALUE)                             \
+    {                                                                   \
+        CURLcode errCode = curl_easy_setopt(HANDLE, OPTION, VALUE);     \
+        if (errCode != CURLE_OK)                                        \
+        {                                                               \
+            hlog_and_throw(HLOG_ERR, EAsyncCurl(                        \
+                               FStringFC(), "CURL_FAIL_SETOPT|||%s|||%s", \
+                               #OPTION, curl_easy_strerror(errCode)));  \
+        }                                                               \
+    }
+
+Forte::AsyncCurlRequest::AsyncCurlRequest(
+    const boost::shared_ptr<AsyncCurl> &client, const FString &url)
+    : mClient(client),
+      mURL(url),
+      mPost(false),
+      mHeaders(NULL),
+      mFollowRedirects(false),
+      mConnectTimeout(0),
+      mMaxTransferTime(0),
+      mThrowOnHTTPError(false),
+      mStarted(false)
+{
+    memset(mErrorBuffer, 0, sizeof(mErrorBuffer));
+}
+
+Forte::AsyncCurlRequest::~AsyncCurlRequest()
+{
+    if (mHeaders != NULL)
+        curl_slist_free_all(mHeaders);
+}
+
+void Forte::AsyncCurlRequest::SetPostFields(const FString &postFields)
+{
+    mPost = true;
+    mPostFields = postFields;
+}
+
+void Forte::AsyncCurlRequest::AddHeader(const FString &header)
+{
+    struct curl_slist *headers = curl_slist_append(mHeaders, header.c_str());
+    if (headers == NULL)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurl(
+                           FStringFC(), "could not add header %s",
+                           header.c_str()));
+    }
+    mHeaders = headers;
+}
+
+void Forte::AsyncCurlRequest::SetBodyCallback(const BodyCallback &callback)
+{
+    mBodyCallback = callback;
+}
+
+void Forte::AsyncCurlRequest::SetFollowRedirects(bool follow)
+{
+    mFollowRedirects = follow;
+}
+
+void Forte::AsyncCurlRequest::SetConnectTimeout(long timeout)
+{
+    mConnectTimeout = timeout;
+}
+
+void Forte::AsyncCurlRequest::SetMaxTransferTime(long maxXferTime)
+{
+    mMaxTransferTime = maxXferTime;
+}
+
+void Forte::AsyncCurlRequest::SetThrowOnHTTPError(bool shouldThrow)
+{
+    mThrowOnHTTPError = shouldThrow;
+}
+
+void Forte::AsyncCurlRequest::Begin(void)
+{
+    boost::shared_ptr<AsyncCurl> client(mClient.lock());
+    if (!client)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurlShutdown(mURL));
+    }
+    client->Start(boost::static_pointer_cast<AsyncCurlRequest>(
+                      shared_from_this()));
+}
+
+void Forte::AsyncCurlRequest::configure(CURL *handle)
+{
+    // called with the client's lock held, on a freshly reset handle
+    mBody.clear();
+    mErrorBuffer[0] = 0;
+    SET_CURL_OPT(handle, CURLOPT_URL, mURL.c_str());
+    SET_CURL_OPT(handle, CURLOPT_ERRORBUFFER, mErrorBuffer);
+    SET_CURL_OPT(handle, CURLOPT_NOSIGNAL, 1L);
+    SET_CURL_OPT(handle, CURLOPT_WRITEFUNCTION, &AsyncCurlRequest::write);
+    SET_CURL_OPT(handle, CURLOPT_WRITEDATA, this);
+    if (mPost)
+    {
+        SET_CURL_OPT(handle, CURLOPT_POSTFIELDSIZE,
+                     static_cast<long>(mPostFields.size()));
+        SET_CURL_OPT(handle, CURLOPT_POSTFIELDS, mPostFields.c_str());
+    }
+    if (mHeaders != NULL)
+        SET_CURL_OPT(handle, CURLOPT_HTTPHEADER, mHeaders);
+    SET_CURL_OPT(handle, CURLOPT_FOLLOWLOCATION, mFollowRedirects ? 1L : 0L);
+    SET_CURL_OPT(handle, CURLOPT_CONNECTTIMEOUT, mConnectTimeout);
+    SET_CURL_OPT(handle, CURLOPT_TIMEOUT, mMaxTransferTime);
+}
+
+size_t Forte::AsyncCurlRequest::write(void *buffer, size_t size,
+                                      size_t nmemb, void *userp)
+{
+    AsyncCurlRequest *request(static_cast<AsyncCurlRequest *>(userp));
+    const char *data(static_cast<const char *>(buffer));
+    const size_t len(size * nmemb);
+
+    if (!request->mBodyCallback)
+    {
+        request->mBody.append(data, len);
+        return len;
+    }
+
+    // anything but len makes curl fail the transfer, and an exception
+    // must not unwind through curl
+    try
+    {
+        return request->mBodyCallback(data, len) ? len : 0;
+    }
+    catch (std::exception &e)
+    {
+        hlog(HLOG_ERR, "body callback for %s threw: %s",
+             request->mURL.c_str(), e.what());
+    }
+    catch (...)
+    {
+        hlog(HLOG_ERR, "body callback for %s threw", request->mURL.c_str());
+    }
+    return 0;
+}
+
+void Forte::AsyncCurlRequest::complete(CURLcode result, long responseCode)
+{
+    if (result != CURLE_OK)
+    {
+        FString err(FStringFC(), "CURL_FAIL_XFER|||%s|||%s",
+                    mErrorBuffer[0] != 0
+                    ? mErrorBuffer : curl_easy_strerror(result),
+                    mURL.c_str());
+        hlog(HLOG_DEBUG, "%s", err.c_str());
+        setException(boost::copy_exception(EAsyncCurlTransfer(err)));
+    }
+    else if (mThrowOnHTTPError && responseCode >= 400)
+    {
+        FString err(FStringFC(), "CURL_FAIL_XFER|||%ld|||%s",
+                    responseCode, mURL.c_str());
+        hlog(HLOG_DEBUG, "%s", err.c_str());
+        setException(boost::copy_exception(EAsyncCurlHTTPError(err)));
+    }
+    else
+    {
+        setResult(responseCode);
+    }
+}
+
+Forte::AsyncCurl::AsyncCurl(const boost::shared_ptr<EPollMonitor> &monitor,
+                            long maxConnections)
+    : mMonitor(monitor),
+      mMulti(NULL),
+      mTimer(-1),
+      mShutdown(false)
+{
+    FTRACE2("%ld", maxConnections);
+
+    if ((mMulti = curl_multi_init()) == NULL)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurlInit());
+    }
+
+    if (curl_multi_setopt(mMulti, CURLMOPT_SOCKETFUNCTION,
+                          &AsyncCurl::socketCallback) != CURLM_OK
+        || curl_multi_setopt(mMulti, CURLMOPT_SOCKETDATA, this) != CURLM_OK
+        || curl_multi_setopt(mMulti, CURLMOPT_TIMERFUNCTION,
+                             &AsyncCurl::timerCallback) != CURLM_OK
+        || curl_multi_setopt(mMulti, CURLMOPT_TIMERDATA, this) != CURLM_OK
+        || (maxConnections > 0
+            && curl_multi_setopt(mMulti, CURLMOPT_MAXCONNECTS,
+                                 maxConnections) != CURLM_OK))
+    {
+        curl_multi_cleanup(mMulti);
+        hlog_and_throw(HLOG_ERR, EAsyncCurlInit());
+    }
+}
+
+Forte::AsyncCurl::~AsyncCurl()
+{
+    FTRACE;
+    Shutdown();
+}
+
+void Forte::AsyncCurl::Start(const AsyncCurlRequestPtr &request)
+{
+    FTRACE2("%s", request->GetURL().c_str());
+
+    AutoUnlockMutex lock(mLock);
+    if (mShutdown)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurlShutdown(request->GetURL()));
+    }
+    if (request->mStarted)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurlRequestStarted(request->GetURL()));
+    }
+
+    if (mTimer == -1)
+    {
+        // handlers in the monitor must not keep the client alive
+        mSelf = boost::static_pointer_cast<AsyncCurl>(shared_from_this());
+        mTimer = mMonitor->AddTimer(boost::bind(&AsyncCurl::timerFired, mSelf));
+    }
+
+    CURL *handle = getHandle();
+    try
+    {
+        request->configure(handle);
+    }
+    catch (...)
+    {
+        releaseHandle(handle);
+        throw;
+    }
+
+    CURLMcode rc = curl_multi_add_handle(mMulti, handle);
+    if (rc != CURLM_OK)
+    {
+        releaseHandle(handle);
+        hlog_and_throw(HLOG_ERR, EAsyncCurl(
+                           FStringFC(), "%s: %s", request->GetURL().c_str(),
+                           curl_multi_strerror(rc)));
+    }
+    request->mStarted = true;
+    mActive[handle] = request;
+}
+
+void Forte::AsyncCurl::Shutdown(void)
+{
+    FTRACE;
+
+    // monitor handlers take mLock, and RemoveTimer waits for a running
+    // one, so everything is taken out under the lock and torn down
+    // after it is released. handlers that get the lock from here on
+    // see mShutdown and leave the multi handle alone
+    int timer;
+    CURLM *multi;
+    std::set<curl_socket_t> sockets;
+    std::map<CURL *, AsyncCurlRequestPtr> active;
+    std::vector<CURL *> idleHandles;
+    {
+        AutoUnlockMutex lock(mLock);
+        if (mShutdown)
+            return;
+        mShutdown = true;
+
+        timer = mTimer;
+        mTimer = -1;
+        multi = mMulti;
+        mMulti = NULL;
+        sockets.swap(mSockets);
+        active.swap(mActive);
+        idleHandles.swap(mIdleHandles);
+    }
+
+    if (timer != -1)
+    {
+        mMonitor->RemoveTimer(timer);
+    }
+
+    foreach (curl_socket_t s, sockets)
+    {
+        try
+        {
+            mMonitor->RemoveFD(s);
+        }
+        catch (EEPollMonitor &e)
+        {
+            hlog(HLOG_WARN, "could not stop watching fd %d: %s",
+                 s, e.what());
+        }
+    }
+
+    std::vector<AsyncCurlRequestPtr> cancelled;
+    typedef std::pair<CURL *, AsyncCurlRequestPtr> ActivePair;
+    foreach (const ActivePair &a, active)
+    {
+        curl_multi_remove_handle(multi, a.first);
+        curl_easy_cleanup(a.first);
+        cancelled.push_back(a.second);
+    }
+
+    foreach (CURL *handle, idleHandles)
+    {
+        curl_easy_cleanup(handle);
+    }
+
+    // closes the cached connections
+    curl_multi_cleanup(multi);
+
+    foreach (const AsyncCurlRequestPtr &request, cancelled)
+    {
+        request->setException(boost::copy_exception(
+                                  EAsyncCurlShutdown(request->GetURL())));
+    }
+}
+
+int Forte::AsyncCurl::GetActiveCount(void) const
+{
+    AutoUnlockMutex lock(mLock);
+    return mActive.size();
+}
+
+int Forte::AsyncCurl::socketCallback(CURL *easy, curl_socket_t s, int what,
+                                     void *userp, void *socketp)
+{
+    static_cast<AsyncCurl *>(userp)->watchSocket(s, what);
+    return 0;
+}
+
+int Forte::AsyncCurl::timerCallback(CURLM *multi, long timeoutMs, void *userp)
+{
+    static_cast<AsyncCurl *>(userp)->setTimer(timeoutMs);
+    return 0;
+}
+
+void Forte::AsyncCurl::socketReady(const boost::weak_ptr<AsyncCurl> &client,
+                                   const struct epoll_event &ev)
+{
+    boost::shared_ptr<AsyncCurl> c(client.lock());
+    if (!c)
+        return;
+
+    int eventMask = 0;
+    if (ev.events & EPOLLIN)
+        eventMask |= CURL_CSELECT_IN;
+    if (ev.events & EPOLLOUT)
+        eventMask |= CURL_CSELECT_OUT;
+    if (ev.events & (EPOLLERR | EPOLLHUP))
+        eventMask |= CURL_CSELECT_ERR;
+    c->socketAction(ev.data.fd, eventMask);
+}
+
+void Forte::AsyncCurl::timerFired(const boost::weak_ptr<AsyncCurl> &client)
+{
+    boost::shared_ptr<AsyncCurl> c(client.lock());
+    if (c)
+        c->socketAction(CURL_SOCKET_TIMEOUT, 0);
+}
+
+void Forte::AsyncCurl::socketAction(curl_socket_t s, int eventMask)
+{
+    std::vector<Completion> completed;
+    {
+        AutoUnlockMutex lock(mLock);
+        if (mShutdown)
+            return;
+
+        int running;
+        CURLMcode rc = curl_multi_socket_action(mMulti, s, eventMask, &running);
+        if (rc != CURLM_OK)
+        {
+            hlog(HLOG_ERR, "curl_multi_socket_action(%d): %s",
+                 s, curl_multi_strerror(rc));
+        }
+        collectCompleted(completed);
+    }
+
+    // completion callbacks may start new requests
+    foreach (const Completion &completion, completed)
+    {
+        completion.mRequest->complete(completion.mResult,
+                                      completion.mResponseCode);
+    }
+}
+
+void Forte::AsyncCurl::watchSocket(curl_socket_t s, int what)
+{
+    // called by curl with mLock held, or by Shutdown() tearing down
+    // the multi handle once its sockets are no longer watched.
+    // exceptions must not unwind through curl, so failures are logged
+    // and the transfer is left to curl's timeouts
+    if (mShutdown)
+        return;
+
+    try
+    {
+        if (what == CURL_POLL_REMOVE)
+        {
+            if (mSockets.erase(s) > 0)
+                mMonitor->RemoveFD(s);
+            return;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.data.fd = s;
+        if (what & CURL_POLL_IN)
+            ev.events |= EPOLLIN;
+        if (what & CURL_POLL_OUT)
+            ev.events |= EPOLLOUT;
+
+        if (mSockets.insert(s).second)
+        {
+            mMonitor->AddFD(s, ev, boost::bind(&AsyncCurl::socketReady,
+                                               mSelf, _1));
+        }
+        else
+        {
+            mMonitor->ModFD(s, ev);
+        }
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "could not watch fd %d: %s", s, e.what());
+    }
+}
+
+void Forte::AsyncCurl::setTimer(long timeoutMs)
+{
+    // called by curl with mLock held, or by Shutdown() once the timer
+    // is gone
+    if (mTimer == -1)
+        return;
+
+    try
+    {
+        if (timeoutMs < 0)
+            mMonitor->CancelTimer(mTimer);
+        else
+            mMonitor->SetTimer(mTimer, Timespec::FromMillisec(timeoutMs));
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "could not set curl timer: %s", e.what());
+    }
+}
+
+void Forte::AsyncCurl::collectCompleted(std::vector<Completion> &completed)
+{
+    // called with mLock held
+    CURLMsg *msg;
+    int remaining;
+    while ((msg = curl_multi_info_read(mMulti, &remaining)) != NULL)
+    {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        CURL *handle = msg->easy_handle;
+        std::map<CURL *, AsyncCurlRequestPtr>::iterator i(mActive.find(handle));
+        if (i == mActive.end())
+        {
+            hlog(HLOG_ERR, "curl finished a transfer it was not given");
+            continue;
+        }
+
+        Completion completion;
+        completion.mRequest = i->second;
+        completion.mResult = msg->data.result;
+        completion.mResponseCode = 0;
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE,
+                          &completion.mResponseCode);
+        completed.push_back(completion);
+
+        mActive.erase(i);
+        // msg is not valid past this point
+        curl_multi_remove_handle(mMulti, handle);
+        releaseHandle(handle);
+    }
+}
+
+CURL * Forte::AsyncCurl::getHandle(void)
+{
+    // called with mLock held
+    if (!mIdleHandles.empty())
+    {
+        CURL *handle = mIdleHandles.back();
+        mIdleHandles.pop_back();
+        return handle;
+    }
+
+    CURL *handle = curl_easy_init();
+    if (handle == NULL)
+    {
+        hlog_and_throw(HLOG_ERR, EAsyncCurlInit());
+    }
+    return handle;
+}
+
+void Forte::AsyncCurl::releaseHandle(CURL *handle)
+{
+    // called with mLock held. the connection stays in the multi
+    // handle's cache, and a reset handle holds no pointers into the
+    // request it ran
+    curl_easy_reset(handle);
+    mIdleHandles.push_back(handle);
+}
+
+#endif  // FORTE_NO_CURL
@@ -0,0 +1,184 @@
+#ifndef __forte_AsyncCurl_h
+#define __forte_AsyncCurl_h
+#ifndef FORTE_NO_CURL
+
+#include "AsyncTask.h"
+#include "AutoMutex.h"
+#include "EPollMonitor.h"
+#include "Exception.h"
+#include "FString.h"
+#include "Object.h"
+#include <curl/curl.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * AsyncCurl runs many HTTP requests at once on the threads of an
+ * EPollMonitor, through one curl multi handle: curl's sockets are
+ * watched in the monitor's epoll set and curl's timeouts run on a
+ * monitor timer, so no thread blocks on a transfer. Finished easy
+ * handles are kept for the next request, and the multi handle keeps
+ * their connections open, so repeated requests to the same host reuse
+ * a connection instead of paying for a new handshake.
+ *
+ * As with Curl, the application must call curl_global_init() (or
+ * Curl::Init()) before creating an AsyncCurl.
+ */
+
+namespace Forte
+{
+    EXCEPTION_CLASS(EAsyncCurl);
+    EXCEPTION_SUBCLASS2(EAsyncCurl, EAsyncCurlInit,
+                        "Could not initialize curl");
+    EXCEPTION_SUBCLASS2(EAsyncCurl, EAsyncCurlShutdown,
+                        "HTTP client is shut down");
+    EXCEPTION_SUBCLASS2(EAsyncCurl, EAsyncCurlRequestStarted,
+                        "HTTP request was already started");
+    EXCEPTION_SUBCLASS2(EAsyncCurl, EAsyncCurlTransfer,
+                        "HTTP transfer failed");
+    EXCEPTION_SUBCLASS2(EAsyncCurl, EAsyncCurlHTTPError,
+                        "HTTP request failed");
+
+    class AsyncCurl;
+
+    /**
+     * AsyncCurlRequest is one HTTP request. Configure it, then call
+     * Begin(); the result is the HTTP response code. A failed transfer
+     * completes with EAsyncCurlTransfer, and a response code of 400 or
+     * more completes with EAsyncCurlHTTPError if SetThrowOnHTTPError()
+     * was called. Settings made after Begin() have no effect.
+     */
+    class AsyncCurlRequest : public AsyncTask<long>
+    {
+        friend class AsyncCurl;
+    public:
+        /**
+         * A BodyCallback is given the response body as it arrives. It
+         * runs on a monitor thread and must not block or call into the
+         * AsyncCurl. Returning false aborts the transfer.
+         */
+        typedef boost::function<bool(const char *data, size_t len)> BodyCallback;
+
+        AsyncCurlRequest(const boost::shared_ptr<AsyncCurl> &client,
+                         const FString &url);
+        virtual ~AsyncCurlRequest();
+
+        void SetPostFields(const FString &postFields);
+        void AddHeader(const FString &header);
+        void SetBodyCallback(const BodyCallback &callback);
+        void SetFollowRedirects(bool follow = true);
+        void SetConnectTimeout(long timeout);
+        void SetMaxTransferTime(long maxXferTime);
+        void SetThrowOnHTTPError(bool shouldThrow = true);
+
+        /**
+         * Begin() hands the request to the client and returns at once.
+         *
+         * @throws EAsyncCurlShutdown if the client is gone or shut down
+         * @throws EAsyncCurlRequestStarted if Begin() was already called
+         */
+        virtual void Begin(void);
+
+        const FString & GetURL(void) const { return mURL; }
+
+        /**
+         * GetBody() returns the response body of a completed request
+         * that had no body callback.
+         */
+        const FString & GetBody(void) const { return mBody; }
+
+    private:
+        void configure(CURL *handle);
+        void complete(CURLcode result, long responseCode);
+        static size_t write(void *buffer, size_t size, size_t nmemb,
+                            void *userp);
+
+        boost::weak_ptr<AsyncCurl> mClient;
+        const FString mURL;
+        bool mPost;
+        FString mPostFields;
+        struct curl_slist *mHeaders;
+        BodyCallback mBodyCallback;
+        bool mFollowRedirects;
+        long mConnectTimeout;
+        long mMaxTransferTime;
+        bool mThrowOnHTTPError;
+        bool mStarted;
+        FString mBody;
+        char mErrorBuffer[CURL_ERROR_SIZE + 1];
+    };
+    typedef boost::shared_ptr<AsyncCurlRequest> AsyncCurlRequestPtr;
+
+    class AsyncCurl : public Object
+    {
+    public:
+        /**
+         * The client runs on monitor, which the caller starts and
+         * shuts down. maxConnections limits the connections kept open
+         * for reuse; 0 leaves curl's default.
+         */
+        AsyncCurl(const boost::shared_ptr<EPollMonitor> &monitor,
+                  long maxConnections = 0);
+        virtual ~AsyncCurl();
+
+        /**
+         * Start() runs request. Same as request->Begin() for a request
+         * made for this client.
+         */
+        void Start(const AsyncCurlRequestPtr &request);
+
+        /**
+         * Shutdown() completes every running request with
+         * EAsyncCurlShutdown and closes all connections. Later requests
+         * are refused.
+         */
+        void Shutdown(void);
+
+        /**
+         * GetActiveCount() returns the number of requests in progress.
+         */
+        int GetActiveCount(void) const;
+
+    private:
+        struct Completion
+        {
+            AsyncCurlRequestPtr mRequest;
+            CURLcode mResult;
+            long mResponseCode;
+        };
+
+        static int socketCallback(CURL *easy, curl_socket_t s, int what,
+                                  void *userp, void *socketp);
+        static int timerCallback(CURLM *multi, long timeoutMs, void *userp);
+        static void socketReady(const boost::weak_ptr<AsyncCurl> &client,
+                                const struct epoll_event &ev);
+        static void timerFired(const boost::weak_ptr<AsyncCurl> &client);
+
+        void socketAction(curl_socket_t s, int eventMask);
+        void watchSocket(curl_socket_t s, int what);
+        void setTimer(long timeoutMs);
+        void collectCompleted(std::vector<Completion> &completed);
+        CURL * getHandle(void);
+        void releaseHandle(CURL *handle);
+
+        boost::shared_ptr<EPollMonitor> mMonitor;
+        boost::weak_ptr<AsyncCurl> mSelf;
+
+        // guards everything below, and every call on mMulti until
+        // Shutdown() takes it out
+        mutable Mutex mLock;
+        CURLM *mMulti;
+        int mTimer;
+        bool mShutdown;
+        std::set<curl_socket_t> mSockets;
+        std::map<CURL *, AsyncCurlRequestPtr> mActive;
+        std::vector<CURL *> mIdleHandles;
+    };
+    typedef boost::shared_ptr<AsyncCurl> AsyncCurlPtr;
+};
+#endif // FORTE_NO_CURL
+#endif // __forte_AsyncCurl_h
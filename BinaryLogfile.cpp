@@ -0,0 +1,1107 @@
+#include "BinaryLogfile.h"
+#include "Foreach.h"
+#include "FTrace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <algorithm>
+
+using namespace Forte;
+
+namespace
+{
+    const char sMagic[] = "FORTEBL\1";
+    const size_t sMagicLen = 8;
+    const unsigned int sVersion = 1;
+
+    enum RecordType {
+        RECORD_END = 0, // preallocated, not yet written
+        RECORD_SEGMENT = 1,
+        RECORD_LOCATION = 2,
+        RECORD_FORMAT = 3,
+        RECORD_THREAD = 4,
+        RECORD_TEXT = 5,
+        RECORD_ARGS = 6
+    };
+
+    // type byte plus the longest length varint
+    const size_t sMaxRecordHeader = 11;
+
+    void putVarint(std::string &out, unsigned long long v)
+    {
+        while (v >= 0x80)
+        {
+            out += static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        out += static_cast<char>(v);
+    }
+
+    void putSVarint(std::string &out, long long v)
+    {
+        putVarint(out, (static_cast<unsigned long long>(v) << 1) ^
+                  static_cast<unsigned long long>(v >> 63));
+    }
+
+    void putString(std::string &out, const char *s, size_t len)
+    {
+        putVarint(out, len);
+        out.append(s, len);
+    }
+
+    void putString(std::string &out, const std::string &s)
+    {
+        putString(out, s.data(), s.size());
+    }
+
+    // bounds checked reading of one record's payload
+    class Cursor
+    {
+    public:
+        Cursor(const char *p, const char *end) : mP(p), mEnd(end), mOK(true) {}
+
+        unsigned long long Varint(void) {
+            unsigned long long v(0);
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (mP >= mEnd)
+                    break;
+                const unsigned char b(*mP++);
+                v |= static_cast<unsigned long long>(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return v;
+            }
+            mOK = false;
+            return 0;
+        }
+
+        long long SVarint(void) {
+            const unsigned long long v(Varint());
+            return static_cast<long long>(v >> 1) ^ -static_cast<long long>(v & 1);
+        }
+
+        unsigned char Byte(void) {
+            if (mP >= mEnd)
+            {
+                mOK = false;
+                return 0;
+            }
+            return *mP++;
+        }
+
+        bool Bytes(size_t len, const char *&bytes) {
+            if (static_cast<size_t>(mEnd - mP) < len)
+            {
+                mOK = false;
+                return false;
+            }
+            bytes = mP;
+            mP += len;
+            return true;
+        }
+
+        FString String(void) {
+            const size_t len(Varint());
+            const char *bytes;
+            if (!mOK || !Bytes(len, bytes))
+                return FString();
+            return FString(std::string(bytes, len));
+        }
+
+        bool OK(void) const { return mOK; }
+        bool AtEnd(void) const { return mP >= mEnd; }
+
+    private:
+        const char *mP;
+        const char *mEnd;
+        bool mOK;
+    };
+
+    // one conversion of a printf format
+    struct FormatSpec
+    {
+        enum Kind {
+            LITERAL_PERCENT,
+            SIGNED,
+            UNSIGNED,
+            CHAR,
+            DOUBLE,
+            STRING,
+            POINTER
+        };
+        enum Length {
+            LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_BIG_L
+        };
+
+        Kind mKind;
+        Length mLength;
+        std::string mFlags;
+        bool mWidthStar;
+        std::string mWidth;
+        bool mHasPrecision;
+        bool mPrecisionStar;
+        std::string mPrecision;
+        char mConversion;
+    };
+
+    // parse the conversion starting after the '%' at p. returns the
+    // end of the conversion, or NULL if the arguments can not be
+    // stored and the message has to be kept as text
+    const char * parseSpec(const char *p, FormatSpec &spec)
+    {
+        spec.mFlags.clear();
+        spec.mWidth.clear();
+        spec.mPrecision.clear();
+        spec.mWidthStar = false;
+        spec.mHasPrecision = false;
+        spec.mPrecisionStar = false;
+        spec.mLength = FormatSpec::LEN_NONE;
+
+        if (*p == '%')
+        {
+            spec.mKind = FormatSpec::LITERAL_PERCENT;
+            spec.mConversion = '%';
+            return p + 1;
+        }
+
+        while (*p && strchr("-+ #0'I", *p))
+            spec.mFlags += *p++;
+
+        if (*p == '*')
+        {
+            spec.mWidthStar = true;
+            ++p;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9')
+                spec.mWidth += *p++;
+        }
+        // positional arguments
+        if (*p == '$')
+            return NULL;
+
+        if (*p == '.')
+        {
+            spec.mHasPrecision = true;
+            ++p;
+            if (*p == '*')
+            {
+                spec.mPrecisionStar = true;
+                ++p;
+            }
+            else
+            {
+                while (*p >= '0' && *p <= '9')
+                    spec.mPrecision += *p++;
+            }
+        }
+
+        switch (*p)
+        {
+        case 'h':
+            ++p;
+            if (*p == 'h')
+            {
+                ++p;
+                spec.mLength = FormatSpec::LEN_HH;
+            }
+            else
+                spec.mLength = FormatSpec::LEN_H;
+            break;
+        case 'l':
+            ++p;
+            if (*p == 'l')
+            {
+                ++p;
+                spec.mLength = FormatSpec::LEN_LL;
+            }
+            else
+                spec.mLength = FormatSpec::LEN_L;
+            break;
+        case 'q':
+            ++p;
+            spec.mLength = FormatSpec::LEN_LL;
+            break;
+        case 'L':
+            ++p;
+            spec.mLength = FormatSpec::LEN_BIG_L;
+            break;
+        case 'j':
+            ++p;
+            spec.mLength = FormatSpec::LEN_J;
+            break;
+        case 'z':
+        case 'Z':
+            ++p;
+            spec.mLength = FormatSpec::LEN_Z;
+            break;
+        case 't':
+            ++p;
+            spec.mLength = FormatSpec::LEN_T;
+            break;
+        }
+
+        spec.mConversion = *p;
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+            spec.mKind = FormatSpec::SIGNED;
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            spec.mKind = FormatSpec::UNSIGNED;
+            break;
+        case 'c':
+            if (spec.mLength != FormatSpec::LEN_NONE)
+                return NULL;
+            spec.mKind = FormatSpec::CHAR;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (spec.mLength == FormatSpec::LEN_BIG_L)
+                return NULL;
+            spec.mKind = FormatSpec::DOUBLE;
+            break;
+        case 's':
+            if (spec.mLength != FormatSpec::LEN_NONE)
+                return NULL;
+            spec.mKind = FormatSpec::STRING;
+            break;
+        case 'p':
+            spec.mKind = FormatSpec::POINTER;
+            break;
+        default:
+            // %m depends on errno, %n writes through its argument
+            return NULL;
+        }
+        if ((spec.mKind == FormatSpec::SIGNED ||
+             spec.mKind == FormatSpec::UNSIGNED) &&
+            spec.mLength == FormatSpec::LEN_BIG_L)
+        {
+            return NULL;
+        }
+        return p + 1;
+    }
+
+    // store the arguments fmt consumes from ap. returns false if
+    // the format has a conversion that can not be stored
+    bool encodeArgs(const char *fmt, va_list ap, std::string &out)
+    {
+        FormatSpec spec;
+        for (const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%'))
+        {
+            p = parseSpec(p + 1, spec);
+            if (p == NULL)
+                return false;
+
+            int precision(-1);
+            if (spec.mWidthStar)
+                putSVarint(out, va_arg(ap, int));
+            if (spec.mPrecisionStar)
+            {
+                precision = va_arg(ap, int);
+                putSVarint(out, precision);
+            }
+            else if (spec.mHasPrecision)
+            {
+                precision = atoi(spec.mPrecision.c_str());
+            }
+
+            switch (spec.mKind)
+            {
+            case FormatSpec::LITERAL_PERCENT:
+                break;
+            case FormatSpec::SIGNED:
+                switch (spec.mLength)
+                {
+                case FormatSpec::LEN_HH:
+                    putSVarint(out, static_cast<signed char>(va_arg(ap, int)));
+                    break;
+                case FormatSpec::LEN_H:
+                    putSVarint(out, static_cast<short>(va_arg(ap, int)));
+                    break;
+                case FormatSpec::LEN_L:
+                    putSVarint(out, va_arg(ap, long));
+                    break;
+                case FormatSpec::LEN_LL:
+                    putSVarint(out, va_arg(ap, long long));
+                    break;
+                case FormatSpec::LEN_J:
+                    putSVarint(out, va_arg(ap, intmax_t));
+                    break;
+                case FormatSpec::LEN_Z:
+                    putSVarint(out, va_arg(ap, ssize_t));
+                    break;
+                case FormatSpec::LEN_T:
+                    putSVarint(out, va_arg(ap, ptrdiff_t));
+                    break;
+                default:
+                    putSVarint(out, va_arg(ap, int));
+                    break;
+                }
+                break;
+            case FormatSpec::UNSIGNED:
+                switch (spec.mLength)
+                {
+                case FormatSpec::LEN_HH:
+                    putVarint(out, static_cast<unsigned char>(va_arg(ap, unsigned int)));
+                    break;
+                case FormatSpec::LEN_H:
+                    putVarint(out, static_cast<unsigned short>(va_arg(ap, unsigned int)));
+                    break;
+                case FormatSpec::LEN_L:
+                    putVarint(out, va_arg(ap, unsigned long));
+                    break;
+                case FormatSpec::LEN_LL:
+                    putVarint(out, va_arg(ap, unsigned long long));
+                    break;
+                case FormatSpec::LEN_J:
+                    putVarint(out, va_arg(ap, uintmax_t));
+                    break;
+                case FormatSpec::LEN_Z:
+                    putVarint(out, va_arg(ap, size_t));
+                    break;
+                case FormatSpec::LEN_T:
+                    putVarint(out, static_cast<unsigned long long>(va_arg(ap, ptrdiff_t)));
+                    break;
+                default:
+                    putVarint(out, va_arg(ap, unsigned int));
+                    break;
+                }
+                break;
+            case FormatSpec::CHAR:
+                putSVarint(out, va_arg(ap, int));
+                break;
+            case FormatSpec::DOUBLE:
+            {
+                const double d(va_arg(ap, double));
+                out.append(reinterpret_cast<const char *>(&d), sizeof(d));
+                break;
+            }
+            case FormatSpec::STRING:
+            {
+                // 0 is a NULL pointer, otherwise the length plus one.
+                // with a precision the string need not be terminated
+                const char *s(va_arg(ap, const char *));
+                if (s == NULL)
+                {
+                    putVarint(out, 0);
+                }
+                else
+                {
+                    const size_t len(precision >= 0
+                                     ? strnlen(s, precision) : strlen(s));
+                    putVarint(out, len + 1);
+                    out.append(s, len);
+                }
+                break;
+            }
+            case FormatSpec::POINTER:
+                putVarint(out, reinterpret_cast<uintptr_t>(va_arg(ap, void *)));
+                break;
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    void appendFormatted(FString &out, const std::string &spec, T value)
+    {
+        char buf[128];
+        const int len(snprintf(buf, sizeof(buf), spec.c_str(), value));
+        if (len < 0)
+            return;
+        if (static_cast<size_t>(len) < sizeof(buf))
+        {
+            out.append(buf, len);
+            return;
+        }
+        std::vector<char> big(len + 1);
+        snprintf(&big[0], big.size(), spec.c_str(), value);
+        out.append(&big[0], len);
+    }
+
+    // the inverse of encodeArgs()
+    bool decodeArgs(const char *fmt, Cursor &in, FString &out)
+    {
+        FormatSpec spec;
+        std::string conversion;
+        const char *p(fmt);
+        const char *percent;
+        while ((percent = strchr(p, '%')) != NULL)
+        {
+            out.append(p, percent - p);
+            p = parseSpec(percent + 1, spec);
+            if (p == NULL)
+                return false;
+
+            if (spec.mKind == FormatSpec::LITERAL_PERCENT)
+            {
+                out += '%';
+                continue;
+            }
+
+            // rebuild the conversion with the stored width and
+            // precision and the integer length of what was stored
+            conversion = "%" + spec.mFlags;
+            if (spec.mWidthStar)
+            {
+                const long long width(in.SVarint());
+                if (width < 0)
+                    conversion += '-';
+                conversion += FString(FStringFC(), "%lld",
+                                      width < 0 ? -width : width);
+            }
+            else
+            {
+                conversion += spec.mWidth;
+            }
+            if (spec.mPrecisionStar)
+            {
+                const long long precision(in.SVarint());
+                if (precision >= 0)
+                    conversion += FString(FStringFC(), ".%lld", precision);
+            }
+            else if (spec.mHasPrecision)
+            {
+                conversion += "." + spec.mPrecision;
+            }
+
+            switch (spec.mKind)
+            {
+            case FormatSpec::SIGNED:
+                conversion += "ll";
+                conversion += spec.mConversion;
+                appendFormatted(out, conversion, in.SVarint());
+                break;
+            case FormatSpec::UNSIGNED:
+                conversion += "ll";
+                conversion += spec.mConversion;
+                appendFormatted(out, conversion, in.Varint());
+                break;
+            case FormatSpec::CHAR:
+                conversion += spec.mConversion;
+                appendFormatted(out, conversion, static_cast<int>(in.SVarint()));
+                break;
+            case FormatSpec::DOUBLE:
+            {
+                const char *bytes;
+                double d(0);
+                if (in.Bytes(sizeof(d), bytes))
+                    memcpy(&d, bytes, sizeof(d));
+                conversion += spec.mConversion;
+                appendFormatted(out, conversion, d);
+                break;
+            }
+            case FormatSpec::STRING:
+            {
+                const unsigned long long stored(in.Varint());
+                conversion += spec.mConversion;
+                if (stored == 0)
+                {
+                    appendFormatted(out, conversion, static_cast<const char *>(NULL));
+                }
+                else
+                {
+                    const char *bytes;
+                    if (in.Bytes(stored - 1, bytes))
+                    {
+                        const std::string s(bytes, stored - 1);
+                        appendFormatted(out, conversion, s.c_str());
+                    }
+                }
+                break;
+            }
+            case FormatSpec::POINTER:
+                conversion += spec.mConversion;
+                appendFormatted(out, conversion,
+                                reinterpret_cast<void *>(
+                                    static_cast<uintptr_t>(in.Varint())));
+                break;
+            default:
+                break;
+            }
+
+            if (!in.OK())
+                return false;
+        }
+        out.append(p);
+        return in.AtEnd();
+    }
+
+    void messageHeader(std::string &out, const LogMsg &msg,
+                       const struct timespec &segmentMonotonic,
+                       unsigned int thread, unsigned int location)
+    {
+        struct timespec mono(msg.mMonotonicTime);
+        if (mono.tv_sec == 0 && mono.tv_nsec == 0)
+            clock_gettime(CLOCK_MONOTONIC, &mono);
+        putSVarint(out,
+                   (mono.tv_sec - segmentMonotonic.tv_sec) * 1000000000LL +
+                   (mono.tv_nsec - segmentMonotonic.tv_nsec));
+        out += static_cast<char>(__builtin_ffs(msg.mLevel & HLOG_ALL));
+        putVarint(out, thread);
+        putVarint(out, location);
+        putVarint(out, msg.mDepth);
+        putString(out, msg.mPrefix);
+    }
+}
+
+// BinaryLogfile
+BinaryLogfile::BinaryLogfile(const FString &path,
+                             unsigned int logMask,
+                             size_t mapChunkSize)
+    : Logfile("//binary/" + path, NULL, logMask, false),
+      mFilePath(path),
+      mMapChunkSize(mapChunkSize),
+      mPageSize(sysconf(_SC_PAGESIZE)),
+      mFD(-1),
+      mMap(NULL),
+      mMapOffset(0),
+      mMapSize(0),
+      mOffset(0)
+{
+    AutoUnlockMutex lock(mWriteLock);
+    open();
+}
+
+BinaryLogfile::~BinaryLogfile()
+{
+    AutoUnlockMutex lock(mWriteLock);
+    close();
+}
+
+void BinaryLogfile::open(void)
+{
+    mFD = ::open(mFilePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (mFD == -1)
+        return;
+
+    struct stat st;
+    if (fstat(mFD, &st) != 0 || !findEnd(st.st_size))
+    {
+        ::close(mFD);
+        mFD = -1;
+        return;
+    }
+
+    // drop whatever a crashed writer left past the last whole record
+    if (static_cast<size_t>(st.st_size) > mOffset &&
+        ftruncate(mFD, mOffset) != 0)
+    {
+        ::close(mFD);
+        mFD = -1;
+        return;
+    }
+
+    if (mOffset == 0)
+    {
+        if (!reserve(sMagicLen))
+        {
+            close();
+            return;
+        }
+        memcpy(mMap + (mOffset - mMapOffset), sMagic, sMagicLen);
+        mOffset += sMagicLen;
+    }
+    writeSegment();
+}
+
+void BinaryLogfile::close(void)
+{
+    if (mMap != NULL)
+    {
+        munmap(mMap, mMapSize);
+        mMap = NULL;
+    }
+    if (mFD != -1)
+    {
+        // give back the preallocated tail
+        if (ftruncate(mFD, mOffset) != 0)
+        {
+            // nothing to do about it, readers stop at the zeros
+        }
+        ::close(mFD);
+        mFD = -1;
+    }
+}
+
+bool BinaryLogfile::findEnd(size_t size)
+{
+    mOffset = 0;
+    if (size == 0)
+        return true;
+    if (size < sMagicLen)
+        return false;
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, mFD, 0);
+    if (map == MAP_FAILED)
+        return false;
+    const char *data(static_cast<const char *>(map));
+
+    bool ours(memcmp(data, sMagic, sMagicLen) == 0);
+    if (ours)
+    {
+        size_t offset(sMagicLen);
+        while (offset < size && data[offset] != RECORD_END)
+        {
+            Cursor in(data + offset + 1, data + size);
+            const unsigned long long len(in.Varint());
+            const char *payload;
+            if (!in.OK() || !in.Bytes(len, payload))
+                break;
+            offset = (payload + len) - data;
+        }
+        mOffset = offset;
+    }
+    munmap(map, size);
+    return ours;
+}
+
+bool BinaryLogfile::reserve(size_t len)
+{
+    if (mFD == -1)
+        return false;
+    if (mMap != NULL && mOffset + len <= mMapOffset + mMapSize)
+        return true;
+
+    if (mMap != NULL)
+    {
+        munmap(mMap, mMapSize);
+        mMap = NULL;
+    }
+
+    // map from the page holding the write offset, at least a chunk
+    const size_t mapOffset(mOffset & ~(mPageSize - 1));
+    size_t mapSize(std::max(mMapChunkSize, mOffset - mapOffset + len));
+    mapSize = (mapSize + mPageSize - 1) & ~(mPageSize - 1);
+
+    // allocate the blocks now so a full disk is an error here rather
+    // than a SIGBUS when the page is written
+    if (posix_fallocate(mFD, mapOffset, mapSize) != 0)
+        return false;
+
+    void *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     mFD, mapOffset);
+    if (map == MAP_FAILED)
+        return false;
+
+    mMap = static_cast<char *>(map);
+    mMapOffset = mapOffset;
+    mMapSize = mapSize;
+    return true;
+}
+
+void BinaryLogfile::appendRecord(int type, const std::string& payload)
+{
+    char header[sMaxRecordHeader];
+    size_t headerLen(0);
+    header[headerLen++] = static_cast<char>(type);
+    unsigned long long len(payload.size());
+    while (len >= 0x80)
+    {
+        header[headerLen++] = static_cast<char>((len & 0x7f) | 0x80);
+        len >>= 7;
+    }
+    header[headerLen++] = static_cast<char>(len);
+
+    if (!reserve(headerLen + payload.size()))
+        return;
+
+    // the payload goes in first, so a reader never sees a type byte
+    // in front of a record that is not all there
+    char *dest(mMap + (mOffset - mMapOffset));
+    memcpy(dest + headerLen, payload.data(), payload.size());
+    memcpy(dest + 1, header + 1, headerLen - 1);
+    __sync_synchronize();
+    dest[0] = header[0];
+    mOffset += headerLen + payload.size();
+}
+
+void BinaryLogfile::writeSegment(void)
+{
+    mLocations.clear();
+    mThreads.clear();
+    mFormats.clear();
+    mFormatAddresses.clear();
+    mFormatsById.clear();
+
+    struct timeval wall;
+    gettimeofday(&wall, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &mSegmentMonotonic);
+
+    char host[128];
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "(hostname too long)");
+    host[sizeof(host) - 1] = 0;
+
+    mDefinition.clear();
+    putVarint(mDefinition, sVersion);
+    putVarint(mDefinition, getpid());
+    putString(mDefinition, host, strlen(host));
+    putVarint(mDefinition, wall.tv_sec);
+    putVarint(mDefinition, wall.tv_usec);
+    putVarint(mDefinition, mSegmentMonotonic.tv_sec);
+    putVarint(mDefinition, mSegmentMonotonic.tv_nsec);
+    appendRecord(RECORD_SEGMENT, mDefinition);
+}
+
+unsigned int BinaryLogfile::internLocation(const LogMsg& msg)
+{
+    mKey.assign(msg.mFile);
+    mKey += '\0';
+    mKey += msg.mFunction;
+    mKey += '\0';
+    mKey.append(reinterpret_cast<const char *>(&msg.mLine), sizeof(msg.mLine));
+
+    std::map<std::string, unsigned int>::iterator i(mLocations.find(mKey));
+    if (i != mLocations.end())
+        return i->second;
+
+    const unsigned int id(mLocations.size() + 1);
+    mLocations[mKey] = id;
+
+    mDefinition.clear();
+    putVarint(mDefinition, id);
+    putString(mDefinition, msg.mFile);
+    putString(mDefinition, msg.mFunction);
+    putSVarint(mDefinition, msg.mLine);
+    appendRecord(RECORD_LOCATION, mDefinition);
+    return id;
+}
+
+unsigned int BinaryLogfile::internThread(const LogMsg& msg)
+{
+    unsigned int threadID(msg.mThreadID);
+    const FString *threadName(&msg.mThreadName);
+    if (msg.mThread)
+    {
+        threadID = msg.mThread->GetThreadID();
+        threadName = &msg.mThread->mThreadName;
+    }
+
+    mKey.assign(reinterpret_cast<const char *>(&msg.mPID), sizeof(msg.mPID));
+    mKey.append(reinterpret_cast<const char *>(&threadID), sizeof(threadID));
+    mKey += *threadName;
+
+    std::map<std::string, unsigned int>::iterator i(mThreads.find(mKey));
+    if (i != mThreads.end())
+        return i->second;
+
+    const unsigned int id(mThreads.size() + 1);
+    mThreads[mKey] = id;
+
+    mDefinition.clear();
+    putVarint(mDefinition, id);
+    putVarint(mDefinition, msg.mPID);
+    putVarint(mDefinition, threadID);
+    putString(mDefinition, *threadName);
+    appendRecord(RECORD_THREAD, mDefinition);
+    return id;
+}
+
+unsigned int BinaryLogfile::internFormat(const char *fmt)
+{
+    // formats are almost always literals, so check the address
+    // before building a string out of it
+    std::map<const char *, unsigned int>::iterator a(mFormatAddresses.find(fmt));
+    if (a != mFormatAddresses.end() &&
+        strcmp(mFormatsById[a->second - 1]->c_str(), fmt) == 0)
+    {
+        return a->second;
+    }
+
+    mKey.assign(fmt);
+    std::map<std::string, unsigned int>::iterator i(mFormats.find(mKey));
+    if (i == mFormats.end())
+    {
+        const unsigned int id(mFormats.size() + 1);
+        i = mFormats.insert(std::make_pair(mKey, id)).first;
+        mFormatsById.push_back(&i->first);
+
+        mDefinition.clear();
+        putVarint(mDefinition, id);
+        putString(mDefinition, mKey);
+        appendRecord(RECORD_FORMAT, mDefinition);
+    }
+    mFormatAddresses[fmt] = i->second;
+    return i->second;
+}
+
+void BinaryLogfile::writeMsg(const LogMsg& msg)
+{
+    if (mFD == -1)
+        return;
+
+    const unsigned int location(internLocation(msg));
+    const unsigned int thread(internThread(msg));
+
+    mPayload.clear();
+    messageHeader(mPayload, msg, mSegmentMonotonic, thread, location);
+
+    if (msg.mFormat != NULL && msg.mArgs != NULL)
+    {
+        mArgs.clear();
+        va_list ap;
+        va_copy(ap, *msg.mArgs);
+        const bool encoded(encodeArgs(msg.mFormat, ap, mArgs));
+        va_end(ap);
+        if (encoded)
+        {
+            putVarint(mPayload, internFormat(msg.mFormat));
+            mPayload += mArgs;
+            appendRecord(RECORD_ARGS, mPayload);
+            return;
+        }
+    }
+
+    putString(mPayload, msg.mMsg);
+    appendRecord(RECORD_TEXT, mPayload);
+}
+
+void BinaryLogfile::Write(const LogMsg& msg)
+{
+    AutoUnlockMutex lock(mWriteLock);
+    writeMsg(msg);
+}
+
+void BinaryLogfile::WriteBatch(const std::vector<const LogMsg*>& msgs)
+{
+    AutoUnlockMutex lock(mWriteLock);
+    foreach (const LogMsg* msg, msgs)
+        writeMsg(*msg);
+}
+
+// BinaryLogReader
+BinaryLogReader::BinaryLogReader(const FString &path)
+    : mPath(path),
+      mFD(-1),
+      mMap(NULL),
+      mSize(0),
+      mOffset(sMagicLen),
+      mUndecodable(0),
+      mSegmentPID(0)
+{
+    mSegmentWall.tv_sec = 0;
+    mSegmentWall.tv_usec = 0;
+    mSegmentMonotonic.tv_sec = 0;
+    mSegmentMonotonic.tv_nsec = 0;
+
+    mFD = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFD == -1)
+    {
+        hlog_and_throw(HLOG_ERR, EBinaryLogfileOpen(
+                           FStringFC(), "%s: %s", path.c_str(),
+                           strerror(errno)));
+    }
+
+    struct stat st;
+    if (fstat(mFD, &st) != 0)
+    {
+        const int err(errno);
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EBinaryLogfileOpen(
+                           FStringFC(), "%s: %s", path.c_str(), strerror(err)));
+    }
+    mSize = st.st_size;
+
+    if (mSize > 0)
+    {
+        void *map = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mFD, 0);
+        if (map == MAP_FAILED)
+        {
+            const int err(errno);
+            ::close(mFD);
+            hlog_and_throw(HLOG_ERR, EBinaryLogfileOpen(
+                               FStringFC(), "%s: %s", path.c_str(),
+                               strerror(err)));
+        }
+        mMap = static_cast<const char *>(map);
+        madvise(const_cast<char *>(mMap), mSize, MADV_SEQUENTIAL);
+    }
+
+    if (mSize < sMagicLen || memcmp(mMap, sMagic, sMagicLen) != 0)
+    {
+        if (mMap != NULL)
+            munmap(const_cast<char *>(mMap), mSize);
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EBinaryLogfileFormat(path));
+    }
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+    if (mMap != NULL)
+        munmap(const_cast<char *>(mMap), mSize);
+    if (mFD != -1)
+        ::close(mFD);
+}
+
+bool BinaryLogReader::Next(LogMsg &msg)
+{
+    while (mOffset < mSize && mMap[mOffset] != RECORD_END)
+    {
+        const int type(static_cast<unsigned char>(mMap[mOffset]));
+        Cursor in(mMap + mOffset + 1, mMap + mSize);
+        const unsigned long long len(in.Varint());
+        const char *payload;
+        if (!in.OK() || !in.Bytes(len, payload))
+            return false;
+        const char *end(payload + len);
+        mOffset = end - mMap;
+
+        Cursor record(payload, end);
+        switch (type)
+        {
+        case RECORD_SEGMENT:
+            readSegment(payload, end);
+            break;
+        case RECORD_LOCATION:
+        {
+            const unsigned int id(record.Varint());
+            Location &location(mLocations[id]);
+            location.mFile = record.String();
+            location.mFunction = record.String();
+            location.mLine = record.SVarint();
+            break;
+        }
+        case RECORD_FORMAT:
+        {
+            const unsigned int id(record.Varint());
+            mFormats[id] = record.String();
+            break;
+        }
+        case RECORD_THREAD:
+        {
+            const unsigned int id(record.Varint());
+            ThreadInfo &thread(mThreads[id]);
+            thread.mPID = record.Varint();
+            thread.mThreadID = record.Varint();
+            thread.mThreadName = record.String();
+            break;
+        }
+        case RECORD_TEXT:
+        case RECORD_ARGS:
+            if (readMsg(type, payload, end, msg))
+                return true;
+            break;
+        default:
+            // written by a newer version
+            break;
+        }
+    }
+    return false;
+}
+
+void BinaryLogReader::readSegment(const char *p, const char *end)
+{
+    Cursor in(p, end);
+    in.Varint(); // version
+    mSegmentPID = in.Varint();
+    mSegmentHost = in.String();
+    mSegmentWall.tv_sec = in.Varint();
+    mSegmentWall.tv_usec = in.Varint();
+    mSegmentMonotonic.tv_sec = in.Varint();
+    mSegmentMonotonic.tv_nsec = in.Varint();
+
+    mLocations.clear();
+    mThreads.clear();
+    mFormats.clear();
+}
+
+bool BinaryLogReader::readMsg(int type, const char *p, const char *end,
+                              LogMsg &msg)
+{
+    Cursor in(p, end);
+    const long long offsetNsec(in.SVarint());
+    const int levelBit(in.Byte());
+    const unsigned int thread(in.Varint());
+    const unsigned int location(in.Varint());
+    msg.mDepth = in.Varint();
+    msg.mPrefix = in.String();
+    if (!in.OK())
+        return false;
+
+    // wall clock of the segment start moved by the monotonic offset
+    const long long usec(mSegmentWall.tv_sec * 1000000LL +
+                         mSegmentWall.tv_usec + offsetNsec / 1000);
+    msg.mTime.tv_sec = usec / 1000000;
+    msg.mTime.tv_usec = usec % 1000000;
+    const long long nsec(mSegmentMonotonic.tv_sec * 1000000000LL +
+                         mSegmentMonotonic.tv_nsec + offsetNsec);
+    msg.mMonotonicTime.tv_sec = nsec / 1000000000LL;
+    msg.mMonotonicTime.tv_nsec = nsec % 1000000000LL;
+
+    msg.mLevel = (levelBit > 0 ? 1 << (levelBit - 1) : 0);
+    msg.mHost = mSegmentHost;
+    msg.mThread = NULL;
+    msg.mFormat = NULL;
+    msg.mArgs = NULL;
+
+    std::map<unsigned int, ThreadInfo>::const_iterator t(mThreads.find(thread));
+    if (t != mThreads.end())
+    {
+        msg.mPID = t->second.mPID;
+        msg.mThreadID = t->second.mThreadID;
+        msg.mThreadName = t->second.mThreadName;
+    }
+    else
+    {
+        msg.mPID = mSegmentPID;
+        msg.mThreadID = 0;
+        msg.mThreadName.clear();
+    }
+
+    std::map<unsigned int, Location>::const_iterator l(mLocations.find(location));
+    if (l != mLocations.end())
+    {
+        msg.mFile = l->second.mFile;
+        msg.mFunction = l->second.mFunction;
+        msg.mLine = l->second.mLine;
+    }
+    else
+    {
+        msg.mFile.clear();
+        msg.mFunction.clear();
+        msg.mLine = 0;
+    }
+
+    msg.mMsg.clear();
+    if (type == RECORD_TEXT)
+    {
+        msg.mMsg = in.String();
+        return in.OK();
+    }
+
+    std::map<unsigned int, FString>::const_iterator f(mFormats.find(in.Varint()));
+    if (f == mFormats.end())
+    {
+        ++mUndecodable;
+        return in.OK();
+    }
+    if (!decodeArgs(f->second.c_str(), in, msg.mMsg))
+    {
+        ++mUndecodable;
+        msg.mMsg = f->second;
+    }
+    return true;
+}
@@ -0,0 +1,179 @@
+#ifndef __BinaryLogfile_h
+#define __BinaryLogfile_h
+
+#include "LogManager.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * BinaryLogfile writes log messages as a compact stream of binary
+ * records instead of formatted text. Source locations, printf
+ * formats and threads are written once per file as definition
+ * records and messages refer to them by number. Messages logged by
+ * hlog() on the calling thread keep their format and raw arguments
+ * rather than the formatted text; anything else (hlogstream(), async
+ * logging, formats using %m, %n, %ls or positional arguments) keeps
+ * the text. Timestamps are CLOCK_MONOTONIC offsets from the start of
+ * the segment, which records the wall clock once.
+ *
+ * The file is appended to through a shared mapping that is grown a
+ * chunk at a time, so writing a message is a memcpy. What has been
+ * written survives the process crashing; the rest of the chunk is
+ * zeros, which the reader treats as the end of the file.
+ *
+ * Usage:
+ * logManager.BeginLogging("//binary//var/log/myserver.blog", HLOG_ALL);
+ *
+ * and logdecode renders the file as the usual text log.
+ *
+ * Reopen() returns false, so LogManager::Reopen() replaces the
+ * logfile with a new one on the same path after a rotation. A file
+ * that is opened again is appended to with a new segment.
+ *
+ * File layout, all integers are LEB128 varints ('s' ones zigzag
+ * encoded) and strings are a varint length followed by the bytes:
+ *
+ *   magic "FORTEBL\1"
+ *   records: u8 type, varint length, length bytes of payload
+ *
+ *   SEGMENT   version, pid, host, wall sec, wall usec, mono sec, mono nsec
+ *   LOCATION  id, file, function, line
+ *   FORMAT    id, format
+ *   THREAD    id, pid, thread id, thread name
+ *   TEXT      s mono offset nsec, u8 level bit, thread, location,
+ *             depth, prefix, message
+ *   ARGS      as TEXT up to depth, then prefix, format, and the
+ *             arguments in the order the format consumes them
+ *
+ * Ids start over in each segment. Readers skip record types they do
+ * not know.
+ */
+
+namespace Forte
+{
+    EXCEPTION_CLASS(EBinaryLogfile);
+    EXCEPTION_SUBCLASS2(EBinaryLogfile, EBinaryLogfileOpen,
+                        "Could not open binary log file");
+    EXCEPTION_SUBCLASS2(EBinaryLogfile, EBinaryLogfileFormat,
+                        "Not a binary log file");
+
+    class BinaryLogfile : public Logfile
+    {
+    public:
+        /**
+         * Append to the binary log at path. mapChunkSize is how far
+         * the file and the mapping are grown at a time. If path can
+         * not be opened, or holds something other than a binary log,
+         * messages are discarded the same as for a text logfile
+         * whose stream failed to open.
+         */
+        BinaryLogfile(const FString &path,
+                      unsigned int logMask = HLOG_ALL,
+                      size_t mapChunkSize = 1048576);
+        virtual ~BinaryLogfile();
+
+        virtual void Write(const LogMsg& msg);
+        virtual void WriteBatch(const std::vector<const LogMsg*>& msgs);
+
+        const FString& GetFilePath(void) const { return mFilePath; }
+        bool IsOpen(void) const { return mFD != -1; }
+
+    protected:
+        void open(void);
+        void close(void);
+        bool findEnd(size_t size);
+        void writeSegment(void);
+        void writeMsg(const LogMsg& msg);
+        unsigned int internLocation(const LogMsg& msg);
+        unsigned int internThread(const LogMsg& msg);
+        unsigned int internFormat(const char *fmt);
+        void appendRecord(int type, const std::string& payload);
+        bool reserve(size_t len);
+
+        const FString mFilePath;
+        const size_t mMapChunkSize;
+        const size_t mPageSize;
+        Mutex mWriteLock;
+
+        int mFD;
+        char *mMap;
+        size_t mMapOffset;
+        size_t mMapSize;
+        size_t mOffset;
+
+        struct timespec mSegmentMonotonic;
+
+        // definitions written to the current segment, by content.
+        // formats are looked up by address first
+        std::map<std::string, unsigned int> mLocations;
+        std::map<std::string, unsigned int> mThreads;
+        std::map<std::string, unsigned int> mFormats;
+        std::map<const char *, unsigned int> mFormatAddresses;
+        std::vector<const std::string*> mFormatsById;
+
+        // reused to build keys and records without allocating
+        std::string mKey;
+        std::string mPayload;
+        std::string mArgs;
+        std::string mDefinition;
+    };
+
+    /**
+     * BinaryLogReader reads back the messages written by
+     * BinaryLogfile, filling in a LogMsg with what the text log
+     * formats need. The file is read through a private mapping, it
+     * may still be being written.
+     */
+    class BinaryLogReader : public Object
+    {
+    public:
+        BinaryLogReader(const FString &path);
+        virtual ~BinaryLogReader();
+
+        /**
+         * Read the next message. Returns false at the end of the
+         * file, including a partly written last record.
+         */
+        bool Next(LogMsg &msg);
+
+        /**
+         * Number of messages whose arguments could not be decoded
+         * and were returned with the bare format.
+         */
+        unsigned long long GetUndecodableCount(void) const {
+            return mUndecodable;
+        }
+
+    protected:
+        struct Location {
+            FString mFile;
+            FString mFunction;
+            int mLine;
+        };
+        struct ThreadInfo {
+            int mPID;
+            unsigned int mThreadID;
+            FString mThreadName;
+        };
+
+        bool readMsg(int type, const char *p, const char *end, LogMsg &msg);
+        void readSegment(const char *p, const char *end);
+
+        const FString mPath;
+        int mFD;
+        const char *mMap;
+        size_t mSize;
+        size_t mOffset;
+        unsigned long long mUndecodable;
+
+        int mSegmentPID;
+        FString mSegmentHost;
+        struct timeval mSegmentWall;
+        struct timespec mSegmentMonotonic;
+        std::map<unsigned int, Location> mLocations;
+        std::map<unsigned int, ThreadInfo> mThreads;
+        std::map<unsigned int, FString> mFormats;
+    };
+};
+#endif
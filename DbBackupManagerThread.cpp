@@ -1,6 +1,7 @@
 #include "DbBackupManagerThread.h"
 #include "DbConnectionPool.h"
 #include "DbAutoConnection.h"
+#include "DbLiteMirror.h"
 #include "FileSystemImpl.h"
 #include "INotify.h"
 #include <boost/make_shared.hpp>
@@ -15,9 +16,30 @@ using namespace boost;
 using namespace Forte;
 
 DbBackupManagerThread::DbBackupManagerThread(boost::shared_ptr<DbConnectionPool> pool)
-    :base_type(), mPool(pool), mDbWatch(-1), mDbParentDirWatch(-1)
+    :base_type(), mPool(pool), mIncremental(false), mMaxBytesPerSecond(0),
+     mDbWatch(-1), mDbParentDirWatch(-1)
 {
-    if(pool && ! pool->GetDbName().empty() && ! pool->GetBackupDbName().empty())
+    init();
+}
+
+DbBackupManagerThread::DbBackupManagerThread(boost::shared_ptr<DbConnectionPool> pool,
+                                             bool incremental,
+                                             unsigned int maxBytesPerSecond)
+    :base_type(), mPool(pool), mIncremental(incremental),
+     mMaxBytesPerSecond(maxBytesPerSecond), mDbWatch(-1), mDbParentDirWatch(-1)
+{
+#ifndef FORTE_WITH_SQLITE
+    if(mIncremental)
+    {
+        hlog_and_throw(HLOG_ERR, DbException("incremental backups need sqlite"));
+    }
+#endif
+    init();
+}
+
+void DbBackupManagerThread::init()
+{
+    if(mPool && ! mPool->GetDbName().empty() && ! mPool->GetBackupDbName().empty())
     {
         mInotify.reset(new INotify());
 
@@ -38,7 +60,10 @@ void DbBackupManagerThread::addWatchDbParentDir()
     {
         if(fs.FileExists(parentPath))
         {
-            mDbParentDirWatch = mInotify->AddWatch(parentPath, IN_CREATE | IN_IGNORED);
+            // in WAL mode writes go to the -wal file next to the db
+            mDbParentDirWatch = mInotify->AddWatch(
+                parentPath,
+                IN_CREATE | IN_IGNORED | (mIncremental ? IN_MODIFY : 0));
             hlogstream(HLOG_DEBUG, "added watch on: " << parentPath);
         }
     }
@@ -88,11 +113,29 @@ timespec DbBackupManagerThread::getModificationTime() const
     }
 }
 
+boost::shared_ptr<DbLiteMirror> DbBackupManagerThread::GetMirror() const
+{
+    return mMirror;
+}
+
 void DbBackupManagerThread::backupDb()
 {
     FTRACE;
     try
     {
+#ifdef FORTE_WITH_SQLITE
+        if(mIncremental)
+        {
+            if(! mMirror)
+            {
+                mMirror.reset(new DbLiteMirror(mPool->GetDbName(),
+                                               mPool->GetBackupDbName(),
+                                               mMaxBytesPerSecond));
+            }
+            mMirror->Sync();
+            return;
+        }
+#endif
         DbAutoConnection connection(mPool);
         connection->BackupDatabase(mPool->GetBackupDbName());
     }
@@ -106,6 +149,17 @@ void DbBackupManagerThread::backupDb()
     }
 }
 
+bool DbBackupManagerThread::isMirrorBehind()
+{
+#ifdef FORTE_WITH_SQLITE
+    // also catches a sync that was put off, and leaves out the
+    // checkpoint each sync starts with
+    return (! mMirror || mMirror->UpdateLag());
+#else
+    return false;
+#endif
+}
+
 void DbBackupManagerThread::resetWatchDbParentDir()
 {
     FileSystemImpl fs;
@@ -171,6 +225,15 @@ void* DbBackupManagerThread::run()
                             addWatchDb();
                         }
                     }
+                    else if(event.mask & IN_MODIFY)
+                    {
+                        const string walName(fs.Basename(mPool->GetDbName()) + "-wal");
+
+                        if(event.name == walName)
+                        {
+                            ++kickCount;
+                        }
+                    }
                     else
                     {
                         hlogstream(HLOG_DEBUG, "unhandled " << event);
@@ -194,7 +257,7 @@ void* DbBackupManagerThread::run()
                 }
             }
 
-            if(kickCount > 0 && hasWatchDb())
+            if(kickCount > 0 && hasWatchDb() && (! mIncremental || isMirrorBehind()))
             {
                 hlogstream(HLOG_DEBUG, kickCount << " kicks to be serviced");
                 backupDb();
@@ -205,7 +268,8 @@ void* DbBackupManagerThread::run()
         {
             timespec currentTimeSpec(getModificationTime());
 
-            if((currentTimeSpec.tv_sec != previousTimeSpec.tv_sec) || (currentTimeSpec.tv_nsec != previousTimeSpec.tv_nsec))
+            if(mIncremental ? isMirrorBehind() :
+               ((currentTimeSpec.tv_sec != previousTimeSpec.tv_sec) || (currentTimeSpec.tv_nsec != previousTimeSpec.tv_nsec)))
             {
                 backupDb();
                 previousTimeSpec = currentTimeSpec;
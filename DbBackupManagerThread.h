@@ -13,6 +13,7 @@ namespace boost
 namespace Forte {
 
     class DbConnectionPool;
+    class DbLiteMirror;
     class INotify;
 
     class DbBackupManagerThread : public DbBackupManager, public Thread
@@ -21,13 +22,31 @@ namespace Forte {
         typedef DbBackupManager base_type;
 
         DbBackupManagerThread(boost::shared_ptr<DbConnectionPool> pool);
+
+        /**
+         * With incremental set, the backup is kept up to date by a
+         * DbLiteMirror, which puts the primary in WAL mode and writes
+         * only the pages that changed, reading the primary at no more
+         * than maxBytesPerSecond (0 is no limit). Sqlite only.
+         */
+        DbBackupManagerThread(boost::shared_ptr<DbConnectionPool> pool,
+                              bool incremental,
+                              unsigned int maxBytesPerSecond = 0);
         ~DbBackupManagerThread();
         void* run();
         void Shutdown();
 
+        /**
+         * The mirror doing incremental backups, for its stats. Empty
+         * until the first backup, or when not incremental.
+         */
+        boost::shared_ptr<DbLiteMirror> GetMirror() const;
+
     protected:
+        void init();
         timespec getModificationTime() const;
         void backupDb();
+        bool isMirrorBehind();
 
         void addWatchDbParentDir();
         void addWatchDb();
@@ -43,6 +62,9 @@ namespace Forte {
 
     private:
         boost::shared_ptr<DbConnectionPool> mPool;
+        const bool mIncremental;
+        const unsigned int mMaxBytesPerSecond;
+        boost::shared_ptr<DbLiteMirror> mMirror;
         boost::scoped_ptr<INotify> mInotify;
         int mDbWatch;
         int mDbParentDirWatch;
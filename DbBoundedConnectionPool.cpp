@@ -0,0 +1,473 @@
+#ifndef FORTE_NO_DB
+
+#include "DbBoundedConnectionPool.h"
+#include "LogManager.h"
+#include "FTrace.h"
+#include "Foreach.h"
+#include <vector>
+
+using namespace Forte;
+using namespace boost;
+
+DbBoundedConnectionPool::DbBoundedConnectionPool(ServiceConfig &configObj,
+                                                 const FString &root) :
+    DbConnectionPool(configObj, root),
+    mMinSize(configObj.Get<unsigned int>(root + ".pool.min", 0)),
+    mMaxSize(configObj.Get<unsigned int>(root + ".pool.max", 16)),
+    mWaitTimeoutMillisec(
+        configObj.Get<unsigned int>(root + ".pool.wait_timeout_ms", 0)),
+    mIdleTimeoutSeconds(
+        configObj.Get<unsigned int>(root + ".pool.idle_timeout", 300)),
+    mValidateIntervalSeconds(
+        configObj.Get<unsigned int>(root + ".pool.validate_interval", 60))
+{
+    startup();
+}
+
+DbBoundedConnectionPool::DbBoundedConnectionPool(
+    const char *dbType,
+    const char *dbName,
+    unsigned int minSize,
+    unsigned int maxSize,
+    unsigned int waitTimeoutMillisec,
+    unsigned int idleTimeoutSeconds,
+    unsigned int validateIntervalSeconds,
+    const char *dbAltName,
+    const char *dbUser,
+    const char *dbPassword,
+    const char *dbHost,
+    const char *dbSocket) :
+    DbConnectionPool(dbType, dbName, dbAltName, dbUser, dbPassword,
+                     dbHost, dbSocket, maxSize),
+    mMinSize(minSize),
+    mMaxSize(maxSize),
+    mWaitTimeoutMillisec(waitTimeoutMillisec),
+    mIdleTimeoutSeconds(idleTimeoutSeconds),
+    mValidateIntervalSeconds(validateIntervalSeconds)
+{
+    startup();
+}
+
+void DbBoundedConnectionPool::startup(void)
+{
+    if (mMaxSize == 0 || mMinSize > mMaxSize)
+    {
+        hlog_and_throw(HLOG_ERR, EDbConnectionPool(
+                           FStringFC(), "[%s] invalid pool size %u-%u",
+                           mDbName.c_str(), mMinSize, mMaxSize));
+    }
+
+    mOpenCount = 0;
+    mCheckouts = mWaits = mTimeouts = 0;
+    mOpened = mClosedIdle = mClosedInvalid = 0;
+    mOpenConnections = mIdleConnections = 0;
+    mLatencyUnder100us = mLatencyUnder1ms = mLatencyUnder10ms = 0;
+    mLatencyUnder100ms = mLatencyUnder1s = mLatencyOver1s = 0;
+
+    registerStatVariable<0>("checkouts", &DbBoundedConnectionPool::mCheckouts);
+    registerStatVariable<1>("waits", &DbBoundedConnectionPool::mWaits);
+    registerStatVariable<2>("timeouts", &DbBoundedConnectionPool::mTimeouts);
+    registerStatVariable<3>("opened", &DbBoundedConnectionPool::mOpened);
+    registerStatVariable<4>("closedIdle",
+                            &DbBoundedConnectionPool::mClosedIdle);
+    registerStatVariable<5>("closedInvalid",
+                            &DbBoundedConnectionPool::mClosedInvalid);
+    registerStatVariable<6>("openConnections",
+                            &DbBoundedConnectionPool::mOpenConnections);
+    registerStatVariable<7>("idleConnections",
+                            &DbBoundedConnectionPool::mIdleConnections);
+    registerStatVariable<8>("checkoutLatencyUnder100us",
+                            &DbBoundedConnectionPool::mLatencyUnder100us);
+    registerStatVariable<9>("checkoutLatencyUnder1ms",
+                            &DbBoundedConnectionPool::mLatencyUnder1ms);
+    registerStatVariable<10>("checkoutLatencyUnder10ms",
+                             &DbBoundedConnectionPool::mLatencyUnder10ms);
+    registerStatVariable<11>("checkoutLatencyUnder100ms",
+                             &DbBoundedConnectionPool::mLatencyUnder100ms);
+    registerStatVariable<12>("checkoutLatencyUnder1s",
+                             &DbBoundedConnectionPool::mLatencyUnder1s);
+    registerStatVariable<13>("checkoutLatencyOver1s",
+                             &DbBoundedConnectionPool::mLatencyOver1s);
+
+    // warm up. a database that is not there yet is retried by the
+    // maintenance thread
+    try
+    {
+        Maintain();
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_WARN, "[%s] could not open %u connections: %s",
+             mDbName.c_str(), mMinSize, e.what());
+    }
+
+    if (mMinSize > 0 || mIdleTimeoutSeconds > 0 || mValidateIntervalSeconds > 0)
+        mMaintenanceThread.reset(new MaintenanceThread(*this));
+}
+
+DbBoundedConnectionPool::~DbBoundedConnectionPool()
+{
+    mMaintenanceThread.reset();
+
+    foreach (const IdleConnection &idle, mIdle)
+        delete idle.mConnection;
+    mIdle.clear();
+}
+
+DbConnection& DbBoundedConnectionPool::GetDbConnection(bool secondaryPreferred)
+{
+    if (mWaitTimeoutMillisec == 0)
+        return getDbConnection(NULL, secondaryPreferred);
+
+    DeadlineClock deadline;
+    deadline.ExpiresInMillisec(mWaitTimeoutMillisec);
+    return getDbConnection(&deadline, secondaryPreferred);
+}
+
+DbConnection& DbBoundedConnectionPool::GetDbConnection(
+    const DeadlineClock &deadline, bool secondaryPreferred)
+{
+    return getDbConnection(&deadline, secondaryPreferred);
+}
+
+DbConnection& DbBoundedConnectionPool::getDbConnection(
+    const DeadlineClock *deadline, bool secondaryPreferred)
+{
+    FTRACE;
+
+    TimerClock timer;
+    timer.Start();
+
+    DbConnection *db = NULL;
+    bool open = false;
+    bool timedOut = false;
+    {
+        AutoUnlockMutex lock(mPoolMutex);
+        ++mCheckouts;
+
+        // callers already waiting go first
+        if (mWaiters.empty() && !mIdle.empty())
+        {
+            db = mIdle.back().mConnection;
+            mIdle.pop_back();
+        }
+        else if (mWaiters.empty() && mOpenCount < mMaxSize)
+        {
+            ++mOpenCount;
+            open = true;
+        }
+        else
+        {
+            Waiter waiter(mPoolMutex);
+            mWaiters.push_back(&waiter);
+            ++mWaits;
+
+            while (waiter.mConnection == NULL && !waiter.mMayOpen)
+            {
+                if (deadline == NULL)
+                {
+                    waiter.mCondition.Wait();
+                }
+                else if (deadline->Expired())
+                {
+                    mWaiters.remove(&waiter);
+                    ++mTimeouts;
+                    timedOut = true;
+                    break;
+                }
+                else
+                {
+                    const struct timespec abstime =
+                        deadline->GetAbsExpirationTime();
+                    waiter.mCondition.TimedWait(abstime);
+                }
+            }
+            db = waiter.mConnection;
+            open = waiter.mMayOpen;
+        }
+
+        if (db != NULL)
+            mUsedConnections.insert(db);
+        mIdleConnections = mIdle.size();
+        mOpenConnections = mOpenCount;
+    }
+
+    if (timedOut)
+    {
+        timer.Stop();
+        hlog_and_throw(HLOG_WARN, EDbConnectionPoolTimeout(
+                           FStringFC(),
+                           "[%s] no connection free after %lld ms (%u open)",
+                           mDbName.c_str(), timer.GetTime().AsMillisec(),
+                           mMaxSize));
+    }
+
+    if (open)
+    {
+        try
+        {
+            db = createConnection(secondaryPreferred);
+        }
+        catch (...)
+        {
+            timer.Stop();
+            AutoUnlockMutex lock(mPoolMutex);
+            connectionClosed();
+            throw;
+        }
+
+        AutoUnlockMutex lock(mPoolMutex);
+        ++mOpened;
+        mUsedConnections.insert(db);
+    }
+
+    timer.Stop();
+    {
+        AutoUnlockMutex lock(mPoolMutex);
+        recordLatency(timer.GetTime());
+    }
+    return *db;
+}
+
+void DbBoundedConnectionPool::ReleaseDbConnection(DbConnection& db)
+{
+    FTRACE;
+
+    rollbackPending(db);
+
+    AutoUnlockMutex lock(mPoolMutex);
+    set<DbConnection*>::iterator iConnection = mUsedConnections.find(&db);
+    if (iConnection == mUsedConnections.end())
+    {
+        throw EDbConnectionPool("Connection not found");
+    }
+    mUsedConnections.erase(iConnection);
+    returnConnection(&db);
+}
+
+void DbBoundedConnectionPool::DeleteConnections()
+{
+    std::list<IdleConnection> idle;
+    {
+        AutoUnlockMutex lock(mPoolMutex);
+        if (!mUsedConnections.empty())
+        {
+            throw EDbConnectionPoolOpenConnections("Connections are still open");
+        }
+        idle.swap(mIdle);
+        mIdleConnections = 0;
+        for (size_t i = 0; i < idle.size(); ++i)
+            connectionClosed();
+    }
+
+    foreach (const IdleConnection &i, idle)
+        delete i.mConnection;
+}
+
+void DbBoundedConnectionPool::returnConnection(DbConnection *connection)
+{
+    IdleConnection idle;
+    idle.mConnection = connection;
+    idle.mIdleSince = idle.mValidatedAt = mClock.GetTime();
+    returnIdle(idle);
+}
+
+void DbBoundedConnectionPool::returnIdle(const IdleConnection &idle)
+{
+    // mPoolMutex is held
+    if (!mWaiters.empty())
+    {
+        Waiter *waiter = mWaiters.front();
+        mWaiters.pop_front();
+        waiter->mConnection = idle.mConnection;
+        mUsedConnections.insert(idle.mConnection);
+        waiter->mCondition.Signal();
+        return;
+    }
+
+    mIdle.push_back(idle);
+    mIdleConnections = mIdle.size();
+}
+
+void DbBoundedConnectionPool::connectionClosed(void)
+{
+    // mPoolMutex is held. the first waiter may open one instead
+    --mOpenCount;
+    if (!mWaiters.empty())
+    {
+        Waiter *waiter = mWaiters.front();
+        mWaiters.pop_front();
+        waiter->mMayOpen = true;
+        ++mOpenCount;
+        waiter->mCondition.Signal();
+    }
+    mOpenConnections = mOpenCount;
+}
+
+void DbBoundedConnectionPool::recordLatency(const Timespec &latency)
+{
+    const struct timespec ts = latency;
+    const long long usec = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+
+    if (usec < 100) ++mLatencyUnder100us;
+    else if (usec < 1000) ++mLatencyUnder1ms;
+    else if (usec < 10000) ++mLatencyUnder10ms;
+    else if (usec < 100000) ++mLatencyUnder100ms;
+    else if (usec < 1000000) ++mLatencyUnder1s;
+    else ++mLatencyOver1s;
+}
+
+bool DbBoundedConnectionPool::validate(DbConnection &connection)
+{
+    try
+    {
+        if (connection.Execute("SELECT 1"))
+            return true;
+        hlog(HLOG_WARN, "[%s] connection %p failed validation: %s",
+             mDbName.c_str(), &connection, connection.GetError().c_str());
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_WARN, "[%s] connection %p failed validation: %s",
+             mDbName.c_str(), &connection, e.what());
+    }
+    return false;
+}
+
+void DbBoundedConnectionPool::Maintain(void)
+{
+    FTRACE;
+
+    std::vector<DbConnection*> closing;
+    std::vector<IdleConnection> checking;
+    {
+        AutoUnlockMutex lock(mPoolMutex);
+        const Timespec now(mClock.GetTime());
+
+        // down to the minimum size
+        std::list<IdleConnection>::iterator i = mIdle.begin();
+        while (mIdleTimeoutSeconds > 0 && i != mIdle.end() &&
+               mOpenCount > mMinSize)
+        {
+            if ((now - i->mIdleSince).AsSeconds() >= (long) mIdleTimeoutSeconds)
+            {
+                closing.push_back(i->mConnection);
+                i = mIdle.erase(i);
+                ++mClosedIdle;
+                connectionClosed();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        // connections being validated stay counted as open
+        i = mIdle.begin();
+        while (mValidateIntervalSeconds > 0 && i != mIdle.end())
+        {
+            if ((now - i->mValidatedAt).AsSeconds() >=
+                (long) mValidateIntervalSeconds)
+            {
+                checking.push_back(*i);
+                i = mIdle.erase(i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        mIdleConnections = mIdle.size();
+    }
+
+    foreach (DbConnection *db, closing)
+    {
+        hlog(HLOG_DEBUG, "[%s] closing idle connection %p",
+             mDbName.c_str(), db);
+        delete db;
+    }
+
+    foreach (IdleConnection &idle, checking)
+    {
+        const bool ok = validate(*idle.mConnection);
+        {
+            AutoUnlockMutex lock(mPoolMutex);
+            if (ok)
+            {
+                // still idle since it was released
+                idle.mValidatedAt = mClock.GetTime();
+                returnIdle(idle);
+                continue;
+            }
+            ++mClosedInvalid;
+            connectionClosed();
+        }
+        delete idle.mConnection;
+    }
+
+    // open connections up to the minimum size
+    while (true)
+    {
+        {
+            AutoUnlockMutex lock(mPoolMutex);
+            if (mOpenCount >= mMinSize)
+                break;
+            ++mOpenCount;
+            mOpenConnections = mOpenCount;
+        }
+
+        DbConnection *db = NULL;
+        try
+        {
+            db = createConnection(false);
+        }
+        catch (...)
+        {
+            AutoUnlockMutex lock(mPoolMutex);
+            connectionClosed();
+            throw;
+        }
+
+        AutoUnlockMutex lock(mPoolMutex);
+        ++mOpened;
+        returnConnection(db);
+    }
+}
+
+DbBoundedConnectionPool::MaintenanceThread::MaintenanceThread(
+    DbBoundedConnectionPool &pool)
+    : mPool(pool)
+{
+    setThreadName("dbpool");
+    initialized();
+}
+
+DbBoundedConnectionPool::MaintenanceThread::~MaintenanceThread()
+{
+    deleting();
+}
+
+void *DbBoundedConnectionPool::MaintenanceThread::run(void)
+{
+    const struct timespec interval = { 1, 0 };
+
+    while (!IsShuttingDown())
+    {
+        interruptibleSleep(interval, false);
+        if (IsShuttingDown())
+            break;
+
+        try
+        {
+            mPool.Maintain();
+        }
+        catch (Exception &e)
+        {
+            hlog(HLOG_WARN, "[%s] pool maintenance failed: %s",
+                 mPool.GetDbName().c_str(), e.what());
+        }
+    }
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __DbBoundedConnectionPool_h
+#define __DbBoundedConnectionPool_h
+
+#ifndef FORTE_NO_DB
+
+#include <list>
+#include "DbConnectionPool.h"
+#include "Clock.h"
+#include "EnableStats.h"
+#include "Locals.h"
+#include "Thread.h"
+#include "ThreadCondition.h"
+
+namespace Forte
+{
+    EXCEPTION_SUBCLASS(EDbConnectionPool, EDbConnectionPoolTimeout);
+
+    /**
+     * DbBoundedConnectionPool never has more than maxSize connections
+     * open. Callers finding them all in use wait in a FIFO queue, and
+     * a released connection goes straight to the first waiter.
+     * GetDbConnection() can be given a DeadlineClock, past which it
+     * throws EDbConnectionPoolTimeout; without one it waits for
+     * waitTimeoutMillisec, or forever if that is 0.
+     *
+     * The pool opens minSize connections at startup, and a background
+     * thread keeps it at that size, closes connections idle for more
+     * than idleTimeoutSeconds beyond it, and runs a trivial query on
+     * connections idle for validateIntervalSeconds, replacing the ones
+     * that fail.
+     *
+     * Stats: checkout counts, waits, timeouts, connections opened,
+     * closed as idle and failing validation, the open and idle counts,
+     * and a histogram of checkout latency.
+     */
+    class DbBoundedConnectionPool :
+        public DbConnectionPool,
+        public EnableStats<DbBoundedConnectionPool,
+                           Locals<DbBoundedConnectionPool,
+                                  int64_t, int64_t, int64_t, int64_t,
+                                  int64_t, int64_t, int64_t, int64_t,
+                                  int64_t, int64_t, int64_t, int64_t,
+                                  int64_t, int64_t> >
+    {
+    public:
+        /**
+         * Reads the connection settings as DbConnectionPool does, and
+         * root.pool.min, .max, .wait_timeout_ms, .idle_timeout and
+         * .validate_interval (seconds).
+         */
+        DbBoundedConnectionPool(ServiceConfig &configObj, const FString &root);
+        DbBoundedConnectionPool(const char *dbType,
+                                const char *dbName,
+                                unsigned int minSize,
+                                unsigned int maxSize,
+                                unsigned int waitTimeoutMillisec = 0,
+                                unsigned int idleTimeoutSeconds = 300,
+                                unsigned int validateIntervalSeconds = 60,
+                                const char *dbAltName = "",
+                                const char *dbUser = "",
+                                const char *dbPassword = "",
+                                const char *dbHost = "",
+                                const char *dbSocket = "");
+        virtual ~DbBoundedConnectionPool();
+
+        virtual DbConnection& GetDbConnection(bool secondaryPreferred = false);
+        virtual DbConnection& GetDbConnection(const DeadlineClock &deadline,
+                                              bool secondaryPreferred = false);
+        virtual void ReleaseDbConnection(DbConnection& connection);
+        virtual void DeleteConnections();
+
+        unsigned int GetMinSize(void) const { return mMinSize; }
+        unsigned int GetMaxSize(void) const { return mMaxSize; }
+
+        /**
+         * Close idle connections past their timeout, validate the
+         * ones due, and open connections up to the minimum size. The
+         * background thread calls this every second.
+         */
+        void Maintain(void);
+
+    protected:
+        struct IdleConnection {
+            DbConnection *mConnection;
+            Timespec mIdleSince;
+            Timespec mValidatedAt;
+        };
+
+        // a caller waiting for a connection. it is handed one, or
+        // the right to open one, by whoever frees it up
+        struct Waiter {
+            Waiter(Mutex &lock)
+                : mConnection(NULL), mMayOpen(false), mCondition(lock) {}
+            DbConnection *mConnection;
+            bool mMayOpen;
+            ThreadCondition mCondition;
+        };
+
+        class MaintenanceThread : public Thread
+        {
+        public:
+            MaintenanceThread(DbBoundedConnectionPool &pool);
+            virtual ~MaintenanceThread();
+        protected:
+            virtual void *run(void);
+            DbBoundedConnectionPool &mPool;
+        };
+
+        void startup(void);
+        DbConnection& getDbConnection(const DeadlineClock *deadline,
+                                      bool secondaryPreferred);
+        void returnConnection(DbConnection *connection);
+        void returnIdle(const IdleConnection &idle);
+        void connectionClosed(void);
+        void recordLatency(const Timespec &latency);
+        bool validate(DbConnection &connection);
+
+        const unsigned int mMinSize;
+        const unsigned int mMaxSize;
+        const unsigned int mWaitTimeoutMillisec;
+        const unsigned int mIdleTimeoutSeconds;
+        const unsigned int mValidateIntervalSeconds;
+
+        // guarded by mPoolMutex. open connections are the idle ones,
+        // mUsedConnections, and those being opened or validated
+        std::list<IdleConnection> mIdle; // most recently used last
+        std::list<Waiter*> mWaiters;
+        unsigned int mOpenCount;
+        MonotonicClock mClock;
+        boost::shared_ptr<MaintenanceThread> mMaintenanceThread;
+
+        int64_t mCheckouts;
+        int64_t mWaits;
+        int64_t mTimeouts;
+        int64_t mOpened;
+        int64_t mClosedIdle;
+        int64_t mClosedInvalid;
+        int64_t mOpenConnections;
+        int64_t mIdleConnections;
+        int64_t mLatencyUnder100us;
+        int64_t mLatencyUnder1ms;
+        int64_t mLatencyUnder10ms;
+        int64_t mLatencyUnder100ms;
+        int64_t mLatencyUnder1s;
+        int64_t mLatencyOver1s;
+    };
+    typedef boost::shared_ptr<DbBoundedConnectionPool> DbBoundedConnectionPoolPtr;
+};
+#endif
+#endif
@@ -6,6 +6,7 @@
 #include "DbException.h"
 #include "DbSqlStatement.h"
 #include "LogManager.h"
+#include <math.h>
 
 using namespace Forte;
 
@@ -240,17 +241,134 @@ void DbConnection::BackupDatabase(DbConnection &targetDatabase)
 
 bool DbConnection::Execute(const DbSqlStatement& statement)
 {
-    return Execute(statement.GetStatement());
+    return Execute(expandParameters(statement));
 }
 
 DbResult DbConnection::Use(const DbSqlStatement& statement)
 {
-    return Use(statement.GetStatement());
+    return Use(expandParameters(statement));
 }
 
 DbResult DbConnection::Store(const DbSqlStatement& statement)
 {
-    return Store(statement.GetStatement());
+    return Store(expandParameters(statement));
+}
+
+FString DbConnection::expandParameters(const DbSqlStatement& statement)
+{
+    if (!statement.HasParameters())
+        return statement.GetStatement();
+
+    const FString& sql(statement.GetStatement());
+    const DbSqlParameters& params(statement.GetParameters());
+    DbSqlParameters::const_iterator param(params.begin());
+    FString ret;
+    char quote = 0;
+    const bool backslashEscapes(stringsHaveBackslashEscapes());
+
+    for (size_t i = 0; i < sql.length(); ++i)
+    {
+        const char c = sql[i];
+        const char next = (i + 1 < sql.length()) ? sql[i + 1] : 0;
+        if (quote != 0)
+        {
+            if (c == '\\' && backslashEscapes && quote != '`' && next != 0)
+            {
+                // \' does not end the literal
+                ret += c;
+                ret += sql[++i];
+                continue;
+            }
+            if (c == quote) quote = 0;
+            ret += c;
+            continue;
+        }
+        if (c == '\'' || c == '"' || c == '`')
+        {
+            quote = c;
+            ret += c;
+            continue;
+        }
+        if (c == '-' && next == '-')
+        {
+            // comment to the end of the line
+            const size_t end = sql.find('\n', i);
+            const size_t len = (end == string::npos) ? string::npos : end - i;
+            ret += sql.substr(i, len);
+            if (end == string::npos) break;
+            i = end - 1;
+            continue;
+        }
+        if (c == '/' && next == '*')
+        {
+            const size_t end = sql.find("*/", i + 2);
+            const size_t len =
+                (end == string::npos) ? string::npos : end + 2 - i;
+            ret += sql.substr(i, len);
+            if (end == string::npos) break;
+            i = end + 1;
+            continue;
+        }
+        if (c != '?')
+        {
+            ret += c;
+            continue;
+        }
+
+        if (param == params.end())
+        {
+            hlog_and_throw(HLOG_ERR, EDbConnectionParameterCount(
+                               FStringFC(), "%zu values for [%s]",
+                               params.size(), sql.c_str()));
+        }
+
+        switch (param->mType)
+        {
+        case DbSqlParameter::DB_PARAM_NULL:
+            ret += "NULL";
+            break;
+        case DbSqlParameter::DB_PARAM_INTEGER:
+            ret += FString(FStringFC(), "%lld", (long long) param->mInteger);
+            break;
+        case DbSqlParameter::DB_PARAM_REAL:
+            // %g would write nan or inf, which are not SQL
+            if (!isfinite(param->mReal))
+            {
+                hlog_and_throw(HLOG_ERR, EDbConnectionParameterValue(
+                                   FStringFC(), "%g bound in [%s]",
+                                   param->mReal, sql.c_str()));
+            }
+            ret += FString(FStringFC(), "%.17g", param->mReal);
+            break;
+        case DbSqlParameter::DB_PARAM_TEXT:
+            ret += "'" + Escape(param->mText.c_str()) + "'";
+            break;
+        case DbSqlParameter::DB_PARAM_BLOB:
+            ret += "X'";
+            for (size_t j = 0; j < param->mText.length(); ++j)
+            {
+                ret += FString(FStringFC(), "%02x",
+                               (unsigned char) param->mText[j]);
+            }
+            ret += "'";
+            break;
+        }
+        ++param;
+    }
+
+    if (param != params.end())
+    {
+        hlog_and_throw(HLOG_ERR, EDbConnectionParameterCount(
+                           FStringFC(), "%zu values for [%s]",
+                           params.size(), sql.c_str()));
+    }
+
+    return ret;
+}
+
+bool DbConnection::stringsHaveBackslashEscapes() const
+{
+    return false;
 }
 
 const std::string& DbConnection::GetDbName() const
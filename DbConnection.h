@@ -23,6 +23,10 @@ namespace Forte
     EXCEPTION_SUBCLASS(EDbConnection, EDbConnectionPendingFailed);
     EXCEPTION_SUBCLASS(EDbConnection, EDbConnectionIoError);
     EXCEPTION_SUBCLASS(EDbConnection, EDbConnectionReadOnly);
+    EXCEPTION_SUBCLASS2(EDbConnection, EDbConnectionParameterCount,
+                        "Bound values do not match the statement placeholders");
+    EXCEPTION_SUBCLASS2(EDbConnection, EDbConnectionParameterValue,
+                        "Bound value cannot be written as SQL");
 
     class DbConnection : public Object
     {
@@ -97,6 +101,15 @@ namespace Forte
         FString mCurrentQuery;
 
      protected:
+        // the statement text with any bound values substituted,
+        // escaped, for the '?' placeholders outside quotes and comments
+        FString expandParameters(const DbSqlStatement& statement);
+
+        // whether a backslash escapes the next character inside a
+        // quoted string, as in MySQL's 'it\'s'. false, the SQL
+        // standard, unless the database says otherwise
+        virtual bool stringsHaveBackslashEscapes() const;
+
         FString mError;        // last database error
         unsigned int mErrno;   // last database error code
         unsigned int mTries;   // number of tries it took to execute the last query
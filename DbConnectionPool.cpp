@@ -6,6 +6,7 @@
 #include "DbLiteConnectionFactory.h"
 #include "DbMirroredConnectionFactory.h"
 #include "DbMirroredConnectionUseSecondaryFactory.h"
+#include "DbRoutingConnectionFactory.h"
 
 #ifdef FORTE_WITH_MYSQL
 #include "DbMyConnection.h"
@@ -32,6 +33,11 @@ using namespace boost;
  * Optionally mirror.path and mirror.type can be used to specify the type of the
  * readonly mirrored database.
  *
+ * For sqlite, a list of read-only replicas can be given as mirror.list, each
+ * entry with a 'path' (mirror.list.0.path, mirror.list.1.path, ...). Reads
+ * are then balanced across them by DbRoutingConnection, writes and anything
+ * in a transaction going to the primary.
+ *
  * @param configObj
  * @param root path to start from in the db config
  */
@@ -42,6 +48,14 @@ DbConnectionPool::DbConnectionPool(ServiceConfig &configObj, const Forte::FStrin
     mDbType = configObj.Get<FString>(root + ".type");
     mDbName = configObj.Get<FString>(root + ".path");
     mDbAltName = configObj.Get<FString>(root + ".mirror.path", "");
+    try
+    {
+        configObj.GetVectorSubKey(root + ".mirror.list", "path", mDbMirrorNames);
+    }
+    catch (EServiceConfigNoKey &e)
+    {
+        mDbMirrorNames.clear();
+    }
     init();
 }
 
@@ -84,7 +98,14 @@ void DbConnectionPool::init()
 #ifdef FORTE_WITH_SQLITE
     else if (!mDbType.CompareNoCase("sqlite"))
     {
-        if (mDbAltName.empty())
+        if (!mDbMirrorNames.empty())
+        {
+            boost::shared_ptr<DbConnectionFactory> primaryDbFactory(new DbLiteConnectionFactory());
+            boost::shared_ptr<DbConnectionFactory> replicaDbFactory(new DbLiteConnectionFactory(SQLITE_OPEN_READONLY));
+            mDbConnectionFactory.reset(new DbRoutingConnectionFactory(primaryDbFactory, replicaDbFactory, mDbMirrorNames));
+            mDbConnectionFactoryReadOnly = mDbConnectionFactory;
+        }
+        else if (mDbAltName.empty())
         {
             mDbConnectionFactory = boost::shared_ptr<DbConnectionFactory>(new DbLiteConnectionFactory());
             mDbConnectionFactoryReadOnly = boost::shared_ptr<DbConnectionFactory>(new DbLiteConnectionFactory());
@@ -100,7 +121,14 @@ void DbConnectionPool::init()
     else if (!mDbType.ComparePrefix("sqlite_", 7))
     {
         const FString vfs(mDbType.substr(7));
-        if (mDbAltName.empty())
+        if (!mDbMirrorNames.empty())
+        {
+            boost::shared_ptr<DbConnectionFactory> primaryDbFactory(new DbLiteConnectionFactory(vfs));
+            boost::shared_ptr<DbConnectionFactory> replicaDbFactory(new DbLiteConnectionFactory(SQLITE_OPEN_READONLY, vfs));
+            mDbConnectionFactory.reset(new DbRoutingConnectionFactory(primaryDbFactory, replicaDbFactory, mDbMirrorNames));
+            mDbConnectionFactoryReadOnly = mDbConnectionFactory;
+        }
+        else if (mDbAltName.empty())
         {
             mDbConnectionFactory = boost::shared_ptr<DbConnectionFactory>(
                     new DbLiteConnectionFactory(vfs));
@@ -146,85 +174,75 @@ void DbConnectionPool::DeleteConnections()
     mFreeConnections.erase(mFreeConnections.begin(), mFreeConnections.end());
 }
 
+DbConnection* DbConnectionPool::createConnection(bool secondaryPreferred)
+{
+    auto_ptr<DbConnection> pNewDb(secondaryPreferred ?
+                                  mDbConnectionFactoryReadOnly->create() :
+                                  mDbConnectionFactory->create());
+    if (!pNewDb.get())
+    {
+        // failed to create pDb
+        FString err;
+        err.Format("[%s] Failed to create database connection",
+                   mDbName.c_str());
+        throw EDbConnectionPool(err.c_str());
+    }
+
+    if (mDbSock.empty())
+    {
+        if (!pNewDb->Init(mDbName, mDbUser, mDbPassword, mDbHost)) {
+            FString err;
+            err.Format("[%s] Could not initialize database connection: %s",
+                       mDbName.c_str(), pNewDb->GetError().c_str());
+            throw EDbConnectionPool(err.c_str());
+        }
+    }
+    else
+    {
+        if (!pNewDb->Init(mDbName, mDbUser, mDbPassword, mDbHost, mDbSock)) {
+            FString err;
+            err.Format("[%s] Could not initialize socket database connection: %s",
+                       mDbName.c_str(), pNewDb->GetError().c_str());
+            throw EDbConnectionPool(err.c_str());
+        }
+    }
+
+    return pNewDb.release();
+}
+
 DbConnection& DbConnectionPool::GetDbConnection(bool secondaryPreferred) {
     FTRACE;
 
     DbConnection * pDb = NULL;
-    bool initNeeded = false;
     {
         AutoUnlockMutex lock(mPoolMutex);
 
-        hlog(HLOG_DEBUG2, "[%s] Free connections=%zu, Used connections=%zu",
-             mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
-        if (mFreeConnections.empty())
+        if (!mFreeConnections.empty())
         {
-            hlog(HLOG_DEBUG2, "[%s] Creating new connection", mDbName.c_str());
-            if (secondaryPreferred)
-                pDb = mDbConnectionFactoryReadOnly->create();
-            else
-                pDb = mDbConnectionFactory->create();
-            initNeeded = true;
-        } else {
-            hlog(HLOG_DEBUG2, "[%s] Free connections=%zu, Used connections=%zu",
-                 mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
             pDb = mFreeConnections.back();
             mUsedConnections.insert(mUsedConnections.end(), pDb);
             mFreeConnections.pop_back();
-            hlog(HLOG_DEBUG2, "[%s] Free connections=%zu, Used connections=%zu",
-                 mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
-        }
-    }
-
-    if (initNeeded && pDb)
-    {
-        auto_ptr<DbConnection> pNewDb(pDb);
-        if (mDbSock.empty())
-        {
-            if (!pDb->Init(mDbName, mDbUser, mDbPassword, mDbHost)) {
-                FString err;
-                err.Format("[%s] Could not initialize database connection: %s",
-                           mDbName.c_str(), pNewDb->GetError().c_str());
-                throw EDbConnectionPool(err.c_str());
-            }
-        }
-        else
-        {
-            if (!pNewDb->Init(mDbName, mDbUser, mDbPassword, mDbHost, mDbSock)) {
-                FString err;
-                err.Format("[%s] Could not initialize socket database connection: %s",
-                           mDbName.c_str(), pNewDb->GetError().c_str());
-                throw EDbConnectionPool(err.c_str());
-            }
-        }
-
-        {
-            // add this new initialized connection to used connections set
-            AutoUnlockMutex lock(mPoolMutex);
-            mUsedConnections.insert(mUsedConnections.end(), pNewDb.get());
-            hlog(HLOG_DEBUG2, "[%s] Free connections=%zu, Used connections=%zu",
-                 mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
-            // release the auto pointer at this point, we are done
-            pDb = pNewDb.release();
         }
     }
 
     if (!pDb)
     {
-        // failed to create pDb
-        FString err;
-        err.Format("[%s] Failed to create database connection",
-                   mDbName.c_str());
-        throw EDbConnectionPool(err.c_str());
+        hlog(HLOG_DEBUG2, "[%s] Creating new connection", mDbName.c_str());
+        auto_ptr<DbConnection> pNewDb(createConnection(secondaryPreferred));
+
+        // add this new initialized connection to used connections set
+        AutoUnlockMutex lock(mPoolMutex);
+        mUsedConnections.insert(mUsedConnections.end(), pNewDb.get());
+        // release the auto pointer at this point, we are done
+        pDb = pNewDb.release();
     }
 
     hlog(HLOG_DEBUG2, "Returning connection [%p]", pDb);
     return *pDb;
 }
 
-void DbConnectionPool::ReleaseDbConnection(DbConnection& db)
+void DbConnectionPool::rollbackPending(DbConnection& db)
 {
-    FTRACE;
-
     // make sure the connection has no pending queries
     if (db.HasPendingQueries())
     {
@@ -245,9 +263,15 @@ void DbConnectionPool::ReleaseDbConnection(DbConnection& db)
                  db.GetDbName().c_str());
         }
     }
+}
+
+void DbConnectionPool::ReleaseDbConnection(DbConnection& db)
+{
+    FTRACE;
+
+    rollbackPending(db);
 
     DbConnection * pOldConnection = NULL;
-    bool freeConnection = false;
     {
         AutoUnlockMutex lock(mPoolMutex);
 
@@ -256,24 +280,14 @@ void DbConnectionPool::ReleaseDbConnection(DbConnection& db)
 
         if(iConnection != mUsedConnections.end())
         {
-            hlog(HLOG_DEBUG2,
-                 "[%s] BEFORE:Free connections=%zu, Used connections=%zu",
-                 mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
             mFreeConnections.push_back(*iConnection);
             mUsedConnections.erase(iConnection);
             if (mFreeConnections.size() > mPoolSize)
             {
                 // have too many connections in the pool, delete one
-                hlog(HLOG_DEBUG2, "[%s] Deleting connection %p (%zu > %u)",
-                     mDbName.c_str(), pOldConnection,
-                     mFreeConnections.size(), mPoolSize);
                 pOldConnection = mFreeConnections.front();
                 mFreeConnections.pop_front();
-                freeConnection = true;
             }
-            hlog(HLOG_DEBUG2,
-                 "[%s] AFTER:Free connections=%zu, Used connections=%zu",
-                 mDbName.c_str(), mFreeConnections.size(), mUsedConnections.size());
         }
         else
         {
@@ -281,9 +295,11 @@ void DbConnectionPool::ReleaseDbConnection(DbConnection& db)
         }
     }
 
-    if (freeConnection && pOldConnection)
+    if (pOldConnection)
     {
         // need to free up connection
+        hlog(HLOG_DEBUG2, "[%s] Deleting connection %p (pool size %u)",
+             mDbName.c_str(), pOldConnection, mPoolSize);
         delete pOldConnection;
     }
 }
@@ -298,6 +314,11 @@ const FString& DbConnectionPool::GetBackupDbName() const
     return mDbAltName;
 }
 
+const FStringVector& DbConnectionPool::GetMirrorDbNames() const
+{
+    return mDbMirrorNames;
+}
+
 const FString& DbConnectionPool::GetDbType() const
 {
     return mDbType;
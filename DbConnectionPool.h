@@ -36,6 +36,7 @@ namespace Forte
 
         const FString& GetDbName() const;
         const FString& GetBackupDbName() const;
+        const FStringVector& GetMirrorDbNames() const;
         const FString& GetDbType() const;
         virtual void OutputUsedConnectionStatus();
 
@@ -43,9 +44,14 @@ namespace Forte
         DbConnectionPool() : mPoolSize(0) {}
         void init();
 
+        // a new, initialized connection. throws EDbConnectionPool
+        DbConnection* createConnection(bool secondaryPreferred);
+        void rollbackPending(DbConnection& db);
+
         FString mDbType;
         FString mDbName;
         FString mDbAltName;
+        FStringVector mDbMirrorNames;
         FString mDbUser;
         FString mDbPassword;
         FString mDbHost;
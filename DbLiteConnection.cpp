@@ -11,17 +11,34 @@
 #include "FTrace.h"
 #include "Clock.h"
 #include "DbConnectionPool.h"
+#include "DbSqlStatement.h"
+#include "Foreach.h"
+#include <ctype.h>
 
 using namespace Forte;
 
 DbLiteConnection::DbLiteConnection(int openFlags, const char *vfsName)
 :
     DbConnection(),
+    mStatementCacheSize(64),
+    mStatementCacheHits(0),
+    mStatementCacheMisses(0),
+    mStatementCacheEvictions(0),
+    mStatementCacheCount(0),
     mFlags(openFlags),
     mVFSName (vfsName)
 {
     FTRACE2("%i", openFlags);
 
+    registerStatVariable<0>("statementCacheHits",
+                            &DbLiteConnection::mStatementCacheHits);
+    registerStatVariable<1>("statementCacheMisses",
+                            &DbLiteConnection::mStatementCacheMisses);
+    registerStatVariable<2>("statementCacheEvictions",
+                            &DbLiteConnection::mStatementCacheEvictions);
+    registerStatVariable<3>("statementCacheSize",
+                            &DbLiteConnection::mStatementCacheCount);
+
     mDBType = "sqlite";
     mDB = NULL;
 }
@@ -127,6 +144,12 @@ bool DbLiteConnection::closeNonVirtual()
 {
     hlog(HLOG_TRACE, "[%s] closing [%p/%p]", mDBName.c_str(), this, mDB);
 
+    // sqlite3_close fails while there are unfinalized statements
+    const std::set<DbLiteResult::LiteStreamData*> streams(mStreams);
+    foreach (DbLiteResult::LiteStreamData *stream, streams)
+        stream->Finish(true);
+    evictPrepared(0);
+
     if (sqlite3_close(mDB) == SQLITE_OK)
     {
         hlog(HLOG_DEBUG2, "[%s] close complete [%p/%p]", mDBName.c_str(), this, mDB);
@@ -286,6 +309,509 @@ DbResult DbLiteConnection::Query(const FString& sql)
     return res;
 }
 
+void DbLiteConnection::SetStatementCacheSize(unsigned int size)
+{
+    mStatementCacheSize = size;
+    evictPrepared(size);
+}
+
+
+void DbLiteConnection::evictPrepared(unsigned int keep)
+{
+    while (mPrepared.size() > keep)
+    {
+        int rc;
+        if ((rc = sqlite3_finalize(mPrepared.back().second)) != SQLITE_OK)
+        {
+            hlog(HLOG_DEBUG, "sqlite3_finalize of cached statement: %d", rc);
+        }
+        mPreparedBySql.erase(mPrepared.back().first);
+        mPrepared.pop_back();
+        if (keep > 0)
+            ++mStatementCacheEvictions;
+    }
+    mStatementCacheCount = mPrepared.size();
+}
+
+
+sqlite3_stmt* DbLiteConnection::prepare(const FString& sql, bool& multiple)
+{
+    multiple = false;
+
+    unsigned int tries_remaining = mRetries + 1;
+    sqlite3_stmt *stmt = NULL;
+    const char *tail = NULL;
+
+    while (tries_remaining > 0)
+    {
+        hlog(HLOG_DEBUG2, "[%s] Preparing statement [%s]", mDBName.c_str(),
+             sql.c_str());
+        mErrno = sqlite3_prepare_v2(mDB, sql, sql.length(), &stmt, &tail);
+        if (stmt != NULL)
+            break;
+
+        mTries++;
+        if (mErrno != SQLITE_BUSY && mErrno != SQLITE_LOCKED)
+        {
+            hlog(HLOG_WARN, "[%s] sqlite3_prepare_v2 failed on [%s]. "
+                 "Error was %d.  hard failure, will not retry.",
+                 mDBName.c_str(), sql.c_str(), mErrno);
+            return NULL;
+        }
+
+        hlog(HLOG_WARN, "[%s] sqlite3_prepare_v2 failed on [%s]. "
+             "Error was %d.  Try %d of %d.",
+             mDBName.c_str(), sql.c_str(), mErrno,
+             (mRetries - tries_remaining + 1),
+             mRetries);
+
+        --tries_remaining;
+        if (tries_remaining > 0)
+            usleep(50000); // sleep 50 milliseconds
+    }
+
+    if (stmt == NULL)
+        return NULL;
+
+    // one statement is prepared at a time, anything after it needs
+    // to go through Query()
+    if (tail != NULL)
+    {
+        while (isspace(*tail) || *tail == ';') ++tail;
+        if (*tail != 0)
+        {
+            sqlite3_finalize(stmt);
+            multiple = true;
+            return NULL;
+        }
+    }
+    return stmt;
+}
+
+
+sqlite3_stmt* DbLiteConnection::getPrepared(const FString& sql,
+                                            bool& multiple)
+{
+    multiple = false;
+
+    std::map<FString, PreparedList::iterator>::iterator i =
+        mPreparedBySql.find(sql);
+    if (i != mPreparedBySql.end())
+    {
+        ++mStatementCacheHits;
+        mPrepared.splice(mPrepared.begin(), mPrepared, i->second);
+        return mPrepared.front().second;
+    }
+
+    ++mStatementCacheMisses;
+
+    sqlite3_stmt *stmt = prepare(sql, multiple);
+    if (stmt != NULL && mStatementCacheSize > 0)
+    {
+        evictPrepared(mStatementCacheSize - 1);
+        mPrepared.push_front(std::make_pair(sql, stmt));
+        mPreparedBySql[sql] = mPrepared.begin();
+        mStatementCacheCount = mPrepared.size();
+    }
+    return stmt;
+}
+
+
+sqlite3_stmt* DbLiteConnection::checkoutPrepared(const FString& sql,
+                                                 bool& multiple)
+{
+    multiple = false;
+
+    std::map<FString, PreparedList::iterator>::iterator i =
+        mPreparedBySql.find(sql);
+    if (i != mPreparedBySql.end())
+    {
+        ++mStatementCacheHits;
+        sqlite3_stmt *stmt = i->second->second;
+        mPrepared.erase(i->second);
+        mPreparedBySql.erase(i);
+        mStatementCacheCount = mPrepared.size();
+        return stmt;
+    }
+
+    ++mStatementCacheMisses;
+    return prepare(sql, multiple);
+}
+
+
+void DbLiteConnection::checkinPrepared(const FString& sql,
+                                       sqlite3_stmt *stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    // the same statement may have been prepared again meanwhile
+    if (mStatementCacheSize == 0 ||
+        mPreparedBySql.find(sql) != mPreparedBySql.end())
+    {
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    evictPrepared(mStatementCacheSize - 1);
+    mPrepared.push_front(std::make_pair(sql, stmt));
+    mPreparedBySql[sql] = mPrepared.begin();
+    mStatementCacheCount = mPrepared.size();
+}
+
+
+void DbLiteConnection::addStream(DbLiteResult::LiteStreamData *stream)
+{
+    mStreams.insert(stream);
+}
+
+
+void DbLiteConnection::endStream(DbLiteResult::LiteStreamData *stream,
+                                 sqlite3_stmt *stmt,
+                                 const FString& cacheKey,
+                                 bool finalize)
+{
+    mStreams.erase(stream);
+    if (finalize || cacheKey.empty())
+        sqlite3_finalize(stmt);
+    else
+        checkinPrepared(cacheKey, stmt);
+}
+
+
+bool DbLiteConnection::bindParameters(sqlite3_stmt *stmt,
+                                      const DbSqlStatement& statement,
+                                      bool copy)
+{
+    const DbSqlParameters& params(statement.GetParameters());
+
+    if (sqlite3_bind_parameter_count(stmt) != (int) params.size())
+    {
+        hlog_and_throw(HLOG_ERR, EDbConnectionParameterCount(
+                           FStringFC(), "%zu values for [%s]",
+                           params.size(), statement.GetStatement().c_str()));
+    }
+
+    // unless asked to copy them, the values outlive the execution
+    sqlite3_destructor_type destructor =
+        copy ? SQLITE_TRANSIENT : SQLITE_STATIC;
+    int i = 1;
+    foreach (const DbSqlParameter& param, params)
+    {
+        switch (param.mType)
+        {
+        case DbSqlParameter::DB_PARAM_NULL:
+            mErrno = sqlite3_bind_null(stmt, i);
+            break;
+        case DbSqlParameter::DB_PARAM_INTEGER:
+            mErrno = sqlite3_bind_int64(stmt, i, param.mInteger);
+            break;
+        case DbSqlParameter::DB_PARAM_REAL:
+            mErrno = sqlite3_bind_double(stmt, i, param.mReal);
+            break;
+        case DbSqlParameter::DB_PARAM_TEXT:
+            mErrno = sqlite3_bind_text(stmt, i, param.mText.data(),
+                                       param.mText.length(), destructor);
+            break;
+        case DbSqlParameter::DB_PARAM_BLOB:
+            mErrno = sqlite3_bind_blob(stmt, i, param.mText.data(),
+                                       param.mText.length(), destructor);
+            break;
+        }
+        if (mErrno != SQLITE_OK)
+        {
+            hlog(HLOG_WARN, "[%s] binding value %d of [%s] failed: %d",
+                 mDBName.c_str(), i, statement.GetStatement().c_str(),
+                 mErrno);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+
+DbResult DbLiteConnection::queryPrepared(const DbSqlStatement& statement)
+{
+    const FString& sql(statement.GetStatement());
+    FTRACE2("[%s] %s on [%p/%p]", mDBName.c_str(), sql.c_str(), this, mDB);
+
+    unsigned int tries_remaining = mRetries + 1;
+    struct timeval tv_start, tv_end;
+    DbLiteResult res;
+
+    // init
+    mTries = 0;
+    mErrno = SQLITE_OK;
+    mError.clear();
+
+    if (mDB == NULL)
+    {
+        setError();
+        return res;
+    }
+
+    bool multiple;
+    sqlite3_stmt *stmt = getPrepared(sql, multiple);
+    if (multiple)
+        return Query(expandParameters(statement));
+
+    mCurrentQuery = sql;
+    if (mAutoCommit == false) mQueriesPending = true;
+
+    if (stmt == NULL)
+    {
+        setError();
+        if (mErrno == SQLITE_IOERR)
+            throw EDbConnectionIoError();
+        return res;
+    }
+
+    const bool cached(mStatementCacheSize > 0);
+    bool bound;
+    try
+    {
+        bound = bindParameters(stmt, statement, false);
+    }
+    catch (EDbConnectionParameterCount &)
+    {
+        if (!cached) sqlite3_finalize(stmt);
+        throw;
+    }
+
+    while (bound && tries_remaining > 0)
+    {
+        // run query
+        mTries++;
+        gettimeofday(&tv_start, NULL);
+        hlog(HLOG_DEBUG2, "[%s] Loading query [%s]", mDBName.c_str(),
+             sql.c_str());
+        mErrno = res.Load(stmt);
+        gettimeofday(&tv_end, NULL);
+        if (sDebugSql) LogSql(sql, tv_end - tv_start);
+
+        if (mErrno == SQLITE_OK)
+            break;
+
+        res.Clear();
+        sqlite3_reset(stmt);
+
+        switch (mErrno)
+        {
+            //// soft failures, keep retrying:
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+            // as in Query(), a failed statement in a transaction
+            // means the transaction has to be started over
+            if (mInTransaction)
+            {
+                hlog(HLOG_WARN, "[%s] Load failed on [%s]. "
+                     "Error was %d. in a transaction, cannot retry",
+                     mDBName.c_str(), sql.c_str(), mErrno);
+
+                tries_remaining = 0;
+            }
+            else
+            {
+                hlog(HLOG_WARN, "[%s] Load failed on [%s]. "
+                     "Error was %d. Try %d of %d.",
+                     mDBName.c_str(), sql.c_str(), mErrno,
+                     (mRetries - tries_remaining + 1),
+                     mRetries);
+
+                --tries_remaining;
+                if (tries_remaining > 0)
+                    usleep(50000); // sleep 50 milliseconds
+            }
+            break;
+
+            //// hard failures, just fail immediately:
+        default:
+            hlog(HLOG_WARN, "[%s] Load failed on [%s]. "
+                 "Error was %d. hard failure, cannot retry",
+                 mDBName.c_str(), sql.c_str(), mErrno);
+
+            tries_remaining = 0;
+            break;
+        }
+    }
+
+    const int err = mErrno;
+    if (!res)
+        setError();
+
+    // ready for the next use, without holding on to the values
+    if (!cached)
+    {
+        sqlite3_finalize(stmt);
+    }
+    else
+    {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    if (err == SQLITE_IOERR)
+    {
+        throw EDbConnectionIoError();
+    }
+
+    return res;
+}
+
+
+DbResult DbLiteConnection::queryStream(const FString& sql,
+                                       const DbSqlStatement *statement)
+{
+    FTRACE2("[%s] %s on [%p/%p]", mDBName.c_str(), sql.c_str(), this, mDB);
+
+    unsigned int tries_remaining = mRetries + 1;
+    struct timeval tv_start, tv_end;
+    DbLiteResult res;
+
+    // init
+    mTries = 0;
+    mErrno = SQLITE_OK;
+    mError.clear();
+
+    if (mDB == NULL)
+    {
+        setError();
+        return res;
+    }
+
+    // a cached statement is taken out of the cache while it is
+    // streaming, and goes back when the result is done with it
+    const bool cacheable(statement != NULL && statement->IsCacheable());
+    bool multiple;
+    sqlite3_stmt *stmt = cacheable ?
+        checkoutPrepared(sql, multiple) : prepare(sql, multiple);
+    if (multiple)
+        return Query(statement ? expandParameters(*statement) : sql);
+
+    mCurrentQuery = sql;
+    if (mAutoCommit == false) mQueriesPending = true;
+
+    if (stmt == NULL)
+    {
+        setError();
+        if (mErrno == SQLITE_IOERR)
+            throw EDbConnectionIoError();
+        return res;
+    }
+
+    bool bound = true;
+    if (statement != NULL)
+    {
+        try
+        {
+            // the statement may be gone before the rows are
+            bound = bindParameters(stmt, *statement, true);
+        }
+        catch (EDbConnectionParameterCount &)
+        {
+            sqlite3_finalize(stmt);
+            throw;
+        }
+    }
+
+    // step to the first row, so errors show up here
+    while (bound && tries_remaining > 0)
+    {
+        mTries++;
+        gettimeofday(&tv_start, NULL);
+        hlog(HLOG_DEBUG2, "[%s] Stepping query [%s]", mDBName.c_str(),
+             sql.c_str());
+        mErrno = sqlite3_step(stmt);
+        gettimeofday(&tv_end, NULL);
+        if (sDebugSql) LogSql(sql, tv_end - tv_start);
+
+        if (mErrno == SQLITE_ROW || mErrno == SQLITE_DONE)
+        {
+            res = new DbLiteResult::LiteStreamData(
+                stmt, mErrno, this, cacheable ? sql : FString());
+            mErrno = SQLITE_OK;
+            return res;
+        }
+
+        sqlite3_reset(stmt);
+
+        switch (mErrno)
+        {
+            //// soft failures, keep retrying:
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+            if (mInTransaction)
+            {
+                hlog(HLOG_WARN, "[%s] Step failed on [%s]. "
+                     "Error was %d. in a transaction, cannot retry",
+                     mDBName.c_str(), sql.c_str(), mErrno);
+
+                tries_remaining = 0;
+            }
+            else
+            {
+                hlog(HLOG_WARN, "[%s] Step failed on [%s]. "
+                     "Error was %d. Try %d of %d.",
+                     mDBName.c_str(), sql.c_str(), mErrno,
+                     (mRetries - tries_remaining + 1),
+                     mRetries);
+
+                --tries_remaining;
+                if (tries_remaining > 0)
+                    usleep(50000); // sleep 50 milliseconds
+            }
+            break;
+
+            //// hard failures, just fail immediately:
+        default:
+            hlog(HLOG_WARN, "[%s] Step failed on [%s]. "
+                 "Error was %d. hard failure, cannot retry",
+                 mDBName.c_str(), sql.c_str(), mErrno);
+
+            tries_remaining = 0;
+            break;
+        }
+    }
+
+    const int err = mErrno;
+    setError();
+    if (cacheable)
+        checkinPrepared(sql, stmt);
+    else
+        sqlite3_finalize(stmt);
+
+    if (err == SQLITE_IOERR)
+    {
+        throw EDbConnectionIoError();
+    }
+
+    return res;
+}
+
+
+bool DbLiteConnection::Execute(const DbSqlStatement& statement)
+{
+    if (!statement.IsCacheable())
+        return Query(statement.GetStatement());
+    return queryPrepared(statement);
+}
+
+
+DbResult DbLiteConnection::Store(const DbSqlStatement& statement)
+{
+    if (!statement.IsCacheable())
+        return Query(statement.GetStatement());
+    return queryPrepared(statement);
+}
+
+
+DbResult DbLiteConnection::Use(const DbSqlStatement& statement)
+{
+    return queryStream(statement.GetStatement(), &statement);
+}
+
+
 bool DbLiteConnection::Execute(const FString& sql)
 {
     return Query(sql);
@@ -300,7 +826,7 @@ DbResult DbLiteConnection::Store(const FString& sql)
 
 DbResult DbLiteConnection::Use(const FString& sql)
 {
-    return Query(sql);
+    return queryStream(sql, NULL);
 }
 
 
@@ -310,6 +836,12 @@ bool DbLiteConnection::IsTemporaryError() const
 }
 
 
+bool DbLiteConnection::IsInTransaction(void) const
+{
+    return (mDB != NULL && sqlite3_get_autocommit(mDB) == 0);
+}
+
+
 FString DbLiteConnection::Escape(const char *str)
 {
     FString ret;
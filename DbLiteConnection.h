@@ -5,9 +5,15 @@
 #ifdef FORTE_WITH_SQLITE
 
 #include <sqlite3.h>
+#include <list>
+#include <map>
+#include <set>
 #include "FString.h"
 #include "DbConnection.h"
 #include "DbException.h"
+#include "DbLiteResult.h"
+#include "EnableStats.h"
+#include "Locals.h"
 
 
 namespace Forte
@@ -17,7 +23,26 @@ namespace Forte
     EXCEPTION_SUBCLASS(EDbLiteBackupFailed, EDbLiteBackupFailedSqlite3BackupInit);
     EXCEPTION_SUBCLASS(EDbLiteBackupFailed, EDbLiteBackupFailedSqlite3BackupStep);
 
-    class DbLiteConnection : public DbConnection
+    /**
+     * DbLiteConnection runs DbSqlStatements that have bound values,
+     * or are marked cacheable, through a per connection LRU cache of
+     * prepared statements keyed by the statement text, binding the
+     * values instead of escaping them into the text. The cache hit,
+     * miss and eviction counts are exposed as stats.
+     *
+     * Use() steps the statement as rows are fetched rather than
+     * loading them all, see DbLiteResult. Until the last row has been
+     * fetched or the result released the statement keeps its read
+     * lock on the database.
+     */
+    class DbLiteConnection :
+        public DbConnection,
+        public EnableStats<DbLiteConnection,
+                           Locals<DbLiteConnection,
+                                  int64_t,
+                                  int64_t,
+                                  int64_t,
+                                  int64_t> >
     {
     public:
         DbLiteConnection(int openFlags = SQLITE_OPEN_READWRITE,
@@ -46,9 +71,27 @@ namespace Forte
         virtual DbResult Store(const FString& sql);
         virtual DbResult Use(const FString& sql);
 
+        virtual bool Execute(const DbSqlStatement& statement);
+        virtual DbResult Store(const DbSqlStatement& statement);
+        virtual DbResult Use(const DbSqlStatement& statement);
+
+        /**
+         * Number of prepared statements kept, least recently used
+         * ones are finalized beyond that. 0 turns the cache off, and
+         * statements with bound values are prepared each time.
+         */
+        void SetStatementCacheSize(unsigned int size);
+        unsigned int GetStatementCacheSize(void) const {
+            return mStatementCacheSize;
+        }
+
         // error info
         virtual bool IsTemporaryError() const;
 
+        // whether a transaction is open, however it was begun. sqlite
+        // rolls back the whole transaction on some errors
+        bool IsInTransaction(void) const;
+
         // misc.
         virtual uint64_t InsertID();
         virtual uint64_t AffectedRows();
@@ -64,8 +107,38 @@ namespace Forte
         void backupDatabase(DbLiteConnection &dbTarget);
         void setError();
         DbResult Query(const FString& sql);
+        DbResult queryPrepared(const DbSqlStatement& statement);
+        DbResult queryStream(const FString& sql,
+                             const DbSqlStatement *statement);
+        sqlite3_stmt* prepare(const FString& sql, bool& multiple);
+        sqlite3_stmt* getPrepared(const FString& sql, bool& multiple);
+        sqlite3_stmt* checkoutPrepared(const FString& sql, bool& multiple);
+        void checkinPrepared(const FString& sql, sqlite3_stmt *stmt);
+        void evictPrepared(unsigned int keep);
+        bool bindParameters(sqlite3_stmt *stmt,
+                            const DbSqlStatement& statement,
+                            bool copy);
+
+        // streaming results still open
+        friend class DbLiteResult;
+        void addStream(DbLiteResult::LiteStreamData *stream);
+        void endStream(DbLiteResult::LiteStreamData *stream,
+                       sqlite3_stmt *stmt,
+                       const FString& cacheKey,
+                       bool finalize);
+        std::set<DbLiteResult::LiteStreamData*> mStreams;
         struct sqlite3 *mDB;
 
+        typedef std::list<std::pair<FString, sqlite3_stmt*> > PreparedList;
+        PreparedList mPrepared; // most recently used first
+        std::map<FString, PreparedList::iterator> mPreparedBySql;
+        unsigned int mStatementCacheSize;
+
+        int64_t mStatementCacheHits;
+        int64_t mStatementCacheMisses;
+        int64_t mStatementCacheEvictions;
+        int64_t mStatementCacheCount;
+
      public:
         int mFlags;
 
@@ -0,0 +1,302 @@
+#ifndef FORTE_NO_DB
+#ifdef FORTE_WITH_SQLITE
+
+#include "DbLiteGroupCommit.h"
+#include "LogManager.h"
+#include "FTrace.h"
+
+using namespace Forte;
+using namespace boost;
+
+DbLiteGroupCommit::DbLiteGroupCommit(const FString &dbPath,
+                                     unsigned int maxBatchSize,
+                                     unsigned int maxLatencyMillisec,
+                                     int openFlags) :
+    mMaxBatchSize(maxBatchSize > 0 ? maxBatchSize : 1),
+    mMaxLatencyMillisec(maxLatencyMillisec),
+    mConnection(openFlags),
+    mCondition(mLock),
+    mShutdown(false),
+    mSubmitted(0),
+    mBatches(0),
+    mCommitted(0),
+    mFailed(0),
+    mRetried(0),
+    mRunSeparately(0),
+    mLastBatchSize(0)
+{
+    registerStatVariable<0>("submitted", &DbLiteGroupCommit::mSubmitted);
+    registerStatVariable<1>("batches", &DbLiteGroupCommit::mBatches);
+    registerStatVariable<2>("committed", &DbLiteGroupCommit::mCommitted);
+    registerStatVariable<3>("failed", &DbLiteGroupCommit::mFailed);
+    registerStatVariable<4>("batchesRetried", &DbLiteGroupCommit::mRetried);
+    registerStatVariable<5>("batchesRunSeparately",
+                            &DbLiteGroupCommit::mRunSeparately);
+    registerStatVariable<6>("lastBatchSize",
+                            &DbLiteGroupCommit::mLastBatchSize);
+
+    FString error;
+    try
+    {
+        if (!mConnection.Init(dbPath))
+            error = mConnection.GetError();
+    }
+    catch (Exception &e)
+    {
+        error = e.what();
+    }
+    if (!error.empty())
+    {
+        hlog_and_throw(HLOG_ERR, EDbLiteGroupCommit(
+                           FStringFC(), "[%s] could not open: %s",
+                           dbPath.c_str(), error.c_str()));
+    }
+
+    mThread.reset(new CommitThread(*this));
+}
+
+DbLiteGroupCommit::~DbLiteGroupCommit()
+{
+    {
+        AutoUnlockMutex lock(mLock);
+        mShutdown = true;
+        mCondition.Broadcast();
+    }
+    mThread.reset();
+
+    // commit whatever the thread did not get to
+    run();
+}
+
+DbLiteGroupCommit::ResultFuturePtr DbLiteGroupCommit::Submit(
+    const DbSqlStatement &statement)
+{
+    Pending pending;
+    // statements are not copyable, so make one like it
+    if (statement.IsMutator())
+        pending.mStatement.reset(
+            new MutatorDbSqlStatement(statement.GetStatement()));
+    else
+        pending.mStatement.reset(
+            new NonMutatorDbSqlStatement(statement.GetStatement()));
+    pending.mStatement->SetParameters(statement.GetParameters());
+    pending.mStatement->SetCacheable(statement.IsCacheable());
+    pending.mFuture.reset(new ResultFuture());
+    pending.mSubmitted = mClock.GetTime();
+
+    AutoUnlockMutex lock(mLock);
+    if (mShutdown)
+        throw EDbLiteGroupCommitShutdown();
+    mPending.push_back(pending);
+    ++mSubmitted;
+    mCondition.Signal();
+    return pending.mFuture;
+}
+
+void DbLiteGroupCommit::run(void)
+{
+    Batch batch;
+    while (takeBatch(batch))
+    {
+        commitBatch(batch);
+        batch.clear();
+    }
+}
+
+bool DbLiteGroupCommit::takeBatch(Batch &batch)
+{
+    AutoUnlockMutex lock(mLock);
+    while (mPending.empty() && !mShutdown)
+        mCondition.Wait();
+    if (mPending.empty())
+        return false;
+
+    // give the batch until its first statement is maxLatency old to fill
+    if (mMaxLatencyMillisec > 0)
+    {
+        const Timespec deadline = mPending.front().mSubmitted +
+            Timespec::FromMillisec(mMaxLatencyMillisec);
+        while (mPending.size() < mMaxBatchSize && !mShutdown &&
+               mClock.GetTime() < deadline)
+        {
+            mCondition.TimedWait(deadline);
+        }
+    }
+
+    while (!mPending.empty() && batch.size() < mMaxBatchSize)
+    {
+        batch.push_back(mPending.front());
+        mPending.pop_front();
+    }
+    return true;
+}
+
+void DbLiteGroupCommit::commitBatch(const Batch &batch)
+{
+    FTRACE2("%zu", batch.size());
+
+    std::vector<Outcome> outcomes(batch.size());
+    if (!runInTransaction(batch, outcomes))
+    {
+        hlog(HLOG_WARN, "[%s] committing %zu statements failed: %s. "
+             "running them one at a time",
+             mConnection.mDBName.c_str(), batch.size(),
+             mConnection.GetError().c_str());
+        ++mRunSeparately;
+        runEach(batch, outcomes);
+    }
+
+    ++mBatches;
+    mLastBatchSize = batch.size();
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        const ResultFuturePtr &future(batch[i].mFuture);
+        if (outcomes[i].mException)
+        {
+            ++mFailed;
+            future->SetException(outcomes[i].mException);
+        }
+        else
+        {
+            ++mCommitted;
+            future->SetResult(outcomes[i].mRows);
+            future->SetException(boost::exception_ptr());
+        }
+    }
+}
+
+bool DbLiteGroupCommit::runInTransaction(const Batch &batch,
+                                         std::vector<Outcome> &outcomes)
+{
+    // statements that have failed stay out of later attempts
+    while (true)
+    {
+        if (!execute("BEGIN IMMEDIATE"))
+            return false;
+
+        bool aborted = false;
+        for (size_t i = 0; i < batch.size() && !aborted; ++i)
+        {
+            if (outcomes[i].mException)
+                continue;
+
+            if (!execute("SAVEPOINT groupcommit"))
+            {
+                execute("ROLLBACK");
+                return false;
+            }
+
+            if (runStatement(*batch[i].mStatement, outcomes[i]))
+            {
+                if (!execute("RELEASE groupcommit"))
+                {
+                    execute("ROLLBACK");
+                    return false;
+                }
+            }
+            else if (mConnection.IsInTransaction())
+            {
+                execute("ROLLBACK TO groupcommit");
+                execute("RELEASE groupcommit");
+            }
+            else
+            {
+                // sqlite rolled back the whole transaction, taking
+                // the statements before this one with it
+                aborted = true;
+            }
+        }
+
+        if (!aborted)
+            break;
+        ++mRetried;
+    }
+
+    if (execute("COMMIT"))
+        return true;
+
+    if (mConnection.IsInTransaction())
+        execute("ROLLBACK");
+    return false;
+}
+
+void DbLiteGroupCommit::runEach(const Batch &batch,
+                                std::vector<Outcome> &outcomes)
+{
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (!outcomes[i].mException)
+            runStatement(*batch[i].mStatement, outcomes[i]);
+    }
+}
+
+bool DbLiteGroupCommit::runStatement(const DbSqlStatement &statement,
+                                     Outcome &outcome)
+{
+    try
+    {
+        if (mConnection.Execute(statement))
+        {
+            outcome.mRows = mConnection.AffectedRows();
+            return true;
+        }
+    }
+    catch (Exception &e)
+    {
+        outcome.mException = boost::copy_exception(
+            DbException(e.what(), mConnection.GetErrno(),
+                        statement.GetStatement().c_str()));
+        return false;
+    }
+
+    const FString err(FStringFC(), "%s", mConnection.GetError().c_str());
+    if (mConnection.IsTemporaryError())
+    {
+        outcome.mException = boost::copy_exception(
+            DbTempErrorException(err, mConnection.GetErrno(),
+                                 statement.GetStatement().c_str()));
+    }
+    else
+    {
+        outcome.mException = boost::copy_exception(
+            DbException(err, mConnection.GetErrno(),
+                        statement.GetStatement().c_str()));
+    }
+    return false;
+}
+
+bool DbLiteGroupCommit::execute(const char *sql)
+{
+    try
+    {
+        return mConnection.Execute(FString(sql));
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_WARN, "[%s] %s failed: %s",
+             mConnection.mDBName.c_str(), sql, e.what());
+        return false;
+    }
+}
+
+DbLiteGroupCommit::CommitThread::CommitThread(DbLiteGroupCommit &groupCommit)
+    : mGroupCommit(groupCommit)
+{
+    setThreadName("dbcommit");
+    initialized();
+}
+
+DbLiteGroupCommit::CommitThread::~CommitThread()
+{
+    deleting();
+}
+
+void *DbLiteGroupCommit::CommitThread::run(void)
+{
+    mGroupCommit.run();
+    return NULL;
+}
+
+#endif
+#endif
@@ -0,0 +1,130 @@
+#ifndef __DbLiteGroupCommit_h
+#define __DbLiteGroupCommit_h
+
+#ifndef FORTE_NO_DB
+#ifdef FORTE_WITH_SQLITE
+
+#include <deque>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "DbLiteConnection.h"
+#include "DbSqlStatement.h"
+#include "Future.h"
+#include "Thread.h"
+#include "ThreadCondition.h"
+
+namespace Forte
+{
+    EXCEPTION_SUBCLASS(DbException, EDbLiteGroupCommit);
+    EXCEPTION_SUBCLASS2(EDbLiteGroupCommit, EDbLiteGroupCommitShutdown,
+                        "Group commit is shutting down");
+
+    /**
+     * DbLiteGroupCommit runs write statements submitted from any
+     * number of threads on its own connection, from a single
+     * committer thread that wraps everything pending in one
+     * transaction, so a burst of small writes costs one sync instead
+     * of one each.
+     *
+     * Submit() returns a Future for the number of rows the statement
+     * changed, or the DbException it failed with. A batch is
+     * committed once it has maxBatchSize statements, or
+     * maxLatencyMillisec after its first statement arrived; with a
+     * latency of 0 the committer takes whatever is pending as soon as
+     * the previous batch is done.
+     *
+     * Each statement runs under a savepoint, so one that fails is
+     * rolled back alone and the rest of the batch commits. If sqlite
+     * rolls back the whole transaction instead, the batch is run
+     * again without the failed statement, and if the commit itself
+     * fails the statements are run one at a time. Statements must not
+     * manage transactions themselves.
+     */
+    class DbLiteGroupCommit :
+        public Object,
+        public EnableStats<DbLiteGroupCommit,
+                           Locals<DbLiteGroupCommit,
+                                  int64_t, int64_t, int64_t, int64_t,
+                                  int64_t, int64_t, int64_t> >
+    {
+    public:
+        typedef Future<uint64_t> ResultFuture;
+        typedef boost::shared_ptr<ResultFuture> ResultFuturePtr;
+
+        DbLiteGroupCommit(const FString &dbPath,
+                          unsigned int maxBatchSize = 256,
+                          unsigned int maxLatencyMillisec = 0,
+                          int openFlags = SQLITE_OPEN_READWRITE);
+
+        /**
+         * Commits what is still pending before returning.
+         */
+        virtual ~DbLiteGroupCommit();
+
+        ResultFuturePtr Submit(const DbSqlStatement &statement);
+
+        unsigned int GetMaxBatchSize(void) const { return mMaxBatchSize; }
+        unsigned int GetMaxLatencyMillisec(void) const {
+            return mMaxLatencyMillisec;
+        }
+
+    protected:
+        struct Pending {
+            boost::shared_ptr<DbSqlStatement> mStatement;
+            ResultFuturePtr mFuture;
+            Timespec mSubmitted;
+        };
+        typedef std::vector<Pending> Batch;
+
+        struct Outcome {
+            Outcome() : mRows(0) {}
+            uint64_t mRows;
+            boost::exception_ptr mException;
+        };
+
+        class CommitThread : public Thread
+        {
+        public:
+            CommitThread(DbLiteGroupCommit &groupCommit);
+            virtual ~CommitThread();
+        protected:
+            virtual void *run(void);
+            DbLiteGroupCommit &mGroupCommit;
+        };
+
+        // committer thread
+        void run(void);
+        bool takeBatch(Batch &batch);
+        void commitBatch(const Batch &batch);
+        bool runInTransaction(const Batch &batch,
+                              std::vector<Outcome> &outcomes);
+        void runEach(const Batch &batch, std::vector<Outcome> &outcomes);
+        bool runStatement(const DbSqlStatement &statement, Outcome &outcome);
+        bool execute(const char *sql);
+
+        const unsigned int mMaxBatchSize;
+        const unsigned int mMaxLatencyMillisec;
+
+        // only used by the committer thread
+        DbLiteConnection mConnection;
+
+        Mutex mLock;
+        ThreadCondition mCondition;
+        std::deque<Pending> mPending; // guarded by mLock
+        bool mShutdown;               // guarded by mLock
+        MonotonicClock mClock;
+        boost::shared_ptr<CommitThread> mThread;
+
+        int64_t mSubmitted;
+        int64_t mBatches;
+        int64_t mCommitted;
+        int64_t mFailed;
+        int64_t mRetried;
+        int64_t mRunSeparately;
+        int64_t mLastBatchSize;
+    };
+    typedef boost::shared_ptr<DbLiteGroupCommit> DbLiteGroupCommitPtr;
+};
+#endif
+#endif
+#endif
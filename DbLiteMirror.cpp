@@ -0,0 +1,629 @@
+#ifndef FORTE_NO_DB
+#ifdef FORTE_WITH_SQLITE
+
+#include "DbLiteMirror.h"
+#include "AutoFD.h"
+#include "Clock.h"
+#include "LogManager.h"
+#include "FTrace.h"
+#include "Thread.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Forte;
+
+// pages read from the primary at a time
+static const unsigned int SCAN_CHUNK_BYTES = 1024 * 1024;
+
+// fields in the header of the first page
+static const unsigned int HEADER_SIZE = 100;
+static const unsigned int HEADER_PAGE_SIZE = 16;
+static const unsigned int HEADER_WRITE_VERSION = 18;
+static const unsigned int HEADER_READ_VERSION = 19;
+static const unsigned int HEADER_CHANGE_COUNTER = 24;
+static const unsigned int HEADER_PAGE_COUNT = 28;
+static const unsigned int HEADER_VERSION_VALID_FOR = 92;
+
+// the rollback journal sqlite plays back when it finds one left
+// behind, see "The Rollback Journal" in sqlite's file format docs
+static const unsigned char JOURNAL_MAGIC[8] = {
+    0xd9, 0xd5, 0x05, 0xf9, 0x20, 0xa1, 0x63, 0xd7
+};
+static const unsigned int JOURNAL_SECTOR_SIZE = 512;
+
+static uint32_t getBigEndian32(const char *p)
+{
+    const unsigned char *u = reinterpret_cast<const unsigned char*>(p);
+    return (u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+static void putBigEndian32(char *p, uint32_t value)
+{
+    p[0] = (value >> 24) & 0xff;
+    p[1] = (value >> 16) & 0xff;
+    p[2] = (value >> 8) & 0xff;
+    p[3] = value & 0xff;
+}
+
+static bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+DbLiteMirror::DbLiteMirror(const FString &primaryPath,
+                           const FString &mirrorPath,
+                           unsigned int maxBytesPerSecond) :
+    mPrimaryPath(primaryPath),
+    mMirrorPath(mirrorPath),
+    mMaxBytesPerSecond(maxBytesPerSecond),
+    mWriterLock(NULL),
+    mReader(NULL),
+    mMirror(NULL),
+    mPageSize(0),
+    mDataVersion(-1),
+    mSyncs(0),
+    mSyncsSkipped(0),
+    mPagesScanned(0),
+    mPagesCopied(0),
+    mLastSyncMillisec(0),
+    mLagMillisec(0)
+{
+    registerStatVariable<0>("syncs", &DbLiteMirror::mSyncs);
+    registerStatVariable<1>("syncsSkipped", &DbLiteMirror::mSyncsSkipped);
+    registerStatVariable<2>("pagesScanned", &DbLiteMirror::mPagesScanned);
+    registerStatVariable<3>("pagesCopied", &DbLiteMirror::mPagesCopied);
+    registerStatVariable<4>("lastSyncMillisec",
+                            &DbLiteMirror::mLastSyncMillisec);
+    registerStatVariable<5>("lagMillisec", &DbLiteMirror::mLagMillisec);
+
+    if (mPrimaryPath == mMirrorPath)
+    {
+        hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                           FStringFC(), "[%s] can not mirror a database "
+                           "to itself", mPrimaryPath.c_str()));
+    }
+
+    try
+    {
+        mWriterLock = open(mPrimaryPath, SQLITE_OPEN_READWRITE);
+        mReader = open(mPrimaryPath, SQLITE_OPEN_READWRITE);
+        mMirror = open(mMirrorPath,
+                       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+
+        // the primary's journal mode is kept in the file, the
+        // mirror's is set each time it is opened
+        FString mode;
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(mWriterLock, "PRAGMA journal_mode = WAL", -1,
+                               &stmt, NULL) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            mode = reinterpret_cast<const char*>(
+                sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        if (mode.MakeLower() != "wal")
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] could not switch to WAL "
+                               "mode: %s", mPrimaryPath.c_str(),
+                               sqlite3_errmsg(mWriterLock)));
+        }
+        // the reader only notices WAL mode once it has read something
+        exec(mReader, "SELECT count(*) FROM sqlite_master");
+        exec(mMirror, "PRAGMA journal_mode = DELETE");
+
+        // sqlite writes a new header into an empty database when it
+        // commits, which would replace the first page copied into it
+        exec(mMirror, "PRAGMA user_version = 0");
+    }
+    catch (...)
+    {
+        sqlite3_close(mMirror);
+        sqlite3_close(mReader);
+        sqlite3_close(mWriterLock);
+        throw;
+    }
+}
+
+DbLiteMirror::~DbLiteMirror()
+{
+    sqlite3_close(mMirror);
+    sqlite3_close(mReader);
+    sqlite3_close(mWriterLock);
+}
+
+sqlite3* DbLiteMirror::open(const FString &path, int flags)
+{
+    sqlite3 *db = NULL;
+    const int err = sqlite3_open_v2(path, &db, flags, NULL);
+    if (err != SQLITE_OK)
+    {
+        const FString msg(db != NULL ? sqlite3_errmsg(db) : "out of memory");
+        sqlite3_close(db);
+        hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                           FStringFC(), "[%s] could not open: %s",
+                           path.c_str(), msg.c_str()));
+    }
+    sqlite3_busy_timeout(db, 5000);
+    return db;
+}
+
+void DbLiteMirror::exec(sqlite3 *db, const char *sql)
+{
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        hlog_and_throw(HLOG_WARN, EDbLiteMirror(
+                           FStringFC(), "[%s] %s failed: %s",
+                           sqlite3_db_filename(db, "main"), sql,
+                           sqlite3_errmsg(db)));
+    }
+}
+
+sqlite3_file* DbLiteMirror::getFile(sqlite3 *db)
+{
+    sqlite3_file *file = NULL;
+    if (sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER,
+                             &file) != SQLITE_OK ||
+        file == NULL || file->pMethods == NULL)
+    {
+        hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                           FStringFC(), "[%s] no file handle",
+                           sqlite3_db_filename(db, "main")));
+    }
+    return file;
+}
+
+int64_t DbLiteMirror::dataVersion(void)
+{
+    // changes each time another connection commits
+    int64_t version = -1;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(mReader, "PRAGMA data_version", -1, &stmt, NULL)
+        == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        version = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+bool DbLiteMirror::pinSnapshot(Timespec &snapshotTime, int64_t &version)
+{
+    // with writers held off, a checkpoint that gets through the
+    // whole WAL leaves nothing newer than the database file, so the
+    // read transaction started next reads the file alone and keeps
+    // further checkpoints out of it until it ends
+    exec(mWriterLock, "BEGIN IMMEDIATE");
+
+    bool pinned = false;
+    try
+    {
+        int logFrames = -1, checkpointed = -1;
+        const int err = sqlite3_wal_checkpoint_v2(mReader, "main",
+                                                  SQLITE_CHECKPOINT_PASSIVE,
+                                                  &logFrames, &checkpointed);
+        if (err == SQLITE_OK && logFrames >= 0 && logFrames == checkpointed)
+        {
+            exec(mReader, "BEGIN");
+            exec(mReader, "SELECT count(*) FROM sqlite_master");
+            version = dataVersion();
+            snapshotTime = RealtimeClock().GetTime();
+            pinned = true;
+        }
+        else
+        {
+            hlog(HLOG_DEBUG, "[%s] checkpointed %d of %d WAL frames (%d)",
+                 mPrimaryPath.c_str(), checkpointed, logFrames, err);
+        }
+    }
+    catch (...)
+    {
+        sqlite3_exec(mReader, "ROLLBACK", NULL, NULL, NULL);
+        sqlite3_exec(mWriterLock, "ROLLBACK", NULL, NULL, NULL);
+        throw;
+    }
+
+    exec(mWriterLock, "ROLLBACK");
+    return pinned;
+}
+
+int DbLiteMirror::Sync(void)
+{
+    FTRACE2("%s -> %s", mPrimaryPath.c_str(), mMirrorPath.c_str());
+
+    MonotonicClock clock;
+    const Timespec start(clock.GetTime());
+
+    Timespec snapshotTime;
+    int64_t version = -1;
+    if (!pinSnapshot(snapshotTime, version))
+    {
+        ++mSyncsSkipped;
+        UpdateLag();
+        return -1;
+    }
+
+    std::vector<uint32_t> changed;
+    try
+    {
+        sqlite3_file *primary = getFile(mReader);
+        sqlite3_int64 size = 0;
+        char header[HEADER_SIZE];
+        if (primary->pMethods->xFileSize(primary, &size) != SQLITE_OK ||
+            size < (sqlite3_int64) HEADER_SIZE ||
+            primary->pMethods->xRead(primary, header, HEADER_SIZE, 0)
+            != SQLITE_OK)
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] could not read the header",
+                               mPrimaryPath.c_str()));
+        }
+
+        unsigned int pageSize =
+            ((unsigned char) header[HEADER_PAGE_SIZE] << 8) |
+            (unsigned char) header[HEADER_PAGE_SIZE + 1];
+        if (pageSize == 1)
+            pageSize = 65536;
+        if (pageSize < 512 || (pageSize & (pageSize - 1)) != 0)
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] bad page size %u",
+                               mPrimaryPath.c_str(), pageSize));
+        }
+        const uint32_t pageCount = size / pageSize;
+
+        if (pageSize != mPageSize)
+            loadMirrorChecksums(getFile(mMirror), pageSize);
+
+        // scan
+        std::vector<uint64_t> checksums(pageCount);
+        const unsigned int chunkPages =
+            std::max(1U, SCAN_CHUNK_BYTES / pageSize);
+        std::vector<char> chunk(chunkPages * pageSize);
+        const Timespec scanStart(clock.GetTime());
+        for (uint32_t first = 0; first < pageCount; first += chunkPages)
+        {
+            const uint32_t n = std::min(chunkPages, pageCount - first);
+            if (primary->pMethods->xRead(primary, &chunk[0], n * pageSize,
+                                         (sqlite3_int64) first * pageSize)
+                != SQLITE_OK)
+            {
+                hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                                   FStringFC(), "[%s] read failed at page %u",
+                                   mPrimaryPath.c_str(), first + 1));
+            }
+
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                const uint32_t page = first + i;
+                checksums[page] = checksum(&chunk[i * pageSize], pageSize);
+                // the first page always goes, for its change counter
+                if (page == 0 || page >= mChecksums.size() ||
+                    mChecksums[page] != checksums[page])
+                {
+                    changed.push_back(page);
+                }
+            }
+
+            if (Thread::IsForteThreadAndShuttingDown())
+            {
+                sqlite3_exec(mReader, "ROLLBACK", NULL, NULL, NULL);
+                return -1;
+            }
+            throttle((uint64_t) (first + n) * pageSize,
+                     clock.GetTime() - scanStart);
+        }
+
+        writeMirror(primary, changed, pageSize, pageCount);
+        mChecksums.swap(checksums);
+        mPageSize = pageSize;
+        mPagesScanned += pageCount;
+    }
+    catch (...)
+    {
+        sqlite3_exec(mReader, "ROLLBACK", NULL, NULL, NULL);
+        // the mirror may be part written, check every page next time
+        mChecksums.clear();
+        mPageSize = 0;
+        throw;
+    }
+
+    exec(mReader, "COMMIT");
+
+    ++mSyncs;
+    mPagesCopied += changed.size();
+    mLastSyncMillisec = (clock.GetTime() - start).AsMillisec();
+    mSnapshotTime = snapshotTime;
+    mDataVersion = version;
+    UpdateLag();
+
+    hlog(HLOG_DEBUG, "[%s] copied %zu of %zu pages to %s in %lld ms",
+         mPrimaryPath.c_str(), changed.size(), mChecksums.size(),
+         mMirrorPath.c_str(), (long long) mLastSyncMillisec);
+    return changed.size();
+}
+
+void DbLiteMirror::loadMirrorChecksums(sqlite3_file *mirror,
+                                       unsigned int pageSize)
+{
+    mChecksums.clear();
+
+    // reading through sqlite rolls back a sync that was cut short,
+    // so the pages checksummed below are the ones the mirror keeps
+    sqlite3_exec(mMirror, "SELECT count(*) FROM sqlite_master",
+                 NULL, NULL, NULL);
+
+    sqlite3_int64 size = 0;
+    if (mirror->pMethods->xFileSize(mirror, &size) != SQLITE_OK)
+        return;
+
+    const uint32_t pageCount = size / pageSize;
+    std::vector<char> page(pageSize);
+    MonotonicClock clock;
+    const Timespec start(clock.GetTime());
+    for (uint32_t i = 0; i < pageCount; ++i)
+    {
+        if (mirror->pMethods->xRead(mirror, &page[0], pageSize,
+                                    (sqlite3_int64) i * pageSize)
+            != SQLITE_OK)
+        {
+            mChecksums.clear();
+            return;
+        }
+        mChecksums.push_back(checksum(&page[0], pageSize));
+        throttle((uint64_t) (i + 1) * pageSize, clock.GetTime() - start);
+    }
+}
+
+void DbLiteMirror::writeMirror(sqlite3_file *primary,
+                               const std::vector<uint32_t> &pages,
+                               unsigned int pageSize,
+                               uint32_t pageCount)
+{
+    // readers of the mirror wait until all of it is written
+    exec(mMirror, "BEGIN EXCLUSIVE");
+
+    try
+    {
+        sqlite3_file *mirror = getFile(mMirror);
+
+        uint32_t counter = 0;
+        sqlite3_int64 size = 0;
+        char header[HEADER_SIZE];
+        if (mirror->pMethods->xFileSize(mirror, &size) == SQLITE_OK &&
+            size >= (sqlite3_int64) HEADER_SIZE &&
+            mirror->pMethods->xRead(mirror, header, HEADER_SIZE, 0)
+            == SQLITE_OK)
+        {
+            counter = getBigEndian32(&header[HEADER_CHANGE_COUNTER]);
+        }
+
+        // if the writes below are cut short, whoever opens the mirror
+        // next finds the journal and puts the old pages back
+        const FString journal(
+            writeJournal(mirror, pages, pageSize, pageCount, counter + 1));
+
+        std::vector<char> page(pageSize);
+        for (std::vector<uint32_t>::const_iterator i = pages.begin();
+             i != pages.end(); ++i)
+        {
+            const sqlite3_int64 offset = (sqlite3_int64) *i * pageSize;
+            if (primary->pMethods->xRead(primary, &page[0], pageSize, offset)
+                != SQLITE_OK)
+            {
+                hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                                   FStringFC(), "[%s] read failed at page %u",
+                                   mPrimaryPath.c_str(), *i + 1));
+            }
+
+            if (*i == 0)
+            {
+                // a rollback journal database, changed since readers
+                // last looked
+                page[HEADER_WRITE_VERSION] = 1;
+                page[HEADER_READ_VERSION] = 1;
+                putBigEndian32(&page[HEADER_CHANGE_COUNTER], counter + 1);
+                putBigEndian32(&page[HEADER_PAGE_COUNT], pageCount);
+                putBigEndian32(&page[HEADER_VERSION_VALID_FOR], counter + 1);
+            }
+
+            if (mirror->pMethods->xWrite(mirror, &page[0], pageSize, offset)
+                != SQLITE_OK)
+            {
+                hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                                   FStringFC(), "[%s] write failed at page %u",
+                                   mMirrorPath.c_str(), *i + 1));
+            }
+        }
+
+        if (mirror->pMethods->xTruncate(
+                mirror, (sqlite3_int64) pageCount * pageSize) != SQLITE_OK ||
+            mirror->pMethods->xSync(mirror, SQLITE_SYNC_NORMAL) != SQLITE_OK)
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] sync failed",
+                               mMirrorPath.c_str()));
+        }
+
+        // still under the exclusive lock, so no reader can mistake
+        // the journal for one left by a crash
+        if (unlink(journal) != 0)
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] could not remove the "
+                               "journal: %s", journal.c_str(),
+                               strerror(errno)));
+        }
+    }
+    catch (...)
+    {
+        // a journal left behind is played back by the next reader of
+        // the mirror, this connection included
+        sqlite3_exec(mMirror, "ROLLBACK", NULL, NULL, NULL);
+        throw;
+    }
+
+    exec(mMirror, "COMMIT");
+}
+
+FString DbLiteMirror::writeJournal(sqlite3_file *mirror,
+                                   const std::vector<uint32_t> &pages,
+                                   unsigned int pageSize,
+                                   uint32_t pageCount,
+                                   uint32_t nonce)
+{
+    // the pages about to be overwritten, and those the truncate drops
+    sqlite3_int64 size = 0;
+    if (mirror->pMethods->xFileSize(mirror, &size) != SQLITE_OK)
+    {
+        hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                           FStringFC(), "[%s] could not get the size",
+                           mMirrorPath.c_str()));
+    }
+    const uint32_t oldPageCount = (size + pageSize - 1) / pageSize;
+    std::vector<uint32_t> saved;
+    for (std::vector<uint32_t>::const_iterator i = pages.begin();
+         i != pages.end() && *i < oldPageCount; ++i)
+    {
+        saved.push_back(*i);
+    }
+    for (uint32_t i = pageCount; i < oldPageCount; ++i)
+        saved.push_back(i);
+
+    // where sqlite looks for it, with the mirror's permissions
+    const FString path(sqlite3_db_filename(mMirror, "main"));
+    const FString journal(path + "-journal");
+    struct stat st;
+    const mode_t mode = (stat(path, &st) == 0) ? (st.st_mode & 0777) : 0644;
+    AutoFD fd(::open(journal, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     mode));
+    if (fd == AutoFD::NONE)
+    {
+        hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                           FStringFC(), "[%s] could not create: %s",
+                           journal.c_str(), strerror(errno)));
+    }
+
+    try
+    {
+        // the old size is restored along with the pages
+        std::vector<char> header(JOURNAL_SECTOR_SIZE);
+        memcpy(&header[0], JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        putBigEndian32(&header[8], saved.size());
+        putBigEndian32(&header[12], nonce);
+        putBigEndian32(&header[16], oldPageCount);
+        putBigEndian32(&header[20], JOURNAL_SECTOR_SIZE);
+        putBigEndian32(&header[24], pageSize);
+        bool ok = writeAll(fd, &header[0], header.size());
+
+        // page number, page, checksum
+        std::vector<char> record(pageSize + 8);
+        for (std::vector<uint32_t>::const_iterator i = saved.begin();
+             ok && i != saved.end(); ++i)
+        {
+            char *page = &record[4];
+            const int err = mirror->pMethods->xRead(
+                mirror, page, pageSize, (sqlite3_int64) *i * pageSize);
+            if (err != SQLITE_OK && err != SQLITE_IOERR_SHORT_READ)
+            {
+                hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                                   FStringFC(), "[%s] read failed at page %u",
+                                   mMirrorPath.c_str(), *i + 1));
+            }
+            uint32_t sum = nonce;
+            for (int j = pageSize - 200; j > 0; j -= 200)
+                sum += (unsigned char) page[j];
+            putBigEndian32(&record[0], *i + 1);
+            putBigEndian32(&record[4 + pageSize], sum);
+            ok = writeAll(fd, &record[0], record.size());
+        }
+
+        // on disk, name included, before the mirror is touched
+        AutoFD dir(::open(path.Left(path.rfind('/') + 1) + ".",
+                          O_RDONLY | O_CLOEXEC));
+        if (!ok || fsync(fd) != 0 || dir == AutoFD::NONE || fsync(dir) != 0)
+        {
+            hlog_and_throw(HLOG_ERR, EDbLiteMirror(
+                               FStringFC(), "[%s] write failed: %s",
+                               journal.c_str(), strerror(errno)));
+        }
+    }
+    catch (...)
+    {
+        // the mirror is untouched, an incomplete journal must not be
+        // played back over it
+        unlink(journal);
+        throw;
+    }
+    return journal;
+}
+
+void DbLiteMirror::throttle(uint64_t bytes, const Timespec &elapsed)
+{
+    if (mMaxBytesPerSecond == 0)
+        return;
+
+    const long long wantMillisec = bytes * 1000 / mMaxBytesPerSecond;
+    const long long aheadMillisec = wantMillisec - elapsed.AsMillisec();
+    if (aheadMillisec > 0)
+        usleep(aheadMillisec * 1000);
+}
+
+Timespec DbLiteMirror::lastChange(void) const
+{
+    Timespec latest;
+    struct stat st;
+    if (stat(mPrimaryPath, &st) == 0)
+        latest = st.st_mtim;
+    if (stat(mPrimaryPath + "-wal", &st) == 0 && Timespec(st.st_mtim) > latest)
+        latest = st.st_mtim;
+    return latest;
+}
+
+bool DbLiteMirror::UpdateLag(void)
+{
+    if (!mSnapshotTime.IsZero() && dataVersion() == mDataVersion)
+    {
+        mLagMillisec = 0;
+        return false;
+    }
+
+    // behind since the last snapshot, or since the primary was last
+    // written if there has not been one
+    const Timespec now(RealtimeClock().GetTime());
+    const Timespec since(mSnapshotTime.IsZero() ? lastChange() : mSnapshotTime);
+    mLagMillisec = (now > since) ? (now - since).AsMillisec() : 0;
+    return true;
+}
+
+uint64_t DbLiteMirror::checksum(const char *page, unsigned int size)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+    for (unsigned int i = 0; i + sizeof(uint64_t) <= size;
+         i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, page + i, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+#endif
+#endif
@@ -0,0 +1,135 @@
+#ifndef __DbLiteMirror_h
+#define __DbLiteMirror_h
+
+#ifndef FORTE_NO_DB
+#ifdef FORTE_WITH_SQLITE
+
+#include <sqlite3.h>
+#include <vector>
+#include <stdint.h>
+#include "Clock.h"
+#include "DbException.h"
+#include "EnableStats.h"
+#include "FString.h"
+#include "Locals.h"
+#include "Object.h"
+
+namespace Forte
+{
+    EXCEPTION_SUBCLASS(DbException, EDbLiteMirror);
+
+    /**
+     * DbLiteMirror keeps a copy of a sqlite database up to date by
+     * writing only the pages that changed, instead of copying the
+     * whole database with sqlite3_backup as
+     * DbLiteConnection::BackupDatabase() does.
+     *
+     * The primary is put in WAL mode. Sync() holds off writers just
+     * long enough to checkpoint the WAL into the database file and
+     * start a read transaction on it. A reader that starts on a fully
+     * checkpointed WAL keeps any later checkpoint from writing to the
+     * database file, so the file stays a consistent snapshot while it
+     * is scanned, and writers carry on appending to the WAL. Each
+     * page's checksum is compared to the one from the last Sync(), and
+     * the pages that differ are written to the mirror under an
+     * exclusive lock, so readers of the mirror never see half a sync.
+     *
+     * The mirror is an ordinary (rollback journal) database, byte for
+     * byte the same as the primary except in the header of the first
+     * page: the file format bytes say it is not in WAL mode, and the
+     * change counter is bumped on every sync so readers of the mirror
+     * drop their caches. Before any page of the mirror is
+     * overwritten, the old pages go to a rollback journal in sqlite's
+     * own format, so a sync cut short by a crash is rolled back by
+     * the next connection to read the mirror.
+     *
+     * maxBytesPerSecond limits how fast the primary is scanned; 0 is
+     * no limit. The pages found are then written in one go so the
+     * mirror is locked for as short a time as possible.
+     *
+     * Stats: syncs, syncs skipped because the WAL could not be
+     * checkpointed, pages scanned and copied, the duration of the last
+     * sync, and lagMillisec, how long the primary has had changes the
+     * mirror does not (updated by Sync() and UpdateLag()).
+     */
+    class DbLiteMirror :
+        public Object,
+        public EnableStats<DbLiteMirror,
+                           Locals<DbLiteMirror,
+                                  int64_t, int64_t, int64_t, int64_t,
+                                  int64_t, int64_t> >
+    {
+    public:
+        DbLiteMirror(const FString &primaryPath,
+                     const FString &mirrorPath,
+                     unsigned int maxBytesPerSecond = 0);
+        virtual ~DbLiteMirror();
+
+        /**
+         * Bring the mirror up to date with the primary. Returns the
+         * number of pages written, or -1 if readers of older snapshots
+         * kept the WAL from being checkpointed and it should be tried
+         * again later. Throws EDbLiteMirror.
+         */
+        int Sync(void);
+
+        /**
+         * Update lagMillisec. Returns true if the primary has changed
+         * since the last Sync(), or there has not been one.
+         */
+        bool UpdateLag(void);
+
+        void SetMaxBytesPerSecond(unsigned int maxBytesPerSecond) {
+            mMaxBytesPerSecond = maxBytesPerSecond;
+        }
+
+        const FString& GetPrimaryPath(void) const { return mPrimaryPath; }
+        const FString& GetMirrorPath(void) const { return mMirrorPath; }
+
+    protected:
+        sqlite3* open(const FString &path, int flags);
+        void exec(sqlite3 *db, const char *sql);
+        sqlite3_file* getFile(sqlite3 *db);
+        int64_t dataVersion(void);
+        bool pinSnapshot(Timespec &snapshotTime, int64_t &version);
+        void loadMirrorChecksums(sqlite3_file *mirror, unsigned int pageSize);
+        void throttle(uint64_t bytes, const Timespec &elapsed);
+        void writeMirror(sqlite3_file *primary,
+                         const std::vector<uint32_t> &pages,
+                         unsigned int pageSize,
+                         uint32_t pageCount);
+        FString writeJournal(sqlite3_file *mirror,
+                             const std::vector<uint32_t> &pages,
+                             unsigned int pageSize,
+                             uint32_t pageCount,
+                             uint32_t nonce);
+        Timespec lastChange(void) const;
+
+        static uint64_t checksum(const char *page, unsigned int size);
+
+        const FString mPrimaryPath;
+        const FString mMirrorPath;
+        unsigned int mMaxBytesPerSecond;
+
+        sqlite3 *mWriterLock;   // holds off writers while pinning
+        sqlite3 *mReader;       // reads the pinned snapshot
+        sqlite3 *mMirror;
+
+        // checksum of each page in the mirror, empty until loaded
+        std::vector<uint64_t> mChecksums;
+        unsigned int mPageSize;
+        Timespec mSnapshotTime; // realtime of the snapshot last synced
+        int64_t mDataVersion;   // and its PRAGMA data_version
+
+        int64_t mSyncs;
+        int64_t mSyncsSkipped;
+        int64_t mPagesScanned;
+        int64_t mPagesCopied;
+        int64_t mLastSyncMillisec;
+        int64_t mLagMillisec;
+    };
+    typedef boost::shared_ptr<DbLiteMirror> DbLiteMirrorPtr;
+};
+#endif
+#endif
+#endif
@@ -28,7 +28,8 @@ DbLiteResult::LiteData::LiteData()
     Data()
 {
     mOkay = true;
-    mCurrentRow = mNextRow = mRes.end();
+    mNumRows = 0;
+    mCurrentRow = mNextRow = 0;
 }
 
 
@@ -37,55 +38,57 @@ DbLiteResult::LiteData::~LiteData()
 }
 
 
+void DbLiteResult::LiteData::clear(void)
+{
+    mColumns.clear();
+    mArena.clear();
+    mColNames.clear();
+    mNumRows = 0;
+    mCurrentRow = mNextRow = 0;
+}
+
+
 int DbLiteResult::LiteData::Load(sqlite3_stmt *stmt)
 {
     const char *sql=sqlite3_sql(stmt);
     FTRACE2("%s", sql);
-    int i, n, err, type;
-    Val val;
-    Row row;
+    int i, n, err;
 
     // clear data
     mOkay = false;  // in case of some exception being thrown
-    mColNames.clear();
-    mRes.clear();
+    clear();
     n = sqlite3_column_count(stmt);
+    mColumns.resize(n);
 
     // run statement
     hlog(HLOG_DEBUG2, "[%s] before step", sql);
     while ((err = sqlite3_step(stmt)) == SQLITE_ROW)
     {
-        // init row
-        row.clear();
-        row.reserve(n);
-
-        // fetch values one column at a time
+        // copy values one column at a time
         for (i=0; i<n; i++)
         {
-            type = sqlite3_column_type(stmt, i);
+            Column &column(mColumns[i]);
+            column.mOffsets.push_back(mArena.size());
 
-            if (type == SQLITE_NULL)
+            if (sqlite3_column_type(stmt, i) == SQLITE_NULL)
             {
-                val.first.clear();
-                val.second = true;
-            }
-            else if (type == SQLITE_BLOB)
-            {
-                val.first.assign(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, i)),
-                                 sqlite3_column_bytes(stmt, i));
-                val.second = false;
+                column.mLengths.push_back(0);
+                column.mNulls.push_back(true);
             }
             else
             {
-                val.first = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
-                val.second = false;
+                // text first, so blobs get a terminator as well
+                const char *value = reinterpret_cast<const char*>(
+                    sqlite3_column_text(stmt, i));
+                const int len = sqlite3_column_bytes(stmt, i);
+                mArena.insert(mArena.end(), value, value + len);
+                mArena.push_back(0);
+                column.mLengths.push_back(len);
+                column.mNulls.push_back(false);
             }
-
-            row.push_back(val);
         }
 
-        // store row
-        mRes.push_back(row);
+        ++mNumRows;
     }
 
     // check code
@@ -94,7 +97,7 @@ int DbLiteResult::LiteData::Load(sqlite3_stmt *stmt)
     if (err == SQLITE_OK)
     {
         // load column names
-        mColNames.resize(n);
+        mColNames.reserve(n);
 
         for (i=0; i<n; i++)
         {
@@ -102,18 +105,18 @@ int DbLiteResult::LiteData::Load(sqlite3_stmt *stmt)
         }
 
         // okay
-        mNextRow = mRes.begin();
+        mNextRow = 0;
         mOkay = true;
     }
     else
     {
         // not okay
-        mNextRow = mRes.end();
+        mNextRow = mNumRows;
         mOkay = false;
     }
 
     // done
-    mCurrentRow = mRes.end();
+    mCurrentRow = mNumRows;
     return err;
 }
 
@@ -126,17 +129,17 @@ bool DbLiteResult::LiteData::IsOkay() const
 
 bool DbLiteResult::LiteData::FetchRow(DbResultRow& row /*OUT*/)
 {
-    Row::iterator ri;
-    if (mNextRow == mRes.end()) return false;
+    if (mNextRow >= mNumRows) return false;
     mCurrentRow = mNextRow;
     ++mNextRow;
     row.clear();
-    row.reserve(mCurrentRow->size());
+    row.reserve(mColumns.size());
 
-    for (ri = mCurrentRow->begin(); ri != mCurrentRow->end(); ++ri)
+    for (std::vector<Column>::const_iterator ci = mColumns.begin();
+         ci != mColumns.end(); ++ci)
     {
-        if (ri->second) row.push_back(NULL);
-        else row.push_back(ri->first.c_str());
+        if (ci->mNulls[mCurrentRow]) row.push_back(NULL);
+        else row.push_back(&mArena[ci->mOffsets[mCurrentRow]]);
     }
 
     return true;
@@ -144,8 +147,7 @@ bool DbLiteResult::LiteData::FetchRow(DbResultRow& row /*OUT*/)
 
 void DbLiteResult::LiteData::UnFetchRow()
 {
-    Row::iterator ri;
-    if (mCurrentRow == mRes.begin()) return;
+    if (mCurrentRow == 0 || mCurrentRow >= mNumRows) return;
     --mCurrentRow;
     --mNextRow;
 }
@@ -164,13 +166,14 @@ FString DbLiteResult::LiteData::GetColumnName(size_t i)
 
 size_t DbLiteResult::LiteData::GetFieldLength(size_t i)
 {
-    return (*mCurrentRow)[i].first.size();
+    if (mCurrentRow >= mNumRows) return 0;
+    return mColumns[i].mLengths[mCurrentRow];
 }
 
 
 size_t DbLiteResult::LiteData::GetNumRows()
 {
-    return mRes.size();
+    return mNumRows;
 }
 
 
@@ -178,16 +181,186 @@ bool DbLiteResult::LiteData::Seek(size_t offset)
 {
     size_t i;
 
-    mCurrentRow = mRes.end();
-    mNextRow = mRes.begin();
+    mCurrentRow = mNumRows;
+    mNextRow = 0;
 
-    for (i=0; i<offset && mNextRow != mRes.end(); i++)
+    for (i=0; i<offset && mNextRow < mNumRows; i++)
     {
         mCurrentRow = mNextRow;
         ++mNextRow;
     }
 
-    return (mNextRow != mRes.end());
+    return (mNextRow < mNumRows);
+}
+
+
+// DbLiteResult::LiteStreamData class
+DbLiteResult::LiteStreamData::LiteStreamData(sqlite3_stmt *stmt,
+                                             int firstStep,
+                                             DbLiteConnection *connection,
+                                             const FString& cacheKey)
+:
+    Data(),
+    mStmt(stmt),
+    mConnection(connection),
+    mCacheKey(cacheKey),
+    mNumRows(0),
+    mFetched(false),
+    mOkay(true)
+{
+    const int n = sqlite3_column_count(stmt);
+    mColNames.reserve(n);
+    for (int i=0; i<n; i++)
+    {
+        mColNames.push_back(sqlite3_column_name(stmt, i));
+    }
+
+    mConnection->addStream(this);
+    if (firstStep != SQLITE_ROW)
+        Finish(false);
+}
+
+
+DbLiteResult::LiteStreamData::~LiteStreamData()
+{
+    Finish(false);
+}
+
+
+void DbLiteResult::LiteStreamData::Finish(bool finalize)
+{
+    if (mStmt == NULL) return;
+    sqlite3_stmt *stmt = mStmt;
+    mStmt = NULL;
+    mFetched = false;
+    mConnection->endStream(this, stmt, mCacheKey, finalize);
+}
+
+
+bool DbLiteResult::LiteStreamData::step(void)
+{
+    const int err = sqlite3_step(mStmt);
+    if (err == SQLITE_ROW) return true;
+
+    if (err != SQLITE_DONE)
+    {
+        hlog(HLOG_WARN, "[%s] step failed after %zu rows. Error was %d.",
+             sqlite3_sql(mStmt), mNumRows, err);
+        mOkay = false;
+    }
+    Finish(false);
+    return false;
+}
+
+
+bool DbLiteResult::LiteStreamData::IsOkay() const
+{
+    return mOkay;
+}
+
+
+// moves past the row last fetched, if any
+bool DbLiteResult::LiteStreamData::next(void)
+{
+    if (mStmt == NULL) return false;
+    if (mFetched)
+    {
+        mFetched = false;
+        if (!step()) return false;
+    }
+    return true;
+}
+
+
+bool DbLiteResult::LiteStreamData::FetchRow(DbResultRow& row /*OUT*/)
+{
+    if (!next()) return false;
+
+    const int n = mColNames.size();
+    row.clear();
+    row.reserve(n);
+
+    for (int i=0; i<n; i++)
+    {
+        if (sqlite3_column_type(mStmt, i) == SQLITE_NULL) row.push_back(NULL);
+        else row.push_back(reinterpret_cast<const char*>(
+                               sqlite3_column_text(mStmt, i)));
+    }
+
+    mFetched = true;
+    ++mNumRows;
+    return true;
+}
+
+
+bool DbLiteResult::LiteStreamData::FetchRow(DbRow& row /*OUT*/)
+{
+    if (!next()) return false;
+
+    row.Set(mStmt);
+
+    mFetched = true;
+    ++mNumRows;
+    return true;
+}
+
+
+void DbLiteResult::LiteStreamData::UnFetchRow()
+{
+    if (!mFetched)
+    {
+        throw Exception("DbLiteResult::UnFetchRow can only unfetch the "
+                        "last row of a streamed result");
+    }
+    mFetched = false;
+    --mNumRows;
+}
+
+
+size_t DbLiteResult::LiteStreamData::GetNumColumns()
+{
+    return mColNames.size();
+}
+
+
+FString DbLiteResult::LiteStreamData::GetColumnName(size_t i)
+{
+    return mColNames[i];
+}
+
+
+size_t DbLiteResult::LiteStreamData::GetFieldLength(size_t i)
+{
+    if (!mFetched) return 0;
+    return sqlite3_column_bytes(mStmt, i);
+}
+
+
+size_t DbLiteResult::LiteStreamData::GetNumRows()
+{
+    return mNumRows;
+}
+
+
+bool DbLiteResult::LiteStreamData::Seek(size_t offset)
+{
+    if (offset < mNumRows)
+    {
+        throw Exception("DbLiteResult::Seek can not go back in a "
+                        "streamed result");
+    }
+
+    DbResultRow row;
+    while (mNumRows < offset)
+    {
+        if (!FetchRow(row)) return false;
+    }
+    if (mFetched)
+    {
+        mFetched = false;
+        if (!step()) return false;
+    }
+    return (mStmt != NULL);
 }
 
 #endif
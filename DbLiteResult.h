@@ -6,16 +6,37 @@
 
 #include "DbResult.h"
 #include <sqlite3.h>
+#include <stdint.h>
 #include <vector>
-#include <list>
 
 namespace Forte
 {
     class DbLiteConnection;
 
+    /**
+     * DbLiteResult holds the rows of a sqlite query in one of two
+     * ways.
+     *
+     * Load() (what Store() uses) steps through all the rows up
+     * front. Every cell's bytes are copied, NUL terminated, into one
+     * arena and each column keeps arrays of offsets into it, lengths
+     * and null flags, so a row costs no allocations of its own.
+     *
+     * Stream() (what Use() uses) keeps the statement and steps it as
+     * rows are fetched. The pointers handed out by FetchRow() are
+     * only good until the next FetchRow(), GetNumRows() is the
+     * number of rows fetched so far, and only the last row fetched
+     * can be unfetched. The statement goes back to its connection
+     * once the last row has been fetched or the result is released;
+     * closing the connection ends the result. FetchRow(DbRow&) gives
+     * the row the statement itself, so rows generated by dbc read
+     * each column's value without converting it to text and back.
+     */
     class DbLiteResult : public DbResult
     {
     protected:
+        friend class DbLiteConnection;
+
         class LiteData : public Data
         {
         public:
@@ -38,16 +59,65 @@ namespace Forte
 
         protected:
             friend class DbLiteResult;
-            typedef std::pair<FString, bool> Val;
-            typedef std::vector<Val> Row;
-            typedef std::list<Row> RowList;
+            struct Column {
+                std::vector<uint64_t> mOffsets;
+                std::vector<uint32_t> mLengths;
+                std::vector<bool> mNulls;
+            };
             typedef std::vector<FString> NameVector;
-            RowList::iterator mCurrentRow, mNextRow;
+
+            void clear(void);
+
+            std::vector<Column> mColumns;
+            std::vector<char> mArena;
             NameVector mColNames;
-            RowList mRes;
+            size_t mNumRows;
+            size_t mCurrentRow, mNextRow; // mNumRows when none
             bool mOkay;
          };
 
+        class LiteStreamData : public Data
+        {
+        public:
+            // the statement has been stepped once, to its first row
+            // (SQLITE_ROW) or to the end (SQLITE_DONE)
+            LiteStreamData(sqlite3_stmt *stmt, int firstStep,
+                           DbLiteConnection *connection,
+                           const FString& cacheKey);
+            virtual ~LiteStreamData();
+
+            // abstract interface
+            virtual bool IsOkay() const;
+            virtual bool FetchRow(DbResultRow& row /*OUT*/);
+            virtual void UnFetchRow();
+            virtual size_t GetNumColumns();
+            virtual FString GetColumnName(size_t i);
+            virtual size_t GetFieldLength(size_t i);
+            virtual size_t GetNumRows();
+            virtual bool Seek(size_t offset);
+
+            // hands the statement to DbRow::Set(sqlite3_stmt*)
+            // rather than the text of every column
+            virtual bool FetchRow(DbRow& row /*OUT*/);
+
+            // give the statement back to the connection, or just
+            // finalize it when the connection is going away
+            void Finish(bool finalize);
+
+        protected:
+            bool step(void);
+            bool next(void);
+
+            sqlite3_stmt *mStmt;
+            DbLiteConnection *mConnection;
+            const FString mCacheKey;
+            std::vector<FString> mColNames;
+            size_t mNumRows;
+            bool mHaveRow;     // mStmt is on a row not fetched yet
+            bool mFetched;     // mStmt is on the row last fetched
+            bool mOkay;
+        };
+
     public:
         DbLiteResult() : DbResult() { }
         DbLiteResult(const DbResult& other) : DbResult(other) { }
@@ -46,6 +46,9 @@ namespace Forte
         virtual uint64_t AffectedRows() { return mysql_affected_rows(mDB); }
         virtual FString Escape(const char *str);
 
+    protected:
+        virtual bool stringsHaveBackslashEscapes() const { return true; }
+
     private:
         MYSQL mMySQL, *mDB;
     };
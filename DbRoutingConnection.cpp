@@ -0,0 +1,418 @@
+#include "DbRoutingConnection.h"
+#include "DbConnectionFactory.h"
+#include "DbSqlStatement.h"
+#include "Foreach.h"
+#include "LogManager.h"
+#include <boost/shared_ptr.hpp>
+#include <ctype.h>
+#include <strings.h>
+
+using namespace Forte;
+using namespace boost;
+
+DbReplicaSet::DbReplicaSet(const FStringVector& paths, unsigned int retrySeconds)
+    : mRetrySeconds(retrySeconds),
+      mNext(0)
+{
+    foreach (const FString &path, paths)
+    {
+        Replica replica;
+        replica.mPath = path;
+        replica.mOutstanding = 0;
+        replica.mQueries = 0;
+        mReplicas.push_back(replica);
+    }
+}
+
+const FString& DbReplicaSet::GetPath(size_t replica) const
+{
+    return mReplicas.at(replica).mPath;
+}
+
+int DbReplicaSet::Acquire()
+{
+    AutoUnlockMutex guard(mMutex);
+
+    const Timespec now(MonotonicClock().GetTime());
+    int best = -1;
+    for (size_t n = 0; n < mReplicas.size(); ++n)
+    {
+        const size_t i = (mNext + n) % mReplicas.size();
+        Replica &replica(mReplicas[i]);
+        if (!replica.mRetryAfter.IsZero())
+        {
+            if (now < replica.mRetryAfter)
+                continue;
+            replica.mRetryAfter = Timespec();
+        }
+        if (best < 0 || replica.mOutstanding < mReplicas[best].mOutstanding)
+            best = i;
+    }
+
+    if (best >= 0)
+    {
+        ++mReplicas[best].mOutstanding;
+        ++mReplicas[best].mQueries;
+        mNext = best + 1;
+    }
+    return best;
+}
+
+void DbReplicaSet::Release(size_t replica)
+{
+    AutoUnlockMutex guard(mMutex);
+    if (mReplicas.at(replica).mOutstanding > 0)
+        --mReplicas[replica].mOutstanding;
+}
+
+void DbReplicaSet::MarkFailed(size_t replica)
+{
+    AutoUnlockMutex guard(mMutex);
+    mReplicas.at(replica).mRetryAfter =
+        MonotonicClock().GetTime() + Timespec::FromSeconds(mRetrySeconds);
+}
+
+unsigned int DbReplicaSet::GetOutstanding(size_t replica) const
+{
+    AutoUnlockMutex guard(mMutex);
+    return mReplicas.at(replica).mOutstanding;
+}
+
+uint64_t DbReplicaSet::GetQueryCount(size_t replica) const
+{
+    AutoUnlockMutex guard(mMutex);
+    return mReplicas.at(replica).mQueries;
+}
+
+namespace
+{
+    // a streamed result, holding its query as running on the replica
+    // until the last row is fetched or the result is released
+    class ReplicaResult : public DbResult
+    {
+    public:
+        ReplicaResult(const DbResult& result,
+                      const boost::shared_ptr<void>& running)
+            : DbResult(result)
+        {
+            DbResult::operator =(new ReplicaData(mData, running));
+        }
+
+    protected:
+        class ReplicaData : public Data
+        {
+        public:
+            ReplicaData(Data *data, const boost::shared_ptr<void>& running)
+                : mData(data), mRunning(running) { mData->AddRef(); }
+            virtual ~ReplicaData() { mData->Release(); }
+
+            virtual bool IsOkay() const { return mData->IsOkay(); }
+            virtual bool FetchRow(DbResultRow& row) {
+                if (mData->FetchRow(row))
+                    return true;
+                mRunning.reset();
+                return false;
+            }
+            virtual bool FetchRow(DbRow& row) {
+                if (mData->FetchRow(row))
+                    return true;
+                mRunning.reset();
+                return false;
+            }
+            virtual void UnFetchRow() { mData->UnFetchRow(); }
+            virtual size_t GetNumColumns() { return mData->GetNumColumns(); }
+            virtual FString GetColumnName(size_t i) {
+                return mData->GetColumnName(i);
+            }
+            virtual size_t GetFieldLength(size_t i) {
+                return mData->GetFieldLength(i);
+            }
+            virtual size_t GetNumRows() { return mData->GetNumRows(); }
+            virtual bool Seek(size_t offset) { return mData->Seek(offset); }
+
+        private:
+            Data *mData;
+            boost::shared_ptr<void> mRunning;
+        };
+    };
+}
+
+DbRoutingConnection::DbRoutingConnection(
+    boost::shared_ptr<DbConnectionFactory> primaryDbConnectionFactory,
+    boost::shared_ptr<DbConnectionFactory> replicaDbConnectionFactory,
+    boost::shared_ptr<DbReplicaSet> replicas)
+    : mPrimaryDbConnectionFactory(primaryDbConnectionFactory),
+      mReplicaDbConnectionFactory(replicaDbConnectionFactory),
+      mReplicaSet(replicas),
+      mDbConnection(primaryDbConnectionFactory->create()),
+      mReplicaConnections(replicas->Size()),
+      mLastReplica(-1)
+{
+    mLast = mDbConnection.get();
+}
+
+DbRoutingConnection::~DbRoutingConnection()
+{
+}
+
+bool DbRoutingConnection::isMutableQuery(const FString& sql)
+{
+    const char *p = sql.c_str();
+    while (isspace(*p) || *p == '(')
+        ++p;
+    return (strncasecmp(p, "select", 6) != 0);
+}
+
+bool DbRoutingConnection::usePrimary() const
+{
+    // a transaction's reads have to see its writes
+    return (!mAutoCommit || mInTransaction || mDbConnection->HasPendingQueries());
+}
+
+DbConnection* DbRoutingConnection::primary()
+{
+    mLast = mDbConnection.get();
+    mLastReplica = -1;
+    return mLast;
+}
+
+DbConnection* DbRoutingConnection::acquireReplica(int& replica)
+{
+    for (size_t tries = 0; tries < mReplicaSet->Size(); ++tries)
+    {
+        replica = mReplicaSet->Acquire();
+        if (replica < 0)
+            return NULL;
+
+        boost::shared_ptr<DbConnection>& db(mReplicaConnections[replica]);
+        if (db)
+            return db.get();
+
+        const FString& path(mReplicaSet->GetPath(replica));
+        try
+        {
+            db.reset(mReplicaDbConnectionFactory->create());
+            if (db->Init(path, mUser, mPassword, mHost, mSocket, mRetries))
+                return db.get();
+
+            hlog(HLOG_WARN, "[%s] could not open replica: %s",
+                 path.c_str(), db->GetError().c_str());
+        }
+        catch (EDbConnection& e)
+        {
+            hlog(HLOG_WARN, "[%s] could not open replica: %s",
+                 path.c_str(), e.what());
+        }
+
+        db.reset();
+        mReplicaSet->Release(replica);
+        mReplicaSet->MarkFailed(replica);
+    }
+
+    return NULL;
+}
+
+DbResult DbRoutingConnection::keepRunning(
+    const DbResult& result, const boost::shared_ptr<ReplicaQuery>& running)
+{
+    return ReplicaResult(result, running);
+}
+
+template <typename Result, typename Query>
+Result DbRoutingConnection::route(Result (DbConnection::*run)(const Query&),
+                                  const Query& query,
+                                  bool mutator,
+                                  bool streamed)
+{
+    int replica = -1;
+    DbConnection *db = NULL;
+    if (!mutator && !usePrimary() && (db = acquireReplica(replica)) != NULL)
+    {
+        boost::shared_ptr<ReplicaQuery> running(
+            new ReplicaQuery(mReplicaSet, replica));
+        try
+        {
+            Result result((db->*run)(query));
+            if (!!result)
+            {
+                mLast = db;
+                mLastReplica = replica;
+                return (streamed ? keepRunning(result, running) : result);
+            }
+
+            hlog(HLOG_DEBUG, "[%s] read failed on replica, trying the primary: %s",
+                 mReplicaSet->GetPath(replica).c_str(), db->GetError().c_str());
+        }
+        catch (EDbConnection& e)
+        {
+            hlog(HLOG_WARN, "[%s] %s", mReplicaSet->GetPath(replica).c_str(),
+                 e.what());
+            mReplicaSet->MarkFailed(replica);
+            mReplicaConnections[replica].reset();
+        }
+    }
+
+    db = primary();
+    return (db->*run)(query);
+}
+
+bool DbRoutingConnection::Init(const FString& db, const FString& user, const FString& pass, const FString& host, const FString& socket, unsigned int retries)
+{
+    mDBName = db;
+    mHost = host;
+    mUser = user;
+    mPassword = pass;
+    mSocket = socket;
+    mRetries = retries;
+    mInTransaction = false;
+
+    mDidInit = mDbConnection->Init(db, user, pass, host, socket, retries);
+    return mDidInit;
+}
+
+bool DbRoutingConnection::Connect()
+{
+    return primary()->Connect();
+}
+
+bool DbRoutingConnection::Close()
+{
+    for (size_t i = 0; i < mReplicaConnections.size(); ++i)
+    {
+        if (mReplicaConnections[i])
+            mReplicaConnections[i]->Close();
+        mReplicaConnections[i].reset();
+    }
+    mInTransaction = false;
+    return primary()->Close();
+}
+
+bool DbRoutingConnection::Execute(const FString& sql)
+{
+    return route<bool, FString>(&DbConnection::Execute, sql,
+                                isMutableQuery(sql));
+}
+
+DbResult DbRoutingConnection::Store(const FString& sql)
+{
+    return route<DbResult, FString>(&DbConnection::Store, sql,
+                                    isMutableQuery(sql));
+}
+
+DbResult DbRoutingConnection::Use(const FString& sql)
+{
+    return route<DbResult, FString>(&DbConnection::Use, sql,
+                                    isMutableQuery(sql), true);
+}
+
+bool DbRoutingConnection::Execute(const DbSqlStatement& statement)
+{
+    return route<bool, DbSqlStatement>(&DbConnection::Execute, statement,
+                                       statement.IsMutator());
+}
+
+DbResult DbRoutingConnection::Use(const DbSqlStatement& statement)
+{
+    return route<DbResult, DbSqlStatement>(&DbConnection::Use, statement,
+                                           statement.IsMutator(), true);
+}
+
+DbResult DbRoutingConnection::Store(const DbSqlStatement& statement)
+{
+    return route<DbResult, DbSqlStatement>(&DbConnection::Store, statement,
+                                           statement.IsMutator());
+}
+
+void DbRoutingConnection::AutoCommit(bool enabled)
+{
+    primary()->AutoCommit(enabled);
+    mAutoCommit = enabled;
+}
+
+void DbRoutingConnection::Begin()
+{
+    primary()->Begin();
+    mInTransaction = true;
+}
+
+void DbRoutingConnection::Commit()
+{
+    primary()->Commit();
+    mInTransaction = false;
+}
+
+void DbRoutingConnection::Rollback()
+{
+    primary()->Rollback();
+    mInTransaction = false;
+}
+
+bool DbRoutingConnection::HasPendingQueries() const
+{
+    return mDbConnection->HasPendingQueries();
+}
+
+uint64_t DbRoutingConnection::InsertID()
+{
+    return mLast->InsertID();
+}
+
+uint64_t DbRoutingConnection::AffectedRows()
+{
+    return mLast->AffectedRows();
+}
+
+FString DbRoutingConnection::Escape(const char *str)
+{
+    return mDbConnection->Escape(str);
+}
+
+FString DbRoutingConnection::GetError() const
+{
+    return mLast->GetError();
+}
+
+unsigned int DbRoutingConnection::GetErrno() const
+{
+    return mLast->GetErrno();
+}
+
+unsigned int DbRoutingConnection::GetTries() const
+{
+    return mLast->GetTries();
+}
+
+bool DbRoutingConnection::IsTemporaryError() const
+{
+    return mLast->IsTemporaryError();
+}
+
+unsigned int DbRoutingConnection::GetRetries() const
+{
+    return mDbConnection->GetRetries();
+}
+
+unsigned int DbRoutingConnection::GetQueryRetryDelay() const
+{
+    return mDbConnection->GetQueryRetryDelay();
+}
+
+void DbRoutingConnection::BackupDatabase(const FString &targetPath)
+{
+    primary()->BackupDatabase(targetPath);
+}
+
+void DbRoutingConnection::BackupDatabase(DbConnection &targetDatabase)
+{
+    primary()->BackupDatabase(targetDatabase);
+}
+
+const std::string& DbRoutingConnection::GetDbName() const
+{
+    return mDbConnection->GetDbName();
+}
+
+const FString& DbRoutingConnection::GetCurrentQuery() const
+{
+    return mLast->GetCurrentQuery();
+}
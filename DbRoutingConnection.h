@@ -0,0 +1,173 @@
+#ifndef FORTE_DB_ROUTING_CONNECTION
+#define FORTE_DB_ROUTING_CONNECTION
+
+#include <DbConnection.h>
+#include <DbConnectionFactory.h>
+#include <DbSqlStatement.h>
+#include <Clock.h>
+#include <Types.h>
+#include <vector>
+
+namespace boost
+{
+    template<class T>
+    class shared_ptr;
+}
+
+namespace Forte {
+
+/**
+ * The read-only replicas shared by the DbRoutingConnections from one
+ * factory, with the number of queries each is running. A replica
+ * that fails to connect is left out for retrySeconds.
+ */
+class DbReplicaSet : public Object
+{
+public:
+    DbReplicaSet(const FStringVector& paths, unsigned int retrySeconds = 30);
+
+    size_t Size() const { return mReplicas.size(); }
+    const FString& GetPath(size_t replica) const;
+
+    /**
+     * Picks the available replica with the fewest queries running,
+     * taking turns between replicas that are equal, and counts a
+     * query as running on it until Release(). Returns -1 if none is
+     * available.
+     */
+    int Acquire();
+    void Release(size_t replica);
+    void MarkFailed(size_t replica);
+
+    unsigned int GetOutstanding(size_t replica) const;
+    uint64_t GetQueryCount(size_t replica) const;
+
+private:
+    struct Replica
+    {
+        FString mPath;
+        unsigned int mOutstanding;
+        uint64_t mQueries;
+        Timespec mRetryAfter;   // monotonic, zero while available
+    };
+
+    const unsigned int mRetrySeconds;
+    std::vector<Replica> mReplicas;
+    size_t mNext;
+    mutable Mutex mMutex;
+
+}; // DbReplicaSet
+
+/**
+ * DbRoutingConnection sends statements that only read to one of a set
+ * of read-only replicas of the database, such as copies kept by
+ * DbLiteMirror, and everything else to the primary.
+ *
+ * Each read goes to the replica with the fewest queries running across
+ * all the connections sharing the DbReplicaSet. A Use() counts as
+ * running until its last row is fetched or its result is released,
+ * since the rows are read from the replica as they are fetched. Inside a
+ * transaction (Begin(), or AutoCommit(false) as DbAutoTrans does)
+ * every statement goes to the primary, so reads see the transaction's
+ * own writes. A read that fails on a replica is run again on the
+ * primary.
+ *
+ * Replica connections are opened on first use, with the credentials
+ * given to Init().
+ */
+class DbRoutingConnection : public DbConnection
+{
+public:
+    typedef DbConnection base_type;
+
+    DbRoutingConnection(boost::shared_ptr<DbConnectionFactory> primaryDbConnectionFactory,
+                        boost::shared_ptr<DbConnectionFactory> replicaDbConnectionFactory,
+                        boost::shared_ptr<DbReplicaSet> replicas);
+
+    ~DbRoutingConnection();
+
+    bool Init(const FString& db,const FString& user,const FString& pass,
+              const FString& host = "localhost",const FString& socket = "", unsigned int retries = 20);
+
+    bool Connect();
+    bool Close();
+    bool HasPendingQueries() const;
+    bool Execute(const FString& sql);
+    DbResult Store(const FString& sql);
+    DbResult Use(const FString& sql);
+    void AutoCommit(bool enabled);
+    void Begin();
+    void Commit();
+    void Rollback();
+    uint64_t InsertID();
+    uint64_t AffectedRows();
+    FString Escape(const char *str);
+    FString GetError() const;
+    unsigned int GetErrno() const;
+    unsigned int GetTries() const;
+    bool IsTemporaryError() const;
+
+    unsigned int GetRetries() const;
+    unsigned int GetQueryRetryDelay() const;
+
+    void BackupDatabase(const FString &targetPath);
+    void BackupDatabase(DbConnection &targetDatabase);
+
+    bool Execute(const DbSqlStatement& statement);
+    DbResult Use(const DbSqlStatement& statement);
+    DbResult Store(const DbSqlStatement& statement);
+
+    virtual const std::string& GetDbName() const;
+    virtual const FString& GetCurrentQuery() const;
+
+    /**
+     * The replica the last statement ran on, or -1 for the primary.
+     */
+    int GetLastReplica() const { return mLastReplica; }
+
+private:
+    static bool isMutableQuery(const FString& sql);
+    bool usePrimary() const;
+    DbConnection* acquireReplica(int& replica);
+    DbConnection* primary();
+
+    template <typename Result, typename Query>
+    Result route(Result (DbConnection::*run)(const Query&),
+                 const Query& query,
+                 bool mutator,
+                 bool streamed = false);
+
+    // counts a query as running on a replica for its lifetime
+    class ReplicaQuery
+    {
+    public:
+        ReplicaQuery(const boost::shared_ptr<DbReplicaSet>& replicas,
+                     int replica) :
+            mReplicas(replicas), mReplica(replica) {}
+        ~ReplicaQuery() { mReplicas->Release(mReplica); }
+    private:
+        boost::shared_ptr<DbReplicaSet> mReplicas;
+        const int mReplica;
+    };
+
+    static bool keepRunning(bool result,
+                            const boost::shared_ptr<ReplicaQuery>& running) {
+        return result;
+    }
+    static DbResult keepRunning(const DbResult& result,
+                                const boost::shared_ptr<ReplicaQuery>& running);
+
+private:
+    boost::shared_ptr<DbConnectionFactory> mPrimaryDbConnectionFactory;
+    boost::shared_ptr<DbConnectionFactory> mReplicaDbConnectionFactory;
+    boost::shared_ptr<DbReplicaSet> mReplicaSet;
+    boost::shared_ptr<DbConnection> mDbConnection;
+    std::vector<boost::shared_ptr<DbConnection> > mReplicaConnections;
+    DbConnection* mLast;
+    int mLastReplica;
+
+}; // DbRoutingConnection
+
+} // namespace Forte
+
+#endif // FORTE_DB_ROUTING_CONNECTION
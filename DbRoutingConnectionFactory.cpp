@@ -0,0 +1,27 @@
+#include <DbRoutingConnectionFactory.h>
+#include <DbRoutingConnection.h>
+#include <boost/shared_ptr.hpp>
+#include "FTrace.h"
+
+using namespace Forte;
+using namespace boost;
+
+DbRoutingConnectionFactory::DbRoutingConnectionFactory(boost::shared_ptr<DbConnectionFactory> primaryDbConnectionFactory,
+                                                       boost::shared_ptr<DbConnectionFactory> replicaDbConnectionFactory,
+                                                       const FStringVector& replicaDbNames)
+    :mPrimaryDbConnectionFactory(primaryDbConnectionFactory),
+     mReplicaDbConnectionFactory(replicaDbConnectionFactory),
+     mReplicaSet(new DbReplicaSet(replicaDbNames))
+{
+}
+
+DbConnection* DbRoutingConnectionFactory::create()
+{
+    FTRACE;
+    return new DbRoutingConnection(mPrimaryDbConnectionFactory, mReplicaDbConnectionFactory, mReplicaSet);
+}
+
+boost::shared_ptr<DbReplicaSet> DbRoutingConnectionFactory::GetReplicaSet() const
+{
+    return mReplicaSet;
+}
@@ -0,0 +1,37 @@
+#ifndef FORTE_DB_ROUTING_CONNECTION_FACTORY
+#define FORTE_DB_ROUTING_CONNECTION_FACTORY
+
+#include <DbConnectionFactory.h>
+#include <Types.h>
+
+namespace boost
+{
+    template<class T>
+    class shared_ptr;
+}
+
+namespace Forte {
+
+class DbReplicaSet;
+
+class DbRoutingConnectionFactory : public DbConnectionFactory
+{
+public:
+    DbRoutingConnectionFactory(boost::shared_ptr<DbConnectionFactory> primaryDbConnectionFactory,
+                               boost::shared_ptr<DbConnectionFactory> replicaDbConnectionFactory,
+                               const FStringVector& replicaDbNames);
+    DbConnection* create();
+
+    // shared by every connection created, for the load on each replica
+    boost::shared_ptr<DbReplicaSet> GetReplicaSet() const;
+
+private:
+    boost::shared_ptr<DbConnectionFactory> mPrimaryDbConnectionFactory;
+    boost::shared_ptr<DbConnectionFactory> mReplicaDbConnectionFactory;
+    boost::shared_ptr<DbReplicaSet> mReplicaSet;
+
+}; // class DbRoutingConnectionFactory
+
+} // namespace Forte
+
+#endif // FORTE_DB_ROUTING_CONNECTION_FACTORY
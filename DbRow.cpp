@@ -3,6 +3,9 @@
 // DbRow.cpp
 
 #include "DbRow.h"
+#ifdef FORTE_WITH_SQLITE
+#include <sqlite3.h>
+#endif
 
 using namespace Forte;
 
@@ -74,4 +77,93 @@ double DbRow::GetDouble(const DbResultRow& row, int index)
     return strtod(row[index], NULL);
 }
 
+#ifndef FORTE_WITH_SQLITE
+
+void DbRow::Set(sqlite3_stmt *stmt)
+{
+    throw ForteDbRowException("Software Error: built without sqlite support");
+}
+
+#else
+
+void DbRow::Set(sqlite3_stmt *stmt)
+{
+    const int n = sqlite3_data_count(stmt);
+    DbResultRow row;
+    row.reserve(n);
+    for (int i = 0; i < n; i++)
+    {
+        if (sqlite3_column_type(stmt, i) == SQLITE_NULL) row.push_back(NULL);
+        else row.push_back(reinterpret_cast<const char*>(
+                               sqlite3_column_text(stmt, i)));
+    }
+    Set(row);
+}
+
+void DbRow::CheckRange(sqlite3_stmt *stmt, int index)
+{
+    if (index < 0 || index >= sqlite3_data_count(stmt))
+        throw ForteDbRowException(FStringFC(), "Software Error: index %d out of range", index);
+}
+
+bool DbRow::IsNull(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return (sqlite3_column_type(stmt, index) == SQLITE_NULL);
+}
+
+int DbRow::GetInt(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return sqlite3_column_int(stmt, index);
+}
+
+unsigned int DbRow::GetUInt(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return static_cast<unsigned int>(sqlite3_column_int64(stmt, index));
+}
+
+long long DbRow::GetLLInt(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return sqlite3_column_int64(stmt, index);
+}
+
+unsigned long long DbRow::GetULLInt(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return static_cast<unsigned long long>(sqlite3_column_int64(stmt, index));
+}
+
+bool DbRow::GetBool(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return (sqlite3_column_int64(stmt, index) != 0);
+}
+
+FString DbRow::GetString(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    // the blob call reads text as is, the length comes after it
+    const char *value =
+        static_cast<const char*>(sqlite3_column_blob(stmt, index));
+    if (value == NULL) return "";
+    return FString(value, sqlite3_column_bytes(stmt, index));
+}
+
+float DbRow::GetFloat(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return static_cast<float>(sqlite3_column_double(stmt, index));
+}
+
+double DbRow::GetDouble(sqlite3_stmt *stmt, int index)
+{
+    CheckRange(stmt, index);
+    return sqlite3_column_double(stmt, index);
+}
+
+#endif
+
 #endif
@@ -7,6 +7,8 @@
 #include "FString.h"
 #include "Exception.h"
 
+struct sqlite3_stmt;
+
 namespace Forte
 {
     EXCEPTION_SUBCLASS(Exception, ForteDbRowException);
@@ -20,6 +22,14 @@ namespace Forte
         virtual ~DbRow() { }
         virtual void Set(const DbResultRow& row) = 0;
 
+        // the current row of a streamed sqlite result (Use()). rows
+        // generated by dbc read the typed column values directly;
+        // this default goes through the text of each column and
+        // Set(const DbResultRow&). declared whether or not
+        // FORTE_WITH_SQLITE is set so the vtable is the same in every
+        // translation unit
+        virtual void Set(sqlite3_stmt *stmt);
+
     protected:
         static void CheckRange(const DbResultRow& row, int index);
         static bool IsNull(const DbResultRow& row, int index);
@@ -31,6 +41,21 @@ namespace Forte
         static FString GetString(const DbResultRow& row, int index);
         static float GetFloat(const DbResultRow& row, int index);
         static double GetDouble(const DbResultRow& row, int index);
+
+#ifdef FORTE_WITH_SQLITE
+        // the same conversions from a sqlite column's own type,
+        // without parsing text
+        static void CheckRange(sqlite3_stmt *stmt, int index);
+        static bool IsNull(sqlite3_stmt *stmt, int index);
+        static int GetInt(sqlite3_stmt *stmt, int index);
+        static unsigned int GetUInt(sqlite3_stmt *stmt, int index);
+        static long long GetLLInt(sqlite3_stmt *stmt, int index);
+        static unsigned long long GetULLInt(sqlite3_stmt *stmt, int index);
+        static bool GetBool(sqlite3_stmt *stmt, int index);
+        static FString GetString(sqlite3_stmt *stmt, int index);
+        static float GetFloat(sqlite3_stmt *stmt, int index);
+        static double GetDouble(sqlite3_stmt *stmt, int index);
+#endif
     };
 };
 #endif
@@ -19,10 +19,48 @@ DbSqlStatement::~DbSqlStatement()
 }
 
 DbSqlStatement::DbSqlStatement(const FString& statement, const bool& isMutator)
-    :mStatement(statement), mIsMutator(isMutator)
+    :mStatement(statement), mIsMutator(isMutator), mCacheable(false)
 {
 }
 
+DbSqlStatement& DbSqlStatement::BindNull(void)
+{
+    mParameters.push_back(DbSqlParameter());
+    return *this;
+}
+
+DbSqlStatement& DbSqlStatement::BindInt(int64_t value)
+{
+    mParameters.push_back(DbSqlParameter());
+    mParameters.back().mType = DbSqlParameter::DB_PARAM_INTEGER;
+    mParameters.back().mInteger = value;
+    return *this;
+}
+
+DbSqlStatement& DbSqlStatement::BindDouble(double value)
+{
+    mParameters.push_back(DbSqlParameter());
+    mParameters.back().mType = DbSqlParameter::DB_PARAM_REAL;
+    mParameters.back().mReal = value;
+    return *this;
+}
+
+DbSqlStatement& DbSqlStatement::BindText(const FString& value)
+{
+    mParameters.push_back(DbSqlParameter());
+    mParameters.back().mType = DbSqlParameter::DB_PARAM_TEXT;
+    mParameters.back().mText = value;
+    return *this;
+}
+
+DbSqlStatement& DbSqlStatement::BindBlob(const FString& value)
+{
+    mParameters.push_back(DbSqlParameter());
+    mParameters.back().mType = DbSqlParameter::DB_PARAM_BLOB;
+    mParameters.back().mText = value;
+    return *this;
+}
+
 std::ostream& operator<<(ostream& out, const Forte::DbSqlStatement& obj)
 {
     out << obj.GetStatement();
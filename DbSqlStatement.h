@@ -2,11 +2,49 @@
 #define FORTE_DB_SQL_STATEMENT
 
 #include <iosfwd>
+#include <vector>
+#include <stdint.h>
 #include "Object.h"
 #include "FString.h"
 
 namespace Forte {
 
+    /**
+     * A value bound to a '?' placeholder in a DbSqlStatement.
+     */
+    class DbSqlParameter
+    {
+    public:
+        enum Type {
+            DB_PARAM_NULL,
+            DB_PARAM_INTEGER,
+            DB_PARAM_REAL,
+            DB_PARAM_TEXT,
+            DB_PARAM_BLOB
+        };
+
+        DbSqlParameter() : mType(DB_PARAM_NULL), mInteger(0), mReal(0.0) {}
+
+        Type mType;
+        int64_t mInteger;
+        double mReal;
+        FString mText; // text and blob values
+    };
+
+    typedef std::vector<DbSqlParameter> DbSqlParameters;
+
+    /**
+     * DbSqlStatement holds a statement and, optionally, values for
+     * the '?' placeholders in it, bound in order with the Bind*()
+     * methods. Connections that can prepare statements (sqlite) keep
+     * a cache of prepared statements keyed by the statement text and
+     * bind the values directly; the others substitute the escaped
+     * values into the text.
+     *
+     * Statements with parameters are always looked up in the cache.
+     * Statements without parameters are only cached when marked with
+     * SetCacheable(), since text built with literals rarely repeats.
+     */
     class DbSqlStatement : public Object
     {
     public:
@@ -14,12 +52,40 @@ namespace Forte {
         virtual bool IsMutator() const;
         virtual ~DbSqlStatement();
 
+        DbSqlStatement& BindNull(void);
+        DbSqlStatement& BindInt(int64_t value);
+        DbSqlStatement& BindDouble(double value);
+        DbSqlStatement& BindText(const FString& value);
+        DbSqlStatement& BindBlob(const FString& value);
+
+        // remove the bound values so the statement can be run again
+        // with new ones
+        void ClearParameters(void) { mParameters.clear(); }
+        void SetParameters(const DbSqlParameters& parameters) {
+            mParameters = parameters;
+        }
+
+        bool HasParameters(void) const { return !mParameters.empty(); }
+        const DbSqlParameters& GetParameters(void) const {
+            return mParameters;
+        }
+
+        DbSqlStatement& SetCacheable(bool cacheable = true) {
+            mCacheable = cacheable;
+            return *this;
+        }
+        bool IsCacheable(void) const {
+            return mCacheable || HasParameters();
+        }
+
     protected:
         DbSqlStatement(const FString& statement, const bool& isMutator);
 
     private:
         const FString mStatement;
         const bool mIsMutator;
+        bool mCacheable;
+        DbSqlParameters mParameters;
     }; // DbSqlStatement
 
 
@@ -52,4 +118,3 @@ std::ostream& operator<<(std::ostream& out, const Forte::DbSqlStatement& obj);
 
 #endif // FORTE_DB_SQL_STATEMENT
 
-
@@ -1,4 +1,6 @@
 #include "Dispatcher.h"
+#include "Clock.h"
+#include "Foreach.h"
 #include "FTrace.h"
 
 using namespace Forte;
@@ -14,10 +16,13 @@ Forte::Dispatcher::Dispatcher(
       mShutdown(false),
       mRequestHandler(reqHandler),
       mNotify(mNotifyLock),
-      mEventQueue(maxQueueDepth, &mNotifyLock, &mNotify)
+      mEventQueue(maxQueueDepth, &mNotifyLock, &mNotify),
+      mQueueWait()
 {
     FTRACE;
 
+    registerStatVariable<0>("queueWait", &Dispatcher::mQueueWait);
+
     if (!mRequestHandler)
         throw EDispatcherReqHandlerInvalid();
 }
@@ -37,6 +42,26 @@ void Forte::Dispatcher::Shutdown(void)
     mShutdown = true;
 }
 
+void Forte::Dispatcher::EnqueueBatch(
+    std::list<boost::shared_ptr<Event> > &events)
+{
+    while (!events.empty())
+    {
+        Enqueue(events.front());
+        events.pop_front();
+    }
+}
+
+void Forte::Dispatcher::recordQueueWait(const Event &e)
+{
+    if (e.mEnqueuedTime.tv_sec == 0 && e.mEnqueuedTime.tv_nsec == 0)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    mQueueWait.Record(Timespec(now) - Timespec(e.mEnqueuedTime));
+}
+
 // End Dispatcher
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -3,6 +3,9 @@
 
 #include "Event.h"
 #include "EventQueue.h"
+#include "EnableStats.h"
+#include "LatencyHistogram.h"
+#include "Locals.h"
 #include "RequestHandler.h"
 #include "AutoMutex.h"
 #include "ThreadCondition.h"
@@ -32,7 +35,12 @@ namespace Forte
     class DispatcherThread;
     class DispatcherWorkerThread;
 
-    class Dispatcher : public Object
+    class Dispatcher :
+        public Object,
+        public EnableStats<Dispatcher,
+                           Locals<Dispatcher,
+                                  LatencyHistogram
+                                  > >
     {
     public:
         Dispatcher(boost::shared_ptr<RequestHandler> reqHandler,
@@ -43,6 +51,15 @@ namespace Forte
         virtual void Resume(void) = 0;
 
         virtual void Enqueue(boost::shared_ptr<Event> e) = 0;
+
+        /**
+         * EnqueueBatch() enqueues every event in events, in order. This
+         * default calls Enqueue() for each one; dispatchers that can take
+         * the whole batch under one lock override it. Events are removed
+         * from events as they are enqueued, so if this throws, events
+         * holds exactly the ones the dispatcher did not take.
+         */
+        virtual void EnqueueBatch(std::list<boost::shared_ptr<Event> > &events);
         virtual bool Accepting(void) = 0;
         virtual int GetQueuedEvents(
             int maxEvents,
@@ -67,6 +84,13 @@ namespace Forte
         FString mDispatcherName;
 
     protected:
+        /**
+         * recordQueueWait() records, in the "queueWait" stat, how long
+         * the event waited between being queued and starting to run.
+         * Dispatchers call it as each event starts.
+         */
+        void recordQueueWait(const Event &e);
+
         bool mPaused;
         bool mShutdown;
         std::vector<boost::shared_ptr<DispatcherWorkerThread> > mThreads;
@@ -75,6 +99,9 @@ namespace Forte
         Mutex mNotifyLock;
         ThreadCondition mNotify;
         EventQueue mEventQueue;
+
+        // microseconds
+        LatencyHistogram mQueueWait;
     };
     typedef boost::shared_ptr<Dispatcher> DispatcherPtr;
 
@@ -82,6 +109,7 @@ namespace Forte
     {
         friend class ThreadPoolDispatcher;
         friend class OnDemandDispatcher;
+        friend class WorkStealingDispatcher;
     public:
         DispatcherThread(Dispatcher &dispatcher);
         virtual ~DispatcherThread();
@@ -94,6 +122,7 @@ namespace Forte
     {
         friend class ThreadPoolDispatcher;
         friend class OnDemandDispatcher;
+        friend class WorkStealingDispatcher;
     public:
         DispatcherWorkerThread(Dispatcher &dispatcher,
                                const boost::shared_ptr<Event>& e);
@@ -1,14 +1,20 @@
 #include "EPollMonitor.h"
 #include <sys/types.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <boost/bind.hpp>
 #include "SystemCallUtil.h"
 #include "FunctionThread.h"
+#include "Foreach.h"
 
 using namespace Forte;
 
-EPollMonitor::EPollMonitor(const std::string& name, int epollTimeoutMs)
+EPollMonitor::EPollMonitor(const std::string& name,
+                           int epollTimeoutMs,
+                           int threadCount)
     : mName(name),
-      mEPollTimeoutMs(epollTimeoutMs)
+      mEPollTimeoutMs(epollTimeoutMs),
+      mThreadCount(threadCount < 1 ? 1 : threadCount)
 {
     FTRACE;
     mEPollFD = epoll_create1(0);
@@ -17,6 +23,27 @@ EPollMonitor::EPollMonitor(const std::string& name, int epollTimeoutMs)
         hlog_and_throw(HLOG_WARN, EPollMonitorCreateEPollFD(
                            FStringFC(), "%d", errno));
     }
+
+    // posted functions are signaled through an eventfd that lives in
+    // the epoll set next to the monitored fds, so one epoll_wait
+    // covers both
+    mWakeupFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mWakeupFD == -1)
+    {
+        close(mEPollFD);
+        hlog_and_throw(HLOG_WARN, EPollMonitorCreateEPollFD(
+                           FStringFC(), "eventfd: %d", errno));
+    }
+
+    epoll_event ev = { 0, { 0 } };
+    ev.events = EPOLLIN;
+    ev.data.fd = mWakeupFD;
+    if (epoll_ctl(mEPollFD, EPOLL_CTL_ADD, mWakeupFD, &ev) == -1)
+    {
+        close(mEPollFD);
+        hlog_and_throw(HLOG_WARN, EPollMonitorCreateEPollFD(
+                           FStringFC(), "wakeup fd: %d", errno));
+    }
 }
 
 EPollMonitor::~EPollMonitor()
@@ -95,21 +122,258 @@ void EPollMonitor::RemoveFD(int fd)
     }
 }
 
+void EPollMonitor::Post(const boost::function<void()>& f)
+{
+    {
+        AutoUnlockMutex lock(mPostedMutex);
+        mPosted.push_back(f);
+    }
+
+    const uint64_t one(1);
+    while (write(mWakeupFD, &one, sizeof(one)) == -1 && errno == EINTR) {}
+}
+
+void EPollMonitor::runPosted()
+{
+    uint64_t count;
+    while (read(mWakeupFD, &count, sizeof(count)) == -1 && errno == EINTR) {}
+
+    std::list<boost::function<void()> > posted;
+    {
+        AutoUnlockMutex lock(mPostedMutex);
+        posted.swap(mPosted);
+    }
+
+    while (!posted.empty())
+    {
+        try
+        {
+            posted.front()();
+        }
+        catch (std::exception& e)
+        {
+            if (hlog_ratelimit(60))
+                hlogstream(HLOG_WARN,
+                           "err from posted epoll function " << e.what());
+        }
+        posted.pop_front();
+    }
+}
+
+namespace Forte
+{
+    // a timer's fd and handler. loop threads hold a reference while
+    // the handler runs, so the fd is not closed, and its number not
+    // reused, under a handler that is still running
+    class EPollTimer
+    {
+    public:
+        EPollTimer(int fd, const EPollTimerHandler& handler)
+            : mFD(fd),
+              mHandler(handler),
+              mRemoved(false),
+              mRunning(false)
+            {
+            }
+
+        AutoFD mFD;
+        const EPollTimerHandler mHandler;
+        // held while the handler runs. RemoveTimer() takes it to
+        // wait out a running handler
+        Mutex mRunMutex;
+        bool mRemoved;
+        volatile bool mRunning;
+        pthread_t mRunningThread;
+    };
+};
+
+int EPollMonitor::AddTimer(const EPollTimerHandler& handler)
+{
+    FTRACE;
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1)
+    {
+        hlog_and_throw(
+            HLOG_WARN, EEPollMonitorTimer(
+                FStringFC(),
+                "timerfd_create: %i:%s",
+                errno,
+                SystemCallUtil::GetErrorDescription(errno).c_str()));
+    }
+    boost::shared_ptr<EPollTimer> timer(new EPollTimer(fd, handler));
+
+    // one shot, and re-armed once the handler returns, so a repeating
+    // timer is not handled on two loop threads at once
+    epoll_event ev = { 0, { 0 } };
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+    AddFD(fd, ev, boost::bind(&EPollMonitor::timerFired, this, timer));
+
+    AutoUnlockMutex lock(mFDMutex);
+    mTimers[fd] = timer;
+    return fd;
+}
+
+boost::shared_ptr<EPollTimer> EPollMonitor::findTimer(int timer)
+{
+    AutoUnlockMutex lock(mFDMutex);
+    std::map<int, boost::shared_ptr<EPollTimer> >::iterator i(
+        mTimers.find(timer));
+    if (i == mTimers.end())
+        return boost::shared_ptr<EPollTimer>();
+    return i->second;
+}
+
+void EPollMonitor::SetTimer(int timer, const Timespec& interval, bool repeats)
+{
+    FTRACE2("%d", timer);
+
+    boost::shared_ptr<EPollTimer> t(findTimer(timer));
+    if (!t)
+        return;
+
+    // a zero it_value would disarm it
+    const Timespec soon(0, 1);
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value = (interval.IsPositive() ? interval : soon);
+    if (repeats)
+        its.it_interval = its.it_value;
+
+    if (timerfd_settime(t->mFD, 0, &its, NULL) == -1)
+    {
+        hlog_and_throw(
+            HLOG_WARN, EEPollMonitorTimer(
+                FStringFC(),
+                "timerfd_settime: %i:%s",
+                errno,
+                SystemCallUtil::GetErrorDescription(errno).c_str()));
+    }
+}
+
+void EPollMonitor::CancelTimer(int timer)
+{
+    FTRACE2("%d", timer);
+
+    boost::shared_ptr<EPollTimer> t(findTimer(timer));
+    if (!t)
+        return;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (timerfd_settime(t->mFD, 0, &its, NULL) == -1)
+    {
+        hlog(HLOG_WARN, "could not disarm timer %d: %s", timer,
+             SystemCallUtil::GetErrorDescription(errno).c_str());
+    }
+}
+
+void EPollMonitor::RemoveTimer(int timer)
+{
+    FTRACE2("%d", timer);
+
+    boost::shared_ptr<EPollTimer> t;
+    {
+        AutoUnlockMutex lock(mFDMutex);
+        std::map<int, boost::shared_ptr<EPollTimer> >::iterator i(
+            mTimers.find(timer));
+        // Shutdown() has already removed it
+        if (i == mTimers.end())
+            return;
+        t = i->second;
+        mTimers.erase(i);
+    }
+
+    RemoveFD(timer);
+
+    // a handler removing its own timer can not wait for itself
+    if (t->mRunning && pthread_equal(t->mRunningThread, pthread_self()))
+    {
+        t->mRemoved = true;
+        return;
+    }
+
+    AutoUnlockMutex runLock(t->mRunMutex);
+    t->mRemoved = true;
+}
+
+void EPollMonitor::timerFired(const boost::shared_ptr<EPollTimer>& timer)
+{
+    {
+        AutoUnlockMutex runLock(timer->mRunMutex);
+        if (timer->mRemoved)
+            return;
+
+        // another loop thread may have been woken for the same
+        // expiry before it was re-armed, or it may have been set
+        // again since
+        uint64_t expirations;
+        if (read(timer->mFD, &expirations, sizeof(expirations))
+            == sizeof(expirations))
+        {
+            timer->mRunningThread = pthread_self();
+            timer->mRunning = true;
+            try
+            {
+                timer->mHandler();
+            }
+            catch (std::exception& e)
+            {
+                if (hlog_ratelimit(60))
+                    hlogstream(HLOG_WARN,
+                               "err from epoll timer " << e.what());
+            }
+            timer->mRunning = false;
+        }
+        if (timer->mRemoved)
+            return;
+    }
+
+    AutoUnlockMutex lock(mFDMutex);
+    std::map<int, boost::shared_ptr<EPollTimer> >::iterator i(
+        mTimers.find(timer->mFD));
+    if (i == mTimers.end() || i->second != timer)
+        return;
+
+    epoll_event ev = { 0, { 0 } };
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = timer->mFD;
+    if (epoll_ctl(mEPollFD, EPOLL_CTL_MOD, timer->mFD, &ev) == -1)
+    {
+        hlog(HLOG_WARN, "could not re-arm timer %d: %s",
+             static_cast<int>(timer->mFD),
+             SystemCallUtil::GetErrorDescription(errno).c_str());
+    }
+}
+
 void EPollMonitor::Start()
 {
     recordStartCall();
-    mMonitorThread.reset(
-        new Forte::FunctionThread(
-            Forte::FunctionThread::AutoInit(),
-            boost::bind(&EPollMonitor::monitorThreadRun, this),
-            mName));
+    for (int i = 0; i < mThreadCount; ++i)
+    {
+        mMonitorThreads.push_back(
+            boost::shared_ptr<Forte::Thread>(
+                new Forte::FunctionThread(
+                    Forte::FunctionThread::AutoInit(),
+                    boost::bind(&EPollMonitor::monitorThreadRun, this),
+                    (i == 0
+                     ? mName
+                     : FString(FStringFC(), "%s-%d", mName.c_str(), i)))));
+    }
 }
 
 void EPollMonitor::Shutdown()
 {
     recordShutdownCall();
-    mMonitorThread->Shutdown();
-    mMonitorThread->WaitForShutdown();
+    foreach (const boost::shared_ptr<Forte::Thread>& t, mMonitorThreads)
+    {
+        t->Shutdown();
+    }
+    foreach (const boost::shared_ptr<Forte::Thread>& t, mMonitorThreads)
+    {
+        t->WaitForShutdown();
+    }
 
     AutoUnlockMutex lock(mFDMutex);
     std::map<int, EPollEventHandler>::iterator fdIt;
@@ -124,7 +388,13 @@ void EPollMonitor::Shutdown()
     }
     mFDToCallbackMap.clear();
 
-    mMonitorThread.reset();
+    // the loop threads are gone, so this closes the timerfds
+    mTimers.clear();
+
+    mMonitorThreads.clear();
+
+    AutoUnlockMutex postedLock(mPostedMutex);
+    mPosted.clear();
 }
 
 void EPollMonitor::monitorThreadRun()
@@ -144,6 +414,12 @@ void EPollMonitor::monitorThreadRun()
 
         for (int i=0; i<fdReadyCount; i++)
         {
+            if (events[i].data.fd == mWakeupFD)
+            {
+                runPosted();
+                continue;
+            }
+
             try
             {
                 {
@@ -159,6 +435,9 @@ void EPollMonitor::monitorThreadRun()
                                "err from epoll callback " << e.what()
                                << "for fd " << events[i].data.fd);
             }
+            // a removed timer, and whatever its handler is bound to,
+            // should not live on until this thread's next event
+            handler.clear();
         }
     }
 }
@@ -6,8 +6,12 @@
 #include "ThreadedObject.h"
 #include "AutoMutex.h"
 #include "AutoFD.h"
+#include "Clock.h"
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <list>
+#include <map>
+#include <vector>
 
 namespace Forte
 {
@@ -16,13 +20,25 @@ namespace Forte
     EXCEPTION_SUBCLASS(EEPollMonitor, EEPollMonitorDuplicateFD);
     EXCEPTION_SUBCLASS(EEPollMonitor, EEPollMonitorAddFD);
     EXCEPTION_SUBCLASS(EEPollMonitor, EEPollMonitorModFD);
+    EXCEPTION_SUBCLASS(EEPollMonitor, EEPollMonitorTimer);
 
     typedef boost::function<void(const struct epoll_event& e)> EPollEventHandler;
+    typedef boost::function<void()> EPollTimerHandler;
+    class EPollTimer;
 
+    /**
+     * EPollMonitor waits on a single epoll set and calls the handler
+     * registered for each ready fd. threadCount loop threads share
+     * the epoll set. when more than one thread is used, handlers that
+     * must not run concurrently for the same fd should register with
+     * EPOLLONESHOT and re-arm with ModFD when they are done.
+     */
     class EPollMonitor : public ThreadedObject
     {
     public:
-        EPollMonitor(const std::string& name="eplmon", int epollTimeoutMs=500);
+        EPollMonitor(const std::string& name="eplmon",
+                     int epollTimeoutMs=500,
+                     int threadCount=1);
         virtual ~EPollMonitor();
         void AddFD(int fd,
                    struct epoll_event& ev,
@@ -33,18 +49,71 @@ namespace Forte
         void Start();
         void Shutdown();
 
+        /**
+         * Run the given function on one of the loop threads as soon
+         * as possible. Functions posted before Start() run once the
+         * monitor is started, functions still pending at Shutdown()
+         * are dropped.
+         */
+        void Post(const boost::function<void()>& f);
+
+        /**
+         * Create a timer whose handler runs on one of the loop threads,
+         * woken by the same epoll_wait as the fds. The timer is a
+         * timerfd in the epoll set. It starts disarmed and its handler
+         * never runs on two threads at once. Returns the id to pass to
+         * SetTimer() and RemoveTimer().
+         */
+        int AddTimer(const EPollTimerHandler& handler);
+
+        /**
+         * Arm the timer to fire after interval, and every interval
+         * after that if repeats. An interval that is not positive
+         * fires as soon as possible. Replaces any earlier setting.
+         */
+        void SetTimer(int timer, const Timespec& interval,
+                      bool repeats = false);
+
+        /**
+         * Disarm the timer. A handler that is already running is not
+         * waited for.
+         */
+        void CancelTimer(int timer);
+
+        /**
+         * Delete the timer. A handler that is already running on
+         * another thread is waited for, and the handler is not run
+         * again once this returns. The timerfd is closed once no
+         * loop thread holds the timer any more, so setting or
+         * cancelling the removed id does nothing.
+         */
+        void RemoveTimer(int timer);
+
+        int GetThreadCount() const {
+            return mThreadCount;
+        }
+
     protected:
         virtual void monitorThreadRun();
+        void runPosted();
+        void timerFired(const boost::shared_ptr<EPollTimer>& timer);
+        boost::shared_ptr<EPollTimer> findTimer(int timer);
 
     protected:
         const std::string mName;
         const int mEPollTimeoutMs;
+        const int mThreadCount;
 
         int mEPollFD;
-        boost::shared_ptr<Forte::Thread> mMonitorThread;
+        AutoFD mWakeupFD;
+        std::vector<boost::shared_ptr<Forte::Thread> > mMonitorThreads;
 
         Forte::Mutex mFDMutex;
         std::map<int, EPollEventHandler> mFDToCallbackMap;
+        std::map<int, boost::shared_ptr<EPollTimer> > mTimers;
+
+        Forte::Mutex mPostedMutex;
+        std::list<boost::function<void()> > mPosted;
     };
 };
 #endif
@@ -2,6 +2,7 @@
 #define __forte__EnableStats_h__
 
 #include <map>
+#include <vector>
 #include "FString.h"
 #include "Foreach.h"
 #include "Exception.h"
@@ -36,6 +37,19 @@ namespace Forte
             boost::throw_exception(EFailedToFindStat(name));
         }
 
+        /**
+         * GetStatNames() and GetStatValues() give the registered stat
+         * variables of this object alone, not those of stat functions
+         * or children, as parallel lists. The names do not change once
+         * the object is constructed, so a StatsSegment takes them once
+         * and then samples the values.
+         */
+        virtual void GetStatNames(std::vector<FString> &names) {
+        }
+
+        virtual void GetStatValues(std::vector<int64_t> &values) {
+        }
+
     protected:
         virtual void includeStatsFromChild(
             const boost::shared_ptr<BaseEnableStats> &child,
@@ -141,11 +155,29 @@ namespace Forte
                 {
                     return (mChildStats[components[0]]())[components[1]];
                 }
+
+                // a stat derived from a local, e.g. "latency.p99"
+                if (components.size() == 2 &&
+                    mStatVariables.LocalExists(components[0]))
+                {
+                    std::map<FString, int64_t> locals =
+                        mStatVariables.template GetAllLocals<int64_t>(this);
+                    if (locals.find(name) != locals.end())
+                        return locals[name];
+                }
             }
 
             boost::throw_exception(EFailedToFindStat(name));
         }
 
+        virtual void GetStatNames(std::vector<FString> &names) {
+            mStatVariables.GetLocalNames(this, names);
+        }
+
+        virtual void GetStatValues(std::vector<int64_t> &values) {
+            mStatVariables.GetLocalValues(this, values);
+        }
+
     protected:
         /**
          * includeStatsFromChild() If Derived class has other child objects which
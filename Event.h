@@ -6,6 +6,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <time.h>
 #include "FString.h"
 #include "Object.h"
 #include <boost/function.hpp>
@@ -14,14 +15,23 @@ namespace Forte
 {
     class Event : public Object {
     public:
-        Event() {};
-        Event(const FString &name) : mName(name) {}
+        Event() { clearEnqueuedTime(); };
+        Event(const FString &name) : mName(name) { clearEnqueuedTime(); }
         virtual ~Event() {}
 
         const FString &GetName(void) const { return mName; }
 
         struct timeval mStartTime;
+        // CLOCK_MONOTONIC time the event was queued to a dispatcher,
+        // zero until then
+        struct timespec mEnqueuedTime;
         FString mName;
+
+    private:
+        void clearEnqueuedTime(void) {
+            mEnqueuedTime.tv_sec = 0;
+            mEnqueuedTime.tv_nsec = 0;
+        }
     };
 
     class RequestEvent : public Event {
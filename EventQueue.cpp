@@ -1,4 +1,5 @@
 #include "EventQueue.h"
+#include "Foreach.h"
 #include "LogManager.h"
 
 using namespace boost;
@@ -57,44 +58,140 @@ void EventQueue::Add(EventQueue::EventPtr e)
         throw EEventQueueEventInvalid();
     if (mMode == QUEUE_MODE_BLOCKING)
         mMaxDepth.Wait();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
     {
         AutoUnlockMutex lock(mMutex);
         if (mShutdown)
             throw EEventQueueShutdown();
-        // \TODO fix this race condition
-        if (mMode != QUEUE_MODE_BLOCKING
-            && mMaxDepth.TryWait() == -1
-            && errno == EAGAIN)
+        push(e, now);
+    }
+
+    // \TODO check for a deep queue, and warn
+
+    // signal appropriate threads
+    if (mNotify)
+    {
+        AutoUnlockMutex lock(*mNotifyMutex);
+        mNotify->Signal();
+    }
+}
+
+void EventQueue::AddBatch(std::list<EventPtr> &events)
+{
+    if (events.empty())
+        return;
+    foreach (const EventPtr &e, events)
+        if (!e)
+            throw EEventQueueEventInvalid();
+    if (mMode == QUEUE_MODE_BLOCKING)
+    {
+        addBatchBlocking(events);
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    {
+        AutoUnlockMutex lock(mMutex);
+        if (mShutdown)
+            throw EEventQueueShutdown();
+        size_t pushed = 0;
+        try
         {
-            // max depth
-            if (mMode == QUEUE_MODE_DROP_OLDEST || mMode == QUEUE_MODE_DROP_OLDEST_LOG)
+            foreach (const EventPtr &e, events)
             {
-                // delete the oldest entry
-                std::list<EventQueue::EventPtr >::iterator i;
-                i = mQueue.begin();
-                if (i != mQueue.end())
-                {
-                    if (mMode == QUEUE_MODE_DROP_OLDEST_LOG && (*i))
-                        hlog(HLOG_INFO, "Event queue full: dropping oldest event (%s)", (*i)->mName.c_str());
-                    mQueue.pop_front();
-                }
+                push(e, now);
+                ++pushed;
             }
-            else if (mMode == QUEUE_MODE_THROW)
-                throw EEventQueueFull();
-            else
-                throw EEventQueue(FStringFC(), "invalid queue mode %d", mMode);
         }
-        mQueue.push_back(e);
+        catch (EEventQueue &)
+        {
+            // all or nothing, so the caller still owns every event
+            for (size_t i = 0; i < pushed; ++i)
+                mQueue.pop_back();
+            if (pushed > 0)
+                mMaxDepth.Post(pushed);
+            throw;
+        }
     }
+    const size_t added = events.size();
+    events.clear();
+    notifyAdded(added);
+}
 
-    // \TODO check for a deep queue, and warn
+void EventQueue::addBatchBlocking(std::list<EventPtr> &events)
+{
+    // Never hold a slot while waiting for another: a batch bigger than
+    // the free depth (or than maxdepth itself) goes in as chunks of
+    // whatever is free, so concurrent producers cannot each sit on part
+    // of the queue while it is empty.
+    while (!events.empty())
+    {
+        mMaxDepth.Wait();
+        size_t slots = 1;
+        while (slots < events.size() && mMaxDepth.TryWait() == 0)
+            ++slots;
 
-    // signal appropriate threads
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        {
+            AutoUnlockMutex lock(mMutex);
+            if (mShutdown)
+            {
+                mMaxDepth.Post(slots);
+                throw EEventQueueShutdown();
+            }
+            for (size_t i = 0; i < slots; ++i)
+            {
+                push(events.front(), now);
+                events.pop_front();
+            }
+        }
+        notifyAdded(slots);
+    }
+}
+
+void EventQueue::notifyAdded(size_t count)
+{
+    // one wakeup for the whole batch
     if (mNotify)
     {
         AutoUnlockMutex lock(*mNotifyMutex);
-        mNotify->Signal();
+        if (count > 1)
+            mNotify->Broadcast();
+        else
+            mNotify->Signal();
+    }
+}
+
+void EventQueue::push(const EventQueue::EventPtr &e,
+                      const struct timespec &now)
+{
+    // \TODO fix this race condition
+    if (mMode != QUEUE_MODE_BLOCKING
+        && mMaxDepth.TryWait() == -1
+        && errno == EAGAIN)
+    {
+        // max depth
+        if (mMode == QUEUE_MODE_DROP_OLDEST || mMode == QUEUE_MODE_DROP_OLDEST_LOG)
+        {
+            // delete the oldest entry
+            std::list<EventQueue::EventPtr >::iterator i;
+            i = mQueue.begin();
+            if (i != mQueue.end())
+            {
+                if (mMode == QUEUE_MODE_DROP_OLDEST_LOG && (*i))
+                    hlog(HLOG_INFO, "Event queue full: dropping oldest event (%s)", (*i)->mName.c_str());
+                mQueue.pop_front();
+            }
+        }
+        else if (mMode == QUEUE_MODE_THROW)
+            throw EEventQueueFull();
+        else
+            throw EEventQueue(FStringFC(), "invalid queue mode %d", mMode);
     }
+    e->mEnqueuedTime = now;
+    mQueue.push_back(e);
 }
 
 EventQueue::EventPtr EventQueue::Get(void)
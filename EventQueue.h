@@ -36,6 +36,15 @@ namespace Forte
             QueueMode mode = QUEUE_MODE_BLOCKING);
         virtual ~EventQueue();
         void Add(EventPtr e);
+
+        /// AddBatch adds every event in events under one lock, and wakes
+        /// the waiting threads once, removing them from events as they
+        /// are added.  In QUEUE_MODE_BLOCKING a batch larger than the free
+        /// depth goes in as chunks of whatever is free; in the other modes
+        /// either every event is added or, if this throws, none is.  If
+        /// this throws, events holds exactly the events that were not
+        /// added.
+        void AddBatch(std::list<EventPtr> &events);
         EventPtr Get(void);
         EventPtrVector Get(const unsigned long& max);
         EventPtr Peek(void);
@@ -74,6 +83,11 @@ namespace Forte
         int mLastDepth;
 
     protected:
+        // adds e to the back of the queue; mMutex must be held
+        void push(const EventPtr &e, const struct timespec &now);
+        void addBatchBlocking(std::list<EventPtr> &events);
+        void notifyAdded(size_t count);
+
         const QueueMode mMode;
         bool mShutdown;
         std::list<EventPtr > mQueue;
@@ -160,6 +160,39 @@ namespace Forte
             }
         }
 
+        // the same, checking through the caller's LogCallSite
+        FunctionEntryProxy(LogCallSite& site, const char *functionName, const char *file, int line)
+        {
+            if(_should_hlog(site, functionName, file, line, HLOG_TRACE))
+            {
+                mImpl.reset(new FunctionEntry(functionName, file, line));
+            }
+        }
+
+        FunctionEntryProxy(LogCallSite& site, const char *functionName, const char *file, int line, const char*fmt, ...) __attribute__((format(printf, 6, 7)))
+        {
+            if(_should_hlog(site, functionName, file, line, HLOG_TRACE))
+            {
+                va_list args;
+                va_start(args, fmt);
+                char message[FunctionEntry::MAX_BUFFER_SIZE];
+                vsnprintf(message, FunctionEntry::MAX_BUFFER_SIZE, fmt, args);
+
+                const FString strMessage(message, sizeof(message));
+                mImpl.reset(new FunctionEntry(functionName, file, line, strMessage));
+
+                va_end(args);
+            }
+        }
+
+        FunctionEntryProxy(LogCallSite& site, const char* functionName, const char *file, int line, const Forte::FString& message)
+        {
+            if(_should_hlog(site, functionName, file, line, HLOG_TRACE))
+            {
+                mImpl.reset(new FunctionEntry(functionName, file, line, message));
+            }
+        }
+
     private:
         boost::scoped_ptr<FunctionEntry> mImpl;
     };
@@ -172,14 +205,16 @@ namespace Forte
  * This macro passes function name, file, and line.
  */
 #define FTRACE \
-Forte::FunctionEntryProxy _forte_trace_object(__PRETTY_FUNCTION__, __FILE__, __LINE__)
+static Forte::LogCallSite _forte_trace_site; \
+Forte::FunctionEntryProxy _forte_trace_object(_forte_trace_site, __PRETTY_FUNCTION__, __FILE__, __LINE__)
 
 
 //@ todo: optimize stream out of hot path
 #define FTRACESTREAM(message)                                           \
     std::ostringstream _forte_trace_stream;                             \
     _forte_trace_stream <<  message;                                    \
-    Forte::FunctionEntryProxy _forte_trace_object(__PRETTY_FUNCTION__, __FILE__, __LINE__, _forte_trace_stream.str())
+    static Forte::LogCallSite _forte_trace_site;                        \
+    Forte::FunctionEntryProxy _forte_trace_object(_forte_trace_site, __PRETTY_FUNCTION__, __FILE__, __LINE__, _forte_trace_stream.str())
 
 /**
  * Same as FTRACE except allows a format string to be passed in
@@ -190,7 +225,9 @@ Forte::FunctionEntryProxy _forte_trace_object(__PRETTY_FUNCTION__, __FILE__, __L
  *   Output (on enter):
  *     ENTER function(arg1, arg2)
  */
-#define FTRACE2(FMT...) Forte::FunctionEntryProxy _forte_trace_object(__PRETTY_FUNCTION__, __FILE__, __LINE__, FMT)
+#define FTRACE2(FMT...) \
+static Forte::LogCallSite _forte_trace_site; \
+Forte::FunctionEntryProxy _forte_trace_object(_forte_trace_site, __PRETTY_FUNCTION__, __FILE__, __LINE__, FMT)
 //#else
 //#define FTRACE
 //#endif
@@ -44,6 +44,7 @@ namespace Forte {};
 #ifndef FORTE_NO_DB
 #include "DbAutoConnection.h"
 #include "DbAutoTrans.h"
+#include "DbBoundedConnectionPool.h"
 #include "DbConnection.h"
 #include "DbConnectionPool.h"
 #include "DbException.h"
@@ -60,6 +61,8 @@ namespace Forte {};
 #endif
 #ifdef FORTE_WITH_SQLITE
 #include "DbLiteConnection.h"
+#include "DbLiteGroupCommit.h"
+#include "DbLiteMirror.h"
 #include "DbLiteResult.h"
 #endif
 #endif // FORTE_NO_DB
@@ -75,6 +78,7 @@ namespace Forte {};
 #include "FString.h"
 #include "FTrace.h"
 #include "LogManager.h"
+#include "BinaryLogfile.h"
 #include "LogTimer.h"
 #include "FMD5.h"
 #include "Murmur.h"
@@ -101,6 +105,7 @@ namespace Forte {};
 #include "Types.h"
 #include "Util.h"
 #include "UrlString.h"
+#include "WorkStealingDispatcher.h"
 
 #ifndef FORTE_NO_XML
 #include "XMLBlob.h"
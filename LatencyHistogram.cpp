@@ -0,0 +1,145 @@
+#include "LatencyHistogram.h"
+#include "Clock.h"
+#include <algorithm>
+
+using namespace Forte;
+
+const unsigned int Forte::LatencyHistogram::SUB_BUCKET_BITS;
+const unsigned int Forte::LatencyHistogram::SUB_BUCKETS;
+const unsigned int Forte::LatencyHistogram::MAX_VALUE_BITS;
+const int64_t Forte::LatencyHistogram::MAX_VALUE;
+const unsigned int Forte::LatencyHistogram::BUCKETS;
+
+Forte::LatencyHistogram::LatencyHistogram()
+    : mMax(0)
+{
+    Clear();
+}
+
+unsigned int Forte::LatencyHistogram::bucketFor(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return value;
+
+    // the bucket is the power of two, then the next SUB_BUCKET_BITS
+    // bits below the top one
+    const unsigned int msb = 63 - __builtin_clzll(value);
+    const unsigned int shift = msb - SUB_BUCKET_BITS;
+    return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+        + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Forte::LatencyHistogram::bucketUpperBound(unsigned int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+
+    const unsigned int shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t lower =
+        (static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS)) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void Forte::LatencyHistogram::Record(int64_t value)
+{
+    if (value < 0)
+        value = 0;
+    else if (value > MAX_VALUE)
+        value = MAX_VALUE;
+
+    __sync_fetch_and_add(&mBuckets[bucketFor(value)], 1);
+
+    int64_t max = mMax;
+    while (value > max)
+    {
+        const int64_t seen = __sync_val_compare_and_swap(&mMax, max, value);
+        if (seen == max)
+            break;
+        max = seen;
+    }
+}
+
+void Forte::LatencyHistogram::Record(const Timespec &elapsed)
+{
+    const struct timespec ts = elapsed;
+    Record(static_cast<int64_t>(ts.tv_sec) * 1000000LL + ts.tv_nsec / 1000);
+}
+
+uint64_t Forte::LatencyHistogram::GetCount(void) const
+{
+    uint64_t count = 0;
+    for (unsigned int i = 0; i < BUCKETS; ++i)
+        count += mBuckets[i];
+    return count;
+}
+
+int64_t Forte::LatencyHistogram::GetPercentile(double fraction) const
+{
+    int64_t result;
+    getPercentiles(&fraction, &result, 1);
+    return result;
+}
+
+void Forte::LatencyHistogram::getPercentiles(
+    const double *fractions, int64_t *results, size_t count) const
+{
+    // copy the counts so the total and the walk agree
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < BUCKETS; ++i)
+    {
+        counts[i] = mBuckets[i];
+        total += counts[i];
+    }
+
+    const int64_t max = mMax;
+    unsigned int bucket = 0;
+    uint64_t seen = counts[0];
+    for (size_t n = 0; n < count; ++n)
+    {
+        if (total == 0)
+        {
+            results[n] = 0;
+            continue;
+        }
+
+        const double fraction = std::max(0.0, std::min(1.0, fractions[n]));
+        uint64_t rank = static_cast<uint64_t>(fraction * total + 0.5);
+        if (rank == 0)
+            rank = 1;
+
+        while (seen < rank && bucket + 1 < BUCKETS)
+            seen += counts[++bucket];
+
+        results[n] = std::min(static_cast<int64_t>(bucketUpperBound(bucket)), max);
+    }
+}
+
+void Forte::LatencyHistogram::Clear(void)
+{
+    for (unsigned int i = 0; i < BUCKETS; ++i)
+        mBuckets[i] = 0;
+    mMax = 0;
+}
+
+void Forte::LatencyHistogram::GetDerivedStatNames(
+    const FString &name, std::vector<FString> &names) const
+{
+    names.push_back(name);
+    names.push_back(FString(FStringFC(), "%s.p50", name.c_str()));
+    names.push_back(FString(FStringFC(), "%s.p99", name.c_str()));
+    names.push_back(FString(FStringFC(), "%s.p999", name.c_str()));
+    names.push_back(FString(FStringFC(), "%s.max", name.c_str()));
+}
+
+void Forte::LatencyHistogram::GetDerivedStatValues(
+    std::vector<int64_t> &values) const
+{
+    static const double fractions[] = { 0.50, 0.99, 0.999 };
+    int64_t percentiles[3];
+    getPercentiles(fractions, percentiles, 3);
+
+    values.push_back(GetCount());
+    values.insert(values.end(), percentiles, percentiles + 3);
+    values.push_back(GetMax());
+}
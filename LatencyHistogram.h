@@ -0,0 +1,81 @@
+#ifndef __Forte_LatencyHistogram_h__
+#define __Forte_LatencyHistogram_h__
+
+#include "Locals.h"
+#include <stdint.h>
+
+namespace Forte
+{
+    class Timespec;
+
+    /**
+     * LatencyHistogram counts recorded latencies in log-scaled buckets,
+     * in the manner of HdrHistogram, so that percentiles can be reported
+     * without keeping the samples. Each power of two is split into
+     * SUB_BUCKETS linear buckets, so a reported value is at most 1/32
+     * above the true one. Values below SUB_BUCKETS are exact; values
+     * past MAX_VALUE are counted as MAX_VALUE.
+     *
+     * Record() takes no lock: it adds to one bucket and updates the
+     * maximum with atomic operations. Readers may see a Record() that
+     * is in progress half done.
+     *
+     * As a stat variable in EnableStats, a histogram named "name"
+     * reports "name" (the count), "name.p50", "name.p99", "name.p999"
+     * and "name.max". Units are whatever the caller records;
+     * Record(const Timespec&) records microseconds.
+     */
+    class LatencyHistogram : public DerivedStats
+    {
+    public:
+        static const unsigned int SUB_BUCKET_BITS = 5;
+        static const unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const unsigned int MAX_VALUE_BITS = 40;
+        static const int64_t MAX_VALUE = (1LL << MAX_VALUE_BITS) - 1;
+        static const unsigned int BUCKETS =
+            (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        LatencyHistogram();
+        virtual ~LatencyHistogram() {}
+
+        void Record(int64_t value);
+        void Record(const Timespec &elapsed);
+
+        uint64_t GetCount(void) const;
+        int64_t GetMax(void) const { return mMax; }
+
+        /**
+         * GetPercentile() returns the value below which the given
+         * fraction (0.0 to 1.0) of recorded values fall, as the upper
+         * bound of the bucket it lands in, and never more than GetMax().
+         * It returns 0 when nothing has been recorded.
+         */
+        int64_t GetPercentile(double fraction) const;
+
+        /**
+         * Clear() empties the histogram. Values recorded at the same
+         * time may be lost.
+         */
+        void Clear(void);
+
+        virtual void GetDerivedStatNames(const FString &name,
+                                         std::vector<FString> &names) const;
+        virtual void GetDerivedStatValues(std::vector<int64_t> &values) const;
+
+    private:
+        LatencyHistogram(const LatencyHistogram &other) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram &rhs) = delete;
+
+        static unsigned int bucketFor(uint64_t value);
+        static uint64_t bucketUpperBound(unsigned int bucket);
+
+        // fractions must be ascending; one pass over the buckets
+        void getPercentiles(const double *fractions, int64_t *results,
+                            size_t count) const;
+
+        volatile uint64_t mBuckets[BUCKETS];
+        volatile int64_t mMax;
+    };
+};
+
+#endif
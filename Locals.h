@@ -2,6 +2,7 @@
 #define __Forte_Locals__
 
 #include <map>
+#include <vector>
 #include <boost/tuple/tuple.hpp>
 #include <boost/preprocessor/repetition/enum_params_with_a_default.hpp>
 #include <boost/preprocessor/repetition/enum_params.hpp>
@@ -9,6 +10,8 @@
 #include <boost/mpl/transform.hpp>
 #include <boost/mpl/reverse_fold.hpp>
 #include <boost/mpl/size.hpp>
+#include <boost/type_traits/is_base_of.hpp>
+#include <boost/utility/enable_if.hpp>
 #include "Exception.h"
 
 namespace Forte
@@ -17,6 +20,40 @@ namespace Forte
     EXCEPTION_SUBCLASS2(ELocals, EFailedToFindVariable,
                         "Failed to find variable");
 
+    /**
+     * A stat variable whose type derives from DerivedStats reports
+     * several stats rather than one value, named after the variable,
+     * e.g. the percentiles of a LatencyHistogram.
+     */
+    class DerivedStats {
+    public:
+        virtual ~DerivedStats() {}
+
+        /**
+         * GetDerivedStatNames() appends the names of the stats derived
+         * from the variable called name, in the order that
+         * GetDerivedStatValues() appends their values.
+         */
+        virtual void GetDerivedStatNames(
+            const Forte::FString &name,
+            std::vector<Forte::FString> &names) const = 0;
+
+        virtual void GetDerivedStatValues(
+            std::vector<int64_t> &values) const = 0;
+
+        void GetDerivedStats(
+            const Forte::FString &name,
+            std::map<Forte::FString, int64_t> &stats) const {
+
+            std::vector<Forte::FString> names;
+            std::vector<int64_t> values;
+            GetDerivedStatNames(name, names);
+            GetDerivedStatValues(values);
+            for (size_t i = 0; i < names.size() && i < values.size(); ++i)
+                stats[names[i]] = values[i];
+        }
+    };
+
     /**
      * The Locals class is used in conjunction with EnableStats. Use this class to indicate
      * the local member variables in the "Derived" class that are used as stat variables.
@@ -105,6 +142,29 @@ namespace Forte
                 return result;
             };
 
+            /**
+             * GetLocalNames() appends the name of each stat, with those
+             * derived from DerivedStats variables expanded, in the order
+             * GetLocalValues() appends their values. Unlike
+             * GetAllLocals() it builds no map, so the values can be
+             * sampled repeatedly into the same vector.
+             */
+            template <typename U>
+                void GetLocalNames(U *from, std::vector<Forte::FString> &names) {
+
+                foreach_tuple_element(
+                    mVars,
+                    AppendTupleElementName<U>(from, mVarNames, names));
+            }
+
+            template <typename U>
+                void GetLocalValues(U *from, std::vector<int64_t> &values) {
+
+                foreach_tuple_element(
+                    mVars,
+                    AppendTupleElementValue<U>(from, values));
+            }
+
             size_t GetNumberOfLocals() {
                 return  boost::mpl::size<LocalTypes>::type::value; }
 
@@ -131,18 +191,88 @@ namespace Forte
 
                 template <typename T>
                 void operator() (T& t, const int index) {
-                    mMap[mVarNames[index]] =
-                         static_cast<ReturnType>(
-                             static_cast<Derived*>(mFrom)->*t
-                             );
+                    save(mVarNames[index], static_cast<Derived*>(mFrom)->*t);
                 }
 
             private:
+                template <typename V>
+                typename boost::disable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                save(const FString &name, V &value) {
+                    mMap[name] = static_cast<ReturnType>(value);
+                }
+
+                template <typename V>
+                typename boost::enable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                save(const FString &name, V &value) {
+                    value.GetDerivedStats(name, mMap);
+                }
+
                 U *mFrom;
                 std::vector<FString> mVarNames;
                 MapType &mMap;
             };
 
+            // functor which will append the stat names of tuple elements
+            template <typename U>
+            struct AppendTupleElementName {
+                AppendTupleElementName(
+                    U *from, const FString *varNames, std::vector<FString> &names)
+                : mFrom (from),
+                    mVarNames (varNames),
+                    mNames (names) {}
+
+                template <typename T>
+                void operator() (T& t, const int index) {
+                    append(mVarNames[index], static_cast<Derived*>(mFrom)->*t);
+                }
+
+            private:
+                template <typename V>
+                typename boost::disable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                append(const FString &name, V &value) {
+                    mNames.push_back(name);
+                }
+
+                template <typename V>
+                typename boost::enable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                append(const FString &name, V &value) {
+                    value.GetDerivedStatNames(name, mNames);
+                }
+
+                U *mFrom;
+                const FString *mVarNames;
+                std::vector<FString> &mNames;
+            };
+
+            // functor which will append the values of tuple elements
+            template <typename U>
+            struct AppendTupleElementValue {
+                AppendTupleElementValue(U *from, std::vector<int64_t> &values)
+                : mFrom (from),
+                    mValues (values) {}
+
+                template <typename T>
+                void operator() (T& t, const int index) {
+                    append(static_cast<Derived*>(mFrom)->*t);
+                }
+
+            private:
+                template <typename V>
+                typename boost::disable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                append(V &value) {
+                    mValues.push_back(static_cast<int64_t>(value));
+                }
+
+                template <typename V>
+                typename boost::enable_if<boost::is_base_of<DerivedStats, V>, void>::type
+                append(V &value) {
+                    value.GetDerivedStatValues(mValues);
+                }
+
+                U *mFrom;
+                std::vector<int64_t> &mValues;
+            };
+
             // Iterate through tuple elements
             template<typename tuple_type, typename F, int Index, int Max>
                 inline typename boost::enable_if_c<Index == Max, void>::type
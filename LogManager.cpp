@@ -1,20 +1,255 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "Clock.h"
 #include "Foreach.h"
 #include "FTrace.h"
 #include "LogManager.h"
+#include "BinaryLogfile.h"
 #include "Types.h"
 #include <boost/tuple/tuple.hpp>
 #include <boost/bind.hpp>
 #include <stdarg.h>
 #include <sys/time.h>
+#include <time.h>
+#include <algorithm>
 
 using namespace Forte;
 using namespace std;
 
-LogManager *LogManager::sLogManager = NULL;
+LogManager * volatile LogManager::sLogManager = NULL;
+// starts at 1 so a zero initialized LogCallSite is always stale
+volatile unsigned int LogManager::sLogGeneration = 1;
 Mutex LogManager::sLogManagerMutex;
 
+static const int sCrashSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+// alternate signal stack for crashHandler(), set up by the first
+// async log call on each thread that did not already have one
+static const size_t CRASH_STACK_SIZE = 65536;
+static __thread char *sCrashStack = NULL;
+
+namespace Forte
+{
+    // one log call, captured on the thread that made it
+    struct AsyncLogRecord
+    {
+        struct timeval mTime;
+        struct timespec mMonotonicTime;
+        int mLevel;
+        unsigned int mDepth;
+        unsigned int mThreadID;
+        int mLine;
+        FString mThreadName;
+        FString mFunction;
+        FString mFile;
+        FString mMsg;
+    };
+
+    // ring of records written only by the thread that owns it and
+    // read only by whoever holds LogManager::mAsyncFlushLock. slots
+    // are reused, so once their strings have grown a log call does
+    // not allocate
+    class AsyncLogBuffer
+    {
+    public:
+        AsyncLogBuffer(unsigned int minRecords, unsigned int generation)
+            : mMask(roundUp(minRecords) - 1),
+              mGeneration(generation),
+              mRecords(mMask + 1),
+              mHead(0),
+              mTail(0),
+              mOwnerExited(0)
+            {
+            }
+
+        // the slot for the next record, or NULL if the ring is full
+        AsyncLogRecord* Reserve(void) {
+            if (mHead - mTail > mMask)
+                return NULL;
+            return &mRecords[mHead & mMask];
+        }
+
+        // publish the record returned by Reserve()
+        void Commit(void) {
+            __sync_synchronize();
+            ++mHead;
+        }
+
+        const unsigned long mMask;
+        const unsigned int mGeneration;
+        std::vector<AsyncLogRecord> mRecords;
+        volatile unsigned long mHead;
+        volatile unsigned long mTail;
+        volatile int mOwnerExited;
+
+    private:
+        static unsigned long roundUp(unsigned int n) {
+            unsigned long size(2);
+            while (size < n)
+                size <<= 1;
+            return size;
+        }
+    };
+
+    class AsyncLogWriter : public Thread
+    {
+    public:
+        AsyncLogWriter(LogManager &logManager, unsigned int flushIntervalMs)
+            : mLogManager(logManager),
+              mFlushInterval(Timespec::FromMillisec(flushIntervalMs))
+            {
+                setThreadName("logwriter");
+                initialized();
+            }
+
+        virtual ~AsyncLogWriter() {
+            deleting();
+        }
+
+    protected:
+        virtual void *run(void) {
+            MonotonicClock clock;
+            while (!IsShuttingDown())
+            {
+                {
+                    AutoUnlockMutex lock(mLogManager.mAsyncWakeLock);
+                    if (!mLogManager.mAsyncWakeRequested)
+                    {
+                        mLogManager.mAsyncWakeCond.TimedWait(
+                            clock.GetTime() + mFlushInterval);
+                    }
+                    mLogManager.mAsyncWakeRequested = false;
+                }
+                mLogManager.flushAsync();
+            }
+            mLogManager.flushAsync();
+            return NULL;
+        }
+
+        LogManager &mLogManager;
+        const Timespec mFlushInterval;
+    };
+};
+
+namespace
+{
+    // holds a mutex if it could be taken, only trying to take it when
+    // tryOnly is set
+    class MaybeLockMutex
+    {
+    public:
+        MaybeLockMutex(Mutex &mutex, bool tryOnly)
+            : mMutex(mutex),
+              mLocked((tryOnly ? mutex.Trylock() : mutex.Lock()) == 0)
+            {
+            }
+        ~MaybeLockMutex() {
+            if (mLocked)
+                mMutex.Unlock();
+        }
+        bool Locked(void) const { return mLocked; }
+
+    private:
+        Mutex &mMutex;
+        const bool mLocked;
+    };
+
+    bool logMsgEarlier(const LogMsg *a, const LogMsg *b)
+    {
+        return timercmp(&a->mTime, &b->mTime, <);
+    }
+
+    // a literal, so the crash handler can use it too
+    const char* levelName(int level)
+    {
+        switch (level & HLOG_ALL)
+        {
+        case HLOG_SQL:
+            return "SQL ";
+        case HLOG_TRACE:
+            return "TRCE";
+        case HLOG_DEBUG4:
+            return "DBG4";
+        case HLOG_DEBUG3:
+            return "DBG3";
+        case HLOG_DEBUG2:
+            return "DBG2";
+        case HLOG_DEBUG1:
+            return "DBG1";
+        case HLOG_DEBUG:
+            return "DBG ";
+        case HLOG_INFO:
+            return "INFO";
+        case HLOG_NOTICE:
+            return "NOTC";
+        case HLOG_WARN:
+            return "WARN";
+        case HLOG_ERR:
+            return "ERR ";
+        case HLOG_CRIT:
+            return "CRIT";
+        case HLOG_ALERT:
+            return "ALRT";
+        case HLOG_EMERG:
+            return "EMRG";
+        default:
+            return "????";
+        }
+    }
+
+    // one line of a crash dump, built without allocating. anything
+    // past the end of the buffer is cut off
+    class CrashLine
+    {
+    public:
+        CrashLine() : mLength(0) {}
+
+        void Append(const char *str, size_t length) {
+            if (length > sizeof(mBuffer) - mLength)
+                length = sizeof(mBuffer) - mLength;
+            memcpy(mBuffer + mLength, str, length);
+            mLength += length;
+        }
+        void Append(const char *str) {
+            Append(str, strlen(str));
+        }
+        void AppendNumber(unsigned long value, int width = 0) {
+            char digits[24];
+            int n(0);
+            do
+            {
+                digits[n++] = '0' + value % 10;
+                value /= 10;
+            } while (value != 0);
+            while (n < width)
+                digits[n++] = '0';
+            while (n > 0)
+                Append(&digits[--n], 1);
+        }
+        void Write(int fd) const {
+            const char *p(mBuffer);
+            size_t left(mLength);
+            while (left > 0)
+            {
+                const ssize_t n(write(fd, p, left));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return;
+                p += n;
+                left -= n;
+            }
+        }
+
+    private:
+        char mBuffer[4096];
+        size_t mLength;
+    };
+}
+
 // Logfile
 Logfile::Logfile(const FString& path, ostream *str, unsigned logMask, bool delStream,
                  unsigned int formatMask) :
@@ -43,78 +278,57 @@ void Logfile::Write(const LogMsg& msg)
     }
 }
 
+void Logfile::WriteBatch(const std::vector<const LogMsg*>& msgs)
+{
+    if (!mOut)
+    {
+        foreach (const LogMsg* msg, msgs)
+            Write(*msg);
+        return;
+    }
+
+    // format into a bounded buffer and hand the stream large writes
+    static const size_t chunkSize(65536);
+    AutoUnlockMutex lock(mMutex);
+    FString out;
+    out.reserve(chunkSize);
+    foreach (const LogMsg* msg, msgs)
+    {
+        out += formatMsg(*msg);
+        if (out.size() >= chunkSize)
+        {
+            mOut->write(out.data(), out.size());
+            out.clear();
+        }
+    }
+    mOut->write(out.data(), out.size());
+    mOut->flush();
+}
+
 FString Logfile::GetLevelStr(int level)
 {
-    FString levelstr;
-
-    switch (level & HLOG_ALL)
-    {
-    case HLOG_SQL:
-        levelstr = "SQL ";
-        break;
-    case HLOG_TRACE:
-        levelstr = "TRCE";
-        break;
-    case HLOG_DEBUG4:
-        levelstr = "DBG4";
-        break;
-    case HLOG_DEBUG3:
-        levelstr = "DBG3";
-        break;
-    case HLOG_DEBUG2:
-        levelstr = "DBG2";
-        break;
-    case HLOG_DEBUG1:
-        levelstr = "DBG1";
-        break;
-    case HLOG_DEBUG:
-        levelstr = "DBG ";
-        break;
-    case HLOG_INFO:
-        levelstr = "INFO";
-        break;
-    case HLOG_NOTICE:
-        levelstr = "NOTC";
-        break;
-    case HLOG_WARN:
-        levelstr = "WARN";
-        break;
-    case HLOG_ERR:
-        levelstr = "ERR ";
-        break;
-    case HLOG_CRIT:
-        levelstr = "CRIT";
-        break;
-    case HLOG_ALERT:
-        levelstr = "ALRT";
-        break;
-    case HLOG_EMERG:
-        levelstr = "EMRG";
-        break;
-    default:
-        levelstr = "????";
-        break;
-    }
-
-    return levelstr;
+    return levelName(level);
 }
 
 void Logfile::FilterSet(const LogFilter &filter)
 {
     AutoUnlockMutex lock(mMutex);
     mFileMasks[LogManager::SourceFileBasename(filter.mSourceFile)] = filter.mMask;
+    LogManager::InvalidateLogCallSites();
 }
 
 void Logfile::FilterDelete(const char *filename)
 {
     AutoUnlockMutex lock(mMutex);
     mFileMasks.erase(LogManager::SourceFileBasename(filename));
+    LogManager::InvalidateLogCallSites();
 }
 
 void Logfile::FilterDeleteAll(void)
 {
     AutoUnlockMutex lock(mMutex);
     mFileMasks.clear();
+    LogManager::InvalidateLogCallSites();
 }
 
 void Logfile::FilterList(std::vector<LogFilter> &filters)
@@ -147,6 +361,13 @@ FString Logfile::formatMsg(const LogMsg &msg)
                       msg.mThread->GetThreadID(),
                       msg.mThread->mThreadName.c_str());
     }
+    else if (msg.mThreadID)
+    {
+        thread.Format("[%d-%u-%s]",
+                      msg.mPID,
+                      msg.mThreadID,
+                      msg.mThreadName.c_str());
+    }
     else
     {
         thread.Format("[%d]", msg.mPID);
@@ -161,9 +382,8 @@ FString Logfile::formatMsg(const LogMsg &msg)
     if (padFL<0) padFL=0;
     fileLine.append(padFL,' ');
 
-    unsigned int depth = FTrace::GetDepth();
     FString offset;
-    offset.append(depth * 3, ' ');
+    offset.append(msg.mDepth * 3, ' ');
     formattedMsg.Format("%02d/%02d/%02d %02d:%02d:%02d.%03d %s%s%s|%s%s() %s%s\n",
                         lt.tm_mon + 1, lt.tm_mday, lt.tm_year % 100,
                         lt.tm_hour, lt.tm_min, lt.tm_sec,
@@ -211,6 +431,13 @@ FString Logfile::customFormatMsg(const LogMsg &msg, const int formatMask)
                           msg.mThread->GetThreadID(),
                           msg.mThread->mThreadName.c_str());
         }
+        else if (msg.mThreadID)
+        {
+            thread.Format("[%d-%u-%s]",
+                          msg.mPID,
+                          msg.mThreadID,
+                          msg.mThreadName.c_str());
+        }
         else
         {
             thread.Format("[%d]", msg.mPID);
@@ -247,9 +474,8 @@ FString Logfile::customFormatMsg(const LogMsg &msg, const int formatMask)
         {
             formattedMsg += " ";
         }
-        unsigned int depth = FTrace::GetDepth();
         FString offset;
-        offset.append(depth * 3, ' ');
+        offset.append(msg.mDepth * 3, ' ');
         formattedMsg += "|";
         formattedMsg += offset;
     }
@@ -291,6 +517,7 @@ void Logfile::SetLogMask(const unsigned int& mask)
 {
     AutoUnlockMutex lock(mMutex);
     mLogMask = mask;
+    LogManager::InvalidateLogCallSites();
 }
 
 unsigned int Logfile::GetFormatMask() const
@@ -369,11 +596,13 @@ FString SysLogfile::formatMsg(const LogMsg &msg)
 {
     FString levelstr, formattedMsg;
     levelstr = GetLevelStr(msg.mLevel);
+    const char *threadName(msg.mThread ? msg.mThread->mThreadName.c_str()
+                           : (msg.mThreadID ? msg.mThreadName.c_str() : NULL));
     formattedMsg.Format("%s [%d%s%s] %s\n",
                         levelstr.c_str(),
                         msg.mPID,
-                        msg.mThread ? "-" : "",
-                        msg.mThread ? msg.mThread->mThreadName.c_str() : "",
+                        threadName ? "-" : "",
+                        threadName ? threadName : "",
                         msg.mMsg.c_str());
     return formattedMsg;
 }
@@ -381,9 +610,15 @@ FString SysLogfile::formatMsg(const LogMsg &msg)
 
 // LogMsg
 LogMsg::LogMsg() :
-    mThread(NULL)
+    mThread(NULL),
+    mThreadID(0),
+    mDepth(0),
+    mFormat(NULL),
+    mArgs(NULL)
 {
     mPID = getpid();
+    mMonotonicTime.tv_sec = 0;
+    mMonotonicTime.tv_nsec = 0;
 }
 
 // LogThreadInfo
@@ -413,8 +648,26 @@ LogThreadInfo::~LogThreadInfo()
 // LogManager
 LogManager::LogManager()
     :mLogMaskTemplate(HLOG_ALL),
-     mLogMaskOR(HLOG_ALL)
-{
+     mLogMaskOR(HLOG_ALL),
+     mAsyncEnabled(0),
+     mAsyncRecordsPerThread(0),
+     mAsyncGeneration(0),
+     mAsyncOverflow(LOG_ASYNC_BLOCK),
+     mAsyncDropped(0),
+     mAsyncDroppedReported(0),
+     mAsyncBufferKey(&LogManager::asyncLogBufferExited),
+     mAsyncWakeCond(mAsyncWakeLock),
+     mAsyncDrainedCond(mAsyncWakeLock),
+     mAsyncWakeRequested(false),
+     mCrashHandlersInstalled(false),
+     mCrashTargetIndex(0),
+     mCrashTargetGeneration(0),
+     mCrashDumping(0),
+     mAsyncBuffersChanging(0)
+{
+    mCrashTargetCount[0] = 0;
+    mCrashTargetCount[1] = 0;
+
     // LogManager is a singleton. There is much much here which will
     // break horribly if you declare a second LogManager object in a
     // process.  If you need a second log file, add it with a second
@@ -423,6 +676,7 @@ LogManager::LogManager()
     AutoUnlockMutex lock(sLogManagerMutex);
     if (!sLogManager) {
         sLogManager = this;
+        InvalidateLogCallSites();
     }
     else
         throw EGlobalLogManagerSet();
@@ -430,9 +684,11 @@ LogManager::LogManager()
 
 LogManager::~LogManager() {
     Log(HLOG_DEBUG, "logging halted");
+    EndAsyncLogging();
     EndLogging();
     AutoUnlockMutex lock(sLogManagerMutex);
     sLogManager = NULL;
+    InvalidateLogCallSites();
 }
 
 void LogManager::BeginLogging()
@@ -477,6 +733,11 @@ void LogManager::beginLogging(const char *path, int mask, unsigned int format)
         logfile = boost::shared_ptr<SysLogfile>(
             new SysLogfile(path + 9, mask));
     }
+    else if (!strncmp(path, "//binary/", 9))
+    {
+        logfile = boost::shared_ptr<BinaryLogfile>(
+            new BinaryLogfile(path + 9, mask));
+    }
     else
     {
         ofstream *out = new ofstream(path, ios::app | ios::out);
@@ -485,22 +746,29 @@ void LogManager::beginLogging(const char *path, int mask, unsigned int format)
     }
 
     mLogfiles.push_back(logfile);
+    InvalidateLogCallSites();
 }
 
 void LogManager::BeginLogging(LogfilePtr logfile)
 {
     AutoUnlockMutex lock(mLogMutex);
     mLogfiles.push_back(logfile);
+    InvalidateLogCallSites();
 }
 
 void LogManager::EndLogging()
 {
+    if (mAsyncEnabled)
+        flushAsync();
     AutoUnlockMutex lock(mLogMutex);
     mLogfiles.clear();
+    InvalidateLogCallSites();
 }
 
 void LogManager::EndLogging(const char *path)
 {
+    if (mAsyncEnabled)
+        flushAsync();
     AutoUnlockMutex lock(mLogMutex);
     endLogging(path);
 }
@@ -511,6 +779,7 @@ void LogManager::endLogging(const char *path)  // helper - no locking
         remove_if(mLogfiles.begin(), mLogfiles.end(),
                   boost::bind(&Logfile::IsPath, _1, path)),
         mLogfiles.end());
+    InvalidateLogCallSites();
 }
 
 void LogManager::Reopen()  // re-open all log files
@@ -587,6 +856,7 @@ void LogManager::setLogMask(const char *path, unsigned int mask)
     {
         mLogMaskOR |= k->second;
     }
+    InvalidateLogCallSites();
 }
 
 void LogManager::setLogMaskOR()
@@ -615,6 +885,7 @@ void LogManager::setLogMaskOR()
     {
         mLogMaskOR |= k->second;
     }
+    InvalidateLogCallSites();
 }
 
 unsigned int LogManager::GetLogMask(const char *path)
@@ -637,6 +908,7 @@ void LogManager::SetSourceFileLogMask(const char *filename, unsigned int mask)
     AutoUnlockMutex lock(mLogMutex);
     mFileMasks[SourceFileBasename(filename)] = mask;
     mLogMaskOR |= mask;
+    InvalidateLogCallSites();
 }
 
 void LogManager::ClearSourceFileLogMask(const char *filename)
@@ -653,6 +925,7 @@ void LogManager::PathSetSourceFileLogMask(const char *path, const char *filename
     Logfile &logfile(getLogfile(path));
     logfile.FilterSet(LogFilter(SourceFileBasename(filename), mask));
     mLogMaskOR |= mask;
+    InvalidateLogCallSites();
 }
 void LogManager::PathClearSourceFileLogMask(const char *path, const char *filename)
 {
@@ -711,18 +984,26 @@ void LogManager::LogMsgVa(int level, const char *fmt, va_list ap)
 
 void LogManager::LogMsgVa(const char * func, const char * file, int line, int level, const char *fmt, va_list ap)
 {
+    // binary logfiles keep the arguments rather than the text, and
+    // vasprintf() leaves ap unusable
+    va_list args;
+    va_copy(args, ap);
     char *amsg(0);
     vasprintf(&amsg, fmt, ap);
-    LogMsgString(func, file, line, level, amsg);
+    logMsg(func, file, line, level, amsg, fmt, &args);
     free(amsg);
+    va_end(args);
 }
 
 void LogManager::LogMsgString(const char * func, const char * fullfile, int line, int level, const std::string& message)
 {
-    char tmp[128];
-    tmp[0] = 0;
-    LogMsg msg;
-    FString file(SourceFileBasename(fullfile));
+    logMsg(func, fullfile, line, level, message, NULL, NULL);
+}
+
+void LogManager::logMsg(const char * func, const char * fullfile, int line,
+                        int level, const std::string& message,
+                        const char *fmt, va_list *args)
+{
     if (level < HLOG_MIN)
     {
         // convert syslog level to HLOG level
@@ -739,7 +1020,16 @@ void LogManager::LogMsgString(const char * func, const char * fullfile, int line
         default: level = HLOG_CRIT; break;
         }
     }
+
+    if (mAsyncEnabled && logAsync(func, fullfile, line, level, message))
+        return;
+
+    char tmp[128];
+    tmp[0] = 0;
+    LogMsg msg;
+    FString file(SourceFileBasename(fullfile));
     gettimeofday(&(msg.mTime), NULL);
+    clock_gettime(CLOCK_MONOTONIC, &(msg.mMonotonicTime));
     if (gethostname(tmp, sizeof(tmp))==0)
         msg.mHost.assign(tmp);
     else
@@ -757,9 +1047,12 @@ void LogManager::LogMsgString(const char * func, const char * fullfile, int line
             msg.mThread = &(ti->mThread);
         msg.mLevel = level;
         msg.mMsg = message;
+        msg.mFormat = fmt;
+        msg.mArgs = args;
         msg.mFunction = func;
         msg.mFile = file;
         msg.mLine = line;
+        msg.mDepth = FTrace::GetDepth();
 
         // decide whether this message should be logged anywhere.
         // Decision is made by (in order of precedence):
@@ -807,6 +1100,552 @@ void LogManager::LogMsgString(const char * func, const char * fullfile, int line
     }
 }
 
+void LogManager::BeginAsyncLogging(unsigned int recordsPerThread,
+                                   unsigned int flushIntervalMs,
+                                   LogAsyncOverflowPolicy overflow)
+{
+    AutoUnlockMutex lock(mAsyncLock);
+    if (mAsyncEnabled)
+        return;
+
+    char tmp[128];
+    if (gethostname(tmp, sizeof(tmp)) == 0)
+        mHostname.assign(tmp);
+    else
+        mHostname = "(hostname too long)";
+
+    mAsyncRecordsPerThread = recordsPerThread;
+    mAsyncOverflow = overflow;
+    mAsyncDropped = 0;
+    mAsyncDroppedReported = 0;
+    ++mAsyncGeneration;
+    mAsyncWriter.reset(new AsyncLogWriter(*this, flushIntervalMs));
+    updateCrashTargets();
+    installCrashHandlers();
+
+    __sync_synchronize();
+    mAsyncEnabled = 1;
+}
+
+void LogManager::EndAsyncLogging(void)
+{
+    boost::shared_ptr<AsyncLogWriter> writer;
+    {
+        AutoUnlockMutex lock(mAsyncLock);
+        mAsyncEnabled = 0;
+        __sync_synchronize();
+        removeCrashHandlers();
+        writer = mAsyncWriter;
+        mAsyncWriter.reset();
+    }
+
+    if (writer)
+    {
+        writer->Shutdown();
+        wakeAsyncWriter();
+        // joins the writer, which flushes once more on its way out
+        writer.reset();
+    }
+
+    // anything logged by a thread that saw async logging still on
+    flushAsync();
+}
+
+void LogManager::FlushAsyncLogging(void)
+{
+    flushAsync();
+}
+
+void LogManager::wakeAsyncWriter(void)
+{
+    AutoUnlockMutex lock(mAsyncWakeLock);
+    mAsyncWakeRequested = true;
+    mAsyncWakeCond.Signal();
+}
+
+AsyncLogBuffer* LogManager::getAsyncLogBuffer(void)
+{
+    AsyncLogBuffer *buffer(static_cast<AsyncLogBuffer *>(mAsyncBufferKey.Get()));
+    if (buffer == NULL || buffer->mGeneration != mAsyncGeneration)
+    {
+        // a buffer from before the last BeginAsyncLogging() may be
+        // the wrong size, retire it like one whose thread exited
+        if (buffer != NULL)
+            buffer->mOwnerExited = 1;
+
+        boost::shared_ptr<AsyncLogBuffer> newBuffer(
+            new AsyncLogBuffer(mAsyncRecordsPerThread, mAsyncGeneration));
+        {
+            AutoUnlockMutex lock(mAsyncBuffersLock);
+            beginAsyncBuffersChange();
+            mAsyncBuffers.push_back(newBuffer);
+            endAsyncBuffersChange();
+        }
+        buffer = newBuffer.get();
+        mAsyncBufferKey.Set(buffer);
+
+        // so a stack overflow on this thread still gets its records
+        // written. threads that set up their own stack keep it
+        stack_t current;
+        if (sCrashStack == NULL
+            && sigaltstack(NULL, &current) == 0
+            && (current.ss_flags & SS_DISABLE) != 0)
+        {
+            stack_t ss;
+            ss.ss_sp = malloc(CRASH_STACK_SIZE);
+            ss.ss_size = CRASH_STACK_SIZE;
+            ss.ss_flags = 0;
+            if (ss.ss_sp != NULL && sigaltstack(&ss, NULL) == 0)
+                sCrashStack = static_cast<char *>(ss.ss_sp);
+            else
+                free(ss.ss_sp);
+        }
+    }
+    return buffer;
+}
+
+void LogManager::asyncLogBufferExited(void *buffer)
+{
+    // thread exit. the writer frees the buffer once it is drained
+    static_cast<AsyncLogBuffer *>(buffer)->mOwnerExited = 1;
+
+    if (sCrashStack != NULL)
+    {
+        stack_t ss;
+        memset(&ss, 0, sizeof(ss));
+        ss.ss_flags = SS_DISABLE;
+        if (sigaltstack(&ss, NULL) == 0)
+            free(sCrashStack);
+        sCrashStack = NULL;
+    }
+}
+
+bool LogManager::logAsync(const char *func, const char *file, int line,
+                          int level, const std::string& message)
+{
+    AsyncLogBuffer *buffer(getAsyncLogBuffer());
+    AsyncLogRecord *record;
+    while ((record = buffer->Reserve()) == NULL)
+    {
+        if (mAsyncOverflow == LOG_ASYNC_DROP)
+        {
+            __sync_fetch_and_add(&mAsyncDropped, 1);
+            return true;
+        }
+
+        // wait for the writer to drain, or fall back to writing
+        // ourselves if async logging is being turned off
+        AutoUnlockMutex lock(mAsyncWakeLock);
+        if (!mAsyncEnabled)
+            return false;
+        mAsyncWakeRequested = true;
+        mAsyncWakeCond.Signal();
+        mAsyncDrainedCond.TimedWait(
+            MonotonicClock().GetTime() + Timespec::FromMillisec(10));
+    }
+
+    gettimeofday(&(record->mTime), NULL);
+    clock_gettime(CLOCK_MONOTONIC, &(record->mMonotonicTime));
+    record->mLevel = level;
+    record->mDepth = FTrace::GetDepth();
+    record->mLine = line;
+    record->mFunction = (func ? func : "");
+    record->mFile = (file ? file : "");
+    LogThreadInfo *ti = static_cast<LogThreadInfo *>(mThreadInfoKey.Get());
+    if (ti != NULL)
+    {
+        record->mThreadID = ti->mThread.GetThreadID();
+        record->mThreadName = ti->mThread.mThreadName;
+    }
+    else
+    {
+        record->mThreadID = 0;
+    }
+    record->mMsg = message;
+    buffer->Commit();
+    return true;
+}
+
+bool LogManager::flushAsync(bool tryOnly)
+{
+    MaybeLockMutex flushLock(mAsyncFlushLock, tryOnly);
+    if (!flushLock.Locked())
+        return false;
+
+    if (!tryOnly && mCrashTargetGeneration != sLogGeneration)
+        updateCrashTargets();
+
+    std::vector<boost::shared_ptr<AsyncLogBuffer> > buffers;
+    {
+        MaybeLockMutex lock(mAsyncBuffersLock, tryOnly);
+        if (!lock.Locked())
+            return false;
+        buffers = mAsyncBuffers;
+    }
+
+    size_t count(0);
+    std::vector<AsyncLogBuffer *> exited;
+    foreach (const boost::shared_ptr<AsyncLogBuffer>& buffer, buffers)
+    {
+        // check before draining, the owner pushes nothing after
+        // setting this
+        const bool ownerExited(buffer->mOwnerExited);
+        __sync_synchronize();
+        const unsigned long head(buffer->mHead);
+        __sync_synchronize();
+
+        for (unsigned long i = buffer->mTail; i != head; ++i)
+        {
+            const AsyncLogRecord &record(buffer->mRecords[i & buffer->mMask]);
+            if (count == mAsyncBatch.size())
+                mAsyncBatch.push_back(boost::shared_ptr<LogMsg>(new LogMsg()));
+            LogMsg &msg(*mAsyncBatch[count++]);
+
+            std::map<FString, FString>::iterator basename(
+                mAsyncBasenames.find(record.mFile));
+            if (basename == mAsyncBasenames.end())
+            {
+                basename = mAsyncBasenames.insert(
+                    std::make_pair(record.mFile,
+                                   SourceFileBasename(record.mFile))).first;
+            }
+
+            msg.mTime = record.mTime;
+            msg.mMonotonicTime = record.mMonotonicTime;
+            msg.mLevel = record.mLevel;
+            msg.mHost = mHostname;
+            msg.mThread = NULL;
+            msg.mThreadID = record.mThreadID;
+            msg.mThreadName = record.mThreadName;
+            msg.mDepth = record.mDepth;
+            msg.mFunction = record.mFunction;
+            msg.mFile = basename->second;
+            msg.mLine = record.mLine;
+            msg.mMsg = record.mMsg;
+        }
+
+        __sync_synchronize();
+        buffer->mTail = head;
+
+        if (ownerExited)
+            exited.push_back(buffer.get());
+    }
+
+    const unsigned long long dropped(mAsyncDropped);
+    if (dropped != mAsyncDroppedReported)
+    {
+        if (count == mAsyncBatch.size())
+            mAsyncBatch.push_back(boost::shared_ptr<LogMsg>(new LogMsg()));
+        LogMsg &msg(*mAsyncBatch[count++]);
+        gettimeofday(&(msg.mTime), NULL);
+        clock_gettime(CLOCK_MONOTONIC, &(msg.mMonotonicTime));
+        msg.mLevel = HLOG_WARN;
+        msg.mHost = mHostname;
+        msg.mThread = NULL;
+        msg.mThreadID = 0;
+        msg.mDepth = 0;
+        msg.mFunction = __FUNCTION__;
+        msg.mFile = SourceFileBasename(__FILE__);
+        msg.mLine = __LINE__;
+        msg.mMsg.Format("async logging dropped %llu messages",
+                        dropped - mAsyncDroppedReported);
+        mAsyncDroppedReported = dropped;
+    }
+
+    bool delivered(true);
+    if (count > 0)
+    {
+        std::vector<const LogMsg *> msgs;
+        msgs.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            msgs.push_back(mAsyncBatch[i].get());
+
+        // each thread's records are in order, interleave them by time
+        std::stable_sort(msgs.begin(), msgs.end(), logMsgEarlier);
+        delivered = deliver(msgs, tryOnly);
+    }
+
+    if (!exited.empty())
+    {
+        MaybeLockMutex lock(mAsyncBuffersLock, tryOnly);
+        if (lock.Locked())
+        {
+            foreach (AsyncLogBuffer *buffer, exited)
+            {
+                std::vector<boost::shared_ptr<AsyncLogBuffer> >::iterator i;
+                for (i = mAsyncBuffers.begin(); i != mAsyncBuffers.end(); ++i)
+                {
+                    if (i->get() == buffer)
+                    {
+                        beginAsyncBuffersChange();
+                        mAsyncBuffers.erase(i);
+                        endAsyncBuffersChange();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // let threads blocked on a full buffer retry
+    if (!tryOnly)
+    {
+        AutoUnlockMutex lock(mAsyncWakeLock);
+        mAsyncDrainedCond.Broadcast();
+    }
+
+    return delivered;
+}
+
+bool LogManager::deliver(const std::vector<const LogMsg *>& msgs, bool tryOnly)
+{
+    LogfileWeakVector logfiles;
+    std::vector<const LogMsg *> accepted;
+    std::vector<bool> fileSpecific;
+
+    {
+        MaybeLockMutex lock(mLogMutex, tryOnly);
+        if (!lock.Locked())
+            return false;
+        copy(mLogfiles.begin(), mLogfiles.end(), back_inserter(logfiles));
+
+        // same precedence as LogMsgString()
+        foreach (const LogMsg *msg, msgs)
+        {
+            std::map<FString,unsigned int>::const_iterator mask(
+                mFileMasks.find(msg->mFile));
+            if (mask == mFileMasks.end())
+            {
+                accepted.push_back(msg);
+                fileSpecific.push_back(false);
+            }
+            else if ((msg->mLevel & mask->second) != 0)
+            {
+                accepted.push_back(msg);
+                fileSpecific.push_back(true);
+            }
+        }
+    }
+
+    std::vector<const LogMsg *> batch;
+    foreach (LogfileWeakVector::value_type& i, logfiles)
+    {
+        LogfilePtr lf(i.lock());
+        if (!lf)
+            continue;
+
+        const unsigned int logMask(lf->GetLogMask());
+        batch.clear();
+        for (size_t n = 0; n < accepted.size(); ++n)
+        {
+            const LogMsg *msg(accepted[n]);
+            const pair<bool, unsigned int> valuePair(lf->GetFileMask(msg->mFile));
+
+            if (valuePair.first)
+            {
+                if ((msg->mLevel & valuePair.second) != 0)
+                    batch.push_back(msg);
+            }
+            else if (fileSpecific[n] || (msg->mLevel & logMask) != 0)
+            {
+                batch.push_back(msg);
+            }
+        }
+
+        if (!batch.empty())
+            lf->WriteBatch(batch);
+    }
+
+    return true;
+}
+
+void LogManager::installCrashHandlers(void)
+{
+    if (mCrashHandlersInstalled)
+        return;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &LogManager::crashHandler;
+    sa.sa_flags = SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    foreach (int sig, sCrashSignals)
+        sigaction(sig, &sa, &mOldCrashActions[sig]);
+    mCrashHandlersInstalled = true;
+}
+
+void LogManager::removeCrashHandlers(void)
+{
+    if (!mCrashHandlersInstalled)
+        return;
+
+    foreach (int sig, sCrashSignals)
+    {
+        // whoever replaced ours after it was installed keeps theirs
+        struct sigaction current;
+        if (sigaction(sig, NULL, &current) == 0
+            && current.sa_handler == &LogManager::crashHandler)
+        {
+            sigaction(sig, &mOldCrashActions[sig], NULL);
+        }
+    }
+    mCrashHandlersInstalled = false;
+}
+
+void LogManager::updateCrashTargets(void)
+{
+    AutoUnlockMutex lock(mLogMutex);
+
+    // only the copy the handler is not reading is rewritten
+    const int next(1 - mCrashTargetIndex);
+    unsigned int count(0);
+    foreach (const LogfilePtr &lf, mLogfiles)
+    {
+        // binary logs and syslog have no text stream to append to
+        if (!lf || lf->mOut == NULL || count == MAX_CRASH_TARGETS)
+            continue;
+
+        CrashTarget &target(mCrashTargets[next][count]);
+        if (lf->mPath == "//stderr")
+            target.mFD = STDERR_FILENO;
+        else if (lf->mPath == "//stdout")
+            target.mFD = STDOUT_FILENO;
+        else if (lf->mPath.compare(0, 2, "//") == 0
+                 || lf->mPath.size() >= sizeof(target.mPath))
+            continue;
+        else
+            target.mFD = -1;
+        strcpy(target.mPath, lf->mPath.c_str());
+        target.mMask = lf->GetLogMask();
+        ++count;
+    }
+    mCrashTargetCount[next] = count;
+
+    __sync_synchronize();
+    mCrashTargetIndex = next;
+    mCrashTargetGeneration = sLogGeneration;
+}
+
+void LogManager::beginAsyncBuffersChange(void)
+{
+    // mAsyncBuffersLock is held, so crashDump() is the only other
+    // party
+    while (true)
+    {
+        mAsyncBuffersChanging = 1;
+        __sync_synchronize();
+        if (!mCrashDumping)
+            return;
+        mAsyncBuffersChanging = 0;
+        usleep(1000);
+    }
+}
+
+void LogManager::endAsyncBuffersChange(void)
+{
+    __sync_synchronize();
+    mAsyncBuffersChanging = 0;
+}
+
+void LogManager::crashDump(void)
+{
+    mCrashDumping = 1;
+    __sync_synchronize();
+
+    // a change to mAsyncBuffers takes microseconds. if the crashing
+    // thread is the one making it, give up on the records
+    for (int i = 0; mAsyncBuffersChanging && i < 1000; ++i)
+        usleep(1000);
+    if (mAsyncBuffersChanging)
+        return;
+
+    const int index(mCrashTargetIndex);
+    const unsigned int count(mCrashTargetCount[index]);
+    int fds[MAX_CRASH_TARGETS];
+    for (unsigned int t = 0; t < count; ++t)
+    {
+        const CrashTarget &target(mCrashTargets[index][t]);
+        fds[t] = (target.mFD >= 0 ? target.mFD
+                  : open(target.mPath, O_WRONLY | O_APPEND));
+    }
+
+    // records from tail to head were committed and not yet written.
+    // the writer may be part way through them, so some may be written
+    // twice
+    foreach (const boost::shared_ptr<AsyncLogBuffer>& buffer, mAsyncBuffers)
+    {
+        const unsigned long head(buffer->mHead);
+        __sync_synchronize();
+        for (unsigned long i = buffer->mTail; i != head; ++i)
+        {
+            const AsyncLogRecord &record(buffer->mRecords[i & buffer->mMask]);
+            CrashLine line;
+            line.AppendNumber(record.mTime.tv_sec);
+            line.Append(".");
+            line.AppendNumber(record.mTime.tv_usec, 6);
+            line.Append(" ");
+            line.Append(levelName(record.mLevel));
+            line.Append(" [");
+            line.AppendNumber(record.mThreadID);
+            line.Append("] ");
+            line.Append(record.mFunction.c_str(), record.mFunction.size());
+            line.Append(":");
+            line.AppendNumber(record.mLine);
+            line.Append(" ");
+            line.Append(record.mMsg.c_str(), record.mMsg.size());
+            line.Append("\n");
+
+            for (unsigned int t = 0; t < count; ++t)
+            {
+                if (fds[t] >= 0
+                    && (record.mLevel & mCrashTargets[index][t].mMask) != 0)
+                {
+                    line.Write(fds[t]);
+                }
+            }
+        }
+    }
+
+    for (unsigned int t = 0; t < count; ++t)
+    {
+        if (fds[t] >= 0 && mCrashTargets[index][t].mFD < 0)
+            close(fds[t]);
+    }
+    // left set, nothing is written after this
+}
+
+void LogManager::crashHandler(int sig)
+{
+    // only async signal safe calls from here: the process is going
+    // down and the queued messages are the ones most likely to say
+    // why. a second fatal signal while dumping goes straight to the
+    // default action
+    static volatile int entered(0);
+    const int savedErrno(errno);
+    LogManager *logManager(sLogManager);
+    if (logManager != NULL && __sync_lock_test_and_set(&entered, 1) == 0)
+    {
+        logManager->mAsyncEnabled = 0;
+        logManager->crashDump();
+        // restore the previous action, unless ours was replaced
+        // meanwhile, in which case this was left as the default
+        struct sigaction current;
+        if (sigaction(sig, NULL, &current) == 0
+            && current.sa_handler == &LogManager::crashHandler)
+        {
+            sigaction(sig, &logManager->mOldCrashActions[sig], NULL);
+        }
+    }
+    else
+    {
+        signal(sig, SIG_DFL);
+    }
+    errno = savedErrno;
+
+    // delivered to the previous handler once this one returns
+    raise(sig);
+}
+
 // hermes API compatibility:
 void _hlog(const char *func, const char * file, int line, int level, const char * fmt, ...)
 {
@@ -837,27 +1676,78 @@ bool LogManager::ShouldLog(const char * func, const char * file, int line, int l
     return false;
 }
 
-bool _should_hlog(const char *func, const char * file, int line, int level)
+bool LogManager::ShouldLogExact(const char * fullfile, int level)
 {
-    try
+    if (!(mLogMaskOR & level))
+        return false;
+
+    FString file(SourceFileBasename(fullfile));
+    AutoUnlockMutex lock(mLogMutex);
+
+    bool fileSpecific(false);
+    std::map<FString,unsigned int>::const_iterator mask(mFileMasks.find(file));
+    if (mask != mFileMasks.end())
     {
-        LogManager *log_mgr(0);
+        if ((level & mask->second) == 0)
+            return false;
+        fileSpecific = true;
+    }
+
+    foreach (const LogfilePtr& lf, mLogfiles)
+    {
+        const pair<bool, unsigned int> valuePair(lf->GetFileMask(file));
+        if (valuePair.first)
         {
-            AutoUnlockMutex lock(LogManager::GetSingletonMutex());
-            log_mgr = LogManager::GetInstancePtr();
+            if ((level & valuePair.second) != 0)
+                return true;
         }
-        if (log_mgr != NULL)
+        else if (fileSpecific || (level & lf->GetLogMask()) != 0)
         {
-            return log_mgr->ShouldLog(func, file, line, level);
+            return true;
         }
     }
-    catch (...)
+
+    return false;
+}
+
+bool _should_hlog(const char *func, const char * file, int line, int level)
+{
+    // the pointer and the mask are each a single aligned load, the
+    // singleton mutex would not make the result any less stale
+    LogManager *log_mgr(LogManager::GetInstancePtr());
+    if (log_mgr != NULL)
     {
+        return log_mgr->ShouldLog(func, file, line, level);
     }
 
     return false;
 }
 
+bool _should_hlog_slow(Forte::LogCallSite& site, const char *func,
+                       const char *file, int line, int level)
+{
+    // read the generation before deciding, so a change made while
+    // deciding leaves the site stale instead of wrongly current
+    const unsigned int generation(LogManager::sLogGeneration);
+    __sync_synchronize();
+
+    bool decision(false);
+    try
+    {
+        LogManager *log_mgr(LogManager::GetInstancePtr());
+        if (log_mgr != NULL)
+            decision = log_mgr->ShouldLogExact(file, level);
+    }
+    catch (...)
+    {
+    }
+
+    site.mCached = (static_cast<unsigned long long>(generation) << 32)
+        | (static_cast<unsigned long long>(level & HLOG_ALL) << 1)
+        | (decision ? 1 : 0);
+    return decision;
+}
+
 void _hlogstream(const char *func, const char * file, int line, int level, const std::string& message)
 {
     try
@@ -17,6 +17,7 @@
 #include "ThreadKey.h"
 #include <syslog.h>
 #include <stdarg.h>
+#include <signal.h>
 #include <boost/throw_exception.hpp>
 
 #define HLOG_NONE        0x00000000
@@ -64,13 +65,29 @@ namespace Forte
     EXCEPTION_SUBCLASS2(ELog, ELogLevelStringUnknown, "Log level string is unknown");
     EXCEPTION_SUBCLASS2(ELog, EGlobalLogManagerSet, "A global log manager is already selected");
 
+    /**
+     * What a thread logging in async mode does when its buffer is
+     * full.
+     */
+    enum LogAsyncOverflowPolicy {
+        LOG_ASYNC_BLOCK, ///< wait for the writer thread to make room
+        LOG_ASYNC_DROP   ///< drop the message and count it
+    };
+
     class LogMsg : public Object {
     public:
         LogMsg();
         struct timeval mTime;
+        // CLOCK_MONOTONIC when the message was logged
+        struct timespec mMonotonicTime;
         int mLevel;
         FString mHost;
         Thread *mThread;
+        // thread id and name, filled in when mThread may no longer
+        // be valid by the time the message is written
+        unsigned int mThreadID;
+        FString mThreadName;
+        unsigned int mDepth;
         FString mFunction;
         FString mFile;
         int mLine;
@@ -78,6 +95,11 @@ namespace Forte
         struct in_addr mClient;
         FString mPrefix;
         FString mMsg;
+        // the printf format mMsg was built from and its arguments,
+        // only set while a message logged by hlog() is being written
+        // on the calling thread. NULL otherwise
+        const char *mFormat;
+        va_list *mArgs;
     };
 
     class LogFilter : public Object {
@@ -115,6 +137,15 @@ namespace Forte
         void FilterList(std::vector<LogFilter> &filters);
 
         virtual void Write(const LogMsg& msg);
+
+        /**
+         * Write a batch of messages from the async log writer. When
+         * there is a stream the batch is formatted into large writes
+         * and flushed once, otherwise each message goes to Write().
+         * Subclasses that override Write() and also have a stream
+         * should override this too.
+         */
+        virtual void WriteBatch(const std::vector<const LogMsg*>& msgs);
         virtual bool Reopen() { return false; }  // true is reopened, false is not
         static FString GetLevelStr(int level);
 
@@ -160,7 +191,21 @@ namespace Forte
         const FString mIdent;
     };
 
+    /**
+     * Per call site cache of whether a log statement at a given level
+     * would be written anywhere. hlog() and friends keep one as a
+     * function local static. It packs the LogManager generation it
+     * was computed under, the level, and the decision into one word
+     * so it can be read and written without a lock. It must stay a
+     * POD so the static is zero initialized without a guard.
+     */
+    struct LogCallSite {
+        volatile unsigned long long mCached;
+    };
+
     class LogManager;
+    class AsyncLogBuffer;
+    class AsyncLogWriter;
     class LogThreadInfo : public Object {
         friend class LogManager;
     public:
@@ -226,6 +271,7 @@ namespace Forte
      **/
     class LogManager : public Object {
         friend class LogThreadInfo;
+        friend class AsyncLogWriter;
     public:
         typedef boost::shared_ptr<Logfile> LogfilePtr;
         typedef std::vector<LogfilePtr> LogfileVector;
@@ -241,6 +287,16 @@ namespace Forte
          * NOTE: you MUST hold the sLogManagerMutex prior to calling these!
          */
         inline static LogManager* GetInstancePtr() { return sLogManager; }
+
+        /**
+         * Bumped whenever anything that decides whether a message is
+         * logged changes: log masks, filters, logfiles, or the
+         * LogManager itself. Invalidates every LogCallSite.
+         */
+        static volatile unsigned int sLogGeneration;
+        static void InvalidateLogCallSites(void) {
+            __sync_add_and_fetch(&sLogGeneration, 1);
+        }
         inline static LogManager & GetInstance() {
             if (sLogManager) return *sLogManager; else throw EEmptyReference("no log manager instance");
         }
@@ -256,7 +312,8 @@ namespace Forte
 
         /**
          *BeginLogging(const char *path) takes a file path you want to log to. Special cases
-         *for the path can be //stdout or //stderr. The types of error messages logged
+         *for the path can be //stdout or //stderr, and //binary/<file> logs to file
+         *in the format written by BinaryLogfile. The types of error messages logged
          *are specified by SetGlobalLogMask. If SetGlobalLogMask does not
          *specify anything, by default all types of error messages are logged. You can
          *call BeginLogging(const char *path) as many times as you want.
@@ -313,6 +370,15 @@ namespace Forte
         void SetLogMask(const char *path, unsigned int mask); // bitmask of desired log levels
         unsigned int GetLogMask(const char *path);
         bool ShouldLog(const char * func, const char * file, int line, int level);
+
+        /**
+         * ShouldLogExact() decides whether a message from file at
+         * level would be written to any logfile, applying the global
+         * and per path source file masks the same way LogMsgString()
+         * does. It takes the log mutex, hlog() only calls it when its
+         * LogCallSite is stale.
+         */
+        bool ShouldLogExact(const char * file, int level);
         /**
          *SetGlobalLogMask(unsigned int mask) takes an unsigned int mask representing
          *different levels of error messages. The list of error messages you provide
@@ -427,6 +493,52 @@ namespace Forte
 
         static FString LogMaskStr(int mask);
 
+        /**
+         * BeginAsyncLogging() moves the formatting and writing of log
+         * messages off the calling thread. Each thread appends its
+         * messages to its own buffer of recordsPerThread entries and
+         * a writer thread formats them and writes them to every
+         * logfile in one batch each flushIntervalMs milliseconds, or
+         * sooner when a buffer fills. overflow decides what a thread
+         * does when its buffer is full.
+         *
+         * Queued messages are written by EndAsyncLogging(),
+         * FlushAsyncLogging(), the LogManager destructor, and on a
+         * best effort basis when the process gets a fatal signal. The
+         * signal handler only makes async signal safe calls: it writes
+         * each queued message's fields as a plain line, with write(2),
+         * to the files and standard streams being logged to at the
+         * last flush, filtered by their level masks only. It runs on
+         * an alternate signal stack in threads that have logged, so a
+         * stack overflow is reported too.
+         */
+        void BeginAsyncLogging(unsigned int recordsPerThread = 4096,
+                               unsigned int flushIntervalMs = 100,
+                               LogAsyncOverflowPolicy overflow = LOG_ASYNC_BLOCK);
+
+        /**
+         * EndAsyncLogging() writes out everything queued, stops the
+         * writer thread and goes back to writing on the calling
+         * thread.
+         */
+        void EndAsyncLogging(void);
+
+        /**
+         * FlushAsyncLogging() writes out everything queued so far
+         * before returning.
+         */
+        void FlushAsyncLogging(void);
+
+        bool IsAsyncLogging(void) const { return mAsyncEnabled != 0; }
+
+        /**
+         * Number of messages dropped under LOG_ASYNC_DROP since
+         * BeginAsyncLogging().
+         */
+        unsigned long long GetAsyncDroppedCount(void) const {
+            return mAsyncDropped;
+        }
+
         /**
          * ComputeLogMaskFromString will take the given string and
          * return an integer log mask.  Bitwise OR of the log levels
@@ -474,6 +586,28 @@ namespace Forte
         void setLogMask(const char *path, unsigned int mask);
         void setLogMaskOR();
 
+        // LogMsgString(), also passing the format and arguments the
+        // message was built from when there are some
+        void logMsg(const char *func, const char *file, int line, int level,
+                    const std::string& message, const char *fmt,
+                    va_list *args);
+        bool logAsync(const char *func, const char *file, int line,
+                      int level, const std::string& message);
+        AsyncLogBuffer* getAsyncLogBuffer(void);
+        // returns false if a lock could not be taken without
+        // blocking and tryOnly is set
+        bool flushAsync(bool tryOnly = false);
+        bool deliver(const std::vector<const LogMsg*>& msgs, bool tryOnly);
+        void wakeAsyncWriter(void);
+        void installCrashHandlers(void);
+        void removeCrashHandlers(void);
+        void updateCrashTargets(void);
+        void crashDump(void);
+        void beginAsyncBuffersChange(void);
+        void endAsyncBuffersChange(void);
+        static void asyncLogBufferExited(void *buffer);
+        static void crashHandler(int sig);
+
     protected:
         friend class Mutex;
         typedef std::vector<boost::weak_ptr<LogfileVector::value_type::element_type> > LogfileWeakVector;
@@ -482,8 +616,8 @@ namespace Forte
         ThreadKey mThreadInfoKey;
         Mutex mLogMutex;
         unsigned mLogMaskTemplate;
-        unsigned mLogMaskOR;
-        static LogManager *sLogManager;
+        volatile unsigned mLogMaskOR;
+        static LogManager * volatile sLogManager;
         static Mutex sLogManagerMutex;
 
         // Source File specific log masks (global)
@@ -491,6 +625,53 @@ namespace Forte
 
         std::map<FString,time_t> mRateLimitedTimestamps;
 
+        // async logging. mAsyncLock guards starting and stopping the
+        // writer, mAsyncFlushLock serializes draining the buffers and
+        // is taken before mLogMutex
+        Mutex mAsyncLock;
+        Mutex mAsyncFlushLock;
+        volatile int mAsyncEnabled;
+        unsigned int mAsyncRecordsPerThread;
+        unsigned int mAsyncGeneration;
+        LogAsyncOverflowPolicy mAsyncOverflow;
+        volatile unsigned long long mAsyncDropped;
+        unsigned long long mAsyncDroppedReported;
+        ThreadKey mAsyncBufferKey;
+        Mutex mAsyncBuffersLock;
+        std::vector<boost::shared_ptr<AsyncLogBuffer> > mAsyncBuffers;
+        boost::shared_ptr<AsyncLogWriter> mAsyncWriter;
+        // mAsyncWakeCond wakes the writer early, mAsyncDrainedCond
+        // wakes threads waiting for room in a full buffer
+        Mutex mAsyncWakeLock;
+        ThreadCondition mAsyncWakeCond;
+        ThreadCondition mAsyncDrainedCond;
+        bool mAsyncWakeRequested;
+        FString mHostname;
+        // writer only, used under mAsyncFlushLock
+        std::vector<boost::shared_ptr<LogMsg> > mAsyncBatch;
+        std::map<FString, FString> mAsyncBasenames;
+        bool mCrashHandlersInstalled;
+        struct sigaction mOldCrashActions[NSIG];
+
+        // where crashDump() writes, as of the last flush. two copies
+        // so the handler never reads one being rewritten; both are
+        // written under mLogMutex
+        enum { MAX_CRASH_TARGETS = 8, MAX_CRASH_TARGET_PATH = 256 };
+        struct CrashTarget {
+            char mPath[MAX_CRASH_TARGET_PATH];
+            int mFD;             // for the standard streams, else -1
+            unsigned int mMask;
+        };
+        CrashTarget mCrashTargets[2][MAX_CRASH_TARGETS];
+        unsigned int mCrashTargetCount[2];
+        volatile int mCrashTargetIndex;
+        unsigned int mCrashTargetGeneration;
+        // crashDump() reads mAsyncBuffers without a lock. it sets
+        // mCrashDumping and changes to mAsyncBuffers set
+        // mAsyncBuffersChanging, and each waits out the other
+        volatile int mCrashDumping;
+        volatile int mAsyncBuffersChanging;
+
         void beginLogging(const char *path, int mask, unsigned int format); // helper - no locking
         void endLogging(const char *path);    // helper - no locking
 
@@ -501,24 +682,45 @@ namespace Forte
 //void hlog(int level, const char* fmt, ...);
 
 bool _should_hlog(const char *func, const char * file, int line, int level);
+bool _should_hlog_slow(Forte::LogCallSite& site, const char *func,
+                       const char *file, int line, int level);
+
+/**
+ * Lock free check used by the hlog macros. When the call site's cached
+ * decision was made under the current generation and for this level
+ * it is a couple of loads and a compare.
+ */
+inline bool _should_hlog(Forte::LogCallSite& site, const char *func,
+                         const char *file, int line, int level)
+{
+    const unsigned long long cached(site.mCached);
+    if (static_cast<unsigned int>(cached >> 32) == Forte::LogManager::sLogGeneration
+        && static_cast<unsigned int>((cached >> 1) & HLOG_ALL) == (level & HLOG_ALL))
+    {
+        return (cached & 1) != 0;
+    }
+    return _should_hlog_slow(site, func, file, line, level);
+}
 
 void _hlog(const char *func, const char *file, int line, int level, const char * fmt, ...) __attribute__((format(printf, 5, 6)));
 #define hlog(level, fmt...) \
     { \
+        static Forte::LogCallSite _site; \
         const char* _func(__FUNCTION__); \
         const char* _file(__FILE__); \
         const unsigned int _line (__LINE__); \
-        if(_should_hlog(_func, _file, _line, level)) \
+        if(_should_hlog(_site, _func, _file, _line, level)) \
             _hlog(_func, _file, _line, level, fmt); \
     }
 
 void _hlogstream(const char *func, const char *file, int line, int level, const std::string& message);
 #define hlogstream(level, message) \
     { \
+        static Forte::LogCallSite _site; \
         const char* _func(__FUNCTION__); \
         const char* _file(__FILE__); \
         const unsigned int _line (__LINE__); \
-        if(_should_hlog(_func, _file, _line, level)) \
+        if(_should_hlog(_site, _func, _file, _line, level)) \
         { \
             std::ostringstream o;                                           \
             o << message;                                                   \
@@ -529,10 +731,11 @@ void _hlogstream(const char *func, const char *file, int line, int level, const
 void _hlog_errno(const char* func, const char* file, int line, int level);
 #define hlog_errno(level) \
     { \
+        static Forte::LogCallSite _site; \
         const char* _func(__FUNCTION__); \
         const char* _file(__FILE__); \
         const unsigned int _line (__LINE__); \
-        if(_should_hlog(_func, _file, _line, level)) \
+        if(_should_hlog(_site, _func, _file, _line, level)) \
             _hlog_errno(_func, _file, _line, level); \
     }
 
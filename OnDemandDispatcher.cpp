@@ -128,6 +128,8 @@ void * Forte::OnDemandDispatcherWorker::run()
     OnDemandDispatcher &disp(dynamic_cast<OnDemandDispatcher&>(mDispatcher));
     mThreadName.Format("%s-od", disp.mDispatcherName.c_str());
     disp.mRequestHandler->Init();
+    // includes the wait for a free thread and starting this one
+    disp.recordQueueWait(*getRawEventPointer());
     disp.mRequestHandler->Handler(getRawEventPointer());
     clearEvent();
     // thread is complete at this point, resetting our event pointer
@@ -202,6 +204,12 @@ void Forte::OnDemandDispatcher::Enqueue(boost::shared_ptr<Event> e)
     mEventQueue.Add(e);
 }
 
+void Forte::OnDemandDispatcher::EnqueueBatch(
+    std::list<boost::shared_ptr<Event> > &events)
+{
+    mEventQueue.AddBatch(events);
+}
+
 bool Forte::OnDemandDispatcher::Accepting(void)
 {
     return mEventQueue.Accepting();
@@ -45,6 +45,7 @@ namespace Forte
         virtual void Pause(void);
         virtual void Resume(void);
         virtual void Enqueue(boost::shared_ptr<Event> e);
+        virtual void EnqueueBatch(std::list<boost::shared_ptr<Event> > &events);
         virtual bool Accepting(void);
 
         inline int GetQueuedEvents(
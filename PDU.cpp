@@ -75,6 +75,38 @@ const boost::shared_ptr<PDUOptionalData>& PDU::GetOptionalData() const
     return mOptionalData;
 }
 
+PDUView::PDUView(const boost::shared_ptr<PDU>& pdu)
+    : mHeader(pdu->GetHeader()),
+      mPayload(pdu->GetPayload<char>()),
+      mOptionalData(NULL),
+      mHolder(pdu)
+{
+    if (pdu->GetOptionalData())
+    {
+        mOptionalData =
+            static_cast<const char*>(pdu->GetOptionalData()->GetData());
+    }
+}
+
+void PDUView::CopyTo(PDU& out) const
+{
+    out.SetHeader(mHeader);
+    out.SetPayload(mHeader.payloadSize, mPayload);
+
+    if (mHeader.optionalDataSize > 0)
+    {
+        boost::shared_ptr<PDUOptionalData> od(
+            new PDUOptionalData(mHeader.optionalDataSize,
+                                mHeader.optionalDataAttributes,
+                                mOptionalData));
+        out.SetOptionalData(od);
+    }
+    else
+    {
+        out.SetOptionalData(boost::shared_ptr<PDUOptionalData>());
+    }
+}
+
 bool PDU::operator==(const PDU &other) const
 {
     bool res =
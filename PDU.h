@@ -241,6 +241,78 @@ namespace Forte
         boost::shared_ptr<PDUOptionalData> mOptionalData;
     };
 
+    /**
+     * PDUView is a read only PDU that does not own its payload or
+     * optional data. It points at bytes held alive by a reference
+     * counted holder, typically a region of a PDUPeerEndpoint receive
+     * buffer, and those bytes stay valid for as long as any copy of
+     * the view exists. Views hold the region against reuse, so
+     * consumers should drop them promptly and CopyTo a PDU anything
+     * they need to keep.
+     */
+    class PDUView
+    {
+      public:
+        PDUView()
+            : mPayload(NULL),
+              mOptionalData(NULL)
+            {}
+
+        PDUView(const PDUHeader& header,
+                const char* payload,
+                const char* optionalData,
+                const boost::shared_ptr<void>& holder)
+            : mHeader(header),
+              mPayload(payload),
+              mOptionalData(optionalData),
+              mHolder(holder)
+            {}
+
+        // view of a PDU that owns its own buffers
+        explicit PDUView(const boost::shared_ptr<PDU>& pdu);
+
+        void Reset() {
+            mHeader = PDUHeader();
+            mPayload = NULL;
+            mOptionalData = NULL;
+            mHolder.reset();
+        }
+
+        bool Empty() const { return !mHolder; }
+
+        const PDUHeader& GetHeader(void) const { return mHeader; }
+        unsigned int GetVersion(void) const { return mHeader.version; }
+        unsigned int GetOpcode(void) const { return mHeader.opcode; }
+        unsigned int GetPayloadSize(void) const { return mHeader.payloadSize; }
+        unsigned int GetOptionalDataSize(void) const {
+            return mHeader.optionalDataSize;
+        }
+        unsigned int GetOptionalDataAttributes(void) const {
+            return mHeader.optionalDataAttributes;
+        }
+
+        template <typename PayloadType>
+            const PayloadType *GetPayload(void) const
+        {
+            return reinterpret_cast<const PayloadType*>(mPayload);
+        }
+
+        const void* GetOptionalData(void) const {
+            return mOptionalData;
+        }
+
+        /**
+         * Copy the viewed bytes into a PDU that owns them.
+         */
+        void CopyTo(PDU& out) const;
+
+      protected:
+        PDUHeader mHeader;
+        const char* mPayload;
+        const char* mOptionalData;
+        boost::shared_ptr<void> mHolder;
+    };
+
     std::ostream& operator<<(std::ostream& os, const PDU &obj);
     std::ostream& operator<<(std::ostream& os, const PDUHeader &obj);
 };
@@ -93,6 +93,20 @@ namespace Forte
          */
         virtual bool RecvPDU(Forte::PDU &out) = 0;
 
+        /**
+         * Pull PDU from queue without copying it, where the endpoint
+         * allows. see PDUPeerEndpoint::RecvPDUView
+         *
+         * @return true if a PDU was received
+         */
+        virtual bool RecvPDUView(Forte::PDUView &out) {
+            boost::shared_ptr<PDU> pdu(new PDU());
+            if (!RecvPDU(*pdu))
+                return false;
+            out = PDUView(pdu);
+            return true;
+        }
+
         void SetEventCallback(PDUPeerEventCallback f) {
             Forte::AutoUnlockMutex lock(mEventCallbackMutex);
             mEventCallback = f;
@@ -14,6 +14,7 @@
 #include "Locals.h"
 #include <boost/function.hpp>
 #include "CumulativeMovingAverage.h"
+#include "PerCPUCounter.h"
 
 EXCEPTION_CLASS(EPDUPeerEndpoint);
 
@@ -66,8 +67,9 @@ namespace Forte
         public ThreadedObject,
         public EnableStats<PDUPeerEndpoint,
                            Locals<PDUPeerEndpoint,
-                                  int64_t, int64_t, int64_t,
-                                  int64_t, int64_t, int64_t,
+                                  PerCPUCounter, PerCPUCounter,
+                                  PerCPUCounter, PerCPUCounter,
+                                  PerCPUCounter, PerCPUCounter,
                                   int64_t, CumulativeMovingAverage
                                   > >
     {
@@ -168,6 +170,24 @@ namespace Forte
          */
         virtual bool RecvPDU(Forte::PDU &out) = 0;
 
+        /**
+         * Receive a PDU without copying it out of the endpoint, if
+         * the endpoint supports that. The view keeps the received
+         * bytes alive until it is dropped. The default implementation
+         * receives a PDU and views it.
+         *
+         * @param out
+         *
+         * @return true if a PDU was received, false if not.
+         */
+        virtual bool RecvPDUView(Forte::PDUView &out) {
+            boost::shared_ptr<PDU> pdu(new PDU());
+            if (!RecvPDU(*pdu))
+                return false;
+            out = PDUView(pdu);
+            return true;
+        }
+
         /**
          * If an endpoint has registered with epoll, the event will
          * come through here.
@@ -210,12 +230,13 @@ namespace Forte
     protected:
         int mID;
 
-        int64_t mPDUSendCount;
-        int64_t mPDURecvCount;
-        int64_t mPDUSendErrors;
-        int64_t mByteSendCount;
-        int64_t mByteRecvCount;
-        int64_t mDisconnectCount;
+        // bumped from the send, receive and event threads at once
+        PerCPUCounter mPDUSendCount;
+        PerCPUCounter mPDURecvCount;
+        PerCPUCounter mPDUSendErrors;
+        PerCPUCounter mByteSendCount;
+        PerCPUCounter mByteRecvCount;
+        PerCPUCounter mDisconnectCount;
         int64_t mPDURecvReadyCount;
         CumulativeMovingAverage mPDURecvReadyCountAvg;
 
@@ -19,10 +19,13 @@ PDUPeerEndpointFD::PDUPeerEndpointFD(
     unsigned int sendTimeoutSeconds,
     unsigned int recvBufferSize,
     unsigned int recvBufferMaxSize,
-    unsigned int recvBufferStepSize)
-    : mPDUSendQueue(pduSendQueue),
+    unsigned int recvBufferStepSize,
+    PDUPeerEndpointMode mode)
+    : mMode(mode),
+      mPDUSendQueue(pduSendQueue),
       mEPollMonitor(epollMonitor),
       mFD(-1),
+      mConnecting(false),
       mSendTimeoutSeconds(sendTimeoutSeconds),
       mSendState(SendStateDisconnected),
       mRecvWorkAvailableCondition(mRecvBufferMutex),
@@ -38,7 +41,13 @@ PDUPeerEndpointFD::PDUPeerEndpointFD(
           : recvBufferStepSize),
       mRecvBuffer(new char[mRecvBufferSize]),
       mCalculator(mRecvBuffer.get(), recvBufferSize),
-      mEventAvailableCondition(mEventQueueMutex)
+      mEventAvailableCondition(mEventQueueMutex),
+      mRecvBlocked(false),
+      mEventDispatchActive(false),
+      mSendBatch(SEND_COALESCE_MAX_PDUS, SEND_COALESCE_MAX_BYTES),
+      mSendTimer(-1),
+      mConnectTimer(-1),
+      mSendTimerArmed(false)
 {
     FTRACE2("%d", static_cast<int>(mFD));
 
@@ -54,6 +63,37 @@ void PDUPeerEndpointFD::Start()
 {
     recordStartCall();
 
+    if (mMode == PDU_PEER_ENDPOINT_EVENT_LOOP)
+    {
+        mPDUSendQueue->SetNotEmptyCallback(
+            boost::bind(&PDUPeerEndpointFD::eventLoopPDUQueued, this));
+
+        // the timers hold a reference until Shutdown() removes them,
+        // which also waits out a handler that is running
+        mSendTimer = mEPollMonitor->AddTimer(
+            boost::bind(
+                &PDUPeerEndpointFD::eventLoopSendTimeout,
+                boost::static_pointer_cast<PDUPeerEndpointFD>(
+                    shared_from_this())));
+        mConnectTimer = mEPollMonitor->AddTimer(
+            boost::bind(
+                &PDUPeerEndpointFD::eventLoopConnect,
+                boost::static_pointer_cast<PDUPeerEndpointFD>(
+                    shared_from_this())));
+
+        // there is no thread waiting to connect in this mode. try
+        // once now, later attempts are made as PDUs are queued
+        mEPollMonitor->Post(
+            boost::bind(
+                &PDUPeerEndpointFD::eventLoopConnect,
+                boost::static_pointer_cast<PDUPeerEndpointFD>(
+                    shared_from_this())));
+
+        // pick up anything queued before we were started
+        eventLoopRearm();
+        return;
+    }
+
     mSendThread.reset(
         new FunctionThread(
             FunctionThread::AutoInit(),
@@ -78,6 +118,35 @@ void PDUPeerEndpointFD::Shutdown()
 {
     recordShutdownCall();
 
+    if (mMode == PDU_PEER_ENDPOINT_EVENT_LOOP)
+    {
+        mPDUSendQueue->SetNotEmptyCallback(PDUQueueNotEmptyCallback());
+
+        // handlers that start after this see no timer to set, so
+        // they can not arm the ids once they are closed and reused.
+        // RemoveTimer() then waits out any still running
+        int sendTimer;
+        int connectTimer;
+        {
+            AutoUnlockMutex handlerLock(mEventHandlerMutex);
+            sendTimer = mSendTimer;
+            mSendTimer = -1;
+        }
+        {
+            AutoUnlockMutex connectLock(mConnectMutex);
+            connectTimer = mConnectTimer;
+            mConnectTimer = -1;
+        }
+        mEPollMonitor->RemoveTimer(sendTimer);
+        mEPollMonitor->RemoveTimer(connectTimer);
+
+        closeFileDescriptor();
+
+        AutoUnlockMutex lock(mEventQueueMutex);
+        mEventQueue.clear();
+        return;
+    }
+
     mSendThread->Shutdown();
     mRecvThread->Shutdown();
     mCallbackThread->Shutdown();
@@ -102,6 +171,15 @@ void PDUPeerEndpointFD::Shutdown()
 }
 
 void PDUPeerEndpointFD::SetFD(int fd)
+{
+    FTRACE2("%d", fd);
+    setFD(fd, NULL, 0, false);
+}
+
+void PDUPeerEndpointFD::setFD(int fd,
+                              const void* preamble,
+                              size_t preambleLength,
+                              bool connecting)
 {
     FTRACE2("%d", fd);
 
@@ -118,8 +196,33 @@ void PDUPeerEndpointFD::SetFD(int fd)
         {
             setSocketNonBlocking(mFD);
 
+            if (preambleLength > 0)
+            {
+                AutoUnlockMutex sendlock(mSendStateMutex);
+                mSendBatch.AddPreamble(preamble, preambleLength);
+                mSendDeadline.ExpiresInSeconds(mSendTimeoutSeconds);
+            }
+
             epoll_event ev = { 0, { 0 } };
             ev.events = EPOLLIN | EPOLLRDHUP;
+            if (mMode == PDU_PEER_ENDPOINT_EVENT_LOOP)
+            {
+                // one loop thread at a time per endpoint. the
+                // handler re-arms when it is done
+                ev.events |= EPOLLONESHOT;
+                if (mPDUSendQueue->GetQueueSize() > 0
+                    || preambleLength > 0)
+                {
+                    ev.events |= EPOLLOUT;
+                }
+
+                // the fd turns writable once the connect is done
+                mConnecting = connecting;
+                if (connecting)
+                {
+                    ev.events = EPOLLOUT | EPOLLONESHOT;
+                }
+            }
             ev.data.fd = mFD;
             mEPollMonitor->AddFD(
                 fd,
@@ -131,9 +234,10 @@ void PDUPeerEndpointFD::SetFD(int fd)
                     _1));
 
             mCalculator.Reset(mRecvBuffer.get(), mRecvBufferSize);
+            mRecvBlocked = false;
             mRecvWorkAvailable = true;
             mRecvWorkAvailableCondition.Signal();
-            sendConnect = true;
+            sendConnect = !mConnecting;
         }
         else
         {
@@ -191,14 +295,20 @@ void PDUPeerEndpointFD::closeFileDescriptor()
             mEPollMonitor->RemoveFD(mFD);
             mFD.Close();
             mFD = -1;
-            doCallback = true;
+            // nothing was told about a connect that never finished
+            doCallback = !mConnecting;
+            mConnecting = false;
         }
         mPDUSendQueue->Clear();
 
+        mRecvBlocked = false;
         mRecvWorkAvailable = true;
         mRecvWorkAvailableCondition.Signal();
         setSendState(SendStateDisconnected);
         mPDUSendQueue->TriggerWaiters();
+
+        AutoUnlockMutex sendlock(mSendStateMutex);
+        mSendBatch.Clear();
     }
 
     if (doCallback)
@@ -221,10 +331,9 @@ void PDUPeerEndpointFD::sendThreadRun()
     Forte::Timespec remainingTime;
 
     const int flags(MSG_NOSIGNAL);
-    int len(0);
-    int cursor(0);
-    int sendBufferSize(0);
-    boost::shared_array<char> sendBuffer;
+    ssize_t len(0);
+    PDUSendBatch sendBatch(SEND_COALESCE_MAX_PDUS, SEND_COALESCE_MAX_BYTES);
+    size_t sentPDUs(0);
     int rc;
 
     struct pollfd pollFDs[1];
@@ -237,6 +346,9 @@ void PDUPeerEndpointFD::sendThreadRun()
         {
         case SendStateDisconnected:
             //hlog(HLOG_DEBUG, "mSendState SendStateDisconnected");
+            // anything still in the batch went down with the old
+            // connection
+            sendBatch.Clear();
             waitForConnected();
             {
                 AutoUnlockMutex fdlock(mFDMutex);
@@ -252,18 +364,16 @@ void PDUPeerEndpointFD::sendThreadRun()
             mPDUSendQueue->WaitForNextPDU(pdu);
             if (pdu)
             {
+                sendBatch.Add(pdu);
                 setSendState(SendStatePDUReady);
             }
             break;
 
         case SendStatePDUReady:
             //hlog(HLOG_DEBUG, "state SendStatePDUReady");
-            sendBuffer = PDU::CreateSendBuffer(*pdu);
-            sendBufferSize =
-                sizeof(PDUHeader)
-                + pdu->GetHeader().payloadSize
-                + pdu->GetHeader().optionalDataSize;
-            cursor = 0;
+            // pick up whatever else is already queued so small PDUs
+            // share a sendmsg call
+            fillSendBatch(sendBatch);
             setSendState(SendStateBufferAvailable);
             sendDeadline.ExpiresInSeconds(mSendTimeoutSeconds);
             break;
@@ -273,25 +383,24 @@ void PDUPeerEndpointFD::sendThreadRun()
             //hlog(HLOG_DEBUG, "state SendStateBufferAvailable");
             {
                 AutoUnlockMutex fdlock(mFDMutex);
-                while ((len = send(mFD,
-                                   sendBuffer.get()+cursor,
-                                   sendBufferSize-cursor,
-                                   flags)) == -1
-                       && errno == EINTR) {}
+                len = sendBatch.Send(mFD, flags);
             }
 
             if (len > 0)
             {
-                cursor += len;
                 mByteSendCount += len;
 
-                if (cursor == sendBufferSize)
+                sentPDUs = sendBatch.RecordSent(len);
+                if (sentPDUs > 0)
                 {
-                    // pdu is done sending
-                    sendBufferSize = cursor = 0;
-                    sendBuffer.reset();
-                    mPDUSendCount++;
+                    mPDUSendCount += sentPDUs;
+                    // each PDU gets the full timeout
+                    sendDeadline.ExpiresInSeconds(mSendTimeoutSeconds);
+                }
 
+                if (sendBatch.Empty())
+                {
+                    // batch is done sending
                     setSendState(SendStateConnected);
                 }
             }
@@ -312,11 +421,9 @@ void PDUPeerEndpointFD::sendThreadRun()
                 else
                 {
                     //timeout
-                    ++mPDUSendErrors;
-                    PDUPeerEventPtr event(new PDUPeerEvent());
-                    event->mEventType = PDUPeerSendErrorEvent;
-                    event->mPDU = pdu;
-                    triggerCallback(event);
+                    std::list<PDUPtr> unsent;
+                    sendBatch.TakeUnsent(unsent);
+                    sendBatchFailed(unsent);
 
                     setSendState(SendStateDisconnected);
                     closeFileDescriptor();
@@ -333,12 +440,10 @@ void PDUPeerEndpointFD::sendThreadRun()
                 {
                     hlog(HLOG_INFO, "lost connection to peer: %d", errno);
                 }
-                ++mPDUSendErrors;
 
-                PDUPeerEventPtr event(new PDUPeerEvent());
-                event->mEventType = PDUPeerSendErrorEvent;
-                event->mPDU = pdu;
-                triggerCallback(event);
+                std::list<PDUPtr> unsent;
+                sendBatch.TakeUnsent(unsent);
+                sendBatchFailed(unsent);
 
                 setSendState(SendStateDisconnected);
                 closeFileDescriptor();
@@ -349,6 +454,36 @@ void PDUPeerEndpointFD::sendThreadRun()
     }
 }
 
+void PDUPeerEndpointFD::fillSendBatch(PDUSendBatch& sendBatch)
+{
+    std::vector<PDUPtr> pdus;
+    while (sendBatch.CanCoalesce()
+           && mPDUSendQueue->DequeueBatch(
+               pdus,
+               sendBatch.GetMaxPDUs() - sendBatch.GetPDUCount()) > 0)
+    {
+        foreach (const PDUPtr& pdu, pdus)
+        {
+            sendBatch.Add(pdu);
+        }
+        pdus.clear();
+    }
+}
+
+void PDUPeerEndpointFD::sendBatchFailed(const std::list<PDUPtr>& unsent)
+{
+    // every PDU taken from the queue that did not make it out gets a
+    // send error, as a lone PDU would have
+    foreach (const PDUPtr& pdu, unsent)
+    {
+        ++mPDUSendErrors;
+        PDUPeerEventPtr event(new PDUPeerEvent());
+        event->mEventType = PDUPeerSendErrorEvent;
+        event->mPDU = pdu;
+        triggerCallback(event);
+    }
+}
+
 void PDUPeerEndpointFD::setSendState(const SendState& state)
 {
     AutoUnlockMutex lock(mSendStateMutex);
@@ -397,7 +532,12 @@ void PDUPeerEndpointFD::recvUntilBlockOrComplete()
     while (len > 0)
     {
         AutoUnlockMutex recvlock(mRecvBufferMutex);
-        bufferEnsureHasSpace();
+        if (!bufferEnsureHasSpace())
+        {
+            // event loop mode with a full buffer. RecvPDU re-arms
+            // EPOLLIN once the consumer makes room
+            return;
+        }
 
         {
             AutoUnlockMutex fdlock(mFDMutex);
@@ -458,13 +598,19 @@ void PDUPeerEndpointFD::recvUntilBlockOrComplete()
     }
 }
 
-void PDUPeerEndpointFD::bufferEnsureHasSpace()
+bool PDUPeerEndpointFD::bufferEnsureHasSpace()
 {
     try
     {
         while (mCalculator.Full()
                && mRecvBufferSize + mRecvBufferStepSize > mRecvBufferMaxSize)
         {
+            if (mMode == PDU_PEER_ENDPOINT_EVENT_LOOP)
+            {
+                // never block a loop thread
+                mRecvBlocked = true;
+                return false;
+            }
             mRecvWorkAvailableCondition.Wait();
         }
 
@@ -482,15 +628,11 @@ void PDUPeerEndpointFD::bufferEnsureHasSpace()
             // new buffer
             boost::shared_array<char> tmp(new char[newsize]);
             memset (tmp.get(), 0, newsize);
-            size_t readLengthOldBuffer = mCalculator.GetReadLength();
-            // copy old data
-            mCalculator.ObjectCopy(tmp.get(), readLengthOldBuffer);
+            // carry over the unread data. pinned data stays where its
+            // views point, in the old buffer they keep alive
+            mCalculator.Move(tmp.get(), newsize);
             mRecvBuffer.swap(tmp);
-            // update calculator with new addres and size
             mRecvBufferSize = newsize;
-            mCalculator.Reset(mRecvBuffer.get(), mRecvBufferSize);
-            // update with proper offest. TODO: make this part of Reset
-            mCalculator.RecordWrite(readLengthOldBuffer);
 
             hlogstream(HLOG_DEBUG,
                        "PDU recv buf new size " << mRecvBufferSize
@@ -504,6 +646,8 @@ void PDUPeerEndpointFD::bufferEnsureHasSpace()
     {
         throw EPeerBufferOutOfMemory();
     }
+
+    return true;
 }
 
 bool PDUPeerEndpointFD::lockedIsPDUReady() const
@@ -543,25 +687,31 @@ void PDUPeerEndpointFD::updateRecvQueueSizeStats()
     }
     else
     {
+        // walk the headers by offset rather than reading from a copy
+        // of the calculator, which would also copy its pins
         size_t readyCount(0);
-        size_t readLength(0);
-        RingBufferCalculator calc(mCalculator);
+        size_t offset(0);
+        const size_t readLength(mCalculator.GetReadLength());
 
-        while ((readLength = calc.GetReadLength()) >= sizeof(PDUHeader))
+        while (readLength - offset >= sizeof(PDUHeader))
         {
-            if (calc.ObjectWillWrap(sizeof(PDUHeader)))
+            size_t pduSize(0);
+            if (mCalculator.ObjectWillWrap(offset, sizeof(PDUHeader)))
             {
-                calc.ObjectCopy(
-                    reinterpret_cast<char*>(&mTmpPDUHeader), sizeof(PDUHeader));
-                calc.RecordRead(std::min(PDU::Size(mTmpPDUHeader), readLength));
+                mCalculator.ObjectCopy(
+                    offset,
+                    reinterpret_cast<char*>(&mTmpPDUHeader),
+                    sizeof(PDUHeader));
+                pduSize = PDU::Size(mTmpPDUHeader);
             }
             else
             {
                 const PDUHeader* pduHeader =
                     reinterpret_cast<const PDUHeader*>(
-                        calc.GetReadLocation());
-                calc.RecordRead(std::min(PDU::Size(*pduHeader), readLength));
+                        mCalculator.GetReadLocation(offset));
+                pduSize = PDU::Size(*pduHeader);
             }
+            offset += std::min(pduSize, readLength - offset);
             ++readyCount;
         }
 
@@ -571,6 +721,8 @@ void PDUPeerEndpointFD::updateRecvQueueSizeStats()
 
 bool PDUPeerEndpointFD::RecvPDU(PDU &out)
 {
+    bool rearm(false);
+
     {
         AutoUnlockMutex recvlock(mRecvBufferMutex);
 
@@ -637,8 +789,146 @@ bool PDUPeerEndpointFD::RecvPDU(PDU &out)
 
         mRecvWorkAvailable = true;
         mRecvWorkAvailableCondition.Signal();
+
+        if (mRecvBlocked)
+        {
+            mRecvBlocked = false;
+            rearm = true;
+        }
+    }
+
+    if (rearm)
+    {
+        eventLoopRearm();
+    }
+
+    validatePDUHeader(out.GetHeader());
+    return true;
+}
+
+struct PDUPeerEndpointFD::RecvBufferPin
+{
+    RecvBufferPin(const boost::shared_ptr<PDUPeerEndpointFD>& endpoint,
+                  const boost::shared_array<char>& buffer,
+                  uint64_t pinID)
+        : mEndpoint(endpoint),
+          mBuffer(buffer),
+          mPinID(pinID)
+        {}
+
+    ~RecvBufferPin() {
+        // the endpoint may already be gone. mBuffer keeps the bytes
+        // valid either way
+        boost::shared_ptr<PDUPeerEndpointFD> endpoint(mEndpoint.lock());
+        if (endpoint)
+        {
+            endpoint->releaseRecvPin(mPinID);
+        }
+    }
+
+    boost::weak_ptr<PDUPeerEndpointFD> mEndpoint;
+    boost::shared_array<char> mBuffer;
+    uint64_t mPinID;
+};
+
+bool PDUPeerEndpointFD::RecvPDUView(PDUView &out)
+{
+    bool copy(false);
+    // dropping a view this endpoint handed out takes mRecvBufferMutex,
+    // so out is only replaced once it is released
+    PDUView view;
+
+    {
+        AutoUnlockMutex recvlock(mRecvBufferMutex);
+
+        if (!lockedIsPDUReady())
+            return false;
+
+        if (mCalculator.ObjectWillWrap(sizeof(PDUHeader)))
+        {
+            copy = true;
+        }
+        else
+        {
+            const char* pduStart = mCalculator.GetReadLocation();
+            const PDUHeader *pduHeader =
+                reinterpret_cast<const PDUHeader*>(pduStart);
+            const size_t pduSize = PDU::Size(*pduHeader);
+            const char* payload = pduStart + sizeof(PDUHeader);
+            const char* optionalData = payload + pduHeader->payloadSize;
+
+            if (mCalculator.ObjectWillWrap(pduSize)
+                || ((pduHeader->optionalDataAttributes
+                     & PDU_OPTIONAL_DATA_ATTRIBUTE_MEMALIGN_512)
+                    && reinterpret_cast<uintptr_t>(optionalData) % 512 != 0))
+            {
+                copy = true;
+            }
+            else
+            {
+                boost::shared_ptr<void> pin(
+                    new RecvBufferPin(
+                        boost::static_pointer_cast<PDUPeerEndpointFD>(
+                            shared_from_this()),
+                        mRecvBuffer,
+                        mCalculator.PinRead(pduSize)));
+
+                view = PDUView(
+                    *pduHeader,
+                    (pduHeader->payloadSize > 0 ? payload : NULL),
+                    (pduHeader->optionalDataSize > 0 ? optionalData : NULL),
+                    pin);
+
+                ++mPDURecvCount;
+                updateRecvQueueSizeStats();
+            }
+        }
+    }
+
+    if (copy)
+    {
+        boost::shared_ptr<PDU> pdu(new PDU());
+        if (!RecvPDU(*pdu))
+            return false;
+        out = PDUView(pdu);
+        return true;
+    }
+
+    out = view;
+    validatePDUHeader(out.GetHeader());
+    return true;
+}
+
+void PDUPeerEndpointFD::releaseRecvPin(uint64_t pinID)
+{
+    bool rearm(false);
+
+    {
+        AutoUnlockMutex recvlock(mRecvBufferMutex);
+
+        // false when the buffer was reset or replaced since the pin
+        // was taken, nothing to give back
+        if (!mCalculator.ReleasePin(pinID))
+            return;
+
+        mRecvWorkAvailable = true;
+        mRecvWorkAvailableCondition.Signal();
+
+        if (mRecvBlocked)
+        {
+            mRecvBlocked = false;
+            rearm = true;
+        }
     }
 
+    if (rearm)
+    {
+        eventLoopRearm();
+    }
+}
+
+void PDUPeerEndpointFD::validatePDUHeader(const PDUHeader& pduHeader)
+{
     // \TODO figure out how to do proper opcode validation.
     //
     // one way to do it would be to ask for a valid opcode range, then
@@ -648,7 +938,7 @@ bool PDUPeerEndpointFD::RecvPDU(PDU &out)
 
     // Validate PDU
     unsigned int basePDUVersion =
-        PDU::GetBasePDUVersion(out.GetHeader().version);
+        PDU::GetBasePDUVersion(pduHeader.version);
     if (basePDUVersion != PDU::PDU_VERSION)
     {
         if (hlog_ratelimit(60))
@@ -659,8 +949,6 @@ bool PDUPeerEndpointFD::RecvPDU(PDU &out)
         closeFileDescriptor();
         throw EPDUVersionInvalid();
     }
-
-    return true;
 }
 
 void PDUPeerEndpointFD::copyPayloadToPDU(PDU& out, const PDUHeader& pduHeader)
@@ -696,9 +984,61 @@ void PDUPeerEndpointFD::copyOptionalDataToPDU(
 void PDUPeerEndpointFD::triggerCallback(
     const boost::shared_ptr<PDUPeerEvent>& event)
 {
-    AutoUnlockMutex lock(mEventQueueMutex);
-    mEventQueue.push_back(event);
-    mEventAvailableCondition.Signal();
+    {
+        AutoUnlockMutex lock(mEventQueueMutex);
+        mEventQueue.push_back(event);
+
+        if (mMode == PDU_PEER_ENDPOINT_THREADED)
+        {
+            mEventAvailableCondition.Signal();
+            return;
+        }
+
+        if (mEventDispatchActive)
+        {
+            return;
+        }
+        mEventDispatchActive = true;
+    }
+
+    // this may be called with the recv buffer locked, so deliver
+    // from a loop thread instead of here. only one dispatch is
+    // outstanding at a time, which keeps events in order
+    mEPollMonitor->Post(
+        boost::bind(
+            &PDUPeerEndpointFD::dispatchPendingEvents,
+            boost::static_pointer_cast<PDUPeerEndpointFD>(
+                shared_from_this())));
+}
+
+void PDUPeerEndpointFD::dispatchPendingEvents()
+{
+    boost::shared_ptr<Forte::PDUPeerEvent> event;
+
+    while (true)
+    {
+        {
+            AutoUnlockMutex lock(mEventQueueMutex);
+            if (mEventQueue.empty())
+            {
+                mEventDispatchActive = false;
+                return;
+            }
+
+            event = mEventQueue.front();
+            mEventQueue.pop_front();
+        }
+
+        try
+        {
+            deliverEvent(event);
+        }
+        catch (std::exception& e)
+        {
+            hlogstream(HLOG_ERR, "exception in callback: " << e.what());
+        }
+        event.reset();
+    }
 }
 
 void PDUPeerEndpointFD::callbackThreadRun()
@@ -746,6 +1086,12 @@ bool PDUPeerEndpointFD::IsPDUReady() const
 void PDUPeerEndpointFD::HandleEPollEvent(
     const epoll_event& e)
 {
+    if (mMode == PDU_PEER_ENDPOINT_EVENT_LOOP)
+    {
+        handleEventLoopEvent(e);
+        return;
+    }
+
     if (e.events & EPOLLIN)
     {
         AutoUnlockMutex lock(mRecvBufferMutex);
@@ -760,3 +1106,333 @@ void PDUPeerEndpointFD::HandleEPollEvent(
         closeFileDescriptor();
     }
 }
+
+void PDUPeerEndpointFD::handleEventLoopEvent(const epoll_event& e)
+{
+    {
+        AutoUnlockMutex handlerLock(mEventHandlerMutex);
+
+        try
+        {
+            if (!eventLoopFinishConnect(e))
+            {
+                // still connecting, or the connect failed and the fd
+                // is closed
+            }
+            else if (e.events & EPOLLERR
+                     || e.events & EPOLLHUP)
+            {
+                closeFileDescriptor();
+                return;
+            }
+            else
+            {
+                // a peer shutdown shows up as EPOLLRDHUP. read
+                // whatever is left, recv will return 0 and close the
+                // fd
+                if (e.events & EPOLLIN
+                    || e.events & EPOLLRDHUP)
+                {
+                    recvUntilBlockOrComplete();
+                }
+
+                // the first send after a connect also sends its
+                // preamble
+                if (e.events & EPOLLOUT)
+                {
+                    eventLoopSendUntilBlockOrEmpty();
+                }
+            }
+        }
+        catch (std::exception& ex)
+        {
+            hlogstream(HLOG_WARN,
+                       "closing connection due to exception: " << ex.what());
+
+            closeFileDescriptor();
+        }
+    }
+
+    eventLoopRearm();
+}
+
+void PDUPeerEndpointFD::eventLoopSendUntilBlockOrEmpty()
+{
+    const int flags(MSG_NOSIGNAL);
+    size_t sentPDUs(0);
+    ssize_t len(0);
+
+    while (true)
+    {
+        {
+            // the fd lock is held across the send so a concurrent
+            // close cannot clear the batch out from under sendmsg
+            AutoUnlockMutex fdlock(mFDMutex);
+            AutoUnlockMutex sendlock(mSendStateMutex);
+
+            if (mSendBatch.Empty())
+            {
+                if (sentPDUs >= static_cast<size_t>(EVENT_LOOP_MAX_SEND_PDUS))
+                {
+                    // let other endpoints on this loop thread have a
+                    // turn. EPOLLOUT is re-armed as the queue is not
+                    // empty
+                    return;
+                }
+
+                fillSendBatch(mSendBatch);
+
+                if (mSendBatch.Empty())
+                {
+                    return;
+                }
+                mSendDeadline.ExpiresInSeconds(mSendTimeoutSeconds);
+            }
+
+            if (mFD == -1)
+            {
+                // the connection was closed since we were woken
+                return;
+            }
+
+            len = mSendBatch.Send(mFD, flags);
+
+            if (len > 0)
+            {
+                mByteSendCount += len;
+
+                size_t completed = mSendBatch.RecordSent(len);
+                if (completed > 0)
+                {
+                    mPDUSendCount += completed;
+                    sentPDUs += completed;
+                    // each PDU gets the full timeout
+                    mSendDeadline.ExpiresInSeconds(mSendTimeoutSeconds);
+                }
+                continue;
+            }
+        }
+
+        if (len == -1 && errno == EAGAIN)
+        {
+            // EPOLLOUT stays armed while a batch is pending, and the
+            // send timer catches a peer that stops reading altogether
+            bool expired(false);
+            bool arm(false);
+            Timespec remaining;
+            {
+                AutoUnlockMutex sendlock(mSendStateMutex);
+                expired = (!mSendBatch.Empty()
+                           && mSendDeadline.Expired());
+                if (!expired && !mSendTimerArmed)
+                {
+                    mSendDeadline.GetRemaining(remaining);
+                    mSendTimerArmed = arm = true;
+                }
+            }
+
+            if (expired)
+            {
+                eventLoopSendError();
+            }
+            else if (arm)
+            {
+                mEPollMonitor->SetTimer(mSendTimer, remaining);
+            }
+            return;
+        }
+        else
+        {
+            if (errno != ECONNRESET
+                && errno != EBADF)
+            {
+                hlog(HLOG_ERR, "unexpected err from send: %d", errno);
+            }
+            else
+            {
+                hlog(HLOG_INFO, "lost connection to peer: %d", errno);
+            }
+
+            eventLoopSendError();
+            return;
+        }
+    }
+}
+
+void PDUPeerEndpointFD::eventLoopSendError()
+{
+    std::list<PDUPtr> unsent;
+    {
+        AutoUnlockMutex sendlock(mSendStateMutex);
+        mSendBatch.TakeUnsent(unsent);
+    }
+    sendBatchFailed(unsent);
+
+    closeFileDescriptor();
+}
+
+void PDUPeerEndpointFD::eventLoopPDUQueued()
+{
+    if (!IsConnected())
+    {
+        mEPollMonitor->Post(
+            boost::bind(
+                &PDUPeerEndpointFD::eventLoopConnect,
+                boost::static_pointer_cast<PDUPeerEndpointFD>(
+                    shared_from_this())));
+        return;
+    }
+
+    eventLoopRearm();
+}
+
+void PDUPeerEndpointFD::eventLoopConnect()
+{
+    AutoUnlockMutex connectLock(mConnectMutex);
+
+    // shut down, a connect posted before that is dropped. a connect
+    // in progress is finished by the loop thread that gets its fd
+    if (mConnectTimer == -1 || GetFD() != -1)
+    {
+        return;
+    }
+
+    // same once a second retry rate as waitForConnected. a request
+    // that comes too soon is held for the connect timer rather than
+    // dropped
+    if (!mConnectRetryDeadline.Expired())
+    {
+        Timespec remaining;
+        mConnectRetryDeadline.GetRemaining(remaining);
+        mEPollMonitor->SetTimer(mConnectTimer, remaining);
+        return;
+    }
+    mConnectRetryDeadline.ExpiresInSeconds(1);
+
+    try
+    {
+        connect();
+    }
+    catch (ECouldNotConnect& e)
+    {
+        mPDUSendQueue->Clear();
+    }
+}
+
+bool PDUPeerEndpointFD::eventLoopFinishConnect(const epoll_event& e)
+{
+    int error(0);
+    {
+        AutoUnlockMutex fdlock(mFDMutex);
+        if (!mConnecting)
+        {
+            return true;
+        }
+
+        // only EPOLLOUT is armed until then, errors are always
+        // reported
+        if (!(e.events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+        {
+            return false;
+        }
+
+        error = getSocketError(mFD);
+        if (error == 0)
+        {
+            mConnecting = false;
+        }
+    }
+
+    if (error != 0)
+    {
+        hlog(HLOG_DEBUG2, "could not connect: %s",
+             SystemCallUtil::GetErrorDescription(error).c_str());
+        // drops the queued PDUs, as a failed blocking connect did
+        closeFileDescriptor();
+        return false;
+    }
+
+    PDUPeerEventPtr event(new PDUPeerEvent());
+    event->mEventType = PDUPeerConnectedEvent;
+    triggerCallback(event);
+    return true;
+}
+
+void PDUPeerEndpointFD::eventLoopSendTimeout()
+{
+    AutoUnlockMutex handlerLock(mEventHandlerMutex);
+
+    bool expired(false);
+    Timespec remaining;
+    {
+        AutoUnlockMutex sendlock(mSendStateMutex);
+        mSendTimerArmed = false;
+        if (mSendBatch.Empty())
+        {
+            return;
+        }
+
+        // sends since the timer was armed push the deadline back
+        expired = mSendDeadline.Expired();
+        if (!expired)
+        {
+            mSendDeadline.GetRemaining(remaining);
+            mSendTimerArmed = true;
+        }
+    }
+
+    if (expired)
+    {
+        hlog(HLOG_INFO, "send timed out after %d seconds",
+             mSendTimeoutSeconds);
+        eventLoopSendError();
+    }
+    else
+    {
+        mEPollMonitor->SetTimer(mSendTimer, remaining);
+    }
+}
+
+void PDUPeerEndpointFD::eventLoopRearm()
+{
+    // serializes re-arming between the loop thread finishing a
+    // wakeup and threads enqueueing PDUs, so the last ModFD always
+    // reflects the current queue state
+    AutoUnlockMutex lock(mEventLoopMutex);
+
+    bool recvBlocked(false);
+    {
+        AutoUnlockMutex recvlock(mRecvBufferMutex);
+        recvBlocked = mRecvBlocked;
+    }
+
+    bool sendPending(false);
+    {
+        AutoUnlockMutex sendlock(mSendStateMutex);
+        sendPending = !mSendBatch.Empty();
+    }
+    sendPending = sendPending || mPDUSendQueue->GetQueueSize() > 0;
+
+    AutoUnlockMutex fdlock(mFDMutex);
+    if (mFD == -1)
+    {
+        return;
+    }
+
+    epoll_event ev = { 0, { 0 } };
+    ev.events = EPOLLRDHUP | EPOLLONESHOT;
+    if (!recvBlocked)
+    {
+        ev.events |= EPOLLIN;
+    }
+    if (sendPending)
+    {
+        ev.events |= EPOLLOUT;
+    }
+    if (mConnecting)
+    {
+        ev.events = EPOLLOUT | EPOLLONESHOT;
+    }
+    ev.data.fd = mFD;
+    mEPollMonitor->ModFD(mFD, ev);
+}
@@ -12,12 +12,20 @@
 #include "EPollMonitor.h"
 #include "FunctionThread.h"
 #include "RingBufferCalculator.h"
+#include "PDUSendBatch.h"
 
 namespace Forte
 {
     static const int RECV_BUFFER_SIZE = 65536;
     static const int DEFAULT_MAX_BUFFER_SIZE = 1048576;
     static const int DEFAULT_SEND_TIMEOUT = 20*1000;
+    // in event loop mode, the most PDUs one endpoint will send per
+    // EPOLLOUT wakeup before giving the loop thread to other endpoints
+    static const int EVENT_LOOP_MAX_SEND_PDUS = 64;
+    // queued PDUs are gathered into a single sendmsg call until the
+    // batch holds this many PDUs or bytes
+    static const int SEND_COALESCE_MAX_PDUS = 32;
+    static const int SEND_COALESCE_MAX_BYTES = 65536;
 
     class PDUPeerEndpointFD : public PDUPeerEndpoint
     {
@@ -28,7 +36,8 @@ namespace Forte
             unsigned int sendTimeoutSeconds = DEFAULT_SEND_TIMEOUT,
             unsigned int recvBufferSize = RECV_BUFFER_SIZE,
             unsigned int recvBufferMaxSize = DEFAULT_MAX_BUFFER_SIZE,
-            unsigned int recvBufferStepSize = RECV_BUFFER_SIZE);
+            unsigned int recvBufferStepSize = RECV_BUFFER_SIZE,
+            PDUPeerEndpointMode mode = PDU_PEER_ENDPOINT_THREADED);
         virtual ~PDUPeerEndpointFD() {}
 
         virtual void Start();
@@ -46,9 +55,15 @@ namespace Forte
         bool IsPDUReady() const;
         bool RecvPDU(Forte::PDU &out);
 
+        // the view points into the receive buffer and pins that
+        // region until the view is dropped. PDUs that wrap the end of
+        // the buffer, or whose optional data needs alignment the
+        // buffer cannot give, are copied once instead
+        bool RecvPDUView(Forte::PDUView &out);
+
         virtual bool IsConnected() const {
             AutoUnlockMutex fdlock(mFDMutex);
-            return (mFD != -1);
+            return (mFD != -1 && !mConnecting);
         }
 
         virtual bool OwnsFD(int fd) const {
@@ -56,6 +71,21 @@ namespace Forte
             return (mFD != -1 && mFD == fd);
         }
 
+        PDUPeerEndpointMode GetMode() const {
+            return mMode;
+        }
+
+    protected:
+        // SetFD(), and in event loop mode also: preamble is copied and
+        // sent ahead of any queued PDU, and when connecting, fd is a
+        // non blocking connect still in progress. the connected event
+        // is sent once it completes, a connect that fails closes the
+        // fd without a disconnected event
+        void setFD(int fd,
+                   const void* preamble,
+                   size_t preambleLength,
+                   bool connecting);
+
     private:
         void waitForConnected();
         void closeFileDescriptor();
@@ -68,20 +98,38 @@ namespace Forte
         };
         void sendThreadRun();
         void setSendState(const SendState& state);
+        void fillSendBatch(PDUSendBatch& sendBatch);
+        void sendBatchFailed(const std::list<PDUPtr>& unsent);
 
         void recvThreadRun();
         void recvUntilBlockOrComplete();
-        void bufferEnsureHasSpace();
+        bool bufferEnsureHasSpace();
         bool lockedIsPDUReady() const;
         void triggerCallback(const boost::shared_ptr<PDUPeerEvent>& event);
         void updateRecvQueueSizeStats();
 
         void callbackThreadRun();
 
+        // event loop mode
+        void handleEventLoopEvent(const epoll_event& e);
+        void eventLoopSendUntilBlockOrEmpty();
+        void eventLoopSendError();
+        void eventLoopPDUQueued();
+        void eventLoopConnect();
+        bool eventLoopFinishConnect(const epoll_event& e);
+        void eventLoopSendTimeout();
+        void eventLoopRearm();
+        void dispatchPendingEvents();
+
+        void validatePDUHeader(const PDUHeader& pduHeader);
+        void releaseRecvPin(uint64_t pinID);
+        struct RecvBufferPin;
+
         void copyPayloadToPDU(PDU& out, const PDUHeader& pduHeader);
         void copyOptionalDataToPDU(PDU& out, const PDUHeader& pduHeader);
 
     private:
+        const PDUPeerEndpointMode mMode;
         boost::shared_ptr<PDUQueue> mPDUSendQueue;
         boost::shared_ptr<EPollMonitor> mEPollMonitor;
         boost::shared_ptr<Forte::FunctionThread> mRecvThread;
@@ -94,6 +142,8 @@ namespace Forte
         mutable Forte::Mutex mConnectMutex;
         mutable Forte::Mutex mFDMutex;
         AutoFD mFD;
+        // event loop mode, mFD is a connect in progress
+        bool mConnecting;
 
         const int mSendTimeoutSeconds;
         mutable Forte::Mutex mSendStateMutex;
@@ -115,6 +165,25 @@ namespace Forte
         mutable Forte::Mutex mEventQueueMutex;
         Forte::ThreadCondition mEventAvailableCondition;
         std::list<boost::shared_ptr<PDUPeerEvent> > mEventQueue;
+
+        // event loop mode. the fd is registered EPOLLONESHOT, so only
+        // one loop thread handles it at a time. mEventHandlerMutex
+        // covers the window where the fd is replaced by a reconnect,
+        // mEventLoopMutex orders re-arming between the loop thread
+        // and enqueuers
+        mutable Forte::Mutex mEventHandlerMutex;
+        mutable Forte::Mutex mEventLoopMutex;
+        bool mRecvBlocked;
+        bool mEventDispatchActive;
+        DeadlineClock mConnectRetryDeadline;
+        PDUSendBatch mSendBatch;
+        DeadlineClock mSendDeadline;
+
+        // EPollMonitor timers for the send deadline and the connect
+        // retry, so neither needs a thread sleeping on it
+        int mSendTimer;
+        int mConnectTimer;
+        bool mSendTimerArmed;
     };
 };
 #endif
@@ -18,7 +18,12 @@ boost::shared_ptr<PDUPeerEndpoint> PDUPeerEndpointFactoryImpl::Create(
     boost::shared_ptr<PDUPeerEndpointFD> p(
         new PDUPeerEndpointFD(
             pduSendQueue,
-            mEPollMonitor.lock()));
+            mEPollMonitor.lock(),
+            DEFAULT_SEND_TIMEOUT,
+            RECV_BUFFER_SIZE,
+            DEFAULT_MAX_BUFFER_SIZE,
+            RECV_BUFFER_SIZE,
+            mEndpointMode));
     p->SetFD(fd);
     return p;
 }
@@ -45,7 +50,12 @@ boost::shared_ptr<PDUPeerEndpoint> PDUPeerEndpointFactoryImpl::Create(
         return boost::shared_ptr<PDUPeerEndpoint>(
             new PDUPeerEndpointFD(
                 pduSendQueue,
-                mEPollMonitor.lock()));
+                mEPollMonitor.lock(),
+                DEFAULT_SEND_TIMEOUT,
+                RECV_BUFFER_SIZE,
+                DEFAULT_MAX_BUFFER_SIZE,
+                RECV_BUFFER_SIZE,
+                mEndpointMode));
     }
     else if (localListenSocketAddress == connectToSocketAddress)
     {
@@ -69,7 +79,8 @@ boost::shared_ptr<PDUPeerEndpoint> PDUPeerEndpointFactoryImpl::Create(
                 pduSendQueue,
                 outgoingPeerSetID,
                 connectToSocketAddress,
-                mEPollMonitor.lock()));
+                mEPollMonitor.lock(),
+                mEndpointMode));
 
         return p;
     }
@@ -20,8 +20,10 @@ namespace Forte
     {
     public:
         PDUPeerEndpointFactoryImpl(
-            const boost::shared_ptr<EPollMonitor>& epollMonitor)
-            : mEPollMonitor(epollMonitor)
+            const boost::shared_ptr<EPollMonitor>& epollMonitor,
+            PDUPeerEndpointMode endpointMode = PDU_PEER_ENDPOINT_THREADED)
+            : mEPollMonitor(epollMonitor),
+              mEndpointMode(endpointMode)
             {
             }
         virtual ~PDUPeerEndpointFactoryImpl() {}
@@ -54,6 +56,7 @@ namespace Forte
 
     protected:
         boost::weak_ptr<EPollMonitor> mEPollMonitor;
+        const PDUPeerEndpointMode mEndpointMode;
     };
 };
 #endif
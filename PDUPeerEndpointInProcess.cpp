@@ -121,6 +121,22 @@ bool PDUPeerEndpointInProcess::RecvPDU(PDU &out)
     return false;
 }
 
+bool PDUPeerEndpointInProcess::RecvPDUView(PDUView &out)
+{
+    AutoUnlockMutex lock(mMutex);
+    if (!mPDUBuffer.empty())
+    {
+        out = PDUView(mPDUBuffer.front());
+
+        mPDUBuffer.pop_front();
+        ++mPDURecvCount;
+        mPDURecvReadyCountAvg = mPDURecvReadyCount = mPDUBuffer.size();
+        return true;
+    }
+
+    return false;
+}
+
 void PDUPeerEndpointInProcess::connect()
 {
     bool needToDoCallback;
@@ -26,6 +26,10 @@ namespace Forte
         virtual bool IsPDUReady() const;
         virtual bool RecvPDU(Forte::PDU &out);
 
+        // the view shares the queued PDU, which a broadcast shares
+        // with every other peer, instead of copying its payload
+        virtual bool RecvPDUView(Forte::PDUView &out);
+
         // epoll does not apply here
         virtual void HandleEPollEvent(const struct epoll_event& e) {}
 
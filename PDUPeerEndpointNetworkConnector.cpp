@@ -13,8 +13,15 @@ Forte::PDUPeerEndpointNetworkConnector::PDUPeerEndpointNetworkConnector(
     const boost::shared_ptr<PDUQueue>& pduSendQueue,
     uint64_t myPeerSetID,
     const SocketAddress& connectToAddress,
-    const boost::shared_ptr<EPollMonitor>& epollMonitor)
-    : PDUPeerEndpointFD(pduSendQueue, epollMonitor),
+    const boost::shared_ptr<EPollMonitor>& epollMonitor,
+    PDUPeerEndpointMode mode)
+    : PDUPeerEndpointFD(pduSendQueue,
+                        epollMonitor,
+                        DEFAULT_SEND_TIMEOUT,
+                        RECV_BUFFER_SIZE,
+                        DEFAULT_MAX_BUFFER_SIZE,
+                        RECV_BUFFER_SIZE,
+                        mode),
       mPeerSetID(myPeerSetID),
       mConnectToAddress(connectToAddress)
 {
@@ -30,6 +37,26 @@ void Forte::PDUPeerEndpointNetworkConnector::connect()
         Forte::setTCPNoDelay(sock);
         Forte::setTCPQuickAck(sock);
 
+        if (GetMode() == PDU_PEER_ENDPOINT_EVENT_LOOP)
+        {
+            // this runs on a loop thread, which must not wait for the
+            // connect or the send. the identifier goes out ahead of
+            // the queued PDUs once the connect is done
+            setSocketNonBlocking(sock);
+            setTCPKeepAlive(sock);
+            setTCPUserTimeout(sock);
+            const bool connected(
+                startConnectToAddress(sock, mConnectToAddress));
+            setFD(sock.Release(), &mPeerSetID, sizeof(mPeerSetID),
+                  !connected);
+
+            hlog(HLOG_DEBUG, "%s connection to %s:%d",
+                 (connected ? "established" : "started"),
+                 mConnectToAddress.first.c_str(),
+                 mConnectToAddress.second);
+            return;
+        }
+
         connectToAddress(sock, mConnectToAddress);
 
         // send identifier
@@ -21,7 +21,8 @@ namespace Forte
             const boost::shared_ptr<PDUQueue>& pduSendQueue,
             uint64_t ownerPeerSetID,
             const SocketAddress& connectToAddress,
-            const boost::shared_ptr<EPollMonitor>& epollMonitor);
+            const boost::shared_ptr<EPollMonitor>& epollMonitor,
+            PDUPeerEndpointMode mode = PDU_PEER_ENDPOINT_THREADED);
 
         virtual ~PDUPeerEndpointNetworkConnector() {}
 
@@ -111,3 +111,8 @@ bool Forte::PDUPeerImpl::RecvPDU(Forte::PDU &out)
 {
     return mEndpoint->RecvPDU(out);
 }
+
+bool Forte::PDUPeerImpl::RecvPDUView(Forte::PDUView &out)
+{
+    return mEndpoint->RecvPDUView(out);
+}
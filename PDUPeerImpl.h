@@ -78,6 +78,7 @@ namespace Forte
          */
         //TODO: boost::shared_ptr<Forte::PDU> RecvPDU() throws (ENoPDUReady, etc);
         bool RecvPDU(Forte::PDU &out);
+        bool RecvPDUView(Forte::PDUView &out);
 
         virtual void HandleEPollEvent(const struct epoll_event& e) {
             mEndpoint->HandleEPollEvent(e);
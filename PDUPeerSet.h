@@ -150,6 +150,11 @@ namespace Forte
          * will be called according to the the async send rules of the
          * PDUPeer.
          *
+         * The PDU is not copied per peer. every peer queues the same
+         * PDU and sends straight from its buffers, keeping only its
+         * own send position, and in process peers can receive it with
+         * RecvPDUView. the PDU must not be modified once broadcast.
+         *
          * @param pdu
          */
         virtual void BroadcastAsync(const PDUPtr& pdu) = 0;
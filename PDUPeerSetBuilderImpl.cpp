@@ -19,14 +19,23 @@ Forte::PDUPeerSetBuilderImpl::PDUPeerSetBuilderImpl(
     bool createInProcessPDUPeer,
     long pduPeerSendTimeout,
     unsigned short queueSize,
-    PDUPeerQueueType queueType)
+    PDUPeerQueueType queueType,
+    PDUPeerEndpointMode endpointMode,
+    int eventLoopThreads)
     : mListenAddress(listenAddress),
       mID(SocketAddressToID(listenAddress)),
       mPDUPeerSendTimeout(pduPeerSendTimeout),
       mQueueSize(queueSize),
       mQueueType(queueType),
-      mEPollMonitor(new EPollMonitor("peerset-epl")),
-      mPDUPeerEndpointFactory(new PDUPeerEndpointFactoryImpl(mEPollMonitor))
+      mEPollMonitor(
+          new EPollMonitor(
+              "peerset-epl",
+              500,
+              (endpointMode == PDU_PEER_ENDPOINT_EVENT_LOOP
+               ? eventLoopThreads
+               : 1))),
+      mPDUPeerEndpointFactory(
+          new PDUPeerEndpointFactoryImpl(mEPollMonitor, endpointMode))
 {
     FTRACE2("%llu", static_cast<unsigned long long>(mID));
 
@@ -48,7 +57,8 @@ Forte::PDUPeerSetBuilderImpl::PDUPeerSetBuilderImpl(
     }
 
     // begin setup PeerSet
-    mPDUPeerSet.reset(new PDUPeerSetImpl(pduPeers, mEPollMonitor));
+    mPDUPeerSet.reset(
+        new PDUPeerSetImpl(pduPeers, mEPollMonitor, mPDUPeerEndpointFactory));
     mPDUPeerSet->SetEventCallback(eventCallback);
     includeStatsFromChild(mPDUPeerSet, "PeerSet");
     // end setup PeerSet
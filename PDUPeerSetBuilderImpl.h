@@ -38,7 +38,9 @@ namespace Forte
             bool createInProcessPDUPeer = true,
             long pduPeerSendTimeout = 30,
             unsigned short queueSize = 1024,
-            PDUPeerQueueType queueType = PDU_PEER_QUEUE_THROW);
+            PDUPeerQueueType queueType = PDU_PEER_QUEUE_THROW,
+            PDUPeerEndpointMode endpointMode = PDU_PEER_ENDPOINT_THREADED,
+            int eventLoopThreads = 4);
 
         // old school style
         // Callers using this setup should also call
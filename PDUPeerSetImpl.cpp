@@ -18,8 +18,10 @@ using namespace Forte;
 
 Forte::PDUPeerSetImpl::PDUPeerSetImpl(
     const std::vector<PDUPeerPtr>& peers,
-    const boost::shared_ptr<EPollMonitor>& epollMonitor)
-    : mEPollMonitor(epollMonitor)
+    const boost::shared_ptr<EPollMonitor>& epollMonitor,
+    const boost::shared_ptr<PDUPeerEndpointFactory>& endpointFactory)
+    : mEPollMonitor(epollMonitor),
+      mEndpointFactory(endpointFactory)
 {
     FTRACE2("created with %zu peers", peers.size());
 
@@ -77,12 +79,15 @@ boost::shared_ptr<PDUPeer> Forte::PDUPeerSetImpl::PeerCreate(int fd)
         throw EObjectNotRunning();
     }
 
-    //TODO: pass in a factory
-    PDUPeerEndpointFactoryImpl f(mEPollMonitor);
+    boost::shared_ptr<PDUPeerEndpointFactory> f(mEndpointFactory);
+    if (!f)
+    {
+        f.reset(new PDUPeerEndpointFactoryImpl(mEPollMonitor));
+    }
     boost::shared_ptr<PDUQueue> q(new PDUQueue);
     // it should be ok to use the fd as the id. any network id of a
     // pdu peer will be a very large number well above 1024
-    boost::shared_ptr<PDUPeer> peer(new PDUPeerImpl(fd, f.Create(q, fd), q));
+    boost::shared_ptr<PDUPeer> peer(new PDUPeerImpl(fd, f->Create(q, fd), q));
     peer->SetEventCallback(mEventCallback);
 
     {
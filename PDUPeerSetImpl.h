@@ -13,6 +13,7 @@
 #include "Locals.h"
 #include "FunctionThread.h"
 #include "EPollMonitor.h"
+#include "PDUPeerEndpointFactory.h"
 #include <boost/shared_ptr.hpp>
 
 namespace Forte
@@ -49,7 +50,10 @@ namespace Forte
     {
     public:
         PDUPeerSetImpl(const std::vector<PDUPeerPtr>& peers,
-                       const boost::shared_ptr<EPollMonitor>& epollMonitor);
+                       const boost::shared_ptr<EPollMonitor>& epollMonitor,
+                       const boost::shared_ptr<PDUPeerEndpointFactory>&
+                       endpointFactory =
+                       boost::shared_ptr<PDUPeerEndpointFactory>());
         virtual ~PDUPeerSetImpl();
 
         /**
@@ -123,6 +127,7 @@ namespace Forte
 
     protected:
         boost::shared_ptr<EPollMonitor> mEPollMonitor;
+        boost::shared_ptr<PDUPeerEndpointFactory> mEndpointFactory;
 
         mutable Forte::Mutex mPDUPeerLock;
         std::map<uint64_t, PDUPeerPtr> mPDUPeers;
@@ -48,6 +48,14 @@ namespace Forte
         PDU_PEER_QUEUE_DROP
     } PDUPeerQueueType;
 
+    typedef enum {
+        // each fd endpoint runs its own send, recv and callback threads
+        PDU_PEER_ENDPOINT_THREADED,
+        // send, recv and callback delivery are driven by the
+        // EPollMonitor loop threads shared by all endpoints
+        PDU_PEER_ENDPOINT_EVENT_LOOP
+    } PDUPeerEndpointMode;
+
     class PDUPeerEvent
     {
     public:
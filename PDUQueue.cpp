@@ -20,16 +20,31 @@ PDUQueue::PDUQueue(
       mPDUQueueNotFullCondition(mPDUQueueMutex),
       mQueueMaxSize(queueSize),
       mQueueType(queueType),
+      mHasNotEmptyCallback(0),
+      mCapacity(queueSize > 0 ? queueSize : 1),
+      mSlots(new Slot[mCapacity]),
+      mEnqueuePos(0),
+      mDequeuePos(0),
+      mCount(0),
+      mConsumerWaiting(0),
+      mProducersWaiting(0),
       mTotalQueued(0),
       mQueueSize(0),
       mDropCount(0),
-      mAvgQueueSize()
+      mAvgQueueSize(),
+      mSendLatency()
 {
     FTRACE;
+    for (size_t i = 0; i < mCapacity; ++i)
+    {
+        mSlots[i].sequence = i;
+    }
+
     registerStatVariable<0>("totalQueued", &PDUQueue::mTotalQueued);
     registerStatVariable<1>("queueSize", &PDUQueue::mQueueSize);
     registerStatVariable<2>("averageQueueSize", &PDUQueue::mAvgQueueSize);
     registerStatVariable<3>("dropCount", &PDUQueue::mDropCount);
+    registerStatVariable<4>("sendLatency", &PDUQueue::mSendLatency);
 }
 
 PDUQueue::~PDUQueue()
@@ -39,87 +54,245 @@ PDUQueue::~PDUQueue()
 
 void PDUQueue::EnqueuePDU(const PDUPtr& pdu)
 {
-    // Potential race condition between semaphore & mutex locks
-    AutoUnlockMutex lock(mPDUQueueMutex);
+    size_t countBefore(0);
+    if (!reserve(countBefore))
+    {
+        return;
+    }
 
-    if (mPDUQueue.size()+1 > mQueueMaxSize)
+    // the reservation guarantees the slot at our position is free or
+    // about to be released by the consumer
+    size_t pos = mEnqueuePos;
+    Slot* slot;
+    while (true)
     {
-        if (mQueueType == PDU_PEER_QUEUE_BLOCK)
+        slot = &mSlots[pos % mCapacity];
+        size_t sequence = slot->sequence;
+        __sync_synchronize();
+
+        if (sequence == pos
+            && __sync_bool_compare_and_swap(&mEnqueuePos, pos, pos + 1))
         {
-            while (mPDUQueue.size()+1 > mQueueMaxSize &&
-                   !Thread::IsForteThreadAndShuttingDown())
-            {
-                mPDUQueueNotFullCondition.Wait();
-            }
-            if (Thread::IsForteThreadAndShuttingDown())
-                boost::throw_exception(EThreadShutdown());
+            break;
         }
-        else if (mQueueType == PDU_PEER_QUEUE_DROP)
-        {
-            ++mDropCount;
-            if (hlog_ratelimit(60))
-                hlogstream(HLOG_WARN, "Dropping PDUs " << mDropCount << " total");
+        pos = mEnqueuePos;
+    }
 
-            return;
+    slot->holder.enqueuedTime = mClock.GetTime();
+    slot->holder.pdu = pdu;
+    __sync_synchronize();
+    slot->sequence = pos + 1;
+
+    ++mTotalQueued;
+    mQueueSize = countBefore + 1;
+
+    // the barrier above orders publishing the PDU before these reads,
+    // so a consumer that went to sleep either saw the PDU or is seen
+    // here
+    __sync_synchronize();
+    if (mConsumerWaiting)
+    {
+        AutoUnlockMutex lock(mPDUQueueMutex);
+        mPDUQueueNotEmptyCondition.Signal();
+    }
+
+    if (countBefore == 0 && mHasNotEmptyCallback)
+    {
+        PDUQueueNotEmptyCallback notEmptyCallback;
+        {
+            AutoUnlockMutex lock(mPDUQueueMutex);
+            notEmptyCallback = mNotEmptyCallback;
         }
-        else // CALLBACK or THROW
+
+        if (notEmptyCallback)
         {
-            hlog_and_throw(HLOG_WARN, EPDUQueueFull(mQueueMaxSize));
+            notEmptyCallback();
         }
     }
+}
 
-    mTotalQueued++;
-    mAvgQueueSize = mQueueSize = mPDUQueue.size();
+bool PDUQueue::reserve(size_t& countBefore)
+{
+    while (true)
+    {
+        size_t count = mCount;
+        if (count + 1 > mQueueMaxSize)
+        {
+            if (mQueueType == PDU_PEER_QUEUE_BLOCK)
+            {
+                waitForNotFull();
+                continue;
+            }
+            else if (mQueueType == PDU_PEER_QUEUE_DROP)
+            {
+                int64_t dropCount = __sync_add_and_fetch(&mDropCount, 1);
+                if (hlog_ratelimit(60))
+                    hlogstream(HLOG_WARN, "Dropping PDUs " << dropCount << " total");
 
-    PDUHolderPtr pduHolder(new PDUHolder);
-    pduHolder->enqueuedTime = mClock.GetTime();
-    pduHolder->pdu = pdu;
-    mPDUQueue.push_back(pduHolder);
+                return false;
+            }
+            else // CALLBACK or THROW
+            {
+                hlog_and_throw(HLOG_WARN, EPDUQueueFull(mQueueMaxSize));
+            }
+        }
 
-    mPDUQueueNotEmptyCondition.Signal();
+        if (__sync_bool_compare_and_swap(&mCount, count, count + 1))
+        {
+            countBefore = count;
+            return true;
+        }
+    }
 }
 
-void PDUQueue::GetNextPDU(boost::shared_ptr<PDU>& pdu)
+void PDUQueue::waitForNotFull()
 {
     AutoUnlockMutex lock(mPDUQueueMutex);
-    if (!mPDUQueue.empty())
+    __sync_add_and_fetch(&mProducersWaiting, 1);
+    while (mCount + 1 > mQueueMaxSize &&
+           !Thread::IsForteThreadAndShuttingDown())
     {
-        pdu = mPDUQueue.front()->pdu;
-        mPDUQueue.pop_front();
-        mAvgQueueSize = mQueueSize = mPDUQueue.size();
-        mPDUQueueNotFullCondition.Signal();
+        mPDUQueueNotFullCondition.Wait();
     }
+    __sync_sub_and_fetch(&mProducersWaiting, 1);
+
+    if (Thread::IsForteThreadAndShuttingDown())
+        boost::throw_exception(EThreadShutdown());
 }
 
-void PDUQueue::WaitForNextPDU(PDUPtr& pdu)
+bool PDUQueue::headReady() const
 {
-    AutoUnlockMutex lock(mPDUQueueMutex);
-    while (!Thread::IsForteThreadAndShuttingDown()
-           && mPDUQueue.empty())
+    size_t pos = mDequeuePos;
+    size_t sequence = mSlots[pos % mCapacity].sequence;
+    __sync_synchronize();
+    return sequence == pos + 1;
+}
+
+bool PDUQueue::lockedDequeue(PDUPtr& pdu, const Timespec* now)
+{
+    size_t pos = mDequeuePos;
+    Slot& slot(mSlots[pos % mCapacity]);
+    size_t sequence = slot.sequence;
+    __sync_synchronize();
+
+    if (sequence != pos + 1)
+    {
+        // empty, or the producer holding this position has not
+        // finished writing it
+        return false;
+    }
+
+    if (now != NULL)
     {
-        mPDUQueueNotEmptyCondition.Wait();
+        mSendLatency.Record(*now - slot.holder.enqueuedTime);
     }
 
-    if (!mPDUQueue.empty())
+    pdu.reset();
+    pdu.swap(slot.holder.pdu);
+    __sync_synchronize();
+    slot.sequence = pos + mCapacity;
+    mDequeuePos = pos + 1;
+    return true;
+}
+
+void PDUQueue::consumed(size_t dequeued)
+{
+    if (dequeued == 0)
     {
-        pdu = mPDUQueue.front()->pdu;
-        mPDUQueue.pop_front();
-        mAvgQueueSize = mQueueSize = mPDUQueue.size();
-        mPDUQueueNotFullCondition.Signal();
+        return;
     }
-    else if (Thread::IsForteThreadAndShuttingDown())
+
+    size_t count = __sync_sub_and_fetch(&mCount, dequeued);
+    mAvgQueueSize = mQueueSize = count;
+
+    if (mProducersWaiting)
     {
+        AutoUnlockMutex lock(mPDUQueueMutex);
         mPDUQueueNotFullCondition.Broadcast();
-        mPDUQueueNotEmptyCondition.Broadcast();
     }
 }
 
-bool PDUQueue::isPDUExpired(PDUHolderPtr pduHolder)
+void PDUQueue::GetNextPDU(boost::shared_ptr<PDU>& pdu)
+{
+    AutoUnlockMutex consumerlock(mConsumerMutex);
+    const Timespec now(mClock.GetTime());
+    if (lockedDequeue(pdu, &now))
+    {
+        consumed(1);
+    }
+}
+
+size_t PDUQueue::DequeueBatch(std::vector<PDUPtr>& out, size_t maxPDUs)
+{
+    AutoUnlockMutex consumerlock(mConsumerMutex);
+    size_t dequeued(0);
+    PDUPtr pdu;
+    // one clock read serves the whole batch
+    const Timespec now(mClock.GetTime());
+    while (dequeued < maxPDUs && lockedDequeue(pdu, &now))
+    {
+        out.push_back(pdu);
+        ++dequeued;
+    }
+    consumed(dequeued);
+    return dequeued;
+}
+
+void PDUQueue::WaitForNextPDU(PDUPtr& pdu)
+{
+    while (true)
+    {
+        {
+            AutoUnlockMutex consumerlock(mConsumerMutex);
+            const Timespec now(mClock.GetTime());
+            if (lockedDequeue(pdu, &now))
+            {
+                consumed(1);
+                return;
+            }
+        }
+
+        AutoUnlockMutex lock(mPDUQueueMutex);
+        if (Thread::IsForteThreadAndShuttingDown())
+        {
+            mPDUQueueNotFullCondition.Broadcast();
+            mPDUQueueNotEmptyCondition.Broadcast();
+            return;
+        }
+
+        // producers check mConsumerWaiting after publishing, so
+        // announce before looking at the ring one last time
+        __sync_add_and_fetch(&mConsumerWaiting, 1);
+        if (!headReady())
+        {
+            mPDUQueueNotEmptyCondition.Wait();
+        }
+        __sync_sub_and_fetch(&mConsumerWaiting, 1);
+    }
+}
+
+void PDUQueue::Clear()
+{
+    AutoUnlockMutex consumerlock(mConsumerMutex);
+    size_t dequeued(0);
+    PDUPtr pdu;
+    while (lockedDequeue(pdu))
+    {
+        ++dequeued;
+    }
+    consumed(dequeued);
+
+    mQueueSize = 0;
+    mAvgQueueSize = 0;
+    mDropCount = 0;
+}
+
+bool PDUQueue::isPDUExpired(const PDUHolder& pduHolder)
 {
     Timespec timeout(mPDUSendTimeout, 0);
     Timespec now;
     now = mClock.GetTime();
-    if (pduHolder->enqueuedTime + timeout < now)
+    if (pduHolder.enqueuedTime + timeout < now)
     {
         return true;
     }
@@ -134,28 +307,27 @@ void PDUQueue::failExpiredPDUs()
     //std::vector<PDUPeerEventPtr> events;
 
     {
-        AutoUnlockMutex lock(mPDUQueueMutex);
-        PDUHolderPtr pduHolder;
+        AutoUnlockMutex consumerlock(mConsumerMutex);
+        size_t dequeued(0);
+        PDUPtr pdu;
         // newest items will be at the back. loop until we find one that
         // is not expired or the list is emtpy
-        while (!mPDUQueue.empty() && isPDUExpired(mPDUQueue.front()))
+        while (headReady()
+               && isPDUExpired(mSlots[mDequeuePos % mCapacity].holder)
+               && lockedDequeue(pdu))
         {
-            pduHolder = mPDUQueue.front();
-            if (isPDUExpired(pduHolder))
-            {
-                //TODO: nothing uses this right now
-                /*if (mEventCallback)
-                {
-                    PDUPeerEventPtr event(new PDUPeerEvent());
-                    event->mPeer = GetPtr();
-                    event->mEventType = PDUPeerSendErrorEvent;
-                    event->mPDU = pduHolder->pdu;
-                    events.push_back(event);
-                    }*/
-                mPDUQueue.pop_front();
-                mPDUQueueNotFullCondition.Signal();
-            }
+            //TODO: nothing uses this right now
+            /*if (mEventCallback)
+              {
+              PDUPeerEventPtr event(new PDUPeerEvent());
+              event->mPeer = GetPtr();
+              event->mEventType = PDUPeerSendErrorEvent;
+              event->mPDU = pduHolder->pdu;
+              events.push_back(event);
+              }*/
+            ++dequeued;
         }
+        consumed(dequeued);
     }
 
     // can't call this with mutex
@@ -6,6 +6,12 @@
  * PDUQueue functions as a blocking queue or a ring buffer,
  * depending. probably could be abstracted further or more properly.
  *
+ * The queue is a bounded multi-producer/single-consumer ring. Any
+ * number of threads may enqueue without taking a lock. Dequeueing is
+ * serialized by a consumer mutex, which in practice is only ever
+ * contended by Clear(). The queue mutex and conditions are only used
+ * to put a blocked producer or an idle consumer to sleep, and the
+ * other side only takes the mutex when it knows someone is sleeping.
  */
 
 #include "Exception.h"
@@ -19,6 +25,10 @@
 #include <boost/bind.hpp>
 #include "ThreadedObject.h"
 #include "CumulativeMovingAverage.h"
+#include "LatencyHistogram.h"
+#include "PerCPUCounter.h"
+#include <boost/scoped_array.hpp>
+#include <vector>
 
 EXCEPTION_CLASS(EPDUQueue);
 
@@ -45,16 +55,19 @@ namespace Forte
         Timespec enqueuedTime;
         PDUPtr pdu;
     };
-    typedef boost::shared_ptr<PDUHolder> PDUHolderPtr;
+
+    // called after a PDU is added to an empty queue
+    typedef boost::function<void()> PDUQueueNotEmptyCallback;
 
     class PDUQueue :
         public Object,
         public EnableStats<PDUQueue,
                            Locals<PDUQueue,
-                                  int64_t,
+                                  PerCPUCounter,
                                   int64_t,
                                   CumulativeMovingAverage,
-                                  int64_t
+                                  int64_t,
+                                  LatencyHistogram
                                   > >
     {
     public:
@@ -70,6 +83,14 @@ namespace Forte
 
         // will block until ready
         virtual void WaitForNextPDU(boost::shared_ptr<PDU>& pdu);
+
+        /**
+         * Append up to maxPDUs queued PDUs to out without blocking.
+         *
+         * @return the number of PDUs dequeued
+         */
+        virtual size_t DequeueBatch(std::vector<PDUPtr>& out, size_t maxPDUs);
+
         //threads will wait on WaitForPDUToSend until there is
         //one. they need to able to be canceled for thread shutdown
         virtual void TriggerWaiters() {
@@ -79,26 +100,44 @@ namespace Forte
 
         //virtual void DequeuePDU(PDUPtr& pdu);
         virtual unsigned int GetQueueSize() const {
-            AutoUnlockMutex lock(mPDUQueueMutex);
-            return mPDUQueue.size();
+            return mCount;
         }
         PDUPeerQueueType GetQueueType() const {
             return mQueueType;
         }
 
-        void Clear() {
+        /**
+         * Event driven consumers that do not wait on the queue use
+         * this to learn that there is work. the callback is made
+         * without the queue lock held, from the thread that enqueued
+         * the PDU.
+         */
+        void SetNotEmptyCallback(const PDUQueueNotEmptyCallback& f) {
             AutoUnlockMutex lock(mPDUQueueMutex);
-            mPDUQueue.clear();
-            mPDUQueueNotFullCondition.Broadcast();
-            mQueueSize = 0;
-            mAvgQueueSize = 0;
-            mDropCount = 0;
+            mNotEmptyCallback = f;
+            mHasNotEmptyCallback = (f ? 1 : 0);
         }
 
+        void Clear();
+
     protected:
-        void lockedEnqueuePDU(const boost::shared_ptr<PDUHolder>& pdu);
-        bool isPDUExpired(PDUHolderPtr pduHolder);
-        void failAllPDUs();
+        // one ring entry. sequence tells producers and the consumer
+        // whose turn it is: it equals the enqueue position when the
+        // slot is free, and that position + 1 once the PDU is in it
+        struct Slot {
+            Slot() : sequence(0) {}
+            volatile size_t sequence;
+            PDUHolder holder;
+        };
+
+        // reserve room for one PDU. false if the PDU was dropped
+        bool reserve(size_t& countBefore);
+        void waitForNotFull();
+        // when now is given, the time the PDU waited is recorded
+        bool lockedDequeue(PDUPtr& pdu, const Timespec* now = NULL);
+        bool headReady() const;
+        void consumed(size_t dequeued);
+        bool isPDUExpired(const PDUHolder& pduHolder);
         void failExpiredPDUs();
 
     protected:
@@ -106,16 +145,31 @@ namespace Forte
         mutable Forte::Mutex mPDUQueueMutex;
         Forte::ThreadCondition mPDUQueueNotEmptyCondition;
         Forte::ThreadCondition mPDUQueueNotFullCondition;
-        std::deque<PDUHolderPtr> mPDUQueue;
         MonotonicClock mClock;
         // limit size of queue
         unsigned short mQueueMaxSize;
         PDUPeerQueueType mQueueType;
-
-        int64_t mTotalQueued;
+        PDUQueueNotEmptyCallback mNotEmptyCallback;
+        volatile int mHasNotEmptyCallback;
+
+        const size_t mCapacity;
+        boost::scoped_array<Slot> mSlots;
+        // producers claim positions with a CAS on mEnqueuePos. the
+        // consumer owns mDequeuePos under mConsumerMutex. mCount is
+        // reserved + queued PDUs and is what enforces mQueueMaxSize
+        volatile size_t mEnqueuePos;
+        volatile size_t mDequeuePos;
+        volatile size_t mCount;
+        mutable Forte::Mutex mConsumerMutex;
+        volatile int mConsumerWaiting;
+        volatile int mProducersWaiting;
+
+        PerCPUCounter mTotalQueued;
         int64_t mQueueSize;
         int64_t mDropCount;
         CumulativeMovingAverage mAvgQueueSize;
+        // microseconds from EnqueuePDU until the sender dequeued it
+        LatencyHistogram mSendLatency;
     };
 };
 #endif
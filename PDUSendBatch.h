@@ -0,0 +1,248 @@
+// #SCQAD TAG: forte.pdupeer
+#ifndef __Forte_PDUSendBatch_h_
+#define __Forte_PDUSendBatch_h_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <errno.h>
+#include <deque>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include "PDU.h"
+#include "PDUPeerTypes.h"
+
+// PDUSendBatch is tightly coupled with PDUPeerEndpointFD. It is not
+// thread safe.
+//
+// it describes one or more queued PDUs as an iovec, header, payload
+// and optional data pointing at the PDU's own buffers, so the PDUs
+// can go out with sendmsg() without being flattened into a send
+// buffer first. several small PDUs can be coalesced into one batch to
+// cut the number of syscalls. a short write leaves the iovec pointing
+// at the first unsent byte, and RecordSent reports how many PDUs were
+// completed so the caller can keep its counters.
+//
+// PDUs are held by the batch until they have been sent in full or the
+// batch is cleared. a batch can also start with a few raw bytes that
+// are not a PDU, such as the id a connecting peer sends first.
+
+EXCEPTION_CLASS(EPDUSendBatch);
+
+namespace Forte
+{
+    class PDUSendBatch
+    {
+    public:
+        PDUSendBatch(size_t maxPDUs, size_t maxBytes)
+            : mMaxPDUs(std::max(maxPDUs, static_cast<size_t>(1))),
+              mMaxBytes(maxBytes),
+              mIOVecCursor(0),
+              mBatchBytes(0),
+              mBytesRemaining(0)
+            {}
+
+        bool Empty() const {
+            return mIOVecs.empty();
+        }
+
+        size_t GetPDUCount() const {
+            return mEntries.size();
+        }
+
+        size_t GetBytesRemaining() const {
+            return mBytesRemaining;
+        }
+
+        // whether more PDUs should be added before sending. the
+        // first PDU always fits, after that PDUs are added until
+        // either limit is reached. the limits are advice to the
+        // caller, Add only refuses a batch that has started sending
+        bool CanCoalesce() const {
+            return mEntries.empty()
+                || (!inFlight()
+                    && mEntries.size() < mMaxPDUs
+                    && mBatchBytes < mMaxBytes);
+        }
+
+        size_t GetMaxPDUs() const {
+            return mMaxPDUs;
+        }
+
+        // copy len bytes to be sent ahead of the PDUs. only an empty
+        // batch takes them, and they do not count as a PDU
+        void AddPreamble(const void* data, size_t len) {
+            if (!Empty())
+            {
+                throw EPDUSendBatch("Preamble added to a batch that is not empty");
+            }
+            if (len == 0)
+            {
+                return;
+            }
+
+            const char* bytes(static_cast<const char*>(data));
+            mPreamble.assign(bytes, bytes + len);
+            addIOVec(&mPreamble[0], len);
+            mBatchBytes += len;
+            mBytesRemaining += len;
+        }
+
+        void Add(const PDUPtr& pdu) {
+            if (inFlight())
+            {
+                throw EPDUSendBatch("Attempt to add to a batch in flight");
+            }
+
+            mEntries.push_back(Entry(pdu));
+            Entry& entry(mEntries.back());
+            const PDUHeader& header(entry.mHeader);
+
+            addIOVec(&entry.mHeader, sizeof(PDUHeader));
+
+            if (header.payloadSize > 0)
+            {
+                addIOVec(pdu->GetPayload<char>(), header.payloadSize);
+            }
+
+            if (header.optionalDataSize > 0)
+            {
+                if (!pdu->GetOptionalData())
+                {
+                    throw EPDUUnexpectedNullBuffer();
+                }
+                addIOVec(pdu->GetOptionalData()->mData,
+                         header.optionalDataSize);
+            }
+
+            entry.mIOVecEnd = mIOVecs.size();
+            mBatchBytes += PDU::Size(header);
+            mBytesRemaining += PDU::Size(header);
+        }
+
+        // one sendmsg() of everything not yet sent. returns what
+        // sendmsg() returned, retrying on EINTR
+        ssize_t Send(int fd, int flags) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &mIOVecs[mIOVecCursor];
+            msg.msg_iovlen =
+                std::min(mIOVecs.size() - mIOVecCursor,
+                         static_cast<size_t>(IOV_MAX));
+
+            ssize_t len;
+            while ((len = sendmsg(fd, &msg, flags)) == -1
+                   && errno == EINTR) {}
+            return len;
+        }
+
+        // advance past len sent bytes. returns the number of PDUs
+        // that are now completely sent and have been released
+        size_t RecordSent(size_t len) {
+            if (len > mBytesRemaining)
+            {
+                throw EPDUSendBatch("Recorded more bytes than were queued");
+            }
+            mBytesRemaining -= len;
+
+            while (len > 0)
+            {
+                struct iovec& iov(mIOVecs[mIOVecCursor]);
+                if (len >= iov.iov_len)
+                {
+                    len -= iov.iov_len;
+                    ++mIOVecCursor;
+                }
+                else
+                {
+                    iov.iov_base = static_cast<char*>(iov.iov_base) + len;
+                    iov.iov_len -= len;
+                    len = 0;
+                }
+            }
+
+            size_t completed(0);
+            while (!mEntries.empty()
+                   && mEntries.front().mIOVecEnd <= mIOVecCursor)
+            {
+                mEntries.pop_front();
+                ++completed;
+            }
+
+            if (mBytesRemaining == 0)
+            {
+                Clear();
+            }
+            return completed;
+        }
+
+        // the PDU currently being sent, or null
+        PDUPtr Front() const {
+            if (mEntries.empty())
+                return PDUPtr();
+            return mEntries.front().mPDU;
+        }
+
+        // hand back every PDU that was not completely sent, in send
+        // order, and empty the batch
+        void TakeUnsent(std::list<PDUPtr>& out) {
+            for (std::deque<Entry>::const_iterator i = mEntries.begin();
+                 i != mEntries.end();
+                 ++i)
+            {
+                out.push_back(i->mPDU);
+            }
+            Clear();
+        }
+
+        void Clear() {
+            mPreamble.clear();
+            mEntries.clear();
+            mIOVecs.clear();
+            mIOVecCursor = 0;
+            mBatchBytes = 0;
+            mBytesRemaining = 0;
+        }
+
+    private:
+        struct Entry
+        {
+            explicit Entry(const PDUPtr& pdu)
+                : mPDU(pdu),
+                  mHeader(pdu->GetHeader()),
+                  mIOVecEnd(0)
+                {}
+
+            PDUPtr mPDU;
+            // sent from here. deque keeps it in place as entries are
+            // added and removed
+            PDUHeader mHeader;
+            size_t mIOVecEnd;
+        };
+
+        bool inFlight() const {
+            return mBytesRemaining != mBatchBytes;
+        }
+
+        void addIOVec(const void* base, size_t len) {
+            struct iovec iov;
+            iov.iov_base = const_cast<void*>(base);
+            iov.iov_len = len;
+            mIOVecs.push_back(iov);
+        }
+
+    private:
+        const size_t mMaxPDUs;
+        const size_t mMaxBytes;
+        std::vector<char> mPreamble;
+        std::deque<Entry> mEntries;
+        std::vector<struct iovec> mIOVecs;
+        size_t mIOVecCursor;
+        size_t mBatchBytes;
+        size_t mBytesRemaining;
+    };
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __Forte_PerCPUCounter_h__
+#define __Forte_PerCPUCounter_h__
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+
+namespace Forte
+{
+    /**
+     * PerCPUCounter is a counter that many threads can add to at once,
+     * for use as a stat variable with EnableStats. Adds go to a shard
+     * chosen by the CPU the thread is running on, and each shard has a
+     * cache line to itself, so threads on different CPUs do not contend
+     * or false-share. Reading it sums the shards.
+     *
+     * There are as many shards as CPUs, rounded up to a power of two
+     * and at most MAX_SHARDS; past that, CPUs share shards. Adds are
+     * atomic, since a thread can move to another CPU mid-add.
+     */
+    class PerCPUCounter
+    {
+    public:
+        static const unsigned int CACHE_LINE_SIZE = 64;
+        static const unsigned int MAX_SHARDS = 16;
+
+        PerCPUCounter(int64_t initial = 0)
+            : mShardMask(shardCount() - 1),
+              mShards(NULL) {
+            void *shards = NULL;
+            if (posix_memalign(&shards, CACHE_LINE_SIZE,
+                               sizeof(Shard) * (mShardMask + 1)) != 0)
+                throw std::bad_alloc();
+            mShards = static_cast<Shard *>(shards);
+            for (unsigned int i = 0; i <= mShardMask; ++i)
+                mShards[i].mValue = 0;
+            mShards[0].mValue = initial;
+        }
+
+        ~PerCPUCounter() {
+            free(mShards);
+        }
+
+        void Add(int64_t delta) {
+            __sync_fetch_and_add(&shard().mValue, delta);
+        }
+
+        PerCPUCounter& operator+=(int64_t delta) { Add(delta); return *this; }
+        PerCPUCounter& operator-=(int64_t delta) { Add(-delta); return *this; }
+        PerCPUCounter& operator++() { Add(1); return *this; }
+        PerCPUCounter& operator--() { Add(-1); return *this; }
+        void operator++(int) { Add(1); }
+        void operator--(int) { Add(-1); }
+
+        /**
+         * Get() sums the shards. Adds made while it runs may or may
+         * not be counted.
+         */
+        int64_t Get() const {
+            int64_t total = 0;
+            for (unsigned int i = 0; i <= mShardMask; ++i)
+                total += mShards[i].mValue;
+            return total;
+        }
+
+        operator int64_t () const { return Get(); }
+
+        /**
+         * Sets the counter, as for a reset. Adds made at the same time
+         * may be lost.
+         */
+        PerCPUCounter& operator=(int64_t value) {
+            for (unsigned int i = 1; i <= mShardMask; ++i)
+                mShards[i].mValue = 0;
+            mShards[0].mValue = value;
+            return *this;
+        }
+
+    private:
+        PerCPUCounter(const PerCPUCounter &other) = delete;
+        PerCPUCounter& operator=(const PerCPUCounter &rhs) = delete;
+
+        struct Shard
+        {
+            volatile int64_t mValue;
+            char mPad[CACHE_LINE_SIZE - sizeof(int64_t)];
+        };
+
+        static unsigned int shardCount() {
+            static const unsigned int count = computeShardCount();
+            return count;
+        }
+
+        static unsigned int computeShardCount() {
+            long cpus = sysconf(_SC_NPROCESSORS_CONF);
+            unsigned int count = 1;
+            while (count < MAX_SHARDS && count < cpus)
+                count <<= 1;
+            return count;
+        }
+
+        Shard& shard() const {
+            int cpu = sched_getcpu();
+            if (cpu < 0)
+                cpu = 0;
+            return mShards[cpu & mShardMask];
+        }
+
+        const unsigned int mShardMask;
+        Shard *mShards;
+    };
+};
+
+#endif
@@ -71,6 +71,10 @@ namespace Forte
                         "The process was killed");
     EXCEPTION_SUBCLASS2(EProcessFuture, EProcessFutureTerminatedDueToUnknownReason,
                         "The process terminated due to unknown reason");
+    EXCEPTION_SUBCLASS2(EProcessFuture, EProcessFutureArgumentTooLong,
+                        "Process argument is too long");
+    EXCEPTION_SUBCLASS2(EProcessFuture, EProcessFutureNotStreaming,
+                        "Process output is not streamed to a buffer");
 
     /**
      * A handle to a process managed by ProcessManager
@@ -81,6 +85,22 @@ namespace Forte
     public:
         typedef boost::function<void (boost::shared_ptr<ProcessFuture>)> ProcessCompleteCallback;
 
+        enum OutputStream
+        {
+            OutputStdout,
+            OutputStderr
+        };
+
+        /**
+         * An OutputCallback is given the output of a streamed process
+         * as it arrives, and a len of 0 at the end of each stream.
+         */
+        typedef boost::function<void (OutputStream stream,
+                                      const char *data,
+                                      size_t len)> OutputCallback;
+
+        static const size_t DEFAULT_OUTPUT_WINDOW = 262144;
+
         enum ProcessTerminationType
         {
             ProcessExited,
@@ -164,6 +184,51 @@ namespace Forte
          */
         virtual void SetErrorFilename(const FString &errorfile) = 0;
 
+        /**
+         * SetOutputCallback() streams stdout and stderr to callback
+         * instead of the output and error files. The callback runs on
+         * the ProcessManager's callback thread, so it must not block
+         * or wait on a process. No more than window bytes of each
+         * stream are read from the process ahead of the callback; a
+         * process that writes faster blocks until the callback
+         * catches up. Can only be called on a process not yet run.
+         *
+         * @throw EProcessFutureStarted
+         *
+         * @param callback function given each piece of output
+         * @param window bytes of each stream that may be in flight
+         */
+        virtual void SetOutputCallback(
+            const OutputCallback &callback,
+            size_t window = DEFAULT_OUTPUT_WINDOW) = 0;
+
+        /**
+         * SetOutputBuffer() streams stdout and stderr into a ring
+         * buffer of capacity bytes each, to be read with
+         * ReadOutput(). A process which fills a buffer blocks until
+         * it is read. Can only be called on a process not yet run.
+         *
+         * @throw EProcessFutureStarted
+         *
+         * @param capacity size in bytes of each buffer
+         */
+        virtual void SetOutputBuffer(size_t capacity) = 0;
+
+        /**
+         * ReadOutput() reads up to len bytes of the stream from the
+         * buffer set with SetOutputBuffer(), blocking until there is
+         * some. Output may still be read after the process has
+         * finished.
+         *
+         * @throw EProcessFutureNotStreaming
+         * @throw EProcessFutureNotStarted
+         *
+         * @return the number of bytes read, or 0 at the end of the
+         * stream
+         */
+        virtual size_t ReadOutput(OutputStream stream, char *buf,
+                                  size_t len) = 0;
+
         /**
          * GetResult() block until the process has finished, or the process is abandoned.
          *
@@ -24,6 +24,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -45,8 +46,11 @@ Forte::ProcessFutureImpl::ProcessFutureImpl(
     mOutputFilename(outputFilename),
     mErrorFilename(errorFilename),
     mInputFilename(inputFilename),
+    mOutputWindow(0),
+    mOutputCond(mOutputLock),
     mMonitorPid(-1),
     mProcessPid(-1),
+    mSpawnID(0),
     mOutputString(""),
     mErrorString(""),
     mState(STATE_READY),
@@ -154,6 +158,55 @@ void Forte::ProcessFutureImpl::SetErrorFilename(const FString &errorfile)
     mErrorFilename = errorfile;
 }
 
+void Forte::ProcessFutureImpl::SetOutputCallback(
+    const OutputCallback &callback,
+    size_t window)
+{
+    if(getState() != STATE_READY)
+    {
+        hlog(HLOG_ERR, "tried setting the output callback after the process had been started");
+        throw EProcessFutureStarted();
+    }
+    mOutputCallback = callback;
+    mOutputWindow = (callback ? window : 0);
+}
+
+void Forte::ProcessFutureImpl::SetOutputBuffer(size_t capacity)
+{
+    if(getState() != STATE_READY)
+    {
+        hlog(HLOG_ERR, "tried setting the output buffer after the process had been started");
+        throw EProcessFutureStarted();
+    }
+    mOutputCallback.clear();
+    mOutputWindow = capacity;
+    mOutputRings[OutputStdout].SetCapacity(capacity);
+    mOutputRings[OutputStderr].SetCapacity(capacity);
+}
+
+size_t Forte::ProcessFutureImpl::ReadOutput(OutputStream stream,
+                                            char *buf,
+                                            size_t len)
+{
+    if (!isStreamingOutput() || mOutputCallback)
+        throw EProcessFutureNotStreaming();
+    if (getState() == STATE_READY)
+        throw EProcessFutureNotStarted();
+
+    size_t n;
+    {
+        AutoUnlockMutex lock(mOutputLock);
+        OutputRing &ring(mOutputRings[stream]);
+        while (ring.mSize == 0 && !ring.mEOF)
+            mOutputCond.Wait();
+        n = ring.Read(buf, len);
+    }
+    // the space is free again; let procmon read that much more
+    if (n > 0)
+        sendOutputAck(stream, n);
+    return n;
+}
+
 boost::shared_ptr<ProcessManagerImpl> Forte::ProcessFutureImpl::getProcessManager(void)
 {
     boost::shared_ptr<ProcessManagerImpl> mgr(mProcessManagerPtr.lock());
@@ -172,12 +225,56 @@ void Forte::ProcessFutureImpl::run()
     if (getState() != STATE_READY)
         throw EProcessFutureStarted();
 
+    // a pooled process is started by a single request, built before
+    // the state changes so that a bad argument leaves it ready
+    PDUPtr spawnPDU;
+    if (mSpawnID != 0)
+        spawnPDU = makeSpawnReq();
+
     // we must set the state prior to sending the start PDU to avoid a race
     setState(STATE_STARTING);
 
     try
     {
+        if (spawnPDU)
+            mManagementChannel->EnqueuePDU(spawnPDU);
+        else
+            sendMonitorStart();
+    }
+    catch (Exception &e)
+    {
+        throw EProcessFutureManagementProcFailed(e.what());
+    }
+
+    // wait for the process to change state
+    DeadlineClock deadline;
+    deadline.ExpiresInSeconds(5);
+    MonotonicClock mtc;
+    AutoUnlockMutex lock(mWaitLock);
+    while (!deadline.Expired() &&
+           getState() == STATE_STARTING)
+    {
+        mWaitCond.TimedWait(mtc.GetTime() + Timespec::FromMillisec(100));
+    }
 
+    if (deadline.Expired() &&
+        getState() == STATE_STARTING)
+    {
+        // get's cancel the process monitor
+        Cancel();
+
+        hlog_and_throw(
+            HLOG_WARN,
+            EProcessFutureManagementProcFailed(
+                FString(
+                    FStringFC(),
+                    "Timed out waiting for process monitor to start for command %s",
+                    mCommand.c_str())));
+    }
+}
+
+void Forte::ProcessFutureImpl::sendMonitorStart(void)
+{
         // send the param PDUs, with full command line info, etc
         PDUPtr paramPDU(new PDU(ProcessOpParam, sizeof(ProcessParamPDU)));
         ProcessParamPDU *param = paramPDU->GetPayload<ProcessParamPDU>();
@@ -220,43 +317,52 @@ void Forte::ProcessFutureImpl::run()
         param->param = ProcessErrfile;
         mManagementChannel->EnqueuePDU(paramPDU);
 
+        if (isStreamingOutput())
+        {
+            paramPDU.reset(new PDU(ProcessOpParam, sizeof(ProcessParamPDU)));
+            param = paramPDU->GetPayload<ProcessParamPDU>();
+            snprintf(param->str, sizeof(param->str), "%zu", mOutputWindow);
+            param->param = ProcessOutputWindow;
+            mManagementChannel->EnqueuePDU(paramPDU);
+        }
+
         // send the control PDU telling the process to start
         PDUPtr pdu(new PDU(ProcessOpControlReq, sizeof(ProcessControlReqPDU)));
         ProcessControlReqPDU *control = pdu->GetPayload<ProcessControlReqPDU>();
 
         control->control = ProcessControlStart;
         mManagementChannel->EnqueuePDU(pdu);
-    }
-    catch (Exception &e)
-    {
-        throw EProcessFutureManagementProcFailed(e.what());
-    }
+}
 
-    // wait for the process to change state
-    DeadlineClock deadline;
-    deadline.ExpiresInSeconds(5);
-    MonotonicClock mtc;
-    AutoUnlockMutex lock(mWaitLock);
-    while (!deadline.Expired() &&
-           getState() == STATE_STARTING)
+namespace
+{
+    void copySpawnParam(char *dst, size_t size, const FString &src)
     {
-        mWaitCond.TimedWait(mtc.GetTime() + Timespec::FromMillisec(100));
+        if (src.size() >= size)
+        {
+            hlog_and_throw(
+                HLOG_ERR,
+                EProcessFutureArgumentTooLong(
+                    FStringFC(), "%zu bytes, the limit is %zu",
+                    src.size(), size - 1));
+        }
+        memcpy(dst, src.c_str(), src.size() + 1);
     }
+}
 
-    if (deadline.Expired() &&
-        getState() == STATE_STARTING)
-    {
-        // get's cancel the process monitor
-        Cancel();
-
-        hlog_and_throw(
-            HLOG_WARN,
-            EProcessFutureManagementProcFailed(
-                FString(
-                    FStringFC(),
-                    "Timed out waiting for process monitor to start for command %s",
-                    mCommand.c_str())));
-    }
+PDUPtr Forte::ProcessFutureImpl::makeSpawnReq(void)
+{
+    PDUPtr pdu(new PDU(ProcessOpSpawnReq, sizeof(ProcessSpawnReqPDU)));
+    ProcessSpawnReqPDU *req = pdu->GetPayload<ProcessSpawnReqPDU>();
+
+    req->id = mSpawnID;
+    copySpawnParam(req->cmdline, sizeof(req->cmdline), mCommand);
+    copySpawnParam(req->cmdlineToLog, sizeof(req->cmdlineToLog), mCommandToLog);
+    copySpawnParam(req->cwd, sizeof(req->cwd), mCurrentWorkingDirectory);
+    copySpawnParam(req->infile, sizeof(req->infile), mInputFilename);
+    copySpawnParam(req->outfile, sizeof(req->outfile), mOutputFilename);
+    copySpawnParam(req->errfile, sizeof(req->errfile), mErrorFilename);
+    return pdu;
 }
 
 void Forte::ProcessFutureImpl::setState(int state)
@@ -401,7 +507,11 @@ void Forte::ProcessFutureImpl::abandon()
 
     if (mManagementChannel)
     {
-        getProcessManager()->abandonProcess(mManagementChannel);
+        // a pooled process shares its channel with others
+        if (mSpawnID != 0)
+            getProcessManager()->abandonPooledProcess(mSpawnID);
+        else
+            getProcessManager()->abandonProcess(mManagementChannel);
     }
 
     setState(STATE_ABANDONED);
@@ -417,6 +527,17 @@ void Forte::ProcessFutureImpl::Signal(int signum)
     if (!isInRunningState())
         throw EProcessFutureNotRunning();
 
+    if (mSpawnID != 0)
+    {
+        PDUPtr pdu(new PDU(ProcessOpSpawnSignal, sizeof(ProcessSpawnSignalPDU)));
+        ProcessSpawnSignalPDU *req = pdu->GetPayload<ProcessSpawnSignalPDU>();
+
+        req->id = mSpawnID;
+        req->signum = signum;
+        mManagementChannel->EnqueuePDU(pdu);
+        return;
+    }
+
     PDUPtr pdu(new PDU(ProcessOpControlReq, sizeof(ProcessControlReqPDU)));
     ProcessControlReqPDU *control = pdu->GetPayload<ProcessControlReqPDU>();
 
@@ -575,6 +696,9 @@ void Forte::ProcessFutureImpl::handlePDU(PDUPeer &peer)
         case ProcessOpStatus:
             handleStatus(peer, pdu);
             break;
+        case ProcessOpOutput:
+            handleOutput(pdu);
+            break;
         default:
             hlog(HLOG_ERR, "unexpected PDU with opcode %d", pdu.GetOpcode());
             break;
@@ -582,10 +706,31 @@ void Forte::ProcessFutureImpl::handlePDU(PDUPeer &peer)
     }
 }
 
+void Forte::ProcessFutureImpl::handleSpawnPDU(const PDU &pdu)
+{
+    FTRACE;
+    switch (pdu.GetOpcode())
+    {
+    case ProcessOpSpawnRes:
+        controlResult(&pdu.GetPayload<ProcessSpawnResPDU>()->res);
+        break;
+    case ProcessOpSpawnStatus:
+        statusChanged(&pdu.GetPayload<ProcessSpawnStatusPDU>()->status);
+        break;
+    default:
+        hlog(HLOG_ERR, "unexpected PDU with opcode %d", pdu.GetOpcode());
+        break;
+    }
+}
+
 void Forte::ProcessFutureImpl::handleControlRes(PDUPeer &peer, const PDU &pdu)
 {
     FTRACE;
-    const ProcessControlResPDU *resPDU = pdu.GetPayload<ProcessControlResPDU>();
+    controlResult(pdu.GetPayload<ProcessControlResPDU>());
+}
+
+void Forte::ProcessFutureImpl::controlResult(const ProcessControlResPDU *resPDU)
+{
     hlog(HLOG_DEBUG, "got back result code %d", resPDU->result);
     mMonitorPid = resPDU->monitorPID;
     mProcessPid = resPDU->processPID;
@@ -595,6 +740,7 @@ void Forte::ProcessFutureImpl::handleControlRes(PDUPeer &peer, const PDU &pdu)
     else
     {
         mErrorString.assign(resPDU->error);
+        closeOutput();
         setState(STATE_ERROR);
     }
 }
@@ -602,7 +748,11 @@ void Forte::ProcessFutureImpl::handleControlRes(PDUPeer &peer, const PDU &pdu)
 void Forte::ProcessFutureImpl::handleStatus(PDUPeer &peer, const PDU &pdu)
 {
     FTRACE;
-    const ProcessStatusPDU *status = pdu.GetPayload<ProcessStatusPDU>();
+    statusChanged(pdu.GetPayload<ProcessStatusPDU>());
+}
+
+void Forte::ProcessFutureImpl::statusChanged(const ProcessStatusPDU *status)
+{
     hlog(HLOG_DEBUG, "got back status type %d code %d", status->type, status->statusCode);
     mStatusCode = status->statusCode;
     switch (status->type)
@@ -633,9 +783,115 @@ void Forte::ProcessFutureImpl::handleError(PDUPeer &peer)
     // the process monitor connection has encountered an unrecoverable
     // error.
     hlog(HLOG_ERR, "lost connection to procmon");
+    closeOutput();
     if (!isInTerminalState())
     {
         mStatusCode = ProcessProcmonFailure;
         setState(STATE_ERROR);
     }
 }
+
+void Forte::ProcessFutureImpl::handleOutput(const PDU &pdu)
+{
+    FTRACE;
+    const ProcessOutputPDU *output = pdu.GetPayload<ProcessOutputPDU>();
+    if (pdu.GetPayloadSize() < sizeof(ProcessOutputPDU)
+        || output->len < 0
+        || pdu.GetPayloadSize() - sizeof(ProcessOutputPDU)
+           < static_cast<size_t>(output->len)
+        || (output->stream != OutputStdout
+            && output->stream != OutputStderr))
+    {
+        hlog(HLOG_ERR, "malformed output PDU");
+        return;
+    }
+    OutputStream stream = static_cast<OutputStream>(output->stream);
+    const char *data = reinterpret_cast<const char *>(output + 1);
+    size_t len = output->len;
+
+    if (mOutputCallback)
+    {
+        {
+            AutoUnlockMutex lock(mOutputLock);
+            if (len == 0)
+                mOutputRings[stream].mEOF = true;
+        }
+        try
+        {
+            mOutputCallback(stream, data, len);
+        }
+        catch (std::exception &e)
+        {
+            hlog(HLOG_ERR, "output callback threw: %s", e.what());
+        }
+        if (len > 0)
+            sendOutputAck(stream, len);
+        return;
+    }
+
+    AutoUnlockMutex lock(mOutputLock);
+    OutputRing &ring(mOutputRings[stream]);
+    if (len == 0)
+        ring.mEOF = true;
+    else if (ring.Write(data, len) != len)
+        hlog(HLOG_ERR, "procmon sent more output than the buffer holds");
+    mOutputCond.Broadcast();
+}
+
+void Forte::ProcessFutureImpl::sendOutputAck(int stream, size_t len)
+{
+    PDUPtr pdu(new PDU(ProcessOpOutputAck, sizeof(ProcessOutputAckPDU)));
+    ProcessOutputAckPDU *ack = pdu->GetPayload<ProcessOutputAckPDU>();
+
+    ack->stream = stream;
+    ack->len = len;
+    mManagementChannel->EnqueuePDU(pdu);
+}
+
+void Forte::ProcessFutureImpl::closeOutput(void)
+{
+    if (!isStreamingOutput())
+        return;
+
+    bool wasOpen[2];
+    {
+        AutoUnlockMutex lock(mOutputLock);
+        for (int i = 0; i < 2; ++i)
+        {
+            wasOpen[i] = !mOutputRings[i].mEOF;
+            mOutputRings[i].mEOF = true;
+        }
+        mOutputCond.Broadcast();
+    }
+    if (mOutputCallback)
+    {
+        if (wasOpen[OutputStdout])
+            mOutputCallback(OutputStdout, NULL, 0);
+        if (wasOpen[OutputStderr])
+            mOutputCallback(OutputStderr, NULL, 0);
+    }
+}
+
+size_t Forte::ProcessFutureImpl::OutputRing::Write(const char *data, size_t len)
+{
+    len = std::min(len, mData.size() - mSize);
+    size_t tail = (mHead + mSize) % mData.size();
+    size_t first = std::min(len, mData.size() - tail);
+    memcpy(&mData[tail], data, first);
+    memcpy(&mData[0], data + first, len - first);
+    mSize += len;
+    return len;
+}
+
+size_t Forte::ProcessFutureImpl::OutputRing::Read(char *buf, size_t len)
+{
+    len = std::min(len, mSize);
+    if (len == 0)
+        return 0;
+    size_t first = std::min(len, mData.size() - mHead);
+    memcpy(buf, &mData[mHead], first);
+    memcpy(buf + first, &mData[0], len - first);
+    mHead = (mHead + len) % mData.size();
+    mSize -= len;
+    return len;
+}
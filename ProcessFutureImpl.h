@@ -7,8 +7,10 @@
 #include "ThreadCondition.h"
 #include "ProcessFuture.h"
 #include "ProcessManagerImpl.h"
+#include "ProcessManagerPDU.h"
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <vector>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -130,6 +132,12 @@ namespace Forte
          */
         void SetErrorFilename(const FString &errorfile);
 
+        virtual void SetOutputCallback(
+            const OutputCallback &callback,
+            size_t window = DEFAULT_OUTPUT_WINDOW);
+        virtual void SetOutputBuffer(size_t capacity);
+        virtual size_t ReadOutput(OutputStream stream, char *buf, size_t len);
+
         /**
          * GetResult() block until the process has finished, or the process is abandoned.
          *
@@ -343,6 +351,42 @@ namespace Forte
         void handleControlRes(PDUPeer &peer, const PDU &pdu);
         void handleStatus(PDUPeer &peer, const PDU &pdu);
 
+        /**
+         * Handle a PDU for this process from a pooled procmon worker.
+         *
+         * @param pdu a ProcessOpSpawnRes or ProcessOpSpawnStatus PDU
+         */
+        void handleSpawnPDU(const PDU &pdu);
+
+        void controlResult(const ProcessControlResPDU *resPDU);
+        void statusChanged(const ProcessStatusPDU *status);
+
+        /**
+         * Deliver streamed output, acknowledging it to procmon once it
+         * has been passed to the output callback.
+         */
+        void handleOutput(const PDU &pdu);
+        void sendOutputAck(int stream, size_t len);
+
+        /**
+         * End any output stream procmon will no longer send.
+         */
+        void closeOutput(void);
+
+        bool isStreamingOutput(void) const { return mOutputWindow > 0; }
+
+        /**
+         * Send the parameters and start request to a dedicated procmon.
+         */
+        void sendMonitorStart(void);
+
+        /**
+         * Build the request which starts a pooled process.
+         *
+         * @throw EProcessFutureArgumentTooLong
+         */
+        PDUPtr makeSpawnReq(void);
+
         /**
          * Called when an unrecoverable error has occurred on the
          * connection to a peer.
@@ -366,8 +410,39 @@ namespace Forte
         FString mErrorFilename;
         FString mInputFilename;
 
+        /**
+         * OutputRing holds the streamed output of one stream until it
+         * is read.
+         */
+        class OutputRing
+        {
+        public:
+            OutputRing() : mHead(0), mSize(0), mEOF(false) {}
+
+            void SetCapacity(size_t capacity) { mData.resize(capacity); }
+            size_t Write(const char *data, size_t len);
+            size_t Read(char *buf, size_t len);
+
+            std::vector<char> mData;
+            size_t mHead;
+            size_t mSize;
+            bool mEOF;
+        };
+
+        // bytes of each stream procmon may send ahead of the reader,
+        // 0 when output goes to files
+        size_t mOutputWindow;
+        OutputCallback mOutputCallback;
+        Mutex mOutputLock;
+        ThreadCondition mOutputCond;
+        OutputRing mOutputRings[2];
+
         pid_t mMonitorPid;
         pid_t mProcessPid;
+
+        // id of the process on a pooled procmon worker, 0 if the
+        // process has a procmon of its own
+        uint64_t mSpawnID;
         unsigned int mStatusCode;
         FString mOutputString;
         FString mErrorString;
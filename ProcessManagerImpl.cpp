@@ -14,6 +14,8 @@
 #include "FTrace.h"
 #include "GUIDGenerator.h"
 #include "PDUPeerSetBuilderImpl.h"
+#include "Foreach.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
@@ -34,9 +36,12 @@ using namespace Forte;
 const int Forte::ProcessManagerImpl::MAX_RUNNING_PROCS = 128;
 const int Forte::ProcessManagerImpl::PDU_BUFFER_SIZE = 4096;
 
-Forte::ProcessManagerImpl::ProcessManagerImpl() :
+Forte::ProcessManagerImpl::ProcessManagerImpl(unsigned int procmonPoolSize) :
     mPeerSet(new PDUPeerSetBuilderImpl()),
     mProcmonPath("/usr/libexec/procmon"),
+    mProcmonPoolSize(procmonPoolSize),
+    mNextWorker(0),
+    mNextSpawnID(0),
     mCallbackAvailableCondition (mCallbackQueueMutex)
 {
     FTRACE;
@@ -70,6 +75,12 @@ Forte::ProcessManagerImpl::ProcessManagerImpl() :
                               FunctionThread::AutoInit(),
                               boost::bind(&ProcessManagerImpl::callbackThreadRun, this),
                               "procmgrcb"));
+
+    if (mProcmonPoolSize > 0)
+    {
+        // start the whole pool now, not on the first process
+        getWorker();
+    }
 }
 
 Forte::ProcessManagerImpl::~ProcessManagerImpl()
@@ -111,11 +122,7 @@ Forte::ProcessManagerImpl::CreateProcess(const FString &command,
                               inputFilename,
                               environment,
                               commandToLog));
-    startMonitor(ph);
-    {
-        AutoUnlockMutex lock(mProcessesLock);
-        mProcesses[ph->getManagementFD()] = ph;
-    }
+    addProcess(ph);
 
     ph->run();
     return ph;
@@ -142,9 +149,7 @@ Forte::ProcessManagerImpl::CreateProcessDontRun(const FString &command,
                               inputFilename,
                               environment,
                               commandToLog));
-    startMonitor(ph);
-    AutoUnlockMutex lock(mProcessesLock);
-    mProcesses[ph->getManagementFD()] = ph;
+    addProcess(ph);
 
     return ph;
 }
@@ -154,6 +159,16 @@ void Forte::ProcessManagerImpl::RunProcess(
 {
     boost::shared_ptr<ProcessFutureImpl> pfi =
         dynamic_pointer_cast<ProcessFutureImpl>(ph);
+    if (pfi->isStreamingOutput() && pfi->mSpawnID != 0)
+    {
+        // pooled workers do not stream output, so the process gets a
+        // procmon of its own after all
+        abandonPooledProcess(pfi->mSpawnID);
+        pfi->mSpawnID = 0;
+        startMonitor(pfi);
+        AutoUnlockMutex lock(mProcessesLock);
+        mProcesses[pfi->getManagementFD()] = pfi;
+    }
     pfi->run();
 }
 
@@ -177,12 +192,67 @@ void Forte::ProcessManagerImpl::abandonProcess(const boost::shared_ptr<Forte::PD
     mPeerSet->PeerDelete(peer);
 }
 
-#pragma GCC diagnostic ignored "-Wold-style-cast"
+void Forte::ProcessManagerImpl::abandonPooledProcess(uint64_t spawnID)
+{
+    // the worker keeps running the command; its status will find no
+    // process and be dropped
+    AutoUnlockMutex lock(mProcessesLock);
+    mPooledProcesses.erase(spawnID);
+}
+
+void Forte::ProcessManagerImpl::addProcess(
+    const boost::shared_ptr<Forte::ProcessFutureImpl> &ph)
+{
+    if (mProcmonPoolSize == 0)
+    {
+        startMonitor(ph);
+        AutoUnlockMutex lock(mProcessesLock);
+        mProcesses[ph->getManagementFD()] = ph;
+        return;
+    }
+
+    ph->mManagementChannel = getWorker();
+    AutoUnlockMutex lock(mProcessesLock);
+    ph->mSpawnID = ++mNextSpawnID;
+    mPooledProcesses[ph->mSpawnID] = ph;
+}
+
+boost::shared_ptr<Forte::PDUPeer> Forte::ProcessManagerImpl::getWorker(void)
+{
+    AutoUnlockMutex lock(mWorkersLock);
+    while (mWorkers.size() < mProcmonPoolSize)
+    {
+        mWorkers.push_back(launchProcmon(true));
+    }
+    mNextWorker = (mNextWorker + 1) % mWorkers.size();
+    return mWorkers[mNextWorker];
+}
+
+boost::shared_ptr<Forte::PDUPeer> Forte::ProcessManagerImpl::findWorker(
+    const PDUPeer &peer)
+{
+    AutoUnlockMutex lock(mWorkersLock);
+    foreach (const boost::shared_ptr<PDUPeer> &worker, mWorkers)
+    {
+        if (worker.get() == &peer)
+            return worker;
+    }
+    return boost::shared_ptr<PDUPeer>();
+}
 
 void Forte::ProcessManagerImpl::startMonitor(
     boost::shared_ptr<Forte::ProcessFutureImpl> ph)
+{
+    ph->mManagementChannel = launchProcmon(false);
+}
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+
+boost::shared_ptr<Forte::PDUPeer> Forte::ProcessManagerImpl::launchProcmon(
+    bool worker)
 {
     int fds[2];
+    boost::shared_ptr<PDUPeer> peer;
 
     try
     {
@@ -227,7 +297,13 @@ void Forte::ProcessManagerImpl::startMonitor(
                 "(procmon)",  // TODO include the name of the monitored process
                 childfdStr.c_str(),
                 NULL,
+                NULL,
             };
+            if (worker)
+            {
+                vargs[1] = "-w";
+                vargs[2] = childfdStr.c_str();
+            }
 //        fprintf(stderr, "procmon child, exec '%s' '%s'\n", mProcmonPath.c_str(), vargs[1]);
             execv(mProcmonPath, const_cast< char** >(vargs));
             fprintf(stderr, "procmon child, exec() failed: %d %s\n", errno,
@@ -240,7 +316,7 @@ void Forte::ProcessManagerImpl::startMonitor(
             childfd.Close();
             // add a PDUPeer to the PeerSet owned by the ProcessManager
             //boost::shared_ptr<ProcessManager> pm(mProcessManagerPtr.lock());
-            ph->mManagementChannel = addPeer(parentfd);
+            peer = addPeer(parentfd);
             parentfd.Release();
 
             // wait for process to deamonise
@@ -289,6 +365,7 @@ void Forte::ProcessManagerImpl::startMonitor(
         hlog(HLOG_ERR, "Unknown error starting process monitor");
         throw;
     }
+    return peer;
 }
 
 #pragma GCC diagnostic warning "-Wold-style-cast"
@@ -439,8 +516,94 @@ bool Forte::ProcessManagerImpl::IsProcessMapEmpty(void)
     return (mProcesses.empty());
 }
 
+void Forte::ProcessManagerImpl::workerPDUCallback(PDUPeer &peer)
+{
+    FTRACE;
+    PDU pdu;
+    while (peer.RecvPDU(pdu))
+    {
+        uint64_t spawnID;
+        switch (pdu.GetOpcode())
+        {
+        case ProcessOpSpawnRes:
+            spawnID = pdu.GetPayload<ProcessSpawnResPDU>()->id;
+            break;
+        case ProcessOpSpawnStatus:
+            spawnID = pdu.GetPayload<ProcessSpawnStatusPDU>()->id;
+            break;
+        default:
+            hlog(HLOG_ERR, "unexpected PDU with opcode %d from procmon worker",
+                 pdu.GetOpcode());
+            continue;
+        }
+
+        // p is declared outside the lock's scope, so that dropping
+        // the last reference to it, which abandons the process, never
+        // happens with the lock held
+        boost::shared_ptr<ProcessFutureImpl> p;
+        {
+            AutoUnlockMutex lock(mProcessesLock);
+            PooledProcessMap::iterator i = mPooledProcesses.find(spawnID);
+            if (i != mPooledProcesses.end())
+                p = (*i).second.lock();
+        }
+        if (p)
+        {
+            p->handleSpawnPDU(pdu);
+        }
+        else
+        {
+            hlog(HLOG_DEBUG, "dropping PDU for abandoned spawn id %llu",
+                 static_cast<unsigned long long>(spawnID));
+        }
+    }
+}
+
+void Forte::ProcessManagerImpl::workerErrorCallback(
+    const boost::shared_ptr<PDUPeer> &worker)
+{
+    FTRACE;
+    hlog(HLOG_ERR, "lost connection to procmon worker");
+    {
+        AutoUnlockMutex lock(mWorkersLock);
+        mWorkers.erase(std::remove(mWorkers.begin(), mWorkers.end(), worker),
+                       mWorkers.end());
+    }
+
+    std::vector<boost::shared_ptr<ProcessFutureImpl> > lost;
+    {
+        AutoUnlockMutex lock(mProcessesLock);
+        typedef std::pair<uint64_t, boost::weak_ptr<ProcessFutureImpl> > PooledPair;
+        foreach (const PooledPair &entry, mPooledProcesses)
+        {
+            boost::shared_ptr<ProcessFutureImpl> p(entry.second.lock());
+            if (p && p->mManagementChannel == worker)
+                lost.push_back(p);
+        }
+    }
+    foreach (const boost::shared_ptr<ProcessFutureImpl> &p, lost)
+    {
+        p->handleError(*worker);
+    }
+    mPeerSet->PeerDelete(worker);
+}
+
 void Forte::ProcessManagerImpl::deliverEvent(const PDUPeerEventPtr &event)
 {
+    if (mProcmonPoolSize > 0)
+    {
+        boost::shared_ptr<PDUPeer> worker(findWorker(*(event->mPeer)));
+        if (worker)
+        {
+            if (event->mEventType == PDUPeerReceivedPDUEvent)
+                workerPDUCallback(*worker);
+            else if (event->mEventType == PDUPeerSendErrorEvent
+                     || event->mEventType == PDUPeerDisconnectedEvent)
+                workerErrorCallback(worker);
+            return;
+        }
+    }
+
     switch (event->mEventType)
     {
     case PDUPeerReceivedPDUEvent:
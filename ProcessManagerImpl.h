@@ -15,6 +15,8 @@
 #include <boost/shared_ptr.hpp>
 #include <unistd.h>
 #include <sys/types.h>
+#include <stdint.h>
+#include <vector>
 
 namespace Forte
 {
@@ -35,8 +37,21 @@ namespace Forte
         static const int PDU_BUFFER_SIZE;
 
         typedef std::map<int, boost::weak_ptr<ProcessFutureImpl> > ProcessMap;
+        typedef std::map<uint64_t, boost::weak_ptr<ProcessFutureImpl> > PooledProcessMap;
 
-        ProcessManagerImpl();
+        /**
+         * By default every process gets a procmon of its own, forked
+         * and exec'd when the process is created. With a procmonPoolSize
+         * above zero, that many procmon workers are started up front
+         * and every process is handed to one of them over its existing
+         * connection, which makes starting short lived commands much
+         * cheaper. A worker that is lost is replaced when the next
+         * process is created. A process which streams its output is
+         * always given a procmon of its own.
+         *
+         * @param procmonPoolSize number of pooled procmon workers, or 0
+         */
+        ProcessManagerImpl(unsigned int procmonPoolSize = 0);
 
         /**
          * ProcessManagerImpl destructor. If the process manager is being destroyed it will
@@ -110,6 +125,8 @@ namespace Forte
 
         virtual const FString & GetProcmonPath(void) { return mProcmonPath; }
 
+        unsigned int GetProcmonPoolSize(void) const { return mProcmonPoolSize; }
+
         virtual bool IsProcessMapEmpty(void);
 
         virtual int CreateProcessAndGetResult(
@@ -133,6 +150,43 @@ namespace Forte
 
         virtual void startMonitor(boost::shared_ptr<Forte::ProcessFutureImpl> ph);
 
+        /**
+         * Fork and exec a procmon, either for a single process or as a
+         * pooled worker, and connect to it.
+         *
+         * @return the PDU peer for the new procmon
+         */
+        boost::shared_ptr<Forte::PDUPeer> launchProcmon(bool worker);
+
+        /**
+         * Give a new process its procmon, or a pooled worker and spawn
+         * id, and start routing its PDUs to it.
+         */
+        void addProcess(const boost::shared_ptr<Forte::ProcessFutureImpl> &ph);
+
+        /**
+         * Pick the pooled worker for the next process, starting any
+         * that are missing.
+         */
+        boost::shared_ptr<Forte::PDUPeer> getWorker(void);
+
+        boost::shared_ptr<Forte::PDUPeer> findWorker(const PDUPeer &peer);
+
+        /**
+         * Stop routing PDUs for a pooled process to its ProcessFuture.
+         */
+        virtual void abandonPooledProcess(uint64_t spawnID);
+
+        /**
+         * Route the PDUs from a pooled worker by spawn id.
+         */
+        void workerPDUCallback(PDUPeer &peer);
+
+        /**
+         * Fail every process on a lost pooled worker.
+         */
+        void workerErrorCallback(const boost::shared_ptr<PDUPeer> &worker);
+
         /**
          * addPeer() is used by new Process objects after creating
          * their monitoring process.  The ProcessManager object (which
@@ -192,6 +246,22 @@ namespace Forte
 
         FString mProcmonPath;
 
+        const unsigned int mProcmonPoolSize;
+
+        /**
+         * Pooled workers, and the next one to use
+         */
+        Mutex mWorkersLock;
+        std::vector<boost::shared_ptr<Forte::PDUPeer> > mWorkers;
+        unsigned int mNextWorker;
+
+        /**
+         * Processes on pooled workers, by spawn id; guarded by
+         * mProcessesLock
+         */
+        PooledProcessMap mPooledProcesses;
+        uint64_t mNextSpawnID;
+
         Mutex mCallbackQueueMutex;
         Forte::ThreadCondition mCallbackAvailableCondition;
         boost::shared_ptr<Forte::FunctionThread> mCallbackThread;
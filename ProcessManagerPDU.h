@@ -1,6 +1,10 @@
 #ifndef _Forte_Process_Manager_PDU_h_
 #define _Forte_Process_Manager_PDU_h_
 
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
 namespace Forte
 {
 
@@ -12,7 +16,14 @@ namespace Forte
         ProcessOpControlReq,
         ProcessOpControlRes,
         ProcessOpInfoReq,
-        ProcessOpInfoRes
+        ProcessOpInfoRes,
+        // pooled procmon workers; every PDU names its process by the
+        // spawn id the ProcessManager gave it
+        ProcessOpSpawnReq,
+        ProcessOpSpawnRes,
+        ProcessOpSpawnStatus,
+        ProcessOpSpawnSignal,
+        ProcessOpOutputAck
     };
 
     enum ProcessStatusType
@@ -34,7 +45,10 @@ namespace Forte
         ProcessInfile,
         ProcessOutfile,
         ProcessErrfile,
-        ProcessCmdlineToLog
+        ProcessCmdlineToLog,
+        // decimal count of bytes; when set, stdout and stderr are
+        // streamed as ProcessOutputPDUs instead of written to files
+        ProcessOutputWindow
     };
 
     struct ProcessParamPDU
@@ -51,10 +65,29 @@ namespace Forte
         int msgLen;
         char msg[1024];
     } __attribute__((__packed__));
+    enum ProcessOutputStreamCode
+    {
+        ProcessOutputStdout,
+        ProcessOutputStderr
+    };
+
+    // largest amount of output carried by one ProcessOutputPDU, small
+    // enough to leave room in the receiving endpoint's 64K buffer
+    static const int PROCESS_OUTPUT_CHUNK_SIZE = 32768;
+
+    // followed by len bytes of output; len of 0 is the end of the
+    // stream. procmon sends no more than the output window, less what
+    // has been acknowledged, on each stream.
     struct ProcessOutputPDU
     {
+        int stream;
+        int len;
+    } __attribute__((__packed__));
+    // the receiver has consumed len bytes of stream
+    struct ProcessOutputAckPDU
+    {
+        int stream;
         int len;
-        char data[1024];
     } __attribute__((__packed__));
 
     enum ProcessControlCodes
@@ -112,5 +145,32 @@ namespace Forte
         // process PID
         int processPID;
     } __attribute__((__packed__));
+
+    // a whole ProcessParamPDU set and the start request in one PDU
+    struct ProcessSpawnReqPDU
+    {
+        uint64_t id;
+        char cmdline[2048];
+        char cmdlineToLog[2048];
+        char cwd[2048];
+        char infile[2048];
+        char outfile[2048];
+        char errfile[2048];
+    } __attribute__((__packed__));
+    struct ProcessSpawnResPDU
+    {
+        uint64_t id;
+        ProcessControlResPDU res;
+    } __attribute__((__packed__));
+    struct ProcessSpawnStatusPDU
+    {
+        uint64_t id;
+        ProcessStatusPDU status;
+    } __attribute__((__packed__));
+    struct ProcessSpawnSignalPDU
+    {
+        uint64_t id;
+        int signum;
+    } __attribute__((__packed__));
 };
 #endif
@@ -4,6 +4,8 @@
 #include <sys/stat.h>
 #include <linux/limits.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <algorithm>
 #include <boost/bind.hpp>
 #include "DaemonUtil.h"
 #include "LogManager.h"
@@ -23,9 +25,15 @@ Forte::ProcessMonitor::ProcessMonitor(int argc, char *argv[]) :
     mState(STATE_STARTUP),
     mInputFilename("/dev/null"),
     mOutputFilename("/dev/null"),
-    mErrorFilename("/dev/null")
+    mErrorFilename("/dev/null"),
+    mOutputWindow(0)
 {
     FTRACE;
+    for (int i = 0; i < 2; ++i)
+    {
+        mRelays[i].fd = -1;
+        mRelays[i].credit = 0;
+    }
     FString logFile;
     FString logLevel;
     try
@@ -59,6 +67,7 @@ Forte::ProcessMonitor::~ProcessMonitor()
 {
     FTRACE;
     mPeerSet->Shutdown();
+    closeOutputPipes();
 }
 
 void Forte::ProcessMonitor::Run()
@@ -106,7 +115,7 @@ void Forte::ProcessMonitor::Run()
                 break;
             }
 
-            usleep(500);
+            relayOutput();
         }
         catch (EPDUPeerSetNoPeers &e)
         {
@@ -143,6 +152,9 @@ void Forte::ProcessMonitor::pduCallback(PDUPeerEventPtr event)
             case ProcessOpControlReq:
                 handleControlReq(*(event->mPeer), pdu);
                 break;
+            case ProcessOpOutputAck:
+                handleOutputAck(pdu);
+                break;
             default:
                 hlog(HLOG_ERR, "unexpected PDU with opcode %d", pdu.GetOpcode());
                 break;
@@ -179,6 +191,9 @@ void Forte::ProcessMonitor::handleParam(const PDUPeer &peer, const PDU &pdu)
     case ProcessErrfile:
         mErrorFilename.assign(paramPDU->str);
         break;
+    case ProcessOutputWindow:
+        mOutputWindow = FString(paramPDU->str).AsUnsignedInteger();
+        break;
     default:
         hlog(HLOG_ERR, "received unknown param code %d", paramPDU->param);
         break;
@@ -355,23 +370,40 @@ void Forte::ProcessMonitor::startProcess(void)
     }
     while (inputfd == -1 && errno == EINTR);
 
-    do
+    if (mOutputWindow > 0)
     {
-        outputfd = open(mOutputFilename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
-        if(outputfd == -1 && errno != EINTR)
-            throw EProcessMonitorUnableToOpenOutputFile(
-                SystemCallUtil::GetErrorDescription(errno));
+        // streamed, the output files are not used
+        outputfd = openOutputPipe(ProcessOutputStdout);
+        try
+        {
+            errorfd = openOutputPipe(ProcessOutputStderr);
+        }
+        catch (EProcessMonitor &e)
+        {
+            close(outputfd);
+            throw;
+        }
     }
-    while (outputfd == -1 && errno == EINTR);
-
-    do
+    else
     {
-        errorfd = open(mErrorFilename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
-        if(errorfd == -1 && errno != EINTR)
-            throw EProcessMonitorUnableToOpenErrorFile(
-                SystemCallUtil::GetErrorDescription(errno));
+        do
+        {
+            outputfd = open(mOutputFilename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+            if(outputfd == -1 && errno != EINTR)
+                throw EProcessMonitorUnableToOpenOutputFile(
+                    SystemCallUtil::GetErrorDescription(errno));
+        }
+        while (outputfd == -1 && errno == EINTR);
+
+        do
+        {
+            errorfd = open(mErrorFilename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+            if(errorfd == -1 && errno != EINTR)
+                throw EProcessMonitorUnableToOpenErrorFile(
+                    SystemCallUtil::GetErrorDescription(errno));
+        }
+        while (errorfd == -1 && errno == EINTR);
     }
-    while (errorfd == -1 && errno == EINTR);
 
     if (mCmdlineToLog.empty())
     {
@@ -476,6 +508,7 @@ void Forte::ProcessMonitor::startProcess(void)
     if (pid < 0)
     {
         // failed to fork
+        closeOutputPipes();
         throw EProcessMonitorUnableToFork();
     }
     else
@@ -497,6 +530,134 @@ void Forte::ProcessMonitor::signalProcess(int signal)
         throw EProcessFutureSignalFailed();
 }
 
+int Forte::ProcessMonitor::openOutputPipe(int stream)
+{
+    FTRACE;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        int err = errno;
+        closeOutputPipes();
+        throw EProcessMonitorUnableToOpenOutputFile(
+            SystemCallUtil::GetErrorDescription(err));
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    AutoUnlockMutex lock(mRelayLock);
+    mRelays[stream].fd = fds[0];
+    mRelays[stream].credit = mOutputWindow;
+    return fds[1];
+}
+
+void Forte::ProcessMonitor::closeOutputPipes(void)
+{
+    AutoUnlockMutex lock(mRelayLock);
+    for (int i = 0; i < 2; ++i)
+    {
+        if (mRelays[i].fd != -1)
+        {
+            close(mRelays[i].fd);
+            mRelays[i].fd = -1;
+        }
+    }
+}
+
+void Forte::ProcessMonitor::handleOutputAck(const PDU &pdu)
+{
+    const ProcessOutputAckPDU *ack = pdu.GetPayload<ProcessOutputAckPDU>();
+    if (ack->stream != ProcessOutputStdout &&
+        ack->stream != ProcessOutputStderr)
+    {
+        hlog(HLOG_ERR, "output acknowledged for unknown stream %d",
+             ack->stream);
+        return;
+    }
+    AutoUnlockMutex lock(mRelayLock);
+    mRelays[ack->stream].credit += ack->len;
+}
+
+void Forte::ProcessMonitor::relayOutput(void)
+{
+    struct pollfd fds[2];
+    int streams[2];
+    nfds_t nfds = 0;
+    {
+        AutoUnlockMutex lock(mRelayLock);
+        for (int i = 0; i < 2; ++i)
+        {
+            // a stream without credit is left in its pipe, so the
+            // process blocks once the pipe is full
+            if (mRelays[i].fd != -1 && mRelays[i].credit > 0)
+            {
+                fds[nfds].fd = mRelays[i].fd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                streams[nfds++] = i;
+            }
+        }
+    }
+
+    if (nfds == 0)
+    {
+        usleep(500);
+        return;
+    }
+
+    // the same half millisecond the loop sleeps without output, but
+    // cut short by output or by SIGCHLD
+    struct timespec timeout = { 0, 500000 };
+    if (ppoll(fds, nfds, &timeout, NULL) <= 0)
+        return;
+    for (nfds_t i = 0; i < nfds; ++i)
+    {
+        if (fds[i].revents != 0)
+            relayStream(streams[i]);
+    }
+}
+
+void Forte::ProcessMonitor::relayStream(int stream)
+{
+    int fd;
+    size_t len;
+    {
+        AutoUnlockMutex lock(mRelayLock);
+        fd = mRelays[stream].fd;
+        len = std::min(mRelays[stream].credit,
+                       static_cast<size_t>(PROCESS_OUTPUT_CHUNK_SIZE));
+    }
+
+    // read straight into the PDU, then trim it to what was read
+    PDUPtr p(new PDU(ProcessOpOutput, sizeof(ProcessOutputPDU) + len));
+    ProcessOutputPDU *output = p->GetPayload<ProcessOutputPDU>();
+    ssize_t n = read(fd, reinterpret_cast<char *>(output + 1), len);
+    if (n == -1 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n == -1)
+        hlog(HLOG_ERR, "unable to read output stream %d: %s", stream,
+             SystemCallUtil::GetErrorDescription(errno).c_str());
+
+    output->stream = stream;
+    output->len = std::max(n, static_cast<ssize_t>(0));
+    PDUHeader header(p->GetHeader());
+    header.payloadSize = sizeof(ProcessOutputPDU) + output->len;
+    p->SetHeader(header);
+
+    {
+        AutoUnlockMutex lock(mRelayLock);
+        if (n > 0)
+        {
+            mRelays[stream].credit -= n;
+        }
+        else
+        {
+            // end of stream
+            close(mRelays[stream].fd);
+            mRelays[stream].fd = -1;
+        }
+    }
+    mPeerSet->BroadcastAsync(p);
+}
+
 Forte::FString Forte::ProcessMonitor::shellEscape(const FString& arg)
 {
     // \TODO: implement this.
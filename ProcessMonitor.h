@@ -1,6 +1,7 @@
 #ifndef _Forte_process_monitor_h_
 #define _Forte_process_monitor_h_
 
+#include "AutoMutex.h"
 #include "FString.h"
 #include "LogManager.h"
 #include "PDUPeerSetBuilder.h"
@@ -111,6 +112,23 @@ namespace Forte
         void startProcess(void);
         void signalProcess(int signal);
 
+        /**
+         * Create the pipe for a streamed output stream.
+         *
+         * @return the write end of the pipe, for the process
+         */
+        int openOutputPipe(int stream);
+        void closeOutputPipes(void);
+
+        void handleOutputAck(const PDU &pdu);
+
+        /**
+         * Wait briefly for streamed output, and send what there is, as
+         * far as the window allows.
+         */
+        void relayOutput(void);
+        void relayStream(int stream);
+
         /**
          * shellEscape()  scrubs the string intended for exec'ing to make sure it is safe.
          *
@@ -164,6 +182,27 @@ namespace Forte
         FString mInputFilename;
         FString mOutputFilename;
         FString mErrorFilename;
+
+        /**
+         * Streamed output: bytes of each stream which may be sent
+         * ahead of the ProcessManager, 0 if output goes to files.
+         */
+        size_t mOutputWindow;
+
+        struct OutputRelay
+        {
+            // read end of the process's pipe, -1 at end of stream
+            int fd;
+            // bytes which may be sent before the next acknowledgement
+            size_t credit;
+        };
+
+        /**
+         * Relays by ProcessOutputStreamCode. Credit is returned by
+         * the PDU threads.
+         */
+        Mutex mRelayLock;
+        OutputRelay mRelays[2];
     };
 };
 
@@ -0,0 +1,389 @@
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include "AutoFD.h"
+#include "Foreach.h"
+#include "FTrace.h"
+#include "PDU.h"
+#include "PDUPeerSetBuilderImpl.h"
+#include "ProcessWorker.h"
+#include "SystemCallUtil.h"
+
+extern char **environ;
+
+using namespace Forte;
+
+namespace
+{
+    // open one of the command's stdio files. the worker's own copy is
+    // close-on-exec; posix_spawn dups it into place for the command
+    int openStdioFile(const char *path, int flags)
+    {
+        int fd;
+        do
+        {
+            fd = open(path, flags | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        }
+        while (fd == -1 && errno == EINTR);
+        return fd;
+    }
+
+    // the peer set opens descriptors of its own, which a command must
+    // not inherit
+    void markCloseOnExec(void)
+    {
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir == NULL)
+            return;
+        const int dirFD = dirfd(dir);
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            const int fd = atoi(entry->d_name);
+            if (fd < 3 || fd == dirFD)
+                continue;
+            const int flags = fcntl(fd, F_GETFD);
+            if (flags != -1 && !(flags & FD_CLOEXEC))
+                fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+        }
+        closedir(dir);
+    }
+
+    void fillStatus(ProcessStatusPDU &status, int childStatus)
+    {
+        // the PDU is packed, so fill an aligned timeval and copy it in
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        memcpy(&status.timestamp, &now, sizeof(now));
+        if (WIFEXITED(childStatus))
+        {
+            status.type = ProcessStatusExited;
+            status.statusCode = WEXITSTATUS(childStatus);
+        }
+        else if (WIFSIGNALED(childStatus))
+        {
+            status.type = ProcessStatusKilled;
+            status.statusCode = WTERMSIG(childStatus);
+        }
+        else
+        {
+            status.type = ProcessStatusUnknownTermination;
+            status.statusCode = childStatus;
+        }
+    }
+}
+
+Forte::ProcessWorker::ProcessWorker(int argc, char *argv[]) :
+    mPeerSet(new PDUPeerSetBuilderImpl())
+{
+    FTRACE;
+    FString logFile;
+    FString logLevel;
+    try
+    {
+        mServiceConfig.ReadConfigFile("/etc/procmon.conf");
+        logFile = mServiceConfig.Get("logfile");
+        logLevel = mServiceConfig.Get("loglevel");
+    }
+    catch (EServiceConfig &e)
+    {
+        // failed to load config, use some defaults
+    }
+    if (logFile != "")
+    {
+        mLogManager.SetGlobalLogMask(
+            mLogManager.ComputeLogMaskFromString(logLevel));
+        mLogManager.BeginLogging(logFile);
+    }
+
+    if (argc != 3 || FString(argv[1]) != "-w")
+        throw EProcessMonitorArguments();
+    FString fdStr(argv[2]);
+    if (!fdStr.IsUnsignedNumeric())
+        throw EProcessMonitorArguments();
+    mFD = fdStr.AsUnsignedInteger();
+
+    char cwd[PATH_MAX];
+    mInitialCWD.assign(getcwd(cwd, sizeof(cwd)) != NULL ? cwd : "/");
+}
+
+Forte::ProcessWorker::~ProcessWorker()
+{
+    FTRACE;
+    mPeerSet->Shutdown();
+}
+
+void Forte::ProcessWorker::Run()
+{
+    FTRACE;
+
+    // SIGCHLD is taken with sigtimedwait() on this thread. it is
+    // blocked before the peer set starts its threads, so they inherit
+    // the mask and the signal stays pending for this thread. it must
+    // not be ignored, or the kernel would reap the commands itself
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+    pthread_sigmask(SIG_SETMASK, &chld, NULL);
+
+    mPeerSet->SetEventCallback(
+        boost::bind(WeakFunctionBinder(
+                        &ProcessWorker::pduCallback,
+                        boost::static_pointer_cast<Forte::ProcessWorker>(
+                            shared_from_this())),
+                    _1));
+    mPeerSet->Start();
+    mPeerSet->PeerCreate(mFD);
+
+    const struct timespec timeout = { 0, 100000000 };
+    while (mPeerSet->GetConnectedCount() > 0 || hasChildren())
+    {
+        // reap on every pass; one signal may stand for many children
+        sigtimedwait(&chld, NULL, &timeout);
+        reap();
+    }
+
+    mPeerSet->SetEventCallback(NULL);
+}
+
+void Forte::ProcessWorker::pduCallback(PDUPeerEventPtr event)
+{
+    FTRACE;
+    if (event->mEventType == PDUPeerReceivedPDUEvent)
+    {
+        PDU pdu;
+        while (event->mPeer->RecvPDU(pdu))
+        {
+            hlog(HLOG_DEBUG, "PDU opcode %d", pdu.GetOpcode());
+            switch (pdu.GetOpcode())
+            {
+            case ProcessOpSpawnReq:
+                handleSpawnReq(*(event->mPeer), pdu);
+                break;
+            case ProcessOpSpawnSignal:
+                handleSpawnSignal(pdu);
+                break;
+            default:
+                hlog(HLOG_ERR, "unexpected PDU with opcode %d", pdu.GetOpcode());
+                break;
+            }
+        }
+    }
+}
+
+void Forte::ProcessWorker::handleSpawnReq(PDUPeer &peer, const PDU &pdu)
+{
+    FTRACE;
+    const ProcessSpawnReqPDU *req = pdu.GetPayload<ProcessSpawnReqPDU>();
+
+    AutoUnlockMutex lock(mChildrenLock);
+    try
+    {
+        pid_t pid = spawn(*req);
+        mChildren[pid] = req->id;
+        mSpawnIDs[req->id] = pid;
+        sendSpawnRes(peer, req->id, ProcessSuccess, pid);
+    }
+    catch (EProcessMonitorUnableToOpenInputFile &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToOpenInputFile, -1, e.what());
+    }
+    catch (EProcessMonitorUnableToOpenOutputFile &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToOpenOutputFile, -1, e.what());
+    }
+    catch (EProcessMonitorUnableToOpenErrorFile &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToOpenErrorFile, -1, e.what());
+    }
+    catch (EProcessMonitorUnableToCWD &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToCWD, -1, e.what());
+    }
+    catch (EProcessMonitorUnableToFork &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToFork, -1, e.what());
+    }
+    catch (EProcessMonitorUnableToExec &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnableToExec, -1, e.what());
+    }
+    catch (EProcessMonitor &e)
+    {
+        sendSpawnRes(peer, req->id, ProcessUnknownError, -1, e.what());
+    }
+}
+
+void Forte::ProcessWorker::handleSpawnSignal(const PDU &pdu)
+{
+    FTRACE;
+    const ProcessSpawnSignalPDU *req = pdu.GetPayload<ProcessSpawnSignalPDU>();
+
+    AutoUnlockMutex lock(mChildrenLock);
+    std::map<uint64_t, pid_t>::iterator i = mSpawnIDs.find(req->id);
+    if (i == mSpawnIDs.end())
+    {
+        hlog(HLOG_DEBUG, "signal %d for finished spawn id %llu", req->signum,
+             static_cast<unsigned long long>(req->id));
+        return;
+    }
+    if (kill(i->second, req->signum) == -1)
+    {
+        hlog(HLOG_ERR, "unable to send signal %d to %d: %s", req->signum,
+             i->second, SystemCallUtil::GetErrorDescription(errno).c_str());
+    }
+}
+
+void Forte::ProcessWorker::sendSpawnRes(PDUPeer &peer, uint64_t id, int result,
+                                        pid_t pid, const char *desc)
+{
+    FTRACE;
+    PDUPtr p(new PDU(ProcessOpSpawnRes, sizeof(ProcessSpawnResPDU)));
+    ProcessSpawnResPDU *response = p->GetPayload<ProcessSpawnResPDU>();
+    response->id = id;
+    response->res.result = result;
+    response->res.processPID = pid;
+    response->res.monitorPID = getpid();
+    strncpy(response->res.error, desc, sizeof(response->res.error) - 1);
+    peer.EnqueuePDU(p);
+}
+
+pid_t Forte::ProcessWorker::spawn(const ProcessSpawnReqPDU &req)
+{
+    FTRACE;
+
+    // the manager terminates every string, but a worker must not
+    // trust that
+    const FString cmdline(req.cmdline, strnlen(req.cmdline, sizeof(req.cmdline)));
+    const FString cwd(req.cwd, strnlen(req.cwd, sizeof(req.cwd)));
+    const FString infile(req.infile, strnlen(req.infile, sizeof(req.infile)));
+    const FString outfile(req.outfile, strnlen(req.outfile, sizeof(req.outfile)));
+    const FString errfile(req.errfile, strnlen(req.errfile, sizeof(req.errfile)));
+    const FString cmdlineToLog(req.cmdlineToLog,
+                               strnlen(req.cmdlineToLog, sizeof(req.cmdlineToLog)));
+
+    AutoFD inputfd(openStdioFile(infile, O_RDWR));
+    if (inputfd == AutoFD::NONE)
+        throw EProcessMonitorUnableToOpenInputFile(
+            SystemCallUtil::GetErrorDescription(errno));
+    AutoFD outputfd(openStdioFile(outfile, O_WRONLY | O_CREAT | O_TRUNC));
+    if (outputfd == AutoFD::NONE)
+        throw EProcessMonitorUnableToOpenOutputFile(
+            SystemCallUtil::GetErrorDescription(errno));
+    AutoFD errorfd(openStdioFile(errfile, O_WRONLY | O_CREAT | O_TRUNC));
+    if (errorfd == AutoFD::NONE)
+        throw EProcessMonitorUnableToOpenErrorFile(
+            SystemCallUtil::GetErrorDescription(errno));
+
+    // posix_spawn has no portable chdir action. commands are only
+    // started on the peer set's callback thread, under mChildrenLock,
+    // so the worker's own directory can stand in for it
+    if (chdir(cwd.empty() ? mInitialCWD : cwd) != 0)
+    {
+        hlog(HLOG_CRIT, "Cannot change directory to: %s", cwd.c_str());
+        throw EProcessMonitorUnableToCWD(
+            SystemCallUtil::GetErrorDescription(errno));
+    }
+
+    markCloseOnExec();
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, inputfd, 0);
+    posix_spawn_file_actions_adddup2(&actions, outputfd, 1);
+    posix_spawn_file_actions_adddup2(&actions, errorfd, 2);
+
+    // the command gets a clear signal mask, default SIGCHLD and SIGPIPE
+    // handling, and a session of its own, as under ProcessMonitor
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t set;
+    sigemptyset(&set);
+    posix_spawnattr_setsigmask(&attr, &set);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &set);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+                             | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSID);
+
+    if (cmdlineToLog.empty())
+    {
+        hlog(HLOG_INFO, "running command: %s", cmdline.c_str());
+    }
+    else
+    {
+        hlog(HLOG_INFO, "running command: %s", cmdlineToLog.c_str());
+    }
+
+    const char *argv[] = { "/bin/bash", "-c", cmdline.c_str(), NULL };
+    pid_t pid;
+    int err = posix_spawn(&pid, argv[0], &actions, &attr,
+                          const_cast<char * const *>(argv), environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err == ENOENT || err == EACCES || err == ENOEXEC)
+    {
+        hlog(HLOG_ERR, "unable to exec the command");
+        throw EProcessMonitorUnableToExec(
+            SystemCallUtil::GetErrorDescription(err));
+    }
+    else if (err != 0)
+    {
+        throw EProcessMonitorUnableToFork(
+            SystemCallUtil::GetErrorDescription(err));
+    }
+    return pid;
+}
+
+void Forte::ProcessWorker::reap(void)
+{
+    std::vector<PDUPtr> statuses;
+    {
+        AutoUnlockMutex lock(mChildrenLock);
+        int childStatus;
+        pid_t pid;
+        while ((pid = waitpid(-1, &childStatus, WNOHANG)) > 0)
+        {
+            std::map<pid_t, uint64_t>::iterator i = mChildren.find(pid);
+            if (i == mChildren.end())
+            {
+                hlog(HLOG_ERR, "wait() returned a process id we don't know about (%u)",
+                     pid);
+                continue;
+            }
+
+            PDUPtr p(new PDU(ProcessOpSpawnStatus, sizeof(ProcessSpawnStatusPDU)));
+            ProcessSpawnStatusPDU *status = p->GetPayload<ProcessSpawnStatusPDU>();
+            status->id = i->second;
+            fillStatus(status->status, childStatus);
+            hlog(HLOG_DEBUG, "child %d finished (type %d code %d)", pid,
+                 status->status.type, status->status.statusCode);
+            statuses.push_back(p);
+
+            mSpawnIDs.erase(i->second);
+            mChildren.erase(i);
+        }
+    }
+
+    foreach (const PDUPtr &p, statuses)
+    {
+        mPeerSet->BroadcastAsync(p);
+    }
+}
+
+bool Forte::ProcessWorker::hasChildren(void)
+{
+    AutoUnlockMutex lock(mChildrenLock);
+    return !mChildren.empty();
+}
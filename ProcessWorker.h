@@ -0,0 +1,84 @@
+#ifndef _Forte_process_worker_h_
+#define _Forte_process_worker_h_
+
+#include "AutoMutex.h"
+#include "FString.h"
+#include "LogManager.h"
+#include "PDUPeerSetBuilder.h"
+#include "ProcessManagerPDU.h"
+#include "ProcessMonitor.h"
+#include "ServiceConfig.h"
+#include <map>
+#include <stdint.h>
+
+namespace Forte
+{
+    /**
+     * ProcessWorker is procmon run as a pooled worker, "procmon -w
+     * <fd>". Unlike ProcessMonitor, which watches one command and is
+     * started afresh for each, a worker stays up and runs any number
+     * of commands, many at once, for the ProcessManager at the other
+     * end of the socket. Commands are started with posix_spawn, which
+     * glibc implements with vfork semantics, so starting one copies no
+     * page tables and creates no thread. Every request and status PDU
+     * carries the spawn id the ProcessManager gave the command.
+     */
+    class ProcessWorker : public Forte::Object
+    {
+    public:
+        /**
+         * Command line usage:
+         *
+         * procmon -w <fd>
+         */
+        ProcessWorker(int argc, char *argv[]);
+        virtual ~ProcessWorker();
+
+        /**
+         * Run commands until the ProcessManager disconnects and every
+         * command has finished.
+         */
+        void Run(void);
+
+    private:
+        void pduCallback(PDUPeerEventPtr event);
+
+        void handleSpawnReq(PDUPeer &peer, const PDU &pdu);
+        void handleSpawnSignal(const PDU &pdu);
+        void sendSpawnRes(PDUPeer &peer, uint64_t id, int result,
+                          pid_t pid, const char *desc = "");
+
+        /**
+         * Start the command, with mChildrenLock held.
+         *
+         * @return the process ID of the command
+         */
+        pid_t spawn(const ProcessSpawnReqPDU &req);
+
+        /**
+         * Collect every finished command and report its status.
+         */
+        void reap(void);
+
+        bool hasChildren(void);
+
+        Forte::LogManager mLogManager;
+        Forte::ServiceConfig mServiceConfig;
+
+        int mFD;
+        FString mInitialCWD;
+        PDUPeerSetBuilderPtr mPeerSet;
+
+        /**
+         * Running commands, by process ID and by spawn id. Held while
+         * a command is started and its response queued, so reap()
+         * never sees a process ID it does not know, and the status of
+         * a command always follows its response.
+         */
+        Mutex mChildrenLock;
+        std::map<pid_t, uint64_t> mChildren;
+        std::map<uint64_t, pid_t> mSpawnIDs;
+    };
+};
+
+#endif
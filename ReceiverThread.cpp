@@ -1,4 +1,5 @@
 #include "AutoFD.h"
+#include "Foreach.h"
 #include "LogManager.h"
 #include "ReceiverThread.h"
 #include "SystemCallUtil.h"
@@ -8,11 +9,17 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <linux/sock_diag.h>
 #include <boost/make_shared.hpp>
 
 #define EPOLLTIMEOUT 500
 
+#ifndef SO_MEMINFO
+#define SO_MEMINFO 55
+#endif
+
 using namespace Forte;
 
 #pragma GCC diagnostic ignored "-Wold-style-cast"
@@ -23,28 +30,9 @@ void * Forte::ReceiverThread::run(void)
     // init thread name
     mThreadName.Format("%s-recv", mName.c_str());
 
-    // create socket
-    AutoFD m(createInetStreamSocket());
-    setReuseAddr(m);
-    bindToAddress(m, SocketAddress(mBindIP, mPort));
-
-    if (listen(m, mBacklog) == -1)
-        throw EReceiverThread(
-            FStringFC(), "failed to listen: %s",
-            SystemCallUtil::GetErrorDescription(errno).c_str());
-
-    // set socket to close-on-exec, which prevents a bug wherein a
-    // child process that restarts this server will still have this
-    // socket open, which prevents us from binding those addresses
-    // until the child exits, thus causing the restart to fail.
-
-    // NOTE added 8/19/2009 PAW: the aforementioned bug is actually
-    // what's supposed to happen.  This would actually be a bug in the
-    // proc-runner, or whatever is doing the exec().  The correct
-    // behavior is to close all file descriptors in the forked child
-    // process *before* you do the exec.  We'll leave this in anyway:
-    int flags = fcntl(m, F_GETFD);
-    fcntl(m, F_SETFD, static_cast<long>(flags | FD_CLOEXEC));
+    // a ReusePort receiver is listening from its constructor
+    if (!mReusePort)
+        mListener = listenSocket();
 
     struct epoll_event ev;
     ev.events = EPOLLIN;
@@ -54,9 +42,16 @@ void * Forte::ReceiverThread::run(void)
     if (efd == -1)
         throw EReceiverThreadPollCreate(SystemCallUtil::GetErrorDescription(errno));
 
-    if (epoll_ctl(efd, EPOLL_CTL_ADD, m, &ev) < 0)
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, mListener, &ev) < 0)
         throw EReceiverThreadPollAdd(SystemCallUtil::GetErrorDescription(errno));
 
+    if (mReusePort)
+    {
+        acceptBatches(efd);
+        mListener.Close();
+        return NULL;
+    }
+
     while (!Thread::IsShuttingDown())
     {
         struct sockaddr_in in_addr;
@@ -88,7 +83,7 @@ void * Forte::ReceiverThread::run(void)
 
         if (events[0].events & EPOLLIN)
         {
-            s = accept(m, reinterpret_cast<struct sockaddr *>(&in_addr), &len);
+            s = accept(mListener, reinterpret_cast<struct sockaddr *>(&in_addr), &len);
         }
         else
         {
@@ -115,5 +110,273 @@ void * Forte::ReceiverThread::run(void)
 
         mDisp->Enqueue(e);
     }
+    mListener.Close();
     return NULL;
 }
+
+int Forte::ReceiverThread::listenSocket(void)
+{
+    // create socket
+    AutoFD m(createInetStreamSocket());
+    setReuseAddr(m);
+    if (mReusePort)
+    {
+        setReusePort(m);
+        // accept4() drains the queue until it would block
+        setSocketNonBlocking(m);
+    }
+    bindToAddress(m, SocketAddress(mBindIP, mPort));
+
+    if (listen(m, mBacklog) == -1)
+        throw EReceiverThread(
+            FStringFC(), "failed to listen: %s",
+            SystemCallUtil::GetErrorDescription(errno).c_str());
+
+    // set socket to close-on-exec, which prevents a bug wherein a
+    // child process that restarts this server will still have this
+    // socket open, which prevents us from binding those addresses
+    // until the child exits, thus causing the restart to fail.
+
+    // NOTE added 8/19/2009 PAW: the aforementioned bug is actually
+    // what's supposed to happen.  This would actually be a bug in the
+    // proc-runner, or whatever is doing the exec().  The correct
+    // behavior is to close all file descriptors in the forked child
+    // process *before* you do the exec.  We'll leave this in anyway:
+    int flags = fcntl(m, F_GETFD);
+    fcntl(m, F_SETFD, static_cast<long>(flags | FD_CLOEXEC));
+
+    if (mPort == 0)
+    {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (getsockname(m, reinterpret_cast<struct sockaddr *>(&addr), &len) == 0)
+            mPort = ntohs(addr.sin_port);
+    }
+
+    return m.Release();
+}
+
+// accepts until the queue is empty, handing the connections to the
+// dispatcher every mMaxBatch
+void Forte::ReceiverThread::acceptBatches(int efd)
+{
+    std::list<boost::shared_ptr<Event> > batch;
+
+    while (!Thread::IsShuttingDown())
+    {
+        struct epoll_event events[1];
+
+        int epollResult = epoll_wait(efd, events, 1, EPOLLTIMEOUT);
+
+        if (epollResult == 0
+            || (epollResult == -1 && errno == EINTR))
+        {
+            //timeout with no events or interrupted
+            sampleQueue();
+            continue;
+        }
+        else if (epollResult == -1)
+        {
+            hlog_and_throw(HLOG_DEBUG,
+                           EReceiverThreadPollFailed(
+                               SystemCallUtil::GetErrorDescription(errno)));
+        }
+
+        if (Thread::IsShuttingDown())
+        {
+            break;
+        }
+
+        if (!(events[0].events & EPOLLIN))
+        {
+            // EPOLLERR or EPOLLHUP
+            if (hlog_ratelimit(3600))
+                hlog(HLOG_ERR,
+                     "epoll_wait returned error event %d", events[0].events);
+            continue;
+        }
+
+        acceptBatch(batch);
+        sampleQueue();
+    }
+}
+
+void Forte::ReceiverThread::acceptBatch(
+    std::list<boost::shared_ptr<Event> > &batch)
+{
+    struct timeval now;
+    bool haveTime = false;
+    uint64_t errors = 0;
+
+    while (!Thread::IsShuttingDown())
+    {
+        int s = accept4(mListener, NULL, NULL, mAcceptFlags);
+        if (s == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // out of descriptors or memory; what is left stays
+                // queued until the next wakeup
+                ++errors;
+                if (hlog_ratelimit(60))
+                    hlog(HLOG_ERR, "accept failed: %s",
+                         SystemCallUtil::GetErrorDescription(errno).c_str());
+            }
+            break;
+        }
+
+        // one timestamp for everything accepted in the same pass
+        if (!haveTime)
+        {
+            gettimeofday(&now, NULL);
+            haveTime = true;
+        }
+
+        boost::shared_ptr<RequestEvent> e = boost::make_shared<RequestEvent>();
+        e->mFD = s;
+        e->mTime = now;
+        // TODO: store client IP address in mClient
+        batch.push_back(e);
+
+        if (batch.size() >= static_cast<size_t>(mMaxBatch))
+        {
+            dispatchBatch(batch);
+            haveTime = false;
+        }
+    }
+
+    dispatchBatch(batch);
+
+    if (errors > 0)
+    {
+        AutoUnlockMutex lock(mStatsLock);
+        mStats.mAcceptErrors += errors;
+    }
+}
+
+void Forte::ReceiverThread::dispatchBatch(
+    std::list<boost::shared_ptr<Event> > &batch)
+{
+    if (batch.empty())
+        return;
+
+    const size_t count = batch.size();
+    size_t failed = 0;
+    try
+    {
+        mDisp->EnqueueBatch(batch);
+    }
+    catch (Exception &e)
+    {
+        // what is left in batch the dispatcher did not take, so nobody
+        // else will close them
+        failed = batch.size();
+        hlog(HLOG_ERR, "could not dispatch %u connections: %s",
+             static_cast<unsigned int>(failed), e.what());
+        foreach (const boost::shared_ptr<Event> &event, batch)
+            close(boost::static_pointer_cast<RequestEvent>(event)->mFD);
+    }
+    batch.clear();
+
+    AutoUnlockMutex lock(mStatsLock);
+    mStats.mAccepted += count;
+    ++mStats.mBatches;
+    mStats.mDispatchFailures += failed;
+}
+
+void Forte::ReceiverThread::sampleQueue(void)
+{
+    // for a listening socket, the current and maximum length of its
+    // accept queue
+    struct tcp_info info;
+    socklen_t infoLen = sizeof(info);
+    const bool haveInfo =
+        (getsockopt(mListener, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0);
+
+    // counts connections dropped because that queue was full
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t meminfoLen = sizeof(meminfo);
+    const bool haveMeminfo =
+        (getsockopt(mListener, SOL_SOCKET, SO_MEMINFO,
+                    meminfo, &meminfoLen) == 0
+         && meminfoLen > SK_MEMINFO_DROPS * sizeof(uint32_t));
+
+    AutoUnlockMutex lock(mStatsLock);
+    if (haveInfo)
+    {
+        mStats.mQueued = info.tcpi_unacked;
+        mStats.mQueueLimit = info.tcpi_sacked;
+    }
+    if (haveMeminfo)
+    {
+        if (meminfo[SK_MEMINFO_DROPS] > mStats.mOverflows
+            && hlog_ratelimit(60))
+            hlog(HLOG_WARN, "%s accept queue overflowed, %u connections "
+                 "dropped so far", mName.c_str(), meminfo[SK_MEMINFO_DROPS]);
+        mStats.mOverflows = meminfo[SK_MEMINFO_DROPS];
+    }
+}
+
+Forte::ReceiverThreadGroup::ReceiverThreadGroup(
+    boost::shared_ptr<Dispatcher> disp,
+    const char *name,
+    int port,
+    int backlog,
+    int threads,
+    const char *bindIP,
+    int maxBatch,
+    int acceptFlags)
+    : mPort(port)
+{
+    if (threads < 1)
+        throw EReceiverThreadCountInvalid();
+
+    for (int i = 0; i < threads; ++i)
+    {
+        mThreads.push_back(
+            boost::shared_ptr<ReceiverThread>(
+                new ReceiverThread(
+                    ReceiverThread::ReusePort(),
+                    disp,
+                    FString(FStringFC(), "%s%d", name, i),
+                    mPort,
+                    backlog,
+                    bindIP,
+                    maxBatch,
+                    acceptFlags)));
+        mPort = mThreads.back()->GetPort();
+    }
+}
+
+Forte::ReceiverThreadGroup::~ReceiverThreadGroup()
+{
+    Shutdown();
+}
+
+void Forte::ReceiverThreadGroup::Shutdown(void)
+{
+    // all at once, rather than waiting out each one's poll in turn
+    foreach (const boost::shared_ptr<ReceiverThread> &thread, mThreads)
+        thread->Shutdown();
+    foreach (const boost::shared_ptr<ReceiverThread> &thread, mThreads)
+        thread->WaitForShutdown();
+}
+
+void Forte::ReceiverThreadGroup::GetStats(ReceiverThread::Stats &stats) const
+{
+    stats = ReceiverThread::Stats();
+    foreach (const boost::shared_ptr<ReceiverThread> &thread, mThreads)
+    {
+        ReceiverThread::Stats s;
+        thread->GetStats(s);
+        stats.mAccepted += s.mAccepted;
+        stats.mBatches += s.mBatches;
+        stats.mAcceptErrors += s.mAcceptErrors;
+        stats.mDispatchFailures += s.mDispatchFailures;
+        stats.mQueued += s.mQueued;
+        stats.mQueueLimit += s.mQueueLimit;
+        stats.mOverflows += s.mOverflows;
+    }
+}
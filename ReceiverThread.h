@@ -1,10 +1,14 @@
 #ifndef __ReceiverThread_h
 #define __ReceiverThread_h
 
+#include "AutoFD.h"
+#include "AutoMutex.h"
 #include "Dispatcher.h"
 #include "Exception.h"
 #include "Event.h"
 #include "FString.h"
+#include <sys/socket.h>
+#include <vector>
 
 namespace Forte
 {
@@ -27,10 +31,66 @@ namespace Forte
 
     EXCEPTION_SUBCLASS(EReceiverThread, EReceiverThreadPollFailed);
 
+    EXCEPTION_SUBCLASS2(EReceiverThread,
+                        EReceiverThreadCountInvalid,
+                        "Invalid number of receiver threads");
+
+    EXCEPTION_SUBCLASS2(EReceiverThread,
+                        EReceiverThreadBatchInvalid,
+                        "Invalid accept batch size");
+
+    /**
+     * ReceiverThread listens on a port and hands each connection it
+     * accepts to a Dispatcher as a RequestEvent.
+     *
+     * By default it accepts one connection each time its socket is
+     * readable. A ReusePort receiver instead binds with SO_REUSEPORT, so
+     * that several of them can share a port and the kernel spreads the
+     * connections across them (see ReceiverThreadGroup). Each wakeup
+     * drains the accept queue with accept4(), and the connections are
+     * handed to Dispatcher::EnqueueBatch() up to maxBatch at a time. Its
+     * socket is listening by the time the constructor returns.
+     */
     class ReceiverThread : public Thread
     {
     public:
         class NoAutoStart {};
+        class ReusePort {};
+
+        /**
+         * Counters kept by a ReusePort receiver. The accept queue
+         * figures are sampled from the listening socket after each batch
+         * and each idle poll.
+         */
+        struct Stats
+        {
+            Stats() :
+                mAccepted(0),
+                mBatches(0),
+                mAcceptErrors(0),
+                mDispatchFailures(0),
+                mQueued(0),
+                mQueueLimit(0),
+                mOverflows(0)
+                {
+                }
+
+            /// connections accepted
+            uint64_t mAccepted;
+            /// batches handed to the dispatcher
+            uint64_t mBatches;
+            /// accept4() failures, such as running out of descriptors
+            uint64_t mAcceptErrors;
+            /// connections closed because the dispatcher refused them
+            uint64_t mDispatchFailures;
+            /// connections waiting in the accept queue
+            uint32_t mQueued;
+            /// the length of the accept queue
+            uint32_t mQueueLimit;
+            /// connections the kernel dropped since the socket was
+            /// created, because the accept queue was full
+            uint32_t mOverflows;
+        };
 
         inline ReceiverThread(
             boost::shared_ptr<Dispatcher> disp,
@@ -42,7 +102,10 @@ namespace Forte
                mName(name),
                mPort(port),
                mBacklog(backlog),
-               mBindIP(bindIP)
+               mBindIP(bindIP),
+               mReusePort(false),
+               mMaxBatch(1),
+               mAcceptFlags(0)
             {
                 if (!disp)
                     throw EReceiverDispatcherInvalid();
@@ -65,13 +128,52 @@ namespace Forte
                mName(name),
                mPort(port),
                mBacklog(backlog),
-               mBindIP(bindIP)
+               mBindIP(bindIP),
+               mReusePort(false),
+               mMaxBatch(1),
+               mAcceptFlags(0)
+            {
+                if (!disp)
+                    throw EReceiverDispatcherInvalid();
+
+                if (mName.empty())
+                    throw Exception("receiver must be given a valid name");
+            }
+
+        /**
+         * Creates a ReusePort receiver. acceptFlags is passed to
+         * accept4() for each connection; add SOCK_NONBLOCK if the request
+         * handler expects non-blocking descriptors.
+         */
+        inline ReceiverThread(
+            ReusePort unused,
+            boost::shared_ptr<Dispatcher> disp,
+            const char *name,
+            int port,
+            int backlog,
+            const char *bindIP = "",
+            int maxBatch = 64,
+            int acceptFlags = SOCK_CLOEXEC)
+            :  mDisp(disp),
+               mName(name),
+               mPort(port),
+               mBacklog(backlog),
+               mBindIP(bindIP),
+               mReusePort(true),
+               mMaxBatch(maxBatch),
+               mAcceptFlags(acceptFlags)
             {
                 if (!disp)
                     throw EReceiverDispatcherInvalid();
 
                 if (mName.empty())
                     throw Exception("receiver must be given a valid name");
+
+                if (mMaxBatch < 1)
+                    throw EReceiverThreadBatchInvalid();
+
+                mListener = listenSocket();
+                initialized();
             }
 
         void StartThread() {
@@ -83,14 +185,80 @@ namespace Forte
             deleting();
         }
 
+        /**
+         * The port a ReusePort receiver is listening on. This is the
+         * port the kernel picked if it was created with port 0.
+         */
+        int GetPort() const { return mPort; }
+
+        void GetStats(Stats &stats) const {
+            AutoUnlockMutex lock(mStatsLock);
+            stats = mStats;
+        }
+
     protected:
         virtual void * run();
 
+        int listenSocket();
+        void acceptBatches(int efd);
+        void acceptBatch(std::list<boost::shared_ptr<Event> > &batch);
+        void dispatchBatch(std::list<boost::shared_ptr<Event> > &batch);
+        void sampleQueue();
+
         boost::shared_ptr<Dispatcher> mDisp;
         FString mName;
         int mPort;
         int mBacklog;
         FString mBindIP;
+
+        const bool mReusePort;
+        const int mMaxBatch;
+        const int mAcceptFlags;
+        AutoFD mListener;
+
+        mutable Mutex mStatsLock;
+        Stats mStats;
+    };
+
+    /**
+     * ReceiverThreadGroup runs several ReusePort receivers on one port,
+     * each with its own socket and thread, so that accepting is not
+     * limited to one thread during a burst of connections.
+     */
+    class ReceiverThreadGroup : public Object
+    {
+    public:
+        /**
+         * Starts threads receivers. If port is 0 the kernel picks the
+         * port for the first one and the rest share it.
+         */
+        ReceiverThreadGroup(
+            boost::shared_ptr<Dispatcher> disp,
+            const char *name,
+            int port,
+            int backlog,
+            int threads,
+            const char *bindIP = "",
+            int maxBatch = 64,
+            int acceptFlags = SOCK_CLOEXEC);
+        virtual ~ReceiverThreadGroup();
+
+        /**
+         * Stops every receiver, and waits for them to exit.
+         */
+        void Shutdown();
+
+        int GetPort() const { return mPort; }
+        size_t GetThreadCount() const { return mThreads.size(); }
+
+        /**
+         * Sums the counters of every receiver.
+         */
+        void GetStats(ReceiverThread::Stats &stats) const;
+
+    protected:
+        int mPort;
+        std::vector<boost::shared_ptr<ReceiverThread> > mThreads;
     };
 };
 #endif
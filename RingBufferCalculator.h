@@ -5,6 +5,8 @@
 #include <sys/types.h>
 #include <string.h>
 #include <boost/shared_array.hpp>
+#include <algorithm>
+#include <deque>
 #include "Exception.h"
 
 // This ring buffer calculator is tightly coupled with
@@ -62,17 +64,36 @@ EXCEPTION_CLASS(ERingBufferCalculator);
 #define RING_BUFFER_ASSERT(ASSERTION__, REASON__)                       \
     if (! (ASSERTION__) )                                               \
     {                                                                   \
-        hlogstream(HLOG_ERR, "Attempt to write to full buffer "         \
+        hlogstream(HLOG_ERR, REASON__                                   \
                    << " size:" << mSize                                 \
                    << " writeCursor:" << mWriteCursor                   \
                    << " readCursor:" << mReadCursor                     \
-                   << " full:" << mFull                                 \
+                   << " readLength:" << mReadLength                     \
+                   << " pinnedLength:" << mPinnedLength                 \
                    << " readEpic:" << mReadEpic                         \
                    << " writeEpic:" << mWriteEpic);                     \
-        throw ERingBufferCalculator("Attempt to write to full buffer"); \
+        throw ERingBufferCalculator(REASON__);                          \
                                                                         \
     }
 
+// pinned regions
+//
+// a read can be recorded with PinRead instead of RecordRead. the
+// bytes are consumed from the readable region as usual, but they stay
+// off limits to writers until ReleasePin is called with the returned
+// id. this lets a consumer hold a pointer into the buffer rather than
+// copying the object out. pins are released in any order, but space
+// is only handed back to writers from the oldest pinned byte forward,
+// so one long lived pin holds back everything read after it:
+//
+// P = pinned, r = read but behind a pin, HHp = readable
+//
+// read cursor = 5, pinned = 5, write cursor = 8, write size = 3
+// PPPrrHHp...
+//
+// Reset drops every pin. ids are never reused, so releasing a pin
+// that was dropped by a Reset is harmless and returns false.
+
 class RingBufferCalculator
 {
 public:
@@ -83,7 +104,9 @@ public:
           mSize(bufferSize),
           mWriteCursor(0),
           mReadCursor(0),
-          mFull(false),
+          mReadLength(0),
+          mPinnedLength(0),
+          mFirstPinID(0),
           mReadEpic(0),
           mWriteEpic(0)
         {}
@@ -94,24 +117,49 @@ public:
         mSize = bufferSize;
         mWriteCursor = 0;
         mReadCursor = 0;
-        mFull = false;
+        mReadLength = 0;
+        mPinnedLength = 0;
+        mFirstPinID += mPins.size();
+        mPins.clear();
         mReadEpic = 0;
         mWriteEpic = 0;
     }
 
+    // copies the readable bytes to the start of bufferAddress and
+    // resets onto it. like Reset, every pin is dropped, so the pinned
+    // bytes must stay valid in the old buffer. the readable region may
+    // be empty when everything in a full buffer is pinned
+    void Move(char* bufferAddress,
+              size_t bufferSize) {
+        const size_t readLength = mReadLength;
+        RING_BUFFER_ASSERT(readLength <= bufferSize,
+                           "Attempt to move into a smaller buffer");
+        if (readLength > 0)
+        {
+            ObjectCopy(bufferAddress, readLength);
+        }
+        Reset(bufferAddress, bufferSize);
+        if (readLength > 0)
+        {
+            RecordWrite(readLength);
+        }
+    }
+
     char* GetWriteLocation() const {
-        RING_BUFFER_ASSERT(!mFull, "Attempt to write to full buffer");
+        RING_BUFFER_ASSERT(!Full(), "Attempt to write to full buffer");
         return mBufferAddress + mWriteCursor;
     }
 
     //TODO: in the std library, empty() is generally the cheaper
     //option, so switch the internal semantic.
     bool Empty() const {
-        return !mFull && mWriteCursor == mReadCursor;
+        return mReadLength == 0;
     }
 
+    // no space left to write, either because the data has not been
+    // read yet or because it is still pinned
     bool Full() const {
-        return mFull;
+        return mReadLength + mPinnedLength == mSize;
     }
 
     const char* GetReadLocation() const {
@@ -120,49 +168,34 @@ public:
     }
 
     size_t GetWriteLength() const {
-        if (mFull)
+        if (Full())
         {
             return 0;
         }
-        else if (mWriteCursor >= mReadCursor)
+
+        // writers may only advance as far as the oldest pinned byte
+        size_t releaseCursor = getReleaseCursor();
+        if (mWriteCursor >= releaseCursor)
         {
             return mSize - mWriteCursor;
         }
         else
         {
-            return mReadCursor - mWriteCursor;
+            return releaseCursor - mWriteCursor;
         }
     }
 
     size_t GetReadLength() const {
-        if (mFull)
-        {
-            return mSize;
-        }
-        else if (mWriteCursor >= mReadCursor)
-        {
-            return mWriteCursor - mReadCursor;
-        }
-        else
-        {
-            return (mSize - mReadCursor) + mWriteCursor;
-        }
+        return mReadLength;
     }
 
     size_t GetReadLengthNoWrap() const {
-        if (Empty())
-        {
-            return 0;
-        }
-        else if (mReadCursor >= mWriteCursor)
-        {
-            // here to end of buffer
-            return mSize - mReadCursor;
-        }
-        else
-        {
-            return mWriteCursor - mReadCursor;
-        }
+        // here to end of buffer at most
+        return std::min(mReadLength, mSize - mReadCursor);
+    }
+
+    size_t GetPinnedLength() const {
+        return mPinnedLength;
     }
 
     void RecordWrite(size_t len) {
@@ -180,48 +213,136 @@ public:
             mWriteCursor = 0;
             ++mWriteEpic;
         }
-        if (mReadCursor == mWriteCursor)
+        mReadLength += len;
+    }
+
+    void RecordRead(size_t len) {
+        advanceReadCursor(len);
+
+        if (!mPins.empty())
         {
-            mFull = true;
+            // consumed, but cannot be written over until the pins in
+            // front of it are released
+            if (mPins.back().mReleased)
+            {
+                mPins.back().mLength += len;
+            }
+            else
+            {
+                mPins.push_back(Pin(len, true));
+            }
+            mPinnedLength += len;
         }
     }
 
-    void RecordRead(size_t len) {
-        RING_BUFFER_ASSERT(len > 0, "Attempt to read 0");
-        RING_BUFFER_ASSERT(len <= GetReadLength(),
-                           "Attempt to read more than is available");
+    // records a read of len bytes that remain valid at their current
+    // location until ReleasePin is called with the returned id
+    uint64_t PinRead(size_t len) {
+        advanceReadCursor(len);
 
-        mReadCursor += len;
-        if (mReadCursor >= mSize)
+        mPins.push_back(Pin(len, false));
+        mPinnedLength += len;
+        return mFirstPinID + mPins.size() - 1;
+    }
+
+    // returns false if the pin was dropped by a Reset
+    bool ReleasePin(uint64_t pinID) {
+        if (pinID < mFirstPinID)
         {
-            mReadCursor -= mSize;
-            ++mReadEpic;
+            return false;
+        }
+        RING_BUFFER_ASSERT(pinID - mFirstPinID < mPins.size(),
+                           "Attempt to release unknown pin");
+
+        mPins[pinID - mFirstPinID].mReleased = true;
+        while (!mPins.empty() && mPins.front().mReleased)
+        {
+            mPinnedLength -= mPins.front().mLength;
+            mPins.pop_front();
+            ++mFirstPinID;
         }
-        mFull = false;
+        return true;
     }
 
     bool ObjectWillWrap(size_t objectLength) const {
-        return mReadCursor + objectLength > mSize;
+        return ObjectWillWrap(0, objectLength);
+    }
+
+    // offset variants look ahead of the read cursor without recording
+    // a read
+    bool ObjectWillWrap(size_t offset, size_t objectLength) const {
+        return getReadCursor(offset) + objectLength > mSize;
+    }
+
+    const char* GetReadLocation(size_t offset) const {
+        RING_BUFFER_ASSERT(offset < mReadLength,
+                           "Attempt to read past end of readable data");
+        return mBufferAddress + getReadCursor(offset);
     }
 
     void ObjectCopy(char* object, size_t objectLength) const {
-        RING_BUFFER_ASSERT(objectLength <= GetReadLength(),
+        ObjectCopy(0, object, objectLength);
+    }
+
+    void ObjectCopy(size_t offset,
+                    char* object,
+                    size_t objectLength) const {
+        RING_BUFFER_ASSERT(offset + objectLength <= GetReadLength(),
                            "Attempt to read object greater than buffer size");
 
-        if (ObjectWillWrap(objectLength))
+        const size_t cursor = getReadCursor(offset);
+        if (ObjectWillWrap(offset, objectLength))
         {
+            const size_t noWrapLength = mSize - cursor;
             memcpy(object,
-                   GetReadLocation(),
-                   GetReadLengthNoWrap());
+                   mBufferAddress + cursor,
+                   noWrapLength);
 
-            memcpy(object + GetReadLengthNoWrap(),
+            memcpy(object + noWrapLength,
                    mBufferAddress,
-                   objectLength - GetReadLengthNoWrap());
+                   objectLength - noWrapLength);
         }
         else
         {
-            memcpy(object, GetReadLocation(), objectLength);
+            memcpy(object, mBufferAddress + cursor, objectLength);
+        }
+    }
+
+private:
+    struct Pin
+    {
+        Pin(size_t length, bool released)
+            : mLength(length),
+              mReleased(released)
+            {}
+
+        size_t mLength;
+        bool mReleased;
+    };
+
+    size_t getReadCursor(size_t offset) const {
+        size_t cursor = mReadCursor + offset;
+        return (cursor >= mSize ? cursor - mSize : cursor);
+    }
+
+    size_t getReleaseCursor() const {
+        return (mReadCursor >= mPinnedLength
+                ? mReadCursor - mPinnedLength
+                : mReadCursor + mSize - mPinnedLength);
+    }
+
+    void advanceReadCursor(size_t len) {
+        RING_BUFFER_ASSERT(len > 0, "Attempt to read 0");
+        RING_BUFFER_ASSERT(len <= GetReadLength(),
+                           "Attempt to read more than is available");
+
+        mReadCursor += len;
+        if (mReadCursor >= mSize)
+        {
+            mReadCursor -= mSize;
+            ++mReadEpic;
         }
+        mReadLength -= len;
     }
 
 private:
@@ -229,7 +350,10 @@ private:
     size_t mSize;
     size_t mWriteCursor;
     size_t mReadCursor;
-    bool mFull;
+    size_t mReadLength;
+    size_t mPinnedLength;
+    std::deque<Pin> mPins;
+    uint64_t mFirstPinID;
     int64_t mReadEpic;
     int64_t mWriteEpic;
 };
@@ -1,4 +1,6 @@
 #include "RunLoop.h"
+#include "Dispatcher.h"
+#include "Foreach.h"
 #include "LogManager.h"
 #include "FTrace.h"
 
@@ -11,6 +13,17 @@ Forte::RunLoop::RunLoop(const Forte::FString &name) :
     initialized();
 }
 
+Forte::RunLoop::RunLoop(const Forte::FString &name,
+                        const Forte::Timespec &tick,
+                        const boost::shared_ptr<Dispatcher> &dispatcher) :
+        mName(name),
+        mWheel(new TimerWheel(tick, MonotonicClock().GetTime())),
+        mDispatcher(dispatcher)
+{
+    FTRACE;
+    initialized();
+}
+
 Forte::RunLoop::~RunLoop()
 {
     FTRACE;
@@ -26,6 +39,17 @@ void Forte::RunLoop::AddTimer(const boost::shared_ptr<Timer> &timer)
 
     // schedule it
     MonotonicClock mc;
+    if (mWheel)
+    {
+        const Timespec now(mc.GetTime());
+        const Timespec absolute(now + timer->GetInterval());
+        mWheel->Add(timer, absolute, now);
+        // the runloop thread only needs waking if it would sleep past it
+        if (!mWakeTime.IsZero() && absolute < mWakeTime)
+            Notify();
+        return;
+    }
+
     mSchedule.insert(RunLoopScheduleItem(timer, mc.GetTime() + timer->GetInterval()));
     hlog(HLOG_DEBUG, "scheduled timer (now=%ld interval=%ld.%llu)",
          mc.GetTime().AsSeconds(), timer->GetInterval().AsSeconds(),
@@ -37,6 +61,8 @@ void Forte::RunLoop::AddTimer(const boost::shared_ptr<Timer> &timer)
 bool Forte::RunLoop::IsEmpty() const
 {
     AutoUnlockMutex lock(mLock);
+    if (mWheel)
+        return mWheel->IsEmpty();
     return (mSchedule.begin() == mSchedule.end());
 }
 
@@ -44,6 +70,9 @@ void * Forte::RunLoop::run(void)
 {
     mThreadName.Format("rl-%s", mName.c_str());
     hlog(HLOG_DEBUG, "runloop starting");
+    if (mWheel)
+        return runWheel();
+
     MonotonicClock mc;
     std::multiset<RunLoopScheduleItem>::iterator i;
     AutoUnlockMutex lock(mLock);
@@ -151,3 +180,141 @@ void * Forte::RunLoop::run(void)
 
     return NULL;
 }
+
+void * Forte::RunLoop::runWheel(void)
+{
+    MonotonicClock mc;
+    AutoUnlockMutex lock(mLock);
+    bool warned = false;
+    while (!IsShuttingDown())
+    {
+        mWakeTime = Timespec();
+        Timespec now = mc.GetTime();
+        mExpired.clear();
+        if (mWheel->Expire(now, mExpired) == 0)
+        {
+            if (!mWheel->GetNextExpiry(mWakeTime))
+                mWakeTime = now + Timespec::FromSeconds(60);
+            Timespec waitInterval = mWakeTime - now;
+            if (waitInterval.IsPositive())
+            {
+                // sleep in an unlocked scope
+                AutoLockMutex unlock(mLock);
+                interruptibleSleep(waitInterval);
+            }
+            continue;
+        }
+
+        // the worst latency in the batch
+        Timespec latency;
+        size_t worst = 0;
+        for (size_t i = 0; i < mExpired.size(); ++i)
+        {
+            Timespec fireLatency = now - mExpired[i].mAbsolute;
+            Timespec schedLatency = now - mExpired[i].mScheduledTime;
+            if (schedLatency < fireLatency)
+                fireLatency = schedLatency;
+            if (latency < fireLatency)
+            {
+                latency = fireLatency;
+                worst = i;
+            }
+        }
+
+        if (latency.AsMillisec() > 100)
+        {
+            if (!warned)
+            {
+                if (hlog_ratelimit(86400))
+                {
+                    hlogstream(HLOG_WARN, "run loop has high latency of (" <<
+                               latency.AsMillisec() << "ms) prior to timer '" <<
+                               mExpired[worst].mTimer->GetName() << "'");
+                }
+                warned = true;
+            }
+        }
+        else if (warned)
+        {
+            warned = false;
+            if (hlog_ratelimit(86400))
+            {
+                hlogstream(HLOG_WARN, "run loop has caught up for '" <<
+                           mName << "'");
+            }
+        }
+
+        // fire the batch in an unlocked scope
+        {
+            AutoLockMutex unlock(mLock);
+            foreach (const TimerWheel::Expired &expired, mExpired)
+                fire(expired.mTimer);
+        }
+
+        foreach (const TimerWheel::Expired &expired, mExpired)
+        {
+            const boost::shared_ptr<Timer> &timer(expired.mTimer);
+            if (!timer->Repeats())
+                continue;
+
+            Timespec next;
+            // If our latency is so high that the next firing time
+            // would be in the past, just compute the next time
+            // from now.
+            if (timer->GetInterval() < latency)
+                next = now + timer->GetInterval();
+            else
+                next = expired.mAbsolute + timer->GetInterval();
+            mWheel->Add(timer, next, now);
+        }
+    }
+
+    mExpired.clear();
+    return NULL;
+}
+
+void Forte::RunLoop::fire(const boost::shared_ptr<Timer> &timer)
+{
+    if (mDispatcher)
+    {
+        try
+        {
+            mDispatcher->Enqueue(
+                boost::shared_ptr<Event>(new TimerEvent(timer)));
+            return;
+        }
+        catch (std::exception &e)
+        {
+            hlog(HLOG_WARN, "could not dispatch timer '%s', firing it "
+                 "here: %s", timer->GetName().c_str(), e.what());
+        }
+    }
+
+    try
+    {
+        timer->Fire();
+    }
+    catch (std::exception &e)
+    {
+        hlog(HLOG_WARN, "exception in timer callback: %s", e.what());
+    }
+}
+
+void Forte::TimerRequestHandler::Handler(Event *e)
+{
+    TimerEvent *event = dynamic_cast<TimerEvent*>(e);
+    if (!event || !event->mTimer)
+    {
+        hlog(HLOG_ERR, "not a timer event");
+        return;
+    }
+
+    try
+    {
+        event->mTimer->Fire();
+    }
+    catch (std::exception &ex)
+    {
+        hlog(HLOG_WARN, "exception in timer callback: %s", ex.what());
+    }
+}
@@ -3,18 +3,25 @@
 
 #include "Clock.h"
 #include "Context.h"
+#include "Event.h"
+#include "RequestHandler.h"
 #include "Thread.h"
 #include "Timer.h"
+#include "TimerWheel.h"
 #include "Util.h"
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
+#include <vector>
 
 namespace Forte
 {
     EXCEPTION_CLASS(ERunLoop);
     EXCEPTION_SUBCLASS2(ERunLoop, ERunLoopTimerInvalid, "Invalid Timer");
 
+    class Dispatcher;
+
     class RunLoop : public Forte::Thread
     {
     public:
@@ -24,6 +31,24 @@ namespace Forte
          * the runloop.
          */
         RunLoop(const FString &name);
+
+        /**
+         * Instantiate a runloop that keeps its timers in a TimerWheel
+         * with the given tick instead of a sorted schedule. Adding a
+         * timer costs the same however many are pending, and all the
+         * timers due in a tick are fired together. Timers fire up to
+         * one tick late.
+         *
+         * If a dispatcher is given, each timer that fires is enqueued
+         * on it as a TimerEvent instead of being called on the runloop
+         * thread. The dispatcher should be created with a
+         * TimerRequestHandler.
+         */
+        RunLoop(const FString &name,
+                const Timespec &tick,
+                const boost::shared_ptr<Dispatcher> &dispatcher =
+                boost::shared_ptr<Dispatcher>());
+
         virtual ~RunLoop();
 
         /**
@@ -40,10 +65,19 @@ namespace Forte
 
     private:
         virtual void * run(void);
+        void * runWheel(void);
+        void fire(const boost::shared_ptr<Timer> &timer);
 
         const FString mName;
         mutable Mutex mLock;
 
+        boost::scoped_ptr<TimerWheel> mWheel;
+        boost::shared_ptr<Dispatcher> mDispatcher;
+        std::vector<TimerWheel::Expired> mExpired;
+        // when the runloop thread will next wake, zero while it is
+        // awake; timers due later need not wake it
+        Timespec mWakeTime;
+
         class RunLoopScheduleItem
         {
         public:
@@ -81,6 +115,34 @@ namespace Forte
         };
         std::multiset<RunLoopScheduleItem> mSchedule;
     };
+
+    /**
+     * The event a RunLoop with a Dispatcher enqueues for a timer that
+     * has fired.
+     */
+    class TimerEvent : public Event
+    {
+    public:
+        TimerEvent(const boost::shared_ptr<Timer> &timer) :
+            Event(timer->GetName()),
+            mTimer(timer) {
+        }
+
+        boost::shared_ptr<Timer> mTimer;
+    };
+
+    /**
+     * Calls the timer in each TimerEvent, on the dispatcher's thread.
+     */
+    class TimerRequestHandler : public RequestHandler
+    {
+    public:
+        virtual void Handler(Event *e);
+        virtual void Busy(void) {}
+        virtual void Periodic(void) {}
+        virtual void Init(void) {}
+        virtual void Cleanup(void) {}
+    };
 };
 
 #endif
@@ -0,0 +1,274 @@
+#include "SnapshotContext.h"
+#include "FTrace.h"
+#include "Foreach.h"
+#include "ThreadKey.h"
+#include <set>
+#include <vector>
+
+using namespace Forte;
+
+namespace
+{
+    struct CachedSnapshot
+    {
+        uint64_t mContextId;
+        unsigned int mGeneration;
+        boost::shared_ptr<const ObjectMap> mSnapshot;
+    };
+
+    struct SnapshotCache
+    {
+        // taken by the owning thread on each read, which is uncontended,
+        // and by a destroyed context dropping its entry from every
+        // thread's cache
+        Mutex mLock;
+        std::vector<CachedSnapshot> mEntries;
+    };
+    typedef std::set<SnapshotCache *> SnapshotCacheSet;
+
+    // a thread rarely reads more than a few contexts; past this the
+    // oldest entry is dropped
+    const size_t MAX_CACHED_SNAPSHOTS = 8;
+}
+
+// every live thread's cache. These are never freed, since threads may
+// exit during static destruction.
+static Mutex & snapshotCachesLock(void)
+{
+    static Mutex *lock = new Mutex();
+    return *lock;
+}
+
+static SnapshotCacheSet & snapshotCaches(void)
+{
+    static SnapshotCacheSet *caches = new SnapshotCacheSet();
+    return *caches;
+}
+
+static __thread SnapshotCache *sSnapshotCache = NULL;
+
+static void deleteSnapshotCache(void *cache)
+{
+    SnapshotCache *snapshotCache = static_cast<SnapshotCache *>(cache);
+    // runs on the exiting thread. a context read from a later thread
+    // key destructor starts a new cache instead of using this one
+    sSnapshotCache = NULL;
+    {
+        AutoUnlockMutex lock(snapshotCachesLock());
+        snapshotCaches().erase(snapshotCache);
+    }
+    delete snapshotCache;
+}
+
+// the key only frees the cache when the thread exits; reads go through
+// the __thread pointer. It is made on first use, in case a context is
+// read during static initialization.
+static ThreadKey & snapshotCacheKey(void)
+{
+    static ThreadKey key(deleteSnapshotCache);
+    return key;
+}
+
+static uint64_t sNextContextId = 0;
+
+static SnapshotCache & threadSnapshotCache(void)
+{
+    if (sSnapshotCache == NULL)
+    {
+        SnapshotCache *cache = new SnapshotCache();
+        {
+            AutoUnlockMutex lock(snapshotCachesLock());
+            snapshotCaches().insert(cache);
+        }
+        sSnapshotCache = cache;
+        snapshotCacheKey().Set(sSnapshotCache);
+    }
+    return *sSnapshotCache;
+}
+
+Forte::SnapshotContext::SnapshotContext()
+    : mId(__sync_add_and_fetch(&sNextContextId, 1)),
+      mSnapshot(new ObjectMap()),
+      mGeneration(0)
+{
+    FTRACE;
+}
+
+Forte::SnapshotContext::~SnapshotContext()
+{
+    FTRACE;
+    if (!mSnapshot->empty())
+    {
+        hlog(HLOG_DEBUG, "Objects Remain in SnapshotContext at deletion:");
+        Dump();
+    }
+    Clear();
+
+    // nobody can read this context again, so no thread would replace
+    // the snapshot it cached. Drop them all here, or the objects in
+    // them live on until each reader thread exits.
+    std::vector<boost::shared_ptr<const ObjectMap> > released;
+    {
+        AutoUnlockMutex lock(snapshotCachesLock());
+        foreach (SnapshotCache *cache, snapshotCaches())
+        {
+            AutoUnlockMutex cacheLock(cache->mLock);
+            foreach (CachedSnapshot &cached, cache->mEntries)
+            {
+                if (cached.mContextId == mId)
+                {
+                    released.push_back(cached.mSnapshot);
+                    cached.mSnapshot.reset();
+                    cached.mContextId = 0;
+                }
+            }
+        }
+    }
+}
+
+const ObjectMap & Forte::SnapshotContext::snapshot(void) const
+{
+    const unsigned int generation = mGeneration;
+    SnapshotCache &cache(threadSnapshotCache());
+
+    // whatever this replaces is released after the cache is unlocked
+    std::vector<boost::shared_ptr<const ObjectMap> > released;
+    AutoUnlockMutex cacheLock(cache.mLock);
+    std::vector<CachedSnapshot> &entries(cache.mEntries);
+
+    std::vector<CachedSnapshot>::iterator i;
+    std::vector<CachedSnapshot>::iterator unused = entries.end();
+    for (i = entries.begin(); i != entries.end(); ++i)
+    {
+        if (i->mContextId == mId)
+        {
+            if (i->mGeneration == generation)
+                return *i->mSnapshot;
+            break;
+        }
+        if (i->mContextId == 0 && unused == entries.end())
+            unused = i;
+    }
+
+    if (i == entries.end())
+    {
+        // reuse the entry of a destroyed context, if there is one
+        if (unused != entries.end())
+        {
+            i = unused;
+        }
+        else
+        {
+            if (entries.size() >= MAX_CACHED_SNAPSHOTS)
+            {
+                released.push_back(entries.front().mSnapshot);
+                entries.erase(entries.begin());
+            }
+            entries.push_back(CachedSnapshot());
+            i = entries.end() - 1;
+        }
+        i->mContextId = mId;
+    }
+
+    released.push_back(i->mSnapshot);
+    {
+        AutoUnlockMutex lock(mWriteLock);
+        i->mSnapshot = mSnapshot;
+        i->mGeneration = mGeneration;
+    }
+    return *i->mSnapshot;
+}
+
+void Forte::SnapshotContext::publish(
+    const boost::shared_ptr<const ObjectMap> &next,
+    std::vector<boost::shared_ptr<const ObjectMap> > &released)
+{
+    // called with mWriteLock held
+    released.push_back(mSnapshot);
+    mSnapshot = next;
+    __sync_synchronize();
+    ++mGeneration;
+
+    // the writer's own stale entry need not wait for its next read
+    if (sSnapshotCache != NULL)
+    {
+        AutoUnlockMutex cacheLock(sSnapshotCache->mLock);
+        foreach (CachedSnapshot &cached, sSnapshotCache->mEntries)
+        {
+            if (cached.mContextId == mId)
+            {
+                released.push_back(cached.mSnapshot);
+                cached.mSnapshot = next;
+                cached.mGeneration = mGeneration;
+            }
+        }
+    }
+}
+
+Forte::ObjectPtr Forte::SnapshotContext::Get(const char *key) const
+{
+    const ObjectMap &objects(snapshot());
+    ObjectMap::const_iterator i = objects.find(key);
+    if (i == objects.end())
+    {
+        // as in ContextImpl, objects must be explicitly created
+        throw_exception(EContextInvalidKey(key));
+    }
+    return i->second;
+}
+
+void Forte::SnapshotContext::Set(const char *key, ObjectPtr obj)
+{
+    if (!obj)
+    {
+        // disallow setting to an empty pointer
+        throw_exception(EContextEmptyPointer(key));
+    }
+
+    // we must not cause object deletions while holding the lock
+    std::vector<boost::shared_ptr<const ObjectMap> > released;
+    {
+        AutoUnlockMutex lock(mWriteLock);
+        boost::shared_ptr<ObjectMap> next(new ObjectMap(*mSnapshot));
+        (*next)[key] = obj;
+        publish(next, released);
+    }
+}
+
+void Forte::SnapshotContext::Remove(const char *key)
+{
+    std::vector<boost::shared_ptr<const ObjectMap> > released;
+    {
+        AutoUnlockMutex lock(mWriteLock);
+        if (mSnapshot->find(key) == mSnapshot->end())
+            return;
+        boost::shared_ptr<ObjectMap> next(new ObjectMap(*mSnapshot));
+        next->erase(key);
+        publish(next, released);
+    }
+}
+
+void Forte::SnapshotContext::Clear(void)
+{
+    std::vector<boost::shared_ptr<const ObjectMap> > released;
+    {
+        AutoUnlockMutex lock(mWriteLock);
+        if (mSnapshot->empty())
+            return;
+        publish(boost::shared_ptr<const ObjectMap>(new ObjectMap()), released);
+    }
+}
+
+void Forte::SnapshotContext::Dump(void)
+{
+    boost::shared_ptr<const ObjectMap> objects;
+    {
+        AutoUnlockMutex lock(mWriteLock);
+        objects = mSnapshot;
+    }
+    hlog(HLOG_DEBUG, "SnapshotContext contains %lu objects:", objects->size());
+    foreach (const ObjectPair &p, *objects)
+    {
+        hlog(HLOG_DEBUG, "[%ld] %s", p.second.use_count(), p.first.c_str());
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef __Forte__SnapshotContext_h__
+#define __Forte__SnapshotContext_h__
+
+#include "AutoMutex.h"
+#include "Context.h"
+#include "Types.h"
+
+namespace Forte
+{
+    /**
+     * SnapshotContext is a Context for the case where objects are read
+     * on every request but set rarely, usually at startup.
+     *
+     * The objects are kept in an immutable map. Set(), Remove() and
+     * Clear() copy the map, change the copy, publish it as the new
+     * snapshot and bump a generation count. Each thread keeps the last
+     * snapshot it read, and takes the write lock only when the
+     * generation has moved on since then. Otherwise a read is a lookup
+     * in the cached map, under a lock of the thread's own that no other
+     * thread takes except to destroy a context, and with no shared
+     * writes.
+     *
+     * Like RCU, an old snapshot stays alive until every thread that read
+     * it has read this context again, or has exited. A removed object
+     * may therefore outlive Remove() for a while, in threads that have
+     * not looked at this context since. Destroying the context drops
+     * its snapshot from every thread, so its objects do not outlive it.
+     *
+     * Handle resolves a key once and keeps the typed pointer, so each
+     * access after that costs one load of the generation.
+     */
+    class SnapshotContext : public Context  // final
+    {
+    public:
+        SnapshotContext();
+        ~SnapshotContext();
+
+        ObjectPtr Get(const char *key) const;
+
+        template <typename ValueType>
+        boost::shared_ptr<ValueType> Get(const char *key) const
+        {
+            return Context::Get<ValueType>(key);
+        }
+
+        void Set(const char *key, ObjectPtr obj);
+        void Remove(const char *key);
+        void Clear(void);
+        void Dump(void);
+
+        /**
+         * GetGeneration() returns a count that changes whenever an
+         * object is set or removed.
+         **/
+        unsigned int GetGeneration(void) const { return mGeneration; }
+
+        /**
+         * Handle gives typed access to one key of a SnapshotContext.
+         * The key is looked up and the object cast to ValueType when
+         * the Handle is made, and again only after the context has
+         * changed. It throws as Context::Get<ValueType>() does, when it
+         * is made and when a changed context no longer has a suitable
+         * object for the key.
+         *
+         * A Handle updates itself when it is used, so each thread should
+         * use its own; they are cheap to copy.
+         **/
+        template <typename ValueType>
+        class Handle
+        {
+        public:
+            Handle(const SnapshotContext &context, const char *key)
+                : mContext(&context),
+                  mKey(key),
+                  mGeneration(0)
+                {
+                    resolve();
+                }
+
+            ValueType & operator*() const { return *Get(); }
+            ValueType * operator->() const { return Get().get(); }
+
+            const boost::shared_ptr<ValueType> & Get() const {
+                if (mGeneration != mContext->GetGeneration())
+                    resolve();
+                return mPtr;
+            }
+
+            const FString & GetKey() const { return mKey; }
+
+        private:
+            void resolve() const {
+                // read first, so a change made during the lookup is
+                // picked up next time
+                mGeneration = mContext->GetGeneration();
+                __sync_synchronize();
+                mPtr = mContext->Get<ValueType>(mKey);
+            }
+
+            const SnapshotContext *mContext;
+            FString mKey;
+            mutable unsigned int mGeneration;
+            mutable boost::shared_ptr<ValueType> mPtr;
+        };
+
+    private:
+        const ObjectMap & snapshot(void) const;
+        void publish(const boost::shared_ptr<const ObjectMap> &next,
+                     std::vector<boost::shared_ptr<const ObjectMap> > &released);
+
+        // identifies this context in the per-thread caches, where the
+        // address could be reused by a later context
+        const uint64_t mId;
+
+        mutable Mutex mWriteLock;
+        boost::shared_ptr<const ObjectMap> mSnapshot;
+        volatile unsigned int mGeneration;
+    };
+};
+
+#endif
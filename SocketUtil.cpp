@@ -48,7 +48,11 @@ void Forte::bindToAddress(int fd, const Forte::SocketAddress& bindAddress)
     memset(&bind_addr, 0, sizeof(struct sockaddr_in));
     bind_addr.sin_family = AF_INET;
     bind_addr.sin_port = htons(bindAddress.second);
-    if (!inet_aton(bindAddress.first.c_str(), &(bind_addr.sin_addr)))
+    if (bindAddress.first.empty())
+    {
+        bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    else if (!inet_aton(bindAddress.first.c_str(), &(bind_addr.sin_addr)))
     {
         throw ECouldNotBind(
             FStringFC(), "invalid bind IP: %s", bindAddress.first.c_str());
@@ -65,28 +69,34 @@ void Forte::bindToAddress(int fd, const Forte::SocketAddress& bindAddress)
     }
 }
 
-void Forte::connectToAddress(int fd, const Forte::SocketAddress& connectToAddress)
+static void toInetAddress(const Forte::SocketAddress& connectToAddress,
+                          struct sockaddr_in& sa)
 {
-    FTRACE2("%s:%d",
-            connectToAddress.first.c_str(),
-            connectToAddress.second);
-
-    hlogstream(HLOG_DEBUG2, "Attempting connection to "
-               << connectToAddress.first << ":" << connectToAddress.second);
-    struct sockaddr_in sa;
-
+    memset(&sa, 0, sizeof(sa));
     if (inet_pton(
             AF_INET, connectToAddress.first.c_str(), &sa.sin_addr) == -1)
     {
         hlogstream(HLOG_DEBUG2,
                    "could not convert ip " << connectToAddress.first
-                   << ":" << SystemCallUtil::GetErrorDescription(errno)
+                   << ":" << Forte::SystemCallUtil::GetErrorDescription(errno)
             );
-        throw ECouldNotConvertIP();
+        throw Forte::ECouldNotConvertIP();
     }
 
     sa.sin_family = AF_INET;
     sa.sin_port = htons(connectToAddress.second);
+}
+
+void Forte::connectToAddress(int fd, const Forte::SocketAddress& connectToAddress)
+{
+    FTRACE2("%s:%d",
+            connectToAddress.first.c_str(),
+            connectToAddress.second);
+
+    hlogstream(HLOG_DEBUG2, "Attempting connection to "
+               << connectToAddress.first << ":" << connectToAddress.second);
+    struct sockaddr_in sa;
+    toInetAddress(connectToAddress, sa);
 
     if (::connect(fd,
                   const_cast<const struct sockaddr *>(
@@ -107,6 +117,53 @@ void Forte::connectToAddress(int fd, const Forte::SocketAddress& connectToAddres
                << ":" << connectToAddress.second);
 }
 
+bool Forte::startConnectToAddress(int fd,
+                                  const Forte::SocketAddress& connectToAddress)
+{
+    FTRACE2("%s:%d",
+            connectToAddress.first.c_str(),
+            connectToAddress.second);
+
+    hlogstream(HLOG_DEBUG2, "Starting connection to "
+               << connectToAddress.first << ":" << connectToAddress.second);
+    struct sockaddr_in sa;
+    toInetAddress(connectToAddress, sa);
+
+    int ret;
+    while ((ret = ::connect(fd,
+                            const_cast<const struct sockaddr *>(
+                                reinterpret_cast<struct sockaddr*>(&sa)),
+                            sizeof(sa))) == -1
+           && errno == EINTR) {}
+
+    if (ret == 0)
+    {
+        return true;
+    }
+    if (errno == EINPROGRESS)
+    {
+        return false;
+    }
+
+    hlogstream(HLOG_DEBUG2, "could not connect to "
+               << connectToAddress.first
+               << ":" << connectToAddress.second
+               << ":" << SystemCallUtil::GetErrorDescription(errno)
+        );
+    throw ECouldNotConnect();
+}
+
+int Forte::getSocketError(int fd)
+{
+    int error(0);
+    socklen_t len(sizeof(error));
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1)
+    {
+        return errno;
+    }
+    return error;
+}
+
 void Forte::setTCPKeepAlive(int fd,
                             const int soKeepAliveEnabled,
                             const int tcpKeepAliveCount,
@@ -217,6 +274,22 @@ void Forte::setReuseAddr(int fd, const int soResuseAddr)
     }
 }
 
+void Forte::setReusePort(int fd, const int soReusePort)
+{
+    if (setsockopt(
+            fd,
+            SOL_SOCKET,
+            SO_REUSEPORT,
+            &soReusePort,
+            sizeof(soReusePort)) == -1)
+    {
+        hlog_and_throw(HLOG_ERR,
+                       ECouldNotSetReusePort(
+                           SystemCallUtil::GetErrorDescription(errno)));
+    }
+    hlog(HLOG_DEBUG2, "Set SO_REUSEPORT for socket to (%d)", soReusePort);
+}
+
 void Forte::setSocketNonBlocking(int fd)
 {
     int flags, s;
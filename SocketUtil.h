@@ -33,6 +33,7 @@ namespace Forte
         ECouldNotConnect,
         "Could not connect to peer");
 
+    EXCEPTION_SUBCLASS(ESocketUtil, ECouldNotSetReusePort);
     EXCEPTION_SUBCLASS(ESocketUtil, EFcntlFailed);
     EXCEPTION_SUBCLASS(ESocketUtil, ESelectFailed);
 
@@ -51,6 +52,15 @@ namespace Forte
     void bindToAddress(int fd, const SocketAddress& connectToAddress);
     void connectToAddress(int fd, const SocketAddress& connectToAddress);
 
+    // start connecting the non blocking socket fd. true if it is
+    // connected already, false if the connect is in progress and fd
+    // becomes writable once it is done. getSocketError() then says
+    // whether it worked
+    bool startConnectToAddress(int fd, const SocketAddress& connectToAddress);
+
+    // the pending error on fd (SO_ERROR), 0 if there is none
+    int getSocketError(int fd);
+
     void setTCPKeepAlive(int fd,
                          const int soKeepAliveEnabled=1,
                          const int tcpKeepAliveCount=4,
@@ -63,6 +73,11 @@ namespace Forte
     void setReuseAddr(int fd,
                       const int soResuseAddr=1);
 
+    // unlike SO_REUSEADDR, sharing a port with SO_REUSEPORT is needed
+    // for the later binds to work, so this throws ECouldNotSetReusePort
+    void setReusePort(int fd,
+                      const int soReusePort=1);
+
     //works for not sockets too
     void setSocketNonBlocking(int fd);
     void setSocketNonBlockingSaveOldFlags(int fd, int &oldFlags);
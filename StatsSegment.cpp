@@ -0,0 +1,360 @@
+#include "StatsSegment.h"
+#include "FTrace.h"
+#include "Foreach.h"
+#include "LogManager.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Forte;
+
+namespace
+{
+    const char sMagic[8] = { 'F', 'S', 'T', 'A', 'T', 'S', '0', '1' };
+    const uint32_t sVersion = 1;
+
+    // a reader gives up on an entry whose writer died mid-change
+    const int MAX_READ_RETRIES = 1000;
+}
+
+const unsigned int Forte::StatsSegmentEntry::NAME_SIZE;
+
+Forte::StatsSegment::StatsSegment(const FString &path, unsigned int capacity)
+    : mPath(path),
+      mCapacity(capacity),
+      mSize(sizeof(StatsSegmentHeader) + capacity * sizeof(StatsSegmentEntry)),
+      mFD(-1),
+      mHeader(NULL),
+      mEntries(NULL)
+{
+    FTRACE2("%s, %u", path.c_str(), capacity);
+
+    // a reader of the file being replaced keeps its copy
+    ::unlink(path.c_str());
+    mFD = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (mFD == -1)
+    {
+        hlog_and_throw(HLOG_ERR, EStatsSegmentOpen(
+                           FStringFC(), "%s: %s", path.c_str(),
+                           strerror(errno)));
+    }
+
+    // ftruncate zero fills, so every entry starts free
+    void *map = MAP_FAILED;
+    if (ftruncate(mFD, mSize) == 0)
+        map = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFD, 0);
+    if (map == MAP_FAILED)
+    {
+        const int err(errno);
+        ::close(mFD);
+        ::unlink(path.c_str());
+        hlog_and_throw(HLOG_ERR, EStatsSegmentOpen(
+                           FStringFC(), "%s: %s", path.c_str(), strerror(err)));
+    }
+
+    mHeader = static_cast<StatsSegmentHeader *>(map);
+    mEntries = reinterpret_cast<StatsSegmentEntry *>(mHeader + 1);
+    mHeader->mVersion = sVersion;
+    mHeader->mEntrySize = sizeof(StatsSegmentEntry);
+    mHeader->mCapacity = capacity;
+    mHeader->mCount = 0;
+    mHeader->mPID = getpid();
+    // readers check the magic, so it goes in last
+    __sync_synchronize();
+    memcpy(mHeader->mMagic, sMagic, sizeof(sMagic));
+}
+
+Forte::StatsSegment::~StatsSegment()
+{
+    FTRACE;
+    munmap(mHeader, mSize);
+    ::close(mFD);
+    ::unlink(mPath.c_str());
+}
+
+void Forte::StatsSegment::Add(const boost::shared_ptr<BaseEnableStats> &object,
+                              const FString &prefix)
+{
+    FTRACE2("%s", prefix.c_str());
+
+    if (!object)
+    {
+        hlog_and_throw(HLOG_ERR, EStatsSegmentObjectInvalid());
+    }
+
+    std::vector<FString> names;
+    object->GetStatNames(names);
+
+    AutoUnlockMutex lock(mLock);
+    mPublications.push_back(Publication());
+    Publication &publication(mPublications.back());
+    publication.mObject = object;
+    try
+    {
+        foreach (const FString &name, names)
+        {
+            if (prefix.empty())
+            {
+                publication.mEntries.push_back(allocate(name));
+            }
+            else
+            {
+                publication.mEntries.push_back(
+                    allocate(FString(FStringFC(), "%s.%s",
+                                     prefix.c_str(), name.c_str())));
+            }
+        }
+    }
+    catch (EStatsSegmentFull &e)
+    {
+        release(publication);
+        mPublications.pop_back();
+        throw;
+    }
+    update(publication, object);
+}
+
+void Forte::StatsSegment::Remove(const boost::shared_ptr<BaseEnableStats> &object)
+{
+    FTRACE;
+
+    AutoUnlockMutex lock(mLock);
+    std::list<Publication>::iterator i = mPublications.begin();
+    while (i != mPublications.end())
+    {
+        boost::shared_ptr<BaseEnableStats> published(i->mObject.lock());
+        if (!published || published == object)
+        {
+            release(*i);
+            i = mPublications.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void Forte::StatsSegment::Update(void)
+{
+    AutoUnlockMutex lock(mLock);
+    std::list<Publication>::iterator i = mPublications.begin();
+    while (i != mPublications.end())
+    {
+        boost::shared_ptr<BaseEnableStats> object(i->mObject.lock());
+        if (!object)
+        {
+            release(*i);
+            i = mPublications.erase(i);
+            continue;
+        }
+        update(*i, object);
+        ++i;
+    }
+}
+
+unsigned int Forte::StatsSegment::GetUsedCount(void) const
+{
+    AutoUnlockMutex lock(mLock);
+    return mHeader->mCount - mFreeEntries.size();
+}
+
+void Forte::StatsSegment::update(
+    Publication &publication, const boost::shared_ptr<BaseEnableStats> &object)
+{
+    publication.mValues.clear();
+    object->GetStatValues(publication.mValues);
+    if (publication.mValues.size() != publication.mEntries.size())
+    {
+        hlog(HLOG_WARN, "stats object gave %zu values for %zu names",
+             publication.mValues.size(), publication.mEntries.size());
+        return;
+    }
+
+    for (size_t i = 0; i < publication.mEntries.size(); ++i)
+    {
+        write(publication.mEntries[i], publication.mValues[i]);
+    }
+}
+
+unsigned int Forte::StatsSegment::allocate(const FString &name)
+{
+    // called with mLock held
+    unsigned int entry;
+    bool fresh(false);
+    if (!mFreeEntries.empty())
+    {
+        entry = mFreeEntries.back();
+        mFreeEntries.pop_back();
+    }
+    else if (mHeader->mCount < mCapacity)
+    {
+        entry = mHeader->mCount;
+        fresh = true;
+    }
+    else
+    {
+        hlog_and_throw(HLOG_ERR, EStatsSegmentFull(
+                           FStringFC(), "%s: no room for %s",
+                           mPath.c_str(), name.c_str()));
+    }
+
+    if (name.size() >= StatsSegmentEntry::NAME_SIZE)
+    {
+        hlog(HLOG_WARN, "stat name truncated: %s", name.c_str());
+    }
+
+    StatsSegmentEntry &e(mEntries[entry]);
+    ++e.mSequence;
+    __sync_synchronize();
+    strncpy(e.mName, name.c_str(), StatsSegmentEntry::NAME_SIZE - 1);
+    e.mName[StatsSegmentEntry::NAME_SIZE - 1] = 0;
+    e.mValue = 0;
+    __sync_synchronize();
+    ++e.mSequence;
+
+    if (fresh)
+    {
+        __sync_synchronize();
+        mHeader->mCount = entry + 1;
+    }
+    return entry;
+}
+
+void Forte::StatsSegment::release(unsigned int entry)
+{
+    // called with mLock held
+    StatsSegmentEntry &e(mEntries[entry]);
+    ++e.mSequence;
+    __sync_synchronize();
+    memset(e.mName, 0, sizeof(e.mName));
+    e.mValue = 0;
+    __sync_synchronize();
+    ++e.mSequence;
+    mFreeEntries.push_back(entry);
+}
+
+void Forte::StatsSegment::release(Publication &publication)
+{
+    foreach (unsigned int entry, publication.mEntries)
+    {
+        release(entry);
+    }
+    publication.mEntries.clear();
+}
+
+void Forte::StatsSegment::write(unsigned int entry, int64_t value)
+{
+    // called with mLock held, so this is the only writer. an unchanged
+    // value is not rewritten, which leaves readers' cache lines alone
+    StatsSegmentEntry &e(mEntries[entry]);
+    if (e.mValue == value)
+        return;
+
+    ++e.mSequence;
+    __sync_synchronize();
+    e.mValue = value;
+    __sync_synchronize();
+    ++e.mSequence;
+}
+
+Forte::StatsSegmentReader::StatsSegmentReader(const FString &path)
+    : mFD(-1),
+      mSize(0),
+      mHeader(NULL),
+      mEntries(NULL)
+{
+    FTRACE2("%s", path.c_str());
+
+    mFD = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFD == -1)
+    {
+        hlog_and_throw(HLOG_ERR, EStatsSegmentOpen(
+                           FStringFC(), "%s: %s", path.c_str(),
+                           strerror(errno)));
+    }
+
+    struct stat st;
+    if (fstat(mFD, &st) != 0)
+    {
+        const int err(errno);
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EStatsSegmentOpen(
+                           FStringFC(), "%s: %s", path.c_str(), strerror(err)));
+    }
+    mSize = st.st_size;
+
+    if (mSize < sizeof(StatsSegmentHeader))
+    {
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EStatsSegmentFormat(path));
+    }
+
+    void *map = mmap(NULL, mSize, PROT_READ, MAP_SHARED, mFD, 0);
+    if (map == MAP_FAILED)
+    {
+        const int err(errno);
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EStatsSegmentOpen(
+                           FStringFC(), "%s: %s", path.c_str(), strerror(err)));
+    }
+    mHeader = static_cast<const StatsSegmentHeader *>(map);
+    mEntries = reinterpret_cast<const StatsSegmentEntry *>(mHeader + 1);
+
+    if (memcmp(mHeader->mMagic, sMagic, sizeof(sMagic)) != 0
+        || mHeader->mVersion != sVersion
+        || mHeader->mEntrySize != sizeof(StatsSegmentEntry)
+        || mSize < sizeof(StatsSegmentHeader)
+                   + mHeader->mCapacity * sizeof(StatsSegmentEntry))
+    {
+        munmap(const_cast<StatsSegmentHeader *>(mHeader), mSize);
+        ::close(mFD);
+        hlog_and_throw(HLOG_ERR, EStatsSegmentFormat(path));
+    }
+}
+
+Forte::StatsSegmentReader::~StatsSegmentReader()
+{
+    munmap(const_cast<StatsSegmentHeader *>(mHeader), mSize);
+    ::close(mFD);
+}
+
+void Forte::StatsSegmentReader::Read(std::map<FString, int64_t> &stats) const
+{
+    const uint32_t used(mHeader->mCount);
+    const uint32_t count(std::min(used, mHeader->mCapacity));
+    __sync_synchronize();
+
+    char name[StatsSegmentEntry::NAME_SIZE];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const StatsSegmentEntry &e(mEntries[i]);
+        int64_t value(0);
+        bool consistent(false);
+        for (int tries = 0; !consistent && tries < MAX_READ_RETRIES; ++tries)
+        {
+            const uint32_t sequence(e.mSequence);
+            if (sequence & 1)
+            {
+                sched_yield();
+                continue;
+            }
+            __sync_synchronize();
+            memcpy(name, e.mName, sizeof(name));
+            value = e.mValue;
+            __sync_synchronize();
+            consistent = (e.mSequence == sequence);
+        }
+
+        name[sizeof(name) - 1] = 0;
+        if (consistent && name[0] != 0)
+        {
+            stats[name] = value;
+        }
+    }
+}
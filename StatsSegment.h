@@ -0,0 +1,168 @@
+#ifndef __Forte_StatsSegment_h__
+#define __Forte_StatsSegment_h__
+
+#include "AutoMutex.h"
+#include "EnableStats.h"
+#include "Exception.h"
+#include "FString.h"
+#include "Object.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * StatsSegment publishes the stat variables of EnableStats objects in
+ * a memory mapped file, usually under /dev/shm, where a monitoring
+ * agent can read them with StatsSegmentReader (or the statsdump tool)
+ * without calling into the server. Scraping costs the server nothing;
+ * the server pays for Update(), which samples each published object
+ * into the slots it was given and allocates nothing.
+ *
+ * The file is a header followed by an array of fixed size entries,
+ * each holding a NUL terminated name and a value. Every entry has its
+ * own sequence count, which the writer makes odd while it changes the
+ * entry, so a reader retries any entry it read mid-change. An entry
+ * with an empty name is free.
+ */
+
+namespace Forte
+{
+    EXCEPTION_CLASS(EStatsSegment);
+    EXCEPTION_SUBCLASS2(EStatsSegment, EStatsSegmentOpen,
+                        "Could not open stats segment");
+    EXCEPTION_SUBCLASS2(EStatsSegment, EStatsSegmentFormat,
+                        "Not a stats segment");
+    EXCEPTION_SUBCLASS2(EStatsSegment, EStatsSegmentFull,
+                        "Stats segment is full");
+    EXCEPTION_SUBCLASS2(EStatsSegment, EStatsSegmentObjectInvalid,
+                        "Stats object is invalid");
+
+    struct StatsSegmentHeader
+    {
+        char mMagic[8];
+        uint32_t mVersion;
+        uint32_t mEntrySize;
+        uint32_t mCapacity;
+        // entries at or past mCount have never been used
+        volatile uint32_t mCount;
+        int32_t mPID;
+        char mReserved[36];
+    };
+
+    struct StatsSegmentEntry
+    {
+        static const unsigned int NAME_SIZE = 112;
+
+        volatile uint32_t mSequence;
+        uint32_t mReserved;
+        volatile int64_t mValue;
+        char mName[NAME_SIZE];
+    };
+
+    class StatsSegment : public Object
+    {
+    public:
+        /**
+         * Creates the segment file at path with room for capacity
+         * stats, replacing any file there. Readers that still have an
+         * old file open keep reading it.
+         */
+        StatsSegment(const FString &path, unsigned int capacity = 4096);
+
+        /**
+         * Removes the segment file.
+         */
+        virtual ~StatsSegment();
+
+        /**
+         * Add() publishes the stat variables of object, named
+         * "prefix.name" (or just "name" for an empty prefix), and
+         * writes their current values. The segment keeps only a weak
+         * pointer; the object's entries are freed at the first Update()
+         * after it is destroyed, or by Remove().
+         *
+         * @throws EStatsSegmentFull if there are not enough free entries
+         */
+        void Add(const boost::shared_ptr<BaseEnableStats> &object,
+                 const FString &prefix);
+
+        void Remove(const boost::shared_ptr<BaseEnableStats> &object);
+
+        /**
+         * Update() writes the current value of every published stat.
+         * Call it as often as the stats should be fresh, e.g. from a
+         * periodic timer.
+         */
+        void Update(void);
+
+        const FString & GetPath(void) const { return mPath; }
+        unsigned int GetCapacity(void) const { return mCapacity; }
+
+        /**
+         * GetUsedCount() returns the number of entries holding a stat.
+         */
+        unsigned int GetUsedCount(void) const;
+
+    private:
+        struct Publication
+        {
+            boost::weak_ptr<BaseEnableStats> mObject;
+            std::vector<unsigned int> mEntries;
+            // reused by every Update()
+            std::vector<int64_t> mValues;
+        };
+
+        void update(Publication &publication,
+                    const boost::shared_ptr<BaseEnableStats> &object);
+        unsigned int allocate(const FString &name);
+        void release(unsigned int entry);
+        void release(Publication &publication);
+        void write(unsigned int entry, int64_t value);
+
+        const FString mPath;
+        const unsigned int mCapacity;
+        size_t mSize;
+        int mFD;
+        StatsSegmentHeader *mHeader;
+        StatsSegmentEntry *mEntries;
+
+        mutable Mutex mLock;
+        std::vector<unsigned int> mFreeEntries;
+        std::list<Publication> mPublications;
+    };
+
+    /**
+     * StatsSegmentReader reads a stats segment written by another
+     * process, without any locking that could stall the writer.
+     */
+    class StatsSegmentReader
+    {
+    public:
+        StatsSegmentReader(const FString &path);
+        ~StatsSegmentReader();
+
+        /**
+         * Read() adds every stat in the segment to stats.
+         */
+        void Read(std::map<FString, int64_t> &stats) const;
+
+        /**
+         * GetPID() returns the process that wrote the segment.
+         */
+        int GetPID(void) const { return mHeader->mPID; }
+
+    private:
+        StatsSegmentReader(const StatsSegmentReader &other) = delete;
+        StatsSegmentReader& operator=(const StatsSegmentReader &rhs) = delete;
+
+        int mFD;
+        size_t mSize;
+        const StatsSegmentHeader *mHeader;
+        const StatsSegmentEntry *mEntries;
+    };
+};
+
+#endif
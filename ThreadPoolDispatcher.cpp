@@ -237,6 +237,7 @@ void * Forte::ThreadPoolDispatcherWorker::run(void)
             setEvent(event);
             // set start time
             gettimeofday(&(event->mStartTime), NULL);
+            disp.recordQueueWait(*event);
             {
                 AutoLockMutex unlock(disp.mNotifyLock);
                 // process the request
@@ -352,6 +353,15 @@ void Forte::ThreadPoolDispatcher::Enqueue(boost::shared_ptr<Event> e)
     mEventQueue.Add(e);
 }
 
+void Forte::ThreadPoolDispatcher::EnqueueBatch(
+    std::list<boost::shared_ptr<Event> > &events)
+{
+    if (IsShuttingDown())
+        throw EThreadPoolDispatcherShuttingDown(
+            "dispatcher is shutting down; no new events are being accepted");
+    mEventQueue.AddBatch(events);
+}
+
 bool Forte::ThreadPoolDispatcher::Accepting(void)
 {
     return mEventQueue.Accepting();
@@ -70,6 +70,7 @@ namespace Forte
         virtual void Pause(void);
         virtual void Resume(void);
         virtual void Enqueue(boost::shared_ptr<Event> e);
+        virtual void EnqueueBatch(std::list<boost::shared_ptr<Event> > &events);
         virtual bool Accepting(void);
         inline int GetQueuedEvents(
             int maxEvents, std::list<boost::shared_ptr<Event> > &queuedEvents)
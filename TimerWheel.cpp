@@ -0,0 +1,233 @@
+#include "TimerWheel.h"
+#include "FTrace.h"
+#include "LogManager.h"
+
+using namespace Forte;
+using namespace boost;
+
+static const unsigned int ROOT_BITS = 8;
+static const unsigned int ROOT_SLOTS = 1 << ROOT_BITS;
+static const unsigned int LEVEL_BITS = 6;
+static const unsigned int LEVEL_SLOTS = 1 << LEVEL_BITS;
+static const unsigned int LEVELS = 3; // above the root
+static const unsigned int TOTAL_BITS = ROOT_BITS + LEVELS * LEVEL_BITS;
+
+static int64_t asNanosec(const Timespec &t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+// slot indexes are taken from this many low bits of the tick at level
+static unsigned int shiftFor(unsigned int level)
+{
+    return ROOT_BITS + (level - 1) * LEVEL_BITS;
+}
+
+static unsigned int slotFor(unsigned int level, uint64_t tick)
+{
+    if (level == 0)
+        return tick & (ROOT_SLOTS - 1);
+    return ROOT_SLOTS + (level - 1) * LEVEL_SLOTS +
+        ((tick >> shiftFor(level)) & (LEVEL_SLOTS - 1));
+}
+
+TimerWheel::TimerWheel(const Timespec &tick, const Timespec &start) :
+    mTick(tick),
+    mStart(start),
+    mTickNanosec(asNanosec(tick)),
+    mCurrent(0),
+    mCount(0),
+    mFree(-1),
+    mSlots(ROOT_SLOTS + LEVELS * LEVEL_SLOTS, -1)
+{
+    FTRACE;
+    if (mTickNanosec <= 0)
+        hlog_and_throw(HLOG_ERR, ETimerWheelTickInvalid());
+}
+
+TimerWheel::~TimerWheel()
+{
+    FTRACE;
+}
+
+uint64_t TimerWheel::tickFor(const Timespec &absolute) const
+{
+    const int64_t ns = asNanosec(absolute - mStart);
+    if (ns <= 0)
+        return 0;
+    // rounded up, so nothing fires before it is due
+    return (ns + mTickNanosec - 1) / mTickNanosec;
+}
+
+Timespec TimerWheel::timeFor(uint64_t tick) const
+{
+    const int64_t ns = asNanosec(mStart) + tick * mTickNanosec;
+    return Timespec(ns / 1000000000LL, ns % 1000000000LL);
+}
+
+void TimerWheel::Add(const shared_ptr<Timer> &timer,
+                     const Timespec &absolute,
+                     const Timespec &scheduledTime)
+{
+    int entry = mFree;
+    if (entry >= 0)
+        mFree = mEntries[entry].mNext;
+    else
+    {
+        entry = mEntries.size();
+        mEntries.push_back(Entry());
+    }
+
+    Entry &e(mEntries[entry]);
+    e.mTimer = timer;
+    e.mAbsolute = absolute;
+    e.mScheduledTime = scheduledTime;
+    ++mCount;
+    place(entry);
+}
+
+void TimerWheel::place(int entry)
+{
+    Entry &e(mEntries[entry]);
+    uint64_t tick = tickFor(e.mAbsolute);
+    if (tick < mCurrent)
+        tick = mCurrent;
+
+    const uint64_t delta = tick - mCurrent;
+    unsigned int slot;
+    if (delta < ROOT_SLOTS)
+        slot = slotFor(0, tick);
+    else
+    {
+        // past the end of the wheel it waits in the last level, and
+        // is placed again from mAbsolute when that slot turns
+        if (delta >= (1ULL << TOTAL_BITS))
+            tick = mCurrent + (1ULL << TOTAL_BITS) - 1;
+
+        unsigned int level = 1;
+        while (level < LEVELS && delta >= (1ULL << shiftFor(level + 1)))
+            ++level;
+        slot = slotFor(level, tick);
+    }
+
+    e.mNext = mSlots[slot];
+    mSlots[slot] = entry;
+}
+
+void TimerWheel::release(int entry)
+{
+    Entry &e(mEntries[entry]);
+    e.mTimer.reset();
+    e.mNext = mFree;
+    mFree = entry;
+    --mCount;
+}
+
+void TimerWheel::cascade(unsigned int level)
+{
+    int &head(mSlots[slotFor(level, mCurrent)]);
+    int entry = head;
+    head = -1;
+    while (entry >= 0)
+    {
+        const int next = mEntries[entry].mNext;
+        if (mEntries[entry].mTimer.expired())
+            release(entry);
+        else
+            place(entry);
+        entry = next;
+    }
+}
+
+size_t TimerWheel::Expire(const Timespec &now, std::vector<Expired> &expired)
+{
+    const int64_t ns = asNanosec(now - mStart);
+    if (ns < 0)
+        return 0;
+    const uint64_t target = ns / mTickNanosec;
+
+    size_t count = 0;
+    while (mCurrent <= target)
+    {
+        if (mCount == 0)
+        {
+            // nothing to cascade, skip the idle ticks
+            mCurrent = target + 1;
+            break;
+        }
+
+        // as each level wraps, the next level's slot comes down a level
+        for (unsigned int level = 0; level < LEVELS; ++level)
+        {
+            if ((mCurrent & ((1ULL << shiftFor(level + 1)) - 1)) != 0)
+                break;
+            cascade(level + 1);
+        }
+
+        int &head(mSlots[slotFor(0, mCurrent)]);
+        int entry = head;
+        head = -1;
+        while (entry >= 0)
+        {
+            Entry &e(mEntries[entry]);
+            const int next = e.mNext;
+            shared_ptr<Timer> timer(e.mTimer.lock());
+            if (timer)
+            {
+                expired.push_back(Expired());
+                expired.back().mTimer = timer;
+                expired.back().mAbsolute = e.mAbsolute;
+                expired.back().mScheduledTime = e.mScheduledTime;
+                ++count;
+            }
+            release(entry);
+            entry = next;
+        }
+        ++mCurrent;
+    }
+
+    return count;
+}
+
+bool TimerWheel::GetNextExpiry(Timespec &next) const
+{
+    if (mCount == 0)
+        return false;
+
+    uint64_t best = 0;
+    bool found = false;
+    for (unsigned int i = 0; i < ROOT_SLOTS; ++i)
+    {
+        if (mSlots[slotFor(0, mCurrent + i)] >= 0)
+        {
+            best = mCurrent + i;
+            found = true;
+            break;
+        }
+    }
+
+    // the ticks at which each coarser slot is placed again
+    for (unsigned int level = 1; level <= LEVELS; ++level)
+    {
+        const unsigned int shift = shiftFor(level);
+        const uint64_t first = (mCurrent + (1ULL << shift) - 1) >> shift;
+        for (unsigned int i = 0; i < LEVEL_SLOTS; ++i)
+        {
+            const uint64_t tick = (first + i) << shift;
+            if (found && tick >= best)
+                break;
+            if (mSlots[slotFor(level, tick)] >= 0)
+            {
+                best = tick;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (!found)
+        return false;
+    next = timeFor(best);
+    return true;
+}
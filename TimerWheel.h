@@ -0,0 +1,119 @@
+#ifndef __Forte_TimerWheel_h__
+#define __Forte_TimerWheel_h__
+
+#include "Clock.h"
+#include "Exception.h"
+#include "Object.h"
+#include "Timer.h"
+#include "Types.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <vector>
+
+namespace Forte
+{
+    EXCEPTION_CLASS(ETimerWheel);
+    EXCEPTION_SUBCLASS2(ETimerWheel, ETimerWheelTickInvalid,
+                        "Invalid TimerWheel tick");
+
+    /**
+     * TimerWheel keeps pending Timers in a hierarchical timing wheel.
+     * The first level has 256 slots of one tick each. Each of the three
+     * levels above it has 64 slots, and each of those slots is 64 times
+     * coarser than one slot of the level below. At a 1ms tick the wheel
+     * covers about 18 hours. A timer due later than that waits in the
+     * last level and is placed again as that level turns.
+     *
+     * Adding a timer links a pooled entry into one slot. The cost is the
+     * same however many timers are pending, and no memory is allocated
+     * once the pool has grown. There is nothing to remove: destroying the
+     * Timer cancels it, and its entry is reclaimed when its slot comes
+     * up. Expire() takes out every timer that is due in one pass, so they
+     * can be fired as a batch. Due times are rounded up to the tick, so a
+     * timer never expires early.
+     *
+     * TimerWheel does no locking of its own. RunLoop uses it under its
+     * lock.
+     */
+    class TimerWheel : public Object
+    {
+    public:
+        struct Expired
+        {
+            boost::shared_ptr<Timer> mTimer;
+            Timespec mAbsolute;
+            Timespec mScheduledTime;
+        };
+
+        /**
+         * Creates an empty wheel. The first tick starts at start, which is
+         * on the monotonic clock. Throws ETimerWheelTickInvalid if tick is
+         * not positive.
+         */
+        TimerWheel(const Timespec &tick, const Timespec &start);
+        virtual ~TimerWheel();
+
+        /**
+         * Adds a timer that is due at absolute, on the monotonic clock.
+         * scheduledTime is when it was scheduled, and is used only to
+         * report latency.
+         */
+        void Add(const boost::shared_ptr<Timer> &timer,
+                 const Timespec &absolute,
+                 const Timespec &scheduledTime);
+
+        /**
+         * Moves every timer that is due by now out of the wheel and
+         * appends it to expired. Earlier ticks come first. Destroyed
+         * timers are dropped. Returns the number of timers appended.
+         */
+        size_t Expire(const Timespec &now, std::vector<Expired> &expired);
+
+        /**
+         * Sets next to the time the wheel next has work to do: either a
+         * slot with timers in it comes due, or a coarser slot has to be
+         * placed again. Returns false if nothing is pending.
+         */
+        bool GetNextExpiry(Timespec &next) const;
+
+        /**
+         * The number of pending entries. This includes destroyed timers
+         * whose entries have not been reclaimed yet.
+         */
+        size_t Size() const { return mCount; }
+        bool IsEmpty() const { return mCount == 0; }
+
+        const Timespec & GetTick() const { return mTick; }
+
+    private:
+        struct Entry
+        {
+            boost::weak_ptr<Timer> mTimer;
+            Timespec mAbsolute;
+            Timespec mScheduledTime;
+            int mNext;
+        };
+
+        uint64_t tickFor(const Timespec &absolute) const;
+        Timespec timeFor(uint64_t tick) const;
+        void place(int entry);
+        void cascade(unsigned int level);
+        void release(int entry);
+
+        const Timespec mTick;
+        const Timespec mStart;
+        const int64_t mTickNanosec;
+
+        // the next tick Expire() has to process
+        uint64_t mCurrent;
+        size_t mCount;
+
+        std::vector<Entry> mEntries;
+        int mFree;
+
+        // list heads, -1 when empty: the first level, then the others
+        std::vector<int> mSlots;
+    };
+};
+
+#endif
@@ -0,0 +1,490 @@
+#include "WorkStealingDispatcher.h"
+#include "LogManager.h"
+#include "Foreach.h"
+#include "FTrace.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <stdlib.h>
+
+using namespace boost;
+using namespace Forte;
+
+// the worker running on this thread, if any. lets a handler that
+// enqueues more work put it on its own deque
+static __thread WorkStealingDispatcherWorker* sCurrentWorker = NULL;
+
+static void futexWait(volatile int* addr, int value, const Timespec& timeout)
+{
+    struct timespec ts = timeout;
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, &ts, NULL, 0);
+}
+
+static void futexWake(volatile int* addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+////////////////////////////// Work stealing dispatcher worker
+
+Forte::WorkStealingDispatcherWorker::WorkStealingDispatcherWorker(
+    WorkStealingDispatcher &disp,
+    unsigned int index)
+    : DispatcherWorkerThread(
+        disp,
+        boost::shared_ptr<Event>() // work will pull events from deques
+        ),
+      mIndex(index),
+      mRandomSeed(index * 2654435761U ^ static_cast<unsigned int>(time(NULL))),
+      mParked(0),
+      mWakeup(0),
+      mMonotonicClock(),
+      mLastPeriodicCall(mMonotonicClock.GetTime().AsSeconds())
+{
+    FTRACE;
+    initialized();
+}
+
+Forte::WorkStealingDispatcherWorker::~WorkStealingDispatcherWorker()
+{
+    FTRACE;
+    deleting();
+}
+
+void Forte::WorkStealingDispatcherWorker::push(const boost::shared_ptr<Event>& e)
+{
+    AutoUnlockMutex lock(mDequeLock);
+    mDeque.push_back(e);
+}
+
+boost::shared_ptr<Event> Forte::WorkStealingDispatcherWorker::pop(void)
+{
+    boost::shared_ptr<Event> event;
+    AutoUnlockMutex lock(mDequeLock);
+    if (!mDeque.empty())
+    {
+        event.swap(mDeque.front());
+        mDeque.pop_front();
+    }
+    return event;
+}
+
+boost::shared_ptr<Event> Forte::WorkStealingDispatcherWorker::stealInto(
+    WorkStealingDispatcherWorker& thief)
+{
+    std::vector<boost::shared_ptr<Event> > stolen;
+    {
+        AutoUnlockMutex lock(mDequeLock);
+        size_t count = (mDeque.size() + 1) / 2;
+        if (count == 0)
+            return boost::shared_ptr<Event>();
+
+        // take from the back, the owner works from the front
+        stolen.assign(mDeque.end() - count, mDeque.end());
+        mDeque.erase(mDeque.end() - count, mDeque.end());
+    }
+
+    if (stolen.size() > 1)
+    {
+        AutoUnlockMutex lock(thief.mDequeLock);
+        thief.mDeque.insert(thief.mDeque.end(), stolen.begin() + 1, stolen.end());
+    }
+    return stolen.front();
+}
+
+void Forte::WorkStealingDispatcherWorker::runEvent(
+    const boost::shared_ptr<Event>& event)
+{
+    WorkStealingDispatcher &disp(
+        dynamic_cast<WorkStealingDispatcher&>(mDispatcher));
+
+    setEvent(event);
+    // set start time
+    gettimeofday(&(event->mStartTime), NULL);
+    disp.recordQueueWait(*event);
+    try
+    {
+        disp.mRequestHandler->Handler(getRawEventPointer());
+    }
+    catch (EThreadShutdown &e)
+    {
+        //normal
+    }
+    catch (EWorkStealingDispatcherShuttingDown &e)
+    {
+        // normal
+    }
+    catch (std::exception &e)
+    {
+        hlog(HLOG_ERR, "exception thrown in event handler: %s", e.what());
+    }
+    catch (...)
+    {
+        hlog(HLOG_ERR, "unknown exception thrown in event handler");
+    }
+    // event will be deleted HERE, unless it was requeued
+    clearEvent();
+}
+
+void Forte::WorkStealingDispatcherWorker::park(const Timespec& timeout)
+{
+    WorkStealingDispatcher &disp(
+        dynamic_cast<WorkStealingDispatcher&>(mDispatcher));
+
+    mWakeup = 0;
+    mParked = 1;
+    // enqueuers push and then look for parked workers, so announce
+    // before the last look at the deques
+    __sync_add_and_fetch(&disp.mParkedCount, 1);
+
+    if (!disp.hasRunnableWork() && !Thread::IsShuttingDown())
+    {
+        futexWait(&mWakeup, 0, timeout);
+    }
+
+    mParked = 0;
+    __sync_sub_and_fetch(&disp.mParkedCount, 1);
+}
+
+bool Forte::WorkStealingDispatcherWorker::wake(void)
+{
+    if (mParked && __sync_bool_compare_and_swap(&mWakeup, 0, 1))
+    {
+        futexWake(&mWakeup);
+        return true;
+    }
+    return false;
+}
+
+void * Forte::WorkStealingDispatcherWorker::run(void)
+{
+    FTRACE;
+
+    WorkStealingDispatcher &disp(
+        dynamic_cast<WorkStealingDispatcher&>(mDispatcher));
+    mThreadName.Format("%s-ws", mDispatcher.mDispatcherName.c_str());
+    hlog(HLOG_DEBUG3, "initializing...");
+    sCurrentWorker = this;
+    // call the request handler's initialization hook
+    disp.mRequestHandler->Init();
+    disp.waitForStart();
+
+    const Timespec parkTimeout(Timespec::FromMillisec(1000));
+    while (!Thread::IsShuttingDown())
+    {
+        boost::shared_ptr<Event> event;
+        if (!disp.mPausedFlag || disp.mStopping)
+        {
+            event = pop();
+            if (!event)
+                event = disp.steal(*this);
+        }
+
+        if (event)
+        {
+            disp.dequeued();
+            runEvent(event);
+            continue;
+        }
+
+        // wake up every second
+        park(parkTimeout);
+
+        // see if we need to run periodic
+        struct timespec now;
+        mMonotonicClock.GetTime(now);
+        if (disp.mRequestHandler->mTimeout != 0 &&
+            static_cast<unsigned int>
+            (now.tv_sec - mLastPeriodicCall) > disp.mRequestHandler->mTimeout)
+        {
+            disp.mRequestHandler->Periodic();
+            mLastPeriodicCall = now.tv_sec;
+        }
+    }
+
+    disp.mRequestHandler->Cleanup();
+    sCurrentWorker = NULL;
+    hlog(HLOG_DEBUG2, "Thread shutdown");
+    return NULL;
+}
+
+////////////////////////////// Work stealing dispatcher
+
+Forte::WorkStealingDispatcher::WorkStealingDispatcher(
+    boost::shared_ptr<RequestHandler> requestHandler,
+    const int numThreads,
+    const int maxDepth,
+    const char *name)
+    : Dispatcher(requestHandler, maxDepth, name),
+      mMaxDepth(maxDepth > 0 ? maxDepth : 1),
+      mStarted(false),
+      mQueued(0),
+      mParkedCount(0),
+      mEnqueuersWaiting(0),
+      mStopping(0),
+      mPausedFlag(0),
+      mNextWorker(0)
+{
+    FTRACE;
+
+    {
+        AutoUnlockMutex lock(mThreadsLock);
+        for (int i = 0; i < std::max(numThreads, 1); ++i)
+        {
+            hlog(HLOG_DEBUG2, "%s: Creating work stealing worker %i",
+                 mDispatcherName.c_str(), i);
+            boost::shared_ptr<WorkStealingDispatcherWorker> worker(
+                new WorkStealingDispatcherWorker(*this, i));
+            mWorkers.push_back(worker.get());
+            mThreads.push_back(worker);
+        }
+    }
+
+    // workers look at each other's deques, let them go once the set
+    // of workers is final
+    AutoUnlockMutex lock(mNotifyLock);
+    mStarted = true;
+    mNotify.Broadcast();
+}
+
+Forte::WorkStealingDispatcher::~WorkStealingDispatcher()
+{
+    FTRACE;
+    if (!IsShuttingDown())
+        Shutdown();
+}
+
+void Forte::WorkStealingDispatcher::waitForStart(void)
+{
+    AutoUnlockMutex lock(mNotifyLock);
+    while (!mStarted)
+        mNotify.Wait();
+}
+
+void Forte::WorkStealingDispatcher::Shutdown(void)
+{
+    FTRACE;
+
+    Dispatcher::Shutdown();
+    if (__sync_lock_test_and_set(&mStopping, 1))
+        return;
+    __sync_synchronize();
+
+    // run what is already queued, waking anyone blocked in Enqueue
+    wakeAll();
+    {
+        AutoUnlockMutex lock(mNotifyLock);
+        mNotify.Broadcast();
+        while (mQueued > 0)
+            mNotify.Wait();
+    }
+
+    hlog(HLOG_DEBUG2,
+         "'%s' dispatcher shutting down, waiting for threads to exit...",
+         mDispatcherName.c_str());
+
+    AutoUnlockMutex lock(mThreadsLock);
+    foreach (boost::shared_ptr<DispatcherWorkerThread> &thr, mThreads)
+    {
+        thr->Shutdown();
+    }
+    // pairs with park(), which announces itself before checking
+    // whether its thread is shutting down
+    __sync_synchronize();
+    wakeAll();
+
+    // workers have a reference to the dispatcher, make sure they are
+    // gone before it is
+    foreach (boost::shared_ptr<DispatcherWorkerThread> &thr, mThreads)
+    {
+        thr->WaitForShutdown();
+    }
+    mWorkers.clear();
+    mThreads.clear();
+    hlog(HLOG_DEBUG2, "'%s' dispatcher shutdown complete",
+         mDispatcherName.c_str());
+}
+
+void Forte::WorkStealingDispatcher::Pause(void)
+{
+    AutoUnlockMutex lock(mNotifyLock);
+    mPaused = true;
+    mPausedFlag = 1;
+}
+
+void Forte::WorkStealingDispatcher::Resume(void)
+{
+    {
+        AutoUnlockMutex lock(mNotifyLock);
+        mPaused = false;
+        mPausedFlag = 0;
+    }
+    wakeAll();
+}
+
+void Forte::WorkStealingDispatcher::Enqueue(boost::shared_ptr<Event> e)
+{
+    if (!e)
+        throw EEventQueueEventInvalid();
+    if (mStopping)
+        throw EWorkStealingDispatcherShuttingDown(
+            "dispatcher is shutting down; no new events are being accepted");
+
+    reserveQueueSlot();
+    // Shutdown sets mStopping and then waits for mQueued to drain, so
+    // either it waits for this event or we see that it is stopping
+    if (mStopping)
+    {
+        dequeued();
+        throw EWorkStealingDispatcherShuttingDown(
+            "dispatcher is shutting down; no new events are being accepted");
+    }
+
+    unsigned int target;
+    if (sCurrentWorker != NULL && &sCurrentWorker->mDispatcher == this)
+    {
+        target = sCurrentWorker->mIndex;
+    }
+    else
+    {
+        target = __sync_fetch_and_add(&mNextWorker, 1) % mWorkers.size();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &e->mEnqueuedTime);
+    mWorkers[target]->push(e);
+
+    // the push has to be visible before we look for parked workers,
+    // pairs with park()
+    __sync_synchronize();
+    if (mParkedCount > 0)
+    {
+        wakeOne(target);
+    }
+}
+
+void Forte::WorkStealingDispatcher::reserveQueueSlot(void)
+{
+    while (true)
+    {
+        int queued = mQueued;
+        if (queued >= mMaxDepth)
+        {
+            AutoUnlockMutex lock(mNotifyLock);
+            __sync_add_and_fetch(&mEnqueuersWaiting, 1);
+            while (mQueued >= mMaxDepth && !mStopping)
+                mNotify.Wait();
+            __sync_sub_and_fetch(&mEnqueuersWaiting, 1);
+
+            if (mStopping)
+                throw EWorkStealingDispatcherShuttingDown(
+                    "dispatcher is shutting down; no new events are being accepted");
+            continue;
+        }
+
+        if (__sync_bool_compare_and_swap(&mQueued, queued, queued + 1))
+            return;
+    }
+}
+
+void Forte::WorkStealingDispatcher::dequeued(void)
+{
+    int queued = __sync_sub_and_fetch(&mQueued, 1);
+    if (mEnqueuersWaiting || (queued == 0 && mStopping))
+    {
+        AutoUnlockMutex lock(mNotifyLock);
+        mNotify.Broadcast();
+    }
+}
+
+bool Forte::WorkStealingDispatcher::hasRunnableWork(void) const
+{
+    return (!mPausedFlag || mStopping) && mQueued > 0;
+}
+
+boost::shared_ptr<Event> Forte::WorkStealingDispatcher::steal(
+    WorkStealingDispatcherWorker& thief)
+{
+    const unsigned int n = mWorkers.size();
+    if (n < 2 || mQueued == 0)
+        return boost::shared_ptr<Event>();
+
+    unsigned int start = rand_r(&thief.mRandomSeed) % n;
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        WorkStealingDispatcherWorker* victim = mWorkers[(start + i) % n];
+        if (victim == &thief)
+            continue;
+
+        boost::shared_ptr<Event> event(victim->stealInto(thief));
+        if (event)
+            return event;
+    }
+    return boost::shared_ptr<Event>();
+}
+
+void Forte::WorkStealingDispatcher::wakeOne(unsigned int preferred)
+{
+    const unsigned int n = mWorkers.size();
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        if (mWorkers[(preferred + i) % n]->wake())
+            return;
+    }
+}
+
+void Forte::WorkStealingDispatcher::wakeAll(void)
+{
+    foreach (WorkStealingDispatcherWorker* worker, mWorkers)
+    {
+        worker->wake();
+    }
+}
+
+bool Forte::WorkStealingDispatcher::Accepting(void)
+{
+    return !mStopping && mQueued < mMaxDepth;
+}
+
+int Forte::WorkStealingDispatcher::GetQueuedEvents(
+    int maxEvents,
+    std::list<boost::shared_ptr<Event> > &queuedEvents)
+{
+    AutoUnlockMutex thrLock(mThreadsLock);
+
+    int count = 0;
+    foreach (WorkStealingDispatcherWorker* worker, mWorkers)
+    {
+        AutoUnlockMutex lock(worker->mDequeLock);
+        foreach (const boost::shared_ptr<Event>& e, worker->mDeque)
+        {
+            if (count >= maxEvents)
+                return count;
+            queuedEvents.push_back(e);
+            ++count;
+        }
+    }
+    return count;
+}
+
+int Forte::WorkStealingDispatcher::GetRunningEvents(
+    int maxEvents,
+    std::list<boost::shared_ptr<Event> > &runningEvents)
+{
+    AutoUnlockMutex thrLock(mThreadsLock);
+
+    int count = 0;
+    foreach (WorkStealingDispatcherWorker* worker, mWorkers)
+    {
+        if (count >= maxEvents)
+            break;
+
+        // workers clear their event without the notify lock, so copy
+        // it under the event lock
+        AutoUnlockMutex lock(worker->mEventMutex);
+        if (worker->mEventPtr)
+        {
+            runningEvents.push_back(worker->mEventPtr);
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,134 @@
+#ifndef __WorkStealingDispatcher_h
+#define __WorkStealingDispatcher_h
+
+#include "Dispatcher.h"
+#include "Clock.h"
+#include <deque>
+
+/**
+ * WorkStealingDispatcher runs events on a fixed pool of workers. Each
+ * worker has its own deque of events instead of all workers sharing
+ * one EventQueue under the dispatcher's notify lock.
+ *
+ * Events enqueued from outside the pool are spread round robin over
+ * the workers, events enqueued by a handler go to the deque of the
+ * worker running it. A worker runs its own events in order, and when
+ * it runs out it steals half of the events queued on a randomly
+ * chosen worker. Idle workers park on a futex and the enqueuer wakes
+ * one of them directly, so the hot path never takes a lock shared by
+ * the whole pool.
+ *
+ * Usage:
+ * boost::shared_ptr<MyRequestHandler> myWorkHandler(new MyWorkHandler());
+ * WorkStealingDispatcher myDispatcher(myWorkHandler,
+ *                                     numThreads,
+ *                                     maxDepth,
+ *                                     "MyDispatcher");
+ *
+ * Shutdown runs the events that are already queued before stopping
+ * the workers, the same as ThreadPoolDispatcher.
+ */
+
+namespace Forte
+{
+    EXCEPTION_CLASS(EWorkStealingDispatcher);
+    EXCEPTION_SUBCLASS(EWorkStealingDispatcher,
+                       EWorkStealingDispatcherShuttingDown);
+
+    class WorkStealingDispatcher;
+
+    class WorkStealingDispatcherWorker : public DispatcherWorkerThread
+    {
+        friend class WorkStealingDispatcher;
+    public:
+        WorkStealingDispatcherWorker(WorkStealingDispatcher &disp,
+                                     unsigned int index);
+        virtual ~WorkStealingDispatcherWorker();
+
+    protected:
+        virtual void *run(void);
+
+        void push(const boost::shared_ptr<Event>& e);
+        boost::shared_ptr<Event> pop(void);
+
+        // move up to half of the events queued here into thief's
+        // deque, returning one of them to run right away
+        boost::shared_ptr<Event> stealInto(WorkStealingDispatcherWorker& thief);
+
+        void runEvent(const boost::shared_ptr<Event>& event);
+        void park(const Timespec& timeout);
+        bool wake(void);
+
+        unsigned int mIndex;
+        unsigned int mRandomSeed;
+
+        Mutex mDequeLock;
+        std::deque<boost::shared_ptr<Event> > mDeque;
+
+        // mParked is set while the worker is, or is about to be,
+        // asleep on mWakeup. mWakeup is the futex word
+        volatile int mParked;
+        volatile int mWakeup;
+
+        MonotonicClock mMonotonicClock;
+        time_t mLastPeriodicCall;
+    };
+
+    class WorkStealingDispatcher : public Dispatcher
+    {
+        friend class WorkStealingDispatcherWorker;
+    public:
+        WorkStealingDispatcher(
+            boost::shared_ptr<RequestHandler> requestHandler,
+            const int numThreads,
+            const int maxDepth,
+            const char *name);
+
+        virtual ~WorkStealingDispatcher();
+        virtual void Shutdown(void);
+        virtual void Pause(void);
+        virtual void Resume(void);
+
+        /**
+         * Queue an event. blocks while maxDepth events are queued.
+         */
+        virtual void Enqueue(boost::shared_ptr<Event> e);
+        virtual bool Accepting(void);
+
+        virtual int GetQueueDepth(void) { return mQueued; }
+
+        int GetQueuedEvents(
+            int maxEvents, std::list<boost::shared_ptr<Event> > &queuedEvents);
+        int GetRunningEvents(
+            int maxEvents, std::list<boost::shared_ptr<Event> > &runningEvents);
+
+    protected:
+        bool hasRunnableWork(void) const;
+        boost::shared_ptr<Event> steal(WorkStealingDispatcherWorker& thief);
+        void reserveQueueSlot(void);
+        void dequeued(void);
+        void wakeOne(unsigned int preferred);
+        void wakeAll(void);
+        void waitForStart(void);
+
+    protected:
+        const int mMaxDepth;
+        bool mStarted;
+
+        // fixed once the dispatcher is constructed, mThreads holds
+        // the owning pointers
+        std::vector<WorkStealingDispatcherWorker*> mWorkers;
+
+        // events sitting in a deque, including ones an enqueuer has
+        // reserved room for but not pushed yet
+        volatile int mQueued;
+        volatile int mParkedCount;
+        volatile int mEnqueuersWaiting;
+        volatile int mStopping;
+        volatile int mPausedFlag;
+        volatile unsigned int mNextWorker;
+    };
+
+    typedef boost::shared_ptr<WorkStealingDispatcher> WorkStealingDispatcherPtr;
+};
+#endif
@@ -747,6 +747,7 @@ void Table::generateCode(void) const
     genPrimaryCtor(h,c);
     genDtor(h,c);
     genSet(h,c);
+    genSetStatement(h,c);
     genSetOrig(h,c);
     fprintf(h, "\n");
     genCount(h,c);
@@ -929,12 +930,10 @@ void Table::genPrimaryCtor(FILE *h, FILE *c) const
     fprintf(c, "%s::%s(Forte::DbConnection &db, %s)\n",
             mClassname.c_str(), mClassname.c_str(), keyParamStr.c_str());
     fprintf(c, "{\n");
-    fprintf(c, "    Forte::DbResult res = %s::SelectPrimaryKey(db, %s);\n",
+    fprintf(c, "    Forte::DbResult res = %s::UsePrimaryKey(db, %s);\n",
             mClassname.c_str(), paramStr.c_str());
-    fprintf(c, "    Forte::DbResultRow row;\n");
-    fprintf(c, "    if (!res.FetchRow(row))\n");
+    fprintf(c, "    if (!res.FetchRow(*this))\n");
     fprintf(c, "        boost::throw_exception(Forte::DbLookupFailedException(\"invalid %s\"));\n", paramStr.c_str());
-    fprintf(c, "    Set(row);\n");
     fprintf(c, "}\n");
 }
 void Table::genDtor(FILE *h, FILE *c) const
@@ -959,6 +958,32 @@ void Table::genSet(FILE *h, FILE *c) const
     fprintf(c, "    dbc_original_loaded = true;\n"); // mark as original loaded
     fprintf(c, "}\n");
 }
+void Table::genSetStatement(FILE *h, FILE *c) const
+{
+    // the same as Set(row), with each value read from a streamed
+    // sqlite row in its own type. declared unconditionally, like
+    // DbRow's, so the class is the same with or without
+    // FORTE_WITH_SQLITE
+    fprintf(h, "    virtual void Set(sqlite3_stmt *stmt);\n");
+    fprintf(c, "void %s::Set(sqlite3_stmt *stmt)\n", mClassname.c_str());
+    fprintf(c, "{\n");
+    fprintf(c, "#ifndef FORTE_WITH_SQLITE\n");
+    fprintf(c, "    Forte::DbRow::Set(stmt);\n");
+    fprintf(c, "#else\n");
+    int i = 0;
+    foreach(YYSTYPE a, mColumns)
+    {
+        const TableColumn &tc(TC(TableColumn,a));
+        if (tc.mOptions & OPT_IN_PRIMARY_KEY)
+            fprintf(c, "    %s = %s = %s(stmt, %d);\n", tc.cName().c_str(),
+                    tc.cOriginalName().c_str(), tc.cGetter().c_str(), i++);
+        else
+            fprintf(c, "    %s = %s(stmt, %d);\n", tc.cName().c_str(), tc.cGetter().c_str(), i++);
+    }
+    fprintf(c, "    dbc_original_loaded = true;\n"); // mark as original loaded
+    fprintf(c, "#endif\n");
+    fprintf(c, "}\n");
+}
 void Table::genSetOrig(FILE *h, FILE *c) const
 {
     fprintf(h, "    void SetOrig(void);\n");
@@ -1043,46 +1068,48 @@ void Table::genSelectAlias(FILE *h, FILE *c) const
 }
 void Table::genSelectPrimaryKey(FILE *h, FILE *c) const
 {
-    // generate string and parameters to sql.Format() call
-    std::vector<FString> formatStrV, formatParamV;
-    FString formatStr, formatParams;
-    bool empty = true;
+    genPrimaryKeyQuery(h, c, "SelectPrimaryKey", "DbStore");
+    // a streamed result, for FetchRow(DbRow&)
+    genPrimaryKeyQuery(h, c, "UsePrimaryKey", "DbUse");
+}
+void Table::genPrimaryKeyQuery(FILE *h, FILE *c, const char *name, const char *run) const
+{
+    // the statement text is fixed and the key values are bound, so
+    // connections that prepare statements only do so once
+    std::vector<FString> cols, whereV, keyParamV;
+    FString colstr, whereStr, keyParamStr;
     foreach(YYSTYPE a, mColumns)
     {
         const TableColumn &tc(TC(TableColumn,a));
+        cols.push_back(aliasPrefix() + tc.sqlName());
         if (tc.mOptions & OPT_IN_PRIMARY_KEY)
         {
-            empty = false;
-            formatStrV.push_back(tc.cFormatStr(aliasPrefix()));
-            formatParamV.push_back(tc.cFormatParam(tc.mName));
+            whereV.push_back(aliasPrefix() + tc.sqlName() + " = ?");
+            keyParamV.push_back(FString(FStringFC(),
+                                        "%s %s", tc.cPODType().c_str(), tc.mName.c_str()));
         }
     }
-    if (empty) return;
-    formatStr.Implode(" AND ", formatStrV);
-    formatParams.Implode(", ", formatParamV);
+    if (whereV.empty()) return;
+    colstr.Implode(", ", cols);
+    whereStr.Implode(" AND ", whereV);
+    keyParamStr.Implode(", ", keyParamV);
 
-    // generate parameters to function call
-    std::vector<FString> keyParamV;
-    FString keyParamStr;
+    fprintf(h, "    static Forte::DbResult %s(Forte::DbConnection &db, %s);\n",
+            name, keyParamStr.c_str());
+    fprintf(c, "Forte::DbResult %s::%s(Forte::DbConnection &db, %s)\n",
+            mClassname.c_str(), name, keyParamStr.c_str());
+    fprintf(c, "{\n");
+    fprintf(c, "    Forte::SelectDbSqlStatement statement(\n");
+    fprintf(c, "        \"SELECT %s FROM %s%s%s WHERE %s\");\n",
+            colstr.c_str(), mName.c_str(), (mAlias.empty())?"":" ",
+            mAlias.c_str(), whereStr.c_str());
     foreach(YYSTYPE a, mColumns)
     {
         const TableColumn &tc(TC(TableColumn,a));
         if (tc.mOptions & OPT_IN_PRIMARY_KEY)
-        {
-            keyParamV.push_back(FString(FStringFC(),
-                                        "%s %s", tc.cPODType().c_str(), tc.mName.c_str()));
-        }
+            genBind(c, tc, tc.mName);
     }
-    keyParamStr.Implode(", ", keyParamV);
-
-    fprintf(h, "    static Forte::DbResult SelectPrimaryKey(Forte::DbConnection &db, %s);\n", keyParamStr.c_str());
-    fprintf(c, "Forte::DbResult %s::SelectPrimaryKey(Forte::DbConnection &db, %s)\n",
-            mClassname.c_str(), keyParamStr.c_str());
-    fprintf(c, "{\n");
-    fprintf(c, "    Forte::FString sql;\n");
-    fprintf(c, "    sql.Format(\" WHERE %s \",\n",formatStr.c_str());
-    fprintf(c, "               %s);\n", formatParams.c_str());
-    fprintf(c, "    return Select(db, sql);\n");
+    fprintf(c, "    return Forte::DbUtil::%s(db, statement);\n", run);
     fprintf(c, "}\n");
 }
 
@@ -1215,27 +1242,31 @@ void Table::genInsert(FILE *h, FILE *c, bool keynoauto, bool set) const
     else if (mModifiedColumn)
         fprintf(c, "    %s = time(0);\n",
                 TC(TableColumn,mModifiedColumn).cName().c_str());
-    fprintf(c, "    Forte::FString sql;\n");
-    fprintf(c, "    sql.Format(\"INSERT INTO %s \"\n", mName.c_str());
-    if (keynoauto && set)
-    {
-        fprintf(c, "               \"(%%s, %%s) VALUES (%%s, %%s) \",\n");
-        fprintf(c, "               keyNoAutoColumnSql(db).c_str(), setColumnSql(db).c_str(),\n");
-        fprintf(c, "               keyNoAutoValueSql(db).c_str(), setValueSql(db).c_str());\n");
-    }
-    else if (keynoauto)
-    {
-        fprintf(c, "               \"(%%s) VALUES (%%s) \",\n");
-        fprintf(c, "               keyNoAutoColumnSql(db).c_str(), keyNoAutoValueSql(db).c_str());\n");
-    }
-    else if (set)
+    if (!(mOptions & OPT_CUSTOMSET))
+        genInsertStatement(c, keynoauto, set);
+    else
     {
-        fprintf(c, "               \"(%%s) VALUES (%%s)\",\n");
-        fprintf(c, "               setColumnSql(db).c_str(), setValueSql(db).c_str());\n");
-    }
-    else // no setSql() call and no settable key columns.
-        throw Exception(FStringFC(), "%s::insert() cannot be generated (has no setSql())",
-                         mName.c_str());
+        fprintf(c, "    Forte::FString sql;\n");
+        fprintf(c, "    sql.Format(\"INSERT INTO %s \"\n", mName.c_str());
+        if (keynoauto && set)
+        {
+            fprintf(c, "               \"(%%s, %%s) VALUES (%%s, %%s) \",\n");
+            fprintf(c, "               keyNoAutoColumnSql(db).c_str(), setColumnSql(db).c_str(),\n");
+            fprintf(c, "               keyNoAutoValueSql(db).c_str(), setValueSql(db).c_str());\n");
+        }
+        else if (keynoauto)
+        {
+            fprintf(c, "               \"(%%s) VALUES (%%s) \",\n");
+            fprintf(c, "               keyNoAutoColumnSql(db).c_str(), keyNoAutoValueSql(db).c_str());\n");
+        }
+        else if (set)
+        {
+            fprintf(c, "               \"(%%s) VALUES (%%s)\",\n");
+            fprintf(c, "               setColumnSql(db).c_str(), setValueSql(db).c_str());\n");
+        }
+        else // no setSql() call and no settable key columns.
+            throw Exception(FStringFC(), "%s::insert() cannot be generated (has no setSql())",
+                             mName.c_str());
 
 /////////////////////////////
 //     if (keynoauto && set)
@@ -1258,7 +1289,9 @@ void Table::genInsert(FILE *h, FILE *c, bool keynoauto, bool set) const
 //                          mName.c_str());
 //////////////////////////////
 
-    fprintf(c, "    Forte::DbUtil::DbExecute(db, Forte::InsertDbSqlStatement(sql));\n");
+        fprintf(c, "    Forte::InsertDbSqlStatement statement(sql);\n");
+    }
+    fprintf(c, "    Forte::DbUtil::DbExecute(db, statement);\n");
     if (mAutoIncrementColumn)
         fprintf(c, "    %s = db.InsertID();\n",
                 TC(TableColumn,mAutoIncrementColumn).cName().c_str());
@@ -1267,6 +1300,48 @@ void Table::genInsert(FILE *h, FILE *c, bool keynoauto, bool set) const
     fprintf(c, "}\n");
     fprintf(c, "\n");
 }
+void Table::genInsertStatement(FILE *c, bool keynoauto, bool set) const
+{
+    // the same columns as the formatted INSERT, with the values bound
+    std::vector<FString> columnStrV, valueStrV;
+    FString columnStr, valueStr;
+    std::vector<YYSTYPE> bound;
+    if (keynoauto)
+    {
+        foreach(YYSTYPE a, mColumns)
+        {
+            const TableColumn &tc(TC(TableColumn,a));
+            if (tc.mOptions & OPT_IN_PRIMARY_KEY &&
+                !(tc.mOptions & OPT_AUTO_INCREMENT))
+                bound.push_back(a);
+        }
+    }
+    if (set)
+    {
+        foreach(YYSTYPE a, mColumns)
+            if ((TC(TableColumn,a).mOptions & OPT_IN_PRIMARY_KEY) == 0)
+                bound.push_back(a);
+    }
+    if (bound.empty()) // no setSql() call and no settable key columns.
+        throw Exception(FStringFC(), "%s::insert() cannot be generated (has no setSql())",
+                         mName.c_str());
+    foreach(YYSTYPE a, bound)
+    {
+        columnStrV.push_back(TC(TableColumn,a).sqlName());
+        valueStrV.push_back("?");
+    }
+    columnStr.Implode(", ", columnStrV);
+    valueStr.Implode(", ", valueStrV);
+
+    fprintf(c, "    Forte::InsertDbSqlStatement statement(\n");
+    fprintf(c, "        \"INSERT INTO %s (%s) VALUES (%s)\");\n",
+            mName.c_str(), columnStr.c_str(), valueStr.c_str());
+    foreach(YYSTYPE a, bound)
+    {
+        const TableColumn &tc(TC(TableColumn,a));
+        genBind(c, tc, tc.cName());
+    }
+}
 void Table::genUpdate(FILE *h, FILE *c, bool set, bool where) const
 {
     if (!set || !where) return;
@@ -1276,16 +1351,54 @@ void Table::genUpdate(FILE *h, FILE *c, bool set, bool where) const
     if (mModifiedColumn)
         fprintf(c, "    %s = time(0);\n",
                 TC(TableColumn,mModifiedColumn).cName().c_str());
-    fprintf(c, "    Forte::FString sql;\n");
-    fprintf(c, "    sql.Format(\"UPDATE %s \"\n", mName.c_str());
-    fprintf(c, "               \"SET %%s \"\n");
-    fprintf(c, "               \"WHERE %%s \",\n");
-    fprintf(c, "               setSql(db).c_str(), whereSql(db).c_str());\n");
-    fprintf(c, "    Forte::DbUtil::DbExecute(db, Forte::UpdateDbSqlStatement(sql));\n");
+    if (!(mOptions & OPT_CUSTOMSET))
+        genUpdateStatement(c);
+    else
+    {
+        fprintf(c, "    Forte::FString sql;\n");
+        fprintf(c, "    sql.Format(\"UPDATE %s \"\n", mName.c_str());
+        fprintf(c, "               \"SET %%s \"\n");
+        fprintf(c, "               \"WHERE %%s \",\n");
+        fprintf(c, "               setSql(db).c_str(), whereSql(db).c_str());\n");
+        fprintf(c, "    Forte::UpdateDbSqlStatement statement(sql);\n");
+    }
+    fprintf(c, "    Forte::DbUtil::DbExecute(db, statement);\n");
     fprintf(c, "    SetOrig();\n");
     fprintf(c, "}\n");
     fprintf(c, "\n");
 }
+void Table::genUpdateStatement(FILE *c) const
+{
+    // the columns of setSql() and whereSql(), with the values bound
+    std::vector<FString> setStrV, whereStrV;
+    FString setStr, whereStr;
+    foreach(YYSTYPE a, mColumns)
+    {
+        const TableColumn &tc(TC(TableColumn,a));
+        if (tc.mOptions & OPT_IN_PRIMARY_KEY)
+            whereStrV.push_back(tc.sqlName() + " = ?");
+        else
+            setStrV.push_back(tc.sqlName() + " = ?");
+    }
+    setStr.Implode(", ", setStrV);
+    whereStr.Implode(" AND ", whereStrV);
+
+    fprintf(c, "    Forte::UpdateDbSqlStatement statement(\n");
+    fprintf(c, "        \"UPDATE %s SET %s WHERE %s\");\n",
+            mName.c_str(), setStr.c_str(), whereStr.c_str());
+    foreach(YYSTYPE a, mColumns)
+    {
+        const TableColumn &tc(TC(TableColumn,a));
+        if ((tc.mOptions & OPT_IN_PRIMARY_KEY) == 0)
+            genBind(c, tc, tc.cName());
+    }
+    foreach(YYSTYPE a, mColumns)
+    {
+        const TableColumn &tc(TC(TableColumn,a));
+        if (tc.mOptions & OPT_IN_PRIMARY_KEY)
+            genBind(c, tc, tc.cName());
+    }
+}
 void Table::genFKInclude(FILE *c) const
 {
     foreach (YYSTYPE k, mForeignKeys)
@@ -1364,38 +1477,30 @@ void Table::genUpdateKey(FILE *h, FILE *c, bool key, bool set, bool where) const
 void Table::genRefresh(FILE *h, FILE *c, bool where) const
 {
     if (!where) return;
-    // generate string and parameters to sql.Format() call
-    std::vector<FString> formatStrV, formatParamV;
-    FString formatStr, formatParams;
-    bool empty = true;
+    std::vector<FString> paramV;
+    FString paramStr;
     foreach(YYSTYPE a, mColumns)
     {
         const TableColumn &tc(TC(TableColumn,a));
         if (tc.mOptions & OPT_IN_PRIMARY_KEY)
-        {
-            empty = false;
-            formatStrV.push_back(tc.cFormatStr(aliasPrefix()));
-            formatParamV.push_back(tc.cFormatParam(tc.cName()));
-        }
+            paramV.push_back(tc.cName());
     }
-    if (empty) return;
-    formatStr.Implode(" AND ", formatStrV);
-    formatParams.Implode(", ", formatParamV);
+    if (paramV.empty()) return;
+    paramStr.Implode(", ", paramV);
 
     fprintf(h, "    void Refresh(Forte::DbConnection &db);\n");
     fprintf(c, "void %s::Refresh(Forte::DbConnection &db)\n", mClassname.c_str());
     fprintf(c, "{\n");
-    fprintf(c, "    Forte::FString sql;\n");
-    fprintf(c, "    sql.Format(\" WHERE %s \",\n",formatStr.c_str());
-    fprintf(c, "               %s);\n", formatParams.c_str());
-    fprintf(c, "    Forte::DbResult res = Select(db, sql);\n");
-    fprintf(c, "    Forte::DbResultRow row;\n");
-    fprintf(c, "    if (!res.FetchRow(row))\n");
+    fprintf(c, "    Forte::DbResult res = UsePrimaryKey(db, %s);\n", paramStr.c_str());
+    fprintf(c, "    if (!res.FetchRow(*this))\n");
     fprintf(c, "        boost::throw_exception(Forte::DbException(\"unable to refresh object\"));\n");
-    fprintf(c, "    Set(row);\n");
     fprintf(c, "}\n");
     fprintf(c, "\n");
 }
+void Table::genBind(FILE *c, const TableColumn &tc, const FString &name) const
+{
+    fprintf(c, "    statement.%s(%s);\n", tc.cBinder().c_str(), name.c_str());
+}
 
 void Table::callFKRestrict(FILE *c, bool update) const
 {
@@ -2110,6 +2215,24 @@ FString TableColumn::cGetter(void) const
     }
     throw Exception("Unknown getter");
 }
+FString TableColumn::cBinder(void) const
+{
+    // output DbSqlStatement bind method
+    if (mType->GetType() == typeid(BlobType)) {
+        return "BindBlob";
+    } else if (mType->GetType() == typeid(CharType) ||
+               mType->GetType() == typeid(VarCharType) ||
+               mType->GetType() == typeid(LongTextType) ||
+               mType->GetType() == typeid(TextType)) {
+        return "BindText";
+    } else if (mType->GetType() == typeid(BigIntType) ||
+               mType->GetType() == typeid(BooleanType) ||
+               mType->GetType() == typeid(IntType) ||
+               mType->GetType() == typeid(TinyIntType)) {
+        return "BindInt";
+    }
+    throw Exception("Unknown binder");
+}
 FString TableColumn::cOriginalName(void) const
 {
     return "dbc_original_" + cName();
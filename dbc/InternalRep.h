@@ -239,6 +239,7 @@ namespace DBC {
         bool cTypeNeedsZeroInit(void) const;                 // false
         FString cPODType(void) const;                        // const char *
         FString cGetter(void) const;                         // GetString
+        FString cBinder(void) const;                         // BindText
         FString cName(void) const;                           // mInstanceGUID
         FString cOriginalName(void) const;                   // dbc_original_mInstanceGUID
         FString cFormatElement(void) const;                  // '%s'
@@ -374,11 +375,13 @@ namespace DBC {
         void genPrimaryCtor(FILE *h, FILE *c) const;
         void genDtor(FILE *h, FILE *c) const;
         void genSet(FILE *h, FILE *c) const;
+        void genSetStatement(FILE *h, FILE *c) const;
         void genSetOrig(FILE *h, FILE *c) const;
         void genCount(FILE *h, FILE *c) const;
         void genSelect(FILE *h, FILE *c) const;
         void genSelectAlias(FILE *h, FILE *c) const;
         void genSelectPrimaryKey(FILE *h, FILE *c) const;
+        void genPrimaryKeyQuery(FILE *h, FILE *c, const char *name, const char *run) const;
         void genCounts(FILE *h, FILE *c) const;
         void genSelectors(FILE *h, FILE *c) const;
         void genDeletors(FILE *h, FILE *c) const;
@@ -387,10 +390,13 @@ namespace DBC {
         void genCtors(FILE *h, FILE *c) const;
         void genReplace(FILE *h, FILE *c, bool key, bool set) const;
         void genInsert(FILE *h, FILE *c, bool key, bool set) const;
+        void genInsertStatement(FILE *c, bool keynoauto, bool set) const;
         void genUpdate(FILE *h, FILE *c, bool set, bool where) const;
+        void genUpdateStatement(FILE *c) const;
         void genUpdateKey(FILE *h, FILE *c, bool key, bool set, bool where) const;
         void genDeleteMe(FILE *h, FILE *c, bool where) const;
         void genRefresh(FILE *h, FILE *c, bool where) const;
+        void genBind(FILE *c, const TableColumn &tc, const FString &name) const;
 
         void genFKInclude(FILE *c) const;
         void genFKMethods(FILE *h, FILE *c) const;
@@ -0,0 +1,161 @@
+#include "Exception.h"
+#include "LogManager.h"
+#include "BinaryLogfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * logdecode renders log files written by BinaryLogfile in the text
+ * format LogManager writes, optionally keeping only messages at some
+ * levels, from one thread, or within a time range.
+ */
+
+using namespace Forte;
+
+namespace
+{
+    // gives access to the text formatting of Logfile
+    class TextRenderer : public Logfile
+    {
+    public:
+        TextRenderer() : Logfile("//stdout", NULL) {}
+        FString Render(const LogMsg &msg) { return formatMsg(msg); }
+    };
+
+    void usage(void)
+    {
+        fprintf(stderr,
+                "usage: logdecode [-l levels] [-t thread] [-s start] [-e end] file...\n"
+                "  -l levels  only messages at these levels, e.g. 'NODEBUG' or 'ERR | WARN'\n"
+                "  -t thread  only messages from this thread id or thread name\n"
+                "  -s start   only messages at or after start\n"
+                "  -e end     only messages before end\n"
+                "times are seconds since the epoch, 'YYYY-MM-DD HH:MM:SS' or\n"
+                "'MM/DD/YY HH:MM:SS' as printed in the log, in local time\n");
+        exit(2);
+    }
+
+    time_t parseTime(const char *str)
+    {
+        char *end;
+        const long long seconds(strtoll(str, &end, 10));
+        if (*str != 0 && *end == 0)
+            return seconds;
+
+        static const char *formats[] = {
+            "%Y-%m-%d %H:%M:%S",
+            "%Y-%m-%dT%H:%M:%S",
+            "%m/%d/%y %H:%M:%S",
+            "%Y-%m-%d",
+            NULL
+        };
+        for (const char **format = formats; *format != NULL; ++format)
+        {
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            const char *rest(strptime(str, *format, &tm));
+            if (rest != NULL && *rest == 0)
+            {
+                tm.tm_isdst = -1;
+                return mktime(&tm);
+            }
+        }
+        fprintf(stderr, "logdecode: can not parse time '%s'\n", str);
+        usage();
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // only here to parse level names, nothing is logged
+    LogManager logManager;
+
+    unsigned int levels(HLOG_ALL);
+    const char *thread(NULL);
+    bool haveStart(false), haveEnd(false);
+    time_t start(0), end(0);
+
+    int c;
+    while ((c = getopt(argc, argv, "l:t:s:e:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'l':
+            try
+            {
+                levels = logManager.ComputeLogMaskFromString(optarg);
+            }
+            catch (ELogLevelStringUnknown &e)
+            {
+                fprintf(stderr, "logdecode: %s\n", e.what());
+                usage();
+            }
+            break;
+        case 't':
+            thread = optarg;
+            break;
+        case 's':
+            start = parseTime(optarg);
+            haveStart = true;
+            break;
+        case 'e':
+            end = parseTime(optarg);
+            haveEnd = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind >= argc)
+        usage();
+
+    char *threadEnd(NULL);
+    const unsigned long threadID(thread ? strtoul(thread, &threadEnd, 10) : 0);
+    const bool threadIsID(thread && *thread != 0 && *threadEnd == 0);
+
+    TextRenderer renderer;
+    int status(0);
+    for (int i = optind; i < argc; ++i)
+    {
+        try
+        {
+            BinaryLogReader reader(argv[i]);
+            LogMsg msg;
+            while (reader.Next(msg))
+            {
+                if (!(msg.mLevel & levels))
+                    continue;
+                if (haveStart && msg.mTime.tv_sec < start)
+                    continue;
+                if (haveEnd && msg.mTime.tv_sec >= end)
+                    continue;
+                if (thread &&
+                    !(threadIsID ? msg.mThreadID == threadID
+                      : msg.mThreadName == thread))
+                {
+                    continue;
+                }
+
+                const FString line(renderer.Render(msg));
+                fwrite(line.data(), 1, line.size(), stdout);
+            }
+
+            if (reader.GetUndecodableCount() > 0)
+            {
+                fprintf(stderr,
+                        "logdecode: %s: %llu messages could not be decoded\n",
+                        argv[i], reader.GetUndecodableCount());
+            }
+        }
+        catch (Exception &e)
+        {
+            fprintf(stderr, "logdecode: %s\n", e.what());
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -17,6 +17,11 @@ namespace Forte
         MOCK_METHOD1(SetInputFilename, void(const FString&));
         MOCK_METHOD1(SetOutputFilename, void(const FString&));
         MOCK_METHOD1(SetErrorFilename, void(const FString&));
+        MOCK_METHOD2(SetOutputCallback,
+                     void(const ProcessFuture::OutputCallback&, size_t));
+        MOCK_METHOD1(SetOutputBuffer, void(size_t));
+        MOCK_METHOD3(ReadOutput,
+                     size_t(ProcessFuture::OutputStream, char *, size_t));
         MOCK_METHOD0(GetResult, void());
         MOCK_METHOD1(GetResultTimed, void(const Timespec &));
         MOCK_METHOD1(Signal, void(int));
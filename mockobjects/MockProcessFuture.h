@@ -184,6 +184,17 @@ namespace Forte
         virtual FString GetErrorString();
         virtual void SetErrorFilename(const FString &errorfile);
 
+        virtual void SetOutputCallback(const OutputCallback &callback,
+                                       size_t window = DEFAULT_OUTPUT_WINDOW) {
+            throw EMockProcessFutureUnimplemented();
+        }
+        virtual void SetOutputBuffer(size_t capacity) {
+            throw EMockProcessFutureUnimplemented();
+        }
+        virtual size_t ReadOutput(OutputStream stream, char *buf, size_t len) {
+            throw EMockProcessFutureUnimplemented();
+        }
+
         /**
          * Cancel() sends signal 15 to the running process.
          *
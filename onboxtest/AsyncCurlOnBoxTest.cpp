@@ -0,0 +1,444 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+
+#include "AsyncCurl.h"
+#include "AutoMutex.h"
+#include "Clock.h"
+#include "EPollMonitor.h"
+#include "Foreach.h"
+#include "FTrace.h"
+#include "FunctionThread.h"
+#include "LogManager.h"
+#include "ThreadCondition.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+/**
+ * LoopbackHTTPServer answers HTTP/1.1 on 127.0.0.1 with keep-alive,
+ * one thread per connection:
+ *   /hello    200 "hello"
+ *   /big      200 with BIG_SIZE bytes
+ *   /slow     200 "slow" after SLOW_MS
+ *   /echo     200 with the request body
+ *   /hang     never answers
+ *   anything else 404
+ */
+class LoopbackHTTPServer
+{
+public:
+    static const size_t BIG_SIZE = 1024 * 1024;
+    static const int SLOW_MS = 200;
+
+    LoopbackHTTPServer()
+        : mShutdown(false),
+          mAccepted(0) {
+        mListenFD = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (mListenFD == -1
+            || bind(mListenFD, (struct sockaddr *) &addr, len) != 0
+            || listen(mListenFD, 64) != 0
+            || getsockname(mListenFD, (struct sockaddr *) &addr, &len) != 0)
+        {
+            throw Exception("could not listen on loopback");
+        }
+        mPort = ntohs(addr.sin_port);
+        mAcceptThread.reset(
+            new FunctionThread(FunctionThread::AutoInit(),
+                               boost::bind(&LoopbackHTTPServer::acceptLoop,
+                                           this),
+                               "httpaccept"));
+    }
+
+    ~LoopbackHTTPServer() {
+        mShutdown = true;
+        mAcceptThread->WaitForShutdown();
+        {
+            AutoUnlockMutex lock(mLock);
+            foreach (const boost::shared_ptr<FunctionThread> &t, mConnections)
+            {
+                t->WaitForShutdown();
+            }
+        }
+        close(mListenFD);
+    }
+
+    FString URL(const char *path) const {
+        return FString(FStringFC(), "http://127.0.0.1:%d%s", mPort, path);
+    }
+
+    int GetAcceptedCount(void) const {
+        AutoUnlockMutex lock(mLock);
+        return mAccepted;
+    }
+
+private:
+    bool waitReadable(int fd) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        while (!mShutdown)
+        {
+            if (poll(&pfd, 1, 50) > 0)
+                return true;
+        }
+        return false;
+    }
+
+    void acceptLoop(void) {
+        while (waitReadable(mListenFD))
+        {
+            int fd = accept4(mListenFD, NULL, NULL, SOCK_CLOEXEC);
+            if (fd == -1)
+                continue;
+            AutoUnlockMutex lock(mLock);
+            ++mAccepted;
+            mConnections.push_back(
+                boost::make_shared<FunctionThread>(
+                    FunctionThread::AutoInit(),
+                    boost::bind(&LoopbackHTTPServer::serve, this, fd),
+                    "httpconn"));
+        }
+    }
+
+    void serve(int fd) {
+        std::string in;
+        char buf[4096];
+        while (true)
+        {
+            size_t end;
+            while ((end = in.find("\r\n\r\n")) == std::string::npos)
+            {
+                ssize_t n;
+                if (!waitReadable(fd) || (n = read(fd, buf, sizeof(buf))) <= 0)
+                {
+                    close(fd);
+                    return;
+                }
+                in.append(buf, n);
+            }
+
+            std::string head(in.substr(0, end + 4));
+            size_t bodyLen = 0;
+            size_t cl = head.find("Content-Length: ");
+            if (cl != std::string::npos)
+                bodyLen = strtoul(head.c_str() + cl + 16, NULL, 10);
+            while (in.size() < head.size() + bodyLen)
+            {
+                ssize_t n;
+                if (!waitReadable(fd) || (n = read(fd, buf, sizeof(buf))) <= 0)
+                {
+                    close(fd);
+                    return;
+                }
+                in.append(buf, n);
+            }
+            std::string body(in.substr(head.size(), bodyLen));
+            in.erase(0, head.size() + bodyLen);
+
+            size_t start = head.find(' ') + 1;
+            std::string path(head.substr(start, head.find(' ', start) - start));
+
+            int status = 200;
+            std::string reply;
+            if (path == "/hello")
+            {
+                reply = "hello";
+            }
+            else if (path == "/big")
+            {
+                reply.assign(BIG_SIZE, 'x');
+            }
+            else if (path == "/slow")
+            {
+                usleep(SLOW_MS * 1000);
+                reply = "slow";
+            }
+            else if (path == "/echo")
+            {
+                reply = body;
+            }
+            else if (path == "/hang")
+            {
+                waitReadable(-1);
+                close(fd);
+                return;
+            }
+            else
+            {
+                status = 404;
+                reply = "not found";
+            }
+
+            FString header(FStringFC(),
+                           "HTTP/1.1 %d %s\r\nContent-Length: %zu\r\n\r\n",
+                           status, status == 200 ? "OK" : "Not Found",
+                           reply.size());
+            std::string out(header + reply);
+            for (size_t sent = 0; sent < out.size(); )
+            {
+                ssize_t n = ::write(fd, out.data() + sent, out.size() - sent);
+                if (n <= 0)
+                {
+                    close(fd);
+                    return;
+                }
+                sent += n;
+            }
+        }
+    }
+
+    volatile bool mShutdown;
+    int mListenFD;
+    int mPort;
+    boost::shared_ptr<FunctionThread> mAcceptThread;
+
+    mutable Mutex mLock;
+    int mAccepted;
+    std::vector<boost::shared_ptr<FunctionThread> > mConnections;
+};
+
+const size_t LoopbackHTTPServer::BIG_SIZE;
+const int LoopbackHTTPServer::SLOW_MS;
+
+class AsyncCurlOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_ALL);
+        logManager.BeginLogging("//stderr",
+                                logManager.GetSingleLevelFromString("UPTO_DEBUG"),
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    static void TearDownTestCase() {
+        curl_global_cleanup();
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+        mMonitor.reset(new EPollMonitor("curlmon", 100, 2));
+        mMonitor->Start();
+        mServer.reset(new LoopbackHTTPServer());
+        mClient = boost::make_shared<AsyncCurl>(mMonitor);
+    }
+
+    void TearDown() {
+        mClient.reset();
+        mMonitor->Shutdown();
+        mMonitor.reset();
+        mServer.reset();
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    AsyncCurlRequestPtr request(const char *path) {
+        return boost::make_shared<AsyncCurlRequest>(mClient, mServer->URL(path));
+    }
+
+    boost::shared_ptr<EPollMonitor> mMonitor;
+    boost::shared_ptr<LoopbackHTTPServer> mServer;
+    AsyncCurlPtr mClient;
+};
+
+static bool countBytes(size_t *count, const char *data, size_t len)
+{
+    *count += len;
+    return true;
+}
+
+static bool abortBody(const char *data, size_t len)
+{
+    return false;
+}
+
+static void countCompletion(Mutex *lock, ThreadCondition *cond, int *count,
+                            const AsyncTask<long> &task)
+{
+    AutoUnlockMutex l(*lock);
+    ++*count;
+    cond->Signal();
+}
+
+TEST_F(AsyncCurlOnBoxTest, RequestsReuseConnection)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        AsyncCurlRequestPtr r(request("/hello"));
+        r->Begin();
+        r->Wait();
+        ASSERT_EQ(200, r->GetResult());
+        EXPECT_EQ("hello", r->GetBody());
+    }
+    EXPECT_EQ(1, mServer->GetAcceptedCount());
+    EXPECT_EQ(0, mClient->GetActiveCount());
+}
+
+TEST_F(AsyncCurlOnBoxTest, ConcurrentRequests)
+{
+    const int count = 8;
+    Mutex lock;
+    ThreadCondition cond(lock);
+    int completed = 0;
+    std::vector<AsyncCurlRequestPtr> requests;
+
+    const Timespec start(MonotonicClock().GetTime());
+    for (int i = 0; i < count; ++i)
+    {
+        AsyncCurlRequestPtr r(request("/slow"));
+        r->SetCallback(boost::bind(countCompletion, &lock, &cond, &completed, _1));
+        r->Begin();
+        requests.push_back(r);
+    }
+    EXPECT_EQ(count, mClient->GetActiveCount());
+
+    {
+        AutoUnlockMutex l(lock);
+        while (completed < count)
+            cond.Wait();
+    }
+    const Timespec elapsed(MonotonicClock().GetTime() - start);
+
+    // one after another they would take count * SLOW_MS
+    EXPECT_LT(elapsed.AsMillisec(), (count / 2) * LoopbackHTTPServer::SLOW_MS);
+    foreach (const AsyncCurlRequestPtr &r, requests)
+    {
+        EXPECT_EQ(200, r->GetResult());
+        EXPECT_EQ("slow", r->GetBody());
+    }
+    EXPECT_EQ(count, mServer->GetAcceptedCount());
+}
+
+TEST_F(AsyncCurlOnBoxTest, PostAndHeaders)
+{
+    AsyncCurlRequestPtr r(request("/echo"));
+    r->SetPostFields("a=1&b=2");
+    r->AddHeader("X-Forte-Test: yes");
+    r->Begin();
+    r->Wait();
+    ASSERT_EQ(200, r->GetResult());
+    EXPECT_EQ("a=1&b=2", r->GetBody());
+
+    ASSERT_THROW(r->Begin(), EAsyncCurlRequestStarted);
+}
+
+TEST_F(AsyncCurlOnBoxTest, StreamsBodyToCallback)
+{
+    size_t received = 0;
+    AsyncCurlRequestPtr r(request("/big"));
+    r->SetBodyCallback(boost::bind(countBytes, &received, _1, _2));
+    r->Begin();
+    r->Wait();
+    ASSERT_EQ(200, r->GetResult());
+    EXPECT_EQ(LoopbackHTTPServer::BIG_SIZE, received);
+    EXPECT_TRUE(r->GetBody().empty());
+
+    AsyncCurlRequestPtr aborted(request("/big"));
+    aborted->SetBodyCallback(abortBody);
+    aborted->Begin();
+    aborted->Wait();
+    ASSERT_THROW(aborted->GetResult(), EAsyncCurlTransfer);
+}
+
+TEST_F(AsyncCurlOnBoxTest, Errors)
+{
+    AsyncCurlRequestPtr notFound(request("/missing"));
+    notFound->Begin();
+    notFound->Wait();
+    EXPECT_EQ(404, notFound->GetResult());
+
+    AsyncCurlRequestPtr thrown(request("/missing"));
+    thrown->SetThrowOnHTTPError();
+    thrown->Begin();
+    thrown->Wait();
+    ASSERT_THROW(thrown->GetResult(), EAsyncCurlHTTPError);
+
+    // nothing listens on a port that was just given up
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, bind(fd, (struct sockaddr *) &addr, len));
+    ASSERT_EQ(0, getsockname(fd, (struct sockaddr *) &addr, &len));
+    close(fd);
+
+    AsyncCurlRequestPtr refused(boost::make_shared<AsyncCurlRequest>(
+                                    mClient, FString(FStringFC(),
+                                                     "http://127.0.0.1:%d/",
+                                                     ntohs(addr.sin_port))));
+    refused->Begin();
+    refused->Wait();
+    ASSERT_THROW(refused->GetResult(), EAsyncCurlTransfer);
+}
+
+TEST_F(AsyncCurlOnBoxTest, TimeoutAndShutdown)
+{
+    AsyncCurlRequestPtr timedOut(request("/hang"));
+    timedOut->SetMaxTransferTime(1);
+    const Timespec start(MonotonicClock().GetTime());
+    timedOut->Begin();
+    timedOut->Wait();
+    EXPECT_LT((MonotonicClock().GetTime() - start).AsMillisec(), 3000);
+    ASSERT_THROW(timedOut->GetResult(), EAsyncCurlTransfer);
+
+    AsyncCurlRequestPtr hung(request("/hang"));
+    hung->Begin();
+    usleep(100000);
+    EXPECT_FALSE(hung->IsComplete());
+
+    mClient->Shutdown();
+    ASSERT_TRUE(hung->IsComplete());
+    ASSERT_THROW(hung->GetResult(), EAsyncCurlShutdown);
+    ASSERT_THROW(request("/hello")->Begin(), EAsyncCurlShutdown);
+}
+
+TEST_F(AsyncCurlOnBoxTest, ShutdownWhileTransfersAndTimersRun)
+{
+    // curl's timer keeps firing on the monitor threads while
+    // transfers start up, so shutting down straight away races it
+    for (int round = 0; round < 100; ++round)
+    {
+        AsyncCurlPtr client(boost::make_shared<AsyncCurl>(mMonitor));
+        std::vector<AsyncCurlRequestPtr> requests;
+        for (int i = 0; i < 16; ++i)
+        {
+            AsyncCurlRequestPtr r(boost::make_shared<AsyncCurlRequest>(
+                                      client, mServer->URL("/slow")));
+            r->Begin();
+            requests.push_back(r);
+        }
+        usleep((round % 20) * 250);
+
+        // half the rounds go through the destructor, which may run on
+        // a monitor thread that still holds the client
+        if (round % 2 == 0)
+            client->Shutdown();
+        client.reset();
+
+        foreach (const AsyncCurlRequestPtr &r, requests)
+        {
+            r->Wait();
+            EXPECT_THROW(r->GetResult(), EAsyncCurlShutdown);
+        }
+    }
+}
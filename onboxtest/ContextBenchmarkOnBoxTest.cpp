@@ -0,0 +1,159 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "ContextImpl.h"
+#include "Foreach.h"
+#include "FunctionThread.h"
+#include "SnapshotContext.h"
+
+#include <boost/bind.hpp>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// compares the read throughput of ContextImpl with SnapshotContext, by
+// Get<T>() and by Handle, with several threads reading at once as
+// request handlers do
+
+static const int BENCHMARK_THREADS = 8;
+static const int BENCHMARK_READS = 500000;
+static const int BENCHMARK_KEYS = 32;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class Service : public Object
+{
+public:
+    Service() : mValue(1) {}
+    int mValue;
+};
+
+static FString keyFor(int i)
+{
+    return FString(FStringFC(), "forte.service.%d", i);
+}
+
+template <typename ContextType>
+static void readByGet(const ContextType *context, volatile long long *sum)
+{
+    long long total = 0;
+    const FString key(keyFor(BENCHMARK_KEYS / 2));
+    for (int i = 0; i < BENCHMARK_READS; ++i)
+        total += context->template Get<Service>(key)->mValue;
+    __sync_add_and_fetch(sum, total);
+}
+
+static void readByHandle(const SnapshotContext *context, volatile long long *sum)
+{
+    long long total = 0;
+    SnapshotContext::Handle<Service> service(*context, keyFor(BENCHMARK_KEYS / 2));
+    for (int i = 0; i < BENCHMARK_READS; ++i)
+        total += service->mValue;
+    __sync_add_and_fetch(sum, total);
+}
+
+class ContextBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void fill(Context &context) {
+        for (int i = 0; i < BENCHMARK_KEYS; ++i)
+            context.Set(keyFor(i), ObjectPtr(new Service()));
+    }
+
+    void runBenchmark(const char *name, const boost::function<void()> &reader,
+                      volatile long long *sum) {
+        TimerClock timer;
+        timer.Start();
+        {
+            std::vector<boost::shared_ptr<FunctionThread> > threads;
+            for (int i = 0; i < BENCHMARK_THREADS; ++i)
+            {
+                threads.push_back(
+                    boost::shared_ptr<FunctionThread>(
+                        new FunctionThread(FunctionThread::AutoInit(),
+                                           reader, "bench-reader")));
+            }
+            foreach (const boost::shared_ptr<FunctionThread> &thread, threads)
+                thread->WaitForShutdown();
+        }
+        timer.Stop();
+
+        const long long reads =
+            static_cast<long long>(BENCHMARK_THREADS) * BENCHMARK_READS;
+        ASSERT_EQ(reads, *sum);
+
+        const long long elapsedUsec = std::max(1LL, asMicrosec(timer.GetTime()));
+        hlogstream(HLOG_INFO, name
+                   << " threads=" << BENCHMARK_THREADS
+                   << " reads=" << reads
+                   << " elapsed_ms=" << timer.GetTime().AsMillisec()
+                   << " reads/s=" << (reads * 1000000LL) / elapsedUsec
+                   << " ns/read=" << (elapsedUsec * 1000LL) / reads);
+    }
+};
+
+TEST_F(ContextBenchmarkOnBoxTest, ContextImplGet)
+{
+    FTRACE;
+    ContextImpl context;
+    fill(context);
+    volatile long long sum = 0;
+    runBenchmark("contextimpl-get",
+                 boost::bind(&readByGet<ContextImpl>, &context, &sum), &sum);
+}
+
+TEST_F(ContextBenchmarkOnBoxTest, SnapshotContextGet)
+{
+    FTRACE;
+    SnapshotContext context;
+    fill(context);
+    volatile long long sum = 0;
+    runBenchmark("snapshot-get",
+                 boost::bind(&readByGet<SnapshotContext>, &context, &sum), &sum);
+}
+
+TEST_F(ContextBenchmarkOnBoxTest, SnapshotContextHandle)
+{
+    FTRACE;
+    SnapshotContext context;
+    fill(context);
+    volatile long long sum = 0;
+    runBenchmark("snapshot-handle",
+                 boost::bind(&readByHandle, &context, &sum), &sum);
+}
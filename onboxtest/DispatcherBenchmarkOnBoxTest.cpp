@@ -0,0 +1,232 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "RequestHandler.h"
+#include "ThreadPoolDispatcher.h"
+#include "OnDemandDispatcher.h"
+#include "WorkStealingDispatcher.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// compares event throughput and enqueue-to-start latency of the
+// dispatchers with handlers that do nothing and handlers that sleep
+
+static const int BENCHMARK_THREADS = 16;
+static const int BENCHMARK_MAX_DEPTH = 65536;
+static const int BENCHMARK_TINY_EVENTS = 50000;
+static const int BENCHMARK_SLOW_EVENTS = 2000;
+static const int BENCHMARK_SLOW_HANDLER_USEC = 1000;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class BenchmarkEvent : public Event
+{
+public:
+    BenchmarkEvent(const Timespec& enqueued) : mEnqueued(enqueued) {}
+    Timespec mEnqueued;
+};
+
+class BenchmarkRequestHandler : public RequestHandler
+{
+public:
+    BenchmarkRequestHandler(int expected, int handlerUsec)
+        : RequestHandler(0),
+          mHandlerUsec(handlerUsec),
+          mLatenciesUsec(expected, 0),
+          mHandled(0)
+        {
+        }
+
+    void Handler(Event *e) {
+        BenchmarkEvent* event = dynamic_cast<BenchmarkEvent*>(e);
+        long long latency = asMicrosec(mClock.GetTime() - event->mEnqueued);
+
+        if (mHandlerUsec > 0)
+            usleep(mHandlerUsec);
+
+        int slot = __sync_fetch_and_add(&mHandled, 1);
+        if (slot < static_cast<int>(mLatenciesUsec.size()))
+            mLatenciesUsec[slot] = latency;
+    }
+
+    void Busy(void) {}
+    void Periodic(void) {}
+    void Init(void) {}
+    void Cleanup(void) {}
+
+    int GetHandled() const {
+        return mHandled;
+    }
+
+    MonotonicClock mClock;
+    int mHandlerUsec;
+    std::vector<long long> mLatenciesUsec;
+    volatile int mHandled;
+};
+
+class DispatcherBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    enum DispatcherType {
+        THREAD_POOL,
+        ON_DEMAND,
+        WORK_STEALING
+    };
+
+    DispatcherPtr makeDispatcher(DispatcherType type,
+                                 const boost::shared_ptr<RequestHandler>& h,
+                                 int events) {
+        switch (type)
+        {
+        case THREAD_POOL:
+            return DispatcherPtr(
+                new ThreadPoolDispatcher(h,
+                                         BENCHMARK_THREADS,
+                                         BENCHMARK_THREADS,
+                                         BENCHMARK_THREADS,
+                                         BENCHMARK_THREADS,
+                                         BENCHMARK_MAX_DEPTH,
+                                         BENCHMARK_MAX_DEPTH,
+                                         "bench-tp"));
+        case ON_DEMAND:
+            // the manager blocks on its thread semaphore before reaping
+            // finished workers, so allow a thread for every event
+            return DispatcherPtr(
+                new OnDemandDispatcher(h,
+                                       events,
+                                       BENCHMARK_MAX_DEPTH,
+                                       BENCHMARK_MAX_DEPTH,
+                                       "bench-od"));
+        case WORK_STEALING:
+        default:
+            return DispatcherPtr(
+                new WorkStealingDispatcher(h,
+                                           BENCHMARK_THREADS,
+                                           BENCHMARK_MAX_DEPTH,
+                                           "bench-ws"));
+        }
+    }
+
+    void runBenchmark(DispatcherType type, int events, int handlerUsec) {
+        const char* typeName =
+            (type == THREAD_POOL ? "thread-pool"
+             : (type == ON_DEMAND ? "on-demand" : "work-stealing"));
+
+        boost::shared_ptr<BenchmarkRequestHandler> handler(
+            new BenchmarkRequestHandler(events, handlerUsec));
+        DispatcherPtr dispatcher(makeDispatcher(type, handler, events));
+
+        // let the thread pool manager start its workers
+        sleep(2);
+
+        MonotonicClock clock;
+        TimerClock timer;
+        timer.Start();
+        for (int i = 0; i < events; ++i)
+        {
+            dispatcher->Enqueue(
+                boost::shared_ptr<Event>(new BenchmarkEvent(clock.GetTime())));
+        }
+
+        DeadlineClock deadline;
+        deadline.ExpiresInSeconds(120);
+        while (handler->GetHandled() < events && !deadline.Expired())
+        {
+            usleep(1000);
+        }
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+        dispatcher->Shutdown();
+
+        ASSERT_EQ(events, handler->GetHandled());
+
+        std::vector<long long>& latencies(handler->mLatenciesUsec);
+        std::sort(latencies.begin(), latencies.end());
+        long long p50 = latencies[latencies.size() / 2];
+        long long p99 = latencies[(latencies.size() * 99) / 100];
+        long long elapsedUsec = std::max(1LL, asMicrosec(elapsed));
+
+        hlogstream(HLOG_INFO, typeName
+                   << " handler_us=" << handlerUsec
+                   << " events=" << events
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " events/s=" << (events * 1000000LL) / elapsedUsec
+                   << " p50_us=" << p50
+                   << " p99_us=" << p99);
+    }
+};
+
+TEST_F(DispatcherBenchmarkOnBoxTest, ThreadPoolTinyHandler)
+{
+    FTRACE;
+    runBenchmark(THREAD_POOL, BENCHMARK_TINY_EVENTS, 0);
+}
+
+TEST_F(DispatcherBenchmarkOnBoxTest, OnDemandTinyHandler)
+{
+    FTRACE;
+    runBenchmark(ON_DEMAND, BENCHMARK_SLOW_EVENTS, 0);
+}
+
+TEST_F(DispatcherBenchmarkOnBoxTest, WorkStealingTinyHandler)
+{
+    FTRACE;
+    runBenchmark(WORK_STEALING, BENCHMARK_TINY_EVENTS, 0);
+}
+
+TEST_F(DispatcherBenchmarkOnBoxTest, ThreadPoolSlowHandler)
+{
+    FTRACE;
+    runBenchmark(THREAD_POOL, BENCHMARK_SLOW_EVENTS, BENCHMARK_SLOW_HANDLER_USEC);
+}
+
+TEST_F(DispatcherBenchmarkOnBoxTest, OnDemandSlowHandler)
+{
+    FTRACE;
+    runBenchmark(ON_DEMAND, BENCHMARK_SLOW_EVENTS, BENCHMARK_SLOW_HANDLER_USEC);
+}
+
+TEST_F(DispatcherBenchmarkOnBoxTest, WorkStealingSlowHandler)
+{
+    FTRACE;
+    runBenchmark(WORK_STEALING, BENCHMARK_SLOW_EVENTS, BENCHMARK_SLOW_HANDLER_USEC);
+}
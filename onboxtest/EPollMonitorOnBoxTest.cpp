@@ -21,7 +21,8 @@ class EPollMonitorOnBoxTest : public ::testing::Test
 public:
     EPollMonitorOnBoxTest()
         : mEventVectorMutex(),
-          mEventVectorNotEmptyCondition(mEventVectorMutex)
+          mEventVectorNotEmptyCondition(mEventVectorMutex),
+          mTimerCount(0)
         {
         }
 
@@ -69,6 +70,19 @@ public:
     Forte::Mutex mEventVectorMutex;
     Forte::ThreadCondition mEventVectorNotEmptyCondition;
     std::vector<struct epoll_event> mEventVector;
+
+    void handleTimer() {
+        AutoUnlockMutex lock(mEventVectorMutex);
+        ++mTimerCount;
+        mEventVectorNotEmptyCondition.Signal();
+    }
+
+    int getTimerCount() {
+        AutoUnlockMutex lock(mEventVectorMutex);
+        return mTimerCount;
+    }
+
+    int mTimerCount;
 };
 
 TEST_F(EPollMonitorOnBoxTest, ConstructDelete)
@@ -349,3 +363,77 @@ TEST_F(EPollMonitorOnBoxTest, DataSentWhileEPollDownET)
     monitor.Shutdown();
 }
 
+
+TEST_F(EPollMonitorOnBoxTest, TimerFiresOnce)
+{
+    EPollMonitor monitor("test");
+    monitor.Start();
+
+    int timer = monitor.AddTimer(
+        boost::bind(&EPollMonitorOnBoxTest::handleTimer, this));
+    usleep(100000);
+    ASSERT_EQ(0, getTimerCount());
+
+    MonotonicClock clock;
+    Timespec start(clock.GetTime());
+    monitor.SetTimer(timer, Timespec::FromMillisec(50));
+    {
+        AutoUnlockMutex lock(mEventVectorMutex);
+        while (mTimerCount == 0)
+        {
+            mEventVectorNotEmptyCondition.Wait();
+        }
+    }
+    ASSERT_GE((clock.GetTime() - start).AsMillisec(), 50);
+
+    usleep(200000);
+    ASSERT_EQ(1, getTimerCount());
+
+    monitor.RemoveTimer(timer);
+    monitor.Shutdown();
+}
+
+TEST_F(EPollMonitorOnBoxTest, TimerRepeatsUntilCancelled)
+{
+    EPollMonitor monitor("test", 500, 2);
+    monitor.Start();
+
+    int timer = monitor.AddTimer(
+        boost::bind(&EPollMonitorOnBoxTest::handleTimer, this));
+    monitor.SetTimer(timer, Timespec::FromMillisec(20), true);
+    usleep(310000);
+    monitor.CancelTimer(timer);
+    int count = getTimerCount();
+    ASSERT_GE(count, 12);
+    ASSERT_LE(count, 16);
+
+    usleep(100000);
+    ASSERT_EQ(count, getTimerCount());
+
+    // a past deadline fires right away
+    monitor.SetTimer(timer, Timespec());
+    usleep(50000);
+    ASSERT_EQ(count + 1, getTimerCount());
+
+    monitor.RemoveTimer(timer);
+    monitor.Shutdown();
+}
+
+TEST_F(EPollMonitorOnBoxTest, RemovedTimerDoesNotFire)
+{
+    EPollMonitor monitor("test");
+    monitor.Start();
+
+    int timer = monitor.AddTimer(
+        boost::bind(&EPollMonitorOnBoxTest::handleTimer, this));
+    monitor.SetTimer(timer, Timespec::FromMillisec(50));
+    monitor.RemoveTimer(timer);
+    usleep(150000);
+    ASSERT_EQ(0, getTimerCount());
+
+    // timers still open at shutdown are closed with the monitor
+    timer = monitor.AddTimer(
+        boost::bind(&EPollMonitorOnBoxTest::handleTimer, this));
+    monitor.Shutdown();
+    monitor.RemoveTimer(timer);
+}
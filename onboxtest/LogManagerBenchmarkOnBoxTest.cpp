@@ -0,0 +1,208 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "Foreach.h"
+
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// measures what an hlog() call costs the calling thread when logging
+// synchronously and when handing messages to the async writer, and
+// what a call that is filtered out costs
+
+static const int BENCHMARK_MESSAGES_PER_THREAD = 100000;
+static const char* BENCHMARK_LOGFILE = "./LogManagerBenchmarkOnBoxTest.bench.log";
+
+static long long asNanosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+class LogBenchmarkThread : public Forte::Thread
+{
+public:
+    LogBenchmarkThread(int messages)
+        : mMessages(messages),
+          mStartLock(),
+          mStartCondition(mStartLock),
+          mStarted(false)
+        {
+            initialized();
+        }
+
+    virtual ~LogBenchmarkThread() {
+        deleting();
+    }
+
+    void Start() {
+        AutoUnlockMutex lock(mStartLock);
+        mStarted = true;
+        mStartCondition.Broadcast();
+    }
+
+    void *run() {
+        {
+            AutoUnlockMutex lock(mStartLock);
+            while (!mStarted)
+                mStartCondition.Wait();
+        }
+
+        TimerClock timer;
+        timer.Start();
+        for (int i = 0; i < mMessages; ++i)
+        {
+            hlog(HLOG_DEBUG, "benchmark message %d with a payload of %s",
+                 i, "some typical length text");
+        }
+        timer.Stop();
+        mElapsed = timer.GetTime();
+        return NULL;
+    }
+
+    int mMessages;
+    Mutex mStartLock;
+    ThreadCondition mStartCondition;
+    bool mStarted;
+    Timespec mElapsed;
+};
+
+class LogManagerBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        // the benchmark messages are DEBUG and only go to the bench
+        // log, results go to stderr
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        unlink(BENCHMARK_LOGFILE);
+        logManager.BeginLogging(BENCHMARK_LOGFILE, HLOG_ALL);
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        logManager.EndLogging(BENCHMARK_LOGFILE);
+        unlink(BENCHMARK_LOGFILE);
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void runBenchmark(const char *mode, int threadCount) {
+        std::vector<boost::shared_ptr<LogBenchmarkThread> > threads;
+        for (int i = 0; i < threadCount; ++i)
+        {
+            boost::shared_ptr<LogBenchmarkThread> thread(
+                new LogBenchmarkThread(BENCHMARK_MESSAGES_PER_THREAD));
+            thread->WaitForInitialize();
+            threads.push_back(thread);
+        }
+
+        TimerClock timer;
+        timer.Start();
+        foreach (const boost::shared_ptr<LogBenchmarkThread>& thread, threads)
+            thread->Start();
+        foreach (const boost::shared_ptr<LogBenchmarkThread>& thread, threads)
+            thread->WaitForShutdown();
+
+        // the wall time includes getting everything into the file
+        const bool async(logManager.IsAsyncLogging());
+        logManager.EndAsyncLogging();
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+        const unsigned long long dropped(
+            async ? logManager.GetAsyncDroppedCount() : 0);
+
+        long long callerNanosec(0);
+        foreach (const boost::shared_ptr<LogBenchmarkThread>& thread, threads)
+            callerNanosec += asNanosec(thread->mElapsed);
+        const long long calls =
+            static_cast<long long>(threadCount) * BENCHMARK_MESSAGES_PER_THREAD;
+
+        hlogstream(HLOG_INFO, mode
+                   << (async ? " (async)" : "")
+                   << " threads=" << threadCount
+                   << " calls=" << calls
+                   << " dropped=" << dropped
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " ns_per_call=" << callerNanosec / calls);
+    }
+};
+
+TEST_F(LogManagerBenchmarkOnBoxTest, DisabledCallSite)
+{
+    static const int CALLS = 10000000;
+    logManager.EndLogging(BENCHMARK_LOGFILE);
+    logManager.BeginLogging(BENCHMARK_LOGFILE, HLOG_NODEBUG);
+
+    // DEBUG4 turned on for some other file puts it in the global OR
+    // mask, so only the call site decision keeps these cheap
+    logManager.SetSourceFileLogMask("SomeOtherFile.cpp", HLOG_ALL);
+
+    TimerClock timer;
+    timer.Start();
+    for (int i = 0; i < CALLS; ++i)
+    {
+        hlog(HLOG_DEBUG4, "disabled message %d", i);
+    }
+    timer.Stop();
+
+    logManager.ClearSourceFileLogMask("SomeOtherFile.cpp");
+    hlogstream(HLOG_INFO, "disabled"
+               << " calls=" << CALLS
+               << " ns_per_call=" << asNanosec(timer.GetTime()) / CALLS);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, Sync1Thread)
+{
+    runBenchmark("sync", 1);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, AsyncBlock1Thread)
+{
+    logManager.BeginAsyncLogging(4096, 100, LOG_ASYNC_BLOCK);
+    runBenchmark("block", 1);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, AsyncDrop1Thread)
+{
+    logManager.BeginAsyncLogging(4096, 100, LOG_ASYNC_DROP);
+    runBenchmark("drop", 1);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, Sync4Threads)
+{
+    runBenchmark("sync", 4);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, AsyncBlock4Threads)
+{
+    logManager.BeginAsyncLogging(4096, 100, LOG_ASYNC_BLOCK);
+    runBenchmark("block", 4);
+}
+
+TEST_F(LogManagerBenchmarkOnBoxTest, AsyncDrop4Threads)
+{
+    logManager.BeginAsyncLogging(4096, 100, LOG_ASYNC_DROP);
+    runBenchmark("drop", 4);
+}
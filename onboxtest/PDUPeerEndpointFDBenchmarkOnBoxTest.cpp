@@ -0,0 +1,243 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "EPollMonitor.h"
+#include "PDUQueue.h"
+#include "PDUPeerEndpointFD.h"
+#include "Foreach.h"
+
+#include <boost/bind.hpp>
+#include <sys/socket.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// compares PDU throughput and delivery latency of the thread-per-endpoint
+// model against the shared epoll event loop at increasing peer counts
+
+static const int BENCHMARK_PDUS_TOTAL = 20000;
+static const int BENCHMARK_EVENT_LOOP_THREADS = 4;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+struct BenchmarkPayload
+{
+    struct timespec sent;
+    char pad[120];
+};
+
+class PDUPeerEndpointFDBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    PDUPeerEndpointFDBenchmarkOnBoxTest()
+        : mRecvMutex(),
+          mAllReceivedCondition(mRecvMutex),
+          mExpected(0)
+        {
+        }
+
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void eventCallback(PDUPeerEndpointFD* endpoint, PDUPeerEventPtr event) {
+        if (event->mEventType != PDUPeerReceivedPDUEvent)
+            return;
+
+        MonotonicClock clock;
+        PDU pdu;
+        std::vector<long long> latencies;
+        while (endpoint->RecvPDU(pdu))
+        {
+            const BenchmarkPayload* p = pdu.GetPayload<BenchmarkPayload>();
+            Timespec sent(p->sent);
+            latencies.push_back(asMicrosec(clock.GetTime() - sent));
+        }
+
+        AutoUnlockMutex lock(mRecvMutex);
+        mLatenciesUsec.insert(mLatenciesUsec.end(),
+                              latencies.begin(), latencies.end());
+        if (mLatenciesUsec.size() >= mExpected)
+            mAllReceivedCondition.Broadcast();
+    }
+
+    boost::shared_ptr<PDUPeerEndpointFD> makeEndpoint(
+        const boost::shared_ptr<PDUQueue>& queue,
+        const boost::shared_ptr<EPollMonitor>& monitor,
+        PDUPeerEndpointMode mode,
+        int fd) {
+        boost::shared_ptr<PDUPeerEndpointFD> e(
+            new PDUPeerEndpointFD(queue, monitor,
+                                  DEFAULT_SEND_TIMEOUT,
+                                  RECV_BUFFER_SIZE,
+                                  DEFAULT_MAX_BUFFER_SIZE,
+                                  RECV_BUFFER_SIZE,
+                                  mode));
+        e->SetEventCallback(
+            boost::bind(&PDUPeerEndpointFDBenchmarkOnBoxTest::eventCallback,
+                        this, e.get(), _1));
+        e->SetFD(fd);
+        return e;
+    }
+
+    void runBenchmark(PDUPeerEndpointMode mode, int peerCount) {
+        const char* modeName =
+            (mode == PDU_PEER_ENDPOINT_EVENT_LOOP ? "event-loop" : "threaded");
+        const int pdusPerPeer = std::max(1, BENCHMARK_PDUS_TOTAL / peerCount);
+
+        boost::shared_ptr<EPollMonitor> monitor(
+            new EPollMonitor(
+                "bench-epl", 500,
+                mode == PDU_PEER_ENDPOINT_EVENT_LOOP
+                ? BENCHMARK_EVENT_LOOP_THREADS : 1));
+        monitor->Start();
+
+        std::vector<boost::shared_ptr<PDUQueue> > queues;
+        std::vector<boost::shared_ptr<PDUPeerEndpointFD> > endpoints;
+        for (int i = 0; i < peerCount; ++i)
+        {
+            int fds[2];
+            ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+            boost::shared_ptr<PDUQueue> sendQueue(
+                new PDUQueue(DEFAULT_SEND_TIMEOUT, pdusPerPeer + 1,
+                             PDU_PEER_QUEUE_BLOCK));
+            boost::shared_ptr<PDUQueue> recvSideQueue(new PDUQueue);
+            queues.push_back(sendQueue);
+            endpoints.push_back(makeEndpoint(sendQueue, monitor, mode, fds[0]));
+            endpoints.push_back(
+                makeEndpoint(recvSideQueue, monitor, mode, fds[1]));
+        }
+
+        foreach (const boost::shared_ptr<PDUPeerEndpointFD>& e, endpoints)
+            e->Start();
+
+        {
+            AutoUnlockMutex lock(mRecvMutex);
+            mLatenciesUsec.clear();
+            mLatenciesUsec.reserve(pdusPerPeer * peerCount);
+            mExpected = pdusPerPeer * peerCount;
+        }
+
+        MonotonicClock clock;
+        TimerClock timer;
+        timer.Start();
+        for (int n = 0; n < pdusPerPeer; ++n)
+        {
+            foreach (const boost::shared_ptr<PDUQueue>& q, queues)
+            {
+                BenchmarkPayload payload;
+                memset(&payload, 0, sizeof(payload));
+                payload.sent = clock.GetTime();
+                PDUPtr pdu(new PDU(1, sizeof(payload), &payload));
+                q->EnqueuePDU(pdu);
+            }
+        }
+
+        {
+            DeadlineClock deadline;
+            deadline.ExpiresInSeconds(120);
+            AutoUnlockMutex lock(mRecvMutex);
+            while (mLatenciesUsec.size() < mExpected && !deadline.Expired())
+                mAllReceivedCondition.TimedWait(1);
+        }
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+
+        foreach (const boost::shared_ptr<PDUPeerEndpointFD>& e, endpoints)
+        {
+            e->SetEventCallback(NULL);
+            e->Shutdown();
+        }
+        monitor->Shutdown();
+
+        AutoUnlockMutex lock(mRecvMutex);
+        ASSERT_EQ(mExpected, mLatenciesUsec.size());
+
+        std::sort(mLatenciesUsec.begin(), mLatenciesUsec.end());
+        long long p99 = mLatenciesUsec[(mLatenciesUsec.size() * 99) / 100];
+        long long elapsedUsec = std::max(1LL, asMicrosec(elapsed));
+        long long pdusPerSecond = (mExpected * 1000000LL) / elapsedUsec;
+
+        hlogstream(HLOG_INFO, modeName << " peers=" << peerCount
+                   << " pdus=" << mExpected
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " pdus/s=" << pdusPerSecond
+                   << " p99_us=" << p99);
+    }
+
+protected:
+    Mutex mRecvMutex;
+    ThreadCondition mAllReceivedCondition;
+    std::vector<long long> mLatenciesUsec;
+    size_t mExpected;
+};
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, Threaded10Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_THREADED, 10);
+}
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, EventLoop10Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_EVENT_LOOP, 10);
+}
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, Threaded100Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_THREADED, 100);
+}
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, EventLoop100Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_EVENT_LOOP, 100);
+}
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, Threaded1000Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_THREADED, 1000);
+}
+
+TEST_F(PDUPeerEndpointFDBenchmarkOnBoxTest, EventLoop1000Peers)
+{
+    FTRACE;
+    runBenchmark(PDU_PEER_ENDPOINT_EVENT_LOOP, 1000);
+}
@@ -0,0 +1,230 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "EPollMonitor.h"
+#include "PDUQueue.h"
+#include "PDUPeerImpl.h"
+#include "PDUPeerSetImpl.h"
+#include "PDUPeerEndpointInProcess.h"
+#include "Foreach.h"
+
+#include <boost/bind.hpp>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// broadcasts large PDUs to in process peers and compares receiving a
+// private copy of each PDU (RecvPDU) against viewing the one shared
+// broadcast PDU (RecvPDUView)
+
+static const int BENCHMARK_BROADCASTS = 32;
+static const size_t BENCHMARK_PAYLOAD_SIZE = 128 * 1024;
+
+static long long cpuMicrosec()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+class PDUPeerSetBroadcastBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    PDUPeerSetBroadcastBenchmarkOnBoxTest()
+        : mRecvMutex(),
+          mAllReceivedCondition(mRecvMutex),
+          mUseView(false),
+          mExpected(0),
+          mReceived(0),
+          mBytesCopied(0)
+        {
+        }
+
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void eventCallback(PDUPeerEventPtr event) {
+        if (event->mEventType != PDUPeerReceivedPDUEvent)
+            return;
+
+        long long received(0);
+        long long bytesCopied(0);
+        if (mUseView)
+        {
+            PDUView view;
+            while (event->mPeer->RecvPDUView(view))
+            {
+                ++received;
+            }
+        }
+        else
+        {
+            PDU pdu;
+            while (event->mPeer->RecvPDU(pdu))
+            {
+                ++received;
+                bytesCopied += pdu.GetPayloadSize();
+            }
+        }
+
+        AutoUnlockMutex lock(mRecvMutex);
+        mReceived += received;
+        mBytesCopied += bytesCopied;
+        if (mReceived >= mExpected)
+            mAllReceivedCondition.Broadcast();
+    }
+
+    void runBenchmark(bool useView, int peerCount) {
+        mUseView = useView;
+
+        std::vector<PDUPeerPtr> peers;
+        for (int i = 0; i < peerCount; ++i)
+        {
+            boost::shared_ptr<PDUQueue> queue(
+                new PDUQueue(2,
+                             BENCHMARK_BROADCASTS + 1,
+                             PDU_PEER_QUEUE_BLOCK));
+            PDUPeerEndpointPtr endpoint(new PDUPeerEndpointInProcess(queue));
+            peers.push_back(PDUPeerPtr(new PDUPeerImpl(i + 1, endpoint, queue)));
+        }
+
+        PDUPeerSetImpl peerSet(peers, boost::shared_ptr<EPollMonitor>());
+        peerSet.SetEventCallback(
+            boost::bind(&PDUPeerSetBroadcastBenchmarkOnBoxTest::eventCallback,
+                        this, _1));
+        peerSet.Start();
+
+        // blocking queues drop PDUs for peers that are not connected
+        DeadlineClock connectDeadline;
+        connectDeadline.ExpiresInSeconds(30);
+        while (peerSet.GetConnectedCount() < static_cast<unsigned int>(peerCount)
+               && !connectDeadline.Expired())
+        {
+            usleep(10000);
+        }
+        ASSERT_EQ(peerCount, peerSet.GetConnectedCount());
+
+        {
+            AutoUnlockMutex lock(mRecvMutex);
+            mExpected = static_cast<long long>(BENCHMARK_BROADCASTS) * peerCount;
+            mReceived = 0;
+            mBytesCopied = 0;
+        }
+
+        std::vector<char> payload(BENCHMARK_PAYLOAD_SIZE, 'b');
+        long long cpuStart = cpuMicrosec();
+        TimerClock timer;
+        timer.Start();
+        for (int n = 0; n < BENCHMARK_BROADCASTS; ++n)
+        {
+            PDUPtr pdu(new PDU(1, payload.size(), &payload[0]));
+            peerSet.BroadcastAsync(pdu);
+        }
+
+        {
+            DeadlineClock deadline;
+            deadline.ExpiresInSeconds(120);
+            AutoUnlockMutex lock(mRecvMutex);
+            while (mReceived < mExpected && !deadline.Expired())
+                mAllReceivedCondition.TimedWait(1);
+        }
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+        long long cpuUsec = cpuMicrosec() - cpuStart;
+
+        peerSet.SetEventCallback(NULL);
+        peerSet.Shutdown();
+
+        AutoUnlockMutex lock(mRecvMutex);
+        ASSERT_EQ(mExpected, mReceived);
+
+        long long broadcastBytes =
+            static_cast<long long>(BENCHMARK_BROADCASTS) * BENCHMARK_PAYLOAD_SIZE;
+        hlogstream(HLOG_INFO, (useView ? "view" : "copy")
+                   << " peers=" << peerCount
+                   << " broadcasts=" << BENCHMARK_BROADCASTS
+                   << " payload_bytes=" << BENCHMARK_PAYLOAD_SIZE
+                   << " broadcast_bytes=" << broadcastBytes
+                   << " bytes_copied=" << mBytesCopied
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " cpu_ms=" << cpuUsec / 1000
+                   << " cpu_us_per_delivery="
+                   << cpuUsec / std::max(1LL, mReceived));
+    }
+
+protected:
+    Mutex mRecvMutex;
+    ThreadCondition mAllReceivedCondition;
+    bool mUseView;
+    long long mExpected;
+    long long mReceived;
+    long long mBytesCopied;
+};
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, Copy16Peers)
+{
+    FTRACE;
+    runBenchmark(false, 16);
+}
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, View16Peers)
+{
+    FTRACE;
+    runBenchmark(true, 16);
+}
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, Copy64Peers)
+{
+    FTRACE;
+    runBenchmark(false, 64);
+}
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, View64Peers)
+{
+    FTRACE;
+    runBenchmark(true, 64);
+}
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, Copy256Peers)
+{
+    FTRACE;
+    runBenchmark(false, 256);
+}
+
+TEST_F(PDUPeerSetBroadcastBenchmarkOnBoxTest, View256Peers)
+{
+    FTRACE;
+    runBenchmark(true, 256);
+}
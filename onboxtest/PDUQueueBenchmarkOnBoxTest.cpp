@@ -0,0 +1,176 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "PDUQueue.h"
+#include "Thread.h"
+#include "Foreach.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// measures PDUQueue enqueue/dequeue throughput as the number of
+// producer threads feeding one batch dequeueing consumer grows
+
+static const int BENCHMARK_PDUS_TOTAL = 320000;
+static const unsigned short BENCHMARK_QUEUE_SIZE = 4096;
+static const size_t BENCHMARK_DEQUEUE_BATCH = 32;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class BenchmarkProducerThread : public Thread
+{
+public:
+    BenchmarkProducerThread(PDUQueue& queue, const PDUPtr& pdu, int count)
+        : mQueue(queue),
+          mPDU(pdu),
+          mCount(count) {
+        initialized();
+    }
+
+    virtual ~BenchmarkProducerThread() {
+        deleting();
+    }
+
+protected:
+    void* run() {
+        for (int i = 0; i < mCount; ++i)
+        {
+            mQueue.EnqueuePDU(mPDU);
+        }
+        return NULL;
+    }
+
+    PDUQueue& mQueue;
+    PDUPtr mPDU;
+    int mCount;
+};
+
+class PDUQueueBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void runBenchmark(int producerCount) {
+        const int perProducer = BENCHMARK_PDUS_TOTAL / producerCount;
+        const long long expected =
+            static_cast<long long>(perProducer) * producerCount;
+
+        PDUQueue queue(2, BENCHMARK_QUEUE_SIZE, PDU_PEER_QUEUE_BLOCK);
+        PDUPtr pdu(new PDU(1, 0, NULL));
+
+        TimerClock timer;
+        timer.Start();
+
+        std::vector<boost::shared_ptr<BenchmarkProducerThread> > producers;
+        for (int i = 0; i < producerCount; ++i)
+        {
+            producers.push_back(
+                boost::shared_ptr<BenchmarkProducerThread>(
+                    new BenchmarkProducerThread(queue, pdu, perProducer)));
+        }
+
+        long long received(0);
+        long long batches(0);
+        std::vector<PDUPtr> pdus;
+        pdus.reserve(BENCHMARK_DEQUEUE_BATCH);
+        while (received < expected)
+        {
+            pdus.clear();
+            size_t n = queue.DequeueBatch(pdus, BENCHMARK_DEQUEUE_BATCH);
+            if (n == 0)
+            {
+                PDUPtr next;
+                queue.WaitForNextPDU(next);
+                n = 1;
+            }
+            received += n;
+            ++batches;
+        }
+
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+        producers.clear();
+
+        ASSERT_EQ(expected, received);
+        ASSERT_EQ(0, queue.GetQueueSize());
+
+        long long elapsedUsec = std::max(1LL, asMicrosec(elapsed));
+        hlogstream(HLOG_INFO, "producers=" << producerCount
+                   << " pdus=" << expected
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " ops/s=" << (expected * 1000000LL) / elapsedUsec
+                   << " avg_batch=" << (received / std::max(1LL, batches)));
+    }
+};
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers1)
+{
+    FTRACE;
+    runBenchmark(1);
+}
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers2)
+{
+    FTRACE;
+    runBenchmark(2);
+}
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers4)
+{
+    FTRACE;
+    runBenchmark(4);
+}
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers8)
+{
+    FTRACE;
+    runBenchmark(8);
+}
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers16)
+{
+    FTRACE;
+    runBenchmark(16);
+}
+
+TEST_F(PDUQueueBenchmarkOnBoxTest, Producers32)
+{
+    FTRACE;
+    runBenchmark(32);
+}
@@ -0,0 +1,119 @@
+// #SCQAD TESTAG: forte, forte.procmon
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "ProcessManagerImpl.h"
+#include "ProcessFuture.h"
+
+#include <algorithm>
+#include <list>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// measures how fast ProcessManager starts and reaps short lived
+// commands, with a procmon per command and with a pool of procmon
+// workers
+
+static const int BENCHMARK_PROCESSES_TOTAL = 2000;
+static const size_t BENCHMARK_OUTSTANDING = 16;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class ProcessManagerBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void waitForExit(const boost::shared_ptr<ProcessFuture> &ph) {
+        ph->GetResult();
+        ASSERT_EQ(ProcessFuture::ProcessExited,
+                  ph->GetProcessTerminationType());
+        ASSERT_EQ(0U, ph->GetStatusCode());
+    }
+
+    void runBenchmark(unsigned int poolSize) {
+        boost::shared_ptr<ProcessManager> pm(
+            new ProcessManagerImpl(poolSize));
+
+        TimerClock timer;
+        timer.Start();
+
+        std::list<boost::shared_ptr<ProcessFuture> > outstanding;
+        for (int i = 0; i < BENCHMARK_PROCESSES_TOTAL; ++i)
+        {
+            if (outstanding.size() == BENCHMARK_OUTSTANDING)
+            {
+                waitForExit(outstanding.front());
+                outstanding.pop_front();
+            }
+            outstanding.push_back(pm->CreateProcess("/bin/true"));
+        }
+        while (!outstanding.empty())
+        {
+            waitForExit(outstanding.front());
+            outstanding.pop_front();
+        }
+
+        timer.Stop();
+        Timespec elapsed = timer.GetTime();
+
+        long long elapsedUsec = std::max(1LL, asMicrosec(elapsed));
+        hlogstream(HLOG_INFO, "pool=" << poolSize
+                   << " processes=" << BENCHMARK_PROCESSES_TOTAL
+                   << " outstanding=" << BENCHMARK_OUTSTANDING
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " procs/s="
+                   << (BENCHMARK_PROCESSES_TOTAL * 1000000LL) / elapsedUsec);
+    }
+};
+
+TEST_F(ProcessManagerBenchmarkOnBoxTest, ProcmonPerProcess)
+{
+    FTRACE;
+    runBenchmark(0);
+}
+
+TEST_F(ProcessManagerBenchmarkOnBoxTest, Pool1)
+{
+    FTRACE;
+    runBenchmark(1);
+}
+
+TEST_F(ProcessManagerBenchmarkOnBoxTest, Pool4)
+{
+    FTRACE;
+    runBenchmark(4);
+}
@@ -125,3 +125,147 @@ TEST_F(ProcessManagerTest, ReactsToChildTerminationInUnder100Millisec)
         FAIL();
     }
 }
+
+static FString expectedSeqOutput(int count)
+{
+    FString expected;
+    for (int i = 1; i <= count; ++i)
+    {
+        expected.append(FString(FStringFC(), "%d\n", i));
+    }
+    return expected;
+}
+
+static FString readStream(const boost::shared_ptr<ProcessFuture> &ph,
+                          ProcessFuture::OutputStream stream)
+{
+    FString output;
+    char buf[1000];
+    size_t n;
+    while ((n = ph->ReadOutput(stream, buf, sizeof(buf))) > 0)
+    {
+        output.append(buf, n);
+    }
+    return output;
+}
+
+class OutputCollector
+{
+public:
+    OutputCollector() : mEnded(0), mCond(mLock) {}
+
+    void Collect(ProcessFuture::OutputStream stream,
+                 const char *data, size_t len) {
+        AutoUnlockMutex lock(mLock);
+        if (len == 0)
+        {
+            ++mEnded;
+            mCond.Broadcast();
+        }
+        else if (stream == ProcessFuture::OutputStdout)
+        {
+            mOutput.append(data, len);
+        }
+        else
+        {
+            mError.append(data, len);
+        }
+    }
+
+    void WaitForEnd(void) {
+        AutoUnlockMutex lock(mLock);
+        while (mEnded < 2)
+        {
+            mCond.Wait();
+        }
+    }
+
+    FString mOutput;
+    FString mError;
+    int mEnded;
+    Mutex mLock;
+    ThreadCondition mCond;
+};
+
+TEST_F(ProcessManagerTest, StreamsOutputToBuffer)
+{
+    try
+    {
+        // the pooled manager hands a streamed process a procmon of its own
+        for (unsigned int poolSize = 0; poolSize <= 2; poolSize += 2)
+        {
+            boost::shared_ptr<ProcessManager> pm(
+                new ProcessManagerImpl(poolSize));
+            boost::shared_ptr<ProcessFuture> ph(
+                pm->CreateProcessDontRun("seq 1 100000; echo done >&2"));
+            ph->SetOutputBuffer(16384);
+            pm->RunProcess(ph);
+
+            ASSERT_EQ(expectedSeqOutput(100000),
+                      readStream(ph, ProcessFuture::OutputStdout));
+            ASSERT_EQ("done\n", readStream(ph, ProcessFuture::OutputStderr));
+            ASSERT_NO_THROW(ph->GetResult());
+            ASSERT_EQ(0, ph->GetStatusCode());
+        }
+    }
+    catch (std::exception& e)
+    {
+        hlog(HLOG_ERR, "exception: %s", e.what());
+        FAIL();
+    }
+}
+
+TEST_F(ProcessManagerTest, StreamedProcessWaitsForReader)
+{
+    try
+    {
+        boost::shared_ptr<ProcessManager> pm(new ProcessManagerImpl);
+        boost::shared_ptr<ProcessFuture> ph(
+            pm->CreateProcessDontRun("head -c 1048576 /dev/zero"));
+        ph->SetOutputBuffer(4096);
+        pm->RunProcess(ph);
+
+        // far more than the buffer and the pipe hold, so the process
+        // cannot finish until it is read
+        usleep(500000);
+        ASSERT_TRUE(ph->IsRunning());
+
+        ASSERT_EQ(1048576U,
+                  readStream(ph, ProcessFuture::OutputStdout).size());
+        ASSERT_NO_THROW(ph->GetResult());
+        ASSERT_EQ(0, ph->GetStatusCode());
+    }
+    catch (std::exception& e)
+    {
+        hlog(HLOG_ERR, "exception: %s", e.what());
+        FAIL();
+    }
+}
+
+TEST_F(ProcessManagerTest, StreamsOutputToCallback)
+{
+    try
+    {
+        OutputCollector collector;
+        boost::shared_ptr<ProcessManager> pm(new ProcessManagerImpl);
+        boost::shared_ptr<ProcessFuture> ph(
+            pm->CreateProcessDontRun("seq 1 100000; echo done >&2"));
+        ph->SetOutputCallback(
+            boost::bind(&OutputCollector::Collect, &collector, _1, _2, _3),
+            8192);
+        pm->RunProcess(ph);
+
+        collector.WaitForEnd();
+        ASSERT_EQ(expectedSeqOutput(100000), collector.mOutput);
+        ASSERT_EQ("done\n", collector.mError);
+        ASSERT_NO_THROW(ph->GetResult());
+        ASSERT_EQ(0, ph->GetStatusCode());
+        ASSERT_THROW(ph->ReadOutput(ProcessFuture::OutputStdout, NULL, 0),
+                     EProcessFutureNotStreaming);
+    }
+    catch (std::exception& e)
+    {
+        hlog(HLOG_ERR, "exception: %s", e.what());
+        FAIL();
+    }
+}
@@ -0,0 +1,257 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "AutoFD.h"
+#include "Clock.h"
+#include "Foreach.h"
+#include "FunctionThread.h"
+#include "ReceiverThread.h"
+#include "RequestHandler.h"
+#include "SocketUtil.h"
+#include "ThreadPoolDispatcher.h"
+
+#include <boost/bind.hpp>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// measures how many connections per second reach the request handler
+// when clients connect as fast as they can, with the single receiver
+// and with groups of ReusePort receivers
+
+static const int BENCHMARK_CLIENTS = 8;
+static const int BENCHMARK_CONNECTIONS = 20000;
+static const int BENCHMARK_BACKLOG = 128;
+static const int BENCHMARK_WORKERS = 4;
+static const int BENCHMARK_SINGLE_PORT = 18719;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class CloseRequestHandler : public RequestHandler
+{
+public:
+    CloseRequestHandler() : RequestHandler(0), mHandled(0) {}
+
+    void Handler(Event *e) {
+        RequestEvent* event = dynamic_cast<RequestEvent*>(e);
+        close(event->mFD);
+        __sync_add_and_fetch(&mHandled, 1);
+    }
+
+    void Busy(void) {}
+    void Periodic(void) {}
+    void Init(void) {}
+    void Cleanup(void) {}
+
+    int GetHandled() const {
+        return mHandled;
+    }
+
+    volatile int mHandled;
+};
+
+// connects and resets, so that no client port is left in TIME_WAIT
+static void connectClients(int port, int connections, volatile int *failed)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    struct linger reset;
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+
+    for (int i = 0; i < connections; ++i)
+    {
+        AutoFD fd(socket(AF_INET, SOCK_STREAM, 0));
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)) == -1)
+            __sync_add_and_fetch(failed, 1);
+    }
+}
+
+class ReceiverThreadBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+
+        mHandler.reset(new CloseRequestHandler());
+        mDispatcher.reset(
+            new ThreadPoolDispatcher(mHandler,
+                                     BENCHMARK_WORKERS,
+                                     BENCHMARK_WORKERS,
+                                     BENCHMARK_WORKERS,
+                                     BENCHMARK_WORKERS,
+                                     BENCHMARK_CONNECTIONS,
+                                     BENCHMARK_CONNECTIONS,
+                                     "bench-recv"));
+        // let the thread pool manager start its workers
+        sleep(2);
+    }
+
+    void TearDown() {
+        mDispatcher->Shutdown();
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    // returns the number of connections the clients could not make
+    int connectAll(int port, int connections, Timespec &elapsed) {
+        volatile int failed = 0;
+        const int before = mHandler->GetHandled();
+
+        TimerClock timer;
+        timer.Start();
+        {
+            std::vector<boost::shared_ptr<FunctionThread> > clients;
+            for (int i = 0; i < BENCHMARK_CLIENTS; ++i)
+            {
+                clients.push_back(
+                    boost::shared_ptr<FunctionThread>(
+                        new FunctionThread(
+                            FunctionThread::AutoInit(),
+                            boost::bind(&connectClients, port,
+                                        connections / BENCHMARK_CLIENTS,
+                                        &failed),
+                            "bench-client")));
+            }
+            foreach (const boost::shared_ptr<FunctionThread> &client, clients)
+                client->WaitForShutdown();
+        }
+
+        const int expected = before + connections - failed;
+        DeadlineClock deadline;
+        deadline.ExpiresInSeconds(60);
+        while (mHandler->GetHandled() < expected && !deadline.Expired())
+        {
+            usleep(1000);
+        }
+        timer.Stop();
+        elapsed = timer.GetTime();
+        EXPECT_EQ(expected, mHandler->GetHandled());
+        return failed;
+    }
+
+    void report(const char *name, int failed, const Timespec &elapsed) {
+        const long long elapsedUsec = std::max(1LL, asMicrosec(elapsed));
+        const long long handled = BENCHMARK_CONNECTIONS - failed;
+        hlogstream(HLOG_INFO, name
+                   << " connections=" << handled
+                   << " refused=" << failed
+                   << " elapsed_ms=" << elapsed.AsMillisec()
+                   << " connections/s=" << (handled * 1000000LL) / elapsedUsec);
+    }
+
+    void runGroup(const char *name, int threads) {
+        ReceiverThreadGroup group(mDispatcher, "bench", 0,
+                                  BENCHMARK_BACKLOG, threads);
+        Timespec elapsed;
+        const int failed = connectAll(group.GetPort(),
+                                      BENCHMARK_CONNECTIONS, elapsed);
+        report(name, failed, elapsed);
+
+        ReceiverThread::Stats stats;
+        group.GetStats(stats);
+        EXPECT_EQ(static_cast<uint64_t>(BENCHMARK_CONNECTIONS - failed),
+                  stats.mAccepted);
+        hlogstream(HLOG_INFO, name
+                   << " batches=" << stats.mBatches
+                   << " per_batch=" << stats.mAccepted / std::max(1ULL,
+                       static_cast<unsigned long long>(stats.mBatches))
+                   << " accept_errors=" << stats.mAcceptErrors
+                   << " overflows=" << stats.mOverflows);
+    }
+
+    boost::shared_ptr<CloseRequestHandler> mHandler;
+    boost::shared_ptr<Dispatcher> mDispatcher;
+};
+
+TEST_F(ReceiverThreadBenchmarkOnBoxTest, GroupSharesPortAndCounts)
+{
+    FTRACE;
+    ReceiverThreadGroup group(mDispatcher, "test", 0, BENCHMARK_BACKLOG, 3);
+    ASSERT_EQ(3U, group.GetThreadCount());
+    ASSERT_GT(group.GetPort(), 0);
+
+    Timespec elapsed;
+    ASSERT_EQ(0, connectAll(group.GetPort(), 400, elapsed));
+
+    ReceiverThread::Stats stats;
+    group.GetStats(stats);
+    EXPECT_EQ(400U, stats.mAccepted);
+    EXPECT_GE(stats.mBatches, 1U);
+    EXPECT_LE(stats.mBatches, 400U);
+    EXPECT_EQ(0U, stats.mAcceptErrors);
+    EXPECT_EQ(0U, stats.mDispatchFailures);
+
+    // sampled on the next idle poll
+    usleep(1100000);
+    group.GetStats(stats);
+    EXPECT_EQ(3U * BENCHMARK_BACKLOG, stats.mQueueLimit);
+    EXPECT_EQ(0U, stats.mQueued);
+}
+
+TEST_F(ReceiverThreadBenchmarkOnBoxTest, GroupRequiresAThread)
+{
+    FTRACE;
+    ASSERT_THROW(ReceiverThreadGroup(mDispatcher, "test", 0,
+                                     BENCHMARK_BACKLOG, 0),
+                 EReceiverThreadCountInvalid);
+}
+
+TEST_F(ReceiverThreadBenchmarkOnBoxTest, Single)
+{
+    FTRACE;
+    ReceiverThread receiver(mDispatcher, "bench", BENCHMARK_SINGLE_PORT,
+                            BENCHMARK_BACKLOG, "127.0.0.1");
+    // it starts listening on its own thread
+    usleep(100000);
+
+    Timespec elapsed;
+    const int failed = connectAll(BENCHMARK_SINGLE_PORT,
+                                  BENCHMARK_CONNECTIONS, elapsed);
+    report("single", failed, elapsed);
+}
+
+TEST_F(ReceiverThreadBenchmarkOnBoxTest, ReusePort1)
+{
+    FTRACE;
+    runGroup("reuseport-1", 1);
+}
+
+TEST_F(ReceiverThreadBenchmarkOnBoxTest, ReusePort4)
+{
+    FTRACE;
+    runGroup("reuseport-4", 4);
+}
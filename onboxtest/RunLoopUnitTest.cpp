@@ -2,6 +2,7 @@
 #include <gmock/gmock.h>
 #include "LogManager.h"
 #include "RunLoop.h"
+#include "ThreadPoolDispatcher.h"
 #include "Timer.h"
 #include <boost/make_shared.hpp>
 #include <boost/bind.hpp>
@@ -108,3 +109,74 @@ TEST_F(RunLoopTest, ScheduledInPast)
     rl->Shutdown();
     rl->WaitForShutdown();
 }
+
+TEST_F(RunLoopTest, WheelMulti)
+{
+    boost::shared_ptr<TimerTarget> target = make_shared<TimerTarget>();
+    boost::shared_ptr<RunLoop> rl(
+        new RunLoop("test", Forte::Timespec::FromMillisec(1)));
+    std::list<boost::shared_ptr<Timer> > timers;
+    for (int i = 1; i < 6; ++i)
+    {
+        boost::shared_ptr<Timer> t = make_shared<Timer>("TimerTarget::TimerFired",
+            rl, boost::bind(&TimerTarget::TimerFired, target),
+            Forte::Timespec::FromMillisec(200*i), false);
+        rl->AddTimer(t);
+        timers.push_back(t);
+    }
+    EXPECT_FALSE(rl->IsEmpty());
+
+    usleep(100000);
+    for (int i = 1; i < 6; ++i)
+    {
+        usleep(200000);
+        EXPECT_EQ(i, target->mCount);
+    }
+    EXPECT_TRUE(rl->IsEmpty());
+    rl->Shutdown();
+    rl->WaitForShutdown();
+}
+
+TEST_F(RunLoopTest, WheelRepeatsUntilDestroyed)
+{
+    boost::shared_ptr<TimerTarget> target = make_shared<TimerTarget>();
+    boost::shared_ptr<RunLoop> rl(
+        new RunLoop("test", Forte::Timespec::FromMillisec(1)));
+    boost::shared_ptr<Timer> t = make_shared<Timer>("TimerTarget::TimerFired",
+        rl, boost::bind(&TimerTarget::TimerFired, target),
+        Forte::Timespec::FromMillisec(100), true);
+    rl->AddTimer(t);
+
+    usleep(550000);
+    EXPECT_EQ(5, target->mCount);
+    t.reset();
+    usleep(300000);
+    EXPECT_EQ(5, target->mCount);
+    rl->Shutdown();
+    rl->WaitForShutdown();
+}
+
+TEST_F(RunLoopTest, WheelDispatcher)
+{
+    boost::shared_ptr<TimerTarget> target = make_shared<TimerTarget>();
+    boost::shared_ptr<Dispatcher> dispatcher(
+        new ThreadPoolDispatcher(
+            boost::shared_ptr<RequestHandler>(new TimerRequestHandler()),
+            1, 1, 1, 1, 16, 128, "timers"));
+    boost::shared_ptr<RunLoop> rl(
+        new RunLoop("test", Forte::Timespec::FromMillisec(1), dispatcher));
+    std::list<boost::shared_ptr<Timer> > timers;
+    for (int i = 0; i < 5; ++i)
+    {
+        boost::shared_ptr<Timer> t = make_shared<Timer>("TimerTarget::TimerFired",
+            rl, boost::bind(&TimerTarget::TimerFired, target),
+            Forte::Timespec::FromMillisec(-100*i), false);
+        rl->AddTimer(t);
+        timers.push_back(t);
+    }
+    usleep(100000);
+    EXPECT_EQ(5, target->mCount);
+    rl->Shutdown();
+    rl->WaitForShutdown();
+    dispatcher->Shutdown();
+}
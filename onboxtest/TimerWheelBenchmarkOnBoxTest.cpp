@@ -0,0 +1,205 @@
+// #SCQAD TESTAG: forte
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+#include "Clock.h"
+#include "RunLoop.h"
+#include "ThreadPoolDispatcher.h"
+#include "Timer.h"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+// compares the cost of adding timers and how late they fire, for a
+// RunLoop with its sorted schedule and with a TimerWheel, with 100k
+// timers spread over a few seconds
+
+static const int BENCHMARK_TIMERS = 100000;
+static const int BENCHMARK_SPREAD_MS = 3000;
+static const int BENCHMARK_FIRST_MS = 1000;
+static const int BENCHMARK_THREADS = 4;
+
+static long long asMicrosec(const Timespec& t)
+{
+    const struct timespec ts = t;
+    return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+}
+
+class FireRecorder : public Object
+{
+public:
+    FireRecorder(int timers)
+        : mDue(timers),
+          mLatenciesUsec(timers, 0),
+          mFired(0)
+        {
+        }
+
+    void Fired(int i) {
+        mLatenciesUsec[i] = asMicrosec(mClock.GetTime() - mDue[i]);
+        __sync_add_and_fetch(&mFired, 1);
+    }
+
+    int GetFired() const {
+        return mFired;
+    }
+
+    MonotonicClock mClock;
+    std::vector<Timespec> mDue;
+    std::vector<long long> mLatenciesUsec;
+    volatile int mFired;
+};
+
+class TimerWheelBenchmarkOnBoxTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_NODEBUG);
+        logManager.BeginLogging("//stderr",
+                                HLOG_NODEBUG,
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void runBenchmark(const char *name,
+                      const boost::shared_ptr<RunLoop> &rl,
+                      const boost::shared_ptr<Dispatcher> &dispatcher) {
+        boost::shared_ptr<FireRecorder> recorder(
+            new FireRecorder(BENCHMARK_TIMERS));
+
+        unsigned int seed = 1;
+        std::vector<boost::shared_ptr<Timer> > timers;
+        for (int i = 0; i < BENCHMARK_TIMERS; ++i)
+        {
+            const int ms = BENCHMARK_FIRST_MS + rand_r(&seed) % BENCHMARK_SPREAD_MS;
+            timers.push_back(
+                boost::shared_ptr<Timer>(
+                    new Timer("bench", rl,
+                              boost::bind(&FireRecorder::Fired, recorder, i),
+                              Timespec::FromMillisec(ms), false)));
+        }
+
+        MonotonicClock clock;
+        TimerClock insert;
+        insert.Start();
+        for (int i = 0; i < BENCHMARK_TIMERS; ++i)
+        {
+            recorder->mDue[i] = clock.GetTime() + timers[i]->GetInterval();
+            rl->AddTimer(timers[i]);
+        }
+        insert.Stop();
+
+        DeadlineClock deadline;
+        deadline.ExpiresInSeconds(60);
+        while (recorder->GetFired() < BENCHMARK_TIMERS && !deadline.Expired())
+        {
+            usleep(10000);
+        }
+        rl->Shutdown();
+        rl->WaitForShutdown();
+        if (dispatcher)
+            dispatcher->Shutdown();
+
+        ASSERT_EQ(BENCHMARK_TIMERS, recorder->GetFired());
+
+        std::vector<long long>& latencies(recorder->mLatenciesUsec);
+        double sum = 0, squares = 0;
+        for (size_t i = 0; i < latencies.size(); ++i)
+        {
+            sum += latencies[i];
+            squares += (double) latencies[i] * latencies[i];
+        }
+        const double mean = sum / latencies.size();
+        const double stddev = sqrt(squares / latencies.size() - mean * mean);
+
+        std::sort(latencies.begin(), latencies.end());
+        long long p50 = latencies[latencies.size() / 2];
+        long long p99 = latencies[(latencies.size() * 99) / 100];
+        long long max = latencies.back();
+        long long insertNsec =
+            asMicrosec(insert.GetTime()) * 1000 / BENCHMARK_TIMERS;
+
+        hlogstream(HLOG_INFO, name
+                   << " timers=" << BENCHMARK_TIMERS
+                   << " insert_ns=" << insertNsec
+                   << " late_p50_us=" << p50
+                   << " late_p99_us=" << p99
+                   << " late_max_us=" << max
+                   << " jitter_us=" << (long long) stddev);
+    }
+};
+
+TEST_F(TimerWheelBenchmarkOnBoxTest, Sorted)
+{
+    FTRACE;
+    runBenchmark("sorted",
+                 boost::shared_ptr<RunLoop>(new RunLoop("bench")),
+                 boost::shared_ptr<Dispatcher>());
+}
+
+TEST_F(TimerWheelBenchmarkOnBoxTest, Wheel)
+{
+    FTRACE;
+    runBenchmark("wheel",
+                 boost::shared_ptr<RunLoop>(
+                     new RunLoop("bench", Timespec::FromMillisec(1))),
+                 boost::shared_ptr<Dispatcher>());
+}
+
+// timers fire up to a tick late, so a finer tick trades more wakeups
+// for less lateness
+TEST_F(TimerWheelBenchmarkOnBoxTest, WheelFineTick)
+{
+    FTRACE;
+    runBenchmark("wheel-100us",
+                 boost::shared_ptr<RunLoop>(
+                     new RunLoop("bench", Timespec(0, 100000))),
+                 boost::shared_ptr<Dispatcher>());
+}
+
+TEST_F(TimerWheelBenchmarkOnBoxTest, WheelDispatched)
+{
+    FTRACE;
+    boost::shared_ptr<Dispatcher> dispatcher(
+        new ThreadPoolDispatcher(
+            boost::shared_ptr<RequestHandler>(new TimerRequestHandler()),
+            BENCHMARK_THREADS,
+            BENCHMARK_THREADS,
+            BENCHMARK_THREADS,
+            BENCHMARK_THREADS,
+            BENCHMARK_TIMERS,
+            BENCHMARK_TIMERS,
+            "bench-timers"));
+    // let the thread pool manager start its workers
+    sleep(2);
+    runBenchmark("wheel-dispatched",
+                 boost::shared_ptr<RunLoop>(
+                     new RunLoop("bench", Timespec::FromMillisec(1), dispatcher)),
+                 dispatcher);
+}
@@ -1,6 +1,8 @@
 #include "Exception.h"
 #include "LogManager.h"
 #include "ProcessMonitor.h"
+#include "ProcessWorker.h"
+#include <string.h>
 
 /**
  * procmon is a process which is started by the ProcManager class for
@@ -8,11 +10,23 @@
  * maintained with the originating ProcManager instance, and status
  * and output are communicated back to the ProcManager via the Forte
  * PDUPeer system.
+ *
+ * Run as "procmon -w <fd>", it is instead a pooled ProcessWorker,
+ * which runs many commands for the ProcManager over one connection.
  */
 int main(int argc, char *argv[])
 {
     try
     {
+        if (argc > 1 && strcmp(argv[1], "-w") == 0)
+        {
+            boost::shared_ptr<Forte::ProcessWorker> worker
+                (new Forte::ProcessWorker(argc, argv));
+            worker->Run();
+            fprintf(stderr, "PROCMON: exiting\n");
+            return 0;
+        }
+
         boost::shared_ptr<Forte::ProcessMonitor> pm
             (new Forte::ProcessMonitor(argc, argv));
         pm->Run();
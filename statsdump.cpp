@@ -0,0 +1,86 @@
+#include "Exception.h"
+#include "LogManager.h"
+#include "StatsSegment.h"
+#include "Foreach.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * statsdump prints the stats a server publishes in a StatsSegment, one
+ * "name value" line each, without making any call into the server.
+ */
+
+using namespace Forte;
+
+namespace
+{
+    void usage(void)
+    {
+        fprintf(stderr,
+                "usage: statsdump [-p prefix] [-i seconds] segment\n"
+                "  -p prefix   only stats whose names start with prefix\n"
+                "  -i seconds  print again every interval until interrupted\n");
+        exit(2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *prefix("");
+    unsigned int interval(0);
+
+    int c;
+    while ((c = getopt(argc, argv, "p:i:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'p':
+            prefix = optarg;
+            break;
+        case 'i':
+            interval = strtoul(optarg, NULL, 10);
+            if (interval == 0)
+                usage();
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+
+    try
+    {
+        StatsSegmentReader reader(argv[optind]);
+        const size_t prefixLen(strlen(prefix));
+        std::map<FString, int64_t> stats;
+        while (true)
+        {
+            stats.clear();
+            reader.Read(stats);
+
+            typedef std::pair<FString, int64_t> StatPair;
+            foreach (const StatPair &stat, stats)
+            {
+                if (stat.first.compare(0, prefixLen, prefix) != 0)
+                    continue;
+                printf("%s %lld\n", stat.first.c_str(),
+                       static_cast<long long>(stat.second));
+            }
+
+            if (interval == 0)
+                break;
+            printf("\n");
+            fflush(stdout);
+            sleep(interval);
+        }
+    }
+    catch (Exception &e)
+    {
+        fprintf(stderr, "statsdump: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// GroupCommitBenchmark.cpp
+//
+// commits/s for small auto-committed inserts from 1 to 16 writer
+// threads, each thread on its own DbLiteConnection, against the same
+// writers submitting to a DbLiteGroupCommit
+
+#include "LogManager.h"
+#include "Clock.h"
+#include "DbLiteConnection.h"
+#include "DbLiteGroupCommit.h"
+#include "DbSqlStatement.h"
+#include "DbUtil.h"
+#include "Thread.h"
+#include <unistd.h>
+#include <vector>
+
+using namespace Forte;
+
+#define BENCHMARK_DB "/tmp/GroupCommitBenchmark.db"
+
+static const int INSERTS_PER_THREAD = 200;
+
+class WriterThread : public Thread
+{
+public:
+    WriterThread(int id, DbLiteGroupCommit *groupCommit) :
+        mId(id), mGroupCommit(groupCommit), mFailures(0)
+    {
+        initialized();
+    }
+    virtual ~WriterThread() { deleting(); }
+
+    int mFailures;
+
+protected:
+    virtual void *run(void)
+    {
+        DbLiteConnection db;
+        if (mGroupCommit == NULL && !db.Init(BENCHMARK_DB))
+        {
+            mFailures = INSERTS_PER_THREAD;
+            return NULL;
+        }
+
+        for (int i = 0; i < INSERTS_PER_THREAD; ++i)
+        {
+            InsertDbSqlStatement insert(
+                "INSERT INTO bench (writer, value) VALUES (?, ?)");
+            insert.BindInt(mId).BindInt(i);
+            try
+            {
+                if (mGroupCommit == NULL)
+                    DbExecute(db, insert);
+                else
+                    mGroupCommit->Submit(insert)->GetResult();
+            }
+            catch (Exception &)
+            {
+                ++mFailures;
+            }
+        }
+        return NULL;
+    }
+
+    int mId;
+    DbLiteGroupCommit *mGroupCommit;
+};
+
+static void createTable(void)
+{
+    unlink(BENCHMARK_DB);
+
+    DbLiteConnection db(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.Init(BENCHMARK_DB);
+    DbExecute(db, "CREATE TABLE bench (id INTEGER PRIMARY KEY, "
+              "writer INTEGER NOT NULL, value INTEGER NOT NULL)");
+}
+
+static void runBenchmark(int threads, bool grouped)
+{
+    createTable();
+
+    boost::shared_ptr<DbLiteGroupCommit> groupCommit;
+    if (grouped)
+        groupCommit.reset(new DbLiteGroupCommit(BENCHMARK_DB));
+
+    TimerClock timer;
+    timer.Start();
+
+    std::vector<boost::shared_ptr<WriterThread> > writers;
+    for (int i = 0; i < threads; ++i)
+    {
+        writers.push_back(boost::shared_ptr<WriterThread>(
+                              new WriterThread(i, groupCommit.get())));
+    }
+
+    int failures = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        writers[i]->WaitForShutdown();
+        failures += writers[i]->mFailures;
+    }
+    timer.Stop();
+
+    const int commits = threads * INSERTS_PER_THREAD - failures;
+    const long long ms = timer.GetTime().AsMillisec();
+    hlog(HLOG_INFO, "%-12s threads=%2d commits=%d failed=%d ms=%lld "
+         "commits/s=%.0f batches=%lld",
+         grouped ? "group commit" : "autocommit", threads, commits,
+         failures, ms, ms > 0 ? commits * 1000.0 / ms : 0.0,
+         grouped ? (long long) groupCommit->GetStat("batches") : 0LL);
+}
+
+int main(int argc, char *argv[])
+{
+    LogManager logManager;
+    logManager.BeginLogging("//stderr", HLOG_NODEBUG);
+
+    const int threadCounts[] = { 1, 2, 4, 8, 16 };
+    try
+    {
+        for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]);
+             ++i)
+        {
+            runBenchmark(threadCounts[i], false);
+            runBenchmark(threadCounts[i], true);
+        }
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "benchmark failed: %s", e.what());
+        unlink(BENCHMARK_DB);
+        return 1;
+    }
+
+    unlink(BENCHMARK_DB);
+    return 0;
+}
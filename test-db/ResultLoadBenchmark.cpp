@@ -0,0 +1,124 @@
+// ResultLoadBenchmark.cpp
+//
+// time to first row, total time and peak memory for reading a 1M row
+// table through DbLiteConnection Store() and Use(). each run is in
+// its own process so the peak resident size is its own.
+
+#include "LogManager.h"
+#include "Clock.h"
+#include "DbLiteConnection.h"
+#include "DbUtil.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace Forte;
+
+#define BENCHMARK_DB "/tmp/ResultLoadBenchmark.db"
+
+static const int ROWS = 1000000;
+
+static long maxRssKb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void createTable(void)
+{
+    unlink(BENCHMARK_DB);
+
+    DbLiteConnection db(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.Init(BENCHMARK_DB);
+    DbExecute(db, "PRAGMA synchronous = OFF");
+    DbExecute(db, "CREATE TABLE bench (id INTEGER PRIMARY KEY, "
+              "name TEXT NOT NULL, value INTEGER)");
+    DbExecute(db, FString(FStringFC(),
+                          "WITH RECURSIVE n(x) AS "
+                          "(SELECT 1 UNION ALL SELECT x + 1 FROM n "
+                          "WHERE x < %d) "
+                          "INSERT INTO bench SELECT x, 'name of row ' || x, "
+                          "CASE WHEN x %% 10 = 0 THEN NULL ELSE x * 7 END "
+                          "FROM n", ROWS));
+}
+
+static void runBenchmark(bool use)
+{
+    DbLiteConnection db;
+    db.Init(BENCHMARK_DB);
+    const long rssBefore = maxRssKb();
+
+    TimerClock firstRowTimer, totalTimer;
+    firstRowTimer.Start();
+    totalTimer.Start();
+
+    DbResult res;
+    if (use)
+        res = DbUse(db, "SELECT id, name, value FROM bench");
+    else
+        res = DbStore(db, "SELECT id, name, value FROM bench");
+
+    DbResultRow row;
+    long long rows = 0, total = 0;
+    while (res.FetchRow(row))
+    {
+        if (rows++ == 0)
+            firstRowTimer.Stop();
+        total += strlen(row[1]);
+        if (row[2] != NULL)
+            total += strtoll(row[2], NULL, 10);
+    }
+    totalTimer.Stop();
+
+    hlog(HLOG_INFO, "%-6s rows=%lld first_row_ms=%lld total_ms=%lld "
+         "peak_rss_kb=%ld (checksum %lld)",
+         use ? "Use" : "Store", rows,
+         firstRowTimer.GetTime().AsMillisec(),
+         totalTimer.GetTime().AsMillisec(),
+         maxRssKb() - rssBefore, total);
+}
+
+static int runInChild(bool use)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        try
+        {
+            runBenchmark(use);
+        }
+        catch (Exception &e)
+        {
+            hlog(HLOG_ERR, "benchmark failed: %s", e.what());
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid)
+        return 1;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    LogManager logManager;
+    logManager.BeginLogging("//stderr", HLOG_NODEBUG);
+
+    try
+    {
+        createTable();
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "creating the table failed: %s", e.what());
+        return 1;
+    }
+
+    int ret = runInChild(false) | runInChild(true);
+    unlink(BENCHMARK_DB);
+    return ret;
+}
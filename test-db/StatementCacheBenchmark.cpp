@@ -0,0 +1,133 @@
+// StatementCacheBenchmark.cpp
+//
+// inserts/s and selects/s through DbLiteConnection with statements
+// built with escaped literals, with bound values prepared every time,
+// and with bound values from the prepared statement cache
+
+#include "LogManager.h"
+#include "Clock.h"
+#include "DbLiteConnection.h"
+#include "DbSqlStatement.h"
+#include "DbUtil.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Forte;
+
+#define BENCHMARK_DB "/tmp/StatementCacheBenchmark.db"
+
+static const int ROWS = 20000;
+
+enum Mode {
+    ESCAPED,
+    BOUND_UNCACHED,
+    BOUND_CACHED
+};
+
+static const char *modeName(Mode mode)
+{
+    switch (mode)
+    {
+    case ESCAPED: return "escaped";
+    case BOUND_UNCACHED: return "bound, uncached";
+    case BOUND_CACHED: return "bound, cached";
+    }
+    return "";
+}
+
+static double perSecond(int count, TimerClock &timer)
+{
+    const long long ms = timer.GetTime().AsMillisec();
+    return ms > 0 ? count * 1000.0 / ms : 0.0;
+}
+
+static void runBenchmark(Mode mode)
+{
+    unlink(BENCHMARK_DB);
+
+    DbLiteConnection db(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.Init(BENCHMARK_DB);
+    db.SetStatementCacheSize(mode == BOUND_UNCACHED ? 0 : 64);
+    DbExecute(db, "PRAGMA synchronous = OFF");
+    DbExecute(db, "CREATE TABLE bench (id INTEGER PRIMARY KEY, "
+              "name TEXT NOT NULL, value INTEGER NOT NULL)");
+
+    // one transaction, so the statements and not the syncs are timed
+    TimerClock insertTimer;
+    insertTimer.Start();
+    DbExecute(db, "BEGIN");
+    for (int i = 0; i < ROWS; i++)
+    {
+        const FString name(FStringFC(), "row '%d'", i);
+        if (mode == ESCAPED)
+        {
+            DbExecute(db, FString(FStringFC(),
+                                  "INSERT INTO bench VALUES (%d, '%s', %d)",
+                                  i, DbEscape(db, name).c_str(), i * 7));
+        }
+        else
+        {
+            InsertDbSqlStatement insert("INSERT INTO bench VALUES (?, ?, ?)");
+            insert.BindInt(i).BindText(name).BindInt(i * 7);
+            DbExecute(db, insert);
+        }
+    }
+    DbExecute(db, "COMMIT");
+    insertTimer.Stop();
+
+    TimerClock selectTimer;
+    selectTimer.Start();
+    long long total = 0;
+    for (int i = 0; i < ROWS; i++)
+    {
+        const int id = (i * 7919) % ROWS;
+        DbResult res;
+        if (mode == ESCAPED)
+        {
+            res = DbStore(db, FString(FStringFC(),
+                                      "SELECT name, value FROM bench "
+                                      "WHERE id = %d", id));
+        }
+        else
+        {
+            SelectDbSqlStatement select(
+                "SELECT name, value FROM bench WHERE id = ?");
+            select.BindInt(id);
+            res = DbStore(db, select);
+        }
+        DbResultRow row;
+        if (res.FetchRow(row) && row[1] != NULL)
+            total += strtoll(row[1], NULL, 10);
+    }
+    selectTimer.Stop();
+
+    hlog(HLOG_INFO, "%-16s inserts/s=%.0f selects/s=%.0f "
+         "cache hits=%lld misses=%lld (checksum %lld)",
+         modeName(mode),
+         perSecond(ROWS, insertTimer), perSecond(ROWS, selectTimer),
+         (long long) db.GetStat("statementCacheHits"),
+         (long long) db.GetStat("statementCacheMisses"),
+         total);
+
+    db.Close();
+    unlink(BENCHMARK_DB);
+}
+
+int main(int argc, char *argv[])
+{
+    LogManager logManager;
+    logManager.BeginLogging("//stderr", HLOG_NODEBUG);
+
+    try
+    {
+        runBenchmark(ESCAPED);
+        runBenchmark(BOUND_UNCACHED);
+        runBenchmark(BOUND_CACHED);
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "benchmark failed: %s", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// TypedRowBenchmark.cpp
+//
+// rows/s decoding a table into the class dbc generates for it
+// (TypedRowBenchmark.sql) through DbRow::Set(const DbResultRow&),
+// which parses the text of every column, against the typed
+// Set(sqlite3_stmt*) a streamed sqlite result hands the row, and the
+// same for lookups by primary key
+
+#include "LogManager.h"
+#include "Clock.h"
+#include "DbLiteConnection.h"
+#include "DbSqlStatement.h"
+#include "DbUtil.h"
+#include "db_bench_row.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Forte;
+
+#define BENCHMARK_DB "/tmp/TypedRowBenchmark.db"
+
+static const int ROWS = 200000;
+static const int LOOKUPS = 50000;
+
+#define SELECT_ALL "SELECT id, name, total, size, enabled, data FROM bench_row"
+
+enum Mode {
+    STORE_TEXT,
+    USE_TEXT,
+    USE_TYPED
+};
+
+static const char *modeName(Mode mode)
+{
+    switch (mode)
+    {
+    case STORE_TEXT: return "Store, Set(row)";
+    case USE_TEXT: return "Use, Set(row)";
+    case USE_TYPED: return "Use, Set(stmt)";
+    }
+    return "";
+}
+
+static double perSecond(int count, TimerClock &timer)
+{
+    const long long ms = timer.GetTime().AsMillisec();
+    return ms > 0 ? count * 1000.0 / ms : 0.0;
+}
+
+static void createTable(DbConnection &db)
+{
+    DbExecute(db, "PRAGMA synchronous = OFF");
+    DbExecute(db, "CREATE TABLE bench_row (id INTEGER PRIMARY KEY, "
+              "name TEXT NOT NULL, total INTEGER NOT NULL, "
+              "size INTEGER NOT NULL, enabled INTEGER NOT NULL, "
+              "data BLOB)");
+
+    // the generated Insert() binds its values
+    TimerClock timer;
+    timer.Start();
+    DbExecute(db, "BEGIN");
+    db_bench_row row;
+    for (int i = 0; i < ROWS; i++)
+    {
+        row.mName.Format("name of row %d", i);
+        row.mTotal = i * 7;
+        row.mSize = 1000000000000ULL + i;
+        row.mEnabled = (i % 3 == 0);
+        row.mData.assign(64, static_cast<char>(i));
+        row.Insert(db);
+    }
+    DbExecute(db, "COMMIT");
+    timer.Stop();
+
+    hlog(HLOG_INFO, "%-16s %10.0f rows/s", "Insert()",
+         perSecond(ROWS, timer));
+}
+
+static long long decode(DbConnection &db, Mode mode)
+{
+    long long total = 0;
+    db_bench_row row;
+    if (mode == USE_TYPED)
+    {
+        DbResult res = DbUse(db, SelectDbSqlStatement(SELECT_ALL));
+        while (res.FetchRow(row))
+            total += row.mTotal + row.mSize + row.mName.length();
+        return total;
+    }
+
+    DbResult res;
+    if (mode == STORE_TEXT)
+        res = db_bench_row::Select(db);
+    else
+        res = DbUse(db, SelectDbSqlStatement(SELECT_ALL));
+    DbResultRow values;
+    while (res.FetchRow(values))
+    {
+        row.Set(values);
+        total += row.mTotal + row.mSize + row.mName.length();
+    }
+    return total;
+}
+
+static long long lookup(DbConnection &db, bool typed)
+{
+    long long total = 0;
+    unsigned int seed = 1;
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        const long long id = 1 + rand_r(&seed) % ROWS;
+        if (typed)
+        {
+            db_bench_row row(db, id);
+            total += row.mTotal;
+        }
+        else
+        {
+            DbResult res = db_bench_row::SelectPrimaryKey(db, id);
+            DbResultRow values;
+            if (!res.FetchRow(values))
+                throw DbException("row not found");
+            db_bench_row row(values);
+            total += row.mTotal;
+        }
+    }
+    return total;
+}
+
+static void runBenchmark(void)
+{
+    unlink(BENCHMARK_DB);
+
+    DbLiteConnection db(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.Init(BENCHMARK_DB);
+    createTable(db);
+
+    const Mode modes[] = { STORE_TEXT, USE_TEXT, USE_TYPED };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        TimerClock timer;
+        timer.Start();
+        const long long total = decode(db, modes[i]);
+        timer.Stop();
+
+        hlog(HLOG_INFO, "%-16s %10.0f rows/s (checksum %lld)",
+             modeName(modes[i]), perSecond(ROWS, timer), total);
+    }
+
+    for (int typed = 0; typed < 2; typed++)
+    {
+        TimerClock timer;
+        timer.Start();
+        const long long total = lookup(db, typed);
+        timer.Stop();
+
+        hlog(HLOG_INFO, "%-16s %10.0f lookups/s (checksum %lld)",
+             typed ? "by key, typed" : "by key, text",
+             perSecond(LOOKUPS, timer), total);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    LogManager logManager;
+    logManager.BeginLogging("//stderr", HLOG_NODEBUG);
+
+    int ret = 0;
+    try
+    {
+        runBenchmark();
+    }
+    catch (Exception &e)
+    {
+        hlog(HLOG_ERR, "benchmark failed: %s", e.what());
+        ret = 1;
+    }
+
+    unlink(BENCHMARK_DB);
+    return ret;
+}
@@ -0,0 +1,14 @@
+-- TypedRowBenchmark.sql
+--
+-- the table TypedRowBenchmark reads, run through dbc to generate
+-- db_bench_row.h and db_bench_row.cpp
+
+CREATE TABLE bench_row (
+  `id` bigint(20) NOT NULL AUTO_INCREMENT,
+  `name` varchar(64) NOT NULL,
+  `total` int(11) NOT NULL,
+  `size` bigint(20) unsigned NOT NULL,
+  `enabled` boolean NOT NULL,
+  `data` blob,
+  PRIMARY KEY (`id`)
+);
@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include "LogManager.h"
+#include "BinaryLogfile.h"
+#include "FTrace.h"
+#include "Foreach.h"
+#include <errno.h>
+#include <fstream>
+#include <sys/time.h>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+
+LogManager logManager;
+
+static const char* TEXT_LOGFILE = "./BinaryLogfileUnitTest.text.log";
+static const char* BINARY_LOGFILE = "./BinaryLogfileUnitTest.blog";
+static const char* ROTATED_LOGFILE = "./BinaryLogfileUnitTest.blog.1";
+
+// everything but the timestamp, which the binary log rebuilds from
+// the monotonic clock
+static const unsigned int COMPARE_FORMAT =
+    HLOG_FORMAT_ALL & ~HLOG_FORMAT_TIMESTAMP;
+
+class TextRenderer : public Logfile
+{
+public:
+    TextRenderer(unsigned int formatMask)
+        : Logfile("//stdout", NULL, HLOG_ALL, false, formatMask) {}
+    FString Render(const LogMsg &msg) { return formatMsg(msg); }
+};
+
+static void readLines(const char *path, std::vector<std::string>& lines)
+{
+    ifstream in(path);
+    std::string line;
+    while (getline(in, line))
+        lines.push_back(line + "\n");
+}
+
+static void decode(const char *path, std::vector<std::string>& lines,
+                   unsigned int formatMask = COMPARE_FORMAT)
+{
+    TextRenderer renderer(formatMask);
+    BinaryLogReader reader(path);
+    LogMsg msg;
+    while (reader.Next(msg))
+        lines.push_back(renderer.Render(msg));
+    EXPECT_EQ(0, reader.GetUndecodableCount());
+}
+
+static void logVariety(void)
+{
+    FTRACE;
+    const char unterminated[] = { 'a', 'b', 'c', 'd' };
+    const char *nullString(NULL);
+    hlog(HLOG_INFO, "plain message");
+    hlog(HLOG_DEBUG, "ints %d %i %u %x %X %o %ld %lld %llu",
+         -42, 7, 4000000000U, 0xbeef, 0xBEEF, 8, -1L, -1234567890123LL,
+         18446744073709551615ULL);
+    hlog(HLOG_DEBUG1, "short %hd %hhd %hhx %hu", -3, 300, -1, 70000);
+    hlog(HLOG_DEBUG2, "sizes %zu %zd %jd %td", sizeof(long), (ssize_t)-5,
+         (intmax_t)99, (ptrdiff_t)-6);
+    hlog(HLOG_WARN, "width [%5d] [%-5d] [%05d] [%+d] [% d] [%*d] [%-*d]",
+         1, 2, 3, 4, 5, 6, 7, -4, 8);
+    hlog(HLOG_ERR, "doubles %f %.2f %10.3e %g %G %a", 3.14159, 2.5, 12345.678,
+         0.0001, 1e100, 1.0);
+    hlog(HLOG_NOTICE, "strings [%s] [%10s] [%-10s] [%.2s] [%.*s] [%s]",
+         "hello", "right", "left", "truncate", 3, unterminated, nullString);
+    hlog(HLOG_CRIT, "char %c pointer %p percent %% done", 'x',
+         reinterpret_cast<void *>(0x1234));
+    hlog(HLOG_ALERT, "%s", "");
+    hlog(HLOG_EMERG, "no arguments at all");
+}
+
+class BinaryLogfileUnitTest : public ::testing::Test
+{
+public:
+    void SetUp() {
+        unlink(TEXT_LOGFILE);
+        unlink(BINARY_LOGFILE);
+        unlink(ROTATED_LOGFILE);
+    }
+
+    void TearDown() {
+        logManager.EndLogging();
+        unlink(TEXT_LOGFILE);
+        unlink(BINARY_LOGFILE);
+        unlink(ROTATED_LOGFILE);
+    }
+
+    void beginBoth(void) {
+        logManager.BeginLogging(TEXT_LOGFILE, HLOG_ALL, COMPARE_FORMAT);
+        logManager.BeginLogging(FString("//binary/") + BINARY_LOGFILE,
+                                HLOG_ALL);
+    }
+
+    void expectSameAsText(void) {
+        std::vector<std::string> text, binary;
+        readLines(TEXT_LOGFILE, text);
+        decode(BINARY_LOGFILE, binary);
+        ASSERT_FALSE(text.empty());
+        ASSERT_EQ(text.size(), binary.size());
+        for (size_t i = 0; i < text.size(); ++i)
+            EXPECT_EQ(text[i], binary[i]);
+    }
+};
+
+TEST_F(BinaryLogfileUnitTest, DecodesToTheTextFormat)
+{
+    beginBoth();
+    logVariety();
+    logVariety();
+    logManager.EndLogging();
+
+    expectSameAsText();
+}
+
+TEST_F(BinaryLogfileUnitTest, KeepsTextWhenArgumentsCanNotBeStored)
+{
+    beginBoth();
+    errno = ENOENT;
+    hlog(HLOG_ERR, "errno says %m");
+    hlogstream(HLOG_INFO, "stream " << 42 << " " << 1.5);
+    FString dynamic("dynamic %d");
+    logManager.Log(HLOG_INFO, dynamic.c_str(), 1);
+    dynamic = "changed %d";
+    logManager.Log(HLOG_INFO, dynamic.c_str(), 2);
+    logManager.EndLogging();
+
+    expectSameAsText();
+}
+
+TEST_F(BinaryLogfileUnitTest, AsyncMessagesAreStoredAsText)
+{
+    beginBoth();
+    logManager.BeginAsyncLogging();
+    logVariety();
+    logManager.EndAsyncLogging();
+    logManager.EndLogging();
+
+    expectSameAsText();
+}
+
+TEST_F(BinaryLogfileUnitTest, RecordsOnlyTheBinaryFormat)
+{
+    boost::shared_ptr<BinaryLogfile> logfile(
+        new BinaryLogfile(BINARY_LOGFILE, HLOG_ALL, 4096));
+    ASSERT_TRUE(logfile->IsOpen());
+    logManager.BeginLogging(logfile);
+    logfile.reset();
+
+    // interned formats and locations make a repeated message a few
+    // bytes, and the file grows across several map chunks
+    const int messages(20000);
+    for (int i = 0; i < messages; ++i)
+        hlog(HLOG_INFO, "message number %d of %s", i, "the test");
+    logManager.EndLogging();
+
+    struct stat st;
+    ASSERT_EQ(0, stat(BINARY_LOGFILE, &st));
+    EXPECT_LT(st.st_size, messages * 24);
+
+    BinaryLogReader reader(BINARY_LOGFILE);
+    LogMsg msg;
+    int count(0);
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    while (reader.Next(msg))
+    {
+        ASSERT_EQ(HLOG_INFO, msg.mLevel);
+        ASSERT_EQ(FString(FStringFC(), "message number %d of the test", count),
+                  msg.mMsg);
+        ++count;
+    }
+    EXPECT_EQ(messages, count);
+    EXPECT_LE(labs(now.tv_sec - msg.mTime.tv_sec), 5);
+}
+
+TEST_F(BinaryLogfileUnitTest, ReopenAfterRotation)
+{
+    const FString path(FString("//binary/") + BINARY_LOGFILE);
+    logManager.BeginLogging(path, HLOG_ALL);
+    hlog(HLOG_INFO, "before rotation %d", 1);
+
+    ASSERT_EQ(0, rename(BINARY_LOGFILE, ROTATED_LOGFILE));
+    logManager.Reopen();
+    hlog(HLOG_INFO, "after rotation %d", 2);
+
+    // reopening without a rotation appends a new segment
+    logManager.Reopen();
+    hlog(HLOG_INFO, "after reopen %d", 3);
+    logManager.EndLogging();
+
+    std::vector<std::string> rotated, current;
+    decode(ROTATED_LOGFILE, rotated, HLOG_FORMAT_MESSAGE);
+    decode(BINARY_LOGFILE, current, HLOG_FORMAT_MESSAGE);
+    ASSERT_EQ(1, rotated.size());
+    EXPECT_EQ(" before rotation 1\n", rotated[0]);
+    ASSERT_EQ(2, current.size());
+    EXPECT_EQ(" after rotation 2\n", current[0]);
+    EXPECT_EQ(" after reopen 3\n", current[1]);
+}
+
+TEST_F(BinaryLogfileUnitTest, IgnoresAPartlyWrittenTail)
+{
+    logManager.BeginLogging(FString("//binary/") + BINARY_LOGFILE, HLOG_ALL);
+    hlog(HLOG_INFO, "first %d", 1);
+    logManager.EndLogging();
+
+    // what a writer killed part way through a record leaves: the
+    // payload without the type byte, then the preallocated zeros
+    {
+        ofstream out(BINARY_LOGFILE, ios::app | ios::out | ios::binary);
+        const char partial[] = { 0, 3, 1, 2, 3 };
+        out.write(partial, sizeof(partial));
+        out.write(std::string(4096, '\0').data(), 4096);
+    }
+
+    std::vector<std::string> lines;
+    decode(BINARY_LOGFILE, lines, HLOG_FORMAT_MESSAGE);
+    ASSERT_EQ(1, lines.size());
+
+    logManager.BeginLogging(FString("//binary/") + BINARY_LOGFILE, HLOG_ALL);
+    hlog(HLOG_INFO, "second %d", 2);
+    logManager.EndLogging();
+
+    // and a record cut short by the end of the file
+    {
+        ofstream out(BINARY_LOGFILE, ios::app | ios::out | ios::binary);
+        const char truncated[] = { 5, 100, 1, 2, 3 };
+        out.write(truncated, sizeof(truncated));
+    }
+
+    lines.clear();
+    decode(BINARY_LOGFILE, lines, HLOG_FORMAT_MESSAGE);
+    ASSERT_EQ(2, lines.size());
+    EXPECT_EQ(" first 1\n", lines[0]);
+    EXPECT_EQ(" second 2\n", lines[1]);
+}
+
+TEST_F(BinaryLogfileUnitTest, RefusesToAppendToOtherFiles)
+{
+    {
+        ofstream out(BINARY_LOGFILE);
+        out << "a text log\n";
+    }
+
+    BinaryLogfile logfile(BINARY_LOGFILE);
+    EXPECT_FALSE(logfile.IsOpen());
+    ASSERT_THROW(BinaryLogReader reader(BINARY_LOGFILE), EBinaryLogfileFormat);
+
+    std::vector<std::string> lines;
+    readLines(BINARY_LOGFILE, lines);
+    ASSERT_EQ(1, lines.size());
+    EXPECT_EQ("a text log\n", lines[0]);
+}
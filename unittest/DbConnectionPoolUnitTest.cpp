@@ -4,6 +4,8 @@
 #include "LogManager.h"
 #include "DbLiteConnection.h"
 #include "DbConnectionPool.h"
+#include "DbBoundedConnectionPool.h"
+#include "Thread.h"
 #include "DbSqlStatement.h"
 
 using namespace Forte;
@@ -279,3 +281,192 @@ TEST_F(BasicDatabasePoolTest, SqliteMirroredDeleteAcquiredDatabaseConnectionsTes
     pool.ReleaseDbConnection(dbConnection);
     pool.DeleteConnections();
 }
+
+/*
+ * SQLITE Bounded Database Pool Tests
+ */
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedInvalidSize)
+{
+    ASSERT_THROW(DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 0, 0),
+                 Forte::EDbConnectionPool);
+    ASSERT_THROW(DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 3, 2),
+                 Forte::EDbConnectionPool);
+}
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedOpensMinimum)
+{
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 2, 4);
+    EXPECT_EQ(2, pool.GetStat("opened"));
+    EXPECT_EQ(2, pool.GetStat("openConnections"));
+    EXPECT_EQ(2, pool.GetStat("idleConnections"));
+
+    DbConnection& dbConnection(pool.GetDbConnection());
+    EXPECT_EQ(2, pool.GetStat("opened"));
+    EXPECT_EQ(1, pool.GetStat("idleConnections"));
+    pool.ReleaseDbConnection(dbConnection);
+    ASSERT_THROW(pool.ReleaseDbConnection(dbConnection), Forte::EDbConnectionPool);
+    EXPECT_EQ(1, pool.GetStat("checkouts"));
+    pool.DeleteConnections();
+    EXPECT_EQ(0, pool.GetStat("openConnections"));
+}
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedDeadline)
+{
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 0, 1);
+    DbConnection& dbConnection(pool.GetDbConnection());
+
+    DeadlineClock deadline;
+    deadline.ExpiresInMillisec(50);
+    ASSERT_THROW(pool.GetDbConnection(deadline), Forte::EDbConnectionPoolTimeout);
+    EXPECT_TRUE(deadline.Expired());
+    EXPECT_EQ(1, pool.GetStat("waits"));
+    EXPECT_EQ(1, pool.GetStat("timeouts"));
+    EXPECT_EQ(1, pool.GetStat("openConnections"));
+
+    pool.ReleaseDbConnection(dbConnection);
+    deadline.ExpiresInMillisec(50);
+    DbConnection& again(pool.GetDbConnection(deadline));
+    EXPECT_EQ(&dbConnection, &again);
+    pool.ReleaseDbConnection(again);
+    pool.DeleteConnections();
+}
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedWaitTimeout)
+{
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 0, 1, 20);
+    DbConnection& dbConnection(pool.GetDbConnection());
+    ASSERT_THROW(pool.GetDbConnection(), Forte::EDbConnectionPoolTimeout);
+    pool.ReleaseDbConnection(dbConnection);
+    pool.DeleteConnections();
+}
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedIdleReaping)
+{
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 1, 3, 0, 1, 0);
+    DbConnection& a(pool.GetDbConnection());
+    DbConnection& b(pool.GetDbConnection());
+    DbConnection& c(pool.GetDbConnection());
+    pool.ReleaseDbConnection(a);
+    pool.ReleaseDbConnection(b);
+    pool.ReleaseDbConnection(c);
+    EXPECT_EQ(3, pool.GetStat("openConnections"));
+
+    pool.Maintain();
+    EXPECT_EQ(0, pool.GetStat("closedIdle"));
+
+    usleep(1100000);
+    pool.Maintain();
+    EXPECT_EQ(2, pool.GetStat("closedIdle"));
+    EXPECT_EQ(1, pool.GetStat("openConnections"));
+    pool.DeleteConnections();
+}
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedValidation)
+{
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 1, 1, 0, 0, 1);
+    DbConnection& dbConnection(pool.GetDbConnection());
+    dbConnection.Close();
+    pool.ReleaseDbConnection(dbConnection);
+
+    // the closed connection fails its check and is replaced
+    usleep(1100000);
+    pool.Maintain();
+    EXPECT_EQ(1, pool.GetStat("closedInvalid"));
+    EXPECT_EQ(2, pool.GetStat("opened"));
+    EXPECT_EQ(1, pool.GetStat("openConnections"));
+
+    DbConnection& replaced(pool.GetDbConnection());
+    EXPECT_TRUE(replaced.Execute("SELECT 1"));
+    pool.ReleaseDbConnection(replaced);
+    pool.DeleteConnections();
+}
+
+class PoolStressThread : public Thread
+{
+public:
+    PoolStressThread(DbBoundedConnectionPool &pool, int checkouts,
+                     int &inUse, int &maxInUse, Mutex &lock) :
+        mPool(pool), mCheckouts(checkouts), mInUse(inUse),
+        mMaxInUse(maxInUse), mLock(lock), mFailures(0)
+    {
+        initialized();
+    }
+    virtual ~PoolStressThread() { deleting(); }
+
+    int mFailures;
+
+protected:
+    virtual void *run(void)
+    {
+        for (int i = 0; i < mCheckouts; ++i)
+        {
+            try
+            {
+                DbConnection& db(mPool.GetDbConnection());
+                {
+                    AutoUnlockMutex lock(mLock);
+                    if (++mInUse > mMaxInUse)
+                        mMaxInUse = mInUse;
+                }
+                if (!db.Execute("SELECT 1"))
+                    ++mFailures;
+                {
+                    AutoUnlockMutex lock(mLock);
+                    --mInUse;
+                }
+                mPool.ReleaseDbConnection(db);
+            }
+            catch (Exception &)
+            {
+                ++mFailures;
+            }
+        }
+        return NULL;
+    }
+
+    DbBoundedConnectionPool &mPool;
+    int mCheckouts;
+    int &mInUse;
+    int &mMaxInUse;
+    Mutex &mLock;
+};
+
+TEST_F(BasicDatabasePoolTest, SqliteBoundedStress)
+{
+    const int threads = 8;
+    const int checkouts = 200;
+    DbBoundedConnectionPool pool("sqlite", getDatabaseName().c_str(), 0, 3);
+
+    int inUse = 0, maxInUse = 0;
+    Mutex lock;
+    std::vector<boost::shared_ptr<PoolStressThread> > workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.push_back(boost::shared_ptr<PoolStressThread>(
+                              new PoolStressThread(pool, checkouts,
+                                                   inUse, maxInUse, lock)));
+    }
+    for (int i = 0; i < threads; ++i)
+    {
+        workers[i]->WaitForShutdown();
+        EXPECT_EQ(0, workers[i]->mFailures);
+    }
+
+    EXPECT_LE(maxInUse, 3);
+    EXPECT_LE(pool.GetStat("opened"), 3);
+    EXPECT_EQ(threads * checkouts, pool.GetStat("checkouts"));
+    EXPECT_EQ(0, pool.GetStat("timeouts"));
+
+    int64_t latencies = 0;
+    const char *buckets[] = { "checkoutLatencyUnder100us",
+                              "checkoutLatencyUnder1ms",
+                              "checkoutLatencyUnder10ms",
+                              "checkoutLatencyUnder100ms",
+                              "checkoutLatencyUnder1s",
+                              "checkoutLatencyOver1s" };
+    for (size_t i = 0; i < sizeof(buckets) / sizeof(buckets[0]); ++i)
+        latencies += pool.GetStat(buckets[i]);
+    EXPECT_EQ(threads * checkouts, latencies);
+    pool.DeleteConnections();
+}
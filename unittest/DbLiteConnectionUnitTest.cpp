@@ -3,6 +3,8 @@
 #include "LogManager.h"
 #include "DbLiteConnection.h"
 #include "DbUtil.h"
+#include "DbSqlStatement.h"
+#include <math.h>
 
 using namespace Forte;
 
@@ -29,6 +31,42 @@ public:
     int mB;
 };
 
+// reads the columns' own types from a streamed result, as the rows
+// dbc generates do
+class DbTypedTest: public Forte::DbRow
+{
+public:
+    DbTypedTest() : mTyped(false) {};
+    void Set(const Forte::DbResultRow &row) {
+        mTyped = false;
+        mA = GetLLInt(row, 0);
+        mB = GetString(row, 1);
+        mC = GetBool(row, 2);
+        mNull = IsNull(row, 1);
+    }
+    void Set(sqlite3_stmt *stmt) {
+        mTyped = true;
+        mA = GetLLInt(stmt, 0);
+        mB = GetString(stmt, 1);
+        mC = GetBool(stmt, 2);
+        mNull = IsNull(stmt, 1);
+        EXPECT_THROW(GetInt(stmt, 3), ForteDbRowException);
+    }
+    bool mTyped;
+    long long mA;
+    FString mB;
+    bool mC;
+    bool mNull;
+};
+
+static long long firstInt(DbResult res)
+{
+    DbResultRow row;
+    if (!res.FetchRow(row) || row[0] == NULL)
+        return -1;
+    return strtoll(row[0], NULL, 10);
+}
+
 class DbLiteConnectionTest : public ::testing::Test {
 public:
     virtual void SetUp() {
@@ -105,6 +143,367 @@ TEST_F(DbLiteConnectionTest, ConstraintTest)
     db.Commit();
 }
 
+TEST_F(DbLiteConnectionTest, CachedStatementsBindValues)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    ASSERT_NO_THROW(db.Execute("CREATE TABLE `values` (`i` int, `r` real, "
+                               "`t` text, `b` blob)"));
+
+    const FString quoted("it's a 'quoted' ? string");
+    const FString blob("\0\1binary\0", 9);
+    InsertDbSqlStatement insert("INSERT INTO `values` VALUES (?, ?, ?, ?)");
+    insert.BindInt(-1234567890123LL).BindDouble(2.5)
+        .BindText(quoted).BindBlob(blob);
+    ASSERT_TRUE(db.Execute(insert));
+    insert.ClearParameters();
+    insert.BindNull().BindNull().BindNull().BindNull();
+    ASSERT_TRUE(db.Execute(insert));
+
+    SelectDbSqlStatement select(
+        "SELECT i, r, t, b FROM `values` WHERE t = ?");
+    select.BindText(quoted);
+    DbResult res = db.Store(select);
+    ASSERT_TRUE(res);
+    ASSERT_EQ(1, res.GetNumRows());
+    DbResultRow row;
+    ASSERT_TRUE(res.FetchRow(row));
+    EXPECT_STREQ("-1234567890123", row[0]);
+    EXPECT_STREQ("2.5", row[1]);
+    EXPECT_EQ(quoted, FString(row[2]));
+
+    SelectDbSqlStatement nulls("SELECT count(*) FROM `values` WHERE i IS ?");
+    nulls.BindNull();
+    EXPECT_EQ(1, firstInt(DbStore(db, nulls)));
+    SelectDbSqlStatement blobs("SELECT i FROM `values` WHERE b = ?");
+    blobs.BindBlob(blob);
+    EXPECT_EQ(-1234567890123LL, firstInt(DbStore(db, blobs)));
+}
+
+TEST_F(DbLiteConnectionTest, StatementCacheStats)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    db.SetStatementCacheSize(2);
+
+    for (int i = 0; i < 10; i++)
+    {
+        InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+        insert.BindInt(i).BindInt(i * 2);
+        ASSERT_TRUE(db.Execute(insert));
+    }
+    EXPECT_EQ(1, db.GetStat("statementCacheMisses"));
+    EXPECT_EQ(9, db.GetStat("statementCacheHits"));
+    EXPECT_EQ(1, db.GetStat("statementCacheSize"));
+
+    // statements without values are only cached when asked to
+    SelectDbSqlStatement count("SELECT count(*) FROM test");
+    ASSERT_TRUE(db.Store(count));
+    EXPECT_EQ(1, db.GetStat("statementCacheSize"));
+    count.SetCacheable();
+    ASSERT_TRUE(db.Store(count));
+    ASSERT_TRUE(db.Store(count));
+    EXPECT_EQ(2, db.GetStat("statementCacheSize"));
+    EXPECT_EQ(10, db.GetStat("statementCacheHits"));
+
+    SelectDbSqlStatement sum("SELECT sum(b) FROM test WHERE a < ?");
+    sum.BindInt(5);
+    EXPECT_EQ(20, firstInt(DbStore(db, sum)));
+    EXPECT_EQ(1, db.GetStat("statementCacheEvictions"));
+    EXPECT_EQ(2, db.GetStat("statementCacheSize"));
+
+    // the least recently used one, the insert, went
+    InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+    insert.BindInt(10).BindInt(20);
+    ASSERT_TRUE(db.Execute(insert));
+    EXPECT_EQ(4, db.GetStat("statementCacheMisses"));
+    EXPECT_EQ(2, db.GetStat("statementCacheEvictions"));
+
+    // cached statements do not keep the connection from closing
+    EXPECT_TRUE(db.Close());
+    EXPECT_EQ(0, db.GetStat("statementCacheSize"));
+}
+
+TEST_F(DbLiteConnectionTest, StatementCacheDisabled)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    db.SetStatementCacheSize(0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+        insert.BindInt(i).BindInt(i);
+        ASSERT_TRUE(db.Execute(insert));
+    }
+    EXPECT_EQ(3, db.GetStat("statementCacheMisses"));
+    EXPECT_EQ(0, db.GetStat("statementCacheSize"));
+    EXPECT_EQ(3, firstInt(DbStore(db, "SELECT count(*) FROM test")));
+}
+
+TEST_F(DbLiteConnectionTest, CachedStatementErrors)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+
+    InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+    insert.BindInt(1);
+    EXPECT_THROW(db.Execute(insert), EDbConnectionParameterCount);
+
+    insert.BindInt(1);
+    ASSERT_TRUE(db.Execute(insert));
+    try
+    {
+        DbExecute(db, insert);
+        FAIL();
+    }
+    catch (DbException &e)
+    {
+        EXPECT_EQ(SQLITE_CONSTRAINT, e.mDbErrno);
+    }
+
+    // and the statement is usable afterwards
+    insert.ClearParameters();
+    insert.BindInt(2).BindInt(2);
+    ASSERT_TRUE(db.Execute(insert));
+
+    // several statements in one go are run one at a time
+    MutatorDbSqlStatement both("INSERT INTO test VALUES (?, 3); "
+                               "INSERT INTO test VALUES (4, ?)");
+    both.BindInt(3).BindInt(4);
+    ASSERT_TRUE(db.Execute(both));
+    EXPECT_EQ(4, firstInt(DbStore(db, "SELECT count(*) FROM test")));
+    EXPECT_EQ(3, firstInt(DbStore(db, "SELECT b FROM test WHERE a = 3")));
+}
+
+// exposes the text expansion used when a statement cannot be bound
+class ExpandingDbLiteConnection : public DbLiteConnection
+{
+public:
+    ExpandingDbLiteConnection(bool backslashEscapes)
+        : mBackslashEscapes(backslashEscapes) {}
+    FString Expand(const DbSqlStatement& statement) {
+        return expandParameters(statement);
+    }
+protected:
+    bool stringsHaveBackslashEscapes() const { return mBackslashEscapes; }
+    bool mBackslashEscapes;
+};
+
+TEST_F(DbLiteConnectionTest, ExpandSkipsQuotesAndComments)
+{
+    ExpandingDbLiteConnection standard(false);
+    ExpandingDbLiteConnection backslash(true);
+
+    SelectDbSqlStatement comments(
+        "SELECT ? -- it's ?\n, ? /* 'a ? */ , '?', ?");
+    comments.BindInt(1).BindInt(2).BindInt(3);
+    EXPECT_EQ("SELECT 1 -- it's ?\n, 2 /* 'a ? */ , '?', 3",
+              standard.Expand(comments));
+
+    // a backslash only escapes the quote where the database says so
+    SelectDbSqlStatement escaped("SELECT 'it\\'s ?', ? -- '");
+    escaped.BindInt(1);
+    EXPECT_EQ("SELECT 'it\\'s ?', 1 -- '", backslash.Expand(escaped));
+    EXPECT_EQ("SELECT 'it\\'s 1', ? -- '", standard.Expand(escaped));
+
+    SelectDbSqlStatement standardEscaped("SELECT 'C:\\', ?");
+    standardEscaped.BindInt(1);
+    EXPECT_EQ("SELECT 'C:\\', 1", standard.Expand(standardEscaped));
+
+    SelectDbSqlStatement real("SELECT ?");
+    real.BindDouble(0.5);
+    EXPECT_EQ("SELECT 0.5", standard.Expand(real));
+    real.ClearParameters();
+    real.BindDouble(NAN);
+    EXPECT_THROW(standard.Expand(real), EDbConnectionParameterValue);
+    real.ClearParameters();
+    real.BindDouble(INFINITY);
+    EXPECT_THROW(standard.Expand(real), EDbConnectionParameterValue);
+}
+
+TEST_F(DbLiteConnectionTest, StoreKeepsEveryRow)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    ASSERT_NO_THROW(db.Execute("CREATE TABLE `cells` (`i` int, `t` text, "
+                               "`b` blob)"));
+    for (int i = 0; i < 10; i++)
+    {
+        InsertDbSqlStatement insert("INSERT INTO `cells` VALUES (?, ?, ?)");
+        insert.BindInt(i);
+        if (i % 3 == 0) insert.BindNull();
+        else insert.BindText(FString(std::string(i, 'x')));
+        insert.BindBlob(FString("a\0b", 3));
+        ASSERT_TRUE(db.Execute(insert));
+    }
+
+    DbResult res = db.Store("SELECT i, t, b FROM `cells` ORDER BY i");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(10, res.GetNumRows());
+    EXPECT_EQ(3, res.GetNumColumns());
+
+    DbResultRow row;
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(res.FetchRow(row));
+        ASSERT_EQ(3, row.size());
+        EXPECT_EQ(i, atoi(row[0]));
+        if (i % 3 == 0)
+        {
+            EXPECT_TRUE(row[1] == NULL);
+        }
+        else
+        {
+            EXPECT_EQ(FString(std::string(i, 'x')), FString(row[1]));
+            EXPECT_EQ(i, res.GetFieldLength(1));
+        }
+        EXPECT_EQ(3, res.GetFieldLength(2));
+        EXPECT_EQ(0, memcmp("a\0b", row[2], 4));
+    }
+    EXPECT_FALSE(res.FetchRow(row));
+
+    ASSERT_TRUE(res.Seek(5));
+    ASSERT_TRUE(res.FetchRow(row));
+    EXPECT_EQ(5, atoi(row[0]));
+    ASSERT_TRUE(res.FetchRow(row));
+    res.UnFetchRow();
+    ASSERT_TRUE(res.FetchRow(row));
+    EXPECT_EQ(6, atoi(row[0]));
+    EXPECT_FALSE(res.Seek(10));
+}
+
+TEST_F(DbLiteConnectionTest, UseStreamsRows)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    db.Begin();
+    for (int i = 0; i < 100; i++)
+    {
+        InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+        insert.BindInt(i).BindInt(i * 3);
+        ASSERT_TRUE(db.Execute(insert));
+    }
+    db.Commit();
+
+    DbResult res = DbUse(db, "SELECT a, b FROM test ORDER BY a");
+    EXPECT_EQ(0, res.GetNumRows());
+    EXPECT_EQ(2, res.GetNumColumns());
+
+    DbTest test;
+    ASSERT_TRUE(res.FetchRow(test));
+    EXPECT_EQ(0, test.mA);
+    res.UnFetchRow();
+    EXPECT_THROW(res.UnFetchRow(), Exception);
+
+    // the connection is still usable while the rows are streaming
+    ASSERT_TRUE(db.Execute("CREATE TABLE other (a int)"));
+    ASSERT_TRUE(db.Execute("INSERT INTO other VALUES (1)"));
+
+    for (int i = 0; i < 50; i++)
+    {
+        ASSERT_TRUE(res.FetchRow(test));
+        EXPECT_EQ(i, test.mA);
+        EXPECT_EQ(i * 3, test.mB);
+    }
+    EXPECT_EQ(50, res.GetNumRows());
+    EXPECT_THROW(res.Seek(0), Exception);
+    ASSERT_TRUE(res.Seek(90));
+    ASSERT_TRUE(res.FetchRow(test));
+    EXPECT_EQ(90, test.mA);
+    int rows = 91;
+    while (res.FetchRow(test))
+        ++rows;
+    EXPECT_EQ(100, rows);
+    EXPECT_TRUE(res);
+
+    DbResult empty = DbUse(db, "SELECT a FROM test WHERE a < 0");
+    EXPECT_TRUE(empty);
+    EXPECT_FALSE(empty.FetchRow(test));
+
+    EXPECT_FALSE(db.Use("SELECT a FROM missing"));
+}
+
+TEST_F(DbLiteConnectionTest, UseTakesCachedStatements)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    for (int i = 0; i < 10; i++)
+    {
+        InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+        insert.BindInt(i).BindInt(i);
+        ASSERT_TRUE(db.Execute(insert));
+    }
+    EXPECT_EQ(1, db.GetStat("statementCacheSize"));
+
+    DbResultRow row;
+    {
+        DbResult first, second;
+        {
+            // the bound values outlive the statement
+            SelectDbSqlStatement select("SELECT a FROM test WHERE a >= ?");
+            select.BindInt(5);
+            first = db.Use(select);
+            second = db.Use(select);
+        }
+        EXPECT_EQ(1, db.GetStat("statementCacheSize"));
+        EXPECT_EQ(3, db.GetStat("statementCacheMisses"));
+
+        int count = 0;
+        while (first.FetchRow(row))
+            ++count;
+        EXPECT_EQ(5, count);
+
+        // finished, so back in the cache
+        EXPECT_EQ(2, db.GetStat("statementCacheSize"));
+        ASSERT_TRUE(second.FetchRow(row));
+        EXPECT_STREQ("5", row[0]);
+    }
+    EXPECT_EQ(2, db.GetStat("statementCacheSize"));
+
+    // closing the connection ends streaming results
+    DbResult open = db.Use("SELECT a FROM test");
+    ASSERT_TRUE(open.FetchRow(row));
+    EXPECT_TRUE(db.Close());
+    EXPECT_FALSE(open.FetchRow(row));
+}
+
+TEST_F(DbLiteConnectionTest, UseSetsTypedRows)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    ASSERT_TRUE(db.Execute("CREATE TABLE typed (a INTEGER, b BLOB, c INTEGER)"));
+    InsertDbSqlStatement insert("INSERT INTO typed VALUES (?, ?, ?)");
+    insert.BindInt(1LL << 40).BindBlob(FString("ab\0cd", 5)).BindInt(1);
+    ASSERT_TRUE(db.Execute(insert));
+    insert.ClearParameters();
+    insert.BindInt(-7).BindNull().BindInt(0);
+    ASSERT_TRUE(db.Execute(insert));
+
+    DbTypedTest test;
+    DbResult res = DbUse(db, "SELECT a, b, c FROM typed ORDER BY rowid");
+    ASSERT_TRUE(res.FetchRow(test));
+    EXPECT_TRUE(test.mTyped);
+    EXPECT_EQ(1LL << 40, test.mA);
+    EXPECT_EQ(FString("ab\0cd", 5), test.mB);
+    EXPECT_TRUE(test.mC);
+    EXPECT_FALSE(test.mNull);
+    ASSERT_TRUE(res.FetchRow(test));
+    EXPECT_EQ(-7, test.mA);
+    EXPECT_EQ("", test.mB);
+    EXPECT_FALSE(test.mC);
+    EXPECT_TRUE(test.mNull);
+    EXPECT_FALSE(res.FetchRow(test));
+    EXPECT_EQ(2, res.GetNumRows());
+
+    // stored rows are still set from their text
+    res = DbStore(db, "SELECT a, b, c FROM typed ORDER BY rowid");
+    ASSERT_TRUE(res.FetchRow(test));
+    EXPECT_FALSE(test.mTyped);
+    EXPECT_EQ(1LL << 40, test.mA);
+    EXPECT_EQ("ab", test.mB);
+}
+
 // TEST(DbLiteConnection, Locking)
 // {
 //     DbLiteConnection db;
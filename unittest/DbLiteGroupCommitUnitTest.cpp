@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "LogManager.h"
+#include "DbLiteGroupCommit.h"
+#include "DbUtil.h"
+#include "DbSqlStatement.h"
+
+using namespace Forte;
+
+#define TEST_DB "/tmp/DbLiteGroupCommitUnitTest.db"
+
+#define CREATE_TEST_TABLE                       \
+    "CREATE TABLE `test` ("                     \
+    "  `a` int(10) not null default '0',"       \
+    "  `b` int(10) not null default '0',"       \
+    "  PRIMARY KEY (`a`)"                       \
+    ");"
+
+static long long countRows(const char *where = "1")
+{
+    DbLiteConnection db;
+    db.Init(TEST_DB);
+    DbResult res = db.Store(FString(FStringFC(),
+                                    "SELECT count(*) FROM test WHERE %s",
+                                    where));
+    DbResultRow row;
+    if (!res.FetchRow(row) || row[0] == NULL)
+        return -1;
+    return strtoll(row[0], NULL, 10);
+}
+
+static DbLiteGroupCommit::ResultFuturePtr insertRow(
+    DbLiteGroupCommit &groupCommit, int a, int b)
+{
+    InsertDbSqlStatement insert("INSERT INTO test VALUES (?, ?)");
+    insert.BindInt(a).BindInt(b);
+    return groupCommit.Submit(insert);
+}
+
+class DbLiteGroupCommitTest : public ::testing::Test {
+public:
+    virtual void SetUp() {
+        unlink(TEST_DB);
+        mLogManager.BeginLogging("//stderr");
+        DbLiteConnection db(SQLITE_OPEN_READWRITE |
+                            SQLITE_OPEN_CREATE);
+        db.Init(TEST_DB);
+        ASSERT_NO_THROW(db.Execute(CREATE_TEST_TABLE));
+    }
+    virtual void TearDown() {
+        unlink(TEST_DB);
+    }
+    LogManager mLogManager;
+};
+
+TEST_F(DbLiteGroupCommitTest, InvalidDatabase)
+{
+    ASSERT_THROW(DbLiteGroupCommit groupCommit("/nonexistent/dir/test.db"),
+                 EDbLiteGroupCommit);
+}
+
+TEST_F(DbLiteGroupCommitTest, CommitsAndReturnsRows)
+{
+    DbLiteGroupCommit groupCommit(TEST_DB);
+
+    std::vector<DbLiteGroupCommit::ResultFuturePtr> futures;
+    for (int i = 0; i < 50; ++i)
+        futures.push_back(insertRow(groupCommit, i, i));
+    for (int i = 0; i < 50; ++i)
+        EXPECT_EQ(1U, futures[i]->GetResult());
+
+    UpdateDbSqlStatement update("UPDATE test SET b = b + 1 WHERE a < ?");
+    update.BindInt(10);
+    EXPECT_EQ(10U, groupCommit.Submit(update)->GetResult());
+
+    EXPECT_EQ(50, countRows());
+    EXPECT_EQ(10, countRows("a != b"));
+    EXPECT_EQ(51, groupCommit.GetStat("committed"));
+    EXPECT_EQ(0, groupCommit.GetStat("failed"));
+}
+
+TEST_F(DbLiteGroupCommitTest, BatchesUpToLatency)
+{
+    DbLiteGroupCommit groupCommit(TEST_DB, 16, 200);
+
+    std::vector<DbLiteGroupCommit::ResultFuturePtr> futures;
+    for (int i = 0; i < 40; ++i)
+        futures.push_back(insertRow(groupCommit, i, i));
+    for (int i = 0; i < 40; ++i)
+        EXPECT_EQ(1U, futures[i]->GetResult());
+
+    // 16 + 16 + 8
+    EXPECT_EQ(3, groupCommit.GetStat("batches"));
+    EXPECT_EQ(40, countRows());
+}
+
+TEST_F(DbLiteGroupCommitTest, FailedStatementIsIsolated)
+{
+    DbLiteGroupCommit groupCommit(TEST_DB, 16, 200);
+
+    DbLiteGroupCommit::ResultFuturePtr ok1(insertRow(groupCommit, 1, 1));
+    DbLiteGroupCommit::ResultFuturePtr dup(insertRow(groupCommit, 1, 2));
+    DbLiteGroupCommit::ResultFuturePtr bad(
+        groupCommit.Submit(InsertDbSqlStatement("INSERT INTO nosuchtable VALUES (1)")));
+    DbLiteGroupCommit::ResultFuturePtr ok2(insertRow(groupCommit, 2, 2));
+
+    EXPECT_EQ(1U, ok1->GetResult());
+    try
+    {
+        dup->GetResult();
+        FAIL();
+    }
+    catch (DbException &e)
+    {
+        EXPECT_EQ(SQLITE_CONSTRAINT, e.mDbErrno);
+    }
+    EXPECT_THROW(bad->GetResult(), DbException);
+    EXPECT_EQ(1U, ok2->GetResult());
+
+    EXPECT_EQ(2, countRows());
+    EXPECT_EQ(1, countRows("a = 1 AND b = 1"));
+    EXPECT_EQ(1, groupCommit.GetStat("batches"));
+    EXPECT_EQ(2, groupCommit.GetStat("failed"));
+    EXPECT_EQ(0, groupCommit.GetStat("batchesRetried"));
+}
+
+TEST_F(DbLiteGroupCommitTest, RetriesAfterTransactionRollback)
+{
+    {
+        DbLiteConnection db;
+        db.Init(TEST_DB);
+        ASSERT_TRUE(db.Execute("CREATE TRIGGER rollback_negative "
+                               "BEFORE INSERT ON test WHEN NEW.b < 0 "
+                               "BEGIN SELECT RAISE(ROLLBACK, 'negative'); END"));
+    }
+
+    DbLiteGroupCommit groupCommit(TEST_DB, 16, 200);
+    DbLiteGroupCommit::ResultFuturePtr ok1(insertRow(groupCommit, 1, 1));
+    DbLiteGroupCommit::ResultFuturePtr bad(insertRow(groupCommit, 2, -1));
+    DbLiteGroupCommit::ResultFuturePtr ok2(insertRow(groupCommit, 3, 3));
+
+    EXPECT_EQ(1U, ok1->GetResult());
+    EXPECT_THROW(bad->GetResult(), DbException);
+    EXPECT_EQ(1U, ok2->GetResult());
+
+    EXPECT_EQ(2, countRows());
+    EXPECT_EQ(1, groupCommit.GetStat("batchesRetried"));
+}
+
+TEST_F(DbLiteGroupCommitTest, CommitsPendingOnDestruction)
+{
+    std::vector<DbLiteGroupCommit::ResultFuturePtr> futures;
+    {
+        DbLiteGroupCommit groupCommit(TEST_DB, 1000, 60000);
+        for (int i = 0; i < 20; ++i)
+            futures.push_back(insertRow(groupCommit, i, i));
+    }
+    for (int i = 0; i < 20; ++i)
+    {
+        ASSERT_TRUE(futures[i]->IsReady());
+        EXPECT_EQ(1U, futures[i]->GetResult());
+    }
+    EXPECT_EQ(20, countRows());
+}
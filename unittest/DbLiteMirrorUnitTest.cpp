@@ -0,0 +1,315 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include "LogManager.h"
+#include "DbLiteConnection.h"
+#include "DbLiteMirror.h"
+#include "DbUtil.h"
+
+using namespace Forte;
+
+#define TEST_DB "/tmp/DbLiteMirrorUnitTest.db"
+#define TEST_DB_MIRROR "/tmp/DbLiteMirrorUnitTest.mirror.db"
+
+#define CREATE_TEST_TABLE                       \
+    "CREATE TABLE `test` ("                     \
+    "  `a` integer primary key,"                \
+    "  `b` blob"                                \
+    ");"
+
+static std::string readFile(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+static long long queryInt(DbConnection &db, const char *sql)
+{
+    DbResult res = db.Store(sql);
+    DbResultRow row;
+    if (!res.FetchRow(row) || row[0] == NULL)
+        return -1;
+    return strtoll(row[0], NULL, 10);
+}
+
+// the mirror differs from the primary only in the header fields it
+// sets on the first page
+static void expectMirrored(void)
+{
+    std::string primary(readFile(TEST_DB));
+    std::string mirror(readFile(TEST_DB_MIRROR));
+    ASSERT_EQ(primary.size(), mirror.size());
+    ASSERT_GE(primary.size(), 100U);
+
+    EXPECT_EQ(2, primary[18]);
+    EXPECT_EQ(1, mirror[18]);
+    EXPECT_EQ(1, mirror[19]);
+    EXPECT_EQ(mirror.substr(24, 4), mirror.substr(92, 4));
+    const int fields[] = { 18, 19, 24, 25, 26, 27, 28, 29, 30, 31,
+                           92, 93, 94, 95 };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+        primary[fields[i]] = mirror[fields[i]] = 0;
+    EXPECT_TRUE(primary == mirror);
+}
+
+// stops a sync just after its journal is written, as a crash would
+class CrashingDbLiteMirror : public DbLiteMirror
+{
+public:
+    CrashingDbLiteMirror() : DbLiteMirror(TEST_DB, TEST_DB_MIRROR) {}
+
+    void JournalOnly(const std::vector<uint32_t> &pages,
+                     unsigned int pageSize, uint32_t pageCount) {
+        exec(mMirror, "BEGIN EXCLUSIVE");
+        writeJournal(getFile(mMirror), pages, pageSize, pageCount, 12345);
+        exec(mMirror, "ROLLBACK");
+    }
+};
+
+class DbLiteMirrorTest : public ::testing::Test {
+public:
+    virtual void SetUp() {
+        unlink(TEST_DB);
+        unlink(TEST_DB "-wal");
+        unlink(TEST_DB "-shm");
+        unlink(TEST_DB_MIRROR);
+        unlink(TEST_DB_MIRROR "-journal");
+        mLogManager.BeginLogging("//stderr");
+        DbLiteConnection db(SQLITE_OPEN_READWRITE |
+                            SQLITE_OPEN_CREATE);
+        db.Init(TEST_DB);
+        ASSERT_NO_THROW(db.Execute(CREATE_TEST_TABLE));
+    }
+    virtual void TearDown() {
+        unlink(TEST_DB);
+        unlink(TEST_DB "-wal");
+        unlink(TEST_DB "-shm");
+        unlink(TEST_DB_MIRROR);
+        unlink(TEST_DB_MIRROR "-journal");
+    }
+    LogManager mLogManager;
+};
+
+TEST_F(DbLiteMirrorTest, InvalidPaths)
+{
+    ASSERT_THROW(DbLiteMirror mirror(TEST_DB, TEST_DB), EDbLiteMirror);
+    ASSERT_THROW(DbLiteMirror mirror("/nonexistent/dir/test.db", TEST_DB_MIRROR),
+                 EDbLiteMirror);
+}
+
+TEST_F(DbLiteMirrorTest, ByteIdenticalAfterRandomBatches)
+{
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+
+    unsigned int seed = 42;
+    for (int batch = 0; batch < 60; ++batch)
+    {
+        DbExecute(db, "BEGIN");
+        const int statements = 1 + rand_r(&seed) % 50;
+        for (int i = 0; i < statements; ++i)
+        {
+            const int key = rand_r(&seed) % 2000;
+            const int size = rand_r(&seed) % 3000;
+            switch (rand_r(&seed) % 3)
+            {
+            case 0:
+                DbExecute(db, FString(FStringFC(),
+                                      "INSERT OR REPLACE INTO test VALUES "
+                                      "(%d, randomblob(%d))", key, size));
+                break;
+            case 1:
+                DbExecute(db, FString(FStringFC(),
+                                      "UPDATE test SET b = randomblob(%d) "
+                                      "WHERE a >= %d AND a < %d",
+                                      size, key, key + 20));
+                break;
+            case 2:
+                DbExecute(db, FString(FStringFC(),
+                                      "DELETE FROM test WHERE a >= %d AND "
+                                      "a < %d", key, key + 50));
+                break;
+            }
+        }
+        DbExecute(db, "COMMIT");
+
+        // shrinks the file now and then
+        if (batch % 20 == 19)
+            DbExecute(db, "VACUUM");
+
+        ASSERT_GE(mirror.Sync(), 1);
+        expectMirrored();
+    }
+
+    DbLiteConnection copy(SQLITE_OPEN_READONLY);
+    ASSERT_TRUE(copy.Init(TEST_DB_MIRROR));
+    DbResult res = copy.Store("PRAGMA integrity_check");
+    DbResultRow row;
+    ASSERT_TRUE(res.FetchRow(row));
+    EXPECT_STREQ("ok", row[0]);
+    EXPECT_EQ(queryInt(db, "SELECT sum(length(b)) FROM test"),
+              queryInt(copy, "SELECT sum(length(b)) FROM test"));
+    EXPECT_EQ(60, mirror.GetStat("syncs"));
+}
+
+TEST_F(DbLiteMirrorTest, CopiesOnlyChangedPages)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    DbExecute(db, "BEGIN");
+    for (int i = 0; i < 2000; ++i)
+    {
+        DbExecute(db, FString(FStringFC(),
+                              "INSERT INTO test VALUES (%d, randomblob(500))",
+                              i));
+    }
+    DbExecute(db, "COMMIT");
+
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    const int pages = mirror.Sync();
+    EXPECT_GT(pages, 200);
+    EXPECT_EQ(1, mirror.Sync()); // the first page only
+
+    DbExecute(db, "UPDATE test SET b = randomblob(500) WHERE a = 1000");
+    EXPECT_LE(mirror.Sync(), 3);
+    EXPECT_EQ(3 * pages, mirror.GetStat("pagesScanned"));
+    expectMirrored();
+
+    // a new mirror starts from what is already there
+    DbExecute(db, "UPDATE test SET b = randomblob(500) WHERE a = 10");
+    DbLiteMirror again(TEST_DB, TEST_DB_MIRROR);
+    EXPECT_LE(again.Sync(), 3);
+    expectMirrored();
+}
+
+TEST_F(DbLiteMirrorTest, MirrorReadersSeeChanges)
+{
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    DbExecute(db, "INSERT INTO test VALUES (1, 'one')");
+    mirror.Sync();
+
+    DbLiteConnection reader(SQLITE_OPEN_READONLY);
+    ASSERT_TRUE(reader.Init(TEST_DB_MIRROR));
+    EXPECT_EQ(1, queryInt(reader, "SELECT count(*) FROM test"));
+
+    DbExecute(db, "INSERT INTO test VALUES (2, 'two')");
+    EXPECT_EQ(1, queryInt(reader, "SELECT count(*) FROM test"));
+    mirror.Sync();
+    EXPECT_EQ(2, queryInt(reader, "SELECT count(*) FROM test"));
+}
+
+TEST_F(DbLiteMirrorTest, SkipsWhileOldSnapshotsAreRead)
+{
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    DbExecute(db, "INSERT INTO test VALUES (1, 'one')");
+
+    DbLiteConnection reader;
+    ASSERT_TRUE(reader.Init(TEST_DB));
+    DbExecute(reader, "BEGIN");
+    EXPECT_EQ(1, queryInt(reader, "SELECT count(*) FROM test"));
+
+    DbExecute(db, "INSERT INTO test VALUES (2, 'two')");
+    EXPECT_EQ(-1, mirror.Sync());
+    EXPECT_EQ(1, mirror.GetStat("syncsSkipped"));
+
+    DbExecute(reader, "COMMIT");
+    EXPECT_GE(mirror.Sync(), 1);
+    expectMirrored();
+}
+
+TEST_F(DbLiteMirrorTest, LagAndThrottle)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    DbExecute(db, "BEGIN");
+    for (int i = 0; i < 400; ++i)
+    {
+        DbExecute(db, FString(FStringFC(),
+                              "INSERT INTO test VALUES (%d, randomblob(1000))",
+                              i));
+    }
+    DbExecute(db, "COMMIT");
+
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    EXPECT_TRUE(mirror.UpdateLag());
+    mirror.Sync();
+    EXPECT_FALSE(mirror.UpdateLag());
+    EXPECT_EQ(0, mirror.GetStat("lagMillisec"));
+
+    usleep(50000);
+    DbExecute(db, "INSERT INTO test VALUES (1000, 'new')");
+    EXPECT_TRUE(mirror.UpdateLag());
+    EXPECT_GE(mirror.GetStat("lagMillisec"), 40);
+
+    // about 450KB at 1MB/s
+    mirror.SetMaxBytesPerSecond(1024 * 1024);
+    mirror.Sync();
+    EXPECT_GE(mirror.GetStat("lastSyncMillisec"), 300);
+    EXPECT_EQ(0, mirror.GetStat("lagMillisec"));
+    expectMirrored();
+}
+
+TEST_F(DbLiteMirrorTest, InterruptedSyncIsRolledBack)
+{
+    DbLiteConnection db;
+    ASSERT_TRUE(db.Init(TEST_DB));
+    DbExecute(db, "BEGIN");
+    for (int i = 0; i < 100; ++i)
+    {
+        DbExecute(db, FString(FStringFC(),
+                              "INSERT INTO test VALUES (%d, randomblob(500))",
+                              i));
+    }
+    DbExecute(db, "COMMIT");
+
+    const unsigned int pageSize = queryInt(db, "PRAGMA page_size");
+    std::string synced;
+    {
+        CrashingDbLiteMirror mirror;
+        ASSERT_GT(mirror.Sync(), 10);
+        synced = readFile(TEST_DB_MIRROR);
+        const uint32_t pageCount = synced.size() / pageSize;
+
+        // overwrite the first pages, shrink by one page and then grow
+        // past the old end, with only the journal on disk to undo it
+        std::vector<uint32_t> pages;
+        pages.push_back(0);
+        pages.push_back(1);
+        mirror.JournalOnly(pages, pageSize, pageCount - 1);
+
+        int fd = open(TEST_DB_MIRROR, O_WRONLY);
+        ASSERT_NE(-1, fd);
+        const std::string garbage(pageSize * 2, 'x');
+        ASSERT_EQ((ssize_t) garbage.size(),
+                  pwrite(fd, garbage.data(), garbage.size(), 0));
+        ASSERT_EQ(0, ftruncate(fd, (off_t) (pageCount - 1) * pageSize));
+        ASSERT_EQ((ssize_t) garbage.size(),
+                  pwrite(fd, garbage.data(), garbage.size(),
+                         (off_t) pageCount * pageSize));
+        close(fd);
+    }
+
+    // the next reader puts the mirror back as the last sync left it
+    ASSERT_EQ(0, access(TEST_DB_MIRROR "-journal", F_OK));
+    {
+        DbLiteConnection reader;
+        ASSERT_TRUE(reader.Init(TEST_DB_MIRROR));
+        EXPECT_EQ(100, queryInt(reader, "SELECT count(*) FROM test"));
+    }
+    EXPECT_NE(0, access(TEST_DB_MIRROR "-journal", F_OK));
+    EXPECT_TRUE(readFile(TEST_DB_MIRROR) == synced);
+
+    DbExecute(db, "DELETE FROM test WHERE a < 50");
+    DbLiteMirror mirror(TEST_DB, TEST_DB_MIRROR);
+    EXPECT_GE(mirror.Sync(), 1);
+    expectMirrored();
+    EXPECT_NE(0, access(TEST_DB_MIRROR "-journal", F_OK));
+}
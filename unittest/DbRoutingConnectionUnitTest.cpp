@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "LogManager.h"
+#include "DbAutoTrans.h"
+#include "DbConnectionPool.h"
+#include "DbLiteConnection.h"
+#include "DbLiteConnectionFactory.h"
+#include "DbRoutingConnection.h"
+#include "DbRoutingConnectionFactory.h"
+#include "DbSqlStatement.h"
+#include "DbUtil.h"
+#include "ServiceConfig.h"
+
+using namespace Forte;
+
+#define TEST_DB "/tmp/DbRoutingConnectionUnitTest.db"
+#define TEST_REPLICA "/tmp/DbRoutingConnectionUnitTest.replica%d.db"
+
+static const int REPLICAS = 3;
+
+static FString replicaPath(int i)
+{
+    return FString(FStringFC(), TEST_REPLICA, i);
+}
+
+// each database says which one it is
+static void createDatabase(const FString &path, const FString &name)
+{
+    unlink(path);
+    DbLiteConnection db(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    db.Init(path);
+    DbExecute(db, "CREATE TABLE whoami (name TEXT)");
+    DbExecute(db, FString(FStringFC(), "INSERT INTO whoami VALUES ('%s')",
+                          name.c_str()));
+    DbExecute(db, "CREATE TABLE test (a INTEGER PRIMARY KEY)");
+}
+
+static FString whoami(DbConnection &db)
+{
+    DbResult res = db.Store("SELECT name FROM whoami");
+    DbResultRow row;
+    if (!res || !res.FetchRow(row) || row[0] == NULL)
+        return "";
+    return row[0];
+}
+
+static long long countRows(DbConnection &db)
+{
+    DbResult res = db.Store(SelectDbSqlStatement("SELECT count(*) FROM test"));
+    DbResultRow row;
+    if (!res || !res.FetchRow(row) || row[0] == NULL)
+        return -1;
+    return strtoll(row[0], NULL, 10);
+}
+
+class DbRoutingConnectionTest : public ::testing::Test {
+public:
+    virtual void SetUp() {
+        mLogManager.BeginLogging("//stderr");
+        createDatabase(TEST_DB, "primary");
+        for (int i = 0; i < REPLICAS; ++i)
+        {
+            createDatabase(replicaPath(i), FString(FStringFC(), "replica%d", i));
+            mReplicaPaths.push_back(replicaPath(i));
+        }
+    }
+    virtual void TearDown() {
+        unlink(TEST_DB);
+        for (int i = 0; i < REPLICAS; ++i)
+            unlink(replicaPath(i));
+    }
+
+    boost::shared_ptr<DbRoutingConnectionFactory> makeFactory(
+        const FStringVector &paths)
+    {
+        return boost::shared_ptr<DbRoutingConnectionFactory>(
+            new DbRoutingConnectionFactory(
+                boost::shared_ptr<DbConnectionFactory>(
+                    new DbLiteConnectionFactory()),
+                boost::shared_ptr<DbConnectionFactory>(
+                    new DbLiteConnectionFactory(SQLITE_OPEN_READONLY)),
+                paths));
+    }
+
+    LogManager mLogManager;
+    FStringVector mReplicaPaths;
+};
+
+TEST_F(DbRoutingConnectionTest, ReadsGoToReplicasWritesToPrimary)
+{
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(
+        makeFactory(mReplicaPaths));
+    boost::scoped_ptr<DbConnection> db(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+    DbRoutingConnection &routing(dynamic_cast<DbRoutingConnection&>(*db));
+
+    EXPECT_EQ(0, whoami(*db).find("replica"));
+    EXPECT_GE(routing.GetLastReplica(), 0);
+
+    ASSERT_TRUE(db->Execute("INSERT INTO test VALUES (1)"));
+    EXPECT_EQ(-1, routing.GetLastReplica());
+    EXPECT_EQ(1U, db->AffectedRows());
+
+    InsertDbSqlStatement insert("INSERT INTO test VALUES (?)");
+    insert.BindInt(2);
+    ASSERT_TRUE(db->Execute(insert));
+    EXPECT_EQ(-1, routing.GetLastReplica());
+
+    // the replicas are not kept up to date here
+    EXPECT_EQ(0, countRows(*db));
+    EXPECT_GE(routing.GetLastReplica(), 0);
+
+    DbLiteConnection primary;
+    ASSERT_TRUE(primary.Init(TEST_DB));
+    EXPECT_EQ(2, countRows(primary));
+}
+
+TEST_F(DbRoutingConnectionTest, BalancesAcrossReplicas)
+{
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(
+        makeFactory(mReplicaPaths));
+    boost::scoped_ptr<DbConnection> db1(factory->create());
+    boost::scoped_ptr<DbConnection> db2(factory->create());
+    ASSERT_TRUE(db1->Init(TEST_DB, "", ""));
+    ASSERT_TRUE(db2->Init(TEST_DB, "", ""));
+
+    for (int i = 0; i < 15; ++i)
+    {
+        EXPECT_NE("", whoami(*db1));
+        EXPECT_NE("", whoami(*db2));
+    }
+
+    boost::shared_ptr<DbReplicaSet> replicas(factory->GetReplicaSet());
+    for (int i = 0; i < REPLICAS; ++i)
+    {
+        EXPECT_EQ(10U, replicas->GetQueryCount(i));
+        EXPECT_EQ(0U, replicas->GetOutstanding(i));
+    }
+}
+
+TEST_F(DbRoutingConnectionTest, PrefersLeastOutstanding)
+{
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(
+        makeFactory(mReplicaPaths));
+    boost::shared_ptr<DbReplicaSet> replicas(factory->GetReplicaSet());
+    boost::scoped_ptr<DbConnection> db(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+
+    // as if other connections were busy on the first two
+    EXPECT_EQ(0, replicas->Acquire());
+    EXPECT_EQ(1, replicas->Acquire());
+    EXPECT_EQ(1U, replicas->GetOutstanding(0));
+
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ("replica2", whoami(*db));
+
+    replicas->Release(0);
+    replicas->Release(1);
+    EXPECT_EQ(0U, replicas->GetOutstanding(0));
+    EXPECT_EQ(0U, replicas->GetOutstanding(2));
+}
+
+TEST_F(DbRoutingConnectionTest, StreamedReadsCountUntilFinished)
+{
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(
+        makeFactory(mReplicaPaths));
+    boost::shared_ptr<DbReplicaSet> replicas(factory->GetReplicaSet());
+    boost::scoped_ptr<DbConnection> db(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+    DbRoutingConnection &routing(dynamic_cast<DbRoutingConnection&>(*db));
+
+    DbResult res = db->Use("SELECT name FROM whoami");
+    ASSERT_TRUE(res);
+    int replica = routing.GetLastReplica();
+    ASSERT_GE(replica, 0);
+    EXPECT_EQ(1U, replicas->GetOutstanding(replica));
+
+    // the replica is busy while the rows are read
+    EXPECT_NE("", whoami(*db));
+    EXPECT_NE(replica, routing.GetLastReplica());
+
+    DbResultRow row;
+    ASSERT_TRUE(res.FetchRow(row));
+    EXPECT_EQ(1U, replicas->GetOutstanding(replica));
+    EXPECT_FALSE(res.FetchRow(row));
+    EXPECT_EQ(0U, replicas->GetOutstanding(replica));
+
+    // or until the result is released
+    res = db->Use(SelectDbSqlStatement("SELECT name FROM whoami"));
+    ASSERT_TRUE(res);
+    replica = routing.GetLastReplica();
+    ASSERT_GE(replica, 0);
+    EXPECT_EQ(1U, replicas->GetOutstanding(replica));
+    res.Clear();
+    EXPECT_EQ(0U, replicas->GetOutstanding(replica));
+
+    // a Store() has read every row by the time it returns
+    res = db->Store("SELECT name FROM whoami");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(0U, replicas->GetOutstanding(routing.GetLastReplica()));
+}
+
+TEST_F(DbRoutingConnectionTest, ReadsOwnWritesInTransaction)
+{
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(
+        makeFactory(mReplicaPaths));
+    boost::scoped_ptr<DbConnection> db(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+    DbRoutingConnection &routing(dynamic_cast<DbRoutingConnection&>(*db));
+
+    {
+        DbAutoTrans trans(*db);
+        DbExecute(*db, "INSERT INTO test VALUES (1)");
+        EXPECT_EQ(1, countRows(*db));
+        EXPECT_EQ("primary", whoami(*db));
+        EXPECT_EQ(-1, routing.GetLastReplica());
+        // not committed, rolled back here
+    }
+
+    EXPECT_EQ(0, whoami(*db).find("replica"));
+
+    db->Begin();
+    DbExecute(*db, "INSERT INTO test VALUES (2)");
+    EXPECT_EQ(1, countRows(*db));
+    db->Commit();
+    EXPECT_EQ(0, countRows(*db));
+    EXPECT_GE(routing.GetLastReplica(), 0);
+}
+
+TEST_F(DbRoutingConnectionTest, SkipsFailedReplicas)
+{
+    FStringVector paths;
+    paths.push_back("/nonexistent/dir/replica.db");
+    paths.push_back(replicaPath(1));
+    boost::shared_ptr<DbRoutingConnectionFactory> factory(makeFactory(paths));
+    boost::scoped_ptr<DbConnection> db(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ("replica1", whoami(*db));
+
+    // a query the replica can not run is tried on the primary
+    DbLiteConnection primary;
+    ASSERT_TRUE(primary.Init(TEST_DB));
+    DbExecute(primary, "CREATE TABLE primaryonly (a INTEGER)");
+    DbResult res = db->Store("SELECT count(*) FROM primaryonly");
+    EXPECT_TRUE(res);
+
+    FStringVector none;
+    none.push_back("/nonexistent/dir/replica.db");
+    factory = makeFactory(none);
+    db.reset(factory->create());
+    ASSERT_TRUE(db->Init(TEST_DB, "", ""));
+    EXPECT_EQ("primary", whoami(*db));
+}
+
+TEST_F(DbRoutingConnectionTest, PoolFromServiceConfig)
+{
+    ServiceConfig config;
+    config.Set("db.type", "sqlite");
+    config.Set("db.path", TEST_DB);
+    for (int i = 0; i < REPLICAS; ++i)
+    {
+        config.Set(FString(FStringFC(), "db.mirror.list.%d.path", i),
+                   replicaPath(i));
+    }
+
+    DbConnectionPool pool(config, "db");
+    ASSERT_EQ(3U, pool.GetMirrorDbNames().size());
+
+    DbConnection &db(pool.GetDbConnection());
+    ASSERT_TRUE(dynamic_cast<DbRoutingConnection*>(&db) != NULL);
+    EXPECT_EQ(0, whoami(db).find("replica"));
+    EXPECT_TRUE(db.Execute("INSERT INTO test VALUES (1)"));
+    pool.ReleaseDbConnection(db);
+}
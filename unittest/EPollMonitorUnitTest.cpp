@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "FTrace.h"
+#include "LogManager.h"
+#include "EPollMonitor.h"
+#include <boost/bind.hpp>
+
+using namespace Forte;
+
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+class EPollMonitorUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_ALL);
+        logManager.BeginLogging("//stderr",
+                                logManager.GetSingleLevelFromString("UPTO_DEBUG"),
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+};
+
+struct SlowTimer
+{
+    SlowTimer(EPollMonitor &monitor, bool removeSelf)
+        : mMonitor(monitor),
+          mRemoveSelf(removeSelf),
+          mTimer(-1),
+          mStarted(0),
+          mFinished(0)
+        {
+        }
+
+    void Fired() {
+        __sync_fetch_and_add(&mStarted, 1);
+        if (mRemoveSelf)
+            mMonitor.RemoveTimer(mTimer);
+        usleep(200000);
+        __sync_fetch_and_add(&mFinished, 1);
+    }
+
+    bool WaitForStart() {
+        for (int i = 0; i < 1000 && mStarted == 0; ++i)
+            usleep(1000);
+        return mStarted != 0;
+    }
+
+    EPollMonitor &mMonitor;
+    const bool mRemoveSelf;
+    int mTimer;
+    volatile int mStarted;
+    volatile int mFinished;
+};
+
+TEST_F(EPollMonitorUnitTest, RemoveTimerWaitsForRunningHandler)
+{
+    EPollMonitor monitor("eplmon", 100, 2);
+    monitor.Start();
+
+    SlowTimer slow(monitor, false);
+    slow.mTimer = monitor.AddTimer(boost::bind(&SlowTimer::Fired, &slow));
+    monitor.SetTimer(slow.mTimer, Timespec(), true);
+    ASSERT_TRUE(slow.WaitForStart());
+
+    monitor.RemoveTimer(slow.mTimer);
+    EXPECT_EQ(1, slow.mFinished);
+
+    // the id is gone, setting it neither throws nor fires anything
+    monitor.SetTimer(slow.mTimer, Timespec());
+    monitor.CancelTimer(slow.mTimer);
+    usleep(300000);
+    EXPECT_EQ(1, slow.mStarted);
+
+    monitor.Shutdown();
+}
+
+TEST_F(EPollMonitorUnitTest, HandlerCanRemoveItsOwnTimer)
+{
+    EPollMonitor monitor("eplmon", 100, 2);
+    monitor.Start();
+
+    SlowTimer slow(monitor, true);
+    slow.mTimer = monitor.AddTimer(boost::bind(&SlowTimer::Fired, &slow));
+    monitor.SetTimer(slow.mTimer, Timespec(), true);
+    ASSERT_TRUE(slow.WaitForStart());
+
+    // already removed by the handler
+    monitor.RemoveTimer(slow.mTimer);
+    usleep(400000);
+    EXPECT_EQ(1, slow.mStarted);
+    EXPECT_EQ(1, slow.mFinished);
+
+    monitor.Shutdown();
+}
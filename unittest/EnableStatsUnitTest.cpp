@@ -2,6 +2,8 @@
 #include "EnableStats.h"
 #include "LogManager.h"
 #include "Locals.h"
+#include "LatencyHistogram.h"
+#include "PerCPUCounter.h"
 
 using namespace Forte;
 using namespace boost;
@@ -276,3 +278,48 @@ TEST_F(EnableStatsUnitTest, HierarchyOfAbstractTypesTest)
     ASSERT_EQ(0, allStats["numberOfObjects"]);
     PrintStats(allStats);
 }
+
+class DerivedStatTest :
+    public Forte::Object,
+    public EnableStats<DerivedStatTest,
+                       Locals<DerivedStatTest, PerCPUCounter, LatencyHistogram> >
+{
+public:
+    DerivedStatTest() {
+        registerStatVariable<0>("requests", &DerivedStatTest::requests);
+        registerStatVariable<1>("latency", &DerivedStatTest::latency);
+    }
+
+    void HandleRequest(int64_t usec) {
+        ++requests;
+        latency.Record(usec);
+    }
+
+protected:
+    PerCPUCounter requests;
+    LatencyHistogram latency;
+};
+
+TEST_F(EnableStatsUnitTest, DerivedStats)
+{
+    DerivedStatTest test;
+
+    test.HandleRequest(10);
+    test.HandleRequest(20);
+
+    std::map<FString, int64_t> allStats = test.GetAllStats();
+    PrintStats(allStats);
+
+    ASSERT_EQ(6, allStats.size());
+    ASSERT_EQ(2, allStats["requests"]);
+    ASSERT_EQ(2, allStats["latency"]);
+    ASSERT_EQ(10, allStats["latency.p50"]);
+    ASSERT_EQ(20, allStats["latency.p99"]);
+    ASSERT_EQ(20, allStats["latency.p999"]);
+    ASSERT_EQ(20, allStats["latency.max"]);
+
+    ASSERT_EQ(2, test.GetStat("requests"));
+    ASSERT_EQ(2, test.GetStat("latency"));
+    ASSERT_EQ(20, test.GetStat("latency.max"));
+    ASSERT_THROW(test.GetStat("latency.p42"), EFailedToFindStat);
+}
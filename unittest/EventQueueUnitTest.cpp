@@ -1,10 +1,14 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include "FTrace.h"
+#include "Foreach.h"
 #include "LogManager.h"
 
+#include "Clock.h"
 #include "Event.h"
 #include "EventQueue.h"
+#include "FunctionThread.h"
+#include <boost/bind.hpp>
 
 using namespace std;
 using namespace boost;
@@ -102,3 +106,98 @@ TEST_F(EventQueueUnitTest, DropOldestStopsDroppingAfterSpaceIsAvailable)
     q.Add(e);
     EXPECT_EQ(4, q.Depth());
 }
+
+TEST_F(EventQueueUnitTest, AddBatchKeepsOrder)
+{
+    EventQueue q(16);
+    std::list<boost::shared_ptr<Event> > batch;
+    for (int i = 0; i < 5; ++i)
+        batch.push_back(boost::shared_ptr<Event>(new Event()));
+    std::list<boost::shared_ptr<Event> > added(batch);
+
+    q.AddBatch(batch);
+    EXPECT_EQ(5, q.Depth());
+    foreach (const boost::shared_ptr<Event> &e, added)
+        EXPECT_EQ(e, q.Get());
+    EXPECT_EQ(0, q.Depth());
+
+    std::list<boost::shared_ptr<Event> > empty;
+    q.AddBatch(empty);
+    EXPECT_EQ(0, q.Depth());
+}
+
+TEST_F(EventQueueUnitTest, AddBatchIsAllOrNothing)
+{
+    EventQueue q(4, EventQueue::QUEUE_MODE_THROW);
+    boost::shared_ptr<Event> e(new Event());
+    q.Add(e);
+    q.Add(e);
+
+    std::list<boost::shared_ptr<Event> > batch(3, e);
+    ASSERT_THROW(q.AddBatch(batch), EEventQueueFull);
+    EXPECT_EQ(2, q.Depth());
+
+    // the slots it took were given back
+    batch.pop_back();
+    q.AddBatch(batch);
+    EXPECT_EQ(4, q.Depth());
+
+    std::list<boost::shared_ptr<Event> > invalid(1, e);
+    invalid.push_back(boost::shared_ptr<Event>());
+    q.Get();
+    ASSERT_THROW(q.AddBatch(invalid), EEventQueueEventInvalid);
+    EXPECT_EQ(3, q.Depth());
+}
+
+static void addBatchOf(EventQueue *q, int count)
+{
+    std::list<boost::shared_ptr<Event> > batch;
+    for (int i = 0; i < count; ++i)
+        batch.push_back(boost::shared_ptr<Event>(new Event()));
+    q->AddBatch(batch);
+}
+
+TEST_F(EventQueueUnitTest, AddBatchLargerThanDepthBlocking)
+{
+    // each batch is bigger than the whole queue, and two producers
+    // compete for its slots
+    const int batchSize = 10;
+    EventQueue q(4);
+    boost::shared_ptr<FunctionThread> first(
+        new FunctionThread(FunctionThread::AutoInit(),
+                           boost::bind(&addBatchOf, &q, batchSize),
+                           "producer"));
+    boost::shared_ptr<FunctionThread> second(
+        new FunctionThread(FunctionThread::AutoInit(),
+                           boost::bind(&addBatchOf, &q, batchSize),
+                           "producer"));
+
+    int received = 0;
+    for (int tries = 0; received < 2 * batchSize && tries < 10000; ++tries)
+    {
+        EXPECT_GE(4, q.Depth());
+        EventQueue::EventPtrVector events(q.Get(2 * batchSize));
+        received += events.size();
+        if (events.empty())
+            usleep(1000);
+    }
+    EXPECT_EQ(2 * batchSize, received);
+
+    first->WaitForShutdown();
+    second->WaitForShutdown();
+    EXPECT_EQ(0, q.Depth());
+}
+
+TEST_F(EventQueueUnitTest, AddStampsEnqueuedTime)
+{
+    EventQueue q(16);
+    boost::shared_ptr<Event> e(new Event());
+    EXPECT_EQ(0, e->mEnqueuedTime.tv_sec);
+    EXPECT_EQ(0, e->mEnqueuedTime.tv_nsec);
+
+    struct timespec before;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    q.Add(e);
+
+    EXPECT_FALSE(Timespec(e->mEnqueuedTime) < Timespec(before));
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "LatencyHistogram.h"
+#include "Clock.h"
+#include "LogManager.h"
+
+using namespace Forte;
+
+LogManager logManager;
+
+class LatencyHistogramUnitTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestCase() {
+        logManager.BeginLogging("//stdout");
+        logManager.SetLogMask("//stdout", HLOG_ALL);
+        hlog(HLOG_DEBUG, "Starting test...");
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging("//stdout");
+    }
+};
+
+TEST_F(LatencyHistogramUnitTest, Empty)
+{
+    LatencyHistogram histogram;
+
+    ASSERT_EQ(0, histogram.GetCount());
+    ASSERT_EQ(0, histogram.GetMax());
+    ASSERT_EQ(0, histogram.GetPercentile(0.5));
+    ASSERT_EQ(0, histogram.GetPercentile(0.99));
+}
+
+TEST_F(LatencyHistogramUnitTest, SmallValuesAreExact)
+{
+    LatencyHistogram histogram;
+
+    for (int i = 1; i <= 20; ++i)
+        histogram.Record(i);
+
+    ASSERT_EQ(20, histogram.GetCount());
+    ASSERT_EQ(20, histogram.GetMax());
+    ASSERT_EQ(10, histogram.GetPercentile(0.5));
+    ASSERT_EQ(1, histogram.GetPercentile(0.0));
+    ASSERT_EQ(20, histogram.GetPercentile(1.0));
+}
+
+TEST_F(LatencyHistogramUnitTest, LargeValuesWithinBucketError)
+{
+    LatencyHistogram histogram;
+
+    for (int64_t i = 1; i <= 100000; ++i)
+        histogram.Record(i);
+
+    const int64_t p50 = histogram.GetPercentile(0.5);
+    const int64_t p99 = histogram.GetPercentile(0.99);
+    const int64_t p999 = histogram.GetPercentile(0.999);
+
+    // reported values are bucket upper bounds, at most 1/32 high
+    ASSERT_LE(50000, p50);
+    ASSERT_GE(50000 + 50000 / 32, p50);
+    ASSERT_LE(99000, p99);
+    ASSERT_GE(99000 + 99000 / 32, p99);
+    ASSERT_LE(99900, p999);
+    ASSERT_GE(100000, p999);
+    ASSERT_EQ(100000, histogram.GetMax());
+}
+
+TEST_F(LatencyHistogramUnitTest, ClampsOutOfRange)
+{
+    LatencyHistogram histogram;
+
+    histogram.Record(-5);
+    histogram.Record(LatencyHistogram::MAX_VALUE + 1000);
+
+    ASSERT_EQ(2, histogram.GetCount());
+    ASSERT_EQ(0, histogram.GetPercentile(0.5));
+    ASSERT_EQ(LatencyHistogram::MAX_VALUE, histogram.GetMax());
+    ASSERT_EQ(LatencyHistogram::MAX_VALUE, histogram.GetPercentile(1.0));
+}
+
+TEST_F(LatencyHistogramUnitTest, RecordsTimespecInMicroseconds)
+{
+    LatencyHistogram histogram;
+
+    histogram.Record(Timespec(2, 500000));
+
+    ASSERT_EQ(2000500, histogram.GetMax());
+}
+
+TEST_F(LatencyHistogramUnitTest, DerivedStatsAndClear)
+{
+    LatencyHistogram histogram;
+
+    histogram.Record(3);
+    histogram.Record(7);
+
+    std::map<FString, int64_t> stats;
+    histogram.GetDerivedStats("wait", stats);
+
+    ASSERT_EQ(5, stats.size());
+    ASSERT_EQ(2, stats["wait"]);
+    ASSERT_EQ(3, stats["wait.p50"]);
+    ASSERT_EQ(7, stats["wait.p99"]);
+    ASSERT_EQ(7, stats["wait.p999"]);
+    ASSERT_EQ(7, stats["wait.max"]);
+
+    histogram.Clear();
+    ASSERT_EQ(0, histogram.GetCount());
+    ASSERT_EQ(0, histogram.GetMax());
+}
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include "LogManager.h"
 #include "FTrace.h"
+#include "Foreach.h"
+#include "Clock.h"
 #include <boost/make_shared.hpp>
+#include <fstream>
+#include <sys/wait.h>
 
 using namespace std;
 using namespace boost;
@@ -231,3 +235,255 @@ TEST(LogManagerUnitTest, TestMultiThreadedConcurrency)
     EXPECT_EQ(MAX_THREADS, ctr);
     EXPECT_EQ(MAX_THREADS, stats);
 }
+
+static int countLinesContaining(const FString& filename, const FString& needle)
+{
+    ifstream in(filename.c_str());
+    string line;
+    int count(0);
+    while (getline(in, line))
+    {
+        if (line.find(needle) != string::npos)
+            ++count;
+    }
+    return count;
+}
+
+class AsyncLogClient : public Forte::Thread
+{
+public:
+    AsyncLogClient(int index, int messages)
+        : mIndex(index), mMessages(messages)
+    {
+        setThreadName(FString(FStringFC(), "asyncclient%d", index));
+        initialized();
+    }
+
+    virtual ~AsyncLogClient() {
+        deleting();
+    }
+
+    void *run()
+    {
+        for (int i = 0; i < mMessages; ++i)
+        {
+            hlog(HLOG_ERR, "async message %d from client %d", i, mIndex);
+        }
+        return 0;
+    }
+
+    int mIndex;
+    int mMessages;
+};
+
+TEST(LogManagerUnitTest, AsyncLoggingWritesEveryMessage)
+{
+    FString filename = "./testasynclog";
+    unlink(filename.c_str());
+    logManager.EndLogging();
+    logManager.BeginLogging(filename, HLOG_NODEBUG);
+    logManager.BeginAsyncLogging(64, 10, LOG_ASYNC_BLOCK);
+    ASSERT_TRUE(logManager.IsAsyncLogging());
+
+    {
+        vector<boost::shared_ptr<AsyncLogClient> > clients;
+        for (int i = 0; i < 4; ++i)
+        {
+            clients.push_back(
+                boost::shared_ptr<AsyncLogClient>(new AsyncLogClient(i, 500)));
+        }
+        foreach (const boost::shared_ptr<AsyncLogClient>& client, clients)
+        {
+            client->WaitForShutdown();
+        }
+    }
+
+    // filtered on the writer thread just like the synchronous path
+    hlog(HLOG_DEBUG, "async message that is filtered out");
+
+    logManager.EndAsyncLogging();
+    ASSERT_FALSE(logManager.IsAsyncLogging());
+    logManager.EndLogging(filename);
+
+    EXPECT_EQ(2000, countLinesContaining(filename, "async message"));
+    EXPECT_EQ(500, countLinesContaining(filename, "asyncclient2"));
+    EXPECT_EQ(0, logManager.GetAsyncDroppedCount());
+    unlink(filename.c_str());
+}
+
+TEST(LogManagerUnitTest, AsyncLoggingFlushWritesQueuedMessages)
+{
+    FString filename = "./testasynclog";
+    unlink(filename.c_str());
+    logManager.BeginLogging(filename, HLOG_NODEBUG);
+
+    // long enough that only the explicit flush writes anything
+    logManager.BeginAsyncLogging(1024, 60000, LOG_ASYNC_BLOCK);
+    for (int i = 0; i < 100; ++i)
+    {
+        hlog(HLOG_INFO, "queued message %d", i);
+    }
+    EXPECT_EQ(0, countLinesContaining(filename, "queued message"));
+
+    logManager.FlushAsyncLogging();
+    EXPECT_EQ(100, countLinesContaining(filename, "queued message"));
+
+    logManager.EndAsyncLogging();
+    logManager.EndLogging(filename);
+    unlink(filename.c_str());
+}
+
+TEST(LogManagerUnitTest, AsyncLoggingDropPolicyCountsDroppedMessages)
+{
+    FString filename = "./testasynclog";
+    unlink(filename.c_str());
+    logManager.BeginLogging(filename, HLOG_NODEBUG);
+
+    logManager.BeginAsyncLogging(16, 60000, LOG_ASYNC_DROP);
+    for (int i = 0; i < 100; ++i)
+    {
+        hlog(HLOG_INFO, "overflow message %d", i);
+    }
+    EXPECT_EQ(84, logManager.GetAsyncDroppedCount());
+
+    logManager.EndAsyncLogging();
+    logManager.EndLogging(filename);
+
+    EXPECT_EQ(16, countLinesContaining(filename, "overflow message"));
+    EXPECT_EQ(1, countLinesContaining(filename, "dropped 84 messages"));
+    unlink(filename.c_str());
+}
+
+TEST(LogManagerUnitTest, AsyncLoggingBlockPolicyWaitsForWriter)
+{
+    FString filename = "./testasynclog";
+    unlink(filename.c_str());
+    logManager.BeginLogging(filename, HLOG_NODEBUG);
+
+    // a full buffer wakes the writer instead of waiting out the interval
+    logManager.BeginAsyncLogging(16, 60000, LOG_ASYNC_BLOCK);
+    for (int i = 0; i < 1000; ++i)
+    {
+        hlog(HLOG_INFO, "blocking message %d", i);
+    }
+    EXPECT_LE(1000 - 16, countLinesContaining(filename, "blocking message"));
+
+    logManager.EndAsyncLogging();
+    logManager.EndLogging(filename);
+
+    EXPECT_EQ(1000, countLinesContaining(filename, "blocking message"));
+    unlink(filename.c_str());
+}
+
+TEST(LogManagerUnitTest, AsyncLoggingFlushesOnCrash)
+{
+    FString filename = "./testasynclog";
+    unlink(filename.c_str());
+
+    pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0)
+    {
+        logManager.EndLogging();
+        logManager.BeginLogging(filename, HLOG_NODEBUG);
+        logManager.BeginAsyncLogging(1024, 60000, LOG_ASYNC_BLOCK);
+        for (int i = 0; i < 10; ++i)
+        {
+            hlog(HLOG_CRIT, "message before crash %d", i);
+        }
+        abort();
+    }
+
+    int status(0);
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFSIGNALED(status));
+    EXPECT_EQ(SIGABRT, WTERMSIG(status));
+    EXPECT_EQ(10, countLinesContaining(filename, "message before crash"));
+    unlink(filename.c_str());
+}
+
+static void laterBusHandler(int sig)
+{
+}
+
+TEST(LogManagerUnitTest, EndAsyncLoggingKeepsLaterSignalHandler)
+{
+    struct sigaction original;
+    ASSERT_EQ(0, sigaction(SIGBUS, NULL, &original));
+
+    logManager.BeginAsyncLogging();
+    signal(SIGBUS, &laterBusHandler);
+    logManager.EndAsyncLogging();
+
+    struct sigaction current;
+    ASSERT_EQ(0, sigaction(SIGBUS, NULL, &current));
+    EXPECT_TRUE(current.sa_handler == &laterBusHandler);
+    sigaction(SIGBUS, &original, NULL);
+}
+
+static void logFromOneCallSite(int i)
+{
+    hlog(HLOG_DEBUG, "call site message %d", i);
+}
+
+TEST(LogManagerUnitTest, CallSiteCacheFollowsMaskChanges)
+{
+    FString filename = "./testcallsitelog";
+    unlink(filename.c_str());
+    logManager.EndLogging();
+    logManager.BeginLogging(filename, HLOG_INFO);
+
+    logFromOneCallSite(0);
+    EXPECT_EQ(0, countLinesContaining(filename, "call site message 0"));
+
+    logManager.SetGlobalLogMask(HLOG_DEBUG | HLOG_INFO);
+    logFromOneCallSite(1);
+    EXPECT_EQ(1, countLinesContaining(filename, "call site message 1"));
+
+    logManager.SetSourceFileLogMask(__FILE__, HLOG_INFO);
+    logFromOneCallSite(2);
+    EXPECT_EQ(0, countLinesContaining(filename, "call site message 2"));
+
+    logManager.ClearSourceFileLogMask(__FILE__);
+    logFromOneCallSite(3);
+    EXPECT_EQ(1, countLinesContaining(filename, "call site message 3"));
+
+    logManager.PathSetSourceFileLogMask(filename, __FILE__, HLOG_ERR);
+    logFromOneCallSite(4);
+    EXPECT_EQ(0, countLinesContaining(filename, "call site message 4"));
+
+    logManager.PathClearAllSourceFiles(filename);
+    logFromOneCallSite(5);
+    EXPECT_EQ(1, countLinesContaining(filename, "call site message 5"));
+
+    logManager.EndLogging(filename);
+    logFromOneCallSite(6);
+
+    logManager.SetGlobalLogMask(HLOG_ALL);
+    unlink(filename.c_str());
+}
+
+TEST(LogManagerUnitTest, DisabledLogStatementWritesNothing)
+{
+    // the cost of these is measured by LogManagerBenchmarkOnBoxTest
+    static const int CALLS = 100000;
+    FString filename = "./testcallsitelog";
+    unlink(filename.c_str());
+    logManager.EndLogging();
+    logManager.BeginLogging(filename, HLOG_NODEBUG);
+
+    // DEBUG4 turned on for some other file puts it in the global OR
+    // mask, so only the call site decision keeps these out
+    logManager.SetSourceFileLogMask("SomeOtherFile.cpp", HLOG_ALL);
+
+    for (int i = 0; i < CALLS; ++i)
+    {
+        hlog(HLOG_DEBUG4, "disabled message %d", i);
+    }
+
+    logManager.ClearSourceFileLogMask("SomeOtherFile.cpp");
+    logManager.EndLogging(filename);
+
+    EXPECT_EQ(0, countLinesContaining(filename, "disabled message"));
+    unlink(filename.c_str());
+}
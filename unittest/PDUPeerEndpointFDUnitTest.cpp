@@ -321,6 +321,316 @@ TEST_F(PDUPeerEndpointFDUnitTest, SendsAndRecvsViaEPollAndPDUQueue)
     monitor->Shutdown();
 }
 
+TEST_F(PDUPeerEndpointFDUnitTest, EventLoopModeSendsAndRecvsViaEPoll)
+{
+    FTRACE;
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 2));
+    monitor->Start();
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    boost::shared_ptr<PDUQueue> pduQueue1(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e1(
+        new PDUPeerEndpointFD(pduQueue1, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              DEFAULT_MAX_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e1->SetEventCallback(
+        boost::bind(
+            &PDUPeerEndpointFDUnitTest::EventCallback, this, _1));
+    e1->SetFD(fds[0]);
+
+    boost::shared_ptr<PDUQueue> pduQueue2(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e2(
+        new PDUPeerEndpointFD(pduQueue2, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              DEFAULT_MAX_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e2->SetEventCallback(
+        boost::bind(
+            &PDUPeerEndpointFDUnitTest::EventCallback, this, _1));
+    e2->SetFD(fds[1]);
+
+    e1->Start();
+    e2->Start();
+
+    {
+        Forte::AutoUnlockMutex lock(mEventMutex);
+        while (mConnectedEventCount < 2)
+        {
+            mEventReceivedCondition.Wait();
+        }
+    }
+
+    Forte::PDUPtr pdu = makeTestPDU();
+    for (int i = 0; i < 3; ++i)
+    {
+        pduQueue1->EnqueuePDU(pdu);
+    }
+
+    Forte::PDU out;
+    for (int i = 0; i < 3; ++i)
+    {
+        while (!e2->IsPDUReady()) { usleep(10000); }
+        ASSERT_TRUE(e2->RecvPDU(out));
+        ASSERT_EQ(*pdu, out);
+    }
+
+    {
+        Forte::AutoUnlockMutex lock(mEventMutex);
+        while (mReceiveEventCount < 1)
+        {
+            mEventReceivedCondition.Wait();
+        }
+    }
+
+    e1->SetEventCallback(NULL);
+    e2->SetEventCallback(NULL);
+    e1->Shutdown();
+    e2->Shutdown();
+
+    monitor->Shutdown();
+}
+
+TEST_F(PDUPeerEndpointFDUnitTest, EventLoopModeResumesRecvWhenBufferDrains)
+{
+    FTRACE;
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 1));
+    monitor->Start();
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    // recv buffer cannot grow, so it fills and the loop thread has to
+    // stop reading rather than wait for the consumer
+    boost::shared_ptr<PDUQueue> pduQueue1(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e1(
+        new PDUPeerEndpointFD(pduQueue1, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e1->SetFD(fds[0]);
+
+    boost::shared_ptr<PDUQueue> pduQueue2(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e2(
+        new PDUPeerEndpointFD(pduQueue2, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e2->SetFD(fds[1]);
+
+    e1->Start();
+    e2->Start();
+
+    const int pduCount(64);
+    Forte::PDUPtr pdu = makeTestPDU(4096);
+    for (int i = 0; i < pduCount; ++i)
+    {
+        pduQueue1->EnqueuePDU(pdu);
+    }
+
+    Forte::PDU out;
+    for (int i = 0; i < pduCount; ++i)
+    {
+        while (!e2->RecvPDU(out)) { usleep(1000); }
+        ASSERT_EQ(*pdu, out);
+    }
+
+    e1->Shutdown();
+    e2->Shutdown();
+
+    monitor->Shutdown();
+}
+
+TEST_F(PDUPeerEndpointFDUnitTest, EventLoopModeSendTimesOutWhenPeerStopsReading)
+{
+    FTRACE;
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 1));
+    monitor->Start();
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    AutoFD peer(fds[1]);
+
+    // nothing reads the other end, so EPOLLOUT never comes back and
+    // only the send timer can notice the deadline has passed
+    boost::shared_ptr<PDUQueue> pduQueue(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e1(
+        new PDUPeerEndpointFD(pduQueue, monitor,
+                              1,
+                              RECV_BUFFER_SIZE,
+                              DEFAULT_MAX_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e1->SetEventCallback(
+        boost::bind(
+            &PDUPeerEndpointFDUnitTest::EventCallback, this, _1));
+    e1->SetFD(fds[0]);
+    e1->Start();
+
+    Forte::PDUPtr pdu = makeTestPDU(4096);
+    for (int i = 0; i < 256; ++i)
+    {
+        pduQueue->EnqueuePDU(pdu);
+    }
+
+    DeadlineClock deadline;
+    deadline.ExpiresInSeconds(10);
+    {
+        Forte::AutoUnlockMutex lock(mEventMutex);
+        while (mDisconnectedEventCount < 1 && !deadline.Expired())
+        {
+            Forte::AutoLockMutex unlock(mEventMutex);
+            usleep(10000);
+        }
+        ASSERT_EQ(1, mDisconnectedEventCount);
+    }
+    ASSERT_FALSE(e1->IsConnected());
+
+    e1->SetEventCallback(NULL);
+    e1->Shutdown();
+
+    monitor->Shutdown();
+}
+
+TEST_F(PDUPeerEndpointFDUnitTest, RecvPDUViewReferencesReceivedPDU)
+{
+    FTRACE;
+    setupDefaultFDPair();
+
+    Forte::PDUPtr pdu = makeTestPDU();
+    for (int i = 0; i < 3; ++i)
+    {
+        mPDUQueue1->EnqueuePDU(pdu);
+    }
+
+    std::vector<Forte::PDUView> views;
+    for (int i = 0; i < 3; ++i)
+    {
+        Forte::PDUView view;
+        while (!mEndpoint2->RecvPDUView(view)) { usleep(10000); }
+        views.push_back(view);
+    }
+    ASSERT_FALSE(mEndpoint2->IsPDUReady());
+
+    teardownDefaultFDPair();
+
+    // views stay valid after the endpoint has let go of its buffer
+    foreach (const Forte::PDUView& view, views)
+    {
+        ASSERT_EQ(pdu->GetOpcode(), view.GetOpcode());
+        ASSERT_EQ(pdu->GetOptionalDataSize(), view.GetOptionalDataSize());
+        ASSERT_EQ(0, memcmp(pdu->GetOptionalData()->GetData(),
+                            view.GetOptionalData(),
+                            view.GetOptionalDataSize()));
+
+        Forte::PDU out;
+        view.CopyTo(out);
+        ASSERT_EQ(*pdu, out);
+    }
+}
+
+TEST_F(PDUPeerEndpointFDUnitTest, RecvPDUViewReusesOneView)
+{
+    FTRACE;
+    setupDefaultFDPair();
+
+    Forte::PDUPtr pdu = makeTestPDU();
+    for (int i = 0; i < 5; ++i)
+    {
+        mPDUQueue1->EnqueuePDU(pdu);
+    }
+
+    // each call drops the view it replaces, pin and all
+    Forte::PDUView view;
+    for (int i = 0; i < 5; ++i)
+    {
+        while (!mEndpoint2->RecvPDUView(view)) { usleep(10000); }
+
+        Forte::PDU out;
+        view.CopyTo(out);
+        ASSERT_EQ(*pdu, out);
+    }
+    ASSERT_FALSE(mEndpoint2->RecvPDUView(view));
+    ASSERT_FALSE(view.Empty());
+
+    teardownDefaultFDPair();
+}
+
+TEST_F(PDUPeerEndpointFDUnitTest, RecvResumesWhenPDUViewsAreDropped)
+{
+    FTRACE;
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 1));
+    monitor->Start();
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    // recv buffer cannot grow, so held views are what stops the
+    // receiver until they are dropped
+    boost::shared_ptr<PDUQueue> pduQueue1(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e1(
+        new PDUPeerEndpointFD(pduQueue1, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e1->SetFD(fds[0]);
+
+    boost::shared_ptr<PDUQueue> pduQueue2(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointFD> e2(
+        new PDUPeerEndpointFD(pduQueue2, monitor,
+                              DEFAULT_SEND_TIMEOUT,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              RECV_BUFFER_SIZE,
+                              PDU_PEER_ENDPOINT_EVENT_LOOP));
+    e2->SetFD(fds[1]);
+
+    e1->Start();
+    e2->Start();
+
+    const int pduCount(64);
+    Forte::PDUPtr pdu = makeTestPDU(4096);
+    for (int i = 0; i < pduCount; ++i)
+    {
+        pduQueue1->EnqueuePDU(pdu);
+    }
+
+    std::list<Forte::PDUView> held;
+    for (int i = 0; i < pduCount; ++i)
+    {
+        Forte::PDUView view;
+        while (!e2->RecvPDUView(view)) { usleep(1000); }
+
+        Forte::PDU out;
+        view.CopyTo(out);
+        ASSERT_EQ(*pdu, out);
+
+        held.push_back(view);
+        if (held.size() > 4)
+        {
+            held.pop_front();
+        }
+    }
+    held.clear();
+
+    e1->Shutdown();
+    e2->Shutdown();
+
+    monitor->Shutdown();
+}
+
 TEST_F(PDUPeerEndpointFDUnitTest, QueuesPDUsForSending)
 {
     FTRACE;
@@ -91,3 +91,27 @@ TEST_F(PDUPeerEndpointInProcessUnitTest, PullsPDUsFromPDUQueueAndSendsThem)
 
     theClass.Shutdown();
 }
+
+TEST_F(PDUPeerEndpointInProcessUnitTest, RecvPDUViewSharesQueuedPDU)
+{
+    FTRACE;
+    boost::shared_ptr<PDUQueue> pduQueue(new PDUQueue);
+    PDUPeerEndpointInProcess theClass(pduQueue);
+    theClass.SetEventCallback(
+        boost::bind(&PDUPeerEndpointInProcessUnitTest::EventCallback, this, _1));
+    theClass.Start();
+
+    const char payload[] = "shared payload";
+    PDUPtr p(new PDU(7, sizeof(payload), payload));
+    pduQueue->EnqueuePDU(p);
+    sleep(1);
+    ASSERT_EQ(1, mCallbackReceiveCount);
+
+    PDUView view;
+    ASSERT_TRUE(theClass.RecvPDUView(view));
+    ASSERT_EQ(7, view.GetOpcode());
+    ASSERT_EQ(p->GetPayload<char>(), view.GetPayload<char>());
+    ASSERT_FALSE(theClass.RecvPDUView(view));
+
+    theClass.Shutdown();
+}
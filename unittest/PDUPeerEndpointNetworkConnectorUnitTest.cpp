@@ -53,3 +53,108 @@ TEST_F(PDUPeerEndpointNetworkConnectorUnitTest, ConstructDelete)
 
     EXPECT_EQ(-1, theClass.GetFD());
 }
+
+static void countConnected(int *connected, boost::shared_ptr<PDUPeerEvent> event)
+{
+    if (event->mEventType == PDUPeerConnectedEvent)
+        __sync_fetch_and_add(connected, 1);
+}
+
+TEST_F(PDUPeerEndpointNetworkConnectorUnitTest, EventLoopModeConnectsWithoutBlocking)
+{
+    FTRACE;
+    AutoFD listener(createInetStreamSocket());
+    bindToAddress(listener, make_pair("127.0.0.1", 0));
+    ASSERT_EQ(0, listen(listener, 1));
+    struct sockaddr_in bound;
+    socklen_t boundLen(sizeof(bound));
+    ASSERT_EQ(0, getsockname(listener, reinterpret_cast<struct sockaddr*>(&bound),
+                             &boundLen));
+
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 1));
+    monitor->Start();
+    boost::shared_ptr<PDUQueue> pduQueue(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointNetworkConnector> connector(
+        new PDUPeerEndpointNetworkConnector(
+            pduQueue,
+            mOwnerID,
+            make_pair("127.0.0.1", static_cast<int>(ntohs(bound.sin_port))),
+            monitor,
+            PDU_PEER_ENDPOINT_EVENT_LOOP));
+    int connected(0);
+    connector->SetEventCallback(boost::bind(&countConnected, &connected, _1));
+    connector->Start();
+
+    // Start() has the loop thread start the connect
+    AutoFD peer(accept(listener, NULL, NULL));
+    ASSERT_NE(-1, peer);
+    for (int i = 0; i < 1000 && connected == 0; ++i)
+        usleep(1000);
+    ASSERT_EQ(1, connected);
+
+    char payload[16] = "connector pdu";
+    PDUPtr pdu(new PDU(7, sizeof(payload), payload));
+    pduQueue->EnqueuePDU(pdu);
+
+    // the identifier comes first, then the PDU that was queued
+    const size_t expected(sizeof(mOwnerID) + PDU::Size(pdu->GetHeader()));
+    std::string got;
+    char buf[256];
+    while (got.size() < expected)
+    {
+        ssize_t rc = recv(peer, buf, sizeof(buf), 0);
+        ASSERT_GT(rc, 0);
+        got.append(buf, rc);
+    }
+    ASSERT_EQ(expected, got.size());
+    uint64_t id;
+    memcpy(&id, got.data(), sizeof(id));
+    EXPECT_EQ(mOwnerID, id);
+    boost::shared_array<char> flat(PDU::CreateSendBuffer(*pdu));
+    EXPECT_EQ(std::string(flat.get(), PDU::Size(pdu->GetHeader())),
+              got.substr(sizeof(id)));
+
+    EXPECT_TRUE(connector->IsConnected());
+
+    connector->SetEventCallback(NULL);
+    connector->Shutdown();
+    monitor->Shutdown();
+}
+
+TEST_F(PDUPeerEndpointNetworkConnectorUnitTest, EventLoopModeConnectFailureIsQuiet)
+{
+    FTRACE;
+    // bound, but not listening, so the connect is refused
+    AutoFD unused(createInetStreamSocket());
+    bindToAddress(unused, make_pair("127.0.0.1", 0));
+    struct sockaddr_in bound;
+    socklen_t boundLen(sizeof(bound));
+    ASSERT_EQ(0, getsockname(unused, reinterpret_cast<struct sockaddr*>(&bound),
+                             &boundLen));
+
+    boost::shared_ptr<EPollMonitor> monitor(new EPollMonitor("eplmon", 500, 1));
+    monitor->Start();
+    boost::shared_ptr<PDUQueue> pduQueue(new PDUQueue);
+    boost::shared_ptr<PDUPeerEndpointNetworkConnector> connector(
+        new PDUPeerEndpointNetworkConnector(
+            pduQueue,
+            mOwnerID,
+            make_pair("127.0.0.1", static_cast<int>(ntohs(bound.sin_port))),
+            monitor,
+            PDU_PEER_ENDPOINT_EVENT_LOOP));
+    int connected(0);
+    connector->SetEventCallback(boost::bind(&countConnected, &connected, _1));
+    connector->Start();
+
+    for (int i = 0; i < 100 && connector->GetFD() == -1; ++i)
+        usleep(1000);
+    for (int i = 0; i < 1000 && connector->GetFD() != -1; ++i)
+        usleep(1000);
+    EXPECT_EQ(-1, connector->GetFD());
+    EXPECT_FALSE(connector->IsConnected());
+    EXPECT_EQ(0, connected);
+
+    connector->SetEventCallback(NULL);
+    connector->Shutdown();
+    monitor->Shutdown();
+}
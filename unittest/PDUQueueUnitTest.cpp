@@ -0,0 +1,258 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+
+#include "PDUQueue.h"
+#include "Thread.h"
+#include "Foreach.h"
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+class PDUQueueUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_ALL);
+        logManager.BeginLogging("//stderr",
+                                logManager.GetSingleLevelFromString("UPTO_DEBUG"),
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() {
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+};
+
+// payload carries the producer and its sequence number
+struct TestPayload
+{
+    int producer;
+    int sequence;
+};
+
+static PDUPtr makePDU(int producer, int sequence)
+{
+    TestPayload payload;
+    payload.producer = producer;
+    payload.sequence = sequence;
+    return PDUPtr(new PDU(1, sizeof(payload), &payload));
+}
+
+class ProducerThread : public Thread
+{
+public:
+    ProducerThread(PDUQueue& queue, int producer, int count)
+        : mQueue(queue),
+          mProducer(producer),
+          mCount(count) {
+        initialized();
+    }
+
+    virtual ~ProducerThread() {
+        deleting();
+    }
+
+protected:
+    void* run() {
+        for (int i = 0; i < mCount; ++i)
+        {
+            mQueue.EnqueuePDU(makePDU(mProducer, i));
+        }
+        return NULL;
+    }
+
+    PDUQueue& mQueue;
+    int mProducer;
+    int mCount;
+};
+
+class NotEmptyCounter
+{
+public:
+    NotEmptyCounter() : mCalls(0) {}
+    void Call() { ++mCalls; }
+    int mCalls;
+};
+
+TEST_F(PDUQueueUnitTest, DequeuesInOrder)
+{
+    FTRACE;
+    PDUQueue queue(2, 8, PDU_PEER_QUEUE_THROW);
+
+    // go around the ring more than once
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            queue.EnqueuePDU(makePDU(0, i));
+        }
+        ASSERT_EQ(5, queue.GetQueueSize());
+
+        for (int i = 0; i < 5; ++i)
+        {
+            PDUPtr pdu;
+            queue.GetNextPDU(pdu);
+            ASSERT_TRUE(pdu);
+            ASSERT_EQ(i, pdu->GetPayload<TestPayload>()->sequence);
+        }
+
+        PDUPtr pdu;
+        queue.GetNextPDU(pdu);
+        ASSERT_FALSE(pdu);
+        ASSERT_EQ(0, queue.GetQueueSize());
+    }
+}
+
+TEST_F(PDUQueueUnitTest, ThrowsWhenFull)
+{
+    FTRACE;
+    PDUQueue queue(2, 4, PDU_PEER_QUEUE_THROW);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        queue.EnqueuePDU(makePDU(0, i));
+    }
+    ASSERT_THROW(queue.EnqueuePDU(makePDU(0, 4)), EPDUQueueFull);
+    ASSERT_EQ(4, queue.GetQueueSize());
+
+    PDUPtr pdu;
+    queue.GetNextPDU(pdu);
+    ASSERT_NO_THROW(queue.EnqueuePDU(makePDU(0, 4)));
+}
+
+TEST_F(PDUQueueUnitTest, DropsWhenFull)
+{
+    FTRACE;
+    PDUQueue queue(2, 4, PDU_PEER_QUEUE_DROP);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        queue.EnqueuePDU(makePDU(0, i));
+    }
+    ASSERT_EQ(4, queue.GetQueueSize());
+
+    std::vector<PDUPtr> pdus;
+    ASSERT_EQ(4, queue.DequeueBatch(pdus, 10));
+    ASSERT_EQ(3, pdus.back()->GetPayload<TestPayload>()->sequence);
+}
+
+TEST_F(PDUQueueUnitTest, BlockedProducerResumesWhenConsumed)
+{
+    FTRACE;
+    PDUQueue queue(2, 4, PDU_PEER_QUEUE_BLOCK);
+    ProducerThread producer(queue, 0, 20);
+
+    int next(0);
+    while (next < 20)
+    {
+        PDUPtr pdu;
+        queue.WaitForNextPDU(pdu);
+        ASSERT_TRUE(pdu);
+        ASSERT_EQ(next, pdu->GetPayload<TestPayload>()->sequence);
+        ASSERT_LE(queue.GetQueueSize(), 4);
+        ++next;
+    }
+}
+
+TEST_F(PDUQueueUnitTest, DequeueBatchHonorsMax)
+{
+    FTRACE;
+    PDUQueue queue(2, 16, PDU_PEER_QUEUE_THROW);
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.EnqueuePDU(makePDU(0, i));
+    }
+
+    std::vector<PDUPtr> pdus;
+    ASSERT_EQ(4, queue.DequeueBatch(pdus, 4));
+    ASSERT_EQ(6, queue.DequeueBatch(pdus, 100));
+    ASSERT_EQ(0, queue.DequeueBatch(pdus, 100));
+    ASSERT_EQ(10, pdus.size());
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(i, pdus[i]->GetPayload<TestPayload>()->sequence);
+    }
+    ASSERT_EQ(0, queue.GetQueueSize());
+}
+
+TEST_F(PDUQueueUnitTest, NotEmptyCallbackOnlyOnFirstPDU)
+{
+    FTRACE;
+    PDUQueue queue(2, 16, PDU_PEER_QUEUE_THROW);
+    NotEmptyCounter counter;
+    queue.SetNotEmptyCallback(
+        boost::bind(&NotEmptyCounter::Call, &counter));
+
+    queue.EnqueuePDU(makePDU(0, 0));
+    queue.EnqueuePDU(makePDU(0, 1));
+    ASSERT_EQ(1, counter.mCalls);
+
+    queue.Clear();
+    ASSERT_EQ(0, queue.GetQueueSize());
+    queue.EnqueuePDU(makePDU(0, 2));
+    ASSERT_EQ(2, counter.mCalls);
+}
+
+TEST_F(PDUQueueUnitTest, MultipleProducersKeepPerProducerOrder)
+{
+    FTRACE;
+    const int producers = 8;
+    const int perProducer = 5000;
+    PDUQueue queue(2, 64, PDU_PEER_QUEUE_BLOCK);
+
+    std::vector<boost::shared_ptr<ProducerThread> > threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.push_back(
+            boost::shared_ptr<ProducerThread>(
+                new ProducerThread(queue, p, perProducer)));
+    }
+
+    std::vector<int> nextSequence(producers, 0);
+    int received(0);
+    std::vector<PDUPtr> pdus;
+    while (received < producers * perProducer)
+    {
+        pdus.clear();
+        if (queue.DequeueBatch(pdus, 32) == 0)
+        {
+            PDUPtr pdu;
+            queue.WaitForNextPDU(pdu);
+            pdus.push_back(pdu);
+        }
+
+        foreach (const PDUPtr& pdu, pdus)
+        {
+            const TestPayload* payload = pdu->GetPayload<TestPayload>();
+            ASSERT_EQ(nextSequence[payload->producer], payload->sequence);
+            ++nextSequence[payload->producer];
+            ++received;
+        }
+    }
+
+    foreach (int n, nextSequence)
+    {
+        ASSERT_EQ(perProducer, n);
+    }
+    ASSERT_EQ(0, queue.GetQueueSize());
+}
@@ -0,0 +1,244 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "FTrace.h"
+#include "LogManager.h"
+
+#include "PDUSendBatch.h"
+#include "Foreach.h"
+
+#include <sys/socket.h>
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+
+using ::testing::UnitTest;
+
+LogManager logManager;
+
+class PDUSendBatchUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_ALL);
+        logManager.BeginLogging("//stderr",
+                                logManager.GetSingleLevelFromString("UPTO_DEBUG"),
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging();
+    }
+
+    void SetUp() {
+        hlogstream(
+            HLOG_INFO, "Starting test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, mFDs));
+    }
+
+    void TearDown() {
+        close(mFDs[0]);
+        close(mFDs[1]);
+        hlogstream(
+            HLOG_INFO, "ending test "
+            << UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    PDUPtr makePDU(int opcode,
+                   size_t payloadSize,
+                   size_t optionalDataSize,
+                   unsigned int attributes = 0) {
+        std::vector<char> payload(payloadSize, static_cast<char>(opcode));
+        PDUPtr pdu(new PDU(opcode, payloadSize,
+                           payloadSize ? &payload[0] : NULL));
+        if (optionalDataSize > 0)
+        {
+            std::vector<char> data(optionalDataSize,
+                                   static_cast<char>(opcode + 100));
+            boost::shared_ptr<PDUOptionalData> od(
+                new PDUOptionalData(optionalDataSize, attributes, &data[0]));
+            pdu->SetOptionalData(od);
+        }
+        return pdu;
+    }
+
+    // what the old flattened send path would have written
+    std::string flatten(const std::vector<PDUPtr>& pdus) {
+        std::string out;
+        foreach (const PDUPtr& pdu, pdus)
+        {
+            boost::shared_array<char> buf = PDU::CreateSendBuffer(*pdu);
+            out.append(buf.get(), PDU::Size(pdu->GetHeader()));
+        }
+        return out;
+    }
+
+    std::string readAll(size_t len) {
+        std::string out;
+        char buf[4096];
+        while (out.size() < len)
+        {
+            ssize_t rc = recv(mFDs[1], buf,
+                              std::min(sizeof(buf), len - out.size()), 0);
+            if (rc <= 0)
+                break;
+            out.append(buf, rc);
+        }
+        return out;
+    }
+
+    int mFDs[2];
+};
+
+TEST_F(PDUSendBatchUnitTest, SendsSameBytesAsFlattenedBuffers)
+{
+    std::vector<PDUPtr> pdus;
+    pdus.push_back(makePDU(1, 0, 0));
+    pdus.push_back(makePDU(2, 16, 0));
+    pdus.push_back(makePDU(3, 8, 1024));
+    pdus.push_back(makePDU(4, 0, 512, PDU_OPTIONAL_DATA_ATTRIBUTE_MEMALIGN_512));
+
+    PDUSendBatch batch(32, 65536);
+    foreach (const PDUPtr& pdu, pdus)
+    {
+        ASSERT_TRUE(batch.CanCoalesce());
+        batch.Add(pdu);
+    }
+    std::string expected(flatten(pdus));
+    ASSERT_EQ(expected.size(), batch.GetBytesRemaining());
+
+    ssize_t len = batch.Send(mFDs[0], MSG_NOSIGNAL);
+    ASSERT_EQ(static_cast<ssize_t>(expected.size()), len);
+    ASSERT_EQ(4, batch.RecordSent(len));
+    ASSERT_TRUE(batch.Empty());
+
+    ASSERT_EQ(expected, readAll(expected.size()));
+}
+
+TEST_F(PDUSendBatchUnitTest, ResumesAfterPartialWrites)
+{
+    std::vector<PDUPtr> pdus;
+    pdus.push_back(makePDU(1, 32, 100));
+    pdus.push_back(makePDU(2, 7, 0));
+    pdus.push_back(makePDU(3, 0, 300));
+
+    PDUSendBatch batch(32, 65536);
+    foreach (const PDUPtr& pdu, pdus)
+    {
+        batch.Add(pdu);
+    }
+    std::string expected(flatten(pdus));
+
+    // stand in for short writes by sending at most 13 bytes at a time
+    std::string sent;
+    size_t completed(0);
+    while (!batch.Empty())
+    {
+        ASSERT_EQ(pdus[completed], batch.Front());
+
+        ssize_t len = batch.Send(mFDs[0], MSG_NOSIGNAL);
+        ASSERT_GT(len, 0);
+        std::string got(readAll(len));
+        ASSERT_EQ(static_cast<size_t>(len), got.size());
+
+        // only record part of it, then resend the rest
+        size_t recorded = std::min(static_cast<size_t>(len),
+                                   static_cast<size_t>(13));
+        sent.append(got, 0, recorded);
+        completed += batch.RecordSent(recorded);
+    }
+
+    ASSERT_EQ(3, completed);
+    ASSERT_EQ(expected, sent);
+}
+
+TEST_F(PDUSendBatchUnitTest, CoalescesUpToLimits)
+{
+    PDUSendBatch byCount(2, 65536);
+    byCount.Add(makePDU(1, 4, 0));
+    ASSERT_TRUE(byCount.CanCoalesce());
+    byCount.Add(makePDU(2, 4, 0));
+    ASSERT_FALSE(byCount.CanCoalesce());
+    // limits are advice, a PDU already dequeued can still be added
+    byCount.Add(makePDU(3, 4, 0));
+    ASSERT_EQ(3, byCount.GetPDUCount());
+
+    // a PDU larger than the byte limit still goes out, alone
+    PDUSendBatch byBytes(32, 1024);
+    ASSERT_TRUE(byBytes.CanCoalesce());
+    byBytes.Add(makePDU(1, 0, 4096));
+    ASSERT_FALSE(byBytes.CanCoalesce());
+
+    // nothing joins a batch that has started sending
+    PDUSendBatch inFlight(32, 65536);
+    inFlight.Add(makePDU(1, 64, 0));
+    inFlight.RecordSent(10);
+    ASSERT_FALSE(inFlight.CanCoalesce());
+    ASSERT_THROW(inFlight.Add(makePDU(2, 4, 0)), EPDUSendBatch);
+}
+
+TEST_F(PDUSendBatchUnitTest, TakeUnsentReturnsIncompletePDUs)
+{
+    std::vector<PDUPtr> pdus;
+    pdus.push_back(makePDU(1, 8, 0));
+    pdus.push_back(makePDU(2, 8, 0));
+    pdus.push_back(makePDU(3, 8, 0));
+
+    PDUSendBatch batch(32, 65536);
+    foreach (const PDUPtr& pdu, pdus)
+    {
+        batch.Add(pdu);
+    }
+
+    // first PDU and part of the second
+    ASSERT_EQ(1, batch.RecordSent(PDU::Size(pdus[0]->GetHeader()) + 3));
+
+    std::list<PDUPtr> unsent;
+    batch.TakeUnsent(unsent);
+    ASSERT_TRUE(batch.Empty());
+    ASSERT_EQ(2, unsent.size());
+    ASSERT_EQ(pdus[1], unsent.front());
+    ASSERT_EQ(pdus[2], unsent.back());
+}
+
+TEST_F(PDUSendBatchUnitTest, PreambleGoesAheadOfPDUs)
+{
+    std::vector<PDUPtr> pdus;
+    pdus.push_back(makePDU(1, 8, 0));
+    pdus.push_back(makePDU(2, 0, 64));
+
+    const uint64_t id(123456789);
+    PDUSendBatch batch(32, 65536);
+    batch.AddPreamble(&id, sizeof(id));
+    ASSERT_FALSE(batch.Empty());
+    ASSERT_EQ(0, batch.GetPDUCount());
+    ASSERT_TRUE(batch.CanCoalesce());
+    foreach (const PDUPtr& pdu, pdus)
+    {
+        batch.Add(pdu);
+    }
+    ASSERT_THROW(batch.AddPreamble(&id, sizeof(id)), EPDUSendBatch);
+
+    std::string expected(reinterpret_cast<const char*>(&id), sizeof(id));
+    expected.append(flatten(pdus));
+    ASSERT_EQ(expected.size(), batch.GetBytesRemaining());
+
+    // the preamble alone completes no PDU, and is not sent twice
+    ASSERT_EQ(0, batch.RecordSent(sizeof(id) - 1));
+    ASSERT_EQ(0, batch.RecordSent(1));
+    ssize_t len = batch.Send(mFDs[0], MSG_NOSIGNAL);
+    ASSERT_EQ(static_cast<ssize_t>(expected.size() - sizeof(id)), len);
+    ASSERT_EQ(2, batch.RecordSent(len));
+    ASSERT_TRUE(batch.Empty());
+    ASSERT_EQ(expected.substr(sizeof(id)), readAll(len));
+
+    // a batch that only held a preamble is empty once it is sent
+    batch.AddPreamble(&id, sizeof(id));
+    len = batch.Send(mFDs[0], MSG_NOSIGNAL);
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(id)), len);
+    ASSERT_EQ(0, batch.RecordSent(len));
+    ASSERT_TRUE(batch.Empty());
+    ASSERT_EQ(expected.substr(0, sizeof(id)), readAll(len));
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "PerCPUCounter.h"
+#include "FunctionThread.h"
+#include "LogManager.h"
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+using namespace Forte;
+
+LogManager logManager;
+
+class PerCPUCounterUnitTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestCase() {
+        logManager.BeginLogging("//stdout");
+        logManager.SetLogMask("//stdout", HLOG_ALL);
+        hlog(HLOG_DEBUG, "Starting test...");
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging("//stdout");
+    }
+};
+
+TEST_F(PerCPUCounterUnitTest, Operators)
+{
+    PerCPUCounter counter(5);
+    ASSERT_EQ(5, static_cast<int64_t>(counter));
+
+    ++counter;
+    counter++;
+    counter += 10;
+    ASSERT_EQ(17, counter.Get());
+
+    --counter;
+    counter--;
+    counter -= 5;
+    ASSERT_EQ(10, counter.Get());
+
+    counter = 0;
+    ASSERT_EQ(0, counter.Get());
+}
+
+static void addMany(PerCPUCounter *counter, int times)
+{
+    for (int i = 0; i < times; ++i)
+        ++(*counter);
+}
+
+TEST_F(PerCPUCounterUnitTest, ConcurrentAddsAreNotLost)
+{
+    const int threadCount = 8;
+    const int adds = 100000;
+    PerCPUCounter counter;
+
+    {
+        std::vector<boost::shared_ptr<FunctionThread> > threads;
+        for (int i = 0; i < threadCount; ++i)
+        {
+            threads.push_back(
+                boost::shared_ptr<FunctionThread>(
+                    new FunctionThread(FunctionThread::AutoInit(),
+                                       boost::bind(&addMany, &counter, adds),
+                                       "adder")));
+        }
+        for (int i = 0; i < threadCount; ++i)
+            threads[i]->WaitForShutdown();
+    }
+
+    ASSERT_EQ(threadCount * adds, counter.Get());
+}
@@ -431,3 +431,155 @@ TEST_F(RingBufferCalculatorUnitTest, RecordReadWorksForWrappingObjects)
     ASSERT_EQ(0, rbc.GetReadLengthNoWrap());
     ASSERT_TRUE(rbc.Empty());
 }
+
+TEST_F(RingBufferCalculatorUnitTest, PinnedReadIsNotWritable)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+
+    uint64_t pin = rbc.PinRead(4);
+    //01234567890
+    //PPPPrrrrrrr
+    ASSERT_EQ(7, rbc.GetReadLength());
+    ASSERT_EQ(4, rbc.GetPinnedLength());
+    ASSERT_EQ(mBuffer.get() + 4, rbc.GetReadLocation());
+    ASSERT_TRUE(rbc.Full());
+    ASSERT_EQ(0, rbc.GetWriteLength());
+
+    rbc.RecordRead(7);
+    ASSERT_TRUE(rbc.Empty());
+    ASSERT_TRUE(rbc.Full());
+    ASSERT_EQ(11, rbc.GetPinnedLength());
+    ASSERT_THROW(rbc.GetWriteLocation(), ERingBufferCalculator);
+
+    ASSERT_TRUE(rbc.ReleasePin(pin));
+    ASSERT_EQ(0, rbc.GetPinnedLength());
+    ASSERT_FALSE(rbc.Full());
+    ASSERT_EQ(11, rbc.GetWriteLength());
+}
+
+TEST_F(RingBufferCalculatorUnitTest, PinsReleaseSpaceFromOldestPin)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+
+    uint64_t pin1 = rbc.PinRead(3);
+    uint64_t pin2 = rbc.PinRead(3);
+    rbc.RecordRead(2);
+    //01234567890
+    //111222rr...
+    ASSERT_EQ(8, rbc.GetPinnedLength());
+    ASSERT_EQ(0, rbc.GetWriteLength());
+
+    // releasing out of order frees nothing until the oldest goes
+    ASSERT_TRUE(rbc.ReleasePin(pin2));
+    ASSERT_EQ(8, rbc.GetPinnedLength());
+    ASSERT_EQ(0, rbc.GetWriteLength());
+
+    ASSERT_TRUE(rbc.ReleasePin(pin1));
+    ASSERT_EQ(0, rbc.GetPinnedLength());
+    ASSERT_EQ(8, rbc.GetWriteLength());
+    ASSERT_EQ(mBuffer.get(), rbc.GetWriteLocation());
+    ASSERT_EQ(3, rbc.GetReadLength());
+}
+
+TEST_F(RingBufferCalculatorUnitTest, WriteStopsAtPinnedRegion)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(6);
+    rbc.RecordRead(2);
+    uint64_t pin = rbc.PinRead(3);
+    rbc.RecordWrite(5);
+    //01234567890
+    //..PPPr.....  written to end, then wrapped
+    ASSERT_EQ(2, rbc.GetWriteLength());
+    rbc.RecordWrite(2);
+    ASSERT_TRUE(rbc.Full());
+    ASSERT_EQ(0, rbc.GetWriteLength());
+    ASSERT_EQ(8, rbc.GetReadLength());
+
+    ASSERT_TRUE(rbc.ReleasePin(pin));
+    ASSERT_EQ(3, rbc.GetWriteLength());
+    ASSERT_EQ(mBuffer.get() + 2, rbc.GetWriteLocation());
+}
+
+TEST_F(RingBufferCalculatorUnitTest, ResetDropsPins)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+    uint64_t pin = rbc.PinRead(5);
+
+    rbc.Reset(mBuffer.get(), 11);
+    ASSERT_EQ(0, rbc.GetPinnedLength());
+    ASSERT_EQ(11, rbc.GetWriteLength());
+
+    rbc.RecordWrite(11);
+    uint64_t newPin = rbc.PinRead(5);
+    ASSERT_NE(pin, newPin);
+    ASSERT_FALSE(rbc.ReleasePin(pin));
+    ASSERT_EQ(5, rbc.GetPinnedLength());
+    ASSERT_TRUE(rbc.ReleasePin(newPin));
+    ASSERT_EQ(0, rbc.GetPinnedLength());
+}
+
+TEST_F(RingBufferCalculatorUnitTest, MoveCarriesReadableData)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+    rbc.RecordRead(6);
+    rbc.RecordWrite(6);
+    uint64_t pin = rbc.PinRead(3);
+    //01234567890
+    //abcdefPPPxy  wrapped, so the readable data is xyabcdef
+    ASSERT_TRUE(rbc.Full());
+
+    boost::scoped_array<char> bigger(new char[22]);
+    rbc.Move(bigger.get(), 22);
+    ASSERT_EQ(0, rbc.GetPinnedLength());
+    ASSERT_EQ(8, rbc.GetReadLength());
+    ASSERT_EQ(bigger.get(), rbc.GetReadLocation());
+    ASSERT_EQ(14, rbc.GetWriteLength());
+
+    char buf[] = { 9, 10, 0, 1, 2, 3, 4, 5 };
+    ASSERT_EQ(0, memcmp(buf, bigger.get(), 8));
+    ASSERT_FALSE(rbc.ReleasePin(pin));
+}
+
+TEST_F(RingBufferCalculatorUnitTest, MoveWithEverythingPinned)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+    uint64_t pin = rbc.PinRead(11);
+    ASSERT_TRUE(rbc.Full());
+    ASSERT_TRUE(rbc.Empty());
+
+    // nothing readable to carry over, and more data can be received
+    boost::scoped_array<char> bigger(new char[22]);
+    rbc.Move(bigger.get(), 22);
+    ASSERT_TRUE(rbc.Empty());
+    ASSERT_FALSE(rbc.Full());
+    ASSERT_EQ(22, rbc.GetWriteLength());
+    ASSERT_EQ(bigger.get(), rbc.GetWriteLocation());
+
+    rbc.RecordWrite(5);
+    ASSERT_EQ(5, rbc.GetReadLength());
+    ASSERT_FALSE(rbc.ReleasePin(pin));
+}
+
+TEST_F(RingBufferCalculatorUnitTest, OffsetCopyLooksAheadOfReadCursor)
+{
+    RingBufferCalculator rbc(mBuffer.get(), 11);
+    rbc.RecordWrite(11);
+    rbc.RecordRead(6);
+    rbc.RecordWrite(6);
+
+    ASSERT_FALSE(rbc.ObjectWillWrap(2, 3));
+    ASSERT_TRUE(rbc.ObjectWillWrap(2, 4));
+    ASSERT_EQ(mBuffer.get() + 8, rbc.GetReadLocation(2));
+
+    char buf[] = { 9, 10, 0, 1 };
+    char copiedBuf[4];
+    rbc.ObjectCopy(3, copiedBuf, 4);
+    ASSERT_EQ(0, memcmp(buf, copiedBuf, 4));
+    ASSERT_EQ(11, rbc.GetReadLength());
+}
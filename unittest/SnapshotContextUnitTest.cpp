@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "FunctionThread.h"
+#include "LogManager.h"
+#include "Semaphore.h"
+#include "SnapshotContext.h"
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+using namespace Forte;
+
+LogManager logManager;
+
+class Counted : public Object
+{
+public:
+    Counted(int value = 0) : mValue(value) { ++sCount; }
+    virtual ~Counted() { --sCount; }
+    int mValue;
+    static int sCount;
+};
+int Counted::sCount = 0;
+
+class Other : public Object
+{
+};
+
+class SnapshotContextUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging("//stderr", HLOG_INFO);
+    }
+};
+
+TEST_F(SnapshotContextUnitTest, GetSetRemove)
+{
+    SnapshotContext c;
+    ASSERT_THROW(c.Get("a"), EContextInvalidKey);
+    ASSERT_THROW(c.Set("a", ObjectPtr()), EContextEmptyPointer);
+
+    const unsigned int generation = c.GetGeneration();
+    c.Set("a", ObjectPtr(new Counted(1)));
+    EXPECT_NE(generation, c.GetGeneration());
+    EXPECT_EQ(1, c.Get<Counted>("a")->mValue);
+    ASSERT_THROW(c.Get<Other>("a"), EContextTypeMismatch);
+
+    c.Set("a", ObjectPtr(new Counted(2)));
+    EXPECT_EQ(2, c.Get<Counted>("a")->mValue);
+    EXPECT_EQ(1, Counted::sCount);
+
+    c.Remove("a");
+    ASSERT_THROW(c.Get("a"), EContextInvalidKey);
+    EXPECT_EQ(0, Counted::sCount);
+
+    // nothing to remove, nothing changes
+    const unsigned int removed = c.GetGeneration();
+    c.Remove("a");
+    c.Clear();
+    EXPECT_EQ(removed, c.GetGeneration());
+}
+
+TEST_F(SnapshotContextUnitTest, WorksWithContextMacros)
+{
+    SnapshotContext mContext;
+    CNEW("counted", Counted, 7);
+    CGET("counted", Counted, counted);
+    EXPECT_EQ(7, counted.mValue);
+
+    const Context &base(mContext);
+    EXPECT_EQ(7, base.Get<Counted>("counted")->mValue);
+}
+
+TEST_F(SnapshotContextUnitTest, ClearReleasesObjects)
+{
+    {
+        SnapshotContext c;
+        c.Set("a", ObjectPtr(new Counted()));
+        c.Set("b", ObjectPtr(new Counted()));
+        c.Get("a");
+        EXPECT_EQ(2, Counted::sCount);
+        c.Clear();
+        EXPECT_EQ(0, Counted::sCount);
+        c.Set("a", ObjectPtr(new Counted()));
+    }
+    EXPECT_EQ(0, Counted::sCount);
+}
+
+TEST_F(SnapshotContextUnitTest, HandleFollowsChanges)
+{
+    SnapshotContext c;
+    ASSERT_THROW(SnapshotContext::Handle<Counted>(c, "a"), EContextInvalidKey);
+
+    c.Set("a", ObjectPtr(new Counted(1)));
+    SnapshotContext::Handle<Counted> a(c, "a");
+    EXPECT_EQ(1, a->mValue);
+    EXPECT_EQ(1, (*a).mValue);
+    EXPECT_EQ("a", a.GetKey());
+
+    c.Set("b", ObjectPtr(new Counted(2)));
+    EXPECT_EQ(1, a->mValue);
+
+    c.Set("a", ObjectPtr(new Counted(3)));
+    EXPECT_EQ(3, a->mValue);
+
+    c.Set("a", ObjectPtr(new Other()));
+    ASSERT_THROW(a.Get(), EContextTypeMismatch);
+
+    c.Remove("a");
+    ASSERT_THROW(a.Get(), EContextInvalidKey);
+}
+
+static void readValue(const SnapshotContext *c, int *value)
+{
+    *value = c->Get<Counted>("a")->mValue;
+}
+
+TEST_F(SnapshotContextUnitTest, OtherThreadsSeeChanges)
+{
+    SnapshotContext c;
+    c.Set("a", ObjectPtr(new Counted(1)));
+
+    int value = 0;
+    {
+        FunctionThread t(FunctionThread::AutoInit(),
+                         boost::bind(&readValue, &c, &value), "reader");
+        t.WaitForShutdown();
+    }
+    EXPECT_EQ(1, value);
+
+    // a thread that has cached the old snapshot sees the new one
+    c.Get("a");
+    c.Set("a", ObjectPtr(new Counted(2)));
+    {
+        FunctionThread t(FunctionThread::AutoInit(),
+                         boost::bind(&readValue, &c, &value), "reader");
+        t.WaitForShutdown();
+    }
+    EXPECT_EQ(2, value);
+    EXPECT_EQ(2, c.Get<Counted>("a")->mValue);
+}
+
+// a context made at the address of one just destroyed must not be
+// served the old one's cached snapshot
+TEST_F(SnapshotContextUnitTest, NewContextStartsEmpty)
+{
+    for (int i = 0; i < 20; ++i)
+    {
+        SnapshotContext c;
+        ASSERT_THROW(c.Get("a"), EContextInvalidKey);
+        c.Set("a", ObjectPtr(new Counted(i)));
+        EXPECT_EQ(i, c.Get<Counted>("a")->mValue);
+    }
+}
+
+// reads the context, then stays alive until told to exit
+static void readAndWait(const SnapshotContext *c, Semaphore *read,
+                        Semaphore *exit)
+{
+    c->Get("a");
+    read->Post();
+    exit->Wait();
+}
+
+TEST_F(SnapshotContextUnitTest, DestroyReleasesOtherThreadsSnapshots)
+{
+    Semaphore read(0);
+    Semaphore exit(0);
+    boost::scoped_ptr<SnapshotContext> c(new SnapshotContext());
+    c->Set("a", ObjectPtr(new Counted()));
+
+    FunctionThread t(FunctionThread::AutoInit(),
+                     boost::bind(&readAndWait, c.get(), &read, &exit),
+                     "reader");
+    read.Wait();
+    EXPECT_EQ(1, Counted::sCount);
+
+    // the reader still caches the snapshot it read, but the context
+    // is gone so its objects must be too
+    c.reset();
+    EXPECT_EQ(0, Counted::sCount);
+
+    exit.Post();
+    t.WaitForShutdown();
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "StatsSegment.h"
+#include "LatencyHistogram.h"
+#include "LogManager.h"
+#include "Locals.h"
+#include "PerCPUCounter.h"
+#include <boost/make_shared.hpp>
+#include <unistd.h>
+
+using namespace Forte;
+
+LogManager logManager;
+
+class StatsSegmentUnitTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestCase() {
+        logManager.BeginLogging("//stdout");
+        logManager.SetLogMask("//stdout", HLOG_ALL);
+        hlog(HLOG_DEBUG, "Starting test...");
+    }
+
+    static void TearDownTestCase() {
+        logManager.EndLogging("//stdout");
+    }
+
+    void SetUp() {
+        mPath.Format("/tmp/StatsSegmentUnitTest.%d", getpid());
+    }
+
+    FString mPath;
+};
+
+class PeerStats :
+    public Forte::Object,
+    public EnableStats<PeerStats,
+                       Locals<PeerStats, int64_t, PerCPUCounter, LatencyHistogram> >
+{
+public:
+    PeerStats()
+        : queued(0) {
+        registerStatVariable<0>("queued", &PeerStats::queued);
+        registerStatVariable<1>("sent", &PeerStats::sent);
+        registerStatVariable<2>("latency", &PeerStats::latency);
+    }
+
+    void Send(int64_t usec) {
+        ++sent;
+        latency.Record(usec);
+    }
+
+    int64_t queued;
+    PerCPUCounter sent;
+    LatencyHistogram latency;
+};
+
+static std::map<FString, int64_t> withPrefix(
+    const FString &prefix, const std::map<FString, int64_t> &stats)
+{
+    std::map<FString, int64_t> result;
+    typedef std::pair<FString, int64_t> StatPair;
+    foreach (const StatPair &stat, stats)
+    {
+        result[FString(FStringFC(), "%s.%s",
+                       prefix.c_str(), stat.first.c_str())] = stat.second;
+    }
+    return result;
+}
+
+TEST_F(StatsSegmentUnitTest, ReaderMatchesGetAllStats)
+{
+    StatsSegment segment(mPath, 64);
+    boost::shared_ptr<PeerStats> a(boost::make_shared<PeerStats>());
+    boost::shared_ptr<PeerStats> b(boost::make_shared<PeerStats>());
+    a->Send(10);
+    segment.Add(a, "peer.a");
+    segment.Add(b, "peer.b");
+    EXPECT_EQ(14, segment.GetUsedCount());
+
+    StatsSegmentReader reader(mPath);
+    EXPECT_EQ(getpid(), reader.GetPID());
+
+    std::map<FString, int64_t> expected(withPrefix("peer.a", a->GetAllStats()));
+    std::map<FString, int64_t> fromB(withPrefix("peer.b", b->GetAllStats()));
+    expected.insert(fromB.begin(), fromB.end());
+
+    std::map<FString, int64_t> stats;
+    reader.Read(stats);
+    EXPECT_EQ(expected, stats);
+    EXPECT_EQ(1, stats["peer.a.sent"]);
+    EXPECT_EQ(10, stats["peer.a.latency.max"]);
+
+    // values change only when the server updates the segment
+    a->queued = 7;
+    b->Send(300);
+    b->Send(20);
+    stats.clear();
+    reader.Read(stats);
+    EXPECT_EQ(0, stats["peer.a.queued"]);
+
+    segment.Update();
+    expected = withPrefix("peer.a", a->GetAllStats());
+    fromB = withPrefix("peer.b", b->GetAllStats());
+    expected.insert(fromB.begin(), fromB.end());
+    stats.clear();
+    reader.Read(stats);
+    EXPECT_EQ(expected, stats);
+    EXPECT_EQ(7, stats["peer.a.queued"]);
+    EXPECT_EQ(2, stats["peer.b.sent"]);
+    EXPECT_EQ(300, stats["peer.b.latency.max"]);
+}
+
+TEST_F(StatsSegmentUnitTest, DestroyedObjectsAreDropped)
+{
+    StatsSegment segment(mPath, 16);
+    boost::shared_ptr<PeerStats> a(boost::make_shared<PeerStats>());
+    boost::shared_ptr<PeerStats> b(boost::make_shared<PeerStats>());
+    segment.Add(a, "a");
+    segment.Add(b, "b");
+    ASSERT_THROW(segment.Add(boost::make_shared<PeerStats>(), "c"),
+                 EStatsSegmentFull);
+    EXPECT_EQ(14, segment.GetUsedCount());
+
+    a.reset();
+    segment.Update();
+    EXPECT_EQ(7, segment.GetUsedCount());
+
+    StatsSegmentReader reader(mPath);
+    std::map<FString, int64_t> stats;
+    reader.Read(stats);
+    EXPECT_EQ(7, stats.size());
+    EXPECT_EQ(0, stats.count("a.queued"));
+    EXPECT_EQ(1, stats.count("b.queued"));
+
+    // freed entries are reused
+    boost::shared_ptr<PeerStats> c(boost::make_shared<PeerStats>());
+    segment.Add(c, "c");
+    segment.Remove(b);
+    EXPECT_EQ(7, segment.GetUsedCount());
+
+    stats.clear();
+    reader.Read(stats);
+    EXPECT_EQ(withPrefix("c", c->GetAllStats()), stats);
+}
+
+TEST_F(StatsSegmentUnitTest, FileLifetime)
+{
+    ASSERT_THROW(StatsSegmentReader reader(mPath), EStatsSegmentOpen);
+    {
+        StatsSegment segment(mPath);
+        EXPECT_EQ(0, access(mPath.c_str(), R_OK));
+        ASSERT_THROW(segment.Add(boost::shared_ptr<PeerStats>(), "x"),
+                     EStatsSegmentObjectInvalid);
+    }
+    EXPECT_NE(0, access(mPath.c_str(), R_OK));
+
+    FILE *notASegment = fopen(mPath.c_str(), "w");
+    ASSERT_TRUE(notASegment != NULL);
+    fprintf(notASegment, "not a stats segment, but long enough to have a header "
+            "that could be read as one if nothing were checked\n");
+    fclose(notASegment);
+    ASSERT_THROW(StatsSegmentReader reader(mPath), EStatsSegmentFormat);
+    unlink(mPath.c_str());
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "Foreach.h"
+#include "LogManager.h"
+#include "RunLoop.h"
+#include "Timer.h"
+#include "TimerWheel.h"
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <map>
+
+using namespace Forte;
+using namespace boost;
+
+LogManager logManager;
+
+static void nothing(void)
+{
+}
+
+class TimerWheelUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging("//stderr", HLOG_INFO);
+    }
+
+    virtual void SetUp() {
+        mStart = Timespec::FromSeconds(1000);
+        mTick = Timespec::FromMillisec(1);
+        mRunLoop = boost::make_shared<RunLoop>("twtest");
+    }
+
+    virtual void TearDown() {
+        mRunLoop->Shutdown();
+        mRunLoop->WaitForShutdown();
+    }
+
+    shared_ptr<Timer> makeTimer(const FString &name) {
+        return boost::make_shared<Timer>(name, mRunLoop, &nothing,
+                                         Timespec::FromMillisec(1), false);
+    }
+
+    Timespec at(long long millisec) {
+        return mStart + Timespec(millisec / 1000, (millisec % 1000) * 1000000);
+    }
+
+    Timespec mStart;
+    Timespec mTick;
+    shared_ptr<RunLoop> mRunLoop;
+};
+
+TEST_F(TimerWheelUnitTest, InvalidTick)
+{
+    ASSERT_THROW(TimerWheel(Timespec(), mStart), ETimerWheelTickInvalid);
+    ASSERT_THROW(TimerWheel(Timespec::FromMillisec(-1), mStart),
+                 ETimerWheelTickInvalid);
+}
+
+TEST_F(TimerWheelUnitTest, Empty)
+{
+    TimerWheel wheel(mTick, mStart);
+    Timespec next;
+    std::vector<TimerWheel::Expired> expired;
+    EXPECT_TRUE(wheel.IsEmpty());
+    EXPECT_FALSE(wheel.GetNextExpiry(next));
+    EXPECT_EQ(0U, wheel.Expire(at(100000), expired));
+    EXPECT_TRUE(expired.empty());
+}
+
+TEST_F(TimerWheelUnitTest, ExpiresInOrderAndNotEarly)
+{
+    TimerWheel wheel(mTick, mStart);
+    shared_ptr<Timer> a(makeTimer("a"));
+    shared_ptr<Timer> b(makeTimer("b"));
+    shared_ptr<Timer> c(makeTimer("c"));
+    shared_ptr<Timer> d(makeTimer("d"));
+
+    wheel.Add(d, at(7200000), mStart);               // in the last level
+    wheel.Add(c, at(20000), mStart);                 // the third
+    wheel.Add(b, at(300), mStart);                   // the second
+    wheel.Add(a, at(5) + Timespec(0, 100), mStart);  // rounded up to 6
+    EXPECT_EQ(4U, wheel.Size());
+
+    Timespec next;
+    ASSERT_TRUE(wheel.GetNextExpiry(next));
+    EXPECT_TRUE(next == at(6));
+
+    std::vector<TimerWheel::Expired> expired;
+    EXPECT_EQ(0U, wheel.Expire(at(5) + Timespec(0, 100), expired));
+    EXPECT_EQ(1U, wheel.Expire(at(6), expired));
+    ASSERT_EQ(1U, expired.size());
+    EXPECT_EQ(a, expired[0].mTimer);
+    EXPECT_TRUE(expired[0].mScheduledTime == mStart);
+
+    // late, so both come out at once, earliest first
+    expired.clear();
+    EXPECT_EQ(2U, wheel.Expire(at(30000), expired));
+    ASSERT_EQ(2U, expired.size());
+    EXPECT_EQ(b, expired[0].mTimer);
+    EXPECT_EQ(c, expired[1].mTimer);
+    EXPECT_TRUE(expired[1].mAbsolute == at(20000));
+
+    expired.clear();
+    EXPECT_EQ(0U, wheel.Expire(at(7199999), expired));
+    EXPECT_EQ(1U, wheel.Expire(at(7200000), expired));
+    EXPECT_TRUE(wheel.IsEmpty());
+}
+
+TEST_F(TimerWheelUnitTest, InThePast)
+{
+    TimerWheel wheel(mTick, mStart);
+    std::vector<TimerWheel::Expired> expired;
+    wheel.Expire(at(50), expired);
+
+    // goes in the next tick
+    shared_ptr<Timer> a(makeTimer("a"));
+    wheel.Add(a, at(10), at(10));
+    EXPECT_EQ(0U, wheel.Expire(at(50), expired));
+    EXPECT_EQ(1U, wheel.Expire(at(51), expired));
+}
+
+TEST_F(TimerWheelUnitTest, DestroyedTimersAreDropped)
+{
+    TimerWheel wheel(mTick, mStart);
+    shared_ptr<Timer> a(makeTimer("a"));
+    shared_ptr<Timer> b(makeTimer("b"));
+    shared_ptr<Timer> c(makeTimer("c"));
+    wheel.Add(a, at(10), mStart);
+    wheel.Add(b, at(10), mStart);
+    wheel.Add(c, at(100000), mStart);
+    b.reset();
+    c.reset();
+    EXPECT_EQ(3U, wheel.Size());
+
+    std::vector<TimerWheel::Expired> expired;
+    EXPECT_EQ(1U, wheel.Expire(at(10), expired));
+    EXPECT_EQ(a, expired[0].mTimer);
+    EXPECT_EQ(1U, wheel.Size());
+
+    // reclaimed when its slot is placed again
+    EXPECT_EQ(0U, wheel.Expire(at(100000), expired));
+    EXPECT_TRUE(wheel.IsEmpty());
+}
+
+// steps from one GetNextExpiry() to the next, as RunLoop does, and
+// checks that every timer comes out within a tick after it is due
+TEST_F(TimerWheelUnitTest, ManyTimersAcrossAllLevels)
+{
+    TimerWheel wheel(mTick, mStart);
+    std::map<Timer*, Timespec> due;
+    std::vector<shared_ptr<Timer> > timers;
+    unsigned int seed = 7;
+    for (int i = 0; i < 20000; ++i)
+    {
+        // up to about two days, past the end of the wheel
+        const long long ms = (i % 4 == 0) ?
+            rand_r(&seed) % 2000 :
+            (long long) rand_r(&seed) * 173 % 172800000LL;
+        shared_ptr<Timer> timer(makeTimer("t"));
+        const Timespec absolute(at(ms) + Timespec(0, rand_r(&seed) % 1000000));
+        wheel.Add(timer, absolute, mStart);
+        due[timer.get()] = absolute;
+        timers.push_back(timer);
+    }
+
+    std::vector<TimerWheel::Expired> expired;
+    size_t fired = 0;
+    int steps = 0;
+    Timespec now;
+    while (wheel.GetNextExpiry(now))
+    {
+        ++steps;
+        expired.clear();
+        fired += wheel.Expire(now, expired);
+        foreach (const TimerWheel::Expired &e, expired)
+        {
+            const Timespec &absolute(due[e.mTimer.get()]);
+            ASSERT_TRUE(absolute <= now);
+            ASSERT_TRUE(now - absolute < mTick);
+        }
+    }
+    EXPECT_EQ(timers.size(), fired);
+    EXPECT_TRUE(wheel.IsEmpty());
+    // a step for each tick with timers due and each coarser slot
+    // placed again, not one for every tick in two days
+    EXPECT_LT(steps, 3 * (int) timers.size());
+}
+
+TEST_F(TimerWheelUnitTest, AddAndExpireRounds)
+{
+    TimerWheel wheel(mTick, mStart);
+    std::vector<shared_ptr<Timer> > timers;
+    for (int i = 0; i < 100; ++i)
+        timers.push_back(makeTimer("t"));
+
+    std::vector<TimerWheel::Expired> expired;
+    for (int round = 0; round < 50; ++round)
+    {
+        foreach (const shared_ptr<Timer> &timer, timers)
+            wheel.Add(timer, at(round * 10 + 5), mStart);
+        EXPECT_EQ(100U, wheel.Size());
+        expired.clear();
+        EXPECT_EQ(100U, wheel.Expire(at(round * 10 + 5), expired));
+        EXPECT_TRUE(wheel.IsEmpty());
+    }
+}
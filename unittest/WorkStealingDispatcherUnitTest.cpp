@@ -0,0 +1,319 @@
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "FTrace.h"
+#include "LogManager.h"
+
+#include "RequestHandler.h"
+#include "WorkStealingDispatcher.h"
+
+using namespace std;
+using namespace boost;
+using namespace Forte;
+
+LogManager logManager;
+
+class TestEvent : public Forte::Event
+{
+public:
+    TestEvent() {}
+    virtual ~TestEvent() {}
+
+    virtual void DoWork() = 0;
+};
+
+class TestEventNoop : public TestEvent
+{
+public:
+    TestEventNoop() {}
+    virtual ~TestEventNoop() {}
+
+    virtual void DoWork() {}
+};
+
+class TestEventWorkUntilSignaled : public TestEvent
+{
+public:
+    TestEventWorkUntilSignaled() {}
+    virtual ~TestEventWorkUntilSignaled() {}
+
+    virtual void DoWork() {
+        while (!Thread::MyThread()->IsShuttingDown())
+        {
+            const Timespec interval(5, 0);
+            const bool throwOnShutdown(false);
+            Thread::InterruptibleSleep(interval, throwOnShutdown);
+        }
+    }
+};
+
+// queues children on the worker running it, then holds that worker
+// until every child has run. the children can only run if other
+// workers steal them
+class TestEventSpawnAndWait : public TestEvent
+{
+public:
+    TestEventSpawnAndWait(DispatcherPtr dispatcher, int children)
+        : mDispatcher(dispatcher),
+          mChildren(children),
+          mDoneCondition(mDoneMutex),
+          mDone(0)
+        {
+        }
+
+    virtual ~TestEventSpawnAndWait() {}
+
+    class Child : public TestEvent
+    {
+    public:
+        Child(TestEventSpawnAndWait& parent) : mParent(parent) {}
+        virtual void DoWork() {
+            AutoUnlockMutex lock(mParent.mDoneMutex);
+            ++mParent.mDone;
+            mParent.mDoneCondition.Signal();
+        }
+        TestEventSpawnAndWait& mParent;
+    };
+
+    virtual void DoWork() {
+        for (int i = 0; i < mChildren; ++i)
+        {
+            mDispatcher->Enqueue(boost::shared_ptr<Event>(new Child(*this)));
+        }
+
+        DeadlineClock deadline;
+        deadline.ExpiresInSeconds(10);
+        AutoUnlockMutex lock(mDoneMutex);
+        while (mDone < mChildren && !deadline.Expired())
+        {
+            mDoneCondition.TimedWait(1);
+        }
+    }
+
+    int GetDone() {
+        AutoUnlockMutex lock(mDoneMutex);
+        return mDone;
+    }
+
+    DispatcherPtr mDispatcher;
+    int mChildren;
+    Mutex mDoneMutex;
+    ThreadCondition mDoneCondition;
+    int mDone;
+};
+
+class TestRequestHandler : public RequestHandler
+{
+public:
+    TestRequestHandler()
+        : RequestHandler(0),
+          mCondition(mHandledRequestsMutex),
+          mHandledRequests(0),
+          mInitCount(0),
+          mCleanupCount(0)
+        {
+        }
+    virtual ~TestRequestHandler() {}
+
+    int GetHandledRequestCount() const {
+        AutoUnlockMutex lock(mHandledRequestsMutex);
+        return mHandledRequests;
+    }
+
+    void WaitForRequestHandled(int minHandled=1) {
+        AutoUnlockMutex lock(mHandledRequestsMutex);
+
+        while (mHandledRequests < minHandled)
+        {
+            mCondition.Wait();
+        }
+    }
+
+    void Handler(Event *e) {
+        {
+            AutoUnlockMutex lock(mHandledRequestsMutex);
+            mHandledRequests++;
+            mCondition.Signal();
+        }
+
+        TestEvent* event = dynamic_cast<TestEvent*>(e);
+        if (event != NULL)
+        {
+            event->DoWork();
+        }
+    }
+
+    void Busy(void) {
+    }
+
+    void Periodic(void) {
+    }
+
+    void Init(void) {
+        AutoUnlockMutex lock(mHandledRequestsMutex);
+        ++mInitCount;
+    }
+
+    void Cleanup(void) {
+        AutoUnlockMutex lock(mHandledRequestsMutex);
+        ++mCleanupCount;
+    }
+
+    mutable Forte::Mutex mHandledRequestsMutex;
+    mutable Forte::ThreadCondition mCondition;
+    int mHandledRequests;
+    int mInitCount;
+    int mCleanupCount;
+};
+
+
+class WorkStealingDispatcherUnitTest : public ::testing::Test
+{
+public:
+    static void SetUpTestCase() {
+        logManager.BeginLogging(__FILE__ ".log", HLOG_ALL);
+        logManager.BeginLogging("//stderr",
+                                logManager.GetSingleLevelFromString("UPTO_DEBUG"),
+                                HLOG_FORMAT_SIMPLE | HLOG_FORMAT_THREAD);
+        hlog(HLOG_DEBUG, "Starting test...");
+    }
+
+    static void TearDownTestCase() {
+    }
+
+    void SetUp() {
+    }
+
+    void TearDown() {
+    }
+};
+
+TEST_F(WorkStealingDispatcherUnitTest, ConstructDelete)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 4, 32, "TestWorkStealing"));
+
+    ASSERT_EQ(4, dispatcher->GetThreadCount());
+    dispatcher->Shutdown();
+
+    // a worker shut down before it ran never calls either
+    ASSERT_EQ(testHandler->mInitCount, testHandler->mCleanupCount);
+    ASSERT_EQ(0, dispatcher->GetThreadCount());
+}
+
+TEST_F(WorkStealingDispatcherUnitTest, HandlesEveryEvent)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 4, 32, "TestWorkStealing"));
+
+    // more events than maxDepth, so Enqueue has to block for room
+    for (int i = 0; i < 10000; ++i)
+    {
+        dispatcher->Enqueue(boost::make_shared<TestEventNoop>());
+    }
+
+    testHandler->WaitForRequestHandled(10000);
+    ASSERT_EQ(10000, testHandler->GetHandledRequestCount());
+    ASSERT_EQ(0, dispatcher->GetQueueDepth());
+
+    dispatcher->Shutdown();
+}
+
+TEST_F(WorkStealingDispatcherUnitTest, WorkersCanWorkUntilSignalled)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 6, 32, "TestWorkStealing"));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        dispatcher->Enqueue(boost::make_shared<TestEventWorkUntilSignaled>());
+    }
+
+    testHandler->WaitForRequestHandled(5);
+    const int maxEvents(10);
+    std::list<boost::shared_ptr<Event> > events;
+
+    ASSERT_EQ(0, dispatcher->GetQueuedEvents(maxEvents, events));
+    ASSERT_EQ(5, dispatcher->GetRunningEvents(maxEvents, events));
+
+    dispatcher->Shutdown();
+
+    ASSERT_EQ(5, testHandler->GetHandledRequestCount());
+}
+
+TEST_F(WorkStealingDispatcherUnitTest, IdleWorkersStealFromBusyWorker)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 4, 64, "TestWorkStealing"));
+
+    boost::shared_ptr<TestEventSpawnAndWait> parent(
+        new TestEventSpawnAndWait(dispatcher, 20));
+    dispatcher->Enqueue(parent);
+
+    testHandler->WaitForRequestHandled(21);
+    dispatcher->Shutdown();
+
+    ASSERT_EQ(20, parent->GetDone());
+}
+
+TEST_F(WorkStealingDispatcherUnitTest, PausedDispatcherQueuesUntilResumed)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 2, 32, "TestWorkStealing"));
+
+    dispatcher->Pause();
+    for (int i = 0; i < 10; ++i)
+    {
+        dispatcher->Enqueue(boost::make_shared<TestEventNoop>());
+    }
+
+    usleep(200000);
+    ASSERT_EQ(0, testHandler->GetHandledRequestCount());
+    ASSERT_EQ(10, dispatcher->GetQueueDepth());
+
+    const int maxEvents(5);
+    std::list<boost::shared_ptr<Event> > events;
+    ASSERT_EQ(5, dispatcher->GetQueuedEvents(maxEvents, events));
+
+    dispatcher->Resume();
+    testHandler->WaitForRequestHandled(10);
+
+    dispatcher->Shutdown();
+}
+
+TEST_F(WorkStealingDispatcherUnitTest, ShutdownRunsQueuedEventsAndRejectsNew)
+{
+    FTRACE;
+
+    boost::shared_ptr<TestRequestHandler> testHandler(new TestRequestHandler());
+    boost::shared_ptr<WorkStealingDispatcher> dispatcher(
+        new WorkStealingDispatcher(testHandler, 2, 1000, "TestWorkStealing"));
+
+    for (int i = 0; i < 500; ++i)
+    {
+        dispatcher->Enqueue(boost::make_shared<TestEventNoop>());
+    }
+    dispatcher->Shutdown();
+
+    ASSERT_EQ(500, testHandler->GetHandledRequestCount());
+    ASSERT_FALSE(dispatcher->Accepting());
+    ASSERT_THROW(dispatcher->Enqueue(boost::make_shared<TestEventNoop>()),
+                 EWorkStealingDispatcherShuttingDown);
+}